@@ -263,13 +263,18 @@ static int aesbs_xts_encrypt(struct blkcipher_desc *desc,
 	/* generate the initial tweak */
 	AES_encrypt(walk.iv, walk.iv, &ctx->twkey);
 
+	/*
+	 * Keep a single NEON section for the whole request rather than one
+	 * per walk step; the walk must not sleep while we hold it.
+	 */
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+	kernel_neon_begin();
 	while (walk.nbytes) {
-		kernel_neon_begin();
 		bsaes_xts_encrypt(walk.src.virt.addr, walk.dst.virt.addr,
 				  walk.nbytes, &ctx->enc, walk.iv);
-		kernel_neon_end();
 		err = blkcipher_walk_done(desc, &walk, walk.nbytes % AES_BLOCK_SIZE);
 	}
+	kernel_neon_end();
 	return err;
 }
 
@@ -287,13 +292,15 @@ static int aesbs_xts_decrypt(struct blkcipher_desc *desc,
 	/* generate the initial tweak */
 	AES_encrypt(walk.iv, walk.iv, &ctx->twkey);
 
+	/* one NEON section per request, see aesbs_xts_encrypt() */
+	desc->flags &= ~CRYPTO_TFM_REQ_MAY_SLEEP;
+	kernel_neon_begin();
 	while (walk.nbytes) {
-		kernel_neon_begin();
 		bsaes_xts_decrypt(walk.src.virt.addr, walk.dst.virt.addr,
 				  walk.nbytes, &ctx->dec, walk.iv);
-		kernel_neon_end();
 		err = blkcipher_walk_done(desc, &walk, walk.nbytes % AES_BLOCK_SIZE);
 	}
+	kernel_neon_end();
 	return err;
 }
 
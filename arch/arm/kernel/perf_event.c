@@ -519,9 +519,16 @@ static void armpmu_enable(struct pmu *pmu)
 		for (idx = 0; idx <= armpmu->num_events; ++idx) {
 			struct perf_event *event = hw_events->events[idx];
 
-			if (!event)
+			if (!event || (event->hw.state & PERF_HES_STOPPED))
 				continue;
 
+			/*
+			 * The counters were folded into the events before
+			 * power collapse and came back reset, so rebase
+			 * prev_count and the remaining period before
+			 * counting again.
+			 */
+			armpmu_event_set_period(event);
 			armpmu->enable(event);
 		}
 
@@ -0,0 +1,30 @@
+/*
+ *  linux/arch/arm/lib/copy_page_neon.c
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * copy_page() for kernels with kernel mode NEON. The NEON loop is used
+ * whenever the CPU has NEON and the caller is allowed to touch the NEON
+ * register file; interrupt context and CPUs without NEON fall back to
+ * the LDM/STM routine from copy_page.S.
+ */
+#include <linux/linkage.h>
+#include <asm/neon.h>
+#include <asm/page.h>
+#include <asm/simd.h>
+
+asmlinkage void __copy_page_arm(void *to, const void *from);
+asmlinkage void __copy_page_neon(void *to, const void *from);
+
+void copy_page(void *to, const void *from)
+{
+	if (cpu_has_neon() && may_use_simd()) {
+		kernel_neon_begin();
+		__copy_page_neon(to, from);
+		kernel_neon_end();
+	} else {
+		__copy_page_arm(to, from);
+	}
+}
@@ -25,6 +25,7 @@
 #include <linux/of_fdt.h>
 #include <linux/of_irq.h>
 #include <linux/memory.h>
+#include <linux/sched_energy.h>
 #include <linux/regulator/cpr-regulator.h>
 #include <linux/regulator/fan53555.h>
 #include <linux/regulator/onsemi-ncp6335d.h>
@@ -107,6 +108,33 @@ void __init msm8226_add_drivers(void)
 	cpr_regulator_init();
 }
 
+/*
+ * Cortex-A7 energy model for energy aware scheduling, per core, in mW.
+ * The figures are estimates; placement only depends on their ratios.
+ */
+static const struct sched_energy_opp msm8226_cpu_opps[] = {
+	{  300000,  32 },
+	{  384000,  41 },
+	{  600000,  68 },
+	{  787200,  98 },
+	{  998400, 142 },
+	{ 1094400, 168 },
+	{ 1190400, 197 },
+};
+
+static const struct sched_energy_idle msm8226_cpu_idle_states[] = {
+	{ 18 },		/* wfi */
+	{  7 },		/* retention */
+	{  1 },		/* power collapse */
+};
+
+static const struct sched_energy msm8226_sched_energy = {
+	.opps			= msm8226_cpu_opps,
+	.nr_opps		= ARRAY_SIZE(msm8226_cpu_opps),
+	.idle_states		= msm8226_cpu_idle_states,
+	.nr_idle_states		= ARRAY_SIZE(msm8226_cpu_idle_states),
+};
+
 void __init msm8226_init(void)
 {
 	struct of_dev_auxdata *adata = msm8226_auxdata_lookup;
@@ -126,6 +154,7 @@ void __init msm8226_init(void)
 
 	msm8226_init_gpiomux();
 	msm8226_add_drivers();
+	sched_energy_register(&msm8226_sched_energy);
 }
 
 static const char *msm8226_dt_match[] __initconst = {
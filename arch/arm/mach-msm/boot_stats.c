@@ -12,6 +12,7 @@
 
 #include <linux/kernel.h>
 #include <linux/err.h>
+#include <linux/errno.h>
 #include <linux/io.h>
 #include <linux/init.h>
 #include <linux/delay.h>
@@ -23,6 +24,11 @@
 #include <linux/sched.h>
 #include <linux/of.h>
 #include <linux/of_address.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/spinlock.h>
+#include <linux/math64.h>
+#include <soc/qcom/boot_stats.h>
 #include <mach/msm_iomap.h>
 
 struct boot_stats {
@@ -36,6 +42,80 @@ static void __iomem *mpm_counter_base;
 static uint32_t mpm_counter_freq;
 static struct boot_stats __iomem *boot_stats;
 
+/*
+ * Kernel events are stamped with local_clock(), which runs from kernel
+ * start, and mapped onto the MPM timeline through one sample of both
+ * clocks taken in boot_stats_init().
+ */
+#define BOOT_STATS_MAX_EVENTS	256
+#define BOOT_STATS_NAME_LEN	56
+
+struct boot_event {
+	u64 ns;
+	u32 duration_us;
+	char name[BOOT_STATS_NAME_LEN];
+};
+
+static struct boot_event boot_events[BOOT_STATS_MAX_EVENTS];
+static unsigned int boot_events_nr;
+static DEFINE_SPINLOCK(boot_events_lock);
+
+static struct boot_stats bl_stats;
+static u32 sync_mpm;
+static u64 sync_ns;
+
+/* Driver probes that take at least this long are added to the timeline */
+static unsigned int probe_threshold_us = 5000;
+module_param(probe_threshold_us, uint, S_IRUGO | S_IWUSR);
+
+static void boot_stats_add(u64 ns, u32 duration_us, const char *name)
+{
+	struct boot_event *ev;
+	unsigned long flags;
+
+	spin_lock_irqsave(&boot_events_lock, flags);
+	if (boot_events_nr < BOOT_STATS_MAX_EVENTS) {
+		ev = &boot_events[boot_events_nr++];
+		ev->ns = ns;
+		ev->duration_us = duration_us;
+		strlcpy(ev->name, name, sizeof(ev->name));
+	}
+	spin_unlock_irqrestore(&boot_events_lock, flags);
+}
+
+void boot_stats_mark(const char *fmt, ...)
+{
+	char name[BOOT_STATS_NAME_LEN];
+	u64 ns = local_clock();
+	va_list args;
+
+	va_start(args, fmt);
+	vsnprintf(name, sizeof(name), fmt, args);
+	va_end(args);
+
+	boot_stats_add(ns, 0, name);
+}
+
+u64 boot_stats_probe_start(void)
+{
+	return local_clock();
+}
+
+void boot_stats_probe(struct device *dev, u64 start, int ret)
+{
+	char name[BOOT_STATS_NAME_LEN];
+	u64 us = div_u64(local_clock() - start, NSEC_PER_USEC);
+
+	if (us < ACCESS_ONCE(probe_threshold_us))
+		return;
+
+	snprintf(name, sizeof(name), "probe %s %s%s",
+		 dev->driver ? dev->driver->name : "?", dev_name(dev),
+		 ret == -EPROBE_DEFER ? " (deferred)" :
+		 ret ? " (failed)" : "");
+	boot_stats_add(start, min_t(u64, us, U32_MAX), name);
+}
+
 static int mpm_parse_dt(void)
 {
 	struct device_node *np;
@@ -90,6 +170,77 @@ static void print_boot_stats(void)
 		mpm_counter_freq);
 }
 
+static u32 ns_to_mpm(u64 ns)
+{
+	s64 delta = (s64)(ns - sync_ns);
+
+	return sync_mpm + (s32)div_s64(delta * mpm_counter_freq, NSEC_PER_SEC);
+}
+
+static void boot_stats_show_row(struct seq_file *m, u32 count,
+				u32 duration_us, const char *name)
+{
+	u64 ms = div_u64((u64)count * MSEC_PER_SEC, mpm_counter_freq);
+	u32 rem;
+	u64 sec = div_u64_rem(ms, MSEC_PER_SEC, &rem);
+
+	seq_printf(m, "%10u %8llu.%03u %10u  %s\n", count, sec, rem,
+		   duration_us, name);
+}
+
+static int boot_stats_show(struct seq_file *m, void *unused)
+{
+	unsigned int i, nr;
+
+	/* boot_stats_init() did not find the MPM counter */
+	if (!sync_ns)
+		return -ENODEV;
+
+	seq_printf(m, "%10s %12s %10s  %s\n", "mpm_count", "time_s",
+		   "dur_us", "event");
+	boot_stats_show_row(m, bl_stats.bootloader_start, 0,
+			    "bootloader start");
+	boot_stats_show_row(m, bl_stats.bootloader_display, 0,
+			    "bootloader display");
+	boot_stats_show_row(m, bl_stats.bootloader_load_kernel, 0,
+			    "bootloader load kernel");
+	boot_stats_show_row(m, bl_stats.bootloader_end, 0,
+			    "bootloader end");
+	boot_stats_show_row(m, ns_to_mpm(0), 0, "kernel start");
+
+	spin_lock_irq(&boot_events_lock);
+	nr = boot_events_nr;
+	spin_unlock_irq(&boot_events_lock);
+
+	/* Entries below nr are never rewritten */
+	for (i = 0; i < nr; i++)
+		boot_stats_show_row(m, ns_to_mpm(boot_events[i].ns),
+				    boot_events[i].duration_us,
+				    boot_events[i].name);
+
+	return 0;
+}
+
+static int boot_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, boot_stats_show, NULL);
+}
+
+static const struct file_operations boot_stats_fops = {
+	.open		= boot_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init boot_stats_debugfs_init(void)
+{
+	debugfs_create_file("boot_stats", S_IRUGO, NULL, NULL,
+			    &boot_stats_fops);
+	return 0;
+}
+late_initcall(boot_stats_debugfs_init);
+
 int boot_stats_init(void)
 {
 	int ret;
@@ -100,6 +251,15 @@ int boot_stats_init(void)
 
 	print_boot_stats();
 
+	bl_stats.bootloader_start = readl_relaxed(&boot_stats->bootloader_start);
+	bl_stats.bootloader_end = readl_relaxed(&boot_stats->bootloader_end);
+	bl_stats.bootloader_display =
+		readl_relaxed(&boot_stats->bootloader_display);
+	bl_stats.bootloader_load_kernel =
+		readl_relaxed(&boot_stats->bootloader_load_kernel);
+	sync_ns = local_clock();
+	sync_mpm = readl_relaxed(mpm_counter_base);
+
 	iounmap(boot_stats);
 	iounmap(mpm_counter_base);
 
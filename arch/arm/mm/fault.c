@@ -268,6 +268,9 @@ do_page_fault(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 {
 	struct task_struct *tsk;
 	struct mm_struct *mm;
+#ifdef CONFIG_PER_VMA_LOCK
+	struct vm_area_struct *vma;
+#endif
 	int fault, sig, code;
 	unsigned int flags = FAULT_FLAG_ALLOW_RETRY | FAULT_FLAG_KILLABLE;
 
@@ -293,6 +296,48 @@ do_page_fault(unsigned long addr, unsigned int fsr, struct pt_regs *regs)
 	if (fsr & FSR_WRITE)
 		flags |= FAULT_FLAG_WRITE;
 
+#ifdef CONFIG_PER_VMA_LOCK
+	if (!user_mode(regs))
+		goto lock_mmap;
+
+	vma = lock_vma_under_rcu(mm, addr);
+	if (!vma)
+		goto lock_mmap;
+	if (access_error(fsr, vma)) {
+		vma_end_read(vma);
+		goto lock_mmap;
+	}
+
+	/*
+	 * Without mmap_sem there is nothing to drop while waiting on a
+	 * locked page, so such faults are redone under mmap_sem instead.
+	 */
+	fault = handle_mm_fault(mm, vma, addr & PAGE_MASK,
+				flags | FAULT_FLAG_RETRY_NOWAIT);
+	vma_end_read(vma);
+
+	if (!(fault & VM_FAULT_RETRY)) {
+		count_vm_event(VMA_LOCK_SUCCESS);
+		perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS, 1, regs, addr);
+		if (!(fault & VM_FAULT_ERROR)) {
+			if (fault & VM_FAULT_MAJOR) {
+				tsk->maj_flt++;
+				perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MAJ, 1,
+					      regs, addr);
+			} else {
+				tsk->min_flt++;
+				perf_sw_event(PERF_COUNT_SW_PAGE_FAULTS_MIN, 1,
+					      regs, addr);
+			}
+		}
+		goto done;
+	}
+	count_vm_event(VMA_LOCK_RETRY);
+	if (fatal_signal_pending(current))
+		return 0;
+lock_mmap:
+#endif
+
 	/*
 	 * As per x86, we may deadlock here.  However, since the kernel only
 	 * validly references user space from well defined areas of the code,
@@ -353,6 +398,9 @@ retry:
 	}
 
 	up_read(&mm->mmap_sem);
+#ifdef CONFIG_PER_VMA_LOCK
+done:
+#endif
 
 	/*
 	 * Handle the "normal" case first - VM_FAULT_MAJOR / VM_FAULT_MINOR
@@ -66,6 +66,8 @@
 					   overrides the coredump filter bits */
 #define MADV_DODUMP	70		/* Clear the MADV_NODUMP flag */
 
+#define MADV_WILLNEED_ASYNC 64		/* MADV_WILLNEED without waiting */
+
 /* compatibility flags */
 #define MAP_FILE	0
 #define MAP_VARIABLE	0
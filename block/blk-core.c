@@ -1364,6 +1364,7 @@ void __blk_put_request(struct request_queue *q, struct request *req)
 	blk_pm_put_request(req);
 
 	elv_completed_request(q, req);
+	blk_wbt_done(req);
 
 	/* this is a bio leak if the bio is not tagged with BIO_DONTFREE */
 	WARN_ON(req->bio && !bio_flagged(req->bio, BIO_DONTFREE));
@@ -1556,6 +1557,7 @@ void blk_queue_bio(struct request_queue *q, struct bio *bio)
 	int el_ret, rw_flags, where = ELEVATOR_INSERT_SORT;
 	struct request *req;
 	unsigned int request_count = 0;
+	bool wb_tracked;
 
 	/*
 	 * low level driver can indicate that it wants pages above a
@@ -1611,12 +1613,19 @@ get_rq:
 	if (sync)
 		rw_flags |= REQ_SYNC;
 
+	/*
+	 * Background writeback waits here while the queue already holds
+	 * as many writes as the read latency seen on it allows.
+	 */
+	wb_tracked = blk_wbt_wait(q, bio);
+
 	/*
 	 * Grab a free request. This is might sleep but can not fail.
 	 * Returns with the queue unlocked.
 	 */
 	req = get_request(q, rw_flags, bio, GFP_NOIO);
 	if (unlikely(!req)) {
+		blk_wbt_abort(q, wb_tracked);
 		bio_endio(bio, -ENODEV);	/* @q is dead */
 		goto out_unlock;
 	}
@@ -1628,6 +1637,7 @@ get_rq:
 	 * often, and the elevators are able to handle it.
 	 */
 	init_request_from_bio(req, bio);
+	blk_wbt_track(req, wb_tracked);
 
 	if (test_bit(QUEUE_FLAG_SAME_COMP, &q->queue_flags))
 		req->cpu = raw_smp_processor_id();
@@ -2291,6 +2301,8 @@ void blk_dequeue_request(struct request *rq)
 		q->in_flight[rq_is_sync(rq)]++;
 		set_io_start_time_ns(rq);
 	}
+	blk_io_hist_dispatch(rq);
+	blk_wbt_issue(rq);
 }
 
 /**
@@ -2536,7 +2548,7 @@ static void blk_finish_request(struct request *req, int error)
 
 	BUG_ON(blk_queued_rq(req));
 
-	if (unlikely(laptop_mode) && req->cmd_type == REQ_TYPE_FS)
+	if (unlikely(writeback_batching()) && req->cmd_type == REQ_TYPE_FS)
 		laptop_io_completion(&req->q->backing_dev_info);
 
 	blk_delete_timer(req);
@@ -2546,6 +2558,7 @@ static void blk_finish_request(struct request *req, int error)
 
 
 	blk_account_io_done(req);
+	blk_io_hist_done(req);
 
 	if (req->end_io)
 		req->end_io(req, error);
@@ -0,0 +1,150 @@
+/*
+ * Per request queue I/O latency histograms.
+ *
+ * Queue time (insert to dispatch) and service time (dispatch to
+ * completion) are counted in log2 usec buckets, split by operation and
+ * by sync/async.  Buckets are per-CPU and only summed when read through
+ * sysfs, so the completion path does a single per-CPU increment.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/percpu.h>
+#include <linux/ktime.h>
+
+#include "blk.h"
+
+static const char *const blk_io_hist_op_names[BLK_IO_HIST_OPS] = {
+	"read", "write", "discard", "flush",
+};
+
+static int blk_io_hist_op(struct request *rq)
+{
+	if (rq->cmd_flags & (REQ_FLUSH | REQ_FLUSH_SEQ))
+		return BLK_IO_HIST_FLUSH;
+	if (rq->cmd_flags & REQ_DISCARD)
+		return BLK_IO_HIST_DISCARD;
+	return rq_data_dir(rq) == READ ? BLK_IO_HIST_READ : BLK_IO_HIST_WRITE;
+}
+
+/* Bucket 0 is below 1us, bucket n covers [2^(n-1), 2^n) usec */
+static int blk_io_hist_bucket(u64 delta_ns)
+{
+	u64 us = delta_ns;
+
+	do_div(us, NSEC_PER_USEC);
+	if (us >> 32)
+		return BLK_IO_HIST_BUCKETS - 1;
+
+	return min_t(int, fls((u32)us), BLK_IO_HIST_BUCKETS - 1);
+}
+
+void __blk_io_hist_done(struct request *rq)
+{
+	struct request_queue *q = rq->q;
+	int op, sync;
+	u64 now;
+
+	if (!rq->io_hist_dispatch_ns)
+		return;
+
+	now = ktime_to_ns(ktime_get());
+	op = blk_io_hist_op(rq);
+	sync = rq_is_sync(rq) ? 1 : 0;
+
+	if (rq->io_hist_insert_ns &&
+	    rq->io_hist_dispatch_ns >= rq->io_hist_insert_ns)
+		this_cpu_inc(q->io_hist->count[BLK_IO_HIST_QUEUE][op][sync]
+			[blk_io_hist_bucket(rq->io_hist_dispatch_ns -
+					    rq->io_hist_insert_ns)]);
+	if (now >= rq->io_hist_dispatch_ns)
+		this_cpu_inc(q->io_hist->count[BLK_IO_HIST_SERVICE][op][sync]
+			[blk_io_hist_bucket(now - rq->io_hist_dispatch_ns)]);
+}
+
+static ssize_t blk_io_hist_show(struct request_queue *q, char *page,
+				int stage)
+{
+	ssize_t len = 0;
+	int op, sync, b, cpu;
+
+	if (!q->io_hist)
+		return 0;
+
+	for (op = 0; op < BLK_IO_HIST_OPS; op++) {
+		for (sync = 1; sync >= 0; sync--) {
+			len += scnprintf(page + len, PAGE_SIZE - len, "%s %s",
+					 blk_io_hist_op_names[op],
+					 sync ? "sync" : "async");
+			for (b = 0; b < BLK_IO_HIST_BUCKETS; b++) {
+				unsigned int sum = 0;
+
+				for_each_possible_cpu(cpu)
+					sum += per_cpu_ptr(q->io_hist, cpu)->
+						count[stage][op][sync][b];
+				len += scnprintf(page + len, PAGE_SIZE - len,
+						 " %u", sum);
+			}
+			len += scnprintf(page + len, PAGE_SIZE - len, "\n");
+		}
+	}
+
+	return len;
+}
+
+ssize_t queue_io_hist_queue_show(struct request_queue *q, char *page)
+{
+	return blk_io_hist_show(q, page, BLK_IO_HIST_QUEUE);
+}
+
+ssize_t queue_io_hist_service_show(struct request_queue *q, char *page)
+{
+	return blk_io_hist_show(q, page, BLK_IO_HIST_SERVICE);
+}
+
+ssize_t queue_io_hist_show(struct request_queue *q, char *page)
+{
+	return sprintf(page, "%d\n", q->io_hist_enabled);
+}
+
+/*
+ * Writing 1 clears the histograms and starts counting, 0 stops counting.
+ * The buckets are allocated on first enable and kept until the queue is
+ * released, so a completion racing with a disable never sees them go.
+ */
+ssize_t queue_io_hist_store(struct request_queue *q, const char *page,
+			    size_t count)
+{
+	unsigned long val;
+	int cpu, err;
+
+	err = kstrtoul(page, 10, &val);
+	if (err)
+		return err;
+
+	if (!val) {
+		q->io_hist_enabled = false;
+		return count;
+	}
+
+	if (!q->io_hist) {
+		q->io_hist = alloc_percpu(struct blk_io_hist);
+		if (!q->io_hist)
+			return -ENOMEM;
+	} else {
+		q->io_hist_enabled = false;
+		for_each_possible_cpu(cpu)
+			memset(per_cpu_ptr(q->io_hist, cpu), 0,
+			       sizeof(struct blk_io_hist));
+	}
+
+	smp_wmb();
+	q->io_hist_enabled = true;
+	return count;
+}
+
+void blk_io_hist_exit(struct request_queue *q)
+{
+	q->io_hist_enabled = false;
+	free_percpu(q->io_hist);
+	q->io_hist = NULL;
+}
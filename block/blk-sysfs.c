@@ -429,6 +429,32 @@ static struct queue_sysfs_entry queue_random_entry = {
 	.store = queue_store_random,
 };
 
+#ifdef CONFIG_BLK_DEV_IO_HIST
+static struct queue_sysfs_entry queue_io_hist_entry = {
+	.attr = {.name = "io_hist", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_io_hist_show,
+	.store = queue_io_hist_store,
+};
+
+static struct queue_sysfs_entry queue_io_hist_queue_entry = {
+	.attr = {.name = "io_hist_queue", .mode = S_IRUGO },
+	.show = queue_io_hist_queue_show,
+};
+
+static struct queue_sysfs_entry queue_io_hist_service_entry = {
+	.attr = {.name = "io_hist_service", .mode = S_IRUGO },
+	.show = queue_io_hist_service_show,
+};
+#endif
+
+#ifdef CONFIG_BLK_WBT
+static struct queue_sysfs_entry queue_wbt_lat_entry = {
+	.attr = {.name = "wbt_lat_usec", .mode = S_IRUGO | S_IWUSR },
+	.show = queue_wbt_lat_show,
+	.store = queue_wbt_lat_store,
+};
+#endif
+
 static struct attribute *default_attrs[] = {
 	&queue_requests_entry.attr,
 	&queue_ra_entry.attr,
@@ -452,6 +478,14 @@ static struct attribute *default_attrs[] = {
 	&queue_rq_affinity_entry.attr,
 	&queue_iostats_entry.attr,
 	&queue_random_entry.attr,
+#ifdef CONFIG_BLK_DEV_IO_HIST
+	&queue_io_hist_entry.attr,
+	&queue_io_hist_queue_entry.attr,
+	&queue_io_hist_service_entry.attr,
+#endif
+#ifdef CONFIG_BLK_WBT
+	&queue_wbt_lat_entry.attr,
+#endif
 	NULL,
 };
 
@@ -529,6 +563,8 @@ static void blk_release_queue(struct kobject *kobj)
 	blk_sync_queue(q);
 
 	blkcg_exit_queue(q);
+	blk_io_hist_exit(q);
+	blk_wbt_exit(q);
 
 	if (q->elevator) {
 		spin_lock_irq(q->queue_lock);
@@ -591,6 +627,8 @@ int blk_register_queue(struct gendisk *disk)
 	if (!q->request_fn)
 		return 0;
 
+	blk_wbt_init(q);
+
 	ret = elv_register_queue(q);
 	if (ret) {
 		kobject_uevent(&q->kobj, KOBJ_REMOVE);
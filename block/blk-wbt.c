@@ -0,0 +1,245 @@
+/*
+ * Writeback throttling.
+ *
+ * Buffered writeback can fill a request queue with large async writes,
+ * and sync reads then wait behind them no matter how the I/O scheduler
+ * orders its queue.  The number of background writes a queue may hold is
+ * limited instead, and scaled from the latency of the reads completing on
+ * it: every window the fastest read is compared against a target, the
+ * allowed write depth is halved while reads stay slower than that and
+ * doubled back once they are not.  Like CoDel, looking at the minimum
+ * keeps a single slow read from throttling the writes.
+ *
+ * All state is protected by the queue lock, which the submission,
+ * dispatch and completion paths of a request based queue already hold.
+ */
+#include <linux/kernel.h>
+#include <linux/blkdev.h>
+#include <linux/ktime.h>
+#include <linux/slab.h>
+#include <linux/swap.h>
+#include <linux/wait.h>
+
+#include "blk.h"
+
+#define WBT_DEFAULT_LAT_NONROT	(2 * NSEC_PER_MSEC)
+#define WBT_DEFAULT_LAT_ROT	(75 * NSEC_PER_MSEC)
+#define WBT_WINDOW_NSEC		(100 * NSEC_PER_MSEC)
+#define WBT_MAX_STEP		16
+
+struct rq_wb {
+	struct request_queue *q;
+	u64 min_lat_nsec;		/* read latency target, 0 disables */
+	int scale_step;			/* write depth is halved per step */
+	unsigned int inflight;		/* tracked writes holding a request */
+	wait_queue_head_t wait;
+	struct timer_list window_timer;
+
+	/* the current window */
+	unsigned int nr_reads;
+	unsigned int nr_writes;
+	u64 min_read_nsec;
+};
+
+/* Writes a queue may hold at the current step, at least one */
+static unsigned int wbt_depth(struct rq_wb *rwb)
+{
+	unsigned int depth = max(rwb->q->nr_requests / 2, 1UL);
+
+	return max(depth >> rwb->scale_step, 1U);
+}
+
+/* Shorter windows at higher steps so that throttling reacts faster */
+static unsigned long wbt_window(struct rq_wb *rwb)
+{
+	u64 win = div_u64((u64)WBT_WINDOW_NSEC << 4,
+			  int_sqrt((rwb->scale_step + 1) << 8));
+
+	return max(nsecs_to_jiffies(win), 1UL);
+}
+
+static void wbt_arm_window(struct rq_wb *rwb)
+{
+	if (!timer_pending(&rwb->window_timer))
+		mod_timer(&rwb->window_timer, jiffies + wbt_window(rwb));
+}
+
+static bool wbt_enabled(struct rq_wb *rwb)
+{
+	return rwb->min_lat_nsec != 0;
+}
+
+static void wbt_window_fn(unsigned long data)
+{
+	struct rq_wb *rwb = (struct rq_wb *)data;
+	struct request_queue *q = rwb->q;
+	unsigned long flags;
+	int step;
+
+	spin_lock_irqsave(q->queue_lock, flags);
+	step = rwb->scale_step;
+	if (rwb->nr_reads && rwb->min_read_nsec > rwb->min_lat_nsec) {
+		/* some writes must still complete for this to help */
+		if (rwb->inflight && wbt_depth(rwb) > 1 &&
+		    step < WBT_MAX_STEP)
+			rwb->scale_step++;
+	} else if (rwb->scale_step > 0) {
+		rwb->scale_step--;
+	}
+
+	if (rwb->scale_step < step)
+		wake_up_all(&rwb->wait);
+
+	rwb->nr_reads = rwb->nr_writes = 0;
+	rwb->min_read_nsec = 0;
+	if (wbt_enabled(rwb) && (rwb->scale_step || rwb->inflight))
+		wbt_arm_window(rwb);
+	spin_unlock_irqrestore(q->queue_lock, flags);
+}
+
+/* Background writeback only; sync writes and reclaim are never held */
+static bool wbt_should_throttle(struct bio *bio)
+{
+	if (bio_data_dir(bio) != WRITE)
+		return false;
+	if (bio->bi_rw & (REQ_SYNC | REQ_META | REQ_PRIO | REQ_FLUSH |
+			  REQ_FUA | REQ_DISCARD))
+		return false;
+
+	return !current_is_kswapd();
+}
+
+static bool wbt_may_queue(struct rq_wb *rwb)
+{
+	return !wbt_enabled(rwb) || rwb->inflight < wbt_depth(rwb);
+}
+
+/*
+ * Called from blk_queue_bio() with the queue lock held, before a request
+ * is allocated for @bio.  Sleeps with the lock dropped while the queue
+ * holds as many background writes as the current step allows.  Returns
+ * true if the request for @bio has to be accounted as throttled.
+ */
+bool __blk_wbt_wait(struct request_queue *q, struct bio *bio)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	DEFINE_WAIT(wait);
+
+	if (!wbt_enabled(rwb) || !wbt_should_throttle(bio))
+		return false;
+
+	wbt_arm_window(rwb);
+	while (!wbt_may_queue(rwb)) {
+		prepare_to_wait_exclusive(&rwb->wait, &wait,
+					  TASK_UNINTERRUPTIBLE);
+		if (wbt_may_queue(rwb))
+			break;
+		spin_unlock_irq(q->queue_lock);
+		io_schedule();
+		spin_lock_irq(q->queue_lock);
+	}
+	finish_wait(&rwb->wait, &wait);
+
+	rwb->inflight++;
+	return true;
+}
+
+static void wbt_dec_inflight(struct rq_wb *rwb)
+{
+	rwb->inflight--;
+	if (waitqueue_active(&rwb->wait) && wbt_may_queue(rwb))
+		wake_up(&rwb->wait);
+}
+
+/* The request for a throttled bio could not be allocated */
+void __blk_wbt_abort(struct request_queue *q)
+{
+	wbt_dec_inflight(q->rq_wb);
+}
+
+/* Called as @rq is freed, with the queue lock held */
+void __blk_wbt_done(struct request *rq)
+{
+	struct rq_wb *rwb = rq->q->rq_wb;
+
+	if (rq->wbt_issue_ns) {
+		u64 lat = ktime_to_ns(ktime_get()) - rq->wbt_issue_ns;
+
+		if (!rwb->nr_reads++ || lat < rwb->min_read_nsec)
+			rwb->min_read_nsec = lat;
+		rq->wbt_issue_ns = 0;
+	}
+
+	if (rq->wbt_tracked) {
+		rq->wbt_tracked = false;
+		rwb->nr_writes++;
+		wbt_dec_inflight(rwb);
+	}
+}
+
+ssize_t queue_wbt_lat_show(struct request_queue *q, char *page)
+{
+	if (!q->rq_wb)
+		return -EINVAL;
+
+	return sprintf(page, "%llu\n",
+		       div_u64(q->rq_wb->min_lat_nsec, NSEC_PER_USEC));
+}
+
+ssize_t queue_wbt_lat_store(struct request_queue *q, const char *page,
+			    size_t count)
+{
+	struct rq_wb *rwb = q->rq_wb;
+	unsigned long long val;
+	int err;
+
+	if (!rwb)
+		return -EINVAL;
+
+	err = kstrtoull(page, 10, &val);
+	if (err)
+		return err;
+
+	spin_lock_irq(q->queue_lock);
+	rwb->min_lat_nsec = val * NSEC_PER_USEC;
+	rwb->scale_step = 0;
+	wake_up_all(&rwb->wait);
+	spin_unlock_irq(q->queue_lock);
+
+	return count;
+}
+
+/* Called when a request based queue is registered */
+void blk_wbt_init(struct request_queue *q)
+{
+	struct rq_wb *rwb;
+
+	if (q->rq_wb)
+		return;
+
+	rwb = kzalloc(sizeof(*rwb), GFP_KERNEL);
+	if (!rwb)
+		return;
+
+	rwb->q = q;
+	rwb->min_lat_nsec = blk_queue_nonrot(q) ? WBT_DEFAULT_LAT_NONROT :
+						  WBT_DEFAULT_LAT_ROT;
+	init_waitqueue_head(&rwb->wait);
+	setup_timer(&rwb->window_timer, wbt_window_fn, (unsigned long)rwb);
+
+	spin_lock_irq(q->queue_lock);
+	q->rq_wb = rwb;
+	spin_unlock_irq(q->queue_lock);
+}
+
+void blk_wbt_exit(struct request_queue *q)
+{
+	struct rq_wb *rwb = q->rq_wb;
+
+	if (!rwb)
+		return;
+
+	del_timer_sync(&rwb->window_timer);
+	q->rq_wb = NULL;
+	kfree(rwb);
+}
@@ -231,4 +231,96 @@ static inline int blk_throtl_init(struct request_queue *q) { return 0; }
 static inline void blk_throtl_exit(struct request_queue *q) { }
 #endif /* CONFIG_BLK_DEV_THROTTLING */
 
+/*
+ * I/O latency histograms
+ */
+#ifdef CONFIG_BLK_DEV_IO_HIST
+extern void __blk_io_hist_done(struct request *rq);
+extern void blk_io_hist_exit(struct request_queue *q);
+extern ssize_t queue_io_hist_show(struct request_queue *q, char *page);
+extern ssize_t queue_io_hist_store(struct request_queue *q, const char *page,
+				   size_t count);
+extern ssize_t queue_io_hist_queue_show(struct request_queue *q, char *page);
+extern ssize_t queue_io_hist_service_show(struct request_queue *q, char *page);
+
+static inline void blk_io_hist_insert(struct request *rq)
+{
+	if (rq->q->io_hist_enabled)
+		rq->io_hist_insert_ns = ktime_to_ns(ktime_get());
+}
+
+static inline void blk_io_hist_dispatch(struct request *rq)
+{
+	if (rq->q->io_hist_enabled)
+		rq->io_hist_dispatch_ns = ktime_to_ns(ktime_get());
+}
+
+static inline void blk_io_hist_done(struct request *rq)
+{
+	if (rq->q->io_hist_enabled) {
+		smp_rmb();
+		__blk_io_hist_done(rq);
+	}
+}
+#else /* CONFIG_BLK_DEV_IO_HIST */
+static inline void blk_io_hist_insert(struct request *rq) { }
+static inline void blk_io_hist_dispatch(struct request *rq) { }
+static inline void blk_io_hist_done(struct request *rq) { }
+static inline void blk_io_hist_exit(struct request_queue *q) { }
+#endif /* CONFIG_BLK_DEV_IO_HIST */
+
+/*
+ * Writeback throttling
+ */
+#ifdef CONFIG_BLK_WBT
+extern bool __blk_wbt_wait(struct request_queue *q, struct bio *bio);
+extern void __blk_wbt_abort(struct request_queue *q);
+extern void __blk_wbt_done(struct request *rq);
+extern void blk_wbt_init(struct request_queue *q);
+extern void blk_wbt_exit(struct request_queue *q);
+extern ssize_t queue_wbt_lat_show(struct request_queue *q, char *page);
+extern ssize_t queue_wbt_lat_store(struct request_queue *q, const char *page,
+				   size_t count);
+
+static inline bool blk_wbt_wait(struct request_queue *q, struct bio *bio)
+{
+	return q->rq_wb && __blk_wbt_wait(q, bio);
+}
+
+static inline void blk_wbt_abort(struct request_queue *q, bool tracked)
+{
+	if (tracked)
+		__blk_wbt_abort(q);
+}
+
+static inline void blk_wbt_track(struct request *rq, bool tracked)
+{
+	rq->wbt_tracked = tracked;
+}
+
+static inline void blk_wbt_issue(struct request *rq)
+{
+	if (rq->q->rq_wb && rq->cmd_type == REQ_TYPE_FS &&
+	    rq_data_dir(rq) == READ)
+		rq->wbt_issue_ns = ktime_to_ns(ktime_get());
+}
+
+static inline void blk_wbt_done(struct request *rq)
+{
+	if (rq->q->rq_wb)
+		__blk_wbt_done(rq);
+}
+#else /* CONFIG_BLK_WBT */
+static inline bool blk_wbt_wait(struct request_queue *q, struct bio *bio)
+{
+	return false;
+}
+static inline void blk_wbt_abort(struct request_queue *q, bool tracked) { }
+static inline void blk_wbt_track(struct request *rq, bool tracked) { }
+static inline void blk_wbt_issue(struct request *rq) { }
+static inline void blk_wbt_done(struct request *rq) { }
+static inline void blk_wbt_init(struct request_queue *q) { }
+static inline void blk_wbt_exit(struct request_queue *q) { }
+#endif /* CONFIG_BLK_WBT */
+
 #endif /* BLK_INTERNAL_H */
@@ -632,6 +632,7 @@ void __elv_add_request(struct request_queue *q, struct request *rq, int where)
 	blk_pm_add_request(q, rq);
 
 	rq->q = q;
+	blk_io_hist_insert(rq);
 
 	if (rq->cmd_flags & REQ_SOFTBARRIER) {
 		/* barriers are scheduling boundary, update end_sector */
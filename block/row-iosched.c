@@ -111,6 +111,29 @@ struct rowq_idling_data {
 	bool			begin_idling;
 };
 
+/*
+ * Latency target mode: when a read latency target is set for a priority
+ * class, the p95 of insert-to-completion latency of that class's read
+ * queue is tracked and, every ROW_LAT_ADAPT_SAMPLES completions, the read
+ * quantum and the idling window are adapted to it.
+ */
+#define ROW_LAT_ADAPT_SAMPLES		32
+#define ROW_LAT_MAX_QUANTUM_SCALE	8
+#define ROW_LAT_MIN_STEP_US		20
+
+/**
+ * struct rowq_lat_data - latency target data for a read queue
+ * @target_ms:		p95 read latency target (msec), 0 if disabled
+ * @p95_us:		running p95 estimate of read latency (usec)
+ * @nr_samples:		completions since the last adaptation
+ *
+ */
+struct rowq_lat_data {
+	int			target_ms;
+	u32			p95_us;
+	unsigned int		nr_samples;
+};
+
 /**
  * struct row_queue - requests grouping structure
  * @rdata:		parent row_data structure
@@ -122,6 +145,7 @@ struct rowq_idling_data {
  * @dispatch quantum:	number of requests this queue may
  *			dispatch in a dispatch cycle
  * @idle_data:		data for idling on queues
+ * @lat_data:		data for the latency target mode
  *
  */
 struct row_queue {
@@ -136,6 +160,7 @@ struct row_queue {
 
 	/* used only for READ queues */
 	struct rowq_idling_data	idle_data;
+	struct rowq_lat_data	lat_data;
 };
 
 /**
@@ -209,6 +234,8 @@ struct row_data {
 };
 
 #define RQ_ROWQ(rq) ((struct row_queue *) ((rq)->elv.priv[0]))
+/* Insertion time in usec, truncated to 32 bits; only deltas are used */
+#define RQ_INSERT_US(rq) ((u32)(unsigned long)((rq)->elv.priv[1]))
 
 #define row_log(q, fmt, args...)   \
 	blk_add_trace_msg(q, "%s():" fmt , __func__, ##args)
@@ -340,6 +367,7 @@ static void row_add_request(struct request_queue *q,
 	rd->nr_reqs[rq_data_dir(rq)]++;
 	rqueue->nr_req++;
 	rq_set_fifo_time(rq, jiffies); /* for statistics*/
+	rq->elv.priv[1] = (void *)(unsigned long)(u32)ktime_to_us(ktime_get());
 
 	if (rq->cmd_flags & REQ_URGENT) {
 		WARN_ON(1);
@@ -455,9 +483,69 @@ static int row_reinsert_req(struct request_queue *q,
 	return 0;
 }
 
+/*
+ * row_lat_update() - Account a read completion in the latency target mode
+ * @rd:		pointer to struct row_data
+ * @rqueue:	read queue the request was dispatched from
+ * @lat_us:	insert-to-completion latency of the request (usec)
+ *
+ * The p95 is estimated by moving it up by 95% of a step when a sample is
+ * above it and down by 5% of a step otherwise, which settles where 5% of
+ * the samples are above the estimate.  Over target, the read quantum is
+ * doubled so fewer writes of the class get in between reads, and the
+ * idling window is stretched up to half of the target.  Well under
+ * target, both go back towards their defaults.
+ */
+static void row_lat_update(struct row_data *rd, struct row_queue *rqueue,
+			   u32 lat_us)
+{
+	struct rowq_lat_data *lat = &rqueue->lat_data;
+	int def_quantum = row_queues_def[rqueue->prio].quantum;
+	u32 target_us, step;
+
+	if (!lat->target_ms)
+		return;
+
+	if (!lat->p95_us) {
+		lat->p95_us = lat_us;
+	} else {
+		step = max_t(u32, lat->p95_us >> 4, ROW_LAT_MIN_STEP_US);
+		if (lat_us > lat->p95_us)
+			lat->p95_us += step - step / 20;
+		else
+			lat->p95_us -= min(step / 20, lat->p95_us - 1);
+	}
+
+	if (++lat->nr_samples < ROW_LAT_ADAPT_SAMPLES)
+		return;
+	lat->nr_samples = 0;
+
+	target_us = lat->target_ms * USEC_PER_MSEC;
+	if (lat->p95_us > target_us) {
+		rqueue->disp_quantum = min(rqueue->disp_quantum * 2,
+				def_quantum * ROW_LAT_MAX_QUANTUM_SCALE);
+		if (rd->rd_idle_data.idle_time_ms <
+		    max(lat->target_ms / 2, ROW_IDLE_TIME_MSEC))
+			rd->rd_idle_data.idle_time_ms++;
+	} else if (lat->p95_us < target_us / 2) {
+		rqueue->disp_quantum = max(rqueue->disp_quantum -
+				rqueue->disp_quantum / 4, def_quantum);
+		if (rd->rd_idle_data.idle_time_ms > ROW_IDLE_TIME_MSEC)
+			rd->rd_idle_data.idle_time_ms--;
+	}
+	row_log_rowq(rd, rqueue->prio, "p95=%uus quantum=%d idle=%dms",
+		lat->p95_us, rqueue->disp_quantum,
+		(int)rd->rd_idle_data.idle_time_ms);
+}
+
 static void row_completed_req(struct request_queue *q, struct request *rq)
 {
 	struct row_data *rd = q->elevator->elevator_data;
+	struct row_queue *rqueue = RQ_ROWQ(rq);
+
+	if (rqueue && rq_data_dir(rq) == READ)
+		row_lat_update(rd, rqueue,
+			(u32)ktime_to_us(ktime_get()) - RQ_INSERT_US(rq));
 
 	 if (rq->cmd_flags & REQ_URGENT) {
 		if (!rd->urgent_in_flight) {
@@ -992,6 +1080,14 @@ SHOW_FUNCTION(row_reg_starv_limit_show,
 	rowd->reg_prio_starvation.starvation_limit);
 SHOW_FUNCTION(row_low_starv_limit_show,
 	rowd->low_prio_starvation.starvation_limit);
+SHOW_FUNCTION(row_hp_read_target_show,
+	rowd->row_queues[ROWQ_PRIO_HIGH_READ].lat_data.target_ms);
+SHOW_FUNCTION(row_rp_read_target_show,
+	rowd->row_queues[ROWQ_PRIO_REG_READ].lat_data.target_ms);
+SHOW_FUNCTION(row_hp_read_p95_show,
+	rowd->row_queues[ROWQ_PRIO_HIGH_READ].lat_data.p95_us);
+SHOW_FUNCTION(row_rp_read_p95_show,
+	rowd->row_queues[ROWQ_PRIO_REG_READ].lat_data.p95_us);
 #undef SHOW_FUNCTION
 
 #define STORE_FUNCTION(__FUNC, __PTR, MIN, MAX)			\
@@ -1038,6 +1134,12 @@ STORE_FUNCTION(row_reg_starv_limit_store,
 STORE_FUNCTION(row_low_starv_limit_store,
 			&rowd->low_prio_starvation.starvation_limit,
 			1, INT_MAX);
+STORE_FUNCTION(row_hp_read_target_store,
+			&rowd->row_queues[ROWQ_PRIO_HIGH_READ].lat_data.target_ms,
+			0, INT_MAX / USEC_PER_MSEC);
+STORE_FUNCTION(row_rp_read_target_store,
+			&rowd->row_queues[ROWQ_PRIO_REG_READ].lat_data.target_ms,
+			0, INT_MAX / USEC_PER_MSEC);
 
 #undef STORE_FUNCTION
 
@@ -1057,6 +1159,10 @@ static struct elv_fs_entry row_attrs[] = {
 	ROW_ATTR(rd_idle_data_freq),
 	ROW_ATTR(reg_starv_limit),
 	ROW_ATTR(low_starv_limit),
+	ROW_ATTR(hp_read_target),
+	ROW_ATTR(rp_read_target),
+	__ATTR(hp_read_p95, S_IRUGO, row_hp_read_p95_show, NULL),
+	__ATTR(rp_read_p95, S_IRUGO, row_rp_read_p95_show, NULL),
 	__ATTR_NULL
 };
 
@@ -25,6 +25,7 @@
 #include <linux/async.h>
 #include <linux/pm_runtime.h>
 #include <linux/pinctrl/devinfo.h>
+#include <soc/qcom/boot_stats.h>
 
 #include "base.h"
 #include "power/power.h"
@@ -302,6 +303,7 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 {
 	int ret = 0;
 	int local_trigger_count = atomic_read(&deferred_trigger_count);
+	u64 probe_start;
 
 	atomic_inc(&probe_count);
 	pr_debug("bus: '%s': %s: probing driver %s with device %s\n",
@@ -321,15 +323,14 @@ static int really_probe(struct device *dev, struct device_driver *drv)
 		goto probe_failed;
 	}
 
-	if (dev->bus->probe) {
+	probe_start = boot_stats_probe_start();
+	if (dev->bus->probe)
 		ret = dev->bus->probe(dev);
-		if (ret)
-			goto probe_failed;
-	} else if (drv->probe) {
+	else if (drv->probe)
 		ret = drv->probe(dev);
-		if (ret)
-			goto probe_failed;
-	}
+	boot_stats_probe(dev, probe_start, ret);
+	if (ret)
+		goto probe_failed;
 
 	driver_bound(dev);
 	ret = 1;
@@ -520,6 +521,30 @@ int driver_attach(struct device_driver *drv)
 }
 EXPORT_SYMBOL_GPL(driver_attach);
 
+static ASYNC_DOMAIN(async_probe_domain);
+
+static void __driver_attach_async(void *data, async_cookie_t cookie)
+{
+	struct device_driver *drv = data;
+
+	driver_attach(drv);
+	pr_debug("bus: '%s': async probe of driver %s done\n",
+		 drv->bus->name, drv->name);
+}
+
+/**
+ * driver_attach_async - bind a driver to devices from an async domain.
+ * @drv: driver.
+ *
+ * Used by bus_add_driver() for PROBE_PREFER_ASYNCHRONOUS drivers. The
+ * domain takes part in async_synchronize_full(), so wait_for_device_probe()
+ * and kernel_init() wait for these probes before userspace runs.
+ */
+void driver_attach_async(struct device_driver *drv)
+{
+	async_schedule_domain(__driver_attach_async, drv, &async_probe_domain);
+}
+
 /*
  * __device_release_driver() must be called with @dev lock held.
  * When called for a USB interface, @dev->parent lock must be held as well.
@@ -586,6 +611,9 @@ void driver_detach(struct device_driver *drv)
 	struct device_private *dev_prv;
 	struct device *dev;
 
+	if (drv->probe_type == PROBE_PREFER_ASYNCHRONOUS)
+		async_synchronize_full_domain(&async_probe_domain);
+
 	for (;;) {
 		spin_lock(&drv->p->klist_devices.k_lock);
 		if (list_empty(&drv->p->klist_devices.k_list)) {
@@ -29,6 +29,7 @@
 #include <linux/export.h>
 #include <linux/debugfs.h>
 #include <linux/seq_file.h>
+#include <linux/sync.h>
 
 static inline int is_dma_buf_file(struct file *);
 
@@ -50,6 +51,11 @@ static int dma_buf_release(struct inode *inode, struct file *file)
 
 	BUG_ON(dmabuf->vmapping_counter);
 
+#ifdef CONFIG_SYNC
+	if (dmabuf->fence)
+		sync_fence_put(dmabuf->fence);
+#endif
+
 	dmabuf->ops->release(dmabuf);
 
 	mutex_lock(&db_list.lock);
@@ -330,6 +336,69 @@ void dma_buf_unmap_attachment(struct dma_buf_attachment *attach,
 }
 EXPORT_SYMBOL_GPL(dma_buf_unmap_attachment);
 
+#ifdef CONFIG_SYNC
+/**
+ * dma_buf_attach_fence - Attach the fence of a pending write to the buffer
+ * @dmabuf:	[in]	buffer being written.
+ * @fence:	[in]	fence signaled once the write has completed, or NULL.
+ *
+ * Replaces any fence attached before, so that consumers importing the buffer
+ * can wait for the last producer without the fence fd being passed along
+ * by userspace. The buffer keeps its own reference on @fence.
+ */
+void dma_buf_attach_fence(struct dma_buf *dmabuf, struct sync_fence *fence)
+{
+	struct sync_fence *old;
+
+	if (WARN_ON(!dmabuf))
+		return;
+
+	if (fence)
+		get_file(fence->file);
+
+	mutex_lock(&dmabuf->lock);
+	old = dmabuf->fence;
+	dmabuf->fence = fence;
+	mutex_unlock(&dmabuf->lock);
+
+	if (old)
+		sync_fence_put(old);
+}
+EXPORT_SYMBOL_GPL(dma_buf_attach_fence);
+
+/**
+ * dma_buf_get_fence - Get the fence attached to the buffer
+ * @dmabuf:	[in]	buffer about to be read.
+ *
+ * Returns the fence of the last write to the buffer with a reference the
+ * caller must drop with sync_fence_put(), or NULL if there is no write
+ * pending. A fence found signaled is dropped from the buffer.
+ */
+struct sync_fence *dma_buf_get_fence(struct dma_buf *dmabuf)
+{
+	struct sync_fence *fence, *done = NULL;
+
+	if (WARN_ON(!dmabuf))
+		return NULL;
+
+	mutex_lock(&dmabuf->lock);
+	fence = dmabuf->fence;
+	if (fence && fence->status) {
+		done = fence;
+		fence = dmabuf->fence = NULL;
+	} else if (fence) {
+		get_file(fence->file);
+	}
+	mutex_unlock(&dmabuf->lock);
+
+	if (done)
+		sync_fence_put(done);
+
+	return fence;
+}
+EXPORT_SYMBOL_GPL(dma_buf_get_fence);
+#endif
+
 
 /**
  * dma_buf_begin_cpu_access - Must be called before accessing a dma_buf from the
@@ -39,13 +39,44 @@
 #include <linux/mm_types.h>
 #include <linux/dma-contiguous.h>
 #include <linux/dma-removed.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <trace/events/kmem.h>
 
+/* log2 histogram in ms: bucket 0 counts < 1ms, bucket i [2^(i-1), 2^i) */
+#define CMA_HIST_BUCKETS	12
+#define CMA_NR_RECENT		32
+
+struct cma_alloc_record {
+	ktime_t		when;
+	unsigned long	pfn;		/* allocated pfn, 0 on failure */
+	unsigned long	busy_pfn;	/* first range found busy, if any */
+	int		count;
+	int		tries;
+	int		ret;
+	u32		latency_us;
+};
+
+/* Per-allocation accounting, protected by cma_mutex */
+struct cma_stats {
+	unsigned long	allocs;
+	unsigned long	fails;
+	unsigned long	pages;
+	unsigned long	busy;
+	u64		total_us;
+	u32		max_us;
+	unsigned long	hist[CMA_HIST_BUCKETS];
+	struct cma_alloc_record recent[CMA_NR_RECENT];
+	unsigned int	next;
+};
+
 struct cma {
 	unsigned long	base_pfn;
 	unsigned long	count;
 	unsigned long	*bitmap;
 	bool in_system;
+	struct cma_stats stats;
 };
 
 static DEFINE_MUTEX(cma_mutex);
@@ -182,7 +213,7 @@ static __init struct cma *cma_create_area(unsigned long base_pfn,
 
 	pr_debug("%s(base %08lx, count %lx)\n", __func__, base_pfn, count);
 
-	cma = kmalloc(sizeof *cma, GFP_KERNEL);
+	cma = kzalloc(sizeof *cma, GFP_KERNEL);
 	if (!cma)
 		return ERR_PTR(-ENOMEM);
 
@@ -505,6 +536,27 @@ static int __init cma_init_reserved_areas(void)
 }
 core_initcall(cma_init_reserved_areas);
 
+static void cma_account_alloc(struct cma *cma, struct cma_alloc_record *rec)
+{
+	struct cma_stats *stats = &cma->stats;
+	int i;
+
+	stats->allocs++;
+	if (rec->ret)
+		stats->fails++;
+	else
+		stats->pages += rec->count;
+	stats->busy += rec->tries;
+	stats->total_us += rec->latency_us;
+	stats->max_us = max(stats->max_us, rec->latency_us);
+
+	i = fls(rec->latency_us / USEC_PER_MSEC);
+	stats->hist[min(i, CMA_HIST_BUCKETS - 1)]++;
+
+	stats->recent[stats->next] = *rec;
+	stats->next = (stats->next + 1) % CMA_NR_RECENT;
+}
+
 phys_addr_t cma_get_base(struct device *dev)
 {
 	struct cma *cma = dev_get_cma_area(dev);
@@ -528,6 +580,7 @@ unsigned long dma_alloc_from_contiguous(struct device *dev, int count,
 {
 	unsigned long mask, pfn = 0, pageno, start = 0;
 	struct cma *cma = dev_get_cma_area(dev);
+	struct cma_alloc_record rec = { .count = count };
 	int ret = 0;
 	int tries = 0;
 
@@ -545,13 +598,16 @@ unsigned long dma_alloc_from_contiguous(struct device *dev, int count,
 
 	mask = (1 << align) - 1;
 
+	rec.when = ktime_get();
 	mutex_lock(&cma_mutex);
 
 	for (;;) {
 		pageno = bitmap_find_next_zero_area(cma->bitmap, cma->count,
 						    start, count, mask);
-		if (pageno >= cma->count)
+		if (pageno >= cma->count) {
+			ret = -ENOMEM;
 			break;
+		}
 
 		pfn = cma->base_pfn + pageno;
 		if (cma->in_system)
@@ -564,6 +620,8 @@ unsigned long dma_alloc_from_contiguous(struct device *dev, int count,
 		}
 		tries++;
 		trace_dma_alloc_contiguous_retry(tries);
+		if (!rec.busy_pfn)
+			rec.busy_pfn = pfn;
 
 		pr_debug("%s(): memory range at %p is busy, retrying\n",
 			 __func__, pfn_to_page(pfn));
@@ -571,6 +629,17 @@ unsigned long dma_alloc_from_contiguous(struct device *dev, int count,
 		start = pageno + mask + 1;
 	}
 
+	/* Don't hand out the last range that was tried and found busy */
+	if (ret)
+		pfn = 0;
+
+	rec.pfn = pfn;
+	rec.tries = tries;
+	rec.ret = ret;
+	rec.latency_us = min_t(s64, ktime_us_delta(ktime_get(), rec.when),
+			       U32_MAX);
+	cma_account_alloc(cma, &rec);
+
 	mutex_unlock(&cma_mutex);
 	pr_debug("%s(): returned %lx\n", __func__, pfn);
 	return pfn;
@@ -609,3 +678,83 @@ bool dma_release_from_contiguous(struct device *dev, unsigned long pfn,
 
 	return true;
 }
+
+#ifdef CONFIG_DEBUG_FS
+static int cma_stats_show(struct seq_file *m, void *unused)
+{
+	struct cma *cma = m->private;
+	struct cma_stats *stats = &cma->stats;
+	unsigned int i, n;
+
+	mutex_lock(&cma_mutex);
+
+	seq_printf(m, "allocs: %lu\nfails: %lu\npages: %lu\nbusy_retries: %lu\n",
+		   stats->allocs, stats->fails, stats->pages, stats->busy);
+	seq_printf(m, "avg_us: %llu\nmax_us: %u\n",
+		   stats->allocs ? div64_u64(stats->total_us, stats->allocs) : 0,
+		   stats->max_us);
+
+	seq_puts(m, "\nlatency:\n");
+	seq_printf(m, "%5s -   1 ms: %lu\n", "0", stats->hist[0]);
+	for (i = 1; i < CMA_HIST_BUCKETS - 1; i++)
+		seq_printf(m, "%5lu - %4lu ms: %lu\n", 1UL << (i - 1),
+			   (1UL << i) - 1, stats->hist[i]);
+	seq_printf(m, "%5lu -      ms: %lu\n", 1UL << (i - 1), stats->hist[i]);
+
+	seq_puts(m, "\nrecent:\n");
+	seq_printf(m, "%12s %10s %6s %10s %5s %5s %10s\n", "time_ms", "pfn",
+		   "count", "busy_pfn", "tries", "ret", "latency_us");
+	for (n = 0; n < CMA_NR_RECENT; n++) {
+		struct cma_alloc_record *rec;
+
+		rec = &stats->recent[(stats->next + n) % CMA_NR_RECENT];
+		if (!rec->count)
+			continue;
+		seq_printf(m, "%12lld %10lx %6d %10lx %5d %5d %10u\n",
+			   ktime_to_ms(rec->when), rec->pfn, rec->count,
+			   rec->busy_pfn, rec->tries, rec->ret,
+			   rec->latency_us);
+	}
+
+	mutex_unlock(&cma_mutex);
+	return 0;
+}
+
+static int cma_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, cma_stats_show, inode->i_private);
+}
+
+static const struct file_operations cma_stats_fops = {
+	.owner = THIS_MODULE,
+	.open = cma_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init cma_debugfs_init(void)
+{
+	struct dentry *root;
+	char name[16];
+	int i;
+
+	root = debugfs_create_dir("cma", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	for (i = 0; i < cma_area_count; i++) {
+		if (!cma_areas[i].cma)
+			continue;
+		if (cma_areas[i].name)
+			strlcpy(name, cma_areas[i].name, sizeof(name));
+		else
+			snprintf(name, sizeof(name), "cma%d", i);
+		debugfs_create_file(name, S_IRUGO, root, cma_areas[i].cma,
+				    &cma_stats_fops);
+	}
+
+	return 0;
+}
+late_initcall(cma_debugfs_init);
+#endif
@@ -88,6 +88,7 @@ enum {
 	FW_STATUS_LOADING,
 	FW_STATUS_DONE,
 	FW_STATUS_ABORT,
+	FW_STATUS_PINNED,
 };
 
 static int loading_timeout = 60;	/* In seconds */
@@ -306,6 +307,34 @@ static const char * const fw_path[] = {
 module_param_string(path, fw_path_para, sizeof(fw_path_para), 0644);
 MODULE_PARM_DESC(path, "customized firmware image search path with a higher priority than default path");
 
+/*
+ * Images named in 'firmware_class.pinned=a.bin,b.bin' stay in the firmware
+ * cache once they have been loaded, so that later requests, e.g. after a
+ * peripheral restart, get the same buffer back without touching the
+ * filesystem.
+ */
+static char fw_pinned_para[256];
+module_param_string(pinned, fw_pinned_para, sizeof(fw_pinned_para), 0644);
+MODULE_PARM_DESC(pinned, "comma separated list of firmware images to keep cached once loaded");
+
+static bool fw_is_pinned(const char *name)
+{
+	const char *p = fw_pinned_para;
+	size_t len = strlen(name);
+
+	while (*p) {
+		const char *end = strchr(p, ',');
+		size_t n = end ? end - p : strlen(p);
+
+		if (n == len && !strncmp(p, name, len))
+			return true;
+		if (!end)
+			break;
+		p = end + 1;
+	}
+	return false;
+}
+
 /* Don't inline this: 'struct kstat' is biggish */
 static noinline_for_stack long fw_file_size(struct file *file)
 {
@@ -1196,6 +1225,11 @@ static int assign_firmware_buf(struct firmware *fw, struct device *device,
 			kref_get(&buf->ref);
 	}
 
+	/* Pinned images hold an extra reference for good */
+	if (!nocache && fw_is_pinned(buf->fw_id) &&
+	    !test_and_set_bit(FW_STATUS_PINNED, &buf->status))
+		kref_get(&buf->ref);
+
 	/* pass the pages buffer to driver at the last minute */
 	fw_set_page_data(buf, fw);
 	mutex_unlock(&fw_lock);
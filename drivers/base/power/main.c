@@ -30,6 +30,7 @@
 #include <linux/suspend.h>
 #include <linux/cpuidle.h>
 #include <linux/timer.h>
+#include <linux/slab.h>
 #include <linux/wakeup_reason.h>
 
 #include "../base.h"
@@ -55,6 +56,19 @@ static LIST_HEAD(dpm_noirq_list);
 
 struct suspend_stats suspend_stats;
 static DEFINE_MUTEX(dpm_list_mtx);
+
+/*
+ * Dependencies between devices that are not parent and child, see
+ * device_pm_add_dependency().  The lists are only walked under
+ * dpm_deps_lock, never while waiting for a device.
+ */
+struct dpm_dependency {
+	struct list_head	supplier_node;	/* in consumer->power.suppliers */
+	struct list_head	consumer_node;	/* in supplier->power.consumers */
+	struct device		*supplier;
+	struct device		*consumer;
+};
+static DEFINE_SPINLOCK(dpm_deps_lock);
 static pm_message_t pm_transition;
 
 struct dpm_watchdog {
@@ -77,6 +91,8 @@ void device_pm_sleep_init(struct device *dev)
 	complete_all(&dev->power.completion);
 	dev->power.wakeup = NULL;
 	INIT_LIST_HEAD(&dev->power.entry);
+	INIT_LIST_HEAD(&dev->power.suppliers);
+	INIT_LIST_HEAD(&dev->power.consumers);
 }
 
 /**
@@ -123,6 +139,7 @@ void device_pm_remove(struct device *dev)
 	mutex_lock(&dpm_list_mtx);
 	list_del_init(&dev->power.entry);
 	mutex_unlock(&dpm_list_mtx);
+	device_pm_remove_dependencies(dev);
 	device_wakeup_disable(dev);
 	pm_runtime_remove(dev);
 }
@@ -193,29 +210,175 @@ static void initcall_debug_report(struct device *dev, ktime_t calltime,
 	}
 }
 
+/**
+ * device_pm_add_dependency - Order the PM callbacks of two devices.
+ * @consumer: Device that needs @supplier to be functional.
+ * @supplier: Device @consumer depends on.
+ *
+ * Make @consumer suspend before and resume after @supplier, like a child
+ * does with respect to its parent, even if either of them is handled
+ * asynchronously.  @consumer is moved after @supplier in dpm_list if it
+ * was registered first.  The dependency goes away when either device is
+ * removed.  Must not be called during a system power transition.
+ */
+int device_pm_add_dependency(struct device *consumer, struct device *supplier)
+{
+	struct dpm_dependency *dep, *new;
+	struct list_head *pos;
+
+	if (consumer == supplier)
+		return -EINVAL;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+	new->consumer = consumer;
+	new->supplier = supplier;
+
+	mutex_lock(&dpm_list_mtx);
+	spin_lock(&dpm_deps_lock);
+	list_for_each_entry(dep, &consumer->power.suppliers, supplier_node)
+		if (dep->supplier == supplier) {
+			spin_unlock(&dpm_deps_lock);
+			mutex_unlock(&dpm_list_mtx);
+			kfree(new);
+			return 0;
+		}
+	list_add_tail(&new->supplier_node, &consumer->power.suppliers);
+	list_add_tail(&new->consumer_node, &supplier->power.consumers);
+	spin_unlock(&dpm_deps_lock);
+
+	for (pos = consumer->power.entry.next; pos != &dpm_list &&
+	     pos != &consumer->power.entry; pos = pos->next)
+		if (pos == &supplier->power.entry) {
+			device_pm_move_after(consumer, supplier);
+			break;
+		}
+	mutex_unlock(&dpm_list_mtx);
+
+	pr_debug("PM: %s depends on %s\n", dev_name(consumer),
+		 dev_name(supplier));
+	return 0;
+}
+EXPORT_SYMBOL_GPL(device_pm_add_dependency);
+
+/**
+ * device_pm_remove_dependencies - Drop all PM dependencies of a device.
+ * @dev: Device being removed.
+ */
+void device_pm_remove_dependencies(struct device *dev)
+{
+	struct dpm_dependency *dep, *tmp;
+
+	spin_lock(&dpm_deps_lock);
+	list_for_each_entry_safe(dep, tmp, &dev->power.suppliers,
+				 supplier_node) {
+		list_del(&dep->supplier_node);
+		list_del(&dep->consumer_node);
+		kfree(dep);
+	}
+	list_for_each_entry_safe(dep, tmp, &dev->power.consumers,
+				 consumer_node) {
+		list_del(&dep->supplier_node);
+		list_del(&dep->consumer_node);
+		kfree(dep);
+	}
+	spin_unlock(&dpm_deps_lock);
+}
+
+static bool dpm_must_wait(struct device *dev, bool async)
+{
+	return async || (pm_async_enabled && dev->power.async_suspend);
+}
+
 /**
  * dpm_wait - Wait for a PM operation to complete.
+ * @waiter: Device whose PM operation is held up, for reporting only.
  * @dev: Device to wait for.
  * @async: If unset, wait only if the device's power.async_suspend flag is set.
+ *
+ * With pm_print_times set, every wait that actually blocks is reported, so
+ * that the critical path of an asynchronous suspend or resume can be
+ * followed back from the device that finished last.
  */
-static void dpm_wait(struct device *dev, bool async)
+static void dpm_wait(struct device *waiter, struct device *dev, bool async)
 {
-	if (!dev)
+	ktime_t calltime;
+
+	if (!dev || !dpm_must_wait(dev, async))
 		return;
 
-	if (async || (pm_async_enabled && dev->power.async_suspend))
+	if (!pm_print_times_enabled || completion_done(&dev->power.completion)) {
 		wait_for_completion(&dev->power.completion);
+		return;
+	}
+
+	calltime = ktime_get();
+	wait_for_completion(&dev->power.completion);
+	pr_info("PM: %s waited %Ld usecs for %s\n", dev_name(waiter),
+		(unsigned long long)ktime_us_delta(ktime_get(), calltime),
+		dev_name(dev));
 }
 
-static int dpm_wait_fn(struct device *dev, void *async_ptr)
+struct dpm_wait_data {
+	struct device *waiter;
+	bool async;
+};
+
+static int dpm_wait_fn(struct device *dev, void *data)
 {
-	dpm_wait(dev, *((bool *)async_ptr));
+	struct dpm_wait_data *wd = data;
+
+	dpm_wait(wd->waiter, dev, wd->async);
 	return 0;
 }
 
 static void dpm_wait_for_children(struct device *dev, bool async)
 {
-       device_for_each_child(dev, &async, dpm_wait_fn);
+	struct dpm_wait_data wd = { .waiter = dev, .async = async };
+
+	device_for_each_child(dev, &wd, dpm_wait_fn);
+}
+
+/*
+ * Wait for the devices at the other end of @dev's dependencies: the
+ * suppliers on resume, the consumers on suspend.  The list is rescanned
+ * after every wait, since it cannot be held locked while waiting.
+ */
+static void dpm_wait_for_deps(struct device *dev, bool async, bool suppliers)
+{
+	struct dpm_dependency *dep;
+	struct device *other;
+
+	for (;;) {
+		other = NULL;
+		spin_lock(&dpm_deps_lock);
+		if (suppliers) {
+			list_for_each_entry(dep, &dev->power.suppliers,
+					    supplier_node)
+				if (dpm_must_wait(dep->supplier, async) &&
+				    !completion_done(&dep->supplier->power.completion)) {
+					other = dep->supplier;
+					break;
+				}
+		} else {
+			list_for_each_entry(dep, &dev->power.consumers,
+					    consumer_node)
+				if (dpm_must_wait(dep->consumer, async) &&
+				    !completion_done(&dep->consumer->power.completion)) {
+					other = dep->consumer;
+					break;
+				}
+		}
+		if (other)
+			get_device(other);
+		spin_unlock(&dpm_deps_lock);
+
+		if (!other)
+			return;
+		dpm_wait(dev, other, async);
+		put_device(other);
+	}
 }
 
 /**
@@ -377,17 +540,20 @@ static int dpm_run_callback(pm_callback_t cb, struct device *dev,
 			    pm_message_t state, char *info)
 {
 	ktime_t calltime;
+	u64 start;
 	int error;
 
 	if (!cb)
 		return 0;
 
 	calltime = initcall_debug_start(dev);
+	start = suspend_time_now();
 
 	pm_dev_dbg(dev, state, info);
 	error = cb(dev);
 	suspend_report_result(cb, error);
 
+	suspend_time_device(dev, start);
 	initcall_debug_report(dev, calltime, error);
 
 	return error;
@@ -501,6 +667,7 @@ static int device_resume_noirq(struct device *dev, pm_message_t state)
 static void dpm_resume_noirq(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
+	u64 start = suspend_time_phase_begin(SUSPEND_PHASE_RESUME_NOIRQ);
 
 	mutex_lock(&dpm_list_mtx);
 	while (!list_empty(&dpm_noirq_list)) {
@@ -523,6 +690,7 @@ static void dpm_resume_noirq(pm_message_t state)
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	suspend_time_phase_end(SUSPEND_PHASE_RESUME_NOIRQ, start);
 	dpm_show_time(starttime, state, "noirq");
 	resume_device_irqs();
 	cpuidle_resume();
@@ -582,6 +750,7 @@ static int device_resume_early(struct device *dev, pm_message_t state)
 static void dpm_resume_early(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
+	u64 start = suspend_time_phase_begin(SUSPEND_PHASE_RESUME_EARLY);
 
 	mutex_lock(&dpm_list_mtx);
 	while (!list_empty(&dpm_late_early_list)) {
@@ -604,6 +773,7 @@ static void dpm_resume_early(pm_message_t state)
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	suspend_time_phase_end(SUSPEND_PHASE_RESUME_EARLY, start);
 	dpm_show_time(starttime, state, "early");
 }
 
@@ -637,7 +807,8 @@ static int device_resume(struct device *dev, pm_message_t state, bool async)
 	if (dev->power.syscore)
 		goto Complete;
 
-	dpm_wait(dev->parent, async);
+	dpm_wait(dev, dev->parent, async);
+	dpm_wait_for_deps(dev, async, true);
 	device_lock(dev);
 
 	/*
@@ -724,6 +895,91 @@ static bool is_async(struct device *dev)
 		&& !pm_trace_is_enabled();
 }
 
+#define DPM_CRITICAL_MAX	8
+#define DPM_CRITICAL_DEPTH	16
+
+/*
+ * Resume @dev after its parent and its suppliers, ahead of its place in
+ * dpm_suspended_list.  Returns false if that order could not be kept and
+ * @dev was left for the main pass of dpm_resume(), which skips the
+ * devices already resumed here.
+ */
+static bool dpm_resume_critical(struct device *dev, pm_message_t state,
+				int depth)
+{
+	struct device *suppliers[DPM_CRITICAL_MAX];
+	struct dpm_dependency *dep;
+	bool ok = true;
+	int i, n = 0;
+	int error;
+
+	if (!dev->power.is_suspended)
+		return true;
+	if (depth > DPM_CRITICAL_DEPTH)
+		return false;
+
+	if (dev->parent && !dpm_resume_critical(dev->parent, state, depth + 1))
+		return false;
+
+	spin_lock(&dpm_deps_lock);
+	list_for_each_entry(dep, &dev->power.suppliers, supplier_node) {
+		if (n == DPM_CRITICAL_MAX) {
+			ok = false;
+			break;
+		}
+		suppliers[n++] = get_device(dep->supplier);
+	}
+	spin_unlock(&dpm_deps_lock);
+
+	for (i = 0; i < n; i++) {
+		if (ok)
+			ok = dpm_resume_critical(suppliers[i], state, depth + 1);
+		put_device(suppliers[i]);
+	}
+	if (!ok)
+		return false;
+
+	error = device_resume(dev, state, false);
+	if (error) {
+		suspend_stats.failed_resume++;
+		dpm_save_failed_step(SUSPEND_RESUME);
+		dpm_save_failed_dev(dev_name(dev));
+		pm_dev_err(dev, state, " critical", error);
+	}
+	return true;
+}
+
+/*
+ * After an interactive wakeup, resume the display and input devices
+ * marked resume_critical before the rest of dpm_suspended_list.
+ */
+static void dpm_resume_critical_devices(pm_message_t state)
+{
+	struct device *critical[DPM_CRITICAL_MAX];
+	struct device *dev;
+	ktime_t starttime = ktime_get();
+	int i, n = 0;
+
+	list_for_each_entry(dev, &dpm_suspended_list, power.entry) {
+		if (!dev->power.resume_critical)
+			continue;
+		if (n == DPM_CRITICAL_MAX)
+			break;
+		critical[n++] = get_device(dev);
+	}
+	if (!n)
+		return;
+
+	mutex_unlock(&dpm_list_mtx);
+	for (i = 0; i < n; i++) {
+		dpm_resume_critical(critical[i], state, 0);
+		put_device(critical[i]);
+	}
+	mutex_lock(&dpm_list_mtx);
+
+	dpm_show_time(starttime, state, "critical");
+}
+
 /**
  * dpm_resume - Execute "resume" callbacks for non-sysdev devices.
  * @state: PM transition of the system being carried out.
@@ -735,6 +991,7 @@ void dpm_resume(pm_message_t state)
 {
 	struct device *dev;
 	ktime_t starttime = ktime_get();
+	u64 start = suspend_time_phase_begin(SUSPEND_PHASE_RESUME);
 
 	might_sleep();
 
@@ -750,6 +1007,9 @@ void dpm_resume(pm_message_t state)
 		}
 	}
 
+	if (wakeup_reason_interactive())
+		dpm_resume_critical_devices(state);
+
 	while (!list_empty(&dpm_suspended_list)) {
 		dev = to_device(dpm_suspended_list.next);
 		get_device(dev);
@@ -774,6 +1034,7 @@ void dpm_resume(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	suspend_time_phase_end(SUSPEND_PHASE_RESUME, start);
 	dpm_show_time(starttime, state, NULL);
 }
 
@@ -831,6 +1092,7 @@ static void device_complete(struct device *dev, pm_message_t state)
 void dpm_complete(pm_message_t state)
 {
 	struct list_head list;
+	u64 start = suspend_time_phase_begin(SUSPEND_PHASE_COMPLETE);
 
 	might_sleep();
 
@@ -851,6 +1113,7 @@ void dpm_complete(pm_message_t state)
 	}
 	list_splice(&list, &dpm_list);
 	mutex_unlock(&dpm_list_mtx);
+	suspend_time_phase_end(SUSPEND_PHASE_COMPLETE, start);
 }
 
 /**
@@ -939,6 +1202,7 @@ static int device_suspend_noirq(struct device *dev, pm_message_t state)
 static int dpm_suspend_noirq(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
+	u64 start = suspend_time_phase_begin(SUSPEND_PHASE_SUSPEND_NOIRQ);
 	char suspend_abort[MAX_SUSPEND_ABORT_LEN];
 	int error = 0;
 
@@ -975,6 +1239,7 @@ static int dpm_suspend_noirq(pm_message_t state)
 		}
 	}
 	mutex_unlock(&dpm_list_mtx);
+	suspend_time_phase_end(SUSPEND_PHASE_SUSPEND_NOIRQ, start);
 	if (error)
 		dpm_resume_noirq(resume_event(state));
 	else
@@ -1028,6 +1293,7 @@ static int device_suspend_late(struct device *dev, pm_message_t state)
 static int dpm_suspend_late(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
+	u64 start = suspend_time_phase_begin(SUSPEND_PHASE_SUSPEND_LATE);
 	char suspend_abort[MAX_SUSPEND_ABORT_LEN];
 	int error = 0;
 
@@ -1062,6 +1328,7 @@ static int dpm_suspend_late(pm_message_t state)
 		}
 	}
 	mutex_unlock(&dpm_list_mtx);
+	suspend_time_phase_end(SUSPEND_PHASE_SUSPEND_LATE, start);
 	if (error)
 		dpm_resume_early(resume_event(state));
 	else
@@ -1101,12 +1368,15 @@ static int legacy_suspend(struct device *dev, pm_message_t state,
 {
 	int error;
 	ktime_t calltime;
+	u64 start;
 
 	calltime = initcall_debug_start(dev);
+	start = suspend_time_now();
 
 	error = cb(dev, state);
 	suspend_report_result(cb, error);
 
+	suspend_time_device(dev, start);
 	initcall_debug_report(dev, calltime, error);
 
 	return error;
@@ -1127,6 +1397,7 @@ static int __device_suspend(struct device *dev, pm_message_t state, bool async)
 	char suspend_abort[MAX_SUSPEND_ABORT_LEN];
 
 	dpm_wait_for_children(dev, async);
+	dpm_wait_for_deps(dev, async, false);
 
 	if (async_error)
 		goto Complete;
@@ -1252,6 +1523,7 @@ static int device_suspend(struct device *dev)
 int dpm_suspend(pm_message_t state)
 {
 	ktime_t starttime = ktime_get();
+	u64 start = suspend_time_phase_begin(SUSPEND_PHASE_SUSPEND);
 	int error = 0;
 
 	might_sleep();
@@ -1282,6 +1554,7 @@ int dpm_suspend(pm_message_t state)
 	}
 	mutex_unlock(&dpm_list_mtx);
 	async_synchronize_full();
+	suspend_time_phase_end(SUSPEND_PHASE_SUSPEND, start);
 	if (!error)
 		error = async_error;
 	if (error) {
@@ -1358,6 +1631,7 @@ static int device_prepare(struct device *dev, pm_message_t state)
  */
 int dpm_prepare(pm_message_t state)
 {
+	u64 start = suspend_time_phase_begin(SUSPEND_PHASE_PREPARE);
 	int error = 0;
 
 	might_sleep();
@@ -1390,6 +1664,7 @@ int dpm_prepare(pm_message_t state)
 		put_device(dev);
 	}
 	mutex_unlock(&dpm_list_mtx);
+	suspend_time_phase_end(SUSPEND_PHASE_PREPARE, start);
 	return error;
 }
 
@@ -1428,7 +1703,7 @@ EXPORT_SYMBOL_GPL(__suspend_report_result);
  */
 int device_pm_wait_for_dev(struct device *subordinate, struct device *dev)
 {
-	dpm_wait(dev, subordinate->power.async_suspend);
+	dpm_wait(subordinate, dev, subordinate->power.async_suspend);
 	return async_error;
 }
 EXPORT_SYMBOL_GPL(device_pm_wait_for_dev);
@@ -50,6 +50,7 @@ extern void device_pm_add(struct device *);
 extern void device_pm_remove(struct device *);
 extern void device_pm_move_before(struct device *, struct device *);
 extern void device_pm_move_after(struct device *, struct device *);
+extern void device_pm_remove_dependencies(struct device *);
 extern void device_pm_move_last(struct device *);
 
 #else /* !CONFIG_PM_SLEEP */
@@ -35,6 +35,7 @@
 #include <linux/kernel.h>
 #include <linux/notifier.h>
 #include <linux/proc_fs.h>
+#include <linux/seq_file.h>
 #include <linux/spinlock.h>
 #include <linux/timer.h>
 #include <linux/uaccess.h>
@@ -86,6 +87,36 @@ enum {
 static int debug_mask = DEBUG_USER_STATE;
 module_param_named(debug_mask, debug_mask, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+/*
+ * Adaptive idle policy. The idle timeout is derived from the learnt
+ * interval between traffic bursts: when the next burst is predicted to
+ * come sooner than break_even_ms, keeping the UART up is cheaper than a
+ * sleep/wake cycle, otherwise the link is put to sleep after idle_min_ms.
+ */
+static bool adaptive_idle = true;
+module_param_named(adaptive_idle, adaptive_idle, bool, S_IRUGO | S_IWUSR);
+
+static unsigned int idle_min_ms = 250;
+module_param_named(idle_min_ms, idle_min_ms, uint, S_IRUGO | S_IWUSR);
+
+static unsigned int break_even_ms = 1500;
+module_param_named(break_even_ms, break_even_ms, uint, S_IRUGO | S_IWUSR);
+
+/* host wake releases closer together than this are handled as one */
+static unsigned int rx_coalesce_ms = 30;
+module_param_named(rx_coalesce_ms, rx_coalesce_ms, uint, S_IRUGO | S_IWUSR);
+
+struct bluesleep_stats {
+	unsigned long last_activity;	/* jiffies of the last tx/rx */
+	unsigned long burst_start;	/* jiffies the current burst began */
+	unsigned long awake_start;	/* jiffies the uart was woken */
+	unsigned int avg_interval_ms;	/* EWMA of burst to burst time */
+	unsigned int last_awake_ms;
+	u64 total_awake_ms;
+	unsigned int bursts;
+	unsigned int wakeups;
+};
+
 struct bluesleep_info {
 	unsigned host_wake;
 	unsigned ext_wake;
@@ -95,6 +126,7 @@ struct bluesleep_info {
 	int irq_polarity;
 	int has_ext_wake;
 	int tx_timer_interval;
+	struct bluesleep_stats stats;
 };
 
 /* work function */
@@ -104,10 +136,11 @@ static void bluesleep_sleep_work(struct work_struct *work);
 DECLARE_DELAYED_WORK(sleep_workqueue, bluesleep_sleep_work);
 
 /* Macros for handling sleep work */
-#define bluesleep_rx_busy()     schedule_delayed_work(&sleep_workqueue, 0)
-#define bluesleep_tx_busy()     schedule_delayed_work(&sleep_workqueue, 0)
-#define bluesleep_rx_idle()     schedule_delayed_work(&sleep_workqueue, 0)
-#define bluesleep_tx_idle()     schedule_delayed_work(&sleep_workqueue, 0)
+#define bluesleep_rx_busy()	mod_delayed_work(system_wq, &sleep_workqueue, 0)
+#define bluesleep_tx_busy()	mod_delayed_work(system_wq, &sleep_workqueue, 0)
+#define bluesleep_rx_idle()	mod_delayed_work(system_wq, &sleep_workqueue, \
+					msecs_to_jiffies(rx_coalesce_ms))
+#define bluesleep_tx_idle()	mod_delayed_work(system_wq, &sleep_workqueue, 0)
 
 /* 5 second timeout */
 #define TX_TIMER_INTERVAL  5
@@ -153,6 +186,60 @@ struct proc_dir_entry *bluetooth_dir, *sleep_dir;
 /*
  * Local functions
  */
+
+/**
+ * Returns the idle time, in jiffies, after which the tx side is allowed
+ * to sleep.
+ */
+static unsigned long bluesleep_idle_timeout(void)
+{
+	unsigned int max_ms = bsi->tx_timer_interval * MSEC_PER_SEC;
+	unsigned int gap = bsi->stats.avg_interval_ms;
+	unsigned int ms;
+
+	if (!adaptive_idle || !gap)
+		return bsi->tx_timer_interval * HZ;
+
+	if (gap < break_even_ms)
+		/* stay up until just past the predicted next burst */
+		ms = gap + gap / 4;
+	else
+		ms = idle_min_ms;
+
+	return msecs_to_jiffies(clamp(ms, idle_min_ms, max_ms));
+}
+
+/**
+ * Records tx or rx traffic. Activity after more than idle_min_ms of
+ * silence starts a new burst and feeds the interval predictor.
+ * Must be called with rw_lock held.
+ */
+static void bluesleep_activity_locked(void)
+{
+	struct bluesleep_stats *st = &bsi->stats;
+	unsigned long now = jiffies;
+	unsigned int interval;
+
+	if (st->bursts &&
+	    time_before(now, st->last_activity +
+			msecs_to_jiffies(idle_min_ms))) {
+		st->last_activity = now;
+		return;
+	}
+
+	if (st->bursts) {
+		interval = jiffies_to_msecs(now - st->burst_start);
+		if (st->avg_interval_ms)
+			st->avg_interval_ms = (st->avg_interval_ms * 7 +
+					       interval) / 8;
+		else
+			st->avg_interval_ms = interval;
+	}
+	st->bursts++;
+	st->burst_start = now;
+	st->last_activity = now;
+}
+
 static void hsuart_power(int on)
 {
 	if (test_bit(BT_SUSPEND, &flags))
@@ -185,9 +272,11 @@ void bluesleep_sleep_wakeup(void)
 			pr_info("waking up...\n");
 
 		wake_lock(&bsi->wake_lock);
+		bsi->stats.awake_start = jiffies;
+		bsi->stats.wakeups++;
 
 		/* Start the timer */
-		mod_timer(&tx_timer, jiffies + (bsi->tx_timer_interval * HZ));
+		mod_timer(&tx_timer, jiffies + bluesleep_idle_timeout());
 
 		if (debug_mask & DEBUG_BTWAKE)
 			pr_info("BT WAKE: set to wake\n");
@@ -222,6 +311,12 @@ static void bluesleep_sleep_work(struct work_struct *work)
 				pr_info("going to sleep...\n");
 
 			set_bit(BT_ASLEEP, &flags);
+			if (bsi->stats.awake_start) {
+				bsi->stats.last_awake_ms = jiffies_to_msecs(
+					jiffies - bsi->stats.awake_start);
+				bsi->stats.total_awake_ms +=
+					bsi->stats.last_awake_ms;
+			}
 
 			/*Deactivating UART */
 			hsuart_power(0);
@@ -232,13 +327,12 @@ static void bluesleep_sleep_work(struct work_struct *work)
 			wake_lock_timeout(&bsi->wake_lock, HZ / 8);
 		} else {
 			mod_timer(&tx_timer, jiffies +
-					(bsi->tx_timer_interval * HZ));
+					bluesleep_idle_timeout());
 			return;
 		}
 	} else if (test_bit(BT_EXT_WAKE, &flags)
 		   && !test_bit(BT_ASLEEP, &flags)) {
-		mod_timer(&tx_timer, jiffies +
-				(bsi->tx_timer_interval * HZ));
+		mod_timer(&tx_timer, jiffies + bluesleep_idle_timeout());
 
 		if (debug_mask & DEBUG_BTWAKE)
 			pr_info("BT WAKE: set to wake\n");
@@ -263,10 +357,12 @@ static void bluesleep_hostwake_task(unsigned long data)
 		pr_info("hostwake line change\n");
 
 	spin_lock(&rw_lock);
-	if ((gpio_get_value(bsi->host_wake) == bsi->irq_polarity))
+	if ((gpio_get_value(bsi->host_wake) == bsi->irq_polarity)) {
+		bluesleep_activity_locked();
 		bluesleep_rx_busy();
-	else
+	} else {
 		bluesleep_rx_idle();
+	}
 
 	spin_unlock(&rw_lock);
 }
@@ -283,6 +379,7 @@ static void bluesleep_outgoing_data(void)
 
 	/* log data passing by */
 	set_bit(BT_TXDATA, &flags);
+	bluesleep_activity_locked();
 
 	spin_unlock_irqrestore(&rw_lock, irq_flags);
 
@@ -323,8 +420,7 @@ static void bluesleep_tx_timer_expire(unsigned long data)
 	} else {
 		if (debug_mask & DEBUG_SUSPEND)
 			pr_info("Tx data during last period\n");
-		mod_timer(&tx_timer, jiffies +
-				(bsi->tx_timer_interval * HZ));
+		mod_timer(&tx_timer, jiffies + bluesleep_idle_timeout());
 	}
 
 	/* clear the incoming data flag */
@@ -371,8 +467,9 @@ static int bluesleep_start(void)
 	}
 
 	/* start the timer */
-	mod_timer(&tx_timer, jiffies +
-			(bsi->tx_timer_interval * HZ));
+	memset(&bsi->stats, 0, sizeof(bsi->stats));
+	bsi->stats.awake_start = jiffies;
+	mod_timer(&tx_timer, jiffies + bluesleep_idle_timeout());
 
 	/* assert BT_WAKE */
 	if (debug_mask & DEBUG_BTWAKE)
@@ -488,6 +585,32 @@ static int bluesleep_write_proc_lpm(struct file *file,
 	return count;
 }
 
+static int bluesleep_stats_show(struct seq_file *m, void *v)
+{
+	struct bluesleep_stats st;
+	unsigned long irq_flags;
+
+	spin_lock_irqsave(&rw_lock, irq_flags);
+	st = bsi->stats;
+	spin_unlock_irqrestore(&rw_lock, irq_flags);
+
+	seq_printf(m, "bursts: %u\n", st.bursts);
+	seq_printf(m, "avg_interval_ms: %u\n", st.avg_interval_ms);
+	seq_printf(m, "wakeups: %u\n", st.wakeups);
+	seq_printf(m, "last_awake_ms: %u\n", st.last_awake_ms);
+	seq_printf(m, "total_awake_ms: %llu\n", st.total_awake_ms);
+	seq_printf(m, "avg_awake_ms: %llu\n", st.wakeups ?
+		   div_u64(st.total_awake_ms, st.wakeups) : 0);
+	seq_printf(m, "idle_timeout_ms: %u\n",
+		   jiffies_to_msecs(bluesleep_idle_timeout()));
+	return 0;
+}
+
+static int bluesleep_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bluesleep_stats_show, NULL);
+}
+
 static int bluesleep_populate_dt_pinfo(struct platform_device *pdev)
 {
 	struct device_node *np = pdev->dev.of_node;
@@ -694,6 +817,13 @@ static const struct file_operations lpm_fops = {
 	.write = bluesleep_write_proc_lpm
 };
 
+static const struct file_operations stats_fops = {
+	.open = bluesleep_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 // For new proc apis
 static struct proc_dir_entry *bluesleep_proc_create(const char *name,
 						    umode_t mode,
@@ -777,6 +907,14 @@ static int __init bluesleep_init(void)
 	}
 	bluesleep_proc_set_uid_gid(ent);
 
+	/* Creating read only "stats" entry */
+	ent = bluesleep_proc_create("stats", S_IRUGO, sleep_dir, &stats_fops);
+	if (ent == NULL) {
+		BT_ERR("Unable to create /proc/%s/stats entry", PROC_DIR);
+		retval = -ENOMEM;
+		goto fail;
+	}
+
 	flags = 0;		/* clear all status bits */
 
 	/* Initialize spinlock. */
@@ -801,6 +939,7 @@ static int __init bluesleep_init(void)
 fail:
 	remove_proc_entry("btwrite", sleep_dir);
 	remove_proc_entry("lpm", sleep_dir);
+	remove_proc_entry("stats", sleep_dir);
 	remove_proc_entry("sleep", bluetooth_dir);
 	remove_proc_entry("bluetooth", 0);
 	return retval;
@@ -833,6 +972,7 @@ static void __exit bluesleep_exit(void)
 
 	remove_proc_entry("btwrite", sleep_dir);
 	remove_proc_entry("lpm", sleep_dir);
+	remove_proc_entry("stats", sleep_dir);
 	remove_proc_entry("sleep", bluetooth_dir);
 	remove_proc_entry("bluetooth", 0);
 }
@@ -41,6 +41,8 @@
 #include <linux/ioctl.h>
 #include <linux/skbuff.h>
 
+#include <asm/unaligned.h>
+
 #include <net/bluetooth/bluetooth.h>
 #include <net/bluetooth/hci_core.h>
 
@@ -53,14 +55,17 @@ struct h4_struct {
 	unsigned long rx_count;
 	struct sk_buff *rx_skb;
 	struct sk_buff_head txq;
+
+	/* header of the frame being received, until its length is known */
+	u8 rx_type;
+	u8 rx_hdr[HCI_ACL_HDR_SIZE];
+	u8 rx_hdr_len;
 };
 
 /* H4 receiver States */
 #define H4_W4_PACKET_TYPE	0
-#define H4_W4_EVENT_HDR		1
-#define H4_W4_ACL_HDR		2
-#define H4_W4_SCO_HDR		3
-#define H4_W4_DATA		4
+#define H4_W4_HDR		1
+#define H4_W4_DATA		2
 
 /* Initialize protocol */
 static int h4_open(struct hci_uart *hu)
@@ -88,6 +93,10 @@ static int h4_flush(struct hci_uart *hu)
 
 	skb_queue_purge(&h4->txq);
 
+	kfree_skb(h4->rx_skb);
+	h4->rx_skb = NULL;
+	h4->rx_state = H4_W4_PACKET_TYPE;
+
 	return 0;
 }
 
@@ -124,45 +133,129 @@ static int h4_enqueue(struct hci_uart *hu, struct sk_buff *skb)
 	return 0;
 }
 
-static inline int h4_check_data_len(struct h4_struct *h4, int len)
+static int h4_hdr_size(u8 type)
 {
-	int room = skb_tailroom(h4->rx_skb);
-
-	BT_DBG("len %d room %d", len, room);
-
-	if (!len) {
-		hci_recv_frame(h4->rx_skb);
-	} else if (len > room) {
-		BT_ERR("Data length is too large");
-		kfree_skb(h4->rx_skb);
-	} else {
-		h4->rx_state = H4_W4_DATA;
-		h4->rx_count = len;
-		return len;
+	switch (type) {
+	case HCI_EVENT_PKT:
+		return HCI_EVENT_HDR_SIZE;
+	case HCI_ACLDATA_PKT:
+		return HCI_ACL_HDR_SIZE;
+	case HCI_SCODATA_PKT:
+		return HCI_SCO_HDR_SIZE;
 	}
+	return -EILSEQ;
+}
 
-	h4->rx_state = H4_W4_PACKET_TYPE;
-	h4->rx_skb   = NULL;
-	h4->rx_count = 0;
+/* Allocate an skb sized for exactly the frame the header announces */
+static struct sk_buff *h4_alloc_frame(struct h4_struct *h4)
+{
+	struct sk_buff *skb;
+	unsigned int dlen, max;
+
+	switch (h4->rx_type) {
+	case HCI_EVENT_PKT:
+		dlen = h4->rx_hdr[1];
+		max = HCI_MAX_EVENT_SIZE;
+		break;
+	case HCI_ACLDATA_PKT:
+		dlen = get_unaligned_le16(&h4->rx_hdr[2]);
+		max = HCI_MAX_FRAME_SIZE;
+		break;
+	default:
+		dlen = h4->rx_hdr[2];
+		max = HCI_MAX_SCO_SIZE;
+		break;
+	}
 
-	return 0;
+	if (h4->rx_hdr_len + dlen > max) {
+		BT_ERR("Frame of type %d too long (%u)", h4->rx_type, dlen);
+		return NULL;
+	}
+
+	skb = bt_skb_alloc(h4->rx_hdr_len + dlen, GFP_ATOMIC);
+	if (!skb)
+		return NULL;
+
+	bt_cb(skb)->pkt_type = h4->rx_type;
+	memcpy(skb_put(skb, h4->rx_hdr_len), h4->rx_hdr, h4->rx_hdr_len);
+	h4->rx_count = dlen;
+	return skb;
 }
 
-/* Recv data */
+/*
+ * Recv data. Frames are parsed straight out of the tty flip buffer: the
+ * header is gathered first so the skb can be allocated at its final size,
+ * then the payload is copied in as large a run as the buffer allows.
+ * All frames completed by one flip are handed to the core in one batch.
+ */
 static int h4_recv(struct hci_uart *hu, void *data, int count)
 {
-	int ret;
+	struct h4_struct *h4 = hu->priv;
+	struct sk_buff_head frames;
+	u8 *ptr = data;
+	unsigned int len;
+	int hlen;
 
 	if (!test_bit(HCI_UART_REGISTERED, &hu->flags))
 		return -EUNATCH;
 
-	ret = hci_recv_stream_fragment(hu->hdev, data, count);
-	if (ret < 0) {
-		BT_ERR("Frame Reassembly Failed");
-		return ret;
+	__skb_queue_head_init(&frames);
+
+	while (count) {
+		switch (h4->rx_state) {
+		case H4_W4_PACKET_TYPE:
+			h4->rx_type = *ptr++;
+			count--;
+			if (h4_hdr_size(h4->rx_type) < 0) {
+				BT_ERR("Unknown HCI packet type %2.2x",
+				       h4->rx_type);
+				hu->hdev->stat.err_rx++;
+				continue;
+			}
+			h4->rx_hdr_len = 0;
+			h4->rx_state = H4_W4_HDR;
+			continue;
+
+		case H4_W4_HDR:
+			hlen = h4_hdr_size(h4->rx_type);
+			len = min_t(unsigned int, hlen - h4->rx_hdr_len, count);
+			memcpy(&h4->rx_hdr[h4->rx_hdr_len], ptr, len);
+			h4->rx_hdr_len += len;
+			ptr += len;
+			count -= len;
+			if (h4->rx_hdr_len < hlen)
+				continue;
+
+			h4->rx_skb = h4_alloc_frame(h4);
+			if (!h4->rx_skb) {
+				hu->hdev->stat.err_rx++;
+				h4->rx_state = H4_W4_PACKET_TYPE;
+				continue;
+			}
+			h4->rx_state = H4_W4_DATA;
+			break;
+
+		case H4_W4_DATA:
+			len = min_t(unsigned int, h4->rx_count, count);
+			memcpy(skb_put(h4->rx_skb, len), ptr, len);
+			h4->rx_count -= len;
+			ptr += len;
+			count -= len;
+			break;
+		}
+
+		if (h4->rx_state == H4_W4_DATA && !h4->rx_count) {
+			h4->rx_skb->dev = (void *) hu->hdev;
+			__skb_queue_tail(&frames, h4->rx_skb);
+			h4->rx_skb = NULL;
+			h4->rx_state = H4_W4_PACKET_TYPE;
+		}
 	}
 
-	return count;
+	if (!skb_queue_empty(&frames))
+		hci_recv_frames(hu->hdev, &frames);
+
+	return ptr - (u8 *) data;
 }
 
 static struct sk_buff *h4_dequeue(struct hci_uart *hu)
@@ -329,6 +329,44 @@ static const struct file_operations enabled_clocks_fops = {
 	.release	= seq_release,
 };
 
+/*
+ * Hardware enables and rate changes of every clock that saw any, to find the
+ * clocks drivers toggle the most.
+ */
+static int clock_stats_show(struct seq_file *m, void *unused)
+{
+	struct clk_table *table;
+	struct clk *c;
+	int i;
+
+	mutex_lock(&clk_list_lock);
+	seq_printf(m, "%-40s %12s %12s\n", "clock", "enables", "rate_changes");
+	list_for_each_entry(table, &clk_list, node) {
+		for (i = 0; i < table->num_clocks; i++) {
+			c = table->clocks[i].clk;
+			if (!c || (!c->enable_cnt && !c->rate_change_cnt))
+				continue;
+			seq_printf(m, "%-40s %12lu %12lu\n", c->dbg_name,
+				   c->enable_cnt, c->rate_change_cnt);
+		}
+	}
+	mutex_unlock(&clk_list_lock);
+
+	return 0;
+}
+
+static int clock_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, clock_stats_show, inode->i_private);
+}
+
+static const struct file_operations clock_stats_fops = {
+	.open		= clock_stats_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= seq_release,
+};
+
 static int list_rates_show(struct seq_file *m, void *unused)
 {
 	struct clk *clock = m->private;
@@ -579,6 +617,10 @@ static int clock_debug_init(void)
 				&enabled_clocks_fops))
 		return -ENOMEM;
 
+	if (!debugfs_create_file("clock_stats", S_IRUGO, debugfs_base, NULL,
+				&clock_stats_fops))
+		return -ENOMEM;
+
 	return 0;
 }
 
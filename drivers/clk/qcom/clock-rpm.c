@@ -20,10 +20,10 @@
 	((r)->rpmrs_data->set_rate_fn((r), (value), (ctx)))
 
 #define clk_rpmrs_set_rate_sleep(r, value) \
-	    __clk_rpmrs_set_rate((r), (value), (r)->rpmrs_data->ctx_sleep_id)
+	    clk_rpmrs_vote((r), (value), RPM_CLK_SLEEP_SET)
 
 #define clk_rpmrs_set_rate_active(r, value) \
-	   __clk_rpmrs_set_rate((r), (value), (r)->rpmrs_data->ctx_active_id)
+	   clk_rpmrs_vote((r), (value), RPM_CLK_ACTIVE_SET)
 
 static int clk_rpmrs_set_rate_smd(struct rpm_clk *r, uint32_t value,
 				uint32_t context)
@@ -70,6 +70,31 @@ struct clk_rpmrs_data clk_rpmrs_data_smd = {
 
 static DEFINE_MUTEX(rpm_clock_lock);
 
+/*
+ * Send a vote for the resource shared by @r and its peer unless the RPM
+ * already holds the same value for @set. Toggling one clock of a pair while
+ * the other keeps the aggregate up then costs no RPM message at all.
+ * Called with rpm_clock_lock held.
+ */
+static int clk_rpmrs_vote(struct rpm_clk *r, uint32_t value, int set)
+{
+	struct rpm_clk *peer = r->peer;
+	int ctx = set == RPM_CLK_SLEEP_SET ? r->rpmrs_data->ctx_sleep_id :
+					     r->rpmrs_data->ctx_active_id;
+	int rc;
+
+	if (r->last_vote_valid[set] && r->last_vote[set] == value)
+		return 0;
+
+	rc = __clk_rpmrs_set_rate(r, value, ctx);
+
+	/* after a failure the RPM state is unknown, always send next time */
+	r->last_vote_valid[set] = peer->last_vote_valid[set] = !rc;
+	r->last_vote[set] = peer->last_vote[set] = value;
+
+	return rc;
+}
+
 static void to_active_sleep_khz(struct rpm_clk *r, unsigned long rate,
 			unsigned long *active_khz, unsigned long *sleep_khz)
 {
@@ -207,6 +207,16 @@ static void unvote_rate_vdd(struct clk *clk, unsigned long rate)
 	unvote_vdd_level(clk->vdd_class, level);
 }
 
+/* Check if switching between two rates changes the clock's voltage vote. */
+static bool rate_vdd_changes(struct clk *clk, unsigned long old_rate,
+			     unsigned long new_rate)
+{
+	if (!clk->vdd_class)
+		return false;
+
+	return find_vdd_level(clk, old_rate) != find_vdd_level(clk, new_rate);
+}
+
 /* Check if the rate is within the voltage limits of the clock. */
 static bool is_rate_valid(struct clk *clk, unsigned long rate)
 {
@@ -381,6 +391,7 @@ int clk_enable(struct clk *clk)
 			ret = clk->ops->enable(clk);
 		if (ret)
 			goto err_enable_clock;
+		clk->enable_cnt++;
 	}
 	clk->count++;
 	spin_unlock_irqrestore(&clk->lock, flags);
@@ -482,6 +493,7 @@ EXPORT_SYMBOL(clk_get_rate);
 int clk_set_rate(struct clk *clk, unsigned long rate)
 {
 	unsigned long start_rate;
+	bool vote_vdd;
 	int rc = 0;
 	const char *name = clk ? clk->dbg_name : NULL;
 
@@ -511,8 +523,13 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 	if (rc)
 		goto out;
 
-	/* Enforce vdd requirements for target frequency. */
-	if (clk->prepare_count) {
+	/*
+	 * Enforce vdd requirements for target frequency. Most rate changes
+	 * stay within one voltage level, the vote is kept as it is then.
+	 */
+	vote_vdd = clk->prepare_count &&
+		   rate_vdd_changes(clk, start_rate, rate);
+	if (vote_vdd) {
 		rc = vote_rate_vdd(clk, rate);
 		if (rc)
 			goto err_vote_vdd;
@@ -522,9 +539,10 @@ int clk_set_rate(struct clk *clk, unsigned long rate)
 	if (rc)
 		goto err_set_rate;
 	clk->rate = rate;
+	clk->rate_change_cnt++;
 
 	/* Release vdd requirements for starting frequency. */
-	if (clk->prepare_count)
+	if (vote_vdd)
 		unvote_rate_vdd(clk, start_rate);
 
 	if (clk->ops->post_set_rate)
@@ -535,7 +553,7 @@ out:
 	return rc;
 
 err_set_rate:
-	if (clk->prepare_count)
+	if (vote_vdd)
 		unvote_rate_vdd(clk, rate);
 err_vote_vdd:
 	/* clk->rate is still the old rate. So, pass the new rate instead. */
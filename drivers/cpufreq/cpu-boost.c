@@ -25,6 +25,26 @@
 #include <linux/slab.h>
 #include <linux/input.h>
 #include <linux/time.h>
+#include <linux/cpu_boost.h>
+#include <soc/qcom/core_park.h>
+#include <trace/events/power.h>
+
+/*
+ * Every boost source keeps its own per-CPU minimum frequency vote; the
+ * policy notifier applies the highest of them.
+ */
+enum boost_src {
+	BOOST_SRC_MIGRATION,
+	BOOST_SRC_INPUT,
+	BOOST_SRC_FRAME,
+	BOOST_SRC_MAX,
+};
+
+static const char * const boost_src_names[BOOST_SRC_MAX] = {
+	[BOOST_SRC_MIGRATION]	= "migration",
+	[BOOST_SRC_INPUT]	= "input",
+	[BOOST_SRC_FRAME]	= "frame",
+};
 
 struct cpu_sync {
 	struct task_struct *thread;
@@ -35,8 +55,7 @@ struct cpu_sync {
 	spinlock_t lock;
 	bool pending;
 	int src_cpu;
-	unsigned int boost_min;
-	unsigned int input_boost_min;
+	unsigned int boost_vote[BOOST_SRC_MAX];
 	unsigned int task_load;
 };
 
@@ -63,13 +82,45 @@ module_param(migration_load_threshold, uint, 0644);
 static bool load_based_syncs;
 module_param(load_based_syncs, bool, 0644);
 
+/* input device classes, matched through the id table's driver_info */
+#define BOOST_DEV_TOUCH		BIT(0)
+#define BOOST_DEV_KEY		BIT(1)
+
+static unsigned int input_boost_devices = BOOST_DEV_TOUCH | BOOST_DEV_KEY;
+module_param(input_boost_devices, uint, 0644);
+
 static u64 last_input_time;
 #define MIN_INPUT_INTERVAL (150 * USEC_PER_MSEC)
 
+static ATOMIC_NOTIFIER_HEAD(input_boost_notifier_list);
+
+/*
+ * Frame boost: when the display reports a commit that missed its vsync,
+ * hold frame_boost_freq as the floor for the next frame_boost_frames
+ * commits, or until no commit arrives for frame_boost_idle_ms.
+ */
+static unsigned int frame_boost_freq;
+module_param(frame_boost_freq, uint, 0644);
+
+static unsigned int frame_boost_frames = 8;
+module_param(frame_boost_frames, uint, 0644);
+
+static unsigned int frame_boost_idle_ms = 100;
+module_param(frame_boost_idle_ms, uint, 0644);
+
+static DEFINE_SPINLOCK(frame_boost_lock);
+static unsigned int frame_boost_left;
+static bool frame_boost_active;
+static bool frame_boost_applied;
+static DEFINE_MUTEX(frame_boost_mutex);
+static struct work_struct frame_boost_work;
+static struct delayed_work frame_boost_idle_work;
+static BLOCKING_NOTIFIER_HEAD(frame_boost_notifier_list);
+
 /*
  * The CPUFREQ_ADJUST notifier is used to override the current policy min to
- * make sure policy min >= boost_min. The cpufreq framework then does the job
- * of enforcing the new policy.
+ * make sure policy min >= the highest boost vote. The cpufreq framework then
+ * does the job of enforcing the new policy.
  *
  * The sync kthread needs to run on the CPU in question to avoid deadlocks in
  * the wake up code. Achieve this by binding the thread to the respective
@@ -83,17 +134,16 @@ static int boost_adjust_notify(struct notifier_block *nb, unsigned long val,
 	struct cpufreq_policy *policy = data;
 	unsigned int cpu = policy->cpu;
 	struct cpu_sync *s = &per_cpu(sync_info, cpu);
-	unsigned int b_min = s->boost_min;
-	unsigned int ib_min = s->input_boost_min;
-	unsigned int min;
+	unsigned int min = 0;
+	int i;
 
 	switch (val) {
 	case CPUFREQ_ADJUST:
-		if (!b_min && !ib_min)
+		for (i = 0; i < BOOST_SRC_MAX; i++)
+			min = max(min, ACCESS_ONCE(s->boost_vote[i]));
+		if (!min)
 			break;
 
-		min = max(b_min, ib_min);
-
 		pr_debug("CPU%u policy min before boost: %u kHz\n",
 			 cpu, policy->min);
 		pr_debug("CPU%u boost min: %u kHz\n", cpu, min);
@@ -116,13 +166,29 @@ static struct notifier_block boost_adjust_nb = {
 	.notifier_call = boost_adjust_notify,
 };
 
+/*
+ * Record @src's vote for @s->cpu. The caller re-evaluates the policy with
+ * cpufreq_update_policy() to apply it.
+ */
+static void boost_vote(struct cpu_sync *s, enum boost_src src,
+			unsigned int freq)
+{
+	unsigned int old = s->boost_vote[src];
+
+	s->boost_vote[src] = freq;
+	if (freq && freq != old)
+		trace_cpu_boost_on(s->cpu, boost_src_names[src], freq);
+	else if (!freq && old)
+		trace_cpu_boost_off(s->cpu, boost_src_names[src], old);
+}
+
 static void do_boost_rem(struct work_struct *work)
 {
 	struct cpu_sync *s = container_of(work, struct cpu_sync,
 						boost_rem.work);
 
 	pr_debug("Removing boost for CPU%d\n", s->cpu);
-	s->boost_min = 0;
+	boost_vote(s, BOOST_SRC_MIGRATION, 0);
 	/* Force policy re-evaluation to trigger adjust notifier. */
 	cpufreq_update_policy(s->cpu);
 }
@@ -133,7 +199,7 @@ static void do_input_boost_rem(struct work_struct *work)
 						input_boost_rem.work);
 
 	pr_debug("Removing input boost for CPU%d\n", s->cpu);
-	s->input_boost_min = 0;
+	boost_vote(s, BOOST_SRC_INPUT, 0);
 	/* Force policy re-evaluation to trigger adjust notifier. */
 	cpufreq_update_policy(s->cpu);
 }
@@ -180,7 +246,7 @@ static int boost_mig_sync_thread(void *data)
 
 		cancel_delayed_work_sync(&s->boost_rem);
 
-		s->boost_min = req_freq;
+		boost_vote(s, BOOST_SRC_MIGRATION, req_freq);
 
 		/* Force policy re-evaluation to trigger adjust notifier. */
 		get_online_cpus();
@@ -200,7 +266,7 @@ static int boost_mig_sync_thread(void *data)
 			queue_delayed_work_on(dest_cpu, cpu_boost_wq,
 				&s->boost_rem, msecs_to_jiffies(boost_ms));
 		} else {
-			s->boost_min = 0;
+			boost_vote(s, BOOST_SRC_MIGRATION, 0);
 		}
 		put_online_cpus();
 	}
@@ -265,7 +331,7 @@ static void do_input_boost(struct work_struct *work)
 			continue;
 
 		cancel_delayed_work_sync(&i_sync_info->input_boost_rem);
-		i_sync_info->input_boost_min = input_boost_freq;
+		boost_vote(i_sync_info, BOOST_SRC_INPUT, input_boost_freq);
 		cpufreq_update_policy(i);
 		queue_delayed_work_on(i_sync_info->cpu, cpu_boost_wq,
 			&i_sync_info->input_boost_rem,
@@ -279,19 +345,146 @@ static void cpuboost_input_event(struct input_handle *handle,
 {
 	u64 now;
 
-	if (!input_boost_freq)
+	if (!(input_boost_devices & (unsigned long)handle->private))
 		return;
 
 	now = ktime_to_us(ktime_get());
 	if (now - last_input_time < MIN_INPUT_INTERVAL)
 		return;
+	last_input_time = now;
 
-	if (work_pending(&input_boost_work))
+	atomic_notifier_call_chain(&input_boost_notifier_list, 0, NULL);
+
+	if (!input_boost_freq || work_pending(&input_boost_work))
 		return;
 
 	queue_work(cpu_boost_wq, &input_boost_work);
-	last_input_time = ktime_to_us(ktime_get());
+	msm_core_park_boost(input_boost_ms);
+}
+
+/**
+ * input_boost_register_notifier - get called on every input boost
+ * @nb: notifier, called in atomic context from the input event path
+ *
+ * Lets governors with their own notion of a boost, such as interactive's
+ * hispeed pulse, share this driver's input handler and rate limiting.
+ */
+int input_boost_register_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_register(&input_boost_notifier_list, nb);
 }
+EXPORT_SYMBOL(input_boost_register_notifier);
+
+int input_boost_unregister_notifier(struct notifier_block *nb)
+{
+	return atomic_notifier_chain_unregister(&input_boost_notifier_list,
+						nb);
+}
+EXPORT_SYMBOL(input_boost_unregister_notifier);
+
+static void do_frame_boost(struct work_struct *work)
+{
+	bool active;
+	unsigned int cpu;
+
+	mutex_lock(&frame_boost_mutex);
+	active = ACCESS_ONCE(frame_boost_active);
+	if (active == frame_boost_applied) {
+		mutex_unlock(&frame_boost_mutex);
+		return;
+	}
+	frame_boost_applied = active;
+
+	pr_debug("%s frame boost\n", active ? "Starting" : "Removing");
+
+	get_online_cpus();
+	for_each_possible_cpu(cpu) {
+		boost_vote(&per_cpu(sync_info, cpu), BOOST_SRC_FRAME,
+			   active ? frame_boost_freq : 0);
+		if (cpu_online(cpu))
+			cpufreq_update_policy(cpu);
+	}
+	put_online_cpus();
+
+	blocking_notifier_call_chain(&frame_boost_notifier_list,
+			active ? FRAME_BOOST_START : FRAME_BOOST_END, NULL);
+	mutex_unlock(&frame_boost_mutex);
+}
+
+static void do_frame_boost_idle(struct work_struct *work)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&frame_boost_lock, flags);
+	frame_boost_left = 0;
+	frame_boost_active = false;
+	spin_unlock_irqrestore(&frame_boost_lock, flags);
+
+	do_frame_boost(NULL);
+}
+
+/**
+ * cpu_boost_frame_commit - report a display commit
+ * @missed: the commit came later than one vsync after the previous one
+ *
+ * Called by the display driver for every commit of the primary panel.
+ */
+void cpu_boost_frame_commit(bool missed)
+{
+	unsigned long flags;
+	bool changed = false;
+	bool active;
+
+	if (!frame_boost_frames || !cpu_boost_wq)
+		return;
+
+	spin_lock_irqsave(&frame_boost_lock, flags);
+	if (missed) {
+		frame_boost_left = frame_boost_frames;
+		changed = !frame_boost_active;
+		frame_boost_active = true;
+	} else if (frame_boost_left && !--frame_boost_left) {
+		changed = frame_boost_active;
+		frame_boost_active = false;
+	}
+	active = frame_boost_active;
+	spin_unlock_irqrestore(&frame_boost_lock, flags);
+
+	if (changed)
+		queue_work(cpu_boost_wq, &frame_boost_work);
+	if (active)
+		mod_delayed_work(cpu_boost_wq, &frame_boost_idle_work,
+				msecs_to_jiffies(frame_boost_idle_ms));
+}
+EXPORT_SYMBOL(cpu_boost_frame_commit);
+
+/**
+ * cpu_boost_vsync_hint - report that vsync was turned on
+ *
+ * Called by the display driver, from process context, when the compositor
+ * asks for vsync events on the primary panel.  That happens just before
+ * it starts drawing, so the frame boost notifiers get a FRAME_HINT_VSYNC
+ * to let other clock domains start powering up ahead of the work.
+ */
+void cpu_boost_vsync_hint(void)
+{
+	blocking_notifier_call_chain(&frame_boost_notifier_list,
+				     FRAME_HINT_VSYNC, NULL);
+}
+EXPORT_SYMBOL(cpu_boost_vsync_hint);
+
+int frame_boost_register_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&frame_boost_notifier_list, nb);
+}
+EXPORT_SYMBOL(frame_boost_register_notifier);
+
+int frame_boost_unregister_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&frame_boost_notifier_list,
+						  nb);
+}
+EXPORT_SYMBOL(frame_boost_unregister_notifier);
 
 static int cpuboost_input_connect(struct input_handler *handler,
 		struct input_dev *dev, const struct input_device_id *id)
@@ -306,6 +499,7 @@ static int cpuboost_input_connect(struct input_handler *handler,
 	handle->dev = dev;
 	handle->handler = handler;
 	handle->name = "cpufreq";
+	handle->private = (void *)id->driver_info;
 
 	error = input_register_handle(handle);
 	if (error)
@@ -339,6 +533,7 @@ static const struct input_device_id cpuboost_ids[] = {
 		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
 			BIT_MASK(ABS_MT_POSITION_X) |
 			BIT_MASK(ABS_MT_POSITION_Y) },
+		.driver_info = BOOST_DEV_TOUCH,
 	},
 	/* touchpad */
 	{
@@ -347,11 +542,13 @@ static const struct input_device_id cpuboost_ids[] = {
 		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
 		.absbit = { [BIT_WORD(ABS_X)] =
 			BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
+		.driver_info = BOOST_DEV_TOUCH,
 	},
 	/* Keypad */
 	{
 		.flags = INPUT_DEVICE_ID_MATCH_EVBIT,
 		.evbit = { BIT_MASK(EV_KEY) },
+		.driver_info = BOOST_DEV_KEY,
 	},
 	{ },
 };
@@ -369,12 +566,14 @@ static int cpu_boost_init(void)
 	int cpu, ret;
 	struct cpu_sync *s;
 
+	INIT_WORK(&input_boost_work, do_input_boost);
+	INIT_WORK(&frame_boost_work, do_frame_boost);
+	INIT_DELAYED_WORK(&frame_boost_idle_work, do_frame_boost_idle);
+
 	cpu_boost_wq = alloc_workqueue("cpuboost_wq", WQ_HIGHPRI, 0);
 	if (!cpu_boost_wq)
 		return -EFAULT;
 
-	INIT_WORK(&input_boost_work, do_input_boost);
-
 	for_each_possible_cpu(cpu) {
 		s = &per_cpu(sync_info, cpu);
 		s->cpu = cpu;
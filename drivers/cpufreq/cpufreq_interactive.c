@@ -30,7 +30,8 @@
 #include <linux/workqueue.h>
 #include <linux/kthread.h>
 #include <linux/slab.h>
-#include <linux/input.h>
+#include <linux/cpu_boost.h>
+#include <soc/qcom/cpubw_hwmon.h>
 #include "cpufreq_governor.h"
 
 struct cpufreq_interactive_cpuinfo {
@@ -51,6 +52,8 @@ struct cpufreq_interactive_cpuinfo {
 	u64 hispeed_validate_time;
 	struct rw_semaphore enable_sem;
 	int governor_enabled;
+	/* Sampling is stopped until this CPU leaves idle */
+	int idle_suspended;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_interactive_cpuinfo, cpuinfo);
@@ -112,10 +115,16 @@ struct cpufreq_interactive_tunables {
 #define DEFAULT_TIMER_SLACK (4 * DEFAULT_TIMER_RATE)
 	int timer_slack_val;
 	bool io_is_busy;
+	/*
+	 * Stop both sampling timers when a CPU enters idle and restart them
+	 * on idle exit.  The vote of a suspended CPU is ignored by the
+	 * speed change task and replayed when the CPU is busy again.
+	 */
+	bool idle_suspend;
 };
 
 /*
- * Duration in usec to be used with touchboost(interactive_input_event).
+ * Duration in usec of the touchboost requested through cpu-boost.
  * Default is 500000 usec(500 msec).
  */
 #define TOUCHBOOST_DURATION 500000
@@ -201,112 +210,60 @@ static unsigned int freq_to_above_hispeed_delay(
 	return ret;
 }
 
+/* Called with target_loads_lock held */
 static unsigned int freq_to_targetload(
 	struct cpufreq_interactive_tunables *tunables, unsigned int freq)
 {
 	int i;
-	unsigned int ret;
-	unsigned long flags;
-
-	spin_lock_irqsave(&tunables->target_loads_lock, flags);
 
 	for (i = 0; i < tunables->ntarget_loads - 1 &&
 		    freq >= tunables->target_loads[i+1]; i += 2)
 		;
 
-	ret = tunables->target_loads[i];
-	spin_unlock_irqrestore(&tunables->target_loads_lock, flags);
-	return ret;
+	return tunables->target_loads[i];
 }
 
 /*
- * If increasing frequencies never map to a lower target load then
- * choose_freq() will find the minimum frequency that does not exceed its
- * target load given the current load.
+ * loadadjfreq is the frequency invariant demand: update_load() weights
+ * active time by the frequency it ran at, so loadadjfreq / freq is the
+ * load the cpu would see at freq.  Pick, in a single pass over the
+ * frequency table, the lowest frequency within the policy limits whose
+ * load for this demand does not exceed its target load, or the highest
+ * one if none does.
  */
 static unsigned int choose_freq(struct cpufreq_interactive_cpuinfo *pcpu,
 		unsigned int loadadjfreq)
 {
-	unsigned int freq = pcpu->policy->cur;
-	unsigned int prevfreq, freqmin, freqmax;
-	unsigned int tl;
-	int index;
+	struct cpufreq_policy *policy = pcpu->policy;
+	struct cpufreq_interactive_tunables *tunables = policy->governor_data;
+	struct cpufreq_frequency_table *table = pcpu->freq_table;
+	unsigned int best = UINT_MAX, highest = 0;
+	unsigned long flags;
+	int i;
 
-	freqmin = 0;
-	freqmax = UINT_MAX;
+	spin_lock_irqsave(&tunables->target_loads_lock, flags);
 
-	do {
-		prevfreq = freq;
-		tl = freq_to_targetload(pcpu->policy->governor_data, freq);
+	for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+		unsigned int freq = table[i].frequency;
 
-		/*
-		 * Find the lowest frequency where the computed load is less
-		 * than or equal to the target load.
-		 */
+		if (freq == CPUFREQ_ENTRY_INVALID ||
+		    freq < policy->min || freq > policy->max)
+			continue;
 
-		if (cpufreq_frequency_table_target(
-			    pcpu->policy, pcpu->freq_table, loadadjfreq / tl,
-			    CPUFREQ_RELATION_L, &index))
-			break;
-		freq = pcpu->freq_table[index].frequency;
-
-		if (freq > prevfreq) {
-			/* The previous frequency is too low. */
-			freqmin = prevfreq;
-
-			if (freq >= freqmax) {
-				/*
-				 * Find the highest frequency that is less
-				 * than freqmax.
-				 */
-				if (cpufreq_frequency_table_target(
-					    pcpu->policy, pcpu->freq_table,
-					    freqmax - 1, CPUFREQ_RELATION_H,
-					    &index))
-					break;
-				freq = pcpu->freq_table[index].frequency;
-
-				if (freq == freqmin) {
-					/*
-					 * The first frequency below freqmax
-					 * has already been found to be too
-					 * low.  freqmax is the lowest speed
-					 * we found that is fast enough.
-					 */
-					freq = freqmax;
-					break;
-				}
-			}
-		} else if (freq < prevfreq) {
-			/* The previous frequency is high enough. */
-			freqmax = prevfreq;
-
-			if (freq <= freqmin) {
-				/*
-				 * Find the lowest frequency that is higher
-				 * than freqmin.
-				 */
-				if (cpufreq_frequency_table_target(
-					    pcpu->policy, pcpu->freq_table,
-					    freqmin + 1, CPUFREQ_RELATION_L,
-					    &index))
-					break;
-				freq = pcpu->freq_table[index].frequency;
-
-				/*
-				 * If freqmax is the first frequency above
-				 * freqmin then we have already found that
-				 * this speed is fast enough.
-				 */
-				if (freq == freqmax)
-					break;
-			}
-		}
+		if (freq > highest)
+			highest = freq;
 
-		/* If same frequency chosen as previous then done. */
-	} while (freq != prevfreq);
+		if (freq < best && (u64)freq *
+		    freq_to_targetload(tunables, freq) >= loadadjfreq)
+			best = freq;
+	}
 
-	return freq;
+	spin_unlock_irqrestore(&tunables->target_loads_lock, flags);
+
+	if (best != UINT_MAX)
+		return best;
+
+	return highest ? highest : policy->cur;
 }
 
 static u64 update_load(int cpu)
@@ -387,6 +344,14 @@ static void cpufreq_interactive_timer(unsigned long data)
 			new_freq = tunables->hispeed_freq;
 	}
 
+	/*
+	 * Stalls on DDR show up as load.  While the bandwidth governor
+	 * reports the workload as memory bound, hold the step above
+	 * hispeed_freq and let the DDR vote absorb it instead.
+	 */
+	if (new_freq > tunables->hispeed_freq && cpubw_hwmon_mem_bound())
+		new_freq = max(tunables->hispeed_freq, pcpu->target_freq);
+
 	if (pcpu->target_freq >= tunables->hispeed_freq &&
 	    new_freq > pcpu->target_freq &&
 	    now - pcpu->hispeed_validate_time <
@@ -474,6 +439,19 @@ static void cpufreq_interactive_idle_start(void)
 		return;
 	}
 
+	if (((struct cpufreq_interactive_tunables *)
+	     pcpu->policy->governor_data)->idle_suspend) {
+		/*
+		 * Nothing to sample while idle: drop both timers so this
+		 * CPU is not woken up, whatever its current speed.
+		 */
+		pcpu->idle_suspended = 1;
+		del_timer(&pcpu->cpu_timer);
+		del_timer(&pcpu->cpu_slack_timer);
+		up_read(&pcpu->enable_sem);
+		return;
+	}
+
 	pending = timer_pending(&pcpu->cpu_timer);
 
 	if (pcpu->target_freq != pcpu->policy->min) {
@@ -504,6 +482,21 @@ static void cpufreq_interactive_idle_end(void)
 		return;
 	}
 
+	if (pcpu->idle_suspended) {
+		unsigned long flags;
+
+		/* Replay the vote this CPU held when it went idle */
+		pcpu->idle_suspended = 0;
+		if (pcpu->target_freq > pcpu->policy->cur) {
+			spin_lock_irqsave(&speedchange_cpumask_lock, flags);
+			cpumask_set_cpu(smp_processor_id(),
+					&speedchange_cpumask);
+			spin_unlock_irqrestore(&speedchange_cpumask_lock,
+					       flags);
+			wake_up_process(speedchange_task);
+		}
+	}
+
 	/* Arm the timer for 1-2 ticks later if not already. */
 	if (!timer_pending(&pcpu->cpu_timer)) {
 		cpufreq_interactive_timer_resched(pcpu);
@@ -559,11 +552,13 @@ static int cpufreq_interactive_speedchange_task(void *data)
 				struct cpufreq_interactive_cpuinfo *pjcpu =
 					&per_cpu(cpuinfo, j);
 
+				if (ACCESS_ONCE(pjcpu->idle_suspended))
+					continue;
 				if (pjcpu->target_freq > max_freq)
 					max_freq = pjcpu->target_freq;
 			}
 
-			if (max_freq != pcpu->policy->cur)
+			if (max_freq && max_freq != pcpu->policy->cur)
 				__cpufreq_driver_target(pcpu->policy,
 							max_freq,
 							CPUFREQ_RELATION_H);
@@ -947,6 +942,25 @@ static ssize_t store_boostpulse_duration(struct cpufreq_interactive_tunables
 	return count;
 }
 
+static ssize_t show_idle_suspend(struct cpufreq_interactive_tunables *tunables,
+		char *buf)
+{
+	return sprintf(buf, "%u\n", tunables->idle_suspend);
+}
+
+static ssize_t store_idle_suspend(struct cpufreq_interactive_tunables *tunables,
+		const char *buf, size_t count)
+{
+	int ret;
+	unsigned long val;
+
+	ret = kstrtoul(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	tunables->idle_suspend = val;
+	return count;
+}
+
 static ssize_t show_io_is_busy(struct cpufreq_interactive_tunables *tunables,
 		char *buf)
 {
@@ -1013,6 +1027,7 @@ show_store_gov_pol_sys(boost);
 store_gov_pol_sys(boostpulse);
 show_store_gov_pol_sys(boostpulse_duration);
 show_store_gov_pol_sys(io_is_busy);
+show_store_gov_pol_sys(idle_suspend);
 
 #define gov_sys_attr_rw(_name)						\
 static struct global_attr _name##_gov_sys =				\
@@ -1036,6 +1051,7 @@ gov_sys_pol_attr_rw(timer_slack);
 gov_sys_pol_attr_rw(boost);
 gov_sys_pol_attr_rw(boostpulse_duration);
 gov_sys_pol_attr_rw(io_is_busy);
+gov_sys_pol_attr_rw(idle_suspend);
 
 static struct global_attr boostpulse_gov_sys =
 	__ATTR(boostpulse, 0200, NULL, store_boostpulse_gov_sys);
@@ -1056,6 +1072,7 @@ static struct attribute *interactive_attributes_gov_sys[] = {
 	&boostpulse_gov_sys.attr,
 	&boostpulse_duration_gov_sys.attr,
 	&io_is_busy_gov_sys.attr,
+	&idle_suspend_gov_sys.attr,
 	NULL,
 };
 
@@ -1077,6 +1094,7 @@ static struct attribute *interactive_attributes_gov_pol[] = {
 	&boostpulse_gov_pol.attr,
 	&boostpulse_duration_gov_pol.attr,
 	&io_is_busy_gov_pol.attr,
+	&idle_suspend_gov_pol.attr,
 	NULL,
 };
 
@@ -1093,83 +1111,28 @@ static struct attribute_group *get_sysfs_attr(void)
 		return &interactive_attr_group_gov_sys;
 }
 
-static void interactive_input_event(struct input_handle *handle,
-		unsigned int type,
-		unsigned int code, int value)
+/* Called by cpu-boost's input handler, in atomic context */
+static int cpufreq_interactive_input_boost(struct notifier_block *nb,
+					   unsigned long val, void *data)
 {
 	struct cpufreq_interactive_cpuinfo *pcpu = &per_cpu(cpuinfo, 0);
-	struct cpufreq_interactive_tunables *tunables =
-		pcpu->policy->governor_data;
-
-	if (type == EV_SYN && code == SYN_REPORT) {
-		if (!tunables->boosted) {
-			tunables->boostpulse_endtime = ktime_to_us(ktime_get()) + TOUCHBOOST_DURATION;
-			cpufreq_interactive_boost(tunables);
-		}
-	}
-}
-
-static int interactive_input_connect(struct input_handler *handler,
-		struct input_dev *dev, const struct input_device_id *id)
-{
-	struct input_handle *handle;
-	int error;
-
-	handle = kzalloc(sizeof(struct input_handle), GFP_KERNEL);
-	if (!handle)
-		return -ENOMEM;
-
-	handle->dev = dev;
-	handle->handler = handler;
-	handle->name = "cpufreq";
-
-	error = input_register_handle(handle);
-	if (error)
-		goto err2;
+	struct cpufreq_interactive_tunables *tunables;
 
-	error = input_open_device(handle);
-	if (error)
-		goto err1;
+	if (!pcpu->governor_enabled)
+		return NOTIFY_OK;
 
-	return 0;
-err1:
-	input_unregister_handle(handle);
-err2:
-	kfree(handle);
-	return error;
-}
+	tunables = pcpu->policy->governor_data;
+	if (tunables && !tunables->boosted) {
+		tunables->boostpulse_endtime = ktime_to_us(ktime_get()) +
+			TOUCHBOOST_DURATION;
+		cpufreq_interactive_boost(tunables);
+	}
 
-static void interactive_input_disconnect(struct input_handle *handle)
-{
-	input_close_device(handle);
-	input_unregister_handle(handle);
-	kfree(handle);
+	return NOTIFY_OK;
 }
 
-static const struct input_device_id interactive_ids[] = {
-	{
-		.flags = INPUT_DEVICE_ID_MATCH_EVBIT |
-			 INPUT_DEVICE_ID_MATCH_ABSBIT,
-		.evbit = { BIT_MASK(EV_ABS) },
-		.absbit = { [BIT_WORD(ABS_MT_POSITION_X)] =
-			    BIT_MASK(ABS_MT_POSITION_X) |
-			    BIT_MASK(ABS_MT_POSITION_Y) },
-	}, /* multi-touch touchscreen */
-	{
-		.flags = INPUT_DEVICE_ID_MATCH_KEYBIT |
-			 INPUT_DEVICE_ID_MATCH_ABSBIT,
-		.keybit = { [BIT_WORD(BTN_TOUCH)] = BIT_MASK(BTN_TOUCH) },
-		.absbit = { [BIT_WORD(ABS_X)] =
-			    BIT_MASK(ABS_X) | BIT_MASK(ABS_Y) },
-	}, /* touchpad */
-};
-
-static struct input_handler interactive_input_handler = {
-	.event		= interactive_input_event,
-	.connect	= interactive_input_connect,
-	.disconnect	= interactive_input_disconnect,
-	.name		= "interactive",
-	.id_table	= interactive_ids,
+static struct notifier_block cpufreq_interactive_input_nb = {
+	.notifier_call = cpufreq_interactive_input_boost,
 };
 
 static int cpufreq_interactive_idle_notifier(struct notifier_block *nb,
@@ -1300,6 +1263,7 @@ static int cpufreq_governor_interactive(struct cpufreq_policy *policy,
 			down_write(&pcpu->enable_sem);
 			del_timer_sync(&pcpu->cpu_timer);
 			del_timer_sync(&pcpu->cpu_slack_timer);
+			pcpu->idle_suspended = 0;
 			cpufreq_interactive_timer_start(tunables, j);
 			pcpu->governor_enabled = 1;
 			up_write(&pcpu->enable_sem);
@@ -1385,7 +1349,7 @@ static void cpufreq_interactive_nop_timer(unsigned long data)
 
 static int __init cpufreq_interactive_init(void)
 {
-	unsigned int i, rc;
+	unsigned int i;
 	struct cpufreq_interactive_cpuinfo *pcpu;
 	struct sched_param param = { .sched_priority = MAX_RT_PRIO-1 };
 
@@ -1400,9 +1364,8 @@ static int __init cpufreq_interactive_init(void)
 		spin_lock_init(&pcpu->load_lock);
 		spin_lock_init(&pcpu->target_freq_lock);
 		init_rwsem(&pcpu->enable_sem);
-		if (!i)
-			rc = input_register_handler(&interactive_input_handler);
 	}
+	input_boost_register_notifier(&cpufreq_interactive_input_nb);
 
 	spin_lock_init(&speedchange_cpumask_lock);
 	mutex_init(&gov_lock);
@@ -1429,13 +1392,8 @@ module_init(cpufreq_interactive_init);
 
 static void __exit cpufreq_interactive_exit(void)
 {
-	unsigned int cpu;
-
 	cpufreq_unregister_governor(&cpufreq_gov_interactive);
-	for_each_possible_cpu(cpu) {
-		if(!cpu)
-			input_unregister_handler(&interactive_input_handler);
-	}
+	input_boost_unregister_notifier(&cpufreq_interactive_input_nb);
 	kthread_stop(speedchange_task);
 	put_task_struct(speedchange_task);
 }
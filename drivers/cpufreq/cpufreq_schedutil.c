@@ -0,0 +1,478 @@
+/*
+ * drivers/cpufreq/cpufreq_schedutil.c
+ *
+ * cpufreq governor driven by the scheduler's per-entity load tracking.
+ *
+ * This software is licensed under the terms of the GNU General Public
+ * License version 2, as published by the Free Software Foundation, and
+ * may be copied, distributed, and modified under those terms.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Instead of sampling idle time from a timer, the governor is called by
+ * the scheduler (see cpufreq_update_util()) whenever a CPU's runnable
+ * average is updated: on enqueue, dequeue, the scheduler tick and idle
+ * entry/exit.  The callback runs under the runqueue lock, so it only
+ * picks the next frequency and hands the transition to an RT kthread
+ * through irq_work.
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/cpumask.h>
+#include <linux/irq_work.h>
+#include <linux/kthread.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/sched.h>
+#include <linux/sched/rt.h>
+#include <linux/slab.h>
+#include <linux/spinlock.h>
+#include <linux/tick.h>
+
+#define DEFAULT_RATE_LIMIT_US	(1 * USEC_PER_MSEC)
+
+struct sugov_tunables {
+	int usage_count;
+	/* Minimum time between two frequency changes */
+	unsigned int rate_limit_us;
+};
+
+struct sugov_policy {
+	struct cpufreq_policy *policy;
+	struct sugov_tunables *tunables;
+
+	raw_spinlock_t update_lock;	/* protects the fields below */
+	u64 last_freq_update_time;
+	unsigned int next_freq;
+	bool work_in_progress;
+
+	struct irq_work irq_work;
+	struct task_struct *thread;
+	struct mutex work_lock;		/* serializes frequency transitions */
+};
+
+struct sugov_cpu {
+	struct update_util_data update_util;
+	struct sugov_policy *sg_policy;
+
+	/* Last utilization reported by the scheduler for this CPU */
+	unsigned long util;
+	unsigned long max;
+	u64 last_update;
+};
+
+static DEFINE_PER_CPU(struct sugov_cpu, sugov_cpu);
+
+static struct sugov_tunables *common_tunables;
+
+/************************ Governor internals ***********************/
+
+static bool sugov_should_update_freq(struct sugov_policy *sg_policy, u64 time)
+{
+	s64 delta_ns;
+
+	if (sg_policy->work_in_progress)
+		return false;
+
+	delta_ns = time - sg_policy->last_freq_update_time;
+	return delta_ns >= (s64)sg_policy->tunables->rate_limit_us *
+			NSEC_PER_USEC;
+}
+
+/*
+ * The runnable average is not frequency invariant: at a lower clock the
+ * same work keeps the CPU busy for longer.  Scaling the utilization by
+ * cur / max_freq makes it so, and the target then works out to
+ * 1.25 * max_freq * util_inv / max = 1.25 * cur * util / max, which
+ * leaves 20% headroom once the frequency has settled.
+ */
+static unsigned int sugov_get_next_freq(struct cpufreq_policy *policy,
+					unsigned long util, unsigned long max)
+{
+	unsigned int freq = policy->cur;
+
+	freq = div_u64((u64)(freq + (freq >> 2)) * util, max);
+	return clamp_val(freq, policy->min, policy->max);
+}
+
+/*
+ * Use the highest utilization of the CPUs sharing the policy, skipping
+ * CPUs that have not reported for a tick: they are idle with the tick
+ * stopped and their average no longer means anything.
+ */
+static unsigned int sugov_next_freq_shared(struct sugov_policy *sg_policy,
+					   u64 time)
+{
+	struct cpufreq_policy *policy = sg_policy->policy;
+	unsigned long util = 0, max = 1;
+	unsigned int j;
+
+	for_each_cpu(j, policy->cpus) {
+		struct sugov_cpu *j_sg_cpu = &per_cpu(sugov_cpu, j);
+		s64 delta_ns;
+
+		delta_ns = time - j_sg_cpu->last_update;
+		if (delta_ns > TICK_NSEC)
+			continue;
+
+		if (j_sg_cpu->util * max > j_sg_cpu->max * util) {
+			util = j_sg_cpu->util;
+			max = j_sg_cpu->max;
+		}
+	}
+
+	return sugov_get_next_freq(policy, util, max);
+}
+
+static void sugov_update(struct update_util_data *data, u64 time,
+			 unsigned long util, unsigned long max)
+{
+	struct sugov_cpu *sg_cpu = container_of(data, struct sugov_cpu,
+						update_util);
+	struct sugov_policy *sg_policy = sg_cpu->sg_policy;
+	unsigned int next_f;
+
+	raw_spin_lock(&sg_policy->update_lock);
+
+	sg_cpu->util = util;
+	sg_cpu->max = max;
+	sg_cpu->last_update = time;
+
+	if (!sugov_should_update_freq(sg_policy, time))
+		goto out;
+
+	next_f = sugov_next_freq_shared(sg_policy, time);
+	sg_policy->last_freq_update_time = time;
+	if (next_f == sg_policy->next_freq)
+		goto out;
+
+	sg_policy->next_freq = next_f;
+	sg_policy->work_in_progress = true;
+	irq_work_queue(&sg_policy->irq_work);
+out:
+	raw_spin_unlock(&sg_policy->update_lock);
+}
+
+static void sugov_irq_work(struct irq_work *irq_work)
+{
+	struct sugov_policy *sg_policy = container_of(irq_work,
+						struct sugov_policy, irq_work);
+
+	wake_up_process(sg_policy->thread);
+}
+
+static int sugov_thread(void *data)
+{
+	struct sugov_policy *sg_policy = data;
+	unsigned long flags;
+	unsigned int freq;
+
+	while (1) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!ACCESS_ONCE(sg_policy->work_in_progress)) {
+			if (kthread_should_stop())
+				break;
+			schedule();
+			continue;
+		}
+		__set_current_state(TASK_RUNNING);
+
+		mutex_lock(&sg_policy->work_lock);
+		raw_spin_lock_irqsave(&sg_policy->update_lock, flags);
+		freq = sg_policy->next_freq;
+		raw_spin_unlock_irqrestore(&sg_policy->update_lock, flags);
+
+		if (freq != sg_policy->policy->cur)
+			__cpufreq_driver_target(sg_policy->policy, freq,
+						CPUFREQ_RELATION_L);
+
+		raw_spin_lock_irqsave(&sg_policy->update_lock, flags);
+		sg_policy->work_in_progress = false;
+		raw_spin_unlock_irqrestore(&sg_policy->update_lock, flags);
+		mutex_unlock(&sg_policy->work_lock);
+	}
+	__set_current_state(TASK_RUNNING);
+
+	return 0;
+}
+
+/************************** sysfs interface ************************/
+
+static ssize_t show_rate_limit_us(struct sugov_tunables *tunables, char *buf)
+{
+	return sprintf(buf, "%u\n", tunables->rate_limit_us);
+}
+
+static ssize_t store_rate_limit_us(struct sugov_tunables *tunables,
+				   const char *buf, size_t count)
+{
+	unsigned int val;
+	int ret;
+
+	ret = kstrtouint(buf, 0, &val);
+	if (ret < 0)
+		return ret;
+	tunables->rate_limit_us = val;
+	return count;
+}
+
+/*
+ * Create show/store routines
+ * - sys: One governor instance for complete SYSTEM
+ * - pol: One governor instance per struct cpufreq_policy
+ */
+#define show_store_gov_pol_sys(file_name)				\
+static ssize_t show_##file_name##_gov_sys				\
+(struct kobject *kobj, struct attribute *attr, char *buf)		\
+{									\
+	return show_##file_name(common_tunables, buf);			\
+}									\
+									\
+static ssize_t show_##file_name##_gov_pol				\
+(struct cpufreq_policy *policy, char *buf)				\
+{									\
+	struct sugov_policy *sg_policy = policy->governor_data;		\
+									\
+	return show_##file_name(sg_policy->tunables, buf);		\
+}									\
+									\
+static ssize_t store_##file_name##_gov_sys				\
+(struct kobject *kobj, struct attribute *attr, const char *buf,		\
+	size_t count)							\
+{									\
+	return store_##file_name(common_tunables, buf, count);		\
+}									\
+									\
+static ssize_t store_##file_name##_gov_pol				\
+(struct cpufreq_policy *policy, const char *buf, size_t count)		\
+{									\
+	struct sugov_policy *sg_policy = policy->governor_data;		\
+									\
+	return store_##file_name(sg_policy->tunables, buf, count);	\
+}
+
+show_store_gov_pol_sys(rate_limit_us);
+
+static struct global_attr rate_limit_us_gov_sys =
+	__ATTR(rate_limit_us, 0644, show_rate_limit_us_gov_sys,
+	       store_rate_limit_us_gov_sys);
+
+static struct freq_attr rate_limit_us_gov_pol =
+	__ATTR(rate_limit_us, 0644, show_rate_limit_us_gov_pol,
+	       store_rate_limit_us_gov_pol);
+
+/* One Governor instance for entire system */
+static struct attribute *sugov_attributes_gov_sys[] = {
+	&rate_limit_us_gov_sys.attr,
+	NULL,
+};
+
+static struct attribute_group sugov_attr_group_gov_sys = {
+	.attrs = sugov_attributes_gov_sys,
+	.name = "schedutil",
+};
+
+/* Per policy governor instance */
+static struct attribute *sugov_attributes_gov_pol[] = {
+	&rate_limit_us_gov_pol.attr,
+	NULL,
+};
+
+static struct attribute_group sugov_attr_group_gov_pol = {
+	.attrs = sugov_attributes_gov_pol,
+	.name = "schedutil",
+};
+
+static struct attribute_group *get_sysfs_attr(void)
+{
+	if (have_governor_per_policy())
+		return &sugov_attr_group_gov_pol;
+	else
+		return &sugov_attr_group_gov_sys;
+}
+
+/********************** cpufreq governor interface *********************/
+
+static int sugov_policy_init(struct cpufreq_policy *policy)
+{
+	struct sched_param param = { .sched_priority = MAX_RT_PRIO / 2 };
+	struct sugov_policy *sg_policy;
+	struct sugov_tunables *tunables;
+	int rc;
+
+	sg_policy = kzalloc(sizeof(*sg_policy), GFP_KERNEL);
+	if (!sg_policy)
+		return -ENOMEM;
+
+	sg_policy->policy = policy;
+	raw_spin_lock_init(&sg_policy->update_lock);
+	mutex_init(&sg_policy->work_lock);
+	init_irq_work(&sg_policy->irq_work, sugov_irq_work);
+
+	sg_policy->thread = kthread_create(sugov_thread, sg_policy,
+					   "sugov:%u", policy->cpu);
+	if (IS_ERR(sg_policy->thread)) {
+		rc = PTR_ERR(sg_policy->thread);
+		pr_err("%s: failed to create sugov thread: %d\n",
+		       __func__, rc);
+		goto free_policy;
+	}
+	sched_setscheduler_nocheck(sg_policy->thread, SCHED_FIFO, &param);
+	get_task_struct(sg_policy->thread);
+	/* NB: wake up so the thread does not look hung to the freezer */
+	wake_up_process(sg_policy->thread);
+
+	if (!have_governor_per_policy() && common_tunables) {
+		common_tunables->usage_count++;
+		sg_policy->tunables = common_tunables;
+		policy->governor_data = sg_policy;
+		return 0;
+	}
+
+	tunables = kzalloc(sizeof(*tunables), GFP_KERNEL);
+	if (!tunables) {
+		rc = -ENOMEM;
+		goto stop_thread;
+	}
+	tunables->usage_count = 1;
+	tunables->rate_limit_us = DEFAULT_RATE_LIMIT_US;
+
+	sg_policy->tunables = tunables;
+	policy->governor_data = sg_policy;
+	if (!have_governor_per_policy())
+		common_tunables = tunables;
+
+	rc = sysfs_create_group(get_governor_parent_kobj(policy),
+				get_sysfs_attr());
+	if (rc) {
+		policy->governor_data = NULL;
+		if (!have_governor_per_policy())
+			common_tunables = NULL;
+		kfree(tunables);
+		goto stop_thread;
+	}
+
+	return 0;
+
+stop_thread:
+	kthread_stop(sg_policy->thread);
+	put_task_struct(sg_policy->thread);
+free_policy:
+	kfree(sg_policy);
+	return rc;
+}
+
+static void sugov_policy_exit(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	struct sugov_tunables *tunables = sg_policy->tunables;
+
+	if (!--tunables->usage_count) {
+		sysfs_remove_group(get_governor_parent_kobj(policy),
+				   get_sysfs_attr());
+		if (!have_governor_per_policy())
+			common_tunables = NULL;
+		kfree(tunables);
+	}
+
+	policy->governor_data = NULL;
+	kthread_stop(sg_policy->thread);
+	put_task_struct(sg_policy->thread);
+	kfree(sg_policy);
+}
+
+static void sugov_start(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	sg_policy->last_freq_update_time = 0;
+	sg_policy->next_freq = UINT_MAX;
+	sg_policy->work_in_progress = false;
+
+	for_each_cpu(cpu, policy->cpus) {
+		struct sugov_cpu *sg_cpu = &per_cpu(sugov_cpu, cpu);
+
+		sg_cpu->sg_policy = sg_policy;
+		sg_cpu->util = 0;
+		sg_cpu->max = 0;
+		sg_cpu->last_update = 0;
+		sg_cpu->update_util.func = sugov_update;
+		cpufreq_set_update_util_data(cpu, &sg_cpu->update_util);
+	}
+}
+
+static void sugov_stop(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+	unsigned int cpu;
+
+	for_each_cpu(cpu, policy->cpus)
+		cpufreq_set_update_util_data(cpu, NULL);
+
+	synchronize_sched();
+
+	irq_work_sync(&sg_policy->irq_work);
+	/* Wait for a transition that is still in flight */
+	mutex_lock(&sg_policy->work_lock);
+	mutex_unlock(&sg_policy->work_lock);
+}
+
+static void sugov_limits(struct cpufreq_policy *policy)
+{
+	struct sugov_policy *sg_policy = policy->governor_data;
+
+	mutex_lock(&sg_policy->work_lock);
+	if (policy->max < policy->cur)
+		__cpufreq_driver_target(policy, policy->max,
+					CPUFREQ_RELATION_H);
+	else if (policy->min > policy->cur)
+		__cpufreq_driver_target(policy, policy->min,
+					CPUFREQ_RELATION_L);
+	mutex_unlock(&sg_policy->work_lock);
+}
+
+static int cpufreq_governor_schedutil(struct cpufreq_policy *policy,
+				      unsigned int event)
+{
+	switch (event) {
+	case CPUFREQ_GOV_POLICY_INIT:
+		return sugov_policy_init(policy);
+	case CPUFREQ_GOV_POLICY_EXIT:
+		sugov_policy_exit(policy);
+		break;
+	case CPUFREQ_GOV_START:
+		sugov_start(policy);
+		break;
+	case CPUFREQ_GOV_STOP:
+		sugov_stop(policy);
+		break;
+	case CPUFREQ_GOV_LIMITS:
+		sugov_limits(policy);
+		break;
+	}
+	return 0;
+}
+
+#ifndef CONFIG_CPU_FREQ_DEFAULT_GOV_SCHEDUTIL
+static
+#endif
+struct cpufreq_governor cpufreq_gov_schedutil = {
+	.name = "schedutil",
+	.governor = cpufreq_governor_schedutil,
+	.max_transition_latency = 10000000,
+	.owner = THIS_MODULE,
+};
+
+static int __init cpufreq_schedutil_init(void)
+{
+	return cpufreq_register_governor(&cpufreq_gov_schedutil);
+}
+fs_initcall(cpufreq_schedutil_init);
+
+MODULE_DESCRIPTION("'schedutil' - A cpufreq governor driven by scheduler "
+	"utilization");
+MODULE_LICENSE("GPL");
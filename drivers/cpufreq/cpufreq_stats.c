@@ -13,7 +13,10 @@
 #include <linux/cpufreq.h>
 #include <linux/module.h>
 #include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
 #include <asm/cputime.h>
+#include <asm/div64.h>
 
 static spinlock_t cpufreq_stats_lock;
 
@@ -29,6 +32,11 @@ struct cpufreq_stats {
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	unsigned int *trans_table;
 #endif
+	/* PRECHANGE to POSTCHANGE, i.e. how long the driver took to switch */
+	ktime_t trans_start;
+	unsigned int lat_count;
+	u64 lat_total_ns;
+	u64 lat_max_ns;
 };
 
 static DEFINE_PER_CPU(struct cpufreq_stats *, cpufreq_stats_table);
@@ -79,6 +87,38 @@ static ssize_t show_time_in_state(struct cpufreq_policy *policy, char *buf)
 	return len;
 }
 
+static ssize_t show_trans_latency_avg(struct cpufreq_policy *policy,
+				      char *buf)
+{
+	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, policy->cpu);
+	u64 avg;
+
+	if (!stat)
+		return 0;
+	spin_lock(&cpufreq_stats_lock);
+	avg = stat->lat_total_ns;
+	if (stat->lat_count)
+		do_div(avg, stat->lat_count);
+	spin_unlock(&cpufreq_stats_lock);
+	do_div(avg, NSEC_PER_USEC);
+	return sprintf(buf, "%llu\n", avg);
+}
+
+static ssize_t show_trans_latency_max(struct cpufreq_policy *policy,
+				      char *buf)
+{
+	struct cpufreq_stats *stat = per_cpu(cpufreq_stats_table, policy->cpu);
+	u64 max;
+
+	if (!stat)
+		return 0;
+	spin_lock(&cpufreq_stats_lock);
+	max = stat->lat_max_ns;
+	spin_unlock(&cpufreq_stats_lock);
+	do_div(max, NSEC_PER_USEC);
+	return sprintf(buf, "%llu\n", max);
+}
+
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 static ssize_t show_trans_table(struct cpufreq_policy *policy, char *buf)
 {
@@ -128,10 +168,14 @@ cpufreq_freq_attr_ro(trans_table);
 
 cpufreq_freq_attr_ro(total_trans);
 cpufreq_freq_attr_ro(time_in_state);
+cpufreq_freq_attr_ro(trans_latency_avg);
+cpufreq_freq_attr_ro(trans_latency_max);
 
 static struct attribute *default_attrs[] = {
 	&total_trans.attr,
 	&time_in_state.attr,
+	&trans_latency_avg.attr,
+	&trans_latency_max.attr,
 #ifdef CONFIG_CPU_FREQ_STAT_DETAILS
 	&trans_table.attr,
 #endif
@@ -311,14 +355,30 @@ static int cpufreq_stat_notifier_trans(struct notifier_block *nb,
 	struct cpufreq_freqs *freq = data;
 	struct cpufreq_stats *stat;
 	int old_index, new_index;
-
-	if (val != CPUFREQ_POSTCHANGE)
-		return 0;
+	u64 lat;
 
 	stat = per_cpu(cpufreq_stats_table, freq->cpu);
 	if (!stat)
 		return 0;
 
+	if (val == CPUFREQ_PRECHANGE) {
+		stat->trans_start = ktime_get();
+		return 0;
+	}
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return 0;
+
+	if (stat->trans_start.tv64) {
+		lat = ktime_to_ns(ktime_sub(ktime_get(), stat->trans_start));
+		stat->trans_start.tv64 = 0;
+		spin_lock(&cpufreq_stats_lock);
+		stat->lat_count++;
+		stat->lat_total_ns += lat;
+		stat->lat_max_ns = max(stat->lat_max_ns, lat);
+		spin_unlock(&cpufreq_stats_lock);
+	}
+
 	old_index = stat->last_index;
 	new_index = freq_table_get_index(stat, freq->new);
 
@@ -0,0 +1,464 @@
+/*
+ * Per-UID cpufreq time_in_state accounting
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * Every task carries an array of nanoseconds spent at each frequency and
+ * at each number of concurrently busy CPUs. It is charged at context
+ * switch. A frequency transition only splits the running slice of that
+ * CPU, and the split is charged at the next switch. When a task is
+ * released its counters are folded into its UID. Readers add the
+ * counters of live tasks on top.
+ *
+ * /proc/uid_time_in_state is a binary snapshot. All fields are native
+ * endian:
+ *
+ *	u32 version, nr_freqs, nr_cpus, nr_uids
+ *	u32 freq[nr_freqs]		kHz, ascending, padded to 8 bytes
+ *	nr_uids records of:
+ *		u32 uid, u32 reserved
+ *		u64 time[nr_freqs]	ns at freq[i]
+ *		u64 concurrent[nr_cpus]	ns while i + 1 CPUs were busy
+ */
+
+#define pr_fmt(fmt) "cpufreq_times: " fmt
+
+#include <linux/cpufreq.h>
+#include <linux/cpufreq_times.h>
+#include <linux/hashtable.h>
+#include <linux/init.h>
+#include <linux/kernel.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/seqlock.h>
+#include <linux/slab.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+
+#define UID_TIS_VERSION		1
+#define UID_HASH_BITS		10
+
+struct cpufreq_task_times {
+	seqcount_t seq;
+	/* nr_freqs frequency slots followed by nr_cpus concurrency slots */
+	u64 time[0];
+};
+
+struct uid_tis_entry {
+	uid_t uid;
+	struct hlist_node hash;
+	/* released tasks, then a scratch copy used while reading */
+	u64 time[0];
+};
+
+struct cpu_times_state {
+	raw_spinlock_t lock;
+	unsigned int freq_idx;
+	u64 seg_start;
+	u64 slice_start;
+	bool split;
+	u64 *pending;
+};
+
+static DEFINE_PER_CPU(struct cpu_times_state, cpu_times_state);
+static atomic_t nr_busy_cpus;
+
+static unsigned int *freqs;
+static unsigned int nr_freqs;
+static unsigned int nr_slots;
+static bool times_ready;
+
+static DEFINE_HASHTABLE(uid_hash_table, UID_HASH_BITS);
+static DEFINE_SPINLOCK(uid_lock);
+static DEFINE_MUTEX(uid_read_lock);
+static unsigned int nr_uids;
+
+static unsigned int freq_to_idx(unsigned int freq)
+{
+	unsigned int i;
+
+	for (i = 0; i < nr_freqs - 1; i++)
+		if (freqs[i] >= freq)
+			break;
+	return i;
+}
+
+static struct uid_tis_entry *find_or_register_uid(uid_t uid)
+{
+	struct uid_tis_entry *e;
+
+	hash_for_each_possible(uid_hash_table, e, hash, uid) {
+		if (e->uid == uid)
+			return e;
+	}
+
+	e = kzalloc(sizeof(*e) + 2 * nr_slots * sizeof(u64), GFP_ATOMIC);
+	if (!e)
+		return NULL;
+
+	e->uid = uid;
+	hash_add(uid_hash_table, &e->hash, uid);
+	nr_uids++;
+
+	return e;
+}
+
+/* the seqcount only keeps each 64-bit counter from tearing on 32-bit */
+static void add_task_times(struct cpufreq_task_times *t, u64 *out)
+{
+	unsigned int seq, i;
+	u64 v;
+
+	for (i = 0; i < nr_slots; i++) {
+		do {
+			seq = read_seqcount_begin(&t->seq);
+			v = t->time[i];
+		} while (read_seqcount_retry(&t->seq, seq));
+		out[i] += v;
+	}
+}
+
+void cpufreq_task_times_alloc(struct task_struct *p)
+{
+	p->cpufreq_times = NULL;
+	if (!ACCESS_ONCE(times_ready))
+		return;
+
+	p->cpufreq_times = kzalloc(sizeof(*p->cpufreq_times) +
+				   nr_slots * sizeof(u64), GFP_KERNEL);
+	if (p->cpufreq_times)
+		seqcount_init(&p->cpufreq_times->seq);
+}
+
+void cpufreq_task_times_free(struct task_struct *p)
+{
+	kfree(p->cpufreq_times);
+	p->cpufreq_times = NULL;
+}
+
+/* called from release_task(), once @p is off the thread lists */
+void cpufreq_task_times_exit(struct task_struct *p)
+{
+	struct uid_tis_entry *e;
+
+	if (!p->cpufreq_times)
+		return;
+
+	spin_lock(&uid_lock);
+	e = find_or_register_uid(from_kuid_munged(&init_user_ns,
+						  task_uid(p)));
+	if (e)
+		add_task_times(p->cpufreq_times, e->time);
+	spin_unlock(&uid_lock);
+}
+
+/* called from __schedule() with the rq lock held */
+void cpufreq_task_times_switch(struct task_struct *prev,
+			       struct task_struct *next)
+{
+	struct cpu_times_state *st = this_cpu_ptr(&cpu_times_state);
+	struct cpufreq_task_times *t = prev->cpufreq_times;
+	bool prev_idle = is_idle_task(prev);
+	bool next_idle = is_idle_task(next);
+	unsigned int i, busy;
+	u64 now;
+
+	/*
+	 * Kept from boot so it is right once accounting starts. busy is the
+	 * count during prev's slice, before this switch.
+	 */
+	if (prev_idle && !next_idle)
+		busy = atomic_inc_return(&nr_busy_cpus) - 1;
+	else if (!prev_idle && next_idle)
+		busy = atomic_dec_return(&nr_busy_cpus) + 1;
+	else
+		busy = atomic_read(&nr_busy_cpus);
+
+	if (!ACCESS_ONCE(times_ready))
+		return;
+	smp_rmb();
+
+	now = sched_clock();
+	busy = clamp_t(int, busy, 1, nr_cpu_ids);
+
+	raw_spin_lock(&st->lock);
+	if (t && !prev_idle) {
+		write_seqcount_begin(&t->seq);
+		t->time[st->freq_idx] += now - st->seg_start;
+		if (st->split) {
+			for (i = 0; i < nr_freqs; i++)
+				t->time[i] += st->pending[i];
+		}
+		t->time[nr_freqs + busy - 1] += now - st->slice_start;
+		write_seqcount_end(&t->seq);
+	}
+	if (st->split) {
+		memset(st->pending, 0, nr_freqs * sizeof(u64));
+		st->split = false;
+	}
+	st->seg_start = now;
+	st->slice_start = now;
+	raw_spin_unlock(&st->lock);
+}
+
+static int cpufreq_times_transition(struct notifier_block *nb,
+				    unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freq = data;
+	struct cpu_times_state *st = &per_cpu(cpu_times_state, freq->cpu);
+	unsigned long flags;
+	u64 now;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return NOTIFY_OK;
+
+	raw_spin_lock_irqsave(&st->lock, flags);
+	now = sched_clock();
+	st->pending[st->freq_idx] += now - st->seg_start;
+	st->seg_start = now;
+	st->split = true;
+	st->freq_idx = freq_to_idx(freq->new);
+	raw_spin_unlock_irqrestore(&st->lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cpufreq_times_nb = {
+	.notifier_call = cpufreq_times_transition,
+};
+
+/**
+ * cpufreq_times_remove_uids - drop the records of a range of UIDs
+ * @uid_start: first UID to drop
+ * @uid_end: last UID to drop
+ *
+ * Used by uid_cputime's remove_uid_range when an app is uninstalled.
+ */
+void cpufreq_times_remove_uids(uid_t uid_start, uid_t uid_end)
+{
+	struct uid_tis_entry *e;
+	struct hlist_node *tmp;
+	u64 uid;
+
+	spin_lock(&uid_lock);
+	for (uid = uid_start; uid <= uid_end; uid++) {
+		hash_for_each_possible_safe(uid_hash_table, e, tmp,
+					    hash, uid) {
+			if (e->uid != uid)
+				continue;
+			hash_del(&e->hash);
+			kfree(e);
+			nr_uids--;
+		}
+	}
+	spin_unlock(&uid_lock);
+}
+
+struct uid_tis_header {
+	u32 version;
+	u32 nr_freqs;
+	u32 nr_cpus;
+	u32 nr_uids;
+};
+
+struct uid_tis_snapshot {
+	size_t size;
+	char buf[0];
+};
+
+static int uid_time_in_state_open(struct inode *inode, struct file *file)
+{
+	struct uid_tis_snapshot *snap = NULL;
+	struct uid_tis_header *hdr;
+	struct task_struct *g, *task;
+	struct uid_tis_entry *e;
+	size_t freq_bytes, rec_bytes, size;
+	unsigned long bkt;
+	unsigned int n;
+	char *pos;
+	int ret = 0;
+
+	mutex_lock(&uid_read_lock);
+
+	/*
+	 * Add the live tasks into each UID's scratch slots. This also
+	 * registers their UIDs, so the snapshot can be sized afterwards.
+	 */
+	read_lock(&tasklist_lock);
+	spin_lock(&uid_lock);
+	hash_for_each(uid_hash_table, bkt, e, hash)
+		memset(&e->time[nr_slots], 0, nr_slots * sizeof(u64));
+	do_each_thread(g, task) {
+		if (!task->cpufreq_times)
+			continue;
+		e = find_or_register_uid(from_kuid_munged(&init_user_ns,
+							  task_uid(task)));
+		if (!e) {
+			ret = -ENOMEM;
+			goto out_unlock;
+		}
+		add_task_times(task->cpufreq_times, &e->time[nr_slots]);
+	} while_each_thread(g, task);
+	spin_unlock(&uid_lock);
+	read_unlock(&tasklist_lock);
+
+	freq_bytes = ALIGN(nr_freqs * sizeof(u32), sizeof(u64));
+	rec_bytes = 2 * sizeof(u32) + nr_slots * sizeof(u64);
+	size = sizeof(*hdr) + freq_bytes + ACCESS_ONCE(nr_uids) * rec_bytes;
+
+	snap = vzalloc(sizeof(*snap) + size);
+	if (!snap) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	hdr = (struct uid_tis_header *)snap->buf;
+	hdr->version = UID_TIS_VERSION;
+	hdr->nr_freqs = nr_freqs;
+	hdr->nr_cpus = nr_slots - nr_freqs;
+	memcpy(hdr + 1, freqs, nr_freqs * sizeof(u32));
+	pos = snap->buf + sizeof(*hdr) + freq_bytes;
+
+	n = 0;
+	spin_lock(&uid_lock);
+	hash_for_each(uid_hash_table, bkt, e, hash) {
+		u32 *id = (u32 *)pos;
+		u64 *t = (u64 *)(pos + 2 * sizeof(u32));
+		unsigned int i;
+
+		/* UIDs registered by an exit since the sizing pass */
+		if (pos + rec_bytes > snap->buf + size)
+			break;
+		id[0] = e->uid;
+		for (i = 0; i < nr_slots; i++)
+			t[i] = e->time[i] + e->time[nr_slots + i];
+		pos += rec_bytes;
+		n++;
+	}
+	spin_unlock(&uid_lock);
+
+	hdr->nr_uids = n;
+	snap->size = pos - snap->buf;
+	file->private_data = snap;
+	goto out;
+
+out_unlock:
+	spin_unlock(&uid_lock);
+	read_unlock(&tasklist_lock);
+out:
+	mutex_unlock(&uid_read_lock);
+	return ret;
+}
+
+static ssize_t uid_time_in_state_read(struct file *file, char __user *buf,
+				      size_t count, loff_t *ppos)
+{
+	struct uid_tis_snapshot *snap = file->private_data;
+
+	return simple_read_from_buffer(buf, count, ppos, snap->buf,
+				       snap->size);
+}
+
+static int uid_time_in_state_release(struct inode *inode, struct file *file)
+{
+	vfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations uid_time_in_state_fops = {
+	.open		= uid_time_in_state_open,
+	.read		= uid_time_in_state_read,
+	.llseek		= default_llseek,
+	.release	= uid_time_in_state_release,
+};
+
+static int cmp_freq(const void *a, const void *b)
+{
+	return *(const unsigned int *)a - *(const unsigned int *)b;
+}
+
+/* collect the distinct frequencies from every CPU's table, ascending */
+static int __init cpufreq_times_init_freqs(void)
+{
+	struct cpufreq_frequency_table *table;
+	unsigned int cpu, i, j, n = 0;
+
+	for_each_possible_cpu(cpu) {
+		table = cpufreq_frequency_get_table(cpu);
+		if (!table)
+			continue;
+		for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++)
+			n++;
+	}
+	if (!n)
+		return -ENODEV;
+
+	freqs = kcalloc(n, sizeof(*freqs), GFP_KERNEL);
+	if (!freqs)
+		return -ENOMEM;
+
+	for_each_possible_cpu(cpu) {
+		table = cpufreq_frequency_get_table(cpu);
+		if (!table)
+			continue;
+		for (i = 0; table[i].frequency != CPUFREQ_TABLE_END; i++) {
+			if (table[i].frequency == CPUFREQ_ENTRY_INVALID)
+				continue;
+			for (j = 0; j < nr_freqs; j++)
+				if (freqs[j] == table[i].frequency)
+					break;
+			if (j == nr_freqs)
+				freqs[nr_freqs++] = table[i].frequency;
+		}
+	}
+	if (!nr_freqs)
+		return -ENODEV;
+
+	sort(freqs, nr_freqs, sizeof(*freqs), cmp_freq, NULL);
+	nr_slots = nr_freqs + nr_cpu_ids;
+
+	return 0;
+}
+
+static int __init cpufreq_times_init(void)
+{
+	struct cpu_times_state *st;
+	unsigned int cpu;
+	u64 now;
+	int ret;
+
+	ret = cpufreq_times_init_freqs();
+	if (ret) {
+		pr_err("no frequency table: %d\n", ret);
+		return ret;
+	}
+
+	now = sched_clock();
+	for_each_possible_cpu(cpu) {
+		st = &per_cpu(cpu_times_state, cpu);
+		raw_spin_lock_init(&st->lock);
+		st->pending = kcalloc(nr_freqs, sizeof(u64), GFP_KERNEL);
+		if (!st->pending)
+			return -ENOMEM;
+		st->freq_idx = freq_to_idx(cpufreq_quick_get(cpu));
+		st->seg_start = now;
+		st->slice_start = now;
+	}
+	cpufreq_register_notifier(&cpufreq_times_nb,
+				  CPUFREQ_TRANSITION_NOTIFIER);
+	proc_create("uid_time_in_state", S_IRUGO, NULL,
+		    &uid_time_in_state_fops);
+
+	smp_wmb();
+	times_ready = true;
+
+	return 0;
+}
+late_initcall(cpufreq_times_init);
@@ -21,7 +21,7 @@
 #include <linux/module.h>
 #include <linux/cpufreq.h>
 #include <linux/workqueue.h>
-#include <linux/completion.h>
+#include <linux/spinlock.h>
 #include <linux/cpu.h>
 #include <linux/cpumask.h>
 #include <linux/sched.h>
@@ -51,15 +51,27 @@ static unsigned int *l2_khz;
 static bool is_sync;
 static unsigned long *mem_bw;
 
+/*
+ * frequency and index hold the latest request. If requests arrive while
+ * a switch is in progress, only the newest one is applied after it.
+ */
 struct cpufreq_work_struct {
 	struct work_struct work;
 	struct cpufreq_policy *policy;
-	struct completion complete;
+	spinlock_t lock;
+	bool pending;
 	int frequency;
 	unsigned int index;
 	int status;
 };
 
+/*
+ * When set, ->target only queues the request and returns. Completion is
+ * reported through the CPUFREQ_POSTCHANGE transition notifier.
+ */
+static bool async_switch = true;
+module_param(async_switch, bool, 0644);
+
 static DEFINE_PER_CPU(struct cpufreq_work_struct, cpufreq_work);
 static struct workqueue_struct *msm_cpufreq_wq;
 
@@ -156,10 +168,27 @@ static void set_cpu_work(struct work_struct *work)
 {
 	struct cpufreq_work_struct *cpu_work =
 		container_of(work, struct cpufreq_work_struct, work);
+	struct cpufreq_policy *policy;
+	unsigned int frequency, index;
 
-	cpu_work->status = set_cpu_freq(cpu_work->policy, cpu_work->frequency,
-					cpu_work->index);
-	complete(&cpu_work->complete);
+	for (;;) {
+		spin_lock(&cpu_work->lock);
+		if (!cpu_work->pending) {
+			spin_unlock(&cpu_work->lock);
+			break;
+		}
+		cpu_work->pending = false;
+		policy = cpu_work->policy;
+		frequency = cpu_work->frequency;
+		index = cpu_work->index;
+		spin_unlock(&cpu_work->lock);
+
+		if (frequency == policy->cur) {
+			cpu_work->status = 0;
+			continue;
+		}
+		cpu_work->status = set_cpu_freq(policy, frequency, index);
+	}
 }
 
 static int msm_cpufreq_target(struct cpufreq_policy *policy,
@@ -194,16 +223,21 @@ static int msm_cpufreq_target(struct cpufreq_policy *policy,
 		policy->min, policy->max, table[index].frequency);
 
 	cpu_work = &per_cpu(cpufreq_work, policy->cpu);
+	spin_lock(&cpu_work->lock);
 	cpu_work->policy = policy;
 	cpu_work->frequency = table[index].frequency;
 	cpu_work->index = table[index].driver_data;
-	cpu_work->status = -ENODEV;
+	cpu_work->pending = true;
+	spin_unlock(&cpu_work->lock);
 
-	cancel_work_sync(&cpu_work->work);
-	INIT_COMPLETION(cpu_work->complete);
 	queue_work_on(policy->cpu, msm_cpufreq_wq, &cpu_work->work);
-	wait_for_completion(&cpu_work->complete);
 
+	if (async_switch) {
+		ret = 0;
+		goto done;
+	}
+
+	flush_work(&cpu_work->work);
 	ret = cpu_work->status;
 
 done:
@@ -231,7 +265,6 @@ static int msm_cpufreq_init(struct cpufreq_policy *policy)
 	int index;
 	int ret = 0;
 	struct cpufreq_frequency_table *table;
-	struct cpufreq_work_struct *cpu_work = NULL;
 
 	table = cpufreq_frequency_get_table(policy->cpu);
 	if (table == NULL)
@@ -244,10 +277,6 @@ static int msm_cpufreq_init(struct cpufreq_policy *policy)
 	if (is_sync)
 		cpumask_setall(policy->cpus);
 
-	cpu_work = &per_cpu(cpufreq_work, policy->cpu);
-	INIT_WORK(&cpu_work->work, set_cpu_work);
-	init_completion(&cpu_work->complete);
-
 	/* synchronous cpus share the same policy */
 	if (!cpu_clk[policy->cpu])
 		return 0;
@@ -306,6 +335,8 @@ static int msm_cpufreq_cpu_callback(struct notifier_block *nfb,
 		mutex_lock(&per_cpu(cpufreq_suspend, cpu).suspend_mutex);
 		per_cpu(cpufreq_suspend, cpu).device_suspended = 1;
 		mutex_unlock(&per_cpu(cpufreq_suspend, cpu).suspend_mutex);
+		if (msm_cpufreq_wq)
+			flush_work(&per_cpu(cpufreq_work, cpu).work);
 		break;
 	case CPU_DOWN_FAILED:
 		per_cpu(cpufreq_suspend, cpu).device_suspended = 0;
@@ -351,6 +382,7 @@ static int msm_cpufreq_suspend(void)
 		per_cpu(cpufreq_suspend, cpu).device_suspended = 1;
 		mutex_unlock(&per_cpu(cpufreq_suspend, cpu).suspend_mutex);
 	}
+	flush_workqueue(msm_cpufreq_wq);
 
 	return NOTIFY_DONE;
 }
@@ -596,6 +628,8 @@ static int __init msm_cpufreq_register(void)
 	for_each_possible_cpu(cpu) {
 		mutex_init(&(per_cpu(cpufreq_suspend, cpu).suspend_mutex));
 		per_cpu(cpufreq_suspend, cpu).device_suspended = 0;
+		INIT_WORK(&per_cpu(cpufreq_work, cpu).work, set_cpu_work);
+		spin_lock_init(&per_cpu(cpufreq_work, cpu).lock);
 	}
 
 	rc = platform_driver_probe(&msm_cpufreq_plat_driver,
@@ -26,10 +26,13 @@
 #include <linux/suspend.h>
 #include <linux/pm_qos.h>
 #include <linux/of_platform.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <soc/qcom/spm.h>
 #include <soc/qcom/pm.h>
 #include <soc/qcom/rpm-notifier.h>
 #include <soc/qcom/event_timer.h>
+#include <trace/events/trace_msm_low_power.h>
 
 #define SCLK_HZ (32768)
 
@@ -52,6 +55,15 @@ struct lpm_cpu_level {
 	bool use_bc_timer;
 };
 
+struct lpm_level_stats {
+	uint32_t count;
+	uint64_t residency_ns;
+	uint64_t entry_ns;
+	uint64_t exit_ns;
+	uint32_t max_entry_ns;
+	uint32_t max_exit_ns;
+};
+
 struct lpm_system_level {
 	const char *name;
 	uint32_t l2_mode;
@@ -61,6 +73,23 @@ struct lpm_system_level {
 	bool notify_rpm;
 	bool available;
 	bool sync_level;
+	struct lpm_level_stats stats;
+};
+
+/*
+ * Inputs of the last system level decision.  The decision only depends
+ * on these, so the last cpu down reuses it while they are unchanged.
+ */
+struct lpm_select_cache {
+	bool valid;
+	bool from_idle;
+	bool suspend;
+	unsigned int gen;
+	unsigned int online;
+	uint32_t horizon;
+	uint32_t latency_us;
+	uint32_t votes;
+	int index;
 };
 
 struct lpm_system_state {
@@ -74,8 +103,15 @@ struct lpm_system_state {
 	bool no_l2_saw;
 	spinlock_t sync_lock;
 	struct cpumask num_cores_in_sync;
+	struct lpm_select_cache cache;
+	unsigned int level_gen;
+	int64_t prepare_start_ns;
+	int64_t sleep_start_ns;
 };
 
+/* granularity of the cached sleep horizon, 2^6 us */
+#define LPM_HORIZON_SHIFT 6
+
 static struct lpm_system_state sys_state;
 static bool suspend_in_progress;
 static int64_t suspend_time;
@@ -119,14 +155,85 @@ static int msm_pm_sleep_time_override;
 module_param_named(sleep_time_override,
 	msm_pm_sleep_time_override, int, S_IRUGO | S_IWUSR | S_IWGRP);
 
+static bool lpm_prediction = true;
+module_param_named(lpm_prediction,
+	lpm_prediction, bool, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/*
+ * Recent idle residencies of a cpu, used to predict the next one when
+ * wakeups are driven by interrupts rather than by the timer hint.
+ */
+#define LPM_HISTORY_SIZE 8
+
+struct lpm_history {
+	uint32_t resi[LPM_HISTORY_SIZE];
+	int nsamp;
+	int hptr;
+	bool predicted;
+	struct hrtimer histtimer;
+	bool histtimer_fired;
+	/* expected wakeup of a cpu in a cluster sync mode */
+	ktime_t next_wakeup;
+};
+
+static DEFINE_PER_CPU(struct lpm_history, lpm_hist);
+
+/* Per level selection outcome, compared with the residency achieved */
+struct lpm_pred_stats {
+	uint32_t entered;
+	uint32_t predicted;
+	uint32_t too_deep;
+	uint32_t too_shallow;
+};
+
+static DEFINE_PER_CPU(struct lpm_pred_stats [CPUIDLE_STATE_MAX],
+		lpm_pred_stats);
+
+/*
+ * Per cpu, per level idle accounting.  The wake latency is the time from
+ * the expiry of the timer that ended the idle period to the idle exit,
+ * and is only sampled when the cpu stayed idle until that timer.
+ */
+struct lpm_cpu_stats {
+	uint64_t entries;
+	uint64_t aborts;
+	uint64_t residency_ns;
+	uint64_t wake_lat_ns;
+	uint32_t wake_lat_count;
+	uint32_t wake_lat_max_ns;
+};
+
+static DEFINE_PER_CPU(struct lpm_cpu_stats [CPUIDLE_STATE_MAX],
+		lpm_cpu_stats);
+
 static struct cpumask num_powered_cores;
 static struct hrtimer lpm_hrtimer;
 
 static struct kobj_attribute lpm_l2_kattr = __ATTR(l2,  S_IRUGO|S_IWUSR,\
 		lpm_levels_attr_show, lpm_levels_attr_store);
 
+static ssize_t lpm_pred_stats_show(
+	struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t lpm_pred_stats_store(struct kobject *kobj,
+	struct kobj_attribute *attr, const char *buf, size_t count);
+
+static struct kobj_attribute lpm_pred_stats_kattr =
+	__ATTR(prediction_stats, S_IRUGO|S_IWUSR,
+		lpm_pred_stats_show, lpm_pred_stats_store);
+
+static ssize_t lpm_system_stats_show(
+	struct kobject *kobj, struct kobj_attribute *attr, char *buf);
+static ssize_t lpm_system_stats_store(struct kobject *kobj,
+	struct kobj_attribute *attr, const char *buf, size_t count);
+
+static struct kobj_attribute lpm_system_stats_kattr =
+	__ATTR(system_level_stats, S_IRUGO|S_IWUSR,
+		lpm_system_stats_show, lpm_system_stats_store);
+
 static struct attribute *lpm_levels_attr[] = {
 	&lpm_l2_kattr.attr,
+	&lpm_pred_stats_kattr.attr,
+	&lpm_system_stats_kattr.attr,
 	NULL,
 };
 
@@ -171,6 +278,101 @@ static ssize_t lpm_levels_attr_store(struct kobject *kobj,
 	return count;
 }
 
+/*
+ * too_deep counts entries that ended before the level's break-even time,
+ * too_shallow entries that lasted past the break-even time of the next
+ * deeper level.  Writing anything clears the counters.
+ */
+static ssize_t lpm_pred_stats_show(
+	struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+	int i, cpu, len;
+
+	len = scnprintf(buf, PAGE_SIZE,
+			"level entered predicted too_deep too_shallow\n");
+
+	for (i = 0; i < sys_state.num_cpu_levels; i++) {
+		struct lpm_pred_stats sum = { 0 };
+
+		for_each_possible_cpu(cpu) {
+			struct lpm_pred_stats *st = &per_cpu(lpm_pred_stats, cpu)[i];
+
+			sum.entered += st->entered;
+			sum.predicted += st->predicted;
+			sum.too_deep += st->too_deep;
+			sum.too_shallow += st->too_shallow;
+		}
+
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s %u %u %u %u\n",
+				sys_state.cpu_level[i].name, sum.entered,
+				sum.predicted, sum.too_deep, sum.too_shallow);
+	}
+
+	return len;
+}
+
+static ssize_t lpm_pred_stats_store(struct kobject *kobj,
+	struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(lpm_pred_stats, cpu), 0,
+				sizeof(per_cpu(lpm_pred_stats, cpu)));
+
+	return count;
+}
+
+/*
+ * Idle entries of each system level, with the total residency and the
+ * average and worst entry/exit latencies of the last-man paths, in us.
+ * Writing anything clears the counters.
+ */
+static ssize_t lpm_system_stats_show(
+	struct kobject *kobj, struct kobj_attribute *attr, char *buf)
+{
+	int i, len;
+
+	len = scnprintf(buf, PAGE_SIZE,
+		"level count residency avg_entry max_entry avg_exit max_exit\n");
+
+	spin_lock_irq(&sys_state.sync_lock);
+	for (i = 0; i < sys_state.num_system_levels; i++) {
+		struct lpm_level_stats st = sys_state.system_level[i].stats;
+		uint32_t n = st.count ? st.count : 1;
+
+		do_div(st.residency_ns, NSEC_PER_USEC);
+		st.entry_ns = div_u64(st.entry_ns, n);
+		do_div(st.entry_ns, NSEC_PER_USEC);
+		st.exit_ns = div_u64(st.exit_ns, n);
+		do_div(st.exit_ns, NSEC_PER_USEC);
+
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				"%s %u %llu %llu %u %llu %u\n",
+				sys_state.system_level[i].name, st.count,
+				st.residency_ns, st.entry_ns,
+				(u32)(st.max_entry_ns / NSEC_PER_USEC), st.exit_ns,
+				(u32)(st.max_exit_ns / NSEC_PER_USEC));
+	}
+	spin_unlock_irq(&sys_state.sync_lock);
+
+	return len;
+}
+
+static ssize_t lpm_system_stats_store(struct kobject *kobj,
+	struct kobj_attribute *attr, const char *buf, size_t count)
+{
+	int i;
+
+	spin_lock_irq(&sys_state.sync_lock);
+	for (i = 0; i < sys_state.num_system_levels; i++)
+		memset(&sys_state.system_level[i].stats, 0,
+				sizeof(sys_state.system_level[i].stats));
+	spin_unlock_irq(&sys_state.sync_lock);
+
+	return count;
+}
+
 static int msm_pm_get_sleep_mode_value(const char *mode_name)
 {
 	struct lpm_lookup_table pm_sm_lookup[] = {
@@ -252,6 +454,7 @@ static void lpm_system_level_update(void)
 		l = &sys_state.system_level[i];
 		l->available = !(l->l2_mode > max_l2_mode);
 	}
+	sys_state.level_gen++;
 	mutex_unlock(&lpm_lock);
 }
 
@@ -364,6 +567,9 @@ static void lpm_system_prepare(struct lpm_system_state *system_state,
 		return;
 	}
 
+	if (from_idle)
+		system_state->prepare_start_ns = ktime_to_ns(ktime_get());
+
 	us = lpm_get_system_sleep(from_idle, &nextcpu);
 
 	if (from_idle)
@@ -395,6 +601,18 @@ static void lpm_system_prepare(struct lpm_system_state *system_state,
 	msm_mpm_enter_sleep(sclk, from_idle, &nextcpu);
 skip_rpm:
 	system_state->last_entered_cluster_index = index;
+	if (from_idle) {
+		struct lpm_level_stats *st = &lvl->stats;
+		int64_t now = ktime_to_ns(ktime_get());
+		uint32_t entry = now - system_state->prepare_start_ns;
+
+		st->count++;
+		st->entry_ns += entry;
+		st->max_entry_ns = max(st->max_entry_ns, entry);
+		system_state->sleep_start_ns = now;
+	} else {
+		system_state->sleep_start_ns = 0;
+	}
 	spin_unlock(&system_state->sync_lock);
 	return;
 
@@ -411,6 +629,7 @@ static void lpm_system_unprepare(struct lpm_system_state *system_state,
 	int cpu = smp_processor_id();
 	struct lpm_cpu_level *cpu_level = &system_state->cpu_level[cpu_index];
 	bool first_cpu;
+	int64_t wake_ns = 0;
 
 	if (cpu_level->mode < system_state->sync_cpu_mode)
 		return;
@@ -441,6 +660,9 @@ static void lpm_system_unprepare(struct lpm_system_state *system_state,
 	if (index < 0)
 		goto unlock_and_return;
 
+	if (system_state->sleep_start_ns)
+		wake_ns = ktime_to_ns(ktime_get());
+
 	if (default_l2_mode != system_state->system_level[index].l2_mode)
 		lpm_set_l2_mode(system_state, default_l2_mode);
 
@@ -448,6 +670,16 @@ static void lpm_system_unprepare(struct lpm_system_state *system_state,
 		msm_rpm_exit_sleep();
 		msm_mpm_exit_sleep(from_idle);
 	}
+
+	if (wake_ns) {
+		struct lpm_level_stats *st =
+			&system_state->system_level[index].stats;
+		uint32_t exit = ktime_to_ns(ktime_get()) - wake_ns;
+
+		st->residency_ns += wake_ns - system_state->sleep_start_ns;
+		st->exit_ns += exit;
+		st->max_exit_ns = max(st->max_exit_ns, exit);
+	}
 unlock_and_return:
 	system_state->last_entered_cluster_index = -1;
 	spin_unlock(&system_state->sync_lock);
@@ -510,11 +742,110 @@ static void msm_pm_set_timer(uint32_t modified_time_us)
 	hrtimer_start(&lpm_hrtimer, modified_ktime, HRTIMER_MODE_REL_PINNED);
 }
 
+static enum hrtimer_restart lpm_histtimer_cb(struct hrtimer *h)
+{
+	struct lpm_history *history = container_of(h, struct lpm_history,
+							histtimer);
+
+	/* the prediction was too short, fall back to the timer hint */
+	history->histtimer_fired = true;
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Look for a repeating pattern in the recent residencies, as the menu
+ * governor does: accept the average once the standard deviation is
+ * small compared to it, discarding the largest samples as outliers while
+ * at least three quarters of the history remain.
+ */
+static uint32_t lpm_predict(struct lpm_history *history)
+{
+	uint32_t max, thresh = UINT_MAX;
+	uint64_t avg, variance;
+	unsigned long stddev;
+	int i, divisor;
+
+	if (history->nsamp < LPM_HISTORY_SIZE)
+		return 0;
+
+again:
+	max = 0;
+	avg = 0;
+	divisor = 0;
+	for (i = 0; i < LPM_HISTORY_SIZE; i++) {
+		uint32_t value = history->resi[i];
+
+		if (value <= thresh) {
+			avg += value;
+			divisor++;
+			if (value > max)
+				max = value;
+		}
+	}
+	do_div(avg, divisor);
+
+	variance = 0;
+	for (i = 0; i < LPM_HISTORY_SIZE; i++) {
+		uint32_t value = history->resi[i];
+		int64_t diff;
+
+		if (value <= thresh) {
+			diff = (int64_t)value - avg;
+			variance += diff * diff;
+		}
+	}
+	do_div(variance, divisor);
+	stddev = int_sqrt(min_t(uint64_t, variance, ULONG_MAX));
+
+	if ((avg > stddev * 6 && divisor * 4 >= LPM_HISTORY_SIZE * 3) ||
+			stddev <= 20)
+		return (uint32_t)avg;
+
+	if (divisor * 4 > LPM_HISTORY_SIZE * 3) {
+		thresh = max - 1;
+		goto again;
+	}
+
+	return 0;
+}
+
+static void lpm_update_history(int cpu, int idx, uint32_t resi_us)
+{
+	struct lpm_history *history = &per_cpu(lpm_hist, cpu);
+	struct lpm_pred_stats *st = &per_cpu(lpm_pred_stats, cpu)[idx];
+
+	hrtimer_try_to_cancel(&history->histtimer);
+
+	st->entered++;
+	if (history->predicted)
+		st->predicted++;
+	if (resi_us < sys_state.cpu_level[idx].pwr.time_overhead_us)
+		st->too_deep++;
+	else if (idx + 1 < sys_state.num_cpu_levels && resi_us >
+			sys_state.cpu_level[idx + 1].pwr.time_overhead_us)
+		st->too_shallow++;
+
+	history->predicted = false;
+
+	if (history->histtimer_fired) {
+		history->histtimer_fired = false;
+		history->nsamp = 0;
+		history->hptr = 0;
+		return;
+	}
+
+	history->resi[history->hptr] = resi_us;
+	history->hptr = (history->hptr + 1) % LPM_HISTORY_SIZE;
+	if (history->nsamp < LPM_HISTORY_SIZE)
+		history->nsamp++;
+}
+
 static int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 {
 	int best_level = -1;
 	uint32_t best_level_pwr = ~0U;
-	uint32_t latency_us = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+	uint32_t latency_us = pm_qos_request_for_cpu(PM_QOS_CPU_DMA_LATENCY,
+							dev->cpu);
 	uint32_t sleep_us =
 		(uint32_t)(ktime_to_us(tick_nohz_get_sleep_length()));
 	uint32_t modified_time_us = 0;
@@ -524,6 +855,8 @@ static int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 	uint32_t lvl_latency_us = 0;
 	uint32_t lvl_overhead_us = 0;
 	uint32_t lvl_overhead_energy = 0;
+	uint32_t timer_sleep_us = sleep_us;
+	uint32_t predicted_us = 0;
 
 	if (!sys_state.cpu_level)
 		return -EINVAL;
@@ -531,6 +864,14 @@ static int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 	if (!dev->cpu)
 		next_event_us = (uint32_t)(ktime_to_us(get_next_event_time()));
 
+	if (lpm_prediction) {
+		predicted_us = lpm_predict(&per_cpu(lpm_hist, dev->cpu));
+		if (predicted_us && predicted_us < sleep_us)
+			sleep_us = predicted_us;
+		else
+			predicted_us = 0;
+	}
+
 	for (i = 0; i < sys_state.num_cpu_levels; i++) {
 		struct lpm_cpu_level *level = &sys_state.cpu_level[i];
 		struct power_params *pwr_params = &level->pwr;
@@ -593,6 +934,28 @@ static int lpm_cpu_power_select(struct cpuidle_device *dev, int *index)
 	if (modified_time_us && !dev->cpu)
 		msm_pm_set_timer(modified_time_us);
 
+	/*
+	 * If the prediction kept us out of a deeper level that the timer
+	 * hint allowed, wake up after twice the predicted time so that a
+	 * wrong prediction costs at most one shallow residency.
+	 */
+	if (best_level >= 0 && sys_state.cpu_level[best_level].mode >=
+			sys_state.sync_cpu_mode)
+		per_cpu(lpm_hist, dev->cpu).next_wakeup =
+			ktime_add_us(ktime_get(), sleep_us);
+
+	if (predicted_us) {
+		struct lpm_history *history = &per_cpu(lpm_hist, dev->cpu);
+
+		history->predicted = true;
+		if (best_level >= 0 &&
+				best_level + 1 < sys_state.num_cpu_levels &&
+				2 * predicted_us < timer_sleep_us)
+			hrtimer_start(&history->histtimer,
+				ns_to_ktime(2ULL * predicted_us * NSEC_PER_USEC),
+				HRTIMER_MODE_REL_PINNED);
+	}
+
 	return best_level;
 }
 
@@ -647,6 +1010,68 @@ resource_sysfs_add_exit:
 
 	return rc;
 }
+static int lpm_cpu_stats_show(struct seq_file *m, void *v)
+{
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		seq_printf(m, "cpu%d\n", cpu);
+		for (i = 0; i < sys_state.num_cpu_levels; i++) {
+			struct lpm_cpu_stats st = per_cpu(lpm_cpu_stats, cpu)[i];
+			uint64_t avg = st.wake_lat_ns;
+
+			if (st.wake_lat_count)
+				do_div(avg, st.wake_lat_count);
+
+			seq_printf(m,
+				"  %s: entries %llu aborts %llu residency_ns %llu avg_wake_latency_ns %llu max_wake_latency_ns %u\n",
+				sys_state.cpu_level[i].name, st.entries,
+				st.aborts, st.residency_ns, avg,
+				st.wake_lat_max_ns);
+		}
+	}
+
+	return 0;
+}
+
+static int lpm_cpu_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lpm_cpu_stats_show, inode->i_private);
+}
+
+static ssize_t lpm_cpu_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu(lpm_cpu_stats, cpu), 0,
+				sizeof(per_cpu(lpm_cpu_stats, cpu)));
+
+	return count;
+}
+
+static const struct file_operations lpm_cpu_stats_fops = {
+	.open		= lpm_cpu_stats_open,
+	.read		= seq_read,
+	.write		= lpm_cpu_stats_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void lpm_levels_debugfs_add(void)
+{
+	struct dentry *dir;
+
+	dir = debugfs_create_dir("lpm_levels", NULL);
+	if (IS_ERR_OR_NULL(dir))
+		return;
+
+	if (!debugfs_create_file("cpu_stats", S_IRUGO | S_IWUSR, dir, NULL,
+				&lpm_cpu_stats_fops))
+		debugfs_remove(dir);
+}
+
 static int lpm_cpu_menu_select(struct cpuidle_device *dev, int *index)
 {
 	int j;
@@ -696,11 +1121,38 @@ static inline void lpm_cpu_unprepare(struct lpm_system_state *system_state,
 		clockevents_notify(CLOCK_EVT_NOTIFY_BROADCAST_EXIT, &cpu);
 }
 
+/*
+ * Earliest expected wakeup, in us from now, of the cpus in the cluster.
+ * Each cpu publishes its own in lpm_cpu_power_select(), so this covers
+ * predicted interrupt wakeups that the broadcast timer does not know
+ * about.  Called with the sync lock held by the last cpu going down.
+ */
+static uint64_t lpm_cluster_horizon(struct lpm_system_state *system_state)
+{
+	ktime_t now = ktime_get();
+	ktime_t next = KTIME_MAX;
+	int cpu;
+
+	for_each_cpu(cpu, &system_state->num_cores_in_sync) {
+		ktime_t t = per_cpu(lpm_hist, cpu).next_wakeup;
+
+		if (t.tv64 < next.tv64)
+			next = t;
+	}
+
+	if (next.tv64 <= now.tv64)
+		return 0;
+
+	return ktime_to_us(ktime_sub(next, now));
+}
+
 static int lpm_system_select(struct lpm_system_state *system_state,
 		int cpu_index, bool from_idle)
 {
 	struct lpm_cpu_level *cpu_level = &system_state->cpu_level[cpu_index];
 	int cpu = smp_processor_id();
+	struct lpm_select_cache key;
+	uint64_t sleep_us;
 	int i;
 
 	if (cpu_level->mode < system_state->sync_cpu_mode)
@@ -712,11 +1164,15 @@ static int lpm_system_select(struct lpm_system_state *system_state,
 	spin_lock(&system_state->sync_lock);
 	cpumask_set_cpu(cpu, &system_state->num_cores_in_sync);
 
+	key.votes = 0;
 	for (i = 0; i < system_state->num_system_levels; i++) {
 		struct lpm_system_level *system_lvl =
 			&system_state->system_level[i];
 		if (cpu_level->mode >= system_lvl->min_cpu_mode)
 			cpumask_set_cpu(cpu, &system_lvl->num_cpu_votes);
+		if (cpumask_equal(&system_lvl->num_cpu_votes,
+					&num_powered_cores))
+			key.votes |= BIT(i);
 	}
 
 	if (!cpumask_equal(&system_state->num_cores_in_sync,
@@ -725,18 +1181,47 @@ static int lpm_system_select(struct lpm_system_state *system_state,
 		return -EBUSY;
 	}
 
+	sleep_us = lpm_get_system_sleep(from_idle, NULL);
+	if (from_idle)
+		sleep_us = min(sleep_us, lpm_cluster_horizon(system_state));
+
+	key.from_idle = from_idle;
+	key.suspend = suspend_in_progress;
+	key.gen = system_state->level_gen;
+	key.online = num_online_cpus();
+	key.horizon = (uint32_t)min_t(uint64_t, sleep_us >> LPM_HORIZON_SHIFT,
+					UINT_MAX);
+	key.latency_us = pm_qos_request(PM_QOS_CPU_DMA_LATENCY);
+
+	if (system_state->cache.valid &&
+			system_state->cache.from_idle == key.from_idle &&
+			system_state->cache.suspend == key.suspend &&
+			system_state->cache.gen == key.gen &&
+			system_state->cache.online == key.online &&
+			system_state->cache.horizon == key.horizon &&
+			system_state->cache.latency_us == key.latency_us &&
+			system_state->cache.votes == key.votes) {
+		i = system_state->cache.index;
+		spin_unlock(&system_state->sync_lock);
+		return i;
+	}
+
+	key.index = lpm_system_mode_select(system_state,
+			(uint32_t)min_t(uint64_t, sleep_us, UINT_MAX), from_idle);
+	key.valid = true;
+	system_state->cache = key;
+
 	spin_unlock(&system_state->sync_lock);
 
-	return lpm_system_mode_select(system_state,
-			(uint32_t)lpm_get_system_sleep(from_idle, NULL),
-			from_idle);
+	return key.index;
 }
 
-static void lpm_enter_low_power(struct lpm_system_state *system_state,
+static bool lpm_enter_low_power(struct lpm_system_state *system_state,
 		int cpu_index, bool from_idle)
 {
 	int idx;
 	struct lpm_cpu_level *cpu_level = &system_state->cpu_level[cpu_index];
+	bool success;
 
 	lpm_cpu_prepare(system_state, cpu_index, from_idle);
 
@@ -744,18 +1229,48 @@ static void lpm_enter_low_power(struct lpm_system_state *system_state,
 
 	lpm_system_prepare(system_state, idx, from_idle);
 
-	msm_cpu_pm_enter_sleep(cpu_level->mode, from_idle);
+	success = msm_cpu_pm_enter_sleep(cpu_level->mode, from_idle);
 
 	lpm_system_unprepare(system_state, cpu_index, from_idle);
 
 	lpm_cpu_unprepare(system_state, cpu_index, from_idle);
+
+	return success;
+}
+
+static void lpm_update_cpu_stats(int cpu, int idx, bool success,
+		int64_t entry_ns, int64_t exit_ns, int64_t expiry_ns)
+{
+	struct lpm_cpu_stats *st = &per_cpu(lpm_cpu_stats, cpu)[idx];
+	uint64_t wake_lat = 0;
+
+	st->entries++;
+	if (!success)
+		st->aborts++;
+	st->residency_ns += exit_ns - entry_ns;
+
+	if (success && exit_ns > expiry_ns) {
+		wake_lat = exit_ns - expiry_ns;
+		st->wake_lat_ns += wake_lat;
+		st->wake_lat_count++;
+		st->wake_lat_max_ns = max_t(uint32_t, st->wake_lat_max_ns,
+				min_t(uint64_t, wake_lat, UINT_MAX));
+	}
+
+	trace_lpm_cpu_idle_exit(cpu, idx, success, exit_ns - entry_ns,
+			wake_lat);
 }
 
 static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 		struct cpuidle_driver *drv, int index)
 {
 	int64_t time = ktime_to_ns(ktime_get());
+	int64_t entry_ns = time, expiry_ns;
+	ktime_t sleep = tick_nohz_get_sleep_length();
 	int idx;
+	bool success;
+
+	expiry_ns = entry_ns + ktime_to_ns(sleep);
 
 	idx = menu_select ? lpm_cpu_menu_select(dev, &index) :
 			lpm_cpu_power_select(dev, &index);
@@ -764,11 +1279,16 @@ static int lpm_cpuidle_enter(struct cpuidle_device *dev,
 		return -EPERM;
 	}
 
-	lpm_enter_low_power(&sys_state, idx, true);
+	trace_lpm_cpu_idle_enter(dev->cpu, idx, (uint32_t)ktime_to_us(sleep));
+	success = lpm_enter_low_power(&sys_state, idx, true);
 
-	time = ktime_to_ns(ktime_get()) - time;
+	time = ktime_to_ns(ktime_get());
+	lpm_update_cpu_stats(dev->cpu, idx, success, entry_ns, time,
+			expiry_ns);
+	time -= entry_ns;
 	do_div(time, 1000);
 	dev->last_residency = (int)time;
+	lpm_update_history(dev->cpu, idx, (uint32_t)time);
 
 	local_irq_enable();
 	return idx;
@@ -1071,6 +1591,7 @@ static int lpm_probe(struct platform_device *pdev)
 	struct device_node *node = NULL;
 	char *key = NULL;
 	int ret;
+	int cpu;
 
 	node = pdev->dev.of_node;
 
@@ -1127,6 +1648,13 @@ static int lpm_probe(struct platform_device *pdev)
 	platform_device_register(&lpm_dev);
 	suspend_set_ops(&lpm_suspend_ops);
 	hrtimer_init(&lpm_hrtimer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	for_each_possible_cpu(cpu) {
+		struct hrtimer *t = &per_cpu(lpm_hist, cpu).histtimer;
+
+		hrtimer_init(t, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+		t->function = lpm_histtimer_cb;
+	}
+	lpm_levels_debugfs_add();
 	lpm_cpuidle_init();
 	return 0;
 fail:
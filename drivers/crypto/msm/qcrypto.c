@@ -28,6 +28,8 @@
 #include <linux/sched.h>
 #include <linux/init.h>
 #include <linux/cache.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
 #include <soc/qcom/scm.h>
 
 #include <crypto/ctr.h>
@@ -58,6 +60,20 @@
 
 #define QCRYPTO_HIGH_BANDWIDTH_TIMEOUT 1000
 
+/*
+ * Cipher requests shorter than this many bytes are run on the CPU through
+ * a software fallback, where the CE setup and completion interrupt would
+ * cost more than the cipher itself. 0 sends everything to the engine.
+ */
+static unsigned int qcrypto_sw_cutoff = 256;
+module_param_named(sw_cutoff, qcrypto_sw_cutoff, uint, S_IRUGO | S_IWUSR);
+
+struct qcrypto_path_stat {
+	u64 req;
+	u64 bytes;
+	u64 ns;
+};
+
 struct crypto_stat {
 	u32 aead_sha1_aes_enc;
 	u32 aead_sha1_aes_dec;
@@ -88,6 +104,8 @@ struct crypto_stat {
 	u32 sha256_hmac_digest;
 	u32 sha_hmac_op_success;
 	u32 sha_hmac_op_fail;
+	struct qcrypto_path_stat ablk_cipher_hw;
+	struct qcrypto_path_stat ablk_cipher_sw;
 };
 static struct crypto_stat _qcrypto_stat;
 static struct dentry *_debug_dent;
@@ -274,6 +292,9 @@ struct qcrypto_cipher_ctx {
 	unsigned int flags;
 	struct crypto_engine *pengine;  /* fixed engine assigned */
 	u8 ccm4309_nonce[QCRYPTO_CCM4309_NONCE_LEN];
+
+	struct crypto_blkcipher *fallback;	/* for short requests */
+	bool fallback_keyed;
 };
 
 struct qcrypto_cipher_req_ctx {
@@ -294,7 +315,7 @@ struct qcrypto_cipher_req_ctx {
 	struct scatterlist dsg;		/* Dest Data sg  */
 	struct scatterlist ssg;		/* Source Data sg  */
 	unsigned char *data;		/* Incoming data pointer*/
-
+	ktime_t start;			/* when queued to the engine */
 };
 
 #define SHA_MAX_BLOCK_SIZE      SHA256_BLOCK_SIZE
@@ -672,8 +693,24 @@ static int _qcrypto_ahash_hmac_cra_init(struct crypto_tfm *tfm)
 
 static int _qcrypto_cra_ablkcipher_init(struct crypto_tfm *tfm)
 {
+	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
+	const char *name = crypto_tfm_alg_name(tfm);
+	int ret;
+
 	tfm->crt_ablkcipher.reqsize = sizeof(struct qcrypto_cipher_req_ctx);
-	return _qcrypto_cipher_cra_init(tfm);
+	ret = _qcrypto_cipher_cra_init(tfm);
+	if (ret)
+		return ret;
+
+	if (!strncmp(name, "qcom-", strlen("qcom-")))
+		name += strlen("qcom-");
+	/* not fatal, short requests then go to the engine as well */
+	ctx->fallback = crypto_alloc_blkcipher(name, 0,
+			CRYPTO_ALG_ASYNC | CRYPTO_ALG_NEED_FALLBACK);
+	if (IS_ERR(ctx->fallback))
+		ctx->fallback = NULL;
+	ctx->fallback_keyed = false;
+	return 0;
 };
 
 static int _qcrypto_cra_aead_init(struct crypto_tfm *tfm)
@@ -686,6 +723,11 @@ static void _qcrypto_cra_ablkcipher_exit(struct crypto_tfm *tfm)
 {
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(tfm);
 
+	if (ctx->fallback) {
+		crypto_free_blkcipher(ctx->fallback);
+		ctx->fallback = NULL;
+	}
+
 	if (ctx->pengine && ctx->cp->platform_support.bus_scale_table != NULL)
 		qcrypto_ce_bw_scaling_req(ctx->pengine, false);
 };
@@ -698,6 +740,26 @@ static void _qcrypto_cra_aead_exit(struct crypto_tfm *tfm)
 		qcrypto_ce_bw_scaling_req(ctx->pengine, false);
 };
 
+static void _qcrypto_path_stat_add(struct qcrypto_path_stat *ps,
+		unsigned int nbytes, ktime_t start)
+{
+	ps->req++;
+	ps->bytes += nbytes;
+	ps->ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
+static int _disp_path_stats(int len, const char *path,
+		struct qcrypto_path_stat *ps)
+{
+	u64 kbps = 0;
+
+	if (ps->ns)
+		kbps = div64_u64(ps->bytes * NSEC_PER_USEC, ps->ns) * 1000;
+	return scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
+			"   ABLK CIPHER %s req/bytes/KBps : %llu %llu %llu\n",
+			path, ps->req, ps->bytes, kbps);
+}
+
 static int _disp_stats(int id)
 {
 	struct crypto_stat *pstat;
@@ -806,6 +868,8 @@ static int _disp_stats(int id)
 	len += scnprintf(_debug_read_buf + len, DEBUG_MAX_RW_BUF - len - 1,
 			"   SHA HMAC operation success          : %d\n",
 					pstat->sha_hmac_op_success);
+	len += _disp_path_stats(len, "CE", &pstat->ablk_cipher_hw);
+	len += _disp_path_stats(len, "SW", &pstat->ablk_cipher_sw);
 	spin_lock_irqsave(&cp->lock, flags);
 	list_for_each_entry(pe, &cp->engine_list, elist) {
 		len += scnprintf(
@@ -904,6 +968,22 @@ static int _qcrypto_check_aes_keylen(struct crypto_ablkcipher *cipher,
 	return 0;
 }
 
+/*
+ * Mirror a plain software key into the fallback cipher. Contexts using a
+ * HW or pipe key never take the software path.
+ */
+static void _qcrypto_setkey_fallback(struct qcrypto_cipher_ctx *ctx,
+		const u8 *key, unsigned int len)
+{
+	ctx->fallback_keyed = false;
+	if (!ctx->fallback || !key || (ctx->flags &
+			(QCRYPTO_CTX_USE_HW_KEY | QCRYPTO_CTX_USE_PIPE_KEY)))
+		return;
+	crypto_blkcipher_clear_flags(ctx->fallback, ~0);
+	if (!crypto_blkcipher_setkey(ctx->fallback, key, len))
+		ctx->fallback_keyed = true;
+}
+
 static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 		unsigned int len)
 {
@@ -927,6 +1007,7 @@ static int _qcrypto_setkey_aes(struct crypto_ablkcipher *cipher, const u8 *key,
 			}
 		}
 	}
+	_qcrypto_setkey_fallback(ctx, key, len);
 	return 0;
 };
 
@@ -952,6 +1033,7 @@ static int _qcrypto_setkey_aes_xts(struct crypto_ablkcipher *cipher,
 			}
 		}
 	}
+	_qcrypto_setkey_fallback(ctx, key, len);
 	return 0;
 };
 
@@ -990,6 +1072,7 @@ static int _qcrypto_setkey_des(struct crypto_ablkcipher *cipher, const u8 *key,
 	if (!(ctx->flags & QCRYPTO_CTX_USE_PIPE_KEY))
 		memcpy(ctx->enc_key, key, len);
 
+	_qcrypto_setkey_fallback(ctx, key, len);
 	return 0;
 };
 
@@ -1017,6 +1100,7 @@ static int _qcrypto_setkey_3des(struct crypto_ablkcipher *cipher, const u8 *key,
 			return -EINVAL;
 		}
 	}
+	_qcrypto_setkey_fallback(ctx, key, len);
 	return 0;
 };
 
@@ -1101,6 +1185,7 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 	struct ablkcipher_request *areq = (struct ablkcipher_request *) cookie;
 	struct crypto_ablkcipher *ablk = crypto_ablkcipher_reqtfm(areq);
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(areq->base.tfm);
+	struct qcrypto_cipher_req_ctx *rctx = ablkcipher_request_ctx(areq);
 	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 	struct crypto_engine *pengine;
@@ -1121,13 +1206,13 @@ static void _qce_ablk_cipher_complete(void *cookie, unsigned char *icb,
 		pengine->res = 0;
 		pstat->ablk_cipher_op_success++;
 	}
+	_qcrypto_path_stat_add(&pstat->ablk_cipher_hw, areq->nbytes,
+			       rctx->start);
 
 	if (cp->ce_support.aligned_only)  {
-		struct qcrypto_cipher_req_ctx *rctx;
 		uint32_t num_sg = 0;
 		uint32_t bytes = 0;
 
-		rctx = ablkcipher_request_ctx(areq);
 		areq->src = rctx->orig_src;
 		areq->dst = rctx->orig_dst;
 
@@ -1772,11 +1857,38 @@ static int _qcrypto_queue_req(struct crypto_priv *cp,
 	return ret;
 }
 
+static int _qcrypto_queue_ablk_req(struct qcrypto_cipher_ctx *ctx,
+				struct ablkcipher_request *req)
+{
+	struct qcrypto_cipher_req_ctx *rctx = ablkcipher_request_ctx(req);
+	struct crypto_stat *pstat = &_qcrypto_stat;
+	struct blkcipher_desc desc;
+	int ret;
+
+	rctx->start = ktime_get();
+	if (!ctx->fallback_keyed || req->nbytes >= qcrypto_sw_cutoff ||
+			(ctx->flags & (QCRYPTO_CTX_USE_HW_KEY |
+				       QCRYPTO_CTX_USE_PIPE_KEY)))
+		return _qcrypto_queue_req(ctx->cp, ctx->pengine, &req->base);
+
+	desc.tfm = ctx->fallback;
+	desc.info = req->info;
+	desc.flags = req->base.flags & CRYPTO_TFM_REQ_MAY_SLEEP;
+	if (rctx->dir == QCE_ENCRYPT)
+		ret = crypto_blkcipher_encrypt_iv(&desc, req->dst, req->src,
+						  req->nbytes);
+	else
+		ret = crypto_blkcipher_decrypt_iv(&desc, req->dst, req->src,
+						  req->nbytes);
+	_qcrypto_path_stat_add(&pstat->ablk_cipher_sw, req->nbytes,
+			       rctx->start);
+	return ret;
+}
+
 static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -1793,14 +1905,13 @@ static int _qcrypto_enc_aes_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_aes_enc++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_enc_aes_cbc(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -1817,14 +1928,13 @@ static int _qcrypto_enc_aes_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_aes_enc++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_enc_aes_ctr(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -1841,14 +1951,13 @@ static int _qcrypto_enc_aes_ctr(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CTR;
 
 	pstat->ablk_cipher_aes_enc++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_enc_aes_xts(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -1862,7 +1971,7 @@ static int _qcrypto_enc_aes_xts(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_XTS;
 
 	pstat->ablk_cipher_aes_enc++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_aead_encrypt_aes_ccm(struct aead_request *req)
@@ -1918,7 +2027,6 @@ static int _qcrypto_enc_des_ecb(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -1932,14 +2040,13 @@ static int _qcrypto_enc_des_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_des_enc++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_enc_des_cbc(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -1953,14 +2060,13 @@ static int _qcrypto_enc_des_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_des_enc++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_enc_3des_ecb(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -1974,14 +2080,13 @@ static int _qcrypto_enc_3des_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_3des_enc++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_enc_3des_cbc(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -1995,14 +2100,13 @@ static int _qcrypto_enc_3des_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_3des_enc++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_dec_aes_ecb(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -2019,14 +2123,13 @@ static int _qcrypto_dec_aes_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_aes_dec++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_dec_aes_cbc(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -2044,14 +2147,13 @@ static int _qcrypto_dec_aes_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_aes_dec++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_dec_aes_ctr(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -2070,14 +2172,13 @@ static int _qcrypto_dec_aes_ctr(struct ablkcipher_request *req)
 	rctx->dir = QCE_ENCRYPT;
 
 	pstat->ablk_cipher_aes_dec++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_dec_des_ecb(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -2091,14 +2192,13 @@ static int _qcrypto_dec_des_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_des_dec++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_dec_des_cbc(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -2112,14 +2212,13 @@ static int _qcrypto_dec_des_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_des_dec++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_dec_3des_ecb(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -2133,14 +2232,13 @@ static int _qcrypto_dec_3des_ecb(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_ECB;
 
 	pstat->ablk_cipher_3des_dec++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_dec_3des_cbc(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -2154,14 +2252,13 @@ static int _qcrypto_dec_3des_cbc(struct ablkcipher_request *req)
 	rctx->mode = QCE_MODE_CBC;
 
 	pstat->ablk_cipher_3des_dec++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 static int _qcrypto_dec_aes_xts(struct ablkcipher_request *req)
 {
 	struct qcrypto_cipher_req_ctx *rctx;
 	struct qcrypto_cipher_ctx *ctx = crypto_tfm_ctx(req->base.tfm);
-	struct crypto_priv *cp = ctx->cp;
 	struct crypto_stat *pstat;
 
 	pstat = &_qcrypto_stat;
@@ -2175,7 +2272,7 @@ static int _qcrypto_dec_aes_xts(struct ablkcipher_request *req)
 	rctx->dir = QCE_DECRYPT;
 
 	pstat->ablk_cipher_aes_dec++;
-	return _qcrypto_queue_req(cp, ctx->pengine, &req->base);
+	return _qcrypto_queue_ablk_req(ctx, req);
 };
 
 
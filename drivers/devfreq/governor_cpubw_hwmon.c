@@ -28,8 +28,14 @@
 #include <linux/platform_device.h>
 #include <linux/of.h>
 #include <linux/devfreq.h>
+#include <linux/cpu.h>
+#include <linux/percpu.h>
+#include <linux/perf_event.h>
+#include <linux/cache.h>
 #include "governor.h"
 
+#include <trace/events/power.h>
+
 #include <mach/msm-krait-l2-accessors.h>
 
 #define L2PMRESR2		0x412
@@ -82,6 +88,9 @@ static unsigned int guard_band_mbps = 100;
 static unsigned int decay_rate = 90;
 static unsigned int io_percent = 16;
 static unsigned int bw_step = 190;
+static unsigned int burst_window_ms;
+static unsigned int mem_bound_ratio;
+static unsigned int mem_bound_boost = 25;
 
 #define MIN_MS	10U
 #define MAX_MS	500U
@@ -90,6 +99,9 @@ static u32 prev_r_start_val;
 static u32 prev_w_start_val;
 static unsigned long prev_ab;
 static ktime_t prev_ts;
+static long prev_mbps;
+static bool irq_update;
+static bool mem_bound;
 
 #define RD_MON	0
 #define WR_MON	1
@@ -171,6 +183,147 @@ static long mon_get_count(int n, u32 start_val)
 		return count - start_val;
 }
 
+/*
+ * L2 requests are approximated by L1 data cache refills, counted with one
+ * CPU PMU event per online CPU.  Counts of CPUs that go offline are folded
+ * into l2_req_pending so that no part of a window is lost.
+ */
+struct l2_req_mon {
+	struct perf_event *ev;
+	u64 prev;
+};
+static DEFINE_PER_CPU(struct l2_req_mon, l2_req_mon);
+static DEFINE_MUTEX(l2_req_lock);
+static u64 l2_req_pending;
+
+static struct perf_event_attr l2_req_attr = {
+	.type = PERF_TYPE_HARDWARE,
+	.config = PERF_COUNT_HW_CACHE_MISSES,
+	.size = sizeof(struct perf_event_attr),
+	.pinned = 1,
+};
+
+static u64 l2_req_read_delta(struct l2_req_mon *m)
+{
+	u64 total, enabled, running, delta;
+
+	if (!m->ev)
+		return 0;
+
+	total = perf_event_read_value(m->ev, &enabled, &running);
+	delta = total - m->prev;
+	m->prev = total;
+
+	return delta;
+}
+
+static void l2_req_mon_start(int cpu)
+{
+	struct l2_req_mon *m = &per_cpu(l2_req_mon, cpu);
+	struct perf_event *ev;
+
+	ev = perf_event_create_kernel_counter(&l2_req_attr, cpu, NULL, NULL,
+					      NULL);
+	if (IS_ERR(ev)) {
+		pr_debug("No L2 request counter on CPU%d: %ld\n", cpu,
+			 PTR_ERR(ev));
+		return;
+	}
+
+	mutex_lock(&l2_req_lock);
+	m->ev = ev;
+	m->prev = 0;
+	mutex_unlock(&l2_req_lock);
+}
+
+static void l2_req_mon_stop(int cpu)
+{
+	struct l2_req_mon *m = &per_cpu(l2_req_mon, cpu);
+	struct perf_event *ev;
+
+	mutex_lock(&l2_req_lock);
+	l2_req_pending += l2_req_read_delta(m);
+	ev = m->ev;
+	m->ev = NULL;
+	mutex_unlock(&l2_req_lock);
+
+	if (ev)
+		perf_event_release_kernel(ev);
+}
+
+/* Returns the number of L2 requests since the previous call. */
+static u64 l2_req_count(void)
+{
+	u64 count;
+	int cpu;
+
+	mutex_lock(&l2_req_lock);
+	count = l2_req_pending;
+	l2_req_pending = 0;
+	for_each_possible_cpu(cpu)
+		count += l2_req_read_delta(&per_cpu(l2_req_mon, cpu));
+	mutex_unlock(&l2_req_lock);
+
+	return count;
+}
+
+static int l2_req_cpu_callback(struct notifier_block *nb,
+			       unsigned long action, void *hcpu)
+{
+	int cpu = (long)hcpu;
+
+	switch (action & ~CPU_TASKS_FROZEN) {
+	case CPU_ONLINE:
+	case CPU_DOWN_FAILED:
+		l2_req_mon_start(cpu);
+		break;
+	case CPU_DOWN_PREPARE:
+		l2_req_mon_stop(cpu);
+		break;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block l2_req_cpu_nb = {
+	.notifier_call = l2_req_cpu_callback,
+};
+
+static void l2_req_mon_init(void)
+{
+	int cpu;
+
+	get_online_cpus();
+	for_each_online_cpu(cpu)
+		l2_req_mon_start(cpu);
+	register_hotcpu_notifier(&l2_req_cpu_nb);
+	put_online_cpus();
+	l2_req_pending = 0;
+}
+
+static void l2_req_mon_exit(void)
+{
+	int cpu;
+
+	get_online_cpus();
+	unregister_hotcpu_notifier(&l2_req_cpu_nb);
+	for_each_possible_cpu(cpu)
+		l2_req_mon_stop(cpu);
+	put_online_cpus();
+}
+
+/*
+ * Returns true while the last sample window was classified as memory bound,
+ * i.e. a large share of L2 requests had to go to DDR.  Load in such windows
+ * is mostly stall time, which more DDR bandwidth helps and a higher CPU
+ * frequency does not.
+ */
+bool cpubw_hwmon_mem_bound(void)
+{
+	return ACCESS_ONCE(mem_bound);
+}
+EXPORT_SYMBOL_GPL(cpubw_hwmon_mem_bound);
+
 /* Returns MBps of read/writes for the sampling window. */
 static unsigned int beats_to_mbps(long long beats, unsigned int us)
 {
@@ -182,19 +335,19 @@ static unsigned int beats_to_mbps(long long beats, unsigned int us)
 	return beats;
 }
 
-static int to_limit(int mbps)
+static int to_limit(int mbps, unsigned int ms)
 {
-	mbps *= (100 + tolerance_percent) * sample_ms;
+	mbps *= (100 + tolerance_percent) * ms;
 	mbps /= 100;
 	mbps = DIV_ROUND_UP(mbps, MSEC_PER_SEC);
 	return mbps;
 }
 
-static unsigned long measure_bw_and_set_irq(void)
+static unsigned long measure_bw_and_set_irq(long *r_out, unsigned int *us_out)
 {
 	long r_mbps, w_mbps, mbps;
 	ktime_t ts;
-	unsigned int us;
+	unsigned int us, ms;
 
 	/*
 	 * Since we are stopping the counters, we don't want this short work
@@ -217,9 +370,22 @@ static unsigned long measure_bw_and_set_irq(void)
 	r_mbps = beats_to_mbps(r_mbps, us);
 	w_mbps = mon_get_count(WR_MON, prev_w_start_val);
 	w_mbps = beats_to_mbps(w_mbps, us);
+	mbps = r_mbps + w_mbps;
 
-	prev_r_start_val = mon_set_limit_mbyte(RD_MON, to_limit(r_mbps));
-	prev_w_start_val = mon_set_limit_mbyte(WR_MON, to_limit(w_mbps));
+	/*
+	 * When an overflow IRQ shows traffic is still growing, arm the next
+	 * limit for a short burst window so a ramp is followed within a few
+	 * milliseconds instead of once per sample.  Once growth stops, go
+	 * back to the full sample window to avoid an IRQ storm.
+	 */
+	ms = sample_ms;
+	if (irq_update && burst_window_ms &&
+	    mbps * 100 > prev_mbps * (100 + tolerance_percent))
+		ms = burst_window_ms;
+	prev_mbps = mbps;
+
+	prev_r_start_val = mon_set_limit_mbyte(RD_MON, to_limit(r_mbps, ms));
+	prev_w_start_val = mon_set_limit_mbyte(WR_MON, to_limit(w_mbps, ms));
 	prev_ts = ts;
 
 	mon_enable(RD_MON);
@@ -227,16 +393,39 @@ static unsigned long measure_bw_and_set_irq(void)
 
 	preempt_enable();
 
-	mbps = r_mbps + w_mbps;
 	pr_debug("R/W/BW/us = %ld/%ld/%ld/%d\n", r_mbps, w_mbps, mbps, us);
+	trace_cpubw_hwmon_meas(r_mbps, w_mbps, us, irq_update);
 
+	*r_out = r_mbps;
+	*us_out = us;
 	return mbps;
 }
 
+/*
+ * Returns the percentage of L2 requests in the window that missed to DDR,
+ * estimated from DDR read bytes over L1 line size worth of L2 requests.
+ */
+static unsigned int l2_miss_pct(long r_mbps, unsigned int us)
+{
+	u64 reqs, bytes;
+
+	reqs = l2_req_count();
+	if (!reqs)
+		return 0;
+
+	bytes = (u64)r_mbps * SZ_1M * us;
+	do_div(bytes, USEC_PER_SEC);
+
+	return min_t(u64, div64_u64(bytes * 100, reqs * L1_CACHE_BYTES), 100);
+}
+
 static void compute_bw(int mbps, unsigned long *freq, unsigned long *ab)
 {
 	int new_bw;
 
+	if (mem_bound)
+		mbps += mult_frac(mbps, mem_bound_boost, 100);
+
 	mbps += guard_band_mbps;
 
 	if (mbps > prev_ab) {
@@ -279,7 +468,9 @@ static irqreturn_t mon_intr_handler(int irq, void *dev)
 	us = ktime_to_us(ktime_sub(ts, prev_ts));
 	if (us > TOO_SOON_US) {
 		mutex_lock(&df->lock);
+		irq_update = true;
 		ret = update_devfreq(df);
+		irq_update = false;
 		if (ret)
 			pr_err("Unable to update freq on IRQ!\n");
 		mutex_unlock(&df->lock);
@@ -311,6 +502,9 @@ static int start_monitoring(struct devfreq *df)
 	prev_w_start_val = mon_set_limit_mbyte(WR_MON, mbyte);
 	prev_ts = ktime_get();
 	prev_ab = 0;
+	prev_mbps = 0;
+	mem_bound = false;
+	l2_req_mon_init();
 
 	mon_irq_enable(RD_MON, true);
 	mon_irq_enable(WR_MON, true);
@@ -331,16 +525,26 @@ static void stop_monitoring(struct devfreq *df)
 
 	disable_irq(l2pm_irq);
 	free_irq(l2pm_irq, df);
+
+	l2_req_mon_exit();
+	mem_bound = false;
 }
 
 static int devfreq_cpubw_hwmon_get_freq(struct devfreq *df,
 					unsigned long *freq,
 					u32 *flag)
 {
-	unsigned long mbps;
+	unsigned long mbps, *ab = df->data;
+	unsigned int us, miss_pct;
+	long r_mbps;
+
+	mbps = measure_bw_and_set_irq(&r_mbps, &us);
+
+	miss_pct = l2_miss_pct(r_mbps, us);
+	ACCESS_ONCE(mem_bound) = mem_bound_ratio && miss_pct >= mem_bound_ratio;
 
-	mbps = measure_bw_and_set_irq();
-	compute_bw(mbps, freq, df->data);
+	compute_bw(mbps, freq, ab);
+	trace_cpubw_hwmon_update(mbps, miss_pct, mem_bound, *ab, *freq);
 
 	return 0;
 }
@@ -350,6 +554,9 @@ gov_attr(guard_band_mbps, 0U, 2000U);
 gov_attr(decay_rate, 0U, 100U);
 gov_attr(io_percent, 1U, 100U);
 gov_attr(bw_step, 50U, 1000U);
+gov_attr(burst_window_ms, 0U, MIN_MS);
+gov_attr(mem_bound_ratio, 0U, 100U);
+gov_attr(mem_bound_boost, 0U, 100U);
 
 static struct attribute *dev_attr[] = {
 	&dev_attr_tolerance_percent.attr,
@@ -357,6 +564,9 @@ static struct attribute *dev_attr[] = {
 	&dev_attr_decay_rate.attr,
 	&dev_attr_io_percent.attr,
 	&dev_attr_bw_step.attr,
+	&dev_attr_burst_window_ms.attr,
+	&dev_attr_mem_bound_ratio.attr,
+	&dev_attr_mem_bound_boost.attr,
 	NULL,
 };
 
@@ -0,0 +1,311 @@
+/* Copyright (c) 2010-2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#include <linux/errno.h>
+#include <linux/module.h>
+#include <linux/devfreq.h>
+#include <linux/math64.h>
+#include <linux/device.h>
+#include <linux/sysfs.h>
+#include <linux/msm_adreno_devfreq.h>
+#include "governor.h"
+
+/*
+ * In-kernel version of the busy/total based GPU DCVS algorithm used by
+ * msm-adreno-tz.  The decision is taken without a TrustZone round trip,
+ * so sampling on every idle/retire notification stays cheap.
+ */
+
+/*
+ * FLOOR is 5msec to capture up to 3 re-draws
+ * per frame for 60fps content.
+ */
+#define FLOOR			5000
+
+/*
+ * CEILING is 50msec, larger than any standard
+ * frame length, but less than the idle timer.
+ */
+#define CEILING			50000
+
+#define TAG "msm_adreno_native: "
+
+/* Busy percentage above which the GPU moves to a faster level */
+static unsigned int up_threshold = 70;
+/* Busy percentage below which the GPU moves one level slower */
+static unsigned int down_threshold = 50;
+/*
+ * Expected frame rate of the foreground content, 0 if unknown.  When set
+ * the busy ratio is evaluated over one frame period rather than FLOOR so
+ * that a decision never mixes the render and the idle parts of a frame.
+ */
+static unsigned int frame_rate_hint;
+
+static s64 native_window_us(void)
+{
+	unsigned int fps = ACCESS_ONCE(frame_rate_hint);
+
+	if (!fps)
+		return FLOOR;
+
+	return max_t(s64, FLOOR, USEC_PER_SEC / fps);
+}
+
+/*
+ * Returns the slowest level whose frequency keeps the measured load at
+ * or below the midpoint of the two thresholds.
+ */
+static int native_level_for_load(struct devfreq *devfreq, int level,
+				 unsigned int load)
+{
+	unsigned int *table = devfreq->profile->freq_table;
+	unsigned int target = (up_threshold + down_threshold) / 2;
+	u64 need;
+	int i;
+
+	need = (u64)table[level] * load;
+	do_div(need, max(target, 1U));
+
+	for (i = devfreq->profile->max_state - 1; i > 0; i--)
+		if (table[i] >= need)
+			break;
+
+	/* Always take at least one step when over the up threshold */
+	return min(i, level - 1);
+}
+
+static int native_get_target_freq(struct devfreq *devfreq,
+				  unsigned long *freq, u32 *flag)
+{
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+	struct devfreq_dev_status stats;
+	int result, level;
+	unsigned int load;
+
+	stats.private_data = NULL;
+	result = devfreq->profile->get_dev_status(devfreq->dev.parent, &stats);
+	if (result) {
+		pr_err(TAG "get_status failed %d\n", result);
+		return result;
+	}
+
+	*freq = stats.current_frequency;
+	*flag = 0;
+	priv->bin.total_time += stats.total_time;
+	priv->bin.busy_time += stats.busy_time;
+
+	if ((stats.total_time == 0) ||
+		(priv->bin.total_time < native_window_us()))
+		return 1;
+
+	level = devfreq_get_freq_level(devfreq, stats.current_frequency);
+	if (level < 0) {
+		pr_err(TAG "bad freq %ld\n", stats.current_frequency);
+		return level;
+	}
+
+	/*
+	 * If there is an extended block of busy processing go straight to
+	 * the fastest level, as the TZ algorithm does.
+	 */
+	if (priv->bin.busy_time > CEILING) {
+		level = 0;
+	} else {
+		load = div64_s64(priv->bin.busy_time * 100,
+				 priv->bin.total_time);
+		if (load > up_threshold && level > 0)
+			level = native_level_for_load(devfreq, level, load);
+		else if (load < down_threshold &&
+			 level < devfreq->profile->max_state - 1)
+			level++;
+	}
+	priv->bin.total_time = 0;
+	priv->bin.busy_time = 0;
+
+	*freq = devfreq->profile->freq_table[level];
+	return 0;
+}
+
+static int native_notify(struct notifier_block *nb, unsigned long type,
+			 void *devp)
+{
+	int result = 0;
+	struct devfreq *devfreq = devp;
+
+	switch (type) {
+	case ADRENO_DEVFREQ_NOTIFY_IDLE:
+	case ADRENO_DEVFREQ_NOTIFY_RETIRE:
+		mutex_lock(&devfreq->lock);
+		result = update_devfreq(devfreq);
+		mutex_unlock(&devfreq->lock);
+		break;
+	/* ignored by this governor */
+	case ADRENO_DEVFREQ_NOTIFY_SUBMIT:
+	default:
+		break;
+	}
+	return notifier_from_errno(result);
+}
+
+#define show_attr(name) \
+static ssize_t show_##name(struct device *dev,				\
+			struct device_attribute *attr, char *buf)	\
+{									\
+	return sprintf(buf, "%u\n", name);				\
+}
+
+#define store_attr(name, _min, _max) \
+static ssize_t store_##name(struct device *dev,				\
+			struct device_attribute *attr, const char *buf,	\
+			size_t count)					\
+{									\
+	int ret;							\
+	unsigned int val;						\
+	ret = sscanf(buf, "%u", &val);					\
+	if (ret != 1)							\
+		return -EINVAL;						\
+	val = max(val, _min);						\
+	val = min(val, _max);						\
+	name = val;							\
+	return count;							\
+}
+
+#define gov_attr(__attr, min, max)	\
+show_attr(__attr)			\
+store_attr(__attr, min, max)		\
+static DEVICE_ATTR(__attr, 0644, show_##__attr, store_##__attr)
+
+gov_attr(up_threshold, 1U, 100U);
+gov_attr(down_threshold, 0U, 99U);
+gov_attr(frame_rate_hint, 0U, 240U);
+
+static struct attribute *dev_attr[] = {
+	&dev_attr_up_threshold.attr,
+	&dev_attr_down_threshold.attr,
+	&dev_attr_frame_rate_hint.attr,
+	NULL,
+};
+
+static struct attribute_group dev_attr_group = {
+	.name = "adreno_native",
+	.attrs = dev_attr,
+};
+
+static int native_start(struct devfreq *devfreq)
+{
+	struct devfreq_msm_adreno_tz_data *priv;
+	int ret;
+
+	if (devfreq->data == NULL) {
+		pr_err(TAG "data is required for this governor\n");
+		return -EINVAL;
+	}
+
+	priv = devfreq->data;
+	priv->nb.notifier_call = native_notify;
+	priv->bin.total_time = 0;
+	priv->bin.busy_time = 0;
+
+	ret = sysfs_create_group(&devfreq->dev.kobj, &dev_attr_group);
+	if (ret)
+		return ret;
+
+	ret = kgsl_devfreq_add_notifier(devfreq->dev.parent, &priv->nb);
+	if (ret)
+		sysfs_remove_group(&devfreq->dev.kobj, &dev_attr_group);
+
+	return ret;
+}
+
+static int native_stop(struct devfreq *devfreq)
+{
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	kgsl_devfreq_del_notifier(devfreq->dev.parent, &priv->nb);
+	sysfs_remove_group(&devfreq->dev.kobj, &dev_attr_group);
+	return 0;
+}
+
+static int native_resume(struct devfreq *devfreq)
+{
+	struct devfreq_dev_profile *profile = devfreq->profile;
+	unsigned long freq;
+
+	freq = profile->initial_freq;
+
+	return profile->target(devfreq->dev.parent, &freq, 0);
+}
+
+static int native_suspend(struct devfreq *devfreq)
+{
+	struct devfreq_msm_adreno_tz_data *priv = devfreq->data;
+
+	priv->bin.total_time = 0;
+	priv->bin.busy_time = 0;
+	return 0;
+}
+
+static int native_handler(struct devfreq *devfreq, unsigned int event,
+			  void *data)
+{
+	int result;
+	BUG_ON(devfreq == NULL);
+
+	switch (event) {
+	case DEVFREQ_GOV_START:
+		result = native_start(devfreq);
+		break;
+
+	case DEVFREQ_GOV_STOP:
+		result = native_stop(devfreq);
+		break;
+
+	case DEVFREQ_GOV_SUSPEND:
+		result = native_suspend(devfreq);
+		break;
+
+	case DEVFREQ_GOV_RESUME:
+		result = native_resume(devfreq);
+		break;
+
+	case DEVFREQ_GOV_INTERVAL:
+		/* ignored, this governor doesn't use polling */
+	default:
+		result = 0;
+		break;
+	}
+
+	return result;
+}
+
+static struct devfreq_governor msm_adreno_native = {
+	.name = "adreno-native",
+	.get_target_freq = native_get_target_freq,
+	.event_handler = native_handler,
+};
+
+static int __init msm_adreno_native_init(void)
+{
+	return devfreq_add_governor(&msm_adreno_native);
+}
+subsys_initcall(msm_adreno_native_init);
+
+static void __exit msm_adreno_native_exit(void)
+{
+	int ret;
+	ret = devfreq_remove_governor(&msm_adreno_native);
+	if (ret)
+		pr_err(TAG "failed to remove governor %d\n", ret);
+}
+module_exit(msm_adreno_native_exit);
+
+MODULE_LICENSE("GPL v2");
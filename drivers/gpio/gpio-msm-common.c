@@ -27,6 +27,7 @@
 #include <linux/err.h>
 #include <linux/platform_device.h>
 #include <linux/slab.h>
+#include <linux/wakeup_reason.h>
 
 #include <mach/msm_iomap.h>
 #include <mach/gpiomux.h>
@@ -393,6 +394,7 @@ void msm_gpio_show_resume_irq(void)
 
 			pr_warning("%s: %d triggered %s\n",
 					__func__, irq, name);
+			log_wakeup_reason(irq);
 		}
 	}
 	spin_unlock_irqrestore(&tlmm_lock, irq_flags);
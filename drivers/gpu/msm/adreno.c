@@ -19,6 +19,7 @@
 #include <linux/delay.h>
 #include <linux/of_coresight.h>
 #include <linux/input.h>
+#include <linux/cpu_boost.h>
 
 #include <linux/msm-bus-board.h>
 #include <linux/msm-bus.h>
@@ -69,9 +70,14 @@ static struct devfreq_msm_adreno_tz_data adreno_tz_data = {
 	.device_id = KGSL_DEVICE_3D0,
 };
 
+static struct devfreq_msm_adreno_tz_data adreno_native_data = {
+	.device_id = KGSL_DEVICE_3D0,
+};
+
 static const struct devfreq_governor_data adreno_governors[] = {
 	{ .name = "simple_ondemand", .data = &adreno_ondemand_data },
 	{ .name = "msm-adreno-tz", .data = &adreno_tz_data },
+	{ .name = "adreno-native", .data = &adreno_native_data },
 };
 
 static const struct kgsl_functable adreno_functable;
@@ -117,12 +123,12 @@ static struct workqueue_struct *adreno_wq;
 /* Nice level for the higher priority GPU start thread */
 static unsigned int _wake_nice = -7;
 
-/* Number of milliseconds to stay active active after a wake on touch */
+/* Number of milliseconds to stay active after a wake on touch or vsync */
 static unsigned int _wake_timeout = 100;
 
 /*
  * A workqueue callback responsible for actually turning on the GPU after a
- * touch event. kgsl_pwrctrl_wake() is used without any active_count protection
+ * touch event or a vsync hint. kgsl_pwrctrl_wake() is used without any active_count protection
  * to avoid the need to maintain state.  Either somebody will start using the
  * GPU or the idle timer will fire and put the GPU back into slumber
  */
@@ -135,6 +141,8 @@ static void adreno_input_work(struct work_struct *work)
 	kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
 
 	device->flags |= KGSL_FLAG_WAKE_ON_TOUCH;
+	if (device->state == KGSL_STATE_SLUMBER)
+		device->pwrctrl.prewake_count++;
 
 	/*
 	 * Don't schedule adreno_start in a high priority workqueue, we are
@@ -153,6 +161,20 @@ static void adreno_input_work(struct work_struct *work)
 	kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
 }
 
+/*
+ * Only queue the wake work under certain circumstances: we have to be in
+ * slumber and we had to have processed an IB since the last time we woke
+ * up ahead of one.
+ */
+static void adreno_prewake(struct kgsl_device *device)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+
+	if (!(device->flags & KGSL_FLAG_WAKE_ON_TOUCH) &&
+		(device->state == KGSL_STATE_SLUMBER))
+		schedule_work(&adreno_dev->input_work);
+}
+
 /*
  * Process input events and schedule work if needed.  At this point we are only
  * interested in groking EV_ABS touchscreen events
@@ -161,17 +183,25 @@ static void adreno_input_event(struct input_handle *handle, unsigned int type,
 		unsigned int code, int value)
 {
 	struct kgsl_device *device = handle->handler->private;
-	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
 
-	/*
-	 * Only queue the work under certain circumstances: we have to be in
-	 * slumber, the event has to be EV_EBS and we had to have processed an
-	 * IB since the last time we called wake on touch.
-	 */
-	if ((type == EV_ABS) &&
-		!(device->flags & KGSL_FLAG_WAKE_ON_TOUCH) &&
-		(device->state == KGSL_STATE_SLUMBER))
-		schedule_work(&adreno_dev->input_work);
+	if (type == EV_ABS)
+		adreno_prewake(device);
+}
+
+/*
+ * The display turns vsync on when the compositor has a frame to draw, which
+ * is our cue to start the GPU before the first command batch shows up.
+ */
+static int adreno_vsync_hint(struct notifier_block *nb,
+		unsigned long event, void *data)
+{
+	struct adreno_device *adreno_dev = container_of(nb,
+			struct adreno_device, vsync_nb);
+
+	if (event == FRAME_HINT_VSYNC)
+		adreno_prewake(&adreno_dev->dev);
+
+	return NOTIFY_OK;
 }
 
 #ifdef CONFIG_INPUT
@@ -730,6 +760,8 @@ static void adreno_cleanup_pt(struct kgsl_device *device,
 	kgsl_mmu_unmap(pagetable, &device->mmu.setstate_memory);
 
 	kgsl_mmu_unmap(pagetable, &adreno_dev->profile.shared_buffer);
+
+	kgsl_mmu_unmap(pagetable, &adreno_dev->timing.buffer);
 }
 
 static int adreno_setup_pt(struct kgsl_device *device,
@@ -762,6 +794,10 @@ static int adreno_setup_pt(struct kgsl_device *device,
 		result = kgsl_mmu_map_global(pagetable,
 			&adreno_dev->profile.shared_buffer);
 
+	if (!result)
+		result = kgsl_mmu_map_global(pagetable,
+			&adreno_dev->timing.buffer);
+
 	if (result) {
 		/* On error clean up what we have wrought */
 		adreno_cleanup_pt(device, pagetable);
@@ -1638,6 +1674,7 @@ adreno_probe(struct platform_device *pdev)
 
 	adreno_debugfs_init(device);
 	adreno_profile_init(device);
+	adreno_timing_init(device);
 
 	adreno_ft_init_sysfs(device);
 
@@ -1653,6 +1690,8 @@ adreno_probe(struct platform_device *pdev)
 	if (input_register_handler(&adreno_input_handler))
 		KGSL_DRV_ERR(device, "Unable to register the input handler\n");
 #endif
+	adreno_dev->vsync_nb.notifier_call = adreno_vsync_hint;
+	frame_boost_register_notifier(&adreno_dev->vsync_nb);
 out:
 	if (status) {
 		adreno_ringbuffer_close(&adreno_dev->ringbuffer);
@@ -1673,10 +1712,12 @@ static int adreno_remove(struct platform_device *pdev)
 #ifdef CONFIG_INPUT
 	input_unregister_handler(&adreno_input_handler);
 #endif
+	frame_boost_unregister_notifier(&adreno_dev->vsync_nb);
 	adreno_ft_uninit_sysfs(device);
 
 	adreno_coresight_remove(device);
 	adreno_profile_close(device);
+	adreno_timing_close(device);
 
 	kgsl_pwrscale_close(device);
 
@@ -2423,6 +2464,7 @@ static FT_DEVICE_ATTR(ft_hang_intr_status);
 
 static DEVICE_INT_ATTR(wake_nice, 0644, _wake_nice);
 static FT_DEVICE_ATTR(wake_timeout);
+static DEVICE_BOOL_ATTR(submit_timing, 0644, device_3d0.timing.enabled);
 
 static const struct device_attribute *ft_attr_list[] = {
 	&dev_attr_ft_policy,
@@ -2432,6 +2474,7 @@ static const struct device_attribute *ft_attr_list[] = {
 	&dev_attr_ft_hang_intr_status,
 	&dev_attr_wake_nice.attr,
 	&dev_attr_wake_timeout,
+	&dev_attr_submit_timing.attr,
 	NULL,
 };
 
@@ -2507,6 +2550,29 @@ static int adreno_getproperty(struct kgsl_device *device,
 			status = 0;
 		}
 		break;
+	case KGSL_PROP_TIMING_BUFFER:
+		{
+			struct kgsl_shadowprop shadowprop;
+			struct kgsl_memdesc *buffer = &adreno_dev->timing.buffer;
+
+			if (sizebytes != sizeof(shadowprop)) {
+				status = -EINVAL;
+				break;
+			}
+			memset(&shadowprop, 0, sizeof(shadowprop));
+			if (adreno_dev->timing.count) {
+				shadowprop.gpuaddr = buffer->gpuaddr;
+				shadowprop.size = buffer->size;
+				shadowprop.flags = KGSL_FLAGS_INITIALIZED;
+			}
+			if (copy_to_user(value, &shadowprop,
+				sizeof(shadowprop))) {
+				status = -EFAULT;
+				break;
+			}
+			status = 0;
+		}
+		break;
 	case KGSL_PROP_MMU_ENABLE:
 		{
 			int mmu_prop = kgsl_mmu_enabled();
@@ -17,6 +17,7 @@
 #include "adreno_drawctxt.h"
 #include "adreno_ringbuffer.h"
 #include "adreno_profile.h"
+#include "adreno_timing.h"
 #include "kgsl_iommu.h"
 #include <linux/stat.h>
 
@@ -105,6 +106,18 @@ enum adreno_gpurev {
 
 #define ADRENO_DISPATCH_CMDQUEUE_SIZE 128
 
+/**
+ * struct adreno_dispatcher_latency - queue latency for one context priority
+ * @count: Number of command batches submitted at this priority
+ * @total_us: Total time those command batches waited in their context queue
+ * @max_us: Longest time a command batch waited in its context queue
+ */
+struct adreno_dispatcher_latency {
+	unsigned int count;
+	u64 total_us;
+	unsigned int max_us;
+};
+
 /**
  * struct adreno_dispatcher - container for the adreno GPU dispatcher
  * @mutex: Mutex to protect the structure
@@ -122,6 +135,7 @@ enum adreno_gpurev {
  * @work: work_struct to put the dispatcher in a work queue
  * @kobj: kobject for the dispatcher directory in the device sysfs node
  * @idle_gate: Gate to wait on for dispatcher to idle
+ * @latency: Per context priority queue latency of submitted command batches
  */
 struct adreno_dispatcher {
 	struct mutex mutex;
@@ -138,6 +152,7 @@ struct adreno_dispatcher {
 	struct work_struct work;
 	struct kobject kobj;
 	struct completion idle_gate;
+	struct adreno_dispatcher_latency latency[ADRENO_CONTEXT_PRIORITY_LEVELS];
 };
 
 enum adreno_dispatcher_flags {
@@ -187,11 +202,13 @@ struct adreno_device {
 	unsigned int gpulist_index;
 	struct ocmem_buf *ocmem_hdl;
 	struct adreno_profile profile;
+	struct adreno_timing timing;
 	struct adreno_dispatcher dispatcher;
 	struct kgsl_memdesc pwron_fixup;
 	unsigned int pwron_fixup_dwords;
 	struct work_struct start_work;
 	struct work_struct input_work;
+	struct notifier_block vsync_nb;
 	struct adreno_busy_data busy_data;
 	unsigned int ram_cycles_lo;
 	unsigned int starved_ram_lo;
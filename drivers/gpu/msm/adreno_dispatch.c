@@ -46,6 +46,13 @@ static unsigned int _fault_throttle_burst = 3;
 /* Number of command batches inflight in the ringbuffer at any time */
 static unsigned int _dispatcher_inflight = 15;
 
+/*
+ * Number of inflight slots that contexts at medium priority or below may
+ * fill.  The rest are kept for higher priority contexts such as the
+ * compositor so they never queue behind a full ringbuffer of app work.
+ */
+static unsigned int _dispatcher_low_prio_inflight = 10;
+
 /* Command batch timeout (in milliseconds) */
 static unsigned int _cmdbatch_timeout = 2000;
 
@@ -250,6 +257,22 @@ static inline int adreno_dispatcher_requeue_cmdbatch(
 	return 0;
 }
 
+/**
+ * _dispatcher_prio_inflight() - Return the inflight limit for a context
+ * @drawctxt: Pointer to the adreno draw context
+ *
+ * The limit never grows as the priority drops, so once the highest priority
+ * pending context is out of room so is everything queued behind it.
+ */
+static inline unsigned int _dispatcher_prio_inflight(
+		struct adreno_context *drawctxt)
+{
+	if (drawctxt->base.priority < KGSL_CONTEXT_PRIORITY_MED)
+		return _dispatcher_inflight;
+
+	return min(_dispatcher_low_prio_inflight, _dispatcher_inflight);
+}
+
 /**
  * dispatcher_queue_context() - Queue a context in the dispatcher pending list
  * @dispatcher: Pointer to the adreno dispatcher struct
@@ -341,6 +364,17 @@ static int sendcmd(struct adreno_device *adreno_dev,
 
 	trace_adreno_cmdbatch_submitted(cmdbatch, dispatcher->inflight);
 
+	if (cmdbatch->context->priority < ADRENO_CONTEXT_PRIORITY_LEVELS) {
+		struct adreno_dispatcher_latency *latency =
+			&dispatcher->latency[cmdbatch->context->priority];
+		unsigned int us = ktime_us_delta(ktime_get(), cmdbatch->queued);
+
+		latency->count++;
+		latency->total_us += us;
+		if (us > latency->max_us)
+			latency->max_us = us;
+	}
+
 	dispatcher->cmdqueue[dispatcher->tail] = cmdbatch;
 	dispatcher->tail = (dispatcher->tail + 1) %
 		ADRENO_DISPATCH_CMDQUEUE_SIZE;
@@ -386,7 +420,7 @@ static int dispatcher_context_sendcmds(struct adreno_device *adreno_dev,
 	 * Each context can send a specific number of command batches per cycle
 	 */
 	while ((count < _context_cmdbatch_burst) &&
-		(dispatcher->inflight < _dispatcher_inflight)) {
+		(dispatcher->inflight < _dispatcher_prio_inflight(drawctxt))) {
 		int ret;
 		struct kgsl_cmdbatch *cmdbatch;
 
@@ -496,6 +530,13 @@ static int _adreno_dispatcher_issuecmds(struct adreno_device *adreno_dev)
 		drawctxt = plist_first_entry(&dispatcher->pending,
 			struct adreno_context, pending);
 
+		/* Leave the rest for when higher priority work retires */
+		if (dispatcher->inflight >=
+				_dispatcher_prio_inflight(drawctxt)) {
+			spin_unlock(&dispatcher->plist_lock);
+			break;
+		}
+
 		plist_del(&drawctxt->pending, &dispatcher->pending);
 
 		spin_unlock(&dispatcher->plist_lock);
@@ -734,6 +775,7 @@ int adreno_dispatcher_queue_cmd(struct adreno_device *adreno_dev,
 	}
 
 	cmdbatch->timestamp = *timestamp;
+	cmdbatch->queued = ktime_get();
 
 	/*
 	 * Set the fault tolerance policy for the command batch - assuming the
@@ -1704,8 +1746,42 @@ static ssize_t _show_uint(struct adreno_dispatcher *dispatcher,
 		*((unsigned int *) attr->value));
 }
 
+static ssize_t _show_latency(struct adreno_dispatcher *dispatcher,
+		struct dispatcher_attribute *attr,
+		char *buf)
+{
+	ssize_t len = 0;
+	int i;
+
+	mutex_lock(&dispatcher->mutex);
+
+	for (i = 0; i < ADRENO_CONTEXT_PRIORITY_LEVELS; i++) {
+		struct adreno_dispatcher_latency *latency =
+			&dispatcher->latency[i];
+
+		if (!latency->count)
+			continue;
+
+		len += snprintf(buf + len, PAGE_SIZE - len,
+			"%d: count %u avg_us %llu max_us %u\n", i,
+			latency->count,
+			div_u64(latency->total_us, latency->count),
+			latency->max_us);
+	}
+
+	mutex_unlock(&dispatcher->mutex);
+
+	return len;
+}
+
 static DISPATCHER_UINT_ATTR(inflight, 0644, ADRENO_DISPATCH_CMDQUEUE_SIZE,
 	_dispatcher_inflight);
+static DISPATCHER_UINT_ATTR(low_prio_inflight, 0644,
+	ADRENO_DISPATCH_CMDQUEUE_SIZE, _dispatcher_low_prio_inflight);
+static struct dispatcher_attribute dispatcher_attr_queue_latency = {
+	.attr = { .name = "queue_latency", .mode = 0444 },
+	.show = _show_latency,
+};
 /*
  * Our code that "puts back" a command from the context is much cleaner
  * if we are sure that there will always be enough room in the
@@ -1727,6 +1803,8 @@ static DISPATCHER_UINT_ATTR(fault_throttle_burst, 0644, 0,
 
 static struct attribute *dispatcher_attrs[] = {
 	&dispatcher_attr_inflight.attr,
+	&dispatcher_attr_low_prio_inflight.attr,
+	&dispatcher_attr_queue_latency.attr,
 	&dispatcher_attr_context_cmdqueue_size.attr,
 	&dispatcher_attr_context_burst_count.attr,
 	&dispatcher_attr_cmdbatch_timeout.attr,
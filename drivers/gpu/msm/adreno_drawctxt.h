@@ -31,6 +31,13 @@ struct adreno_context_type {
 
 #define ADRENO_CONTEXT_CMDQUEUE_SIZE 128
 
+/*
+ * Context priorities come from KGSL_CONTEXT_PRIORITY_MASK, lower values are
+ * more important.  Contexts that don't ask get the medium priority.
+ */
+#define ADRENO_CONTEXT_PRIORITY_LEVELS 16
+#define KGSL_CONTEXT_PRIORITY_MED	0x8
+
 #define ADRENO_CONTEXT_STATE_ACTIVE 0
 #define ADRENO_CONTEXT_STATE_INVALID 1
 
@@ -607,6 +607,7 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 	unsigned int context_id;
 	unsigned int gpuaddr = rb->device->memstore.gpuaddr;
 	bool profile_ready;
+	bool timing_ready;
 
 	if (drawctxt != NULL && kgsl_context_detached(&drawctxt->base))
 		return -EINVAL;
@@ -642,6 +643,11 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 		adreno_profile_assignments_ready(&adreno_dev->profile) &&
 		!(flags & KGSL_CMD_FLAGS_INTERNAL_ISSUE);
 
+	/* Same for timing user submissions into the shared timing buffer */
+	timing_ready = drawctxt &&
+		adreno_timing_enabled(&adreno_dev->timing) &&
+		!(flags & KGSL_CMD_FLAGS_INTERNAL_ISSUE);
+
 	/* reserve space to temporarily turn off protected mode
 	*  error checking if needed
 	*/
@@ -677,6 +683,9 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 	if (profile_ready)
 		total_sizedwords += 6;   /* space for pre_ib and post_ib */
 
+	if (timing_ready)
+		total_sizedwords += ADRENO_TIMING_DWORDS;
+
 	/* Add space for the power on shader fixup if we need it */
 	if (flags & KGSL_CMD_FLAGS_PWRON_FIXUP)
 		total_sizedwords += 9;
@@ -734,6 +743,10 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 		KGSL_MEMSTORE_OFFSET(context_id, soptimestamp)));
 	GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu, timestamp);
 
+	if (timing_ready)
+		adreno_timing_preib_processing(rb->device, drawctxt,
+				timestamp, &ringcmds, &rcmd_gpu);
+
 	if (flags & KGSL_CMD_FLAGS_PMODE) {
 		/* disable protected mode error checking */
 		GSL_RB_WRITE(rb->device, ringcmds, rcmd_gpu,
@@ -772,6 +785,10 @@ adreno_ringbuffer_addcmds(struct adreno_ringbuffer *rb,
 		adreno_profile_postib_processing(rb->device, &flags,
 						 &ringcmds, &rcmd_gpu);
 
+	if (timing_ready)
+		adreno_timing_postib_processing(rb->device, timestamp,
+						&ringcmds, &rcmd_gpu);
+
 	/*
 	 * end-of-pipeline timestamp.  If per context timestamps is not
 	 * enabled, then context_id will be KGSL_MEMSTORE_GLOBAL so all
@@ -0,0 +1,155 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/msm_kgsl.h>
+
+#include "kgsl.h"
+#include "kgsl_sharedmem.h"
+#include "adreno.h"
+#include "adreno_pm4types.h"
+#include "adreno_ringbuffer.h"
+
+/*
+ * Every submission from a user context gets an entry in a ring that lives in
+ * a buffer userspace maps read only.  The kernel fills in the context and
+ * timestamp when the commands are queued and the CP samples the free running
+ * GPU busy cycle counter before and after the IBs, then copies the timestamp
+ * into the retired field to mark the entry complete.  Profilers can tell GPU
+ * bound frames from CPU bound ones without making a single syscall.
+ */
+
+#define TIMING_ENTRY_OFFSET(_i, _field) \
+	(sizeof(struct kgsl_timing_header) + \
+	 (_i) * sizeof(struct kgsl_timing_entry) + \
+	 offsetof(struct kgsl_timing_entry, _field))
+
+/**
+ * adreno_timing_preib_processing() - Start timing a submission
+ * @device: Pointer to the KGSL device
+ * @drawctxt: Context the submission belongs to
+ * @timestamp: Timestamp of the submission
+ * @rbptr: Pointer to the ringbuffer write pointer
+ * @cmds_gpu: Pointer to the GPU address of the ringbuffer write pointer
+ *
+ * Claim the next entry in the ring and write the commands that sample the
+ * busy counter into its start field.  Called with the device mutex held.
+ */
+void adreno_timing_preib_processing(struct kgsl_device *device,
+		struct adreno_context *drawctxt, unsigned int timestamp,
+		unsigned int **rbptr, unsigned int *cmds_gpu)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct adreno_timing *timing = &adreno_dev->timing;
+	struct kgsl_memdesc *buffer = &timing->buffer;
+	unsigned int i = timing->head;
+
+	kgsl_sharedmem_writel(device, buffer,
+		TIMING_ENTRY_OFFSET(i, retired), 0);
+	kgsl_sharedmem_writel(device, buffer,
+		TIMING_ENTRY_OFFSET(i, context_id), drawctxt->base.id);
+	kgsl_sharedmem_writel(device, buffer,
+		TIMING_ENTRY_OFFSET(i, timestamp), timestamp);
+
+	timing->head = (i + 1) % timing->count;
+	kgsl_sharedmem_writel(device, buffer,
+		offsetof(struct kgsl_timing_header, head), timing->head);
+
+	GSL_RB_WRITE(device, (*rbptr), (*cmds_gpu),
+		cp_type3_packet(CP_REG_TO_MEM, 2));
+	GSL_RB_WRITE(device, (*rbptr), (*cmds_gpu),
+		adreno_getreg(adreno_dev, ADRENO_REG_RBBM_PERFCTR_PWR_1_LO));
+	GSL_RB_WRITE(device, (*rbptr), (*cmds_gpu),
+		buffer->gpuaddr + TIMING_ENTRY_OFFSET(i, start));
+}
+
+/**
+ * adreno_timing_postib_processing() - Finish timing a submission
+ * @device: Pointer to the KGSL device
+ * @timestamp: Timestamp of the submission
+ * @rbptr: Pointer to the ringbuffer write pointer
+ * @cmds_gpu: Pointer to the GPU address of the ringbuffer write pointer
+ *
+ * Sample the busy counter into the end field of the entry claimed by
+ * adreno_timing_preib_processing() and then mark the entry complete.  The
+ * caller makes sure the IBs have gone idle first.
+ */
+void adreno_timing_postib_processing(struct kgsl_device *device,
+		unsigned int timestamp, unsigned int **rbptr,
+		unsigned int *cmds_gpu)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct adreno_timing *timing = &adreno_dev->timing;
+	unsigned int i = (timing->head + timing->count - 1) % timing->count;
+	unsigned int gpuaddr = timing->buffer.gpuaddr;
+
+	GSL_RB_WRITE(device, (*rbptr), (*cmds_gpu),
+		cp_type3_packet(CP_REG_TO_MEM, 2));
+	GSL_RB_WRITE(device, (*rbptr), (*cmds_gpu),
+		adreno_getreg(adreno_dev, ADRENO_REG_RBBM_PERFCTR_PWR_1_LO));
+	GSL_RB_WRITE(device, (*rbptr), (*cmds_gpu),
+		gpuaddr + TIMING_ENTRY_OFFSET(i, end));
+
+	GSL_RB_WRITE(device, (*rbptr), (*cmds_gpu),
+		cp_type3_packet(CP_MEM_WRITE, 2));
+	GSL_RB_WRITE(device, (*rbptr), (*cmds_gpu),
+		gpuaddr + TIMING_ENTRY_OFFSET(i, retired));
+	GSL_RB_WRITE(device, (*rbptr), (*cmds_gpu), timestamp);
+}
+
+/**
+ * adreno_timing_init() - Allocate the timing buffer
+ * @device: Pointer to the KGSL device
+ *
+ * Timing is on by default and stays off if the buffer can't be allocated.
+ */
+void adreno_timing_init(struct kgsl_device *device)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct adreno_timing *timing = &adreno_dev->timing;
+
+	timing->head = 0;
+	timing->count = 0;
+
+	if (kgsl_allocate_contiguous(device, &timing->buffer,
+			ADRENO_TIMING_BUF_SIZE)) {
+		memset(&timing->buffer, 0, sizeof(timing->buffer));
+		return;
+	}
+
+	timing->count = (ADRENO_TIMING_BUF_SIZE -
+		sizeof(struct kgsl_timing_header)) /
+		sizeof(struct kgsl_timing_entry);
+
+	kgsl_sharedmem_set(device, &timing->buffer, 0, 0,
+		timing->buffer.size);
+	kgsl_sharedmem_writel(device, &timing->buffer,
+		offsetof(struct kgsl_timing_header, count), timing->count);
+
+	device->timing_buffer = &timing->buffer;
+	timing->enabled = true;
+}
+
+/**
+ * adreno_timing_close() - Free the timing buffer
+ * @device: Pointer to the KGSL device
+ */
+void adreno_timing_close(struct kgsl_device *device)
+{
+	struct adreno_device *adreno_dev = ADRENO_DEVICE(device);
+	struct adreno_timing *timing = &adreno_dev->timing;
+
+	timing->enabled = false;
+	timing->count = 0;
+	device->timing_buffer = NULL;
+	kgsl_sharedmem_free(&timing->buffer);
+}
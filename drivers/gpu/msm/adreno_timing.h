@@ -0,0 +1,53 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+#ifndef __ADRENO_TIMING_H
+#define __ADRENO_TIMING_H
+
+/* Size of the buffer shared with userspace, header plus entries */
+#define ADRENO_TIMING_BUF_SIZE	(4 * PAGE_SIZE)
+
+/* Ringbuffer dwords added to each timed submission */
+#define ADRENO_TIMING_DWORDS	9
+
+/**
+ * struct adreno_timing - per submission GPU timing capture
+ * @buffer: Buffer shared with the GPU and mapped read only by userspace
+ * @head: Index of the next entry to be written
+ * @count: Number of entries in the buffer
+ * @enabled: True if submissions are being timed
+ */
+struct adreno_timing {
+	struct kgsl_memdesc buffer;
+	unsigned int head;
+	unsigned int count;
+	bool enabled;
+};
+
+struct adreno_device;
+struct adreno_context;
+
+void adreno_timing_init(struct kgsl_device *device);
+void adreno_timing_close(struct kgsl_device *device);
+void adreno_timing_preib_processing(struct kgsl_device *device,
+		struct adreno_context *drawctxt, unsigned int timestamp,
+		unsigned int **rbptr, unsigned int *cmds_gpu);
+void adreno_timing_postib_processing(struct kgsl_device *device,
+		unsigned int timestamp, unsigned int **rbptr,
+		unsigned int *cmds_gpu);
+
+static inline bool adreno_timing_enabled(struct adreno_timing *timing)
+{
+	return timing->enabled && timing->count;
+}
+
+#endif
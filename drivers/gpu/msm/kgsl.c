@@ -19,6 +19,7 @@
 #include <linux/debugfs.h>
 #include <linux/uaccess.h>
 #include <linux/interrupt.h>
+#include <linux/irq.h>
 #include <linux/workqueue.h>
 #include <linux/dma-buf.h>
 #include <linux/pm_runtime.h>
@@ -29,12 +30,14 @@
 #include <linux/mman.h>
 #include <linux/sort.h>
 #include <linux/security.h>
+#include <linux/vmalloc.h>
 #include <asm/cacheflush.h>
 
 #include "kgsl.h"
 #include "kgsl_debugfs.h"
 #include "kgsl_cffdump.h"
 #include "kgsl_log.h"
+#include "kgsl_pool.h"
 #include "kgsl_sharedmem.h"
 #include "kgsl_device.h"
 #include "kgsl_trace.h"
@@ -189,22 +192,11 @@ static void kgsl_destroy_ion(struct kgsl_dma_buf_meta *meta)
 }
 #endif
 
-void
-kgsl_mem_entry_destroy(struct kref *kref)
+/* Free an entry that has been unmapped and detached from its process */
+static void kgsl_mem_entry_release(struct kgsl_mem_entry *entry)
 {
-	struct kgsl_mem_entry *entry = container_of(kref,
-						    struct kgsl_mem_entry,
-						    refcount);
-	unsigned int memtype;
-
-	if (entry == NULL)
-		return;
-
 	/* pull out the memtype before the flags get cleared */
-	memtype = kgsl_memdesc_usermem_type(&entry->memdesc);
-
-	/* Detach from process list */
-	kgsl_mem_entry_detach_process(entry);
+	unsigned int memtype = kgsl_memdesc_usermem_type(&entry->memdesc);
 
 	if (memtype != KGSL_MEM_ENTRY_KERNEL)
 		kgsl_driver.stats.mapped -= entry->memdesc.size;
@@ -250,6 +242,45 @@ kgsl_mem_entry_destroy(struct kref *kref)
 
 	kfree(entry);
 }
+
+static void kgsl_mem_entry_release_list(struct list_head *list)
+{
+	struct kgsl_mem_entry *entry, *tmp;
+
+	list_for_each_entry_safe(entry, tmp, list, unmap_node) {
+		list_del(&entry->unmap_node);
+		kgsl_mem_entry_release(entry);
+	}
+}
+
+void
+kgsl_mem_entry_destroy(struct kref *kref)
+{
+	struct kgsl_mem_entry *entry = container_of(kref,
+						    struct kgsl_mem_entry,
+						    refcount);
+	struct kgsl_pagetable *pagetable = NULL;
+	LIST_HEAD(release);
+
+	if (entry == NULL)
+		return;
+
+	if (entry->priv)
+		pagetable = entry->priv->pagetable;
+
+	/*
+	 * Unmap inside a batch so entries freed together share one TLB
+	 * flush.  The entry is freed by whoever closes the outermost batch,
+	 * once the GPU can no longer reach its pages.
+	 */
+	kgsl_mmu_unmap_batch_begin(pagetable);
+
+	/* Detach from process list */
+	kgsl_mem_entry_detach_process(entry);
+
+	kgsl_mmu_unmap_batch_end(pagetable, &entry->unmap_node, &release);
+	kgsl_mem_entry_release_list(&release);
+}
 EXPORT_SYMBOL(kgsl_mem_entry_destroy);
 
 /**
@@ -431,12 +462,52 @@ static void kgsl_mem_entry_detach_process(struct kgsl_mem_entry *entry)
  * If it fails, the caller should just free the context structure
  * it passed in.
  */
+/**
+ * struct kgsl_submit_ring - Kernel side of a context's submit ring
+ * @pages: The pinned user pages holding the ring
+ * @nr_pages: Number of pages in @pages
+ * @hdr: Kernel mapping of the ring header
+ * @entries: Kernel mapping of the ring entries
+ * @size: Number of entries, a power of two
+ * @head: Index of the next entry to submit, kept here because the copy in
+ * @hdr can be written by the user
+ */
+struct kgsl_submit_ring {
+	struct page **pages;
+	unsigned int nr_pages;
+	struct kgsl_submit_ring_header *hdr;
+	struct kgsl_submit_ring_entry *entries;
+	unsigned int size;
+	unsigned int head;
+};
+
+static void kgsl_submit_ring_free(struct kgsl_submit_ring *ring)
+{
+	unsigned int i;
+
+	if (ring == NULL)
+		return;
+
+	if (ring->hdr)
+		vunmap(ring->hdr);
+
+	for (i = 0; i < ring->nr_pages; i++) {
+		set_page_dirty_lock(ring->pages[i]);
+		put_page(ring->pages[i]);
+	}
+
+	kfree(ring->pages);
+	kfree(ring);
+}
+
 int kgsl_context_init(struct kgsl_device_private *dev_priv,
 			struct kgsl_context *context)
 {
 	int ret = 0, id;
 	struct kgsl_device *device = dev_priv->device;
 
+	mutex_init(&context->submit_ring_lock);
+
 	idr_preload(GFP_KERNEL);
 	write_lock(&device->context_lock);
 	id = idr_alloc(&device->context_idr, context, 1, 0, GFP_NOWAIT);
@@ -499,6 +570,7 @@ EXPORT_SYMBOL(kgsl_context_init);
  */
 int kgsl_context_detach(struct kgsl_context *context)
 {
+	struct kgsl_submit_ring *ring;
 	int ret;
 
 	if (context == NULL)
@@ -512,6 +584,13 @@ int kgsl_context_detach(struct kgsl_context *context)
 	if (test_and_set_bit(KGSL_CONTEXT_DETACHED, &context->priv))
 		return -EINVAL;
 
+	/* Wait for a doorbell in progress and unpin the submit ring */
+	mutex_lock(&context->submit_ring_lock);
+	ring = context->submit_ring;
+	context->submit_ring = NULL;
+	mutex_unlock(&context->submit_ring_lock);
+	kgsl_submit_ring_free(ring);
+
 	trace_kgsl_context_detach(context->device, context);
 
 	ret = context->device->ftbl->drawctxt_detach(context);
@@ -935,6 +1014,7 @@ static int kgsl_release(struct inode *inodep, struct file *filep)
 	struct kgsl_context *context;
 	struct kgsl_mem_entry *entry;
 	int next = 0;
+	LIST_HEAD(release);
 
 	filep->private_data = NULL;
 
@@ -963,6 +1043,9 @@ static int kgsl_release(struct inode *inodep, struct file *filep)
 		next = next + 1;
 	}
 	next = 0;
+
+	/* Free the entries of the process with a single TLB flush */
+	kgsl_mmu_unmap_batch_begin(private->pagetable);
 	while (1) {
 		spin_lock(&private->mem_lock);
 		entry = idr_get_next(&private->mem_idr, &next);
@@ -985,6 +1068,8 @@ static int kgsl_release(struct inode *inodep, struct file *filep)
 		}
 		next = next + 1;
 	}
+	kgsl_mmu_unmap_batch_end(private->pagetable, NULL, &release);
+	kgsl_mem_entry_release_list(&release);
 
 	result = kgsl_close_device(device);
 	kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
@@ -2194,6 +2279,196 @@ done:
 	return result;
 }
 
+long kgsl_ioctl_submit_ring_setup(struct kgsl_device_private *dev_priv,
+				      unsigned int cmd, void *data)
+{
+	struct kgsl_submit_ring_setup *param = data;
+	struct kgsl_context *context;
+	struct kgsl_submit_ring *ring;
+	unsigned long addr = (unsigned long) param->addr;
+	size_t len;
+	long result;
+
+	if (param->size == 0 || param->size > KGSL_SUBMIT_RING_MAX_SIZE ||
+		!is_power_of_2(param->size))
+		return -EINVAL;
+
+	if (addr != param->addr || !PAGE_ALIGNED(addr))
+		return -EINVAL;
+
+	context = kgsl_context_get_owner(dev_priv, param->context_id);
+	if (context == NULL)
+		return -EINVAL;
+
+	ring = kzalloc(sizeof(*ring), GFP_KERNEL);
+	if (ring == NULL) {
+		result = -ENOMEM;
+		goto done;
+	}
+
+	len = sizeof(struct kgsl_submit_ring_header) +
+		param->size * sizeof(struct kgsl_submit_ring_entry);
+	ring->size = param->size;
+	ring->nr_pages = PAGE_ALIGN(len) >> PAGE_SHIFT;
+	ring->pages = kcalloc(ring->nr_pages, sizeof(struct page *),
+		GFP_KERNEL);
+	if (ring->pages == NULL) {
+		result = -ENOMEM;
+		goto err;
+	}
+
+	result = get_user_pages_fast(addr, ring->nr_pages, 1, ring->pages);
+	if (result != ring->nr_pages) {
+		ring->nr_pages = result > 0 ? result : 0;
+		result = -EFAULT;
+		goto err;
+	}
+
+	ring->hdr = vmap(ring->pages, ring->nr_pages, VM_MAP, PAGE_KERNEL);
+	if (ring->hdr == NULL) {
+		result = -ENOMEM;
+		goto err;
+	}
+	ring->entries = (struct kgsl_submit_ring_entry *)(ring->hdr + 1);
+
+	ring->hdr->head = 0;
+	ring->hdr->tail = 0;
+	ring->hdr->size = ring->size;
+
+	mutex_lock(&context->submit_ring_lock);
+	if (context->submit_ring || kgsl_context_detached(context))
+		result = -EBUSY;
+	else {
+		context->submit_ring = ring;
+		result = 0;
+	}
+	mutex_unlock(&context->submit_ring_lock);
+
+err:
+	if (result)
+		kgsl_submit_ring_free(ring);
+done:
+	kgsl_context_put(context);
+	return result;
+}
+
+/**
+ * _kgsl_submit_ring_entry() - Submit one command from a submit ring
+ * @dev_priv: Pointer to the device private struct of the caller
+ * @context: The context that owns the ring
+ * @entry: The ring entry to submit
+ *
+ * The entry is in memory the user can write to at any time, so every field
+ * is read once into the command batch before it is checked.
+ */
+static long _kgsl_submit_ring_entry(struct kgsl_device_private *dev_priv,
+		struct kgsl_context *context,
+		struct kgsl_submit_ring_entry *entry)
+{
+	struct kgsl_device *device = dev_priv->device;
+	struct kgsl_cmdbatch *cmdbatch;
+	unsigned int flags = ACCESS_ONCE(entry->flags);
+	unsigned int numibs = ACCESS_ONCE(entry->numibs);
+	unsigned int timestamp = 0;
+	long result = -EINVAL;
+	int i;
+
+	if (flags & KGSL_CONTEXT_SYNC)
+		goto done;
+
+	if (numibs == 0 || numibs > KGSL_SUBMIT_RING_MAX_IBS)
+		goto done;
+
+	cmdbatch = kgsl_cmdbatch_create(device, context, flags, numibs);
+	if (IS_ERR(cmdbatch)) {
+		result = PTR_ERR(cmdbatch);
+		goto done;
+	}
+
+	for (i = 0; i < numibs; i++) {
+		cmdbatch->ibdesc[i].gpuaddr =
+			(unsigned long) ACCESS_ONCE(entry->ibs[i].gpuaddr);
+		cmdbatch->ibdesc[i].sizedwords =
+			ACCESS_ONCE(entry->ibs[i].sizedwords);
+		cmdbatch->ibdesc[i].ctrl = ACCESS_ONCE(entry->ibs[i].ctrl);
+	}
+
+	if (!_kgsl_cmdbatch_verify(dev_priv, cmdbatch))
+		result = -EINVAL;
+	else
+		result = device->ftbl->issueibcmds(dev_priv, context,
+			cmdbatch, &timestamp);
+
+	/* -EPROTO only tells the user that the context faulted before */
+	if (result && result != -EPROTO)
+		kgsl_cmdbatch_destroy(cmdbatch);
+
+done:
+	entry->timestamp = timestamp;
+	entry->result = result;
+	return result;
+}
+
+long kgsl_ioctl_submit_ring_doorbell(struct kgsl_device_private *dev_priv,
+				      unsigned int cmd, void *data)
+{
+	struct kgsl_submit_ring_doorbell *param = data;
+	struct kgsl_context *context;
+	struct kgsl_submit_ring *ring;
+	unsigned int tail;
+	long result = 0;
+
+	param->count = 0;
+
+	context = kgsl_context_get_owner(dev_priv, param->context_id);
+	if (context == NULL)
+		return -EINVAL;
+
+	mutex_lock(&context->submit_ring_lock);
+	ring = context->submit_ring;
+	if (ring == NULL || kgsl_context_detached(context)) {
+		result = -EINVAL;
+		goto done;
+	}
+
+	tail = ACCESS_ONCE(ring->hdr->tail);
+	/* Read the entries only after the tail that covers them */
+	smp_rmb();
+
+	if (tail - ring->head > ring->size) {
+		result = -EINVAL;
+		goto done;
+	}
+
+	while (ring->head != tail) {
+		struct kgsl_submit_ring_entry *entry =
+			&ring->entries[ring->head & (ring->size - 1)];
+
+		result = _kgsl_submit_ring_entry(dev_priv, context, entry);
+		if (!result || result == -EPROTO) {
+			param->timestamp = entry->timestamp;
+			param->count++;
+		}
+
+		ring->head++;
+		/* Publish the entry results before the entry is handed back */
+		smp_wmb();
+		ring->hdr->head = ring->head;
+
+		/*
+		 * Stop at a failed entry so that the user sees the error
+		 * before any command that depends on it is submitted.
+		 */
+		if (result && result != -EPROTO)
+			break;
+	}
+
+done:
+	mutex_unlock(&context->submit_ring_lock);
+	kgsl_context_put(context);
+	return result;
+}
+
 long kgsl_ioctl_cmdstream_readtimestamp_ctxtid(struct kgsl_device_private
 						*dev_priv, unsigned int cmd,
 						void *data)
@@ -2908,6 +3183,87 @@ error:
 	return result;
 }
 
+/*
+ * _kgsl_gpumem_cpu_dirty() - Check if the CPU wrote to a range of memory
+ * since it was last cleaned
+ * @entry: The memory entry
+ * @offset: Offset of the range in the entry
+ * @length: Length of the range
+ *
+ * Write tracked memory is mapped read-only in userspace and the first write
+ * to each page faults and marks the page dirty.  Clear the dirty bits of the
+ * pages that lie entirely in the range and write protect the user mapping
+ * of the range again so that later writes are seen.  The dirty bits are
+ * cleared before the mapping is zapped, a write that slips in between is
+ * carried over to the page by the zap and only costs a spare clean next time.
+ *
+ * Returns true if the range has to be cleaned, which is always the case if
+ * writes to the memory are not tracked.
+ */
+static bool _kgsl_gpumem_cpu_dirty(struct kgsl_mem_entry *entry,
+				size_t offset, size_t length)
+{
+	struct kgsl_memdesc *memdesc = &entry->memdesc;
+	struct mm_struct *mm = current->mm;
+	struct vm_area_struct *vma = NULL;
+	unsigned long first = offset >> PAGE_SHIFT;
+	unsigned long last = PAGE_ALIGN(offset + length) >> PAGE_SHIFT;
+	unsigned long pgoff = 0;
+	struct scatterlist *s;
+	bool dirty = false;
+	int i;
+
+	/* Writes through the kernel mapping are never tracked */
+	if (!(memdesc->priv & KGSL_MEMDESC_WRTRACK) || memdesc->hostptr)
+		return true;
+
+	if (mm == NULL)
+		return true;
+
+	down_read(&mm->mmap_sem);
+
+	/* Only the process that mapped the memory can write protect it */
+	if (memdesc->useraddr) {
+		vma = find_vma(mm, memdesc->useraddr);
+		if (vma == NULL || vma->vm_start != memdesc->useraddr ||
+			vma->vm_private_data != entry) {
+			up_read(&mm->mmap_sem);
+			return true;
+		}
+	}
+
+	for_each_sg(memdesc->sg, s, memdesc->sglen, i) {
+		int j, npages = s->length >> PAGE_SHIFT;
+
+		for (j = 0; j < npages && pgoff < last; j++, pgoff++) {
+			struct page *page = nth_page(sg_page(s), j);
+
+			if (pgoff < first)
+				continue;
+
+			/* Partly covered pages keep their dirty state */
+			if ((pgoff << PAGE_SHIFT) < offset ||
+				((pgoff + 1) << PAGE_SHIFT) > offset + length)
+				dirty |= PageDirty(page) != 0;
+			else
+				dirty |= TestClearPageDirty(page) != 0;
+		}
+	}
+
+	if (vma != NULL) {
+		unsigned long start = vma->vm_start + (first << PAGE_SHIFT);
+		unsigned long end = min(vma->vm_start + (last << PAGE_SHIFT),
+					vma->vm_end);
+
+		if (start < end)
+			zap_page_range(vma, start, end - start, NULL);
+	}
+
+	up_read(&mm->mmap_sem);
+
+	return dirty;
+}
+
 static int _kgsl_gpumem_sync_cache(struct kgsl_mem_entry *entry,
 				size_t offset, size_t length, unsigned int op)
 {
@@ -2940,9 +3296,23 @@ static int _kgsl_gpumem_sync_cache(struct kgsl_mem_entry *entry,
 	mode = kgsl_memdesc_get_cachemode(&entry->memdesc);
 	if (mode != KGSL_CACHEMODE_UNCACHED
 		&& mode != KGSL_CACHEMODE_WRITECOMBINE) {
+		/*
+		 * If the CPU didn't write to the range there is nothing to
+		 * clean, a flush still has to invalidate what the GPU wrote
+		 */
+		if (cacheop != KGSL_CACHE_OP_INV &&
+			!_kgsl_gpumem_cpu_dirty(entry, offset, length)) {
+			if (cacheop == KGSL_CACHE_OP_CLEAN) {
+				kgsl_driver.stats.cache_ops_skipped++;
+				goto done;
+			}
+			cacheop = KGSL_CACHE_OP_INV;
+		}
+
 		trace_kgsl_mem_sync_cache(entry, offset, length, op);
 		ret = kgsl_cache_range_op(&entry->memdesc, offset,
 					length, cacheop);
+		kgsl_driver.stats.cache_ops_performed++;
 	}
 
 done:
@@ -3358,6 +3728,10 @@ static const struct kgsl_ioctl kgsl_ioctl_funcs[] = {
 			kgsl_ioctl_rb_issueibcmds, 0),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_SUBMIT_COMMANDS,
 			kgsl_ioctl_submit_commands, 0),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_SUBMIT_RING_SETUP,
+			kgsl_ioctl_submit_ring_setup, 0),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_SUBMIT_RING_DOORBELL,
+			kgsl_ioctl_submit_ring_doorbell, 0),
 	/* IOCTL_KGSL_CMDSTREAM_READTIMESTAMP is no longer supported */
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_CMDSTREAM_READTIMESTAMP_CTXTID,
 			kgsl_ioctl_cmdstream_readtimestamp_ctxtid,
@@ -3512,14 +3886,23 @@ static long kgsl_ioctl(struct file *filep, unsigned int cmd, unsigned long arg)
 				ARRAY_SIZE(kgsl_ioctl_funcs), arg);
 }
 
+static inline bool _is_timing_buffer(struct kgsl_device *device,
+		unsigned long vma_offset)
+{
+	return device->timing_buffer && device->timing_buffer->gpuaddr &&
+		vma_offset == device->timing_buffer->gpuaddr;
+}
+
 static int
-kgsl_mmap_memstore(struct kgsl_device *device, struct vm_area_struct *vma)
+kgsl_mmap_memstore(struct kgsl_device *device, struct kgsl_memdesc *memdesc,
+		struct vm_area_struct *vma)
 {
-	struct kgsl_memdesc *memdesc = &device->memstore;
 	int result;
 	unsigned int vma_size = vma->vm_end - vma->vm_start;
 
-	/* The memstore can only be mapped as read only */
+	/*
+	 * The memstore and the timing buffer can only be mapped as read only
+	 */
 
 	if (vma->vm_flags & VM_WRITE)
 		return -EPERM;
@@ -3533,7 +3916,7 @@ kgsl_mmap_memstore(struct kgsl_device *device, struct vm_area_struct *vma)
 	vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
 
 	result = remap_pfn_range(vma, vma->vm_start,
-				device->memstore.physaddr >> PAGE_SHIFT,
+				memdesc->physaddr >> PAGE_SHIFT,
 				 vma_size, vma->vm_page_prot);
 	if (result != 0)
 		KGSL_MEM_ERR(device, "remap_pfn_range failed: %d\n",
@@ -3550,8 +3933,14 @@ kgsl_mmap_memstore(struct kgsl_device *device, struct vm_area_struct *vma)
 static void kgsl_gpumem_vm_open(struct vm_area_struct *vma)
 {
 	struct kgsl_mem_entry *entry = vma->vm_private_data;
-	if (!kgsl_mem_entry_get(entry))
+	if (!kgsl_mem_entry_get(entry)) {
 		vma->vm_private_data = NULL;
+		return;
+	}
+
+	/* A copied or split mapping can't be write protected again */
+	entry->memdesc.priv &= ~KGSL_MEMDESC_WRTRACK;
+	entry->memdesc.priv |= KGSL_MEMDESC_NO_WRTRACK;
 }
 
 static int
@@ -3749,7 +4138,8 @@ kgsl_get_unmapped_area(struct file *file, unsigned long addr,
 	bool flag_top_down = true;
 	struct vm_unmapped_area_info info;
 
-	if (vma_offset == device->memstore.gpuaddr)
+	if (vma_offset == device->memstore.gpuaddr ||
+		_is_timing_buffer(device, vma_offset))
 		return get_unmapped_area(NULL, addr, len, pgoff, flags);
 
 	ret = get_mmap_entry(private, &entry, pgoff, len);
@@ -3949,7 +4339,10 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 	/* Handle leagacy behavior for memstore */
 
 	if (vma_offset == device->memstore.gpuaddr)
-		return kgsl_mmap_memstore(device, vma);
+		return kgsl_mmap_memstore(device, &device->memstore, vma);
+
+	if (_is_timing_buffer(device, vma_offset))
+		return kgsl_mmap_memstore(device, device->timing_buffer, vma);
 
 	/*
 	 * The reference count on the entry that we get from
@@ -3968,6 +4361,28 @@ static int kgsl_mmap(struct file *file, struct vm_area_struct *vma)
 
 	cache = kgsl_memdesc_get_cachemode(&entry->memdesc);
 
+	/*
+	 * Track CPU writes to cached memory so cache cleans can be skipped
+	 * when the CPU didn't touch it.  The mapping starts out read-only and
+	 * the first write to a page faults and marks the page dirty.  This
+	 * needs the memory to have a single mapping backed by struct pages.
+	 */
+	if ((cache == KGSL_CACHEMODE_WRITEBACK
+		|| cache == KGSL_CACHEMODE_WRITETHROUGH)
+		&& kgsl_memdesc_usermem_type(&entry->memdesc) ==
+			KGSL_MEM_ENTRY_KERNEL
+		&& !(vma->vm_flags & VM_PFNMAP)
+		&& !(entry->memdesc.priv & KGSL_MEMDESC_NO_WRTRACK)) {
+		if (entry->memdesc.useraddr) {
+			entry->memdesc.priv &= ~KGSL_MEMDESC_WRTRACK;
+			entry->memdesc.priv |= KGSL_MEMDESC_NO_WRTRACK;
+		} else {
+			entry->memdesc.priv |= KGSL_MEMDESC_WRTRACK;
+			vma->vm_page_prot =
+				vm_get_page_prot(vma->vm_flags & ~VM_SHARED);
+		}
+	}
+
 	switch (cache) {
 	case KGSL_CACHEMODE_UNCACHED:
 		vma->vm_page_prot = pgprot_noncached(vma->vm_page_prot);
@@ -4242,6 +4657,14 @@ int kgsl_device_platform_probe(struct kgsl_device *device)
 		goto error_close_mmu;
 	}
 
+	/*
+	 * The latency vote is there for the cpu taking the GPU interrupt;
+	 * don't keep the other cores out of deep idle for it.
+	 */
+	device->pwrctrl.pm_qos_req_dma.type = PM_QOS_REQ_AFFINE_CORES;
+	cpumask_copy(&device->pwrctrl.pm_qos_req_dma.cpus_affine,
+		cpumask_of(cpumask_first(irq_get_irq_data(
+			device->pwrctrl.interrupt_num)->affinity)));
 	pm_qos_add_request(&device->pwrctrl.pm_qos_req_dma,
 				PM_QOS_CPU_DMA_LATENCY,
 				PM_QOS_DEFAULT_VALUE);
@@ -4330,11 +4753,16 @@ static void kgsl_core_exit(void)
 
 	kgsl_memfree_hist_exit();
 	unregister_chrdev_region(kgsl_driver.major, KGSL_DEVICE_MAX);
+	kgsl_pool_exit();
 }
 
 static int __init kgsl_core_init(void)
 {
 	int result = 0;
+
+	/* Warm up the page pools before userspace starts allocating */
+	kgsl_pool_init();
+
 	/* alloc major and minor device numbers */
 	result = alloc_chrdev_region(&kgsl_driver.major, 0, KGSL_DEVICE_MAX,
 		"kgsl");
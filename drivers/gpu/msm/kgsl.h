@@ -108,6 +108,8 @@ struct kgsl_driver {
 		unsigned int mapped;
 		unsigned int mapped_max;
 		unsigned int histogram[16];
+		unsigned int cache_ops_skipped;
+		unsigned int cache_ops_performed;
 	} stats;
 	unsigned int full_cache_threshold;
 };
@@ -135,6 +137,10 @@ struct kgsl_memdesc_ops {
 #define KGSL_MEMDESC_FROZEN BIT(2)
 /* The memdesc is mapped into a pagetable */
 #define KGSL_MEMDESC_MAPPED BIT(3)
+/* CPU writes through the user mapping are tracked in the page dirty bits */
+#define KGSL_MEMDESC_WRTRACK BIT(4)
+/* The memdesc had more than one user mapping, writes can't be tracked */
+#define KGSL_MEMDESC_NO_WRTRACK BIT(5)
 
 /* shared memory allocation */
 struct kgsl_memdesc {
@@ -186,6 +192,8 @@ struct kgsl_memdesc {
  * @pending_free: if !0, userspace requested that his memory be freed, but there
  *  are still references to it.
  * @dev_priv: back pointer to the device file that created this entry.
+ * @unmap_node: node in the pagetable's list of entries waiting for a TLB
+ *  flush before they can be freed.
  */
 struct kgsl_mem_entry {
 	struct kref refcount;
@@ -196,6 +204,7 @@ struct kgsl_mem_entry {
 	struct kgsl_process_private *priv;
 	int pending_free;
 	struct kgsl_device_private *dev_priv;
+	struct list_head unmap_node;
 };
 
 long kgsl_ioctl_device_getproperty(struct kgsl_device_private *dev_priv,
@@ -208,6 +217,10 @@ long kgsl_ioctl_rb_issueibcmds(struct kgsl_device_private *dev_priv,
 				      unsigned int cmd, void *data);
 long kgsl_ioctl_submit_commands(struct kgsl_device_private *dev_priv,
 				unsigned int cmd, void *data);
+long kgsl_ioctl_submit_ring_setup(struct kgsl_device_private *dev_priv,
+				unsigned int cmd, void *data);
+long kgsl_ioctl_submit_ring_doorbell(struct kgsl_device_private *dev_priv,
+				unsigned int cmd, void *data);
 long kgsl_ioctl_cmdstream_readtimestamp_ctxtid(struct kgsl_device_private
 					*dev_priv, unsigned int cmd,
 					void *data);
@@ -301,6 +301,10 @@ static const struct kgsl_ioctl kgsl_compat_ioctl_funcs[] = {
 			kgsl_ioctl_rb_issueibcmds_compat, 0),
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_SUBMIT_COMMANDS_COMPAT,
 			kgsl_ioctl_submit_commands_compat, 0),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_SUBMIT_RING_SETUP,
+			kgsl_ioctl_submit_ring_setup, 0),
+	KGSL_IOCTL_FUNC(IOCTL_KGSL_SUBMIT_RING_DOORBELL,
+			kgsl_ioctl_submit_ring_doorbell, 0),
 	/* IOCTL_KGSL_CMDSTREAM_READTIMESTAMP is no longer supported */
 	KGSL_IOCTL_FUNC(IOCTL_KGSL_CMDSTREAM_READTIMESTAMP_CTXTID,
 			kgsl_ioctl_cmdstream_readtimestamp_ctxtid,
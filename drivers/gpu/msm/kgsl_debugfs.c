@@ -97,6 +97,36 @@ static const struct file_operations memfree_hist_fops = {
 	.release = single_release,
 };
 
+static int event_latency_print(struct seq_file *s, void *unused)
+{
+	struct kgsl_device *device = s->private;
+	struct kgsl_event_latency *latency = &device->event_latency;
+	unsigned int count, max_us;
+	u64 total_us;
+
+	spin_lock(&latency->lock);
+	count = latency->count;
+	total_us = latency->total_us;
+	max_us = latency->max_us;
+	spin_unlock(&latency->lock);
+
+	seq_printf(s, "count: %u\navg_us: %llu\nmax_us: %u\n", count,
+		count ? div_u64(total_us, count) : 0, max_us);
+	return 0;
+}
+
+static int event_latency_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, event_latency_print, inode->i_private);
+}
+
+static const struct file_operations event_latency_fops = {
+	.open = event_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 void kgsl_device_debugfs_init(struct kgsl_device *device)
 {
 	if (kgsl_debugfs_dir && !IS_ERR(kgsl_debugfs_dir))
@@ -118,6 +148,17 @@ void kgsl_device_debugfs_init(struct kgsl_device *device)
 				&pwr_log_fops);
 	debugfs_create_file("memfree_history", 0444, device->d_debugfs, device,
 				&memfree_hist_fops);
+	debugfs_create_file("event_latency", 0444, device->d_debugfs, device,
+				&event_latency_fops);
+	debugfs_create_u32("mmu_pt_switches", 0444, device->d_debugfs,
+				&device->mmu.stats.pt_switches);
+	debugfs_create_u32("mmu_pt_switches_skipped", 0444, device->d_debugfs,
+				&device->mmu.stats.pt_switches_skipped);
+	debugfs_create_u32("mmu_tlb_flushes", 0444, device->d_debugfs,
+				&device->mmu.stats.tlb_flushes);
+	debugfs_create_u32("mmu_tlb_flushes_deferred", 0444,
+				device->d_debugfs,
+				&device->mmu.stats.tlb_flushes_deferred);
 }
 
 struct type_entry {
@@ -16,6 +16,7 @@
 #include <linux/slab.h>
 #include <linux/idr.h>
 #include <linux/pm_qos.h>
+#include <linux/ktime.h>
 #include <linux/sched.h>
 #include <linux/workqueue.h>
 
@@ -186,6 +187,7 @@ typedef void (*kgsl_event_func)(struct kgsl_device *, struct kgsl_context *,
  * @created: Jiffies when the event was created
  * @work: Work struct for dispatching the callback
  * @result: KGSL event result type to pass to the callback
+ * @signalled: Time the event was taken off the group list
  */
 struct kgsl_event {
 	struct kgsl_device *device;
@@ -197,13 +199,28 @@ struct kgsl_event {
 	unsigned int created;
 	struct work_struct work;
 	int result;
+	ktime_t signalled;
+};
+
+/**
+ * struct kgsl_event_latency - Retire to callback latency of GPU events
+ * @lock: Spinlock protecting the counters, the callbacks run on every CPU
+ * @count: Number of retired events whose callback has run
+ * @total_us: Total time in microseconds between retire and callback
+ * @max_us: Longest time in microseconds between retire and callback
+ */
+struct kgsl_event_latency {
+	spinlock_t lock;
+	unsigned int count;
+	u64 total_us;
+	unsigned int max_us;
 };
 
 /**
  * struct event_group - A list of GPU events
  * @context: Pointer to the active context for the events
  * @lock: Spinlock for protecting the list
- * @events: List of active GPU events
+ * @events: List of active GPU events, sorted by timestamp
  * @group: Node for the master group list
  * @processed: Last processed timestamp
  */
@@ -231,6 +248,7 @@ struct kgsl_event_group {
  * @refcount: kref structure to maintain the reference count
  * @synclist: List of context/timestamp tuples to wait for before issuing
  * @timer: a timer used to track possible sync timeouts for this cmdbatch
+ * @queued: Time the cmdbatch was put on the context queue
  *
  * This struture defines an atomic batch of command buffers issued from
  * userspace.
@@ -250,6 +268,7 @@ struct kgsl_cmdbatch {
 	struct kref refcount;
 	struct list_head synclist;
 	struct timer_list timer;
+	ktime_t queued;
 };
 
 /**
@@ -357,6 +376,9 @@ struct kgsl_device {
 
 	struct kgsl_event_group global_events;
 	struct kgsl_event_group iommu_events;
+	struct kgsl_event_latency event_latency;
+	/* Read only buffer of per submission GPU timing, if the core has one */
+	struct kgsl_memdesc *timing_buffer;
 };
 
 
@@ -367,6 +389,8 @@ struct kgsl_device {
 			kgsl_idle_check),\
 	.event_work  = __WORK_INITIALIZER((_dev).event_work,\
 			kgsl_process_events),\
+	.event_latency.lock = \
+		__SPIN_LOCK_UNLOCKED((_dev).event_latency.lock),\
 	.snapshot_obj_ws = \
 		__WORK_INITIALIZER((_dev).snapshot_obj_ws,\
 		kgsl_snapshot_save_frozen_objs),\
@@ -426,6 +450,8 @@ struct kgsl_context {
 	struct kgsl_pwr_constraint pwr_constraint;
 	unsigned int fault_count;
 	unsigned long fault_time;
+	struct mutex submit_ring_lock;
+	struct kgsl_submit_ring *submit_ring;
 };
 
 /**
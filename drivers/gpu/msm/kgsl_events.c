@@ -14,6 +14,7 @@
 #include <linux/slab.h>
 #include <linux/list.h>
 #include <linux/workqueue.h>
+#include <linux/ktime.h>
 #include <kgsl_device.h>
 
 #include "kgsl_trace.h"
@@ -29,6 +30,7 @@ static inline void signal_event(struct kgsl_device *device,
 {
 	list_del(&event->node);
 	event->result = result;
+	event->signalled = ktime_get();
 	queue_work(device->events_wq, &event->work);
 }
 
@@ -42,8 +44,20 @@ static inline void signal_event(struct kgsl_device *device,
 static void _kgsl_event_worker(struct work_struct *work)
 {
 	struct kgsl_event *event = container_of(work, struct kgsl_event, work);
+	struct kgsl_event_latency *latency = &event->device->event_latency;
 	int id = KGSL_CONTEXT_ID(event->context);
 
+	if (event->result == KGSL_EVENT_RETIRED) {
+		unsigned int us = ktime_us_delta(ktime_get(), event->signalled);
+
+		spin_lock(&latency->lock);
+		latency->count++;
+		latency->total_us += us;
+		if (us > latency->max_us)
+			latency->max_us = us;
+		spin_unlock(&latency->lock);
+	}
+
 	trace_kgsl_fire_event(id, event->timestamp, event->result,
 		jiffies - event->created, event->func);
 
@@ -78,9 +92,14 @@ static void retire_events(struct kgsl_device *device,
 	if (timestamp_cmp(timestamp, group->processed) <= 0)
 		goto out;
 
+	/*
+	 * The list is sorted by timestamp so stop at the first event that
+	 * hasn't expired yet
+	 */
 	list_for_each_entry_safe(event, tmp, &group->events, node) {
-		if (timestamp_cmp(event->timestamp, timestamp) <= 0)
-			signal_event(device, event, KGSL_EVENT_RETIRED);
+		if (timestamp_cmp(event->timestamp, timestamp) > 0)
+			break;
+		signal_event(device, event, KGSL_EVENT_RETIRED);
 	}
 
 	group->processed = timestamp;
@@ -170,7 +189,7 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 {
 	unsigned int queued, retired;
 	struct kgsl_context *context = group->context;
-	struct kgsl_event *event;
+	struct kgsl_event *event, *prev;
 
 	if (!func)
 		return -EINVAL;
@@ -215,13 +234,22 @@ int kgsl_add_event(struct kgsl_device *device, struct kgsl_event_group *group,
 
 	if (timestamp_cmp(retired, timestamp) >= 0) {
 		event->result = KGSL_EVENT_RETIRED;
+		event->signalled = ktime_get();
 		queue_work(device->events_wq, &event->work);
 		spin_unlock(&group->lock);
 		return 0;
 	}
 
-	/* Add the event to the group list */
-	list_add_tail(&event->node, &group->events);
+	/*
+	 * Add the event to the group list in timestamp order.  Timestamps are
+	 * mostly registered in increasing order so search from the tail, and
+	 * put the event after any others for the same timestamp.
+	 */
+	list_for_each_entry_reverse(prev, &group->events, node) {
+		if (timestamp_cmp(prev->timestamp, timestamp) <= 0)
+			break;
+	}
+	list_add(&event->node, &prev->node);
 
 	spin_unlock(&group->lock);
 
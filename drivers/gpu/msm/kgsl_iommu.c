@@ -1260,12 +1260,16 @@ static int kgsl_iommu_setstate(struct kgsl_mmu *mmu,
 		 */
 		if (mmu->hwpagetable != pagetable) {
 			unsigned int flags = 0;
+			mmu->stats.pt_switches++;
 			mmu->hwpagetable = pagetable;
 			flags |= kgsl_mmu_pt_get_flags(mmu->hwpagetable,
 							mmu->device->id) |
 							KGSL_MMUFLAGS_TLBFLUSH;
 			ret = kgsl_setstate(mmu, context_id,
 				KGSL_MMUFLAGS_PTUPDATE | flags);
+		} else {
+			/* The incoming context shares the current pagetable */
+			mmu->stats.pt_switches_skipped++;
 		}
 	}
 
@@ -1720,8 +1724,10 @@ static void kgsl_iommu_flush_tlb_pt_current(struct kgsl_pagetable *pt)
 	if (kgsl_mmu_is_perprocess(pt->mmu) &&
 		iommu->iommu_units[0].dev[KGSL_IOMMU_CONTEXT_USER].attached &&
 		kgsl_iommu_pt_equal(pt->mmu, pt,
-		kgsl_iommu_get_current_ptbase(pt->mmu)))
+		kgsl_iommu_get_current_ptbase(pt->mmu))) {
 		kgsl_iommu_default_setstate(pt->mmu, KGSL_MMUFLAGS_TLBFLUSH);
+		pt->mmu->stats.tlb_flushes++;
+	}
 
 	if (lock_taken)
 		kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
@@ -1756,7 +1762,9 @@ kgsl_iommu_unmap(struct kgsl_pagetable *pt,
 		return ret;
 	}
 
-	kgsl_iommu_flush_tlb_pt_current(pt);
+	/* Inside an unmap batch the flush is done once at the end */
+	if (!kgsl_mmu_defer_tlb_flush(pt))
+		kgsl_iommu_flush_tlb_pt_current(pt);
 
 	return ret;
 }
@@ -2182,4 +2190,5 @@ struct kgsl_mmu_pt_ops iommu_pt_ops = {
 	.mmu_unmap = kgsl_iommu_unmap,
 	.mmu_create_pagetable = kgsl_iommu_create_pagetable,
 	.mmu_destroy_pagetable = kgsl_iommu_destroy_pagetable,
+	.mmu_flush_tlb = kgsl_iommu_flush_tlb_pt_current,
 };
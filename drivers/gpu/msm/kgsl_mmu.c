@@ -426,6 +426,7 @@ kgsl_mmu_createpagetableobject(struct kgsl_mmu *mmu,
 	kref_init(&pagetable->refcount);
 
 	spin_lock_init(&pagetable->lock);
+	INIT_LIST_HEAD(&pagetable->unmap_deferred);
 
 	ptsize = kgsl_mmu_get_ptsize(mmu);
 	pagetable->mmu = mmu;
@@ -820,6 +821,97 @@ int kgsl_mmu_close(struct kgsl_device *device)
 }
 EXPORT_SYMBOL(kgsl_mmu_close);
 
+/**
+ * kgsl_mmu_unmap_batch_begin() - Start batching unmaps from a pagetable
+ * @pagetable: The pagetable, may be NULL
+ *
+ * Until the matching kgsl_mmu_unmap_batch_end() unmaps from @pagetable only
+ * mark its TLB stale, and the outermost batch_end flushes it once for all
+ * of them.  Batches nest and may be opened from several threads.  Holds a
+ * reference to @pagetable until the batch is closed.
+ */
+void kgsl_mmu_unmap_batch_begin(struct kgsl_pagetable *pagetable)
+{
+	if (pagetable == NULL)
+		return;
+
+	kref_get(&pagetable->refcount);
+
+	spin_lock(&pagetable->lock);
+	pagetable->unmap_batch++;
+	spin_unlock(&pagetable->lock);
+}
+EXPORT_SYMBOL(kgsl_mmu_unmap_batch_begin);
+
+/**
+ * kgsl_mmu_unmap_batch_end() - Close a batch of unmaps
+ * @pagetable: The pagetable passed to kgsl_mmu_unmap_batch_begin()
+ * @node: List node of memory unmapped in this batch, or NULL
+ * @release: List that receives the memory that can be freed
+ *
+ * The memory that was unmapped may still be reachable through the GPU TLB,
+ * so it can't be freed until the TLB is flushed.  @node is queued on the
+ * pagetable.  When this closes the outermost batch the TLB is flushed and
+ * everything queued during the batch is moved to @release for the caller
+ * to free, otherwise @release is left empty and the memory is handed to
+ * whoever closes the outermost batch.
+ */
+void kgsl_mmu_unmap_batch_end(struct kgsl_pagetable *pagetable,
+		struct list_head *node, struct list_head *release)
+{
+	bool flush;
+
+	if (pagetable == NULL) {
+		if (node)
+			list_add_tail(node, release);
+		return;
+	}
+
+	spin_lock(&pagetable->lock);
+	if (node)
+		list_add_tail(node, &pagetable->unmap_deferred);
+
+	if (--pagetable->unmap_batch) {
+		spin_unlock(&pagetable->lock);
+		goto done;
+	}
+
+	list_splice_tail_init(&pagetable->unmap_deferred, release);
+	flush = pagetable->tlb_stale;
+	pagetable->tlb_stale = false;
+	spin_unlock(&pagetable->lock);
+
+	if (flush && pagetable->pt_ops && pagetable->pt_ops->mmu_flush_tlb)
+		pagetable->pt_ops->mmu_flush_tlb(pagetable);
+done:
+	kgsl_put_pagetable(pagetable);
+}
+EXPORT_SYMBOL(kgsl_mmu_unmap_batch_end);
+
+/**
+ * kgsl_mmu_defer_tlb_flush() - Check if an unmap can leave the TLB stale
+ * @pagetable: The pagetable that was unmapped from
+ *
+ * Returns true if a batch is open on @pagetable, in which case the TLB is
+ * marked stale and flushed when the batch is closed.
+ */
+bool kgsl_mmu_defer_tlb_flush(struct kgsl_pagetable *pagetable)
+{
+	bool defer;
+
+	spin_lock(&pagetable->lock);
+	defer = pagetable->unmap_batch != 0;
+	if (defer)
+		pagetable->tlb_stale = true;
+	spin_unlock(&pagetable->lock);
+
+	if (defer)
+		pagetable->mmu->stats.tlb_flushes_deferred++;
+
+	return defer;
+}
+EXPORT_SYMBOL(kgsl_mmu_defer_tlb_flush);
+
 int kgsl_mmu_pt_get_flags(struct kgsl_pagetable *pt,
 			enum kgsl_deviceid id)
 {
@@ -63,6 +63,12 @@ struct kgsl_pagetable {
 	} stats;
 	const struct kgsl_mmu_pt_ops *pt_ops;
 	unsigned int tlb_flags;
+	/* Nesting count of open unmap batches, see kgsl_mmu_unmap_batch_* */
+	unsigned int unmap_batch;
+	/* Set if an unmap in the current batch still needs a TLB flush */
+	bool tlb_stale;
+	/* Memory unmapped in the current batch, freed after the flush */
+	struct list_head unmap_deferred;
 	unsigned int fault_addr;
 	void *priv;
 	struct kgsl_mmu *mmu;
@@ -127,6 +133,7 @@ struct kgsl_mmu_pt_ops {
 			unsigned int *tlb_flags);
 	void *(*mmu_create_pagetable) (void);
 	void (*mmu_destroy_pagetable) (struct kgsl_pagetable *);
+	void (*mmu_flush_tlb) (struct kgsl_pagetable *pt);
 };
 
 #define KGSL_MMU_FLAGS_IOMMU_SYNC BIT(31)
@@ -147,6 +154,13 @@ struct kgsl_mmu {
 	unsigned long pt_size;
 	bool pt_per_process;
 	bool use_cpu_map;
+
+	struct {
+		unsigned int pt_switches;
+		unsigned int pt_switches_skipped;
+		unsigned int tlb_flushes;
+		unsigned int tlb_flushes_deferred;
+	} stats;
 };
 
 extern struct kgsl_mmu_ops iommu_ops;
@@ -168,6 +182,10 @@ int kgsl_mmu_unmap(struct kgsl_pagetable *pagetable,
 		    struct kgsl_memdesc *memdesc);
 int kgsl_mmu_put_gpuaddr(struct kgsl_pagetable *pagetable,
 		 struct kgsl_memdesc *memdesc);
+void kgsl_mmu_unmap_batch_begin(struct kgsl_pagetable *pagetable);
+void kgsl_mmu_unmap_batch_end(struct kgsl_pagetable *pagetable,
+		struct list_head *node, struct list_head *release);
+bool kgsl_mmu_defer_tlb_flush(struct kgsl_pagetable *pagetable);
 unsigned int kgsl_virtaddr_to_physaddr(void *virtaddr);
 int kgsl_setstate(struct kgsl_mmu *mmu, unsigned int context_id,
 			uint32_t flags);
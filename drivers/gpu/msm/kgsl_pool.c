@@ -0,0 +1,304 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#include <linux/highmem.h>
+#include <linux/list.h>
+#include <linux/math64.h>
+#include <linux/shrinker.h>
+#include <linux/spinlock.h>
+#include <asm/cacheflush.h>
+
+#include "kgsl_pool.h"
+#include "kgsl_log.h"
+
+/*
+ * Pages freed by kgsl are kept here instead of going back to the buddy
+ * allocator.  Every page in a pool has already been zeroed and cleaned
+ * out of the CPU caches, so an allocation served from a pool skips both
+ * the page allocator and the memset + dcache flush that a fresh page
+ * needs before it can be handed to the GPU or to userspace.
+ *
+ * kgsl cleans the caches of every allocation whatever cache mode it is
+ * later mapped with, so the same pages serve cached and uncached buffers.
+ */
+struct kgsl_page_pool {
+	unsigned int order;
+	/* Number of chunks put in the pool at boot */
+	unsigned int reserve;
+	/* Freed chunks beyond this go back to the page allocator */
+	unsigned int max_count;
+	unsigned int count;
+	unsigned int hits;
+	unsigned int misses;
+	spinlock_t lock;
+	struct list_head page_list;
+};
+
+#define KGSL_POOL(_idx, _order, _reserve, _max) [_idx] = {		\
+	.order = _order,						\
+	.reserve = _reserve,						\
+	.max_count = _max,						\
+	.lock = __SPIN_LOCK_UNLOCKED(kgsl_pools[_idx].lock),		\
+	.page_list = LIST_HEAD_INIT(kgsl_pools[_idx].page_list),	\
+}
+
+/* Each pool is capped at 4MB and starts with 1MB */
+static struct kgsl_page_pool kgsl_pools[] = {
+	KGSL_POOL(0, 0, 256, 1024),
+	KGSL_POOL(1, KGSL_POOL_LARGE_ORDER, 16, 64),
+};
+
+static struct kgsl_page_pool *kgsl_pool_find(unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		if (kgsl_pools[i].order == order)
+			return &kgsl_pools[i];
+
+	return NULL;
+}
+
+static void kgsl_pool_zero_page(struct page *page, unsigned int order)
+{
+	int i;
+
+	for (i = 0; i < (1 << order); i++) {
+		void *addr = kmap_atomic(nth_page(page, i));
+
+		memset(addr, 0, PAGE_SIZE);
+		dmac_flush_range(addr, addr + PAGE_SIZE);
+		kunmap_atomic(addr);
+
+		/* Forget any CPU writes tracked for the previous owner */
+		ClearPageDirty(nth_page(page, i));
+	}
+}
+
+/* Takes a chunk off @pool, must be called with pool->lock held */
+static struct page *__kgsl_pool_get(struct kgsl_page_pool *pool)
+{
+	struct page *page;
+
+	if (pool->count == 0)
+		return NULL;
+
+	page = list_first_entry(&pool->page_list, struct page, lru);
+	list_del(&page->lru);
+	pool->count--;
+
+	return page;
+}
+
+/* Adds a zeroed chunk to @pool, returns false if the pool is full */
+static bool kgsl_pool_put(struct kgsl_page_pool *pool, struct page *page)
+{
+	bool added = false;
+
+	spin_lock(&pool->lock);
+	if (pool->count < pool->max_count) {
+		list_add(&page->lru, &pool->page_list);
+		pool->count++;
+		added = true;
+	}
+	spin_unlock(&pool->lock);
+
+	return added;
+}
+
+/**
+ * kgsl_pool_alloc_page() - Take a zeroed chunk out of the page pools
+ * @order: Order of the chunk
+ *
+ * Returns a chunk whose contents are zero and not present in the CPU
+ * caches, or NULL if the pool of that order is empty and the caller has
+ * to go to the page allocator.
+ */
+struct page *kgsl_pool_alloc_page(unsigned int order)
+{
+	struct kgsl_page_pool *pool = kgsl_pool_find(order);
+	struct page *page;
+
+	if (pool == NULL)
+		return NULL;
+
+	spin_lock(&pool->lock);
+	page = __kgsl_pool_get(pool);
+	if (page)
+		pool->hits++;
+	else
+		pool->misses++;
+	spin_unlock(&pool->lock);
+
+	return page;
+}
+
+/**
+ * kgsl_pool_free_page() - Return a chunk to the page pools
+ * @page: First page of the chunk
+ * @order: Order of the chunk
+ *
+ * The chunk is zeroed and kept if its pool has room, otherwise it goes
+ * straight back to the page allocator.
+ */
+void kgsl_pool_free_page(struct page *page, unsigned int order)
+{
+	struct kgsl_page_pool *pool = kgsl_pool_find(order);
+
+	/* Don't bother zeroing a chunk the pool is going to refuse */
+	if (pool && ACCESS_ONCE(pool->count) < pool->max_count) {
+		kgsl_pool_zero_page(page, order);
+		if (kgsl_pool_put(pool, page))
+			return;
+	}
+
+	__free_pages(page, order);
+}
+
+/* Returns the number of pages held in all pools */
+static unsigned int kgsl_pool_pages(void)
+{
+	unsigned int total = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		total += ACCESS_ONCE(kgsl_pools[i].count) <<
+			kgsl_pools[i].order;
+
+	return total;
+}
+
+/* Returns the number of bytes held in all pools */
+unsigned int kgsl_pool_size(void)
+{
+	return kgsl_pool_pages() << PAGE_SHIFT;
+}
+
+unsigned int kgsl_pool_hits(void)
+{
+	unsigned int hits = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		hits += ACCESS_ONCE(kgsl_pools[i].hits);
+
+	return hits;
+}
+
+unsigned int kgsl_pool_misses(void)
+{
+	unsigned int misses = 0;
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		misses += ACCESS_ONCE(kgsl_pools[i].misses);
+
+	return misses;
+}
+
+/* Returns the percentage of chunk allocations served from the pools */
+unsigned int kgsl_pool_hit_rate(void)
+{
+	u64 hits = kgsl_pool_hits();
+	u64 total = hits + kgsl_pool_misses();
+
+	if (total == 0)
+		return 0;
+
+	return div64_u64(hits * 100, total);
+}
+
+/*
+ * Frees up to @nr_pages pages back to the page allocator, largest chunks
+ * first since those are the hardest for the system to come by.
+ */
+static void kgsl_pool_drain(unsigned long nr_pages)
+{
+	int i;
+
+	for (i = ARRAY_SIZE(kgsl_pools) - 1; i >= 0 && nr_pages; i--) {
+		struct kgsl_page_pool *pool = &kgsl_pools[i];
+
+		while (nr_pages) {
+			struct page *page;
+
+			spin_lock(&pool->lock);
+			page = __kgsl_pool_get(pool);
+			spin_unlock(&pool->lock);
+			if (page == NULL)
+				break;
+
+			__free_pages(page, pool->order);
+			nr_pages -= min_t(unsigned long, nr_pages,
+					  1 << pool->order);
+		}
+	}
+}
+
+static int kgsl_pool_shrink(struct shrinker *shrinker,
+			    struct shrink_control *sc)
+{
+	if (sc->nr_to_scan)
+		kgsl_pool_drain(sc->nr_to_scan);
+
+	return kgsl_pool_pages();
+}
+
+static struct shrinker kgsl_pool_shrinker = {
+	.shrink = kgsl_pool_shrink,
+	.seeks = DEFAULT_SEEKS,
+	.batch = 0,
+};
+
+/* Fills the pools while memory is still unfragmented */
+static void kgsl_pool_reserve(struct kgsl_page_pool *pool)
+{
+	gfp_t gfp_mask = GFP_KERNEL | __GFP_HIGHMEM;
+	int i;
+
+	if (pool->order)
+		gfp_mask |= __GFP_COMP | __GFP_NORETRY | __GFP_NO_KSWAPD |
+			__GFP_NOWARN;
+
+	for (i = 0; i < pool->reserve; i++) {
+		struct page *page = alloc_pages(gfp_mask, pool->order);
+
+		if (page == NULL) {
+			KGSL_CORE_ERR("order %u pool: reserved only %d of %u\n",
+				pool->order, i, pool->reserve);
+			break;
+		}
+
+		kgsl_pool_zero_page(page, pool->order);
+		if (!kgsl_pool_put(pool, page)) {
+			__free_pages(page, pool->order);
+			break;
+		}
+	}
+}
+
+void kgsl_pool_init(void)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(kgsl_pools); i++)
+		kgsl_pool_reserve(&kgsl_pools[i]);
+
+	register_shrinker(&kgsl_pool_shrinker);
+}
+
+void kgsl_pool_exit(void)
+{
+	unregister_shrinker(&kgsl_pool_shrinker);
+	kgsl_pool_drain(ULONG_MAX);
+}
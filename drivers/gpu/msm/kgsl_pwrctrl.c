@@ -19,6 +19,8 @@
 #include <linux/msm-bus-board.h>
 #include <linux/ktime.h>
 #include <linux/delay.h>
+#include <linux/cpu_boost.h>
+#include <linux/msm_thermal.h>
 
 #include "kgsl.h"
 #include "kgsl_pwrscale.h"
@@ -109,9 +111,12 @@ static void update_clk_statistics(struct kgsl_device *device,
 
 static inline unsigned int _adjust_pwrlevel(struct kgsl_pwrctrl *pwr, int level)
 {
-	unsigned int max_pwrlevel = max_t(unsigned int, pwr->thermal_pwrlevel,
+	unsigned int thermal_pwrlevel = max(pwr->thermal_pwrlevel,
+		pwr->thermal_cap_pwrlevel);
+	unsigned int max_pwrlevel = max_t(unsigned int, thermal_pwrlevel,
 		pwr->max_pwrlevel);
-	unsigned int min_pwrlevel = max_t(unsigned int, pwr->thermal_pwrlevel,
+	unsigned int min_pwrlevel = max_t(unsigned int, thermal_pwrlevel,
+		pwr->frame_boost ? min(pwr->min_pwrlevel, pwr->default_pwrlevel) :
 		pwr->min_pwrlevel);
 
 	if (level < max_pwrlevel)
@@ -138,8 +143,11 @@ void kgsl_pwrctrl_buslevel_update(struct kgsl_device *device,
 	 * otherwise request bus level 0, off.
 	 */
 	if (on) {
-		buslevel = min_t(int, pwr->pwrlevels[0].bus_freq,
-				cur + pwr->bus_mod);
+		if (pwr->bus_auto && pwr->bus_auto_level)
+			cur = pwr->bus_auto_level;
+		else
+			cur += pwr->bus_mod;
+		buslevel = min_t(int, pwr->pwrlevels[0].bus_freq, cur);
 		buslevel = max_t(int, buslevel, 1);
 	}
 	msm_bus_scale_client_update_request(pwr->pcl, buslevel);
@@ -787,6 +795,64 @@ static DEVICE_ATTR(reset_count, 0444,
 static DEVICE_ATTR(force_clk_on, 0644,
 	kgsl_pwrctrl_force_clk_on_show,
 	kgsl_pwrctrl_force_clk_on_store);
+static ssize_t kgsl_pwrctrl_bus_auto_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	if (device == NULL)
+		return 0;
+	return snprintf(buf, PAGE_SIZE, "%u\n", device->pwrctrl.bus_auto);
+}
+
+static ssize_t kgsl_pwrctrl_bus_auto_store(struct device *dev,
+					struct device_attribute *attr,
+					const char *buf, size_t count)
+{
+	unsigned int val = 0;
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	int ret;
+
+	if (device == NULL)
+		return 0;
+
+	ret = kgsl_sysfs_store(buf, &val);
+	if (ret)
+		return ret;
+
+	kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
+	device->pwrctrl.bus_auto = min_t(unsigned int, val, 100);
+	device->pwrctrl.bus_auto_level = 0;
+	kgsl_pwrctrl_buslevel_update(device, true);
+	kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
+
+	return count;
+}
+
+static ssize_t kgsl_pwrctrl_wake_stats_show(struct device *dev,
+					struct device_attribute *attr,
+					char *buf)
+{
+	struct kgsl_device *device = kgsl_device_from_dev(dev);
+	struct kgsl_pwrctrl *pwr;
+	ssize_t ret;
+
+	if (device == NULL)
+		return 0;
+	pwr = &device->pwrctrl;
+
+	kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
+	ret = snprintf(buf, PAGE_SIZE,
+		"prewake: %u\nprewake_expired: %u\n"
+		"stall: %u\nstall_us: %llu\nstall_max_us: %u\n",
+		pwr->prewake_count, pwr->prewake_expired,
+		pwr->wake_stall_count, pwr->wake_stall_us,
+		pwr->wake_stall_max_us);
+	kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
+
+	return ret;
+}
+
 static DEVICE_ATTR(force_bus_on, 0644,
 	kgsl_pwrctrl_force_bus_on_show,
 	kgsl_pwrctrl_force_bus_on_store);
@@ -796,6 +862,12 @@ static DEVICE_ATTR(force_rail_on, 0644,
 DEVICE_ATTR(bus_split, 0644,
 	kgsl_pwrctrl_bus_split_show,
 	kgsl_pwrctrl_bus_split_store);
+static DEVICE_ATTR(bus_auto, 0644,
+	kgsl_pwrctrl_bus_auto_show,
+	kgsl_pwrctrl_bus_auto_store);
+static DEVICE_ATTR(wake_stats, 0444,
+	kgsl_pwrctrl_wake_stats_show,
+	NULL);
 
 static const struct device_attribute *pwrctrl_attr_list[] = {
 	&dev_attr_gpuclk,
@@ -814,6 +886,8 @@ static const struct device_attribute *pwrctrl_attr_list[] = {
 	&dev_attr_force_bus_on,
 	&dev_attr_force_rail_on,
 	&dev_attr_bus_split,
+	&dev_attr_bus_auto,
+	&dev_attr_wake_stats,
 	NULL
 };
 
@@ -1010,6 +1084,52 @@ void kgsl_pwrctrl_irq(struct kgsl_device *device, int state)
 }
 EXPORT_SYMBOL(kgsl_pwrctrl_irq);
 
+/*
+ * While the display is missing frames, hold the GPU at or above its
+ * default power level, within the thermal limit.
+ */
+static int kgsl_pwrctrl_frame_boost(struct notifier_block *nb,
+				unsigned long event, void *data)
+{
+	struct kgsl_pwrctrl *pwr = container_of(nb, struct kgsl_pwrctrl,
+						frame_boost_nb);
+	struct kgsl_device *device = container_of(pwr, struct kgsl_device,
+						pwrctrl);
+
+	if (event == FRAME_HINT_VSYNC)
+		return NOTIFY_DONE;
+
+	kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
+	pwr->frame_boost = (event == FRAME_BOOST_START);
+	if (pwr->frame_boost)
+		kgsl_pwrctrl_pwrlevel_change(device, pwr->active_pwrlevel);
+	kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
+
+	return NOTIFY_OK;
+}
+
+/*
+ * msm_thermal's mitigation chain asks for the GPU to be held a number of
+ * power levels below the top, and is told how many could be applied.
+ */
+static int kgsl_pwrctrl_thermal_cap(struct notifier_block *nb,
+				unsigned long event, void *data)
+{
+	struct msm_thermal_gpu_cap *cap = data;
+	struct kgsl_pwrctrl *pwr = container_of(nb, struct kgsl_pwrctrl,
+						thermal_cap_nb);
+	struct kgsl_device *device = container_of(pwr, struct kgsl_device,
+						pwrctrl);
+
+	kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
+	pwr->thermal_cap_pwrlevel = min(cap->levels, pwr->num_pwrlevels - 2);
+	cap->applied = pwr->thermal_cap_pwrlevel;
+	kgsl_pwrctrl_pwrlevel_change(device, pwr->active_pwrlevel);
+	kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
+
+	return NOTIFY_OK;
+}
+
 int kgsl_pwrctrl_init(struct kgsl_device *device)
 {
 	int i, k, m, n = 0, result = 0;
@@ -1104,6 +1224,7 @@ int kgsl_pwrctrl_init(struct kgsl_device *device)
 
 	/* Set if independent bus BW voting is supported */
 	pwr->bus_control = pdata->bus_control;
+	pwr->bus_table = pdata->bus_scale_table;
 
 	/*
 	 * Set the range permitted for BIMC votes per-GPU frequency.
@@ -1154,6 +1275,11 @@ int kgsl_pwrctrl_init(struct kgsl_device *device)
 	}
 	pwr->pwrlevels[freq_i].bus_max = i - 1;
 
+	pwr->frame_boost_nb.notifier_call = kgsl_pwrctrl_frame_boost;
+	frame_boost_register_notifier(&pwr->frame_boost_nb);
+	pwr->thermal_cap_nb.notifier_call = kgsl_pwrctrl_thermal_cap;
+	msm_thermal_gpu_cap_register_notifier(&pwr->thermal_cap_nb);
+
 	return result;
 
 clk_err:
@@ -1172,6 +1298,9 @@ void kgsl_pwrctrl_close(struct kgsl_device *device)
 
 	KGSL_PWR_INFO(device, "close device %d\n", device->id);
 
+	frame_boost_unregister_notifier(&pwr->frame_boost_nb);
+	msm_thermal_gpu_cap_unregister_notifier(&pwr->thermal_cap_nb);
+
 	pm_runtime_disable(device->parentdev);
 
 	if (pwr->pcl)
@@ -1379,6 +1508,8 @@ _slumber(struct kgsl_device *device)
 		device->ftbl->suspend_context(device);
 		device->ftbl->stop(device);
 		_sleep_accounting(device);
+		if (device->flags & KGSL_FLAG_WAKE_ON_TOUCH)
+			device->pwrctrl.prewake_expired++;
 		kgsl_pwrctrl_set_state(device, KGSL_STATE_SLUMBER);
 		pm_qos_update_request(&device->pwrctrl.pm_qos_req_dma,
 						PM_QOS_DEFAULT_VALUE);
@@ -1596,16 +1727,26 @@ EXPORT_SYMBOL(kgsl_pwrstate_to_str);
  */
 int kgsl_active_count_get(struct kgsl_device *device)
 {
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
 	int ret = 0;
 	BUG_ON(!mutex_is_locked(&device->mutex));
 
 	if ((atomic_read(&device->active_cnt) == 0) &&
 		(device->state != KGSL_STATE_ACTIVE)) {
+		ktime_t start = ktime_get();
+		unsigned int us;
+
 		kgsl_mutex_unlock(&device->mutex, &device->mutex_owner);
 		wait_for_completion(&device->hwaccess_gate);
 		kgsl_mutex_lock(&device->mutex, &device->mutex_owner);
 
 		ret = kgsl_pwrctrl_wake(device, 1);
+
+		us = ktime_us_delta(ktime_get(), start);
+		pwr->wake_stall_count++;
+		pwr->wake_stall_us += us;
+		if (us > pwr->wake_stall_max_us)
+			pwr->wake_stall_max_us = us;
 	}
 	if (ret == 0)
 		atomic_inc(&device->active_cnt);
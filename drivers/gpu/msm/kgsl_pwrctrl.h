@@ -80,7 +80,22 @@ struct kgsl_pwr_constraint {
  * @bus_mod - modifier from the current power level for the bus vote
  * @bus_index - default bus index into the bus_ib table
  * @bus_ib - the set of unique ib requests needed for the bus calculation
+ * @bus_table - the bus scale table the bus levels index into
+ * @bus_auto - target IB utilization in percent for the measured bus vote,
+ * 0 to follow the per-pwrlevel bus table
+ * @bus_auto_level - bus level picked from the measured GPU bandwidth
  * @constraint - currently active power constraint
+ * @frame_boost - true while cpu-boost holds a frame boost
+ * @frame_boost_nb - notifier for cpu-boost frame boost events
+ * @thermal_cap_pwrlevel - maximum powerlevel constraint from msm_thermal
+ * @thermal_cap_nb - notifier for msm_thermal GPU cap requests
+ * @prewake_count - number of times the GPU was woken from slumber ahead of
+ * work on a touch or vsync hint
+ * @prewake_expired - number of those wakes that went back to slumber before
+ * any command batch arrived
+ * @wake_stall_count - number of times a caller had to wait for the GPU to wake
+ * @wake_stall_us - total time in microseconds spent in those waits
+ * @wake_stall_max_us - longest of those waits in microseconds
  */
 
 struct kgsl_pwrctrl {
@@ -110,7 +125,19 @@ struct kgsl_pwrctrl {
 	int bus_mod;
 	unsigned int bus_index[KGSL_MAX_PWRLEVELS];
 	uint64_t bus_ib[KGSL_MAX_PWRLEVELS];
+	struct msm_bus_scale_pdata *bus_table;
+	unsigned int bus_auto;
+	unsigned int bus_auto_level;
 	struct kgsl_pwr_constraint constraint;
+	bool frame_boost;
+	struct notifier_block frame_boost_nb;
+	unsigned int thermal_cap_pwrlevel;
+	struct notifier_block thermal_cap_nb;
+	unsigned int prewake_count;
+	unsigned int prewake_expired;
+	unsigned int wake_stall_count;
+	u64 wake_stall_us;
+	unsigned int wake_stall_max_us;
 };
 
 void kgsl_pwrctrl_irq(struct kgsl_device *device, int state);
@@ -13,6 +13,8 @@
 
 #include <linux/export.h>
 #include <linux/kernel.h>
+#include <linux/math64.h>
+#include <linux/msm-bus.h>
 
 #include "kgsl.h"
 #include "kgsl_pwrscale.h"
@@ -272,6 +274,48 @@ int kgsl_devfreq_target(struct device *dev, unsigned long *freq, u32 flags)
 }
 EXPORT_SYMBOL(kgsl_devfreq_target);
 
+/* A3xx VBIF AXI ports are 64 bits wide */
+#define KGSL_AXI_BEAT_BYTES	8
+
+/*
+ * kgsl_pwrscale_bus_auto - vote the bus from measured GPU bandwidth
+ * @device: The device
+ * @total_time: length of the sample in microseconds
+ * @beats: VBIF AXI beats counted during the sample
+ *
+ * Pick the lowest bus level whose IB covers the measured traffic at the
+ * bus_auto utilization target, independently of the GPU power level.  The
+ * vote goes up at once and comes down one level per sample.  This function
+ * expects the device mutex to be locked.
+ */
+static void kgsl_pwrscale_bus_auto(struct kgsl_device *device,
+				s64 total_time, u64 beats)
+{
+	struct kgsl_pwrctrl *pwr = &device->pwrctrl;
+	struct msm_bus_scale_pdata *table = pwr->bus_table;
+	unsigned int level, max = pwr->pwrlevels[0].bus_freq;
+	u64 need;
+
+	if (!pwr->bus_auto || !pwr->bus_control || !table || total_time <= 0)
+		return;
+
+	/* bytes/s at the target utilization */
+	need = beats * KGSL_AXI_BEAT_BYTES * USEC_PER_SEC * 100;
+	need = div64_u64(need, (u64)total_time * pwr->bus_auto);
+
+	for (level = 1; level < max; level++)
+		if (table->usecase[level].vectors[0].ib >= need)
+			break;
+
+	if (pwr->bus_auto_level && level < pwr->bus_auto_level)
+		level = pwr->bus_auto_level - 1;
+
+	if (level != pwr->bus_auto_level) {
+		pwr->bus_auto_level = level;
+		kgsl_pwrctrl_buslevel_update(device, true);
+	}
+}
+
 /*
  * kgsl_devfreq_get_dev_status - devfreq_dev_profile.get_dev_status callback
  * @dev: see devfreq.h
@@ -317,6 +361,9 @@ int kgsl_devfreq_get_dev_status(struct device *dev,
 		b->mod = device->pwrctrl.bus_mod;
 	}
 
+	kgsl_pwrscale_bus_auto(device, stat->total_time,
+				pwrscale->accum_stats.ram_time);
+
 	trace_kgsl_pwrstats(device, stat->total_time, &pwrscale->accum_stats);
 	memset(&pwrscale->accum_stats, 0, sizeof(pwrscale->accum_stats));
 
@@ -19,6 +19,7 @@
 #include <linux/highmem.h>
 
 #include "kgsl.h"
+#include "kgsl_pool.h"
 #include "kgsl_sharedmem.h"
 #include "kgsl_cffdump.h"
 #include "kgsl_device.h"
@@ -232,6 +233,18 @@ static ssize_t kgsl_drv_memstat_show(struct device *dev,
 		val = kgsl_driver.stats.mapped;
 	else if (!strncmp(attr->attr.name, "mapped_max", 10))
 		val = kgsl_driver.stats.mapped_max;
+	else if (!strcmp(attr->attr.name, "page_pool"))
+		val = kgsl_pool_size();
+	else if (!strcmp(attr->attr.name, "page_pool_hits"))
+		val = kgsl_pool_hits();
+	else if (!strcmp(attr->attr.name, "page_pool_misses"))
+		val = kgsl_pool_misses();
+	else if (!strcmp(attr->attr.name, "page_pool_hit_rate"))
+		val = kgsl_pool_hit_rate();
+	else if (!strcmp(attr->attr.name, "cache_ops_skipped"))
+		val = kgsl_driver.stats.cache_ops_skipped;
+	else if (!strcmp(attr->attr.name, "cache_ops_performed"))
+		val = kgsl_driver.stats.cache_ops_performed;
 
 	return snprintf(buf, PAGE_SIZE, "%u\n", val);
 }
@@ -282,6 +295,12 @@ static DEVICE_ATTR(coherent, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(coherent_max, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(mapped, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(mapped_max, 0444, kgsl_drv_memstat_show, NULL);
+static DEVICE_ATTR(page_pool, 0444, kgsl_drv_memstat_show, NULL);
+static DEVICE_ATTR(page_pool_hits, 0444, kgsl_drv_memstat_show, NULL);
+static DEVICE_ATTR(page_pool_misses, 0444, kgsl_drv_memstat_show, NULL);
+static DEVICE_ATTR(page_pool_hit_rate, 0444, kgsl_drv_memstat_show, NULL);
+static DEVICE_ATTR(cache_ops_skipped, 0444, kgsl_drv_memstat_show, NULL);
+static DEVICE_ATTR(cache_ops_performed, 0444, kgsl_drv_memstat_show, NULL);
 static DEVICE_ATTR(histogram, 0444, kgsl_drv_histogram_show, NULL);
 static DEVICE_ATTR(full_cache_threshold, 0644,
 		kgsl_drv_full_cache_threshold_show,
@@ -296,6 +315,12 @@ static const struct device_attribute *drv_attr_list[] = {
 	&dev_attr_coherent_max,
 	&dev_attr_mapped,
 	&dev_attr_mapped_max,
+	&dev_attr_page_pool,
+	&dev_attr_page_pool_hits,
+	&dev_attr_page_pool_misses,
+	&dev_attr_page_pool_hit_rate,
+	&dev_attr_cache_ops_skipped,
+	&dev_attr_cache_ops_performed,
 	&dev_attr_histogram,
 	&dev_attr_full_cache_threshold,
 	NULL
@@ -437,7 +462,8 @@ static void kgsl_page_alloc_free(struct kgsl_memdesc *memdesc)
 
 	if (memdesc->sg)
 		for_each_sg(memdesc->sg, sg, sglen, i)
-			__free_pages(sg_page(sg), get_order(sg->length));
+			kgsl_pool_free_page(sg_page(sg),
+					    get_order(sg->length));
 }
 
 /*
@@ -608,7 +634,12 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 
 	align = (memdesc->flags & KGSL_MEMALIGN_MASK) >> KGSL_MEMALIGN_SHIFT;
 
-	page_size = PAGE_SIZE;
+	/*
+	 * Use 64K chunks when the caller asked for 64K alignment, these are
+	 * kept in their own pool so they stay cheap to come by
+	 */
+	page_size = (align >= ilog2(SZ_64K) && size >= SZ_64K) ?
+			SZ_64K : PAGE_SIZE;
 	/* update align flags for what we actually use */
 	if (page_size != PAGE_SIZE)
 		kgsl_memdesc_set_align(memdesc, ilog2(page_size));
@@ -667,6 +698,14 @@ _kgsl_sharedmem_page_alloc(struct kgsl_memdesc *memdesc,
 		else
 			gfp_mask |= GFP_KERNEL;
 
+		/* Pool pages are already zeroed and out of the CPU caches */
+		page = kgsl_pool_alloc_page(get_order(page_size));
+		if (page != NULL) {
+			sg_set_page(&memdesc->sg[sglen++], page, page_size, 0);
+			len -= page_size;
+			continue;
+		}
+
 		page = alloc_pages(gfp_mask, get_order(page_size));
 
 		if (page == NULL) {
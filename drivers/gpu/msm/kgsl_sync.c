@@ -11,6 +11,7 @@
  *
  */
 
+#include <linux/dma-buf.h>
 #include <linux/err.h>
 #include <linux/file.h>
 #include <linux/sched.h>
@@ -103,12 +104,14 @@ static void kgsl_fence_event_cb(struct kgsl_device *device,
  * @device - KGSL device to create the event on
  * @timestamp - Timestamp to trigger the event
  * @data - Return fence fd stored in struct kgsl_timestamp_event_fence
+ * or struct kgsl_timestamp_event_fence_dmabuf
  * @len - length of the fence event
  * @owner - driver instance that owns this event
  * @returns 0 on success or error code on error
  *
  * Create a fence and register an event to signal the fence when
- * the timestamp expires
+ * the timestamp expires. With the dmabuf variant the fence is also
+ * attached to the buffer for display and other importers to wait on.
  */
 
 int kgsl_add_fence_event(struct kgsl_device *device,
@@ -116,19 +119,29 @@ int kgsl_add_fence_event(struct kgsl_device *device,
 	struct kgsl_device_private *owner)
 {
 	struct kgsl_fence_event_priv *event;
-	struct kgsl_timestamp_event_fence priv;
+	struct kgsl_timestamp_event_fence_dmabuf priv;
+	struct dma_buf *dmabuf = NULL;
 	struct kgsl_context *context;
 	struct sync_pt *pt;
 	struct sync_fence *fence = NULL;
 	int ret = -EINVAL;
 	char fence_name[sizeof(fence->name)] = {};
 
-	if (len != sizeof(priv))
+	if (len == sizeof(priv)) {
+		if (copy_from_user(&priv, data, sizeof(priv)))
+			return -EFAULT;
+		dmabuf = dma_buf_get(priv.dmabuf_fd);
+		if (IS_ERR(dmabuf))
+			return PTR_ERR(dmabuf);
+	} else if (len != sizeof(struct kgsl_timestamp_event_fence)) {
 		return -EINVAL;
+	}
 
 	event = kzalloc(sizeof(*event), GFP_KERNEL);
-	if (event == NULL)
-		return -ENOMEM;
+	if (event == NULL) {
+		ret = -ENOMEM;
+		goto fail_alloc;
+	}
 
 	context = kgsl_context_get_owner(owner, context_id);
 
@@ -159,6 +172,10 @@ int kgsl_add_fence_event(struct kgsl_device *device,
 		goto fail_fence;
 	}
 
+	/* keep the fence alive until it is attached, the fd may be closed */
+	if (dmabuf)
+		get_file(fence->file);
+
 	priv.fence_fd = get_unused_fd_flags(0);
 	if (priv.fence_fd < 0) {
 		KGSL_DRV_ERR(device, "invalid fence fd\n");
@@ -167,7 +184,7 @@ int kgsl_add_fence_event(struct kgsl_device *device,
 	}
 	sync_fence_install(fence, priv.fence_fd);
 
-	if (copy_to_user(data, &priv, sizeof(priv))) {
+	if (copy_to_user(data, &priv.fence_fd, sizeof(priv.fence_fd))) {
 		ret = -EFAULT;
 		goto fail_copy_fd;
 	}
@@ -181,6 +198,12 @@ int kgsl_add_fence_event(struct kgsl_device *device,
 	if (ret)
 		goto fail_event;
 
+	if (dmabuf) {
+		dma_buf_attach_fence(dmabuf, fence);
+		sync_fence_put(fence);
+		dma_buf_put(dmabuf);
+	}
+
 	return 0;
 
 fail_event:
@@ -189,11 +212,16 @@ fail_copy_fd:
 	put_unused_fd(priv.fence_fd);
 fail_fd:
 	/* clean up sync_fence_create */
+	if (dmabuf)
+		sync_fence_put(fence);
 	sync_fence_put(fence);
 fail_fence:
 fail_pt:
 	kgsl_context_put(context);
 	kfree(event);
+fail_alloc:
+	if (dmabuf)
+		dma_buf_put(dmabuf);
 	return ret;
 }
 
@@ -1067,8 +1067,11 @@ struct qpnp_iadc_chip *qpnp_get_iadc(struct device *dev, const char *name)
 		return ERR_PTR(-ENODEV);
 
 	list_for_each_entry(iadc, &qpnp_iadc_device_list, list)
-		if (iadc->adc->spmi->dev.of_node == node)
+		if (iadc->adc->spmi->dev.of_node == node) {
+			/* conversions are requested from the user's resume */
+			device_pm_add_dependency(dev, &iadc->adc->spmi->dev);
 			return iadc;
+		}
 	return ERR_PTR(-EPROBE_DEFER);
 }
 EXPORT_SYMBOL(qpnp_get_iadc);
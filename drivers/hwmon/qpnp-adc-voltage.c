@@ -1027,8 +1027,11 @@ struct qpnp_vadc_chip *qpnp_get_vadc(struct device *dev, const char *name)
 		return ERR_PTR(-ENODEV);
 
 	list_for_each_entry(vadc, &qpnp_vadc_device_list, list)
-		if (vadc->adc->spmi->dev.of_node == node)
+		if (vadc->adc->spmi->dev.of_node == node) {
+			/* conversions are requested from the user's resume */
+			device_pm_add_dependency(dev, &vadc->adc->spmi->dev);
 			return vadc;
+		}
 	return ERR_PTR(-EPROBE_DEFER);
 }
 EXPORT_SYMBOL(qpnp_get_vadc);
@@ -26,6 +26,7 @@
 #include <linux/interrupt.h>
 #include <linux/platform_device.h>
 #include <linux/delay.h>
+#include <linux/dma-mapping.h>
 #include <linux/io.h>
 #include <linux/mutex.h>
 #include <linux/timer.h>
@@ -39,6 +40,7 @@
 #include <mach/board.h>
 #include <mach/gpiomux.h>
 #include <linux/msm-bus-board.h>
+#include <linux/msm-sps.h>
 
 MODULE_LICENSE("GPL v2");
 MODULE_VERSION("0.2");
@@ -53,18 +55,21 @@ enum {
 	QUP_OPERATIONAL         = 0x18,
 	QUP_ERROR_FLAGS         = 0x1C,
 	QUP_ERROR_FLAGS_EN      = 0x20,
+	QUP_OPERATIONAL_MASK    = 0x28,
 	QUP_MX_READ_CNT         = 0x208,
 	QUP_MX_INPUT_CNT        = 0x200,
 	QUP_MX_WR_CNT           = 0x100,
 	QUP_OUT_DEBUG           = 0x108,
 	QUP_OUT_FIFO_CNT        = 0x10C,
 	QUP_OUT_FIFO_BASE       = 0x110,
+	QUP_MX_WRITE_CNT        = 0x150,
 	QUP_IN_READ_CUR         = 0x20C,
 	QUP_IN_DEBUG            = 0x210,
 	QUP_IN_FIFO_CNT         = 0x214,
 	QUP_IN_FIFO_BASE        = 0x218,
 	QUP_I2C_CLK_CTL         = 0x400,
 	QUP_I2C_STATUS          = 0x404,
+	QUP_I2C_MASTER_CONFIG   = 0x408,
 };
 
 /* QUP States and reset values */
@@ -90,6 +95,7 @@ enum {
 enum {
 	I2C_MINI_CORE           = 2U << 8,
 	I2C_N_VAL               = 0xF,
+	I2C_N_VAL_BAM           = 0x7,
 	I2C_CORE_CLK_ON_EN      = BIT(13),
 
 };
@@ -98,6 +104,8 @@ enum {
 enum {
 	QUP_WR_BLK_MODE  = 1U << 10,
 	QUP_RD_BLK_MODE  = 1U << 12,
+	QUP_WR_BAM_MODE  = 3U << 10,
+	QUP_RD_BAM_MODE  = 3U << 12,
 	QUP_UNPACK_EN = 1U << 14,
 	QUP_PACK_EN = 1U << 15,
 };
@@ -114,6 +122,17 @@ enum {
 	QUP_IN_NACK   = 7U << 8,
 };
 
+/* QUP version 2 tags, used in BAM mode */
+enum {
+	QUP_TAG2_START             = 0x81,
+	QUP_TAG2_DATA_WRITE        = 0x82,
+	QUP_TAG2_DATA_WRITE_N_STOP = 0x83,
+	QUP_TAG2_DATA_READ_N_STOP  = 0x87,
+	QUP_TAG2_INPUT_EOT         = 0x93,
+	QUP_TAG2_FLUSH_STOP        = 0x96,
+	QUP_EN_VERSION_TWO_TAG     = 1U,
+};
+
 /* Status, Error flags */
 enum {
 	I2C_STATUS_WR_BUFFER_FULL  = 1U << 0,
@@ -142,6 +161,15 @@ enum msm_i2c_state {
 #define I2C_STATUS_CLK_STATE		13
 #define QUP_OUT_FIFO_NOT_EMPTY		0x10
 #define I2C_GPIOS_DT_CNT		(2)		/* sda and scl */
+#define QUP_BAM_MAX_MSGS		8
+#define QUP_BAM_MAX_BUFS		24
+#define QUP_BAM_MAX_BUF_LEN		255
+#define QUP_BAM_PIPE_DESCS		64
+#define QUP_BAM_TAG_LEN			8
+#define QUP_BAM_IN_TAG_OFF		0
+#define QUP_BAM_EOT_TAG_OFF		QUP_BAM_TAG_LEN
+#define QUP_BAM_MSG_TAG_OFF		(2 * QUP_BAM_TAG_LEN)
+#define QUP_BAM_TAG_MEM_SZ	((QUP_BAM_MAX_BUFS + 2) * QUP_BAM_TAG_LEN)
 
 static char const * const i2c_rsrcs[] = {"i2c_clk", "i2c_sda"};
 
@@ -167,6 +195,43 @@ struct qup_i2c_clk_path_vote {
 	bool                        reg_err;
 };
 
+struct qup_i2c_bam_pipe {
+	struct sps_pipe             *handle;
+	struct sps_connect          config;
+	bool                        connected;
+};
+
+/**
+ * qup_i2c_bam: BAM mode state, set up by the first BAM transfer
+ *
+ * @mem BAM registers, NULL when the controller is used in FIFO mode only
+ * @threshold transfers moving more bytes use BAM, zero for the FIFO size
+ * @failed BAM setup failed and all transfers use FIFO mode
+ * @active a BAM transfer is running, FIFO service flags are ignored
+ * @tags DMA-able scratch for input tags, the EOT and FLUSH_STOP tags and
+ *      one output tag per buffer
+ * @dma message buffers of the current transfer
+ */
+struct qup_i2c_bam {
+	struct resource             *mem;
+	int                         irq;
+	u32                         pipe_idx_cons;
+	u32                         pipe_idx_prod;
+	u32                         threshold;
+	void __iomem                *base;
+	unsigned long               handle;
+	bool                        deregister;
+	bool                        is_init;
+	bool                        failed;
+	bool                        active;
+	struct qup_i2c_bam_pipe     cons;
+	struct qup_i2c_bam_pipe     prod;
+	u8                          *tags;
+	dma_addr_t                  tags_phys;
+	dma_addr_t                  dma[QUP_BAM_MAX_MSGS];
+	struct completion           complete;
+};
+
 struct qup_i2c_dev {
 	struct device                *dev;
 	void __iomem                 *base;		/* virtual */
@@ -197,6 +262,7 @@ struct qup_i2c_dev {
 	void                         *complete;
 	int                          i2c_gpios[ARRAY_SIZE(i2c_rsrcs)];
 	struct qup_i2c_clk_path_vote clk_path_vote;
+	struct qup_i2c_bam           bam;
 };
 
 #ifdef CONFIG_PM
@@ -275,6 +341,10 @@ qup_i2c_interrupt(int irq, void *devid)
 		goto intr_done;
 	}
 
+	/* BAM signals the end of the transfer, not the FIFOs */
+	if (dev->bam.active)
+		return IRQ_HANDLED;
+
 	if ((dev->num_irqs == 3) && (dev->msg->flags == I2C_M_RD)
 		&& (irq == dev->out_irq))
 		return IRQ_HANDLED;
@@ -994,6 +1064,487 @@ static void i2c_qup_dump_gpios(struct qup_i2c_dev *dev)
 						GPIOMUX_SUSPENDED, "suspended");
 }
 
+/*
+ * BAM mode: the bytes of a transfer are moved between memory and the QUP
+ * FIFOs by the BLSP BAM instead of by the CPU. The QUP is switched to
+ * version 2 tags, which the BAM queues on the consumer pipe ahead of the
+ * data. The whole transfer is signalled by a single EOT completion, where
+ * FIFO mode takes an interrupt per block.
+ */
+static void qup_i2c_bam_pipe_disconnect(struct qup_i2c_dev *dev,
+					struct qup_i2c_bam_pipe *pipe)
+{
+	if (!pipe->connected)
+		return;
+
+	if (sps_disconnect(pipe->handle))
+		dev_err(dev->dev, "error disconnecting BAM pipe\n");
+	pipe->connected = false;
+}
+
+static int qup_i2c_bam_pipe_connect(struct qup_i2c_dev *dev,
+				    struct qup_i2c_bam_pipe *pipe)
+{
+	struct sps_register_event event = {
+		.mode      = SPS_TRIGGER_WAIT,
+		.options   = SPS_O_EOT,
+		.xfer_done = &dev->bam.complete,
+	};
+	int ret;
+
+	ret = sps_connect(pipe->handle, &pipe->config);
+	if (ret) {
+		dev_err(dev->dev, "error connecting BAM pipe:%d\n", ret);
+		return ret;
+	}
+
+	ret = sps_register_event(pipe->handle, &event);
+	if (ret) {
+		dev_err(dev->dev, "error registering BAM pipe event:%d\n", ret);
+		sps_disconnect(pipe->handle);
+		return ret;
+	}
+
+	pipe->connected = true;
+	return 0;
+}
+
+static void qup_i2c_bam_pipe_teardown(struct qup_i2c_dev *dev,
+				      struct qup_i2c_bam_pipe *pipe)
+{
+	if (!pipe->handle)
+		return;
+
+	qup_i2c_bam_pipe_disconnect(dev, pipe);
+	if (pipe->config.desc.base)
+		dma_free_coherent(dev->dev, pipe->config.desc.size,
+				  pipe->config.desc.base,
+				  pipe->config.desc.phys_base);
+	sps_free_endpoint(pipe->handle);
+	memset(pipe, 0, sizeof(*pipe));
+}
+
+static int qup_i2c_bam_pipe_init(struct qup_i2c_dev *dev,
+				 struct qup_i2c_bam_pipe *pipe, bool is_cons)
+{
+	struct qup_i2c_bam *bam = &dev->bam;
+	struct sps_connect *config = &pipe->config;
+	int ret;
+
+	pipe->handle = sps_alloc_endpoint();
+	if (!pipe->handle)
+		return -ENOMEM;
+
+	ret = sps_get_config(pipe->handle, config);
+	if (ret)
+		goto pipe_err;
+
+	if (is_cons) {
+		config->source          = SPS_DEV_HANDLE_MEM;
+		config->destination     = bam->handle;
+		config->mode            = SPS_MODE_DEST;
+		config->src_pipe_index  = 0;
+		config->dest_pipe_index = bam->pipe_idx_cons;
+	} else {
+		config->source          = bam->handle;
+		config->destination     = SPS_DEV_HANDLE_MEM;
+		config->mode            = SPS_MODE_SRC;
+		config->src_pipe_index  = bam->pipe_idx_prod;
+		config->dest_pipe_index = 0;
+	}
+	config->options   = SPS_O_EOT | SPS_O_AUTO_ENABLE;
+	config->desc.size = QUP_BAM_PIPE_DESCS * sizeof(struct sps_iovec);
+	config->desc.base = dma_alloc_coherent(dev->dev, config->desc.size,
+					       &config->desc.phys_base,
+					       GFP_KERNEL);
+	if (!config->desc.base) {
+		ret = -ENOMEM;
+		goto pipe_err;
+	}
+	memset(config->desc.base, 0, config->desc.size);
+
+	ret = qup_i2c_bam_pipe_connect(dev, pipe);
+	if (ret)
+		goto pipe_err;
+
+	return 0;
+
+pipe_err:
+	qup_i2c_bam_pipe_teardown(dev, pipe);
+	return ret;
+}
+
+static void qup_i2c_bam_teardown(struct qup_i2c_dev *dev)
+{
+	struct qup_i2c_bam *bam = &dev->bam;
+
+	qup_i2c_bam_pipe_teardown(dev, &bam->cons);
+	qup_i2c_bam_pipe_teardown(dev, &bam->prod);
+
+	if (bam->deregister) {
+		sps_deregister_bam_device(bam->handle);
+		bam->deregister = false;
+	}
+	if (bam->tags) {
+		dma_free_coherent(dev->dev, QUP_BAM_TAG_MEM_SZ, bam->tags,
+				  bam->tags_phys);
+		bam->tags = NULL;
+	}
+	if (bam->base) {
+		iounmap(bam->base);
+		bam->base = NULL;
+	}
+	bam->is_init = false;
+}
+
+static int qup_i2c_bam_init(struct qup_i2c_dev *dev)
+{
+	struct qup_i2c_bam *bam = &dev->bam;
+	struct sps_bam_props props = {
+		.phys_addr         = bam->mem->start,
+		.irq               = bam->irq,
+		.manage            = SPS_BAM_MGR_LOCAL,
+		.summing_threshold = 0x10,
+	};
+	int ret;
+
+	if (bam->is_init)
+		return 0;
+
+	bam->tags = dma_alloc_coherent(dev->dev, QUP_BAM_TAG_MEM_SZ,
+				       &bam->tags_phys, GFP_KERNEL);
+	if (!bam->tags)
+		return -ENOMEM;
+	bam->tags[QUP_BAM_EOT_TAG_OFF]     = QUP_TAG2_INPUT_EOT;
+	bam->tags[QUP_BAM_EOT_TAG_OFF + 1] = QUP_TAG2_FLUSH_STOP;
+
+	/* the BAM may already be registered by another BLSP client */
+	ret = sps_phy2h(bam->mem->start, &bam->handle);
+	if (ret || !bam->handle) {
+		bam->base = ioremap(bam->mem->start, resource_size(bam->mem));
+		if (!bam->base) {
+			ret = -ENOMEM;
+			goto bam_init_err;
+		}
+		props.virt_addr = bam->base;
+
+		ret = sps_register_bam_device(&props, &bam->handle);
+		if (ret)
+			goto bam_init_err;
+		bam->deregister = true;
+	}
+
+	ret = qup_i2c_bam_pipe_init(dev, &bam->prod, false);
+	if (ret)
+		goto bam_init_err;
+
+	ret = qup_i2c_bam_pipe_init(dev, &bam->cons, true);
+	if (ret)
+		goto bam_init_err;
+
+	bam->is_init = true;
+	return 0;
+
+bam_init_err:
+	qup_i2c_bam_teardown(dev);
+	return ret;
+}
+
+/* Drop descriptors left queued by a transfer that did not complete */
+static void qup_i2c_bam_flush(struct qup_i2c_dev *dev)
+{
+	struct qup_i2c_bam *bam = &dev->bam;
+
+	qup_i2c_bam_pipe_disconnect(dev, &bam->cons);
+	qup_i2c_bam_pipe_disconnect(dev, &bam->prod);
+	if (qup_i2c_bam_pipe_connect(dev, &bam->cons) ||
+	    qup_i2c_bam_pipe_connect(dev, &bam->prod))
+		qup_i2c_bam_teardown(dev);
+}
+
+/*
+ * A transfer goes through BAM when it moves more bytes than the FIFO holds
+ * and fits the tag and descriptor space. Messages longer than a BAM buffer
+ * are split: write chunks continue without a new start, while read chunks
+ * restart the read as the FIFO path does at its 256 byte limit.
+ */
+static bool
+qup_i2c_bam_suitable(struct qup_i2c_dev *dev, struct i2c_msg msgs[], int num)
+{
+	struct qup_i2c_bam *bam = &dev->bam;
+	int threshold = bam->threshold ? bam->threshold : dev->out_fifo_sz;
+	int bufs = 0;
+	int total = 0;
+	int i;
+
+	if (!bam->mem || bam->failed || num > QUP_BAM_MAX_MSGS)
+		return false;
+
+	for (i = 0; i < num; i++) {
+		if (!msgs[i].len || (msgs[i].flags & ~I2C_M_RD))
+			return false;
+		bufs += DIV_ROUND_UP(msgs[i].len, QUP_BAM_MAX_BUF_LEN);
+		total += msgs[i].len;
+	}
+
+	return bufs <= QUP_BAM_MAX_BUFS && total > threshold;
+}
+
+static void qup_i2c_bam_unmap(struct qup_i2c_dev *dev, struct i2c_msg msgs[],
+			      int num)
+{
+	int i;
+
+	for (i = 0; i < num; i++)
+		dma_unmap_single(dev->dev, dev->bam.dma[i], msgs[i].len,
+				 (msgs[i].flags & I2C_M_RD) ?
+				 DMA_FROM_DEVICE : DMA_TO_DEVICE);
+}
+
+static int qup_i2c_bam_map(struct qup_i2c_dev *dev, struct i2c_msg msgs[],
+			   int num)
+{
+	dma_addr_t addr;
+	int i;
+
+	for (i = 0; i < num; i++) {
+		addr = dma_map_single(dev->dev, msgs[i].buf, msgs[i].len,
+				      (msgs[i].flags & I2C_M_RD) ?
+				      DMA_FROM_DEVICE : DMA_TO_DEVICE);
+		if (dma_mapping_error(dev->dev, addr)) {
+			qup_i2c_bam_unmap(dev, msgs, i);
+			return -ENOMEM;
+		}
+		dev->bam.dma[i] = addr;
+	}
+
+	return 0;
+}
+
+/* Switch the reset QUP to BAM mode and version 2 tags, then run it */
+static int qup_i2c_bam_config(struct qup_i2c_dev *dev)
+{
+	int ret;
+
+	writel_relaxed(0, dev->base + QUP_CONFIG);
+	writel_relaxed(QUP_OPERATIONAL_RESET, dev->base + QUP_OPERATIONAL);
+	writel_relaxed(QUP_STATUS_ERROR_FLAGS, dev->base + QUP_ERROR_FLAGS_EN);
+	writel_relaxed(I2C_MINI_CORE | I2C_N_VAL_BAM, dev->base + QUP_CONFIG);
+	writel_relaxed(QUP_EN_VERSION_TWO_TAG,
+		       dev->base + QUP_I2C_MASTER_CONFIG);
+
+	/* all counts are zero in BAM mode, the tags delimit the transfer */
+	writel_relaxed(0, dev->base + QUP_MX_INPUT_CNT);
+	writel_relaxed(0, dev->base + QUP_MX_WR_CNT);
+	writel_relaxed(0, dev->base + QUP_MX_READ_CNT);
+	writel_relaxed(0, dev->base + QUP_MX_WRITE_CNT);
+	writel_relaxed(QUP_WR_BAM_MODE | QUP_RD_BAM_MODE |
+		       QUP_PACK_EN | QUP_UNPACK_EN, dev->base + QUP_IO_MODE);
+	/* no FIFO service interrupts, only errors and the BAM's EOT */
+	writel_relaxed(QUP_OUT_SVC_FLAG | QUP_IN_SVC_FLAG,
+		       dev->base + QUP_OPERATIONAL_MASK);
+
+	writel_relaxed(0, dev->base + QUP_I2C_CLK_CTL);
+	writel_relaxed(QUP_I2C_STATUS_RESET, dev->base + QUP_I2C_STATUS);
+
+	if (qup_i2c_poll_state(dev, QUP_I2C_MAST_GEN, false) != 0)
+		return -EIO;
+
+	ret = qup_update_state(dev, QUP_RUN_STATE);
+	if (ret < 0)
+		return ret;
+
+	writel_relaxed(dev->clk_ctl, dev->base + QUP_I2C_CLK_CTL);
+	/* Ensure that clock control is written before queueing the tags */
+	mb();
+	return 0;
+}
+
+static int qup_i2c_bam_queue(struct qup_i2c_dev *dev, struct i2c_msg msgs[],
+			     int num)
+{
+	struct qup_i2c_bam *bam = &dev->bam;
+	u8 *tag = bam->tags + QUP_BAM_MSG_TAG_OFF;
+	dma_addr_t tag_phys = bam->tags_phys + QUP_BAM_MSG_TAG_OFF;
+	dma_addr_t in_tag = bam->tags_phys + QUP_BAM_IN_TAG_OFF;
+	bool last_rx = msgs[num - 1].flags & I2C_M_RD;
+	int i, pos, len, tag_len;
+	int ret = 0;
+	u32 flags;
+
+	for (i = 0; i < num; i++) {
+		bool rx = msgs[i].flags & I2C_M_RD;
+
+		for (pos = 0; pos < msgs[i].len; pos += len) {
+			bool last = (i == num - 1) &&
+				(msgs[i].len - pos <= QUP_BAM_MAX_BUF_LEN);
+
+			len = min_t(int, msgs[i].len - pos,
+				    QUP_BAM_MAX_BUF_LEN);
+
+			/* the HW stops after every read, so always restart */
+			tag_len = 0;
+			if (rx || !pos) {
+				tag[tag_len++] = QUP_TAG2_START;
+				tag[tag_len++] = (msgs[i].addr << 1) | rx;
+			}
+			if (rx)
+				tag[tag_len++] = QUP_TAG2_DATA_READ_N_STOP;
+			else
+				tag[tag_len++] = last ?
+					QUP_TAG2_DATA_WRITE_N_STOP :
+					QUP_TAG2_DATA_WRITE;
+			tag[tag_len++] = len;
+
+			ret = sps_transfer_one(bam->cons.handle, tag_phys,
+					       tag_len, dev, 0);
+			if (ret)
+				return ret;
+			tag += QUP_BAM_TAG_LEN;
+			tag_phys += QUP_BAM_TAG_LEN;
+
+			/* step over the read tag and length in the input */
+			if (rx) {
+				ret = sps_transfer_one(bam->prod.handle,
+						       in_tag, 2, dev, 0);
+				if (ret)
+					return ret;
+			}
+
+			flags = (last && !rx) ?
+				(SPS_IOVEC_FLAG_EOT | SPS_IOVEC_FLAG_NWD) : 0;
+			ret = sps_transfer_one(rx ? bam->prod.handle :
+					       bam->cons.handle,
+					       bam->dma[i] + pos, len, dev,
+					       flags);
+			if (ret)
+				return ret;
+		}
+	}
+
+	if (last_rx) {
+		/* reading the EOT tag off the input raises the interrupt */
+		ret = sps_transfer_one(bam->prod.handle, in_tag, 2, dev, 0);
+		if (ret)
+			return ret;
+		ret = sps_transfer_one(bam->cons.handle,
+				       bam->tags_phys + QUP_BAM_EOT_TAG_OFF, 2,
+				       dev, SPS_IOVEC_FLAG_EOT |
+				       SPS_IOVEC_FLAG_NWD);
+	}
+
+	return ret;
+}
+
+/*
+ * Returns -EAGAIN when BAM could not be set up before anything reached the
+ * bus, in which case the caller carries on with the FIFO path.
+ */
+static int
+qup_i2c_bam_xfer(struct qup_i2c_dev *dev, struct i2c_msg msgs[], int num)
+{
+	struct qup_i2c_bam *bam = &dev->bam;
+	long timeout;
+	int total = 0;
+	int i, ret;
+
+	ret = qup_i2c_bam_init(dev);
+	if (ret) {
+		dev_err(dev->dev, "BAM init failed:%d, using FIFO mode\n", ret);
+		bam->failed = true;
+		return -EAGAIN;
+	}
+
+	if (qup_i2c_bam_map(dev, msgs, num))
+		return -EAGAIN;
+
+	for (i = 0; i < num; i++)
+		total += msgs[i].len;
+
+	INIT_COMPLETION(bam->complete);
+	dev->msg = msgs;
+	dev->err = 0;
+	dev->complete = &bam->complete;
+	dev->bam.active = true;
+
+	ret = qup_i2c_bam_config(dev);
+	if (ret)
+		goto bam_xfer_err;
+
+	ret = qup_i2c_bam_queue(dev, msgs, num);
+	if (ret) {
+		dev_err(dev->dev, "error queueing BAM descriptors:%d\n", ret);
+		goto bam_xfer_err;
+	}
+
+	/* nine clocks per byte, with the FIFO path's margin on top */
+	timeout = wait_for_completion_timeout(&bam->complete,
+			msecs_to_jiffies(total * 9 * MSEC_PER_SEC /
+					 dev->pdata->clk_freq +
+					 dev->out_fifo_sz));
+	if (!timeout) {
+		dev_err(dev->dev, "BAM transaction timed out, SL-AD = 0x%x\n",
+			msgs->addr);
+		dev_err(dev->dev, "I2C Status: %x\n",
+			readl_relaxed(dev->base + QUP_I2C_STATUS));
+		dev_err(dev->dev, "QUP Status: %x\n",
+			readl_relaxed(dev->base + QUP_ERROR_FLAGS));
+		qup_i2c_recover_bus_busy(dev);
+		ret = -ETIMEDOUT;
+	} else if (dev->err > 0 && (dev->err & QUP_I2C_NACK_FLAG)) {
+		dev_err(dev->dev, "I2C slave addr:0x%x not connected\n",
+			msgs->addr);
+		ret = -ENOTCONN;
+	} else if (dev->err > 0) {
+		i2c_qup_dump_gpios(dev);
+		qup_i2c_recover_bus_busy(dev);
+		ret = -dev->err;
+	} else if (dev->err < 0) {
+		dev_err(dev->dev, "QUP data xfer error %d\n", dev->err);
+		ret = dev->err;
+	} else {
+		ret = qup_i2c_poll_writeready(dev, 0);
+	}
+
+bam_xfer_err:
+	dev->bam.active = false;
+	if (ret) {
+		writel_relaxed(1, dev->base + QUP_SW_RESET);
+		/* Make sure the QUP is reset before dropping descriptors */
+		mb();
+		qup_i2c_bam_flush(dev);
+	}
+	qup_i2c_bam_unmap(dev, msgs, num);
+	return ret;
+}
+
+static void qup_i2c_bam_probe(struct platform_device *pdev,
+			      struct qup_i2c_dev *dev)
+{
+	struct qup_i2c_bam *bam = &dev->bam;
+	struct device_node *node = pdev->dev.of_node;
+
+	init_completion(&bam->complete);
+
+	if (!node)
+		return;
+
+	bam->mem = platform_get_resource_byname(pdev, IORESOURCE_MEM,
+						"bam_phys_addr");
+	bam->irq = platform_get_irq_byname(pdev, "bam_irq");
+	if (!bam->mem || bam->irq < 0 ||
+	    of_property_read_u32(node, "qcom,bam-pipe-idx-cons",
+				 &bam->pipe_idx_cons) ||
+	    of_property_read_u32(node, "qcom,bam-pipe-idx-prod",
+				 &bam->pipe_idx_prod)) {
+		bam->mem = NULL;
+		return;
+	}
+	of_property_read_u32(node, "qcom,bam-threshold", &bam->threshold);
+	dev_dbg(&pdev->dev, "BAM mode for transfers above %u bytes\n",
+		bam->threshold);
+}
+
 static int
 qup_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 {
@@ -1092,6 +1643,15 @@ qup_i2c_xfer(struct i2c_adapter *adap, struct i2c_msg msgs[], int num)
 	}
 	enable_irq(dev->err_irq);
 
+	if (qup_i2c_bam_suitable(dev, msgs, num)) {
+		ret = qup_i2c_bam_xfer(dev, msgs, num);
+		if (ret != -EAGAIN) {
+			if (!ret)
+				ret = num;
+			goto out_err;
+		}
+	}
+
 	/* Initialize QUP registers */
 	writel_relaxed(0, dev->base + QUP_CONFIG);
 	writel_relaxed(QUP_OPERATIONAL_RESET, dev->base + QUP_OPERATIONAL);
@@ -1598,6 +2158,7 @@ blsp_core_init:
 	dev->pdata = pdata;
 	dev->clk_ctl = 0;
 	dev->pos = 0;
+	qup_i2c_bam_probe(pdev, dev);
 
 	ret = i2c_qup_clk_path_init(pdev, dev);
 	if (ret) {
@@ -1713,6 +2274,8 @@ blsp_core_init:
 			dev->adapter.dev.of_node = pdev->dev.of_node;
 			of_i2c_register_devices(&dev->adapter);
 		}
+		/* clients wait for the adapter as their ancestor */
+		device_enable_async_suspend(&pdev->dev);
 
 		return 0;
 	}
@@ -1765,6 +2328,9 @@ qup_i2c_remove(struct platform_device *pdev)
 	mutex_lock(&dev->mlock);
 	dev->pwr_state = MSM_I2C_SYS_SUSPENDING;
 	mutex_unlock(&dev->mlock);
+	i2c_qup_pm_resume_clk(dev);
+	qup_i2c_bam_teardown(dev);
+	i2c_qup_pm_suspend_clk(dev);
 	i2c_qup_pm_suspend(dev);
 	dev->pwr_state = MSM_I2C_SYS_SUSPENDED;
 	mutex_destroy(&dev->mlock);
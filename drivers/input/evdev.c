@@ -453,8 +453,10 @@ static ssize_t evdev_read(struct file *file, char __user *buffer,
 			read += input_event_size();
 		}
 
-		if (read)
+		if (read) {
+			input_latency_read(evdev->handle.dev);
 			break;
+		}
 
 		if (!(file->f_flags & O_NONBLOCK)) {
 			error = wait_event_interruptible(evdev->wait,
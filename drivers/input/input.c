@@ -29,6 +29,9 @@
 #include <linux/rcupdate.h>
 #include "input-compat.h"
 
+#define CREATE_TRACE_POINTS
+#include <trace/events/input.h>
+
 MODULE_AUTHOR("Vojtech Pavlik <vojtech@suse.cz>");
 MODULE_DESCRIPTION("Input core");
 MODULE_LICENSE("GPL");
@@ -362,6 +365,39 @@ static int input_get_disposition(struct input_dev *dev,
 	return disposition;
 }
 
+static void input_latency_account(struct input_dev *dev,
+				  enum input_latency_stage stage,
+				  ktime_t start, ktime_t end)
+{
+	s64 us = ktime_us_delta(end, start);
+	unsigned int bucket = us > 0 ? fls64(us >> 6) : 0;
+
+	bucket = min_t(unsigned int, bucket, INPUT_LAT_BUCKETS - 1);
+	dev->latency.hist[stage][bucket]++;
+}
+
+/*
+ * Called with dev->event_lock held when a frame is flushed to the
+ * handlers. Stages the driver did not mark are left out.
+ */
+static void input_latency_sync(struct input_dev *dev)
+{
+	struct input_latency *lat = &dev->latency;
+	ktime_t now = ktime_get();
+	ktime_t start = lat->data.tv64 ? lat->data : lat->irq;
+
+	if (start.tv64) {
+		if (lat->data.tv64)
+			input_latency_account(dev, INPUT_LAT_DATA_TO_SYNC,
+					      lat->data, now);
+		trace_input_sync(dev, ktime_us_delta(now, start));
+	}
+
+	lat->irq = ktime_set(0, 0);
+	lat->data = ktime_set(0, 0);
+	lat->sync = now;
+}
+
 static void input_handle_event(struct input_dev *dev,
 			       unsigned int type, unsigned int code, int value)
 {
@@ -392,6 +428,7 @@ static void input_handle_event(struct input_dev *dev,
 	}
 
 	if (disposition & INPUT_FLUSH) {
+		input_latency_sync(dev);
 		if (dev->num_vals >= 2)
 			input_pass_values(dev, dev->vals, dev->num_vals);
 		dev->num_vals = 0;
@@ -466,6 +503,76 @@ void input_inject_event(struct input_handle *handle,
 }
 EXPORT_SYMBOL(input_inject_event);
 
+/**
+ * input_latency_irq() - mark the interrupt that starts a frame
+ * @dev: device that raised the interrupt
+ * @time: ktime_get() timestamp taken in the hard interrupt handler
+ *
+ * Drivers that want their frames broken down in the latency histograms
+ * call this from their interrupt thread before fetching the data.
+ */
+void input_latency_irq(struct input_dev *dev, ktime_t time)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&dev->event_lock, flags);
+	dev->latency.irq = time;
+	spin_unlock_irqrestore(&dev->event_lock, flags);
+
+	trace_input_irq(dev, ktime_us_delta(ktime_get(), time));
+}
+EXPORT_SYMBOL(input_latency_irq);
+
+/**
+ * input_latency_data() - mark the end of the bus transfer for a frame
+ * @dev: device the data was fetched from
+ */
+void input_latency_data(struct input_dev *dev)
+{
+	struct input_latency *lat = &dev->latency;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	s64 us = 0;
+
+	spin_lock_irqsave(&dev->event_lock, flags);
+	if (lat->irq.tv64) {
+		input_latency_account(dev, INPUT_LAT_IRQ_TO_DATA,
+				      lat->irq, now);
+		us = ktime_us_delta(now, lat->irq);
+	}
+	lat->data = now;
+	spin_unlock_irqrestore(&dev->event_lock, flags);
+
+	trace_input_data(dev, us);
+}
+EXPORT_SYMBOL(input_latency_data);
+
+/**
+ * input_latency_read() - mark a reader picking up the last frame
+ * @dev: device the frame came from
+ *
+ * Called by input handlers when a client consumes events.
+ */
+void input_latency_read(struct input_dev *dev)
+{
+	struct input_latency *lat = &dev->latency;
+	unsigned long flags;
+	ktime_t now = ktime_get();
+	s64 us = -1;
+
+	spin_lock_irqsave(&dev->event_lock, flags);
+	if (lat->sync.tv64) {
+		input_latency_account(dev, INPUT_LAT_SYNC_TO_READ,
+				      lat->sync, now);
+		us = ktime_us_delta(now, lat->sync);
+	}
+	spin_unlock_irqrestore(&dev->event_lock, flags);
+
+	if (us >= 0)
+		trace_input_evdev_read(dev, us);
+}
+EXPORT_SYMBOL(input_latency_read);
+
 /**
  * input_alloc_absinfo - allocates array of input_absinfo structs
  * @dev: the input device emitting absolute events
@@ -1380,12 +1487,59 @@ static ssize_t input_dev_show_properties(struct device *dev,
 }
 static DEVICE_ATTR(properties, S_IRUGO, input_dev_show_properties, NULL);
 
+static const char * const input_latency_stage_names[INPUT_LAT_STAGES] = {
+	[INPUT_LAT_IRQ_TO_DATA]		= "irq_to_data",
+	[INPUT_LAT_DATA_TO_SYNC]	= "data_to_sync",
+	[INPUT_LAT_SYNC_TO_READ]	= "sync_to_read",
+};
+
+static ssize_t input_dev_show_latency(struct device *dev,
+				      struct device_attribute *attr,
+				      char *buf)
+{
+	struct input_dev *input_dev = to_input_dev(dev);
+	unsigned int hist[INPUT_LAT_STAGES][INPUT_LAT_BUCKETS];
+	int len = 0;
+	int i, j;
+
+	spin_lock_irq(&input_dev->event_lock);
+	memcpy(hist, input_dev->latency.hist, sizeof(hist));
+	spin_unlock_irq(&input_dev->event_lock);
+
+	for (i = 0; i < INPUT_LAT_STAGES; i++) {
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s:",
+				 input_latency_stage_names[i]);
+		for (j = 0; j < INPUT_LAT_BUCKETS; j++)
+			len += scnprintf(buf + len, PAGE_SIZE - len, " %u",
+					 hist[i][j]);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+
+	return len;
+}
+
+static ssize_t input_dev_reset_latency(struct device *dev,
+				       struct device_attribute *attr,
+				       const char *buf, size_t count)
+{
+	struct input_dev *input_dev = to_input_dev(dev);
+
+	spin_lock_irq(&input_dev->event_lock);
+	memset(input_dev->latency.hist, 0, sizeof(input_dev->latency.hist));
+	spin_unlock_irq(&input_dev->event_lock);
+
+	return count;
+}
+static DEVICE_ATTR(latency, S_IRUGO | S_IWUSR,
+		   input_dev_show_latency, input_dev_reset_latency);
+
 static struct attribute *input_dev_attrs[] = {
 	&dev_attr_name.attr,
 	&dev_attr_phys.attr,
 	&dev_attr_uniq.attr,
 	&dev_attr_modalias.attr,
 	&dev_attr_properties.attr,
+	&dev_attr_latency.attr,
 	NULL
 };
 
@@ -62,6 +62,9 @@
 #define CM36283_PS_MAX_POLL_DELAY	1000
 #define CM36283_PS_DEFAULT_POLL_DELAY	100
 
+/* time userspace is given to pick up a light change after a wakeup */
+#define CM36283_LS_WAKE_MS		500
+
 static struct sensors_classdev sensors_light_cdev = {
 	.name = "cm36283-light",
 	.vendor = "Capella",
@@ -160,6 +163,8 @@ struct cm36283_info {
 	uint16_t ls_cmd;
 	uint8_t record_clear_int_fail;
 	bool polling;
+	bool ls_wake;
+	bool ls_wake_armed;
 	atomic_t ls_poll_delay;
 	atomic_t ps_poll_delay;
 	struct regulator *vdd;
@@ -506,6 +511,9 @@ static irqreturn_t cm36283_irq_handler(int irq, void *data)
 {
 	struct cm36283_info *lpi = data;
 
+	if (lpi->ls_wake_armed)
+		pm_wakeup_event(&lpi->i2c_client->dev, CM36283_LS_WAKE_MS);
+
 	disable_irq_nosync(lpi->irq);
 	queue_work(lpi->lp_wq, &sensor_irq_work);
 
@@ -1311,6 +1319,38 @@ static ssize_t ls_fLevel_store(struct device *dev,
 	return count;
 }
 
+static ssize_t ls_wake_show(struct device *dev,
+				struct device_attribute *attr, char *buf)
+{
+	struct cm36283_info *lpi = lp_info;
+
+	return scnprintf(buf, PAGE_SIZE, "%d\n", lpi->ls_wake);
+}
+
+/*
+ * With ls_wake set the light sensor keeps running on its threshold
+ * interrupt through suspend and a change of light level band wakes the
+ * system up, instead of the sensor being powered down.
+ */
+static ssize_t ls_wake_store(struct device *dev,
+				struct device_attribute *attr,
+				const char *buf, size_t count)
+{
+	struct cm36283_info *lpi = lp_info;
+	unsigned long value;
+
+	if (kstrtoul(buf, 10, &value) || value > 1)
+		return -EINVAL;
+
+	/* threshold interrupts are only wired up when not polling */
+	if (value && lpi->polling)
+		return -ENODEV;
+
+	lpi->ls_wake = value;
+
+	return count;
+}
+
 static int lightsensor_setup(struct cm36283_info *lpi)
 {
 	int ret;
@@ -1438,6 +1478,9 @@ static int cm36283_setup(struct cm36283_info *lpi)
 		goto fail_free_intr_pin;
 	}
 
+	if (!lpi->polling)
+		device_init_wakeup(&lpi->i2c_client->dev, 1);
+
 	return ret;
 
 fail_free_intr_pin:
@@ -1556,6 +1599,7 @@ static struct device_attribute light_attr[] = {
 			ls_poll_delay_store),
 	__ATTR(enable, 0664,
 			ls_enable_show, ls_enable_store),
+	__ATTR(ls_wake, 0664, ls_wake_show, ls_wake_store),
 };
 
 static struct device_attribute proximity_attr[] = {
@@ -2015,6 +2059,13 @@ static int cm36283_suspend(struct device *dev)
 {
 	struct cm36283_info *lpi = lp_info;
 
+	if (lpi->ls_wake && lpi->als_enable && device_may_wakeup(dev)) {
+		if (!enable_irq_wake(lpi->irq)) {
+			lpi->ls_wake_armed = true;
+			return 0;
+		}
+	}
+
 	if (lpi->als_enable) {
 		if (lightsensor_disable(lpi))
 			goto out;
@@ -2035,6 +2086,12 @@ static int cm36283_resume(struct device *dev)
 {
 	struct cm36283_info *lpi = lp_info;
 
+	if (lpi->ls_wake_armed) {
+		disable_irq_wake(lpi->irq);
+		lpi->ls_wake_armed = false;
+		return 0;
+	}
+
 	if (cm36283_power_set(lpi, 1))
 		goto out;
 
@@ -56,6 +56,15 @@
 #define MPU6050_RAW_ACCEL_DATA_LEN	6
 #define MPU6050_RAW_GYRO_DATA_LEN	6
 
+#define MPU6050_MAX_BATCH_MS		10000
+
+/* motion must last this many wakeup cycles to raise the interrupt */
+#define MPU6050_MOTION_DUR		1
+/* time userspace is given to pick up a motion event after a wakeup */
+#define MPU6050_MOTION_WAKE_MS		500
+/* frames fetched per FIFO burst read */
+#define MPU6050_FIFO_CHUNK_FRAMES	16
+
 struct axis_data {
 	s16 x;
 	s16 y;
@@ -83,6 +92,11 @@ struct axis_data {
  *  @accel_poll_ms:	accelerometer polling delay.
  *  @enable_gpio:	enable GPIO.
  *  @use_poll:		use interrupt mode instead of polling data.
+ *  @fifo_work:		FIFO drain work structure used in batching mode.
+ *  @batch_ms:		maximum report latency in batching mode, 0 if off.
+ *  @fifo_frame_size:	bytes per sample set stored in the FIFO.
+ *  @motion_thr:	motion threshold in low power motion mode.
+ *  @int_enable:	interrupt enables saved over low power motion mode.
  */
 struct mpu6050_sensor {
 	struct i2c_client *client;
@@ -102,6 +116,11 @@ struct mpu6050_sensor {
 	u32 accel_poll_ms;
 	int enable_gpio;
 	bool use_poll;
+	struct delayed_work fifo_work;
+	u32 batch_ms;
+	u8 fifo_frame_size;
+	u8 motion_thr;
+	u8 int_enable;
 };
 
 static int mpu6050_power_ctl(struct mpu6050_sensor *sensor, bool on)
@@ -301,6 +320,19 @@ static void mpu6050_read_gyro_data(struct mpu6050_sensor *sensor,
 static irqreturn_t mpu6050_interrupt_thread(int irq, void *data)
 {
 	struct mpu6050_sensor *sensor = data;
+	int status;
+
+	if (sensor->cfg.lpa_mode) {
+		status = i2c_smbus_read_byte_data(sensor->client,
+				sensor->reg.int_status);
+		if (status > 0 && (status & BIT_MOT_INT)) {
+			pm_wakeup_event(&sensor->client->dev,
+					MPU6050_MOTION_WAKE_MS);
+			input_event(sensor->accel_dev, EV_MSC, MSC_GESTURE, 1);
+			input_sync(sensor->accel_dev);
+		}
+		return IRQ_HANDLED;
+	}
 
 	mpu6050_read_accel_data(sensor, &sensor->axis);
 	mpu6050_read_gyro_data(sensor, &sensor->axis);
@@ -370,6 +402,210 @@ static void mpu6050_gyro_work_fn(struct work_struct *work)
 			msecs_to_jiffies(sensor->gyro_poll_ms));
 }
 
+/**
+ * mpu6050_fifo_config - route the enabled engines into the FIFO
+ * @sensor: sensor device instance
+ * @on: true to start filling the FIFO, false to stop it
+ *
+ * The FIFO is reset whenever it is (re)started, so samples that were
+ * stored under a different frame layout are never parsed.
+ */
+static int mpu6050_fifo_config(struct mpu6050_sensor *sensor, bool on)
+{
+	struct mpu_reg_map *reg = &sensor->reg;
+	u8 fifo_en = 0;
+	int ret;
+
+	ret = i2c_smbus_write_byte_data(sensor->client, reg->fifo_en, 0);
+	if (ret < 0)
+		return ret;
+
+	ret = i2c_smbus_write_byte_data(sensor->client, reg->user_ctrl,
+			BIT_FIFO_RST);
+	if (ret < 0)
+		return ret;
+
+	sensor->cfg.accel_fifo_enable = on && sensor->cfg.accel_enable;
+	sensor->cfg.gyro_fifo_enable = on && sensor->cfg.gyro_enable;
+	sensor->fifo_frame_size = 0;
+	if (sensor->cfg.accel_fifo_enable) {
+		fifo_en |= BIT_ACCEL_OUT;
+		sensor->fifo_frame_size += MPU6050_RAW_ACCEL_DATA_LEN;
+	}
+	if (sensor->cfg.gyro_fifo_enable) {
+		fifo_en |= BITS_GYRO_OUT;
+		sensor->fifo_frame_size += MPU6050_RAW_GYRO_DATA_LEN;
+	}
+
+	if (!fifo_en)
+		return i2c_smbus_write_byte_data(sensor->client,
+				reg->user_ctrl, 0);
+
+	ret = i2c_smbus_write_byte_data(sensor->client, reg->user_ctrl,
+			BIT_FIFO_EN);
+	if (ret < 0)
+		return ret;
+
+	return i2c_smbus_write_byte_data(sensor->client, reg->fifo_en,
+			fifo_en);
+}
+
+/**
+ * mpu6050_fifo_period_ms - time to sleep between two FIFO drains
+ * @sensor: sensor device instance
+ *
+ * Honour the requested latency but wake up early enough that the
+ * FIFO never overflows, keeping a quarter of it as headroom.
+ */
+static u32 mpu6050_fifo_period_ms(struct mpu6050_sensor *sensor)
+{
+	u32 size = (sensor->chip_type == INV_MPU6500) ?
+			MPU6500_FIFO_SIZE : MPU6050_FIFO_SIZE;
+	u32 full_ms;
+
+	if (!sensor->fifo_frame_size || !sensor->cfg.fifo_rate)
+		return sensor->batch_ms;
+
+	full_ms = (size / sensor->fifo_frame_size) * MSEC_PER_SEC /
+			sensor->cfg.fifo_rate;
+
+	return max_t(u32, min(sensor->batch_ms, full_ms * 3 / 4), 1);
+}
+
+/**
+ * mpu6050_fifo_drain - report every sample stored in the FIFO
+ * @sensor: sensor device instance
+ *
+ * Empties the FIFO in bursts of MPU6050_FIFO_CHUNK_FRAMES frames. The
+ * chip does not timestamp samples, so they are spread back from the
+ * time of the drain at the configured output rate and reported with
+ * MSC_TIMESTAMP in microseconds of the monotonic clock.
+ */
+static void mpu6050_fifo_drain(struct mpu6050_sensor *sensor)
+{
+	u8 buffer[MPU6050_FIFO_CHUNK_FRAMES * (MPU6050_RAW_ACCEL_DATA_LEN +
+			MPU6050_RAW_GYRO_DATA_LEN)];
+	u8 frame = sensor->fifo_frame_size;
+	u16 count;
+	u32 frames, chunk, i;
+	u8 *p;
+	s64 period_ns;
+	ktime_t ts;
+	int ret;
+
+	if (!frame)
+		return;
+
+	ret = mpu6050_read_reg(sensor->client, sensor->reg.fifo_count_h,
+			buffer, 2);
+	if (ret < 0)
+		return;
+
+	ts = ktime_get();
+	count = (buffer[0] << 8) | buffer[1];
+	if (count >= ((sensor->chip_type == INV_MPU6500) ?
+			MPU6500_FIFO_SIZE : MPU6050_FIFO_SIZE)) {
+		dev_warn(&sensor->client->dev, "FIFO overflow, resetting\n");
+		mpu6050_fifo_config(sensor, true);
+		return;
+	}
+
+	frames = count / frame;
+	period_ns = NSEC_PER_SEC / sensor->cfg.fifo_rate;
+	/* timestamp of the oldest sample in the FIFO */
+	ts = ktime_sub_ns(ts, frames ? (frames - 1) * period_ns : 0);
+
+	while (frames) {
+		chunk = min_t(u32, frames, MPU6050_FIFO_CHUNK_FRAMES);
+		ret = mpu6050_read_reg(sensor->client, sensor->reg.fifo_r_w,
+				buffer, chunk * frame);
+		if (ret < 0)
+			return;
+
+		for (i = 0, p = buffer; i < chunk; i++, p += frame) {
+			u32 us = (u32)ktime_to_us(ts);
+			u8 *q = p;
+
+			if (sensor->cfg.accel_fifo_enable) {
+				sensor->axis.x = (s16)((q[0] << 8) | q[1]);
+				sensor->axis.y = (s16)((q[2] << 8) | q[3]);
+				sensor->axis.z = (s16)((q[4] << 8) | q[5]);
+				input_report_abs(sensor->accel_dev, ABS_X,
+						sensor->axis.x);
+				input_report_abs(sensor->accel_dev, ABS_Y,
+						sensor->axis.y);
+				input_report_abs(sensor->accel_dev, ABS_Z,
+						sensor->axis.z);
+				input_event(sensor->accel_dev, EV_MSC,
+						MSC_TIMESTAMP, us);
+				input_sync(sensor->accel_dev);
+				q += MPU6050_RAW_ACCEL_DATA_LEN;
+			}
+
+			if (sensor->cfg.gyro_fifo_enable) {
+				sensor->axis.rx = (s16)((q[0] << 8) | q[1]);
+				sensor->axis.ry = (s16)((q[2] << 8) | q[3]);
+				sensor->axis.rz = (s16)((q[4] << 8) | q[5]);
+				input_report_abs(sensor->gyro_dev, ABS_RX,
+						sensor->axis.rx);
+				input_report_abs(sensor->gyro_dev, ABS_RY,
+						sensor->axis.ry);
+				input_report_abs(sensor->gyro_dev, ABS_RZ,
+						sensor->axis.rz);
+				input_event(sensor->gyro_dev, EV_MSC,
+						MSC_TIMESTAMP, us);
+				input_sync(sensor->gyro_dev);
+			}
+
+			ts = ktime_add_ns(ts, period_ns);
+		}
+		frames -= chunk;
+	}
+}
+
+/**
+ * mpu6050_fifo_work_fn - batching mode FIFO drain
+ * @work: the work struct
+ *
+ * Called by the work queue once per batching period; report the whole
+ * FIFO content and go back to sleep.
+ */
+static void mpu6050_fifo_work_fn(struct work_struct *work)
+{
+	struct mpu6050_sensor *sensor;
+
+	sensor = container_of((struct delayed_work *)work,
+				struct mpu6050_sensor, fifo_work);
+
+	mpu6050_fifo_drain(sensor);
+
+	if (sensor->batch_ms)
+		schedule_delayed_work(&sensor->fifo_work,
+			msecs_to_jiffies(mpu6050_fifo_period_ms(sensor)));
+}
+
+/**
+ * mpu6050_batch_update - apply the engine state to the batching FIFO
+ * @sensor: sensor device instance
+ *
+ * Flushes what was batched under the previous configuration, then
+ * restarts the FIFO for the engines that are currently enabled.
+ */
+static void mpu6050_batch_update(struct mpu6050_sensor *sensor)
+{
+	cancel_delayed_work_sync(&sensor->fifo_work);
+	mpu6050_fifo_drain(sensor);
+
+	if (mpu6050_fifo_config(sensor, sensor->batch_ms != 0) < 0) {
+		dev_err(&sensor->client->dev, "Fail to configure FIFO\n");
+		return;
+	}
+
+	if (sensor->batch_ms && sensor->fifo_frame_size)
+		schedule_delayed_work(&sensor->fifo_work,
+			msecs_to_jiffies(mpu6050_fifo_period_ms(sensor)));
+}
+
 /**
  *  mpu6050_set_lpa_freq() - set low power wakeup frequency.
  */
@@ -632,16 +868,22 @@ static ssize_t mpu6050_gyro_attr_set_enable(struct device *dev,
 
 	if (kstrtoul(buf, 10, &enable))
 		return -EINVAL;
+	if (sensor->cfg.lpa_mode)
+		return -EBUSY;
 	if (enable != 0) {
 		mpu6050_gyro_enable(sensor, true);
-		if (sensor->use_poll)
+		if (sensor->batch_ms)
+			mpu6050_batch_update(sensor);
+		else if (sensor->use_poll)
 			schedule_delayed_work(&sensor->gyro_poll_work,
 				msecs_to_jiffies(sensor->gyro_poll_ms));
 		else
 			enable_irq(sensor->client->irq);
 	} else {
 		mpu6050_gyro_enable(sensor, false);
-		if (sensor->use_poll)
+		if (sensor->batch_ms)
+			mpu6050_batch_update(sensor);
+		else if (sensor->use_poll)
 			cancel_delayed_work_sync(&sensor->gyro_poll_work);
 		else
 			disable_irq(sensor->client->irq);
@@ -656,6 +898,9 @@ static struct device_attribute gyro_attr[] = {
 	__ATTR(enable, S_IRUGO | S_IWUSR,
 		mpu6050_gyro_attr_get_enable,
 		mpu6050_gyro_attr_set_enable),
+	__ATTR(batch, S_IRUGO | S_IWUSR,
+		mpu6050_attr_get_batch,
+		mpu6050_attr_set_batch),
 };
 
 static int create_gyro_sysfs_interfaces(struct device *dev)
@@ -805,16 +1050,22 @@ static ssize_t mpu6050_accel_attr_set_enable(struct device *dev,
 
 	if (kstrtoul(buf, 10, &enable))
 		return -EINVAL;
+	if (sensor->cfg.lpa_mode)
+		return -EBUSY;
 	if (enable != 0) {
 		mpu6050_accel_enable(sensor, true);
-		if (sensor->use_poll)
+		if (sensor->batch_ms)
+			mpu6050_batch_update(sensor);
+		else if (sensor->use_poll)
 			schedule_delayed_work(&sensor->accel_poll_work,
 				msecs_to_jiffies(sensor->accel_poll_ms));
 		else
 			enable_irq(sensor->client->irq);
 	} else {
 		mpu6050_accel_enable(sensor, false);
-		if (sensor->use_poll)
+		if (sensor->batch_ms)
+			mpu6050_batch_update(sensor);
+		else if (sensor->use_poll)
 			cancel_delayed_work_sync(&sensor->accel_poll_work);
 		else
 			disable_irq(sensor->client->irq);
@@ -822,6 +1073,263 @@ static ssize_t mpu6050_accel_attr_set_enable(struct device *dev,
 	return count;
 }
 
+/**
+ * mpu6050_continuous_reporting - start or stop the per sample reporting
+ * @sensor: sensor device instance
+ * @on: true to (re)start the poll works or irq of the enabled engines
+ *
+ * The irq is enabled once per enabled engine by the enable attributes,
+ * so it is balanced the same way here.
+ */
+static void mpu6050_continuous_reporting(struct mpu6050_sensor *sensor,
+					bool on)
+{
+	if (sensor->cfg.accel_enable) {
+		if (sensor->use_poll && on)
+			schedule_delayed_work(&sensor->accel_poll_work,
+				msecs_to_jiffies(sensor->accel_poll_ms));
+		else if (sensor->use_poll)
+			cancel_delayed_work_sync(&sensor->accel_poll_work);
+		else if (on)
+			enable_irq(sensor->client->irq);
+		else
+			disable_irq(sensor->client->irq);
+	}
+
+	if (sensor->cfg.gyro_enable) {
+		if (sensor->use_poll && on)
+			schedule_delayed_work(&sensor->gyro_poll_work,
+				msecs_to_jiffies(sensor->gyro_poll_ms));
+		else if (sensor->use_poll)
+			cancel_delayed_work_sync(&sensor->gyro_poll_work);
+		else if (on)
+			enable_irq(sensor->client->irq);
+		else
+			disable_irq(sensor->client->irq);
+	}
+}
+
+/**
+ * mpu6050_attr_get_batch - get the maximum report latency
+ */
+static ssize_t mpu6050_attr_get_batch(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct mpu6050_sensor *sensor = dev_get_drvdata(dev);
+
+	return snprintf(buf, 8, "%u\n", sensor->batch_ms);
+}
+
+/**
+ * mpu6050_attr_set_batch - set the maximum report latency
+ *
+ * A non zero value in milliseconds lets accel and gyro samples pile up
+ * in the hardware FIFO and be reported in one burst, 0 goes back to
+ * reporting every sample as it is produced.
+ */
+static ssize_t mpu6050_attr_set_batch(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	struct mpu6050_sensor *sensor = dev_get_drvdata(dev);
+	unsigned long batch_ms;
+
+	if (kstrtoul(buf, 10, &batch_ms))
+		return -EINVAL;
+	if (batch_ms > MPU6050_MAX_BATCH_MS)
+		return -EINVAL;
+
+	if (batch_ms == sensor->batch_ms)
+		return count;
+
+	if (!sensor->batch_ms)
+		mpu6050_continuous_reporting(sensor, false);
+
+	sensor->batch_ms = batch_ms;
+	mpu6050_batch_update(sensor);
+
+	if (!sensor->batch_ms)
+		mpu6050_continuous_reporting(sensor, true);
+
+	return count;
+}
+
+/**
+ * mpu6050_motion_enable - enter or leave low power motion mode
+ * @sensor: sensor device instance
+ * @on: true to cycle the accel engine and raise motion interrupts
+ *
+ * In motion mode the gyro is in standby and the accel engine wakes up
+ * at the low power rate only to compare against the motion threshold,
+ * so the chip draws a few uA until the device is actually moved.
+ */
+static int mpu6050_motion_enable(struct mpu6050_sensor *sensor, bool on)
+{
+	struct i2c_client *client = sensor->client;
+	struct mpu_reg_map *reg = &sensor->reg;
+	int ret;
+	u8 data;
+
+	ret = i2c_smbus_read_byte_data(client, reg->accel_config);
+	if (ret < 0)
+		return ret;
+	data = (u8)ret & ~BITS_ACCEL_HPF_MASK;
+	if (on && (sensor->chip_type == INV_MPU6050))
+		data |= ACCEL_HPF_5HZ;
+	ret = i2c_smbus_write_byte_data(client, reg->accel_config, data);
+	if (ret < 0)
+		return ret;
+
+	if (on) {
+		ret = i2c_smbus_read_byte_data(client, reg->int_enable);
+		if (ret < 0)
+			return ret;
+		sensor->int_enable = (u8)ret;
+
+		ret = i2c_smbus_write_byte_data(client, REG_ACCEL_MOT_THR,
+				sensor->motion_thr);
+		if (ret < 0)
+			return ret;
+
+		if (sensor->chip_type == INV_MPU6500) {
+			ret = i2c_smbus_write_byte_data(client,
+					REG_6500_ACCEL_INTEL_CTRL,
+					BITS_6500_ACCEL_INTEL_EN);
+			if (ret < 0)
+				return ret;
+			ret = i2c_smbus_write_byte_data(client,
+					REG_6500_LP_ACCEL_ODR,
+					MPU6500_LPA_7_81HZ);
+		} else {
+			ret = i2c_smbus_write_byte_data(client,
+					REG_ACCEL_MOT_DUR, MPU6050_MOTION_DUR);
+			if (ret < 0)
+				return ret;
+			ret = mpu6050_set_lpa_freq(sensor, MPU6050_LPA_5HZ);
+		}
+		if (ret < 0)
+			return ret;
+
+		ret = mpu6050_switch_engine(sensor, true,
+				BIT_PWR_ACCEL_STBY_MASK);
+		if (ret)
+			return ret;
+
+		ret = i2c_smbus_write_byte_data(client, reg->int_enable,
+				(sensor->chip_type == INV_MPU6500) ?
+				BIT_6500_WOM_EN : BIT_MOT_EN);
+		if (ret < 0)
+			return ret;
+
+		ret = i2c_smbus_read_byte_data(client, reg->pwr_mgmt_1);
+		if (ret < 0)
+			return ret;
+		data = ((u8)ret & ~(BIT_SLEEP | BIT_CLK_MASK)) | BIT_CYCLE;
+		ret = i2c_smbus_write_byte_data(client, reg->pwr_mgmt_1, data);
+		if (ret < 0)
+			return ret;
+
+		sensor->cfg.lpa_mode = 1;
+		sensor->cfg.enable = 1;
+	} else {
+		ret = i2c_smbus_read_byte_data(client, reg->pwr_mgmt_1);
+		if (ret < 0)
+			return ret;
+		data = ((u8)ret & ~BIT_CYCLE) | BIT_SLEEP;
+		ret = i2c_smbus_write_byte_data(client, reg->pwr_mgmt_1, data);
+		if (ret < 0)
+			return ret;
+
+		ret = i2c_smbus_write_byte_data(client, reg->int_enable,
+				sensor->int_enable);
+		if (ret < 0)
+			return ret;
+
+		if (sensor->chip_type == INV_MPU6500) {
+			ret = i2c_smbus_write_byte_data(client,
+					REG_6500_ACCEL_INTEL_CTRL, 0);
+			if (ret < 0)
+				return ret;
+		}
+
+		ret = mpu6050_switch_engine(sensor, false,
+				BIT_PWR_ACCEL_STBY_MASK);
+		if (ret)
+			return ret;
+
+		sensor->cfg.lpa_mode = 0;
+		sensor->cfg.enable = 0;
+	}
+
+	return 0;
+}
+
+/**
+ * mpu6050_attr_get_motion - get the low power motion threshold
+ */
+static ssize_t mpu6050_attr_get_motion(struct device *dev,
+			struct device_attribute *attr, char *buf)
+{
+	struct mpu6050_sensor *sensor = dev_get_drvdata(dev);
+
+	return snprintf(buf, 8, "%d\n",
+			sensor->cfg.lpa_mode ? sensor->motion_thr : 0);
+}
+
+/**
+ * mpu6050_attr_set_motion - enter or leave low power motion mode
+ *
+ * A non zero value is the motion threshold in units of the chip's
+ * motion threshold register and arms the motion interrupt as a wakeup
+ * source, 0 leaves motion mode. Motion mode needs the interrupt line
+ * and excludes the accel and gyro streams.
+ */
+static ssize_t mpu6050_attr_set_motion(struct device *dev,
+			struct device_attribute *attr,
+			const char *buf, size_t count)
+{
+	struct mpu6050_sensor *sensor = dev_get_drvdata(dev);
+	unsigned long thr;
+	int ret;
+
+	if (kstrtoul(buf, 10, &thr))
+		return -EINVAL;
+	if (thr > 255)
+		return -EINVAL;
+	if (sensor->use_poll)
+		return -ENODEV;
+
+	if (!thr) {
+		if (!sensor->cfg.lpa_mode)
+			return count;
+		disable_irq(sensor->client->irq);
+		ret = mpu6050_motion_enable(sensor, false);
+		return ret < 0 ? ret : count;
+	}
+
+	if (sensor->cfg.accel_enable || sensor->cfg.gyro_enable)
+		return -EBUSY;
+
+	if (sensor->cfg.lpa_mode) {
+		if (thr == sensor->motion_thr)
+			return count;
+		sensor->motion_thr = thr;
+		ret = i2c_smbus_write_byte_data(sensor->client,
+				REG_ACCEL_MOT_THR, sensor->motion_thr);
+		return ret < 0 ? ret : count;
+	}
+
+	sensor->motion_thr = thr;
+	ret = mpu6050_motion_enable(sensor, true);
+	if (ret < 0) {
+		dev_err(dev, "Fail to enter motion mode ret=%d\n", ret);
+		return ret;
+	}
+	enable_irq(sensor->client->irq);
+
+	return count;
+}
+
 #ifdef DEBUG_NODE
 u8 mpu6050_address;
 u8 mpu6050_data;
@@ -904,6 +1412,12 @@ static struct device_attribute accel_attr[] = {
 	__ATTR(enable, S_IRUGO | S_IWUSR,
 		mpu6050_accel_attr_get_enable,
 		mpu6050_accel_attr_set_enable),
+	__ATTR(batch, S_IRUGO | S_IWUSR,
+		mpu6050_attr_get_batch,
+		mpu6050_attr_set_batch),
+	__ATTR(motion, S_IRUGO | S_IWUSR,
+		mpu6050_attr_get_motion,
+		mpu6050_attr_set_motion),
 #ifdef DEBUG_NODE
 	__ATTR(addr, S_IRUSR | S_IWUSR,
 		mpu6050_accel_attr_get_reg_addr,
@@ -947,6 +1461,7 @@ static void setup_mpu6050_reg(struct mpu_reg_map *reg)
 {
 	reg->sample_rate_div	= REG_SAMPLE_RATE_DIV;
 	reg->lpf		= REG_CONFIG;
+	reg->user_ctrl		= REG_USER_CTRL;
 	reg->fifo_en		= REG_FIFO_EN;
 	reg->gyro_config	= REG_GYRO_CONFIG;
 	reg->accel_config	= REG_ACCEL_CONFIG;
@@ -1237,6 +1752,9 @@ static int mpu6050_probe(struct i2c_client *client,
 
 	input_set_capability(sensor->accel_dev, EV_ABS, ABS_MISC);
 	input_set_capability(sensor->gyro_dev, EV_ABS, ABS_MISC);
+	input_set_capability(sensor->accel_dev, EV_MSC, MSC_TIMESTAMP);
+	input_set_capability(sensor->gyro_dev, EV_MSC, MSC_TIMESTAMP);
+	input_set_capability(sensor->accel_dev, EV_MSC, MSC_GESTURE);
 	input_set_abs_params(sensor->accel_dev, ABS_X,
 			MPU6050_ACCEL_MIN_VALUE, MPU6050_ACCEL_MAX_VALUE,
 			0, 0);
@@ -1259,6 +1777,7 @@ static int mpu6050_probe(struct i2c_client *client,
 	sensor->gyro_dev->dev.parent = &client->dev;
 	input_set_drvdata(sensor->accel_dev, sensor);
 	input_set_drvdata(sensor->gyro_dev, sensor);
+	INIT_DELAYED_WORK(&sensor->fifo_work, mpu6050_fifo_work_fn);
 
 	if ((sensor->pdata->use_int) &&
 		gpio_is_valid(sensor->pdata->gpio_int)) {
@@ -1295,6 +1814,7 @@ static int mpu6050_probe(struct i2c_client *client,
 			goto err_free_gpio;
 		}
 		disable_irq(client->irq);
+		device_init_wakeup(&client->dev, 1);
 	} else {
 		sensor->use_poll = 1;
 		INIT_DELAYED_WORK(&sensor->accel_poll_work,
@@ -1369,6 +1889,7 @@ static int mpu6050_remove(struct i2c_client *client)
 {
 
 	struct mpu6050_sensor *sensor = i2c_get_clientdata(client);
+	cancel_delayed_work_sync(&sensor->fifo_work);
 	remove_gyro_sysfs_interfaces(&sensor->gyro_dev->dev);
 	remove_accel_sysfs_interfaces(&sensor->accel_dev->dev);
 	input_unregister_device(sensor->gyro_dev);
@@ -1401,9 +1922,21 @@ static int mpu6050_suspend(struct device *dev)
 	struct i2c_client *client = to_i2c_client(dev);
 	struct mpu6050_sensor *sensor = i2c_get_clientdata(client);
 
+	/* keep cycling and let motion wake the system up */
+	if (sensor->cfg.lpa_mode) {
+		if (device_may_wakeup(dev))
+			enable_irq_wake(client->irq);
+		return 0;
+	}
+
 	if (!sensor->use_poll)
 		disable_irq(client->irq);
 
+	if (sensor->batch_ms) {
+		cancel_delayed_work_sync(&sensor->fifo_work);
+		mpu6050_fifo_drain(sensor);
+	}
+
 	mpu6050_set_power_mode(sensor, false);
 
 	return 0;
@@ -1420,8 +1953,17 @@ static int mpu6050_resume(struct device *dev)
 	struct i2c_client *client = to_i2c_client(dev);
 	struct mpu6050_sensor *sensor = i2c_get_clientdata(client);
 
+	if (sensor->cfg.lpa_mode) {
+		if (device_may_wakeup(dev))
+			disable_irq_wake(client->irq);
+		return 0;
+	}
+
 	mpu6050_set_power_mode(sensor, true);
 
+	if (sensor->batch_ms)
+		mpu6050_batch_update(sensor);
+
 	if (!sensor->use_poll)
 		enable_irq(client->irq);
 
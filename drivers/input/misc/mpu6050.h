@@ -24,9 +24,12 @@
 #define GYRO_CONFIG_FSR_SHIFT	3
 
 #define REG_ACCEL_CONFIG	0x1C
+#define REG_6500_LP_ACCEL_ODR	0x1E
 #define REG_ACCEL_MOT_THR	0x1F
 #define REG_ACCEL_MOT_DUR	0x20
 #define ACCL_CONFIG_FSR_SHIFT	3
+#define BITS_ACCEL_HPF_MASK	0x07
+#define ACCEL_HPF_5HZ		0x01
 
 #define REG_FIFO_EN		0x23
 #define BIT_ACCEL_OUT		0x08
@@ -50,6 +53,10 @@
 #define REG_RAW_GYRO		0x43
 #define REG_EXT_SENS_DATA_00	0x49
 
+#define REG_6500_ACCEL_INTEL_CTRL	0x69
+#define BITS_6500_ACCEL_INTEL_EN	0xC0
+
+#define REG_USER_CTRL		0x6A
 #define BIT_FIFO_RST		0x04
 #define BIT_DMP_RST		0x08
 #define BIT_I2C_MST_EN		0x20
@@ -71,6 +78,9 @@
 #define REG_FIFO_R_W		0x74
 #define REG_WHOAMI		0x75
 
+#define MPU6050_FIFO_SIZE	1024
+#define MPU6500_FIFO_SIZE	512
+
 #define ODR_DLPF_DIS		8000
 #define ODR_DLPF_ENA		1000
 
@@ -82,6 +92,7 @@
 #define POWER_EN_DELAY_US	10
 
 #define MPU6050_LPA_5HZ		0x40
+#define MPU6500_LPA_7_81HZ	0x05
 
 /* initial configure*/
 #define INIT_FIFO_RATE		50
@@ -137,6 +148,7 @@ enum inv_devices {
  *  struct mpu_reg_map_s - Notable slave registers.
  *  @sample_rate_div:	Divider applied to gyro output rate.
  *  @lpf:		Configures internal LPF.
+ *  @user_ctrl:		Enables and resets the FIFO.
  *  @fifo_en:		Determines which data will appear in FIFO.
  *  @gyro_config:	gyro config register.
  *  @accel_config:	accel config register
@@ -21,6 +21,7 @@
 #include <linux/slab.h>
 #include <linux/interrupt.h>
 #include <linux/delay.h>
+#include <linux/sched.h>
 #include <linux/input.h>
 #include <linux/gpio.h>
 #include <linux/platform_device.h>
@@ -62,6 +63,8 @@
 
 #define CHECK_STATUS_TIMEOUT_MS 100
 
+#define IRQ_THREAD_RT_PRIO (MAX_USER_RT_PRIO / 2 + 1)
+
 #define F01_STD_QUERY_LEN 21
 #define F01_BUID_ID_OFFSET 18
 #define F11_STD_QUERY_LEN 9
@@ -85,6 +88,11 @@
 static int synaptics_rmi4_f12_set_enables(struct synaptics_rmi4_data *rmi4_data,
 		unsigned short ctrl28);
 
+static int synaptics_rmi4_f12_report_fingers(
+		struct synaptics_rmi4_data *rmi4_data,
+		struct synaptics_rmi4_fn *fhandler,
+		unsigned char fingers_to_process);
+
 static int synaptics_rmi4_free_fingers(struct synaptics_rmi4_data *rmi4_data);
 static int synaptics_rmi4_reinit_device(struct synaptics_rmi4_data *rmi4_data);
 static int synaptics_rmi4_reset_device(struct synaptics_rmi4_data *rmi4_data);
@@ -126,6 +134,12 @@ static ssize_t synaptics_rmi4_0dbutton_store(struct device *dev,
 static ssize_t synaptics_rmi4_suspend_store(struct device *dev,
 		struct device_attribute *attr, const char *buf, size_t count);
 
+static ssize_t synaptics_rmi4_irq_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf);
+
+static ssize_t synaptics_rmi4_irq_stats_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count);
+
 struct synaptics_rmi4_f01_device_status {
 	union {
 		struct {
@@ -356,6 +370,9 @@ static struct device_attribute attrs[] = {
 	__ATTR(suspend, S_IWUGO,
 			synaptics_rmi4_show_error,
 			synaptics_rmi4_suspend_store),
+	__ATTR(irq_stats, (S_IRUGO | S_IWUGO),
+			synaptics_rmi4_irq_stats_show,
+			synaptics_rmi4_irq_stats_store),
 };
 
 
@@ -531,6 +548,35 @@ static ssize_t synaptics_rmi4_suspend_store(struct device *dev,
 	return count;
 }
 
+static ssize_t synaptics_rmi4_irq_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct synaptics_rmi4_data *rmi4_data = dev_get_drvdata(dev);
+	unsigned int count = rmi4_data->irq_count;
+	u64 avg = 0;
+
+	if (count)
+		avg = div_u64(rmi4_data->irq_lat_total_us, count);
+
+	return snprintf(buf, PAGE_SIZE,
+			"irqs=%u batched=%u avg_us=%llu max_us=%u\n",
+			count, rmi4_data->irq_batched, avg,
+			rmi4_data->irq_lat_max_us);
+}
+
+static ssize_t synaptics_rmi4_irq_stats_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct synaptics_rmi4_data *rmi4_data = dev_get_drvdata(dev);
+
+	rmi4_data->irq_count = 0;
+	rmi4_data->irq_batched = 0;
+	rmi4_data->irq_lat_total_us = 0;
+	rmi4_data->irq_lat_max_us = 0;
+
+	return count;
+}
+
  /**
  * synaptics_rmi4_f11_abs_report()
  *
@@ -694,29 +740,27 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 		struct synaptics_rmi4_fn *fhandler)
 {
 	int retval;
-	unsigned char touch_count = 0; /* number of touch points */
 	unsigned char finger;
 	unsigned char fingers_to_process;
-	unsigned char finger_status;
 	unsigned char size_of_2d_data;
 	unsigned short data_addr;
-	int x;
-	int y;
-	int wx;
-	int wy;
 	int temp;
 	struct synaptics_rmi4_f12_extra_data *extra_data;
-	struct synaptics_rmi4_f12_finger_data *data;
-	struct synaptics_rmi4_f12_finger_data *finger_data;
-#ifdef F12_DATA_15_WORKAROUND
-	static unsigned char fingers_already_present;
-#endif
 
 	fingers_to_process = fhandler->num_of_data_points;
 	data_addr = fhandler->full_addr.data_base;
 	extra_data = (struct synaptics_rmi4_f12_extra_data *)fhandler->extra;
 	size_of_2d_data = sizeof(struct synaptics_rmi4_f12_finger_data);
 
+	/*
+	 * The finger data of every slot already came in with the
+	 * attention block read, so there is nothing left to fetch.
+	 */
+	if (extra_data->prefetched) {
+		extra_data->prefetched = false;
+		return synaptics_rmi4_f12_report_fingers(rmi4_data, fhandler,
+				fingers_to_process);
+	}
 
 	/* Determine the total number of fingers to process */
 	if (extra_data->data15_size) {
@@ -750,7 +794,8 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 	}
 
 #ifdef F12_DATA_15_WORKAROUND
-	fingers_to_process = max(fingers_to_process, fingers_already_present);
+	fingers_to_process = max(fingers_to_process,
+			extra_data->fingers_already_present);
 #endif
 
 	if (!fingers_to_process) {
@@ -765,6 +810,39 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 	if (retval < 0)
 		return 0;
 
+	input_latency_data(rmi4_data->input_dev);
+
+	return synaptics_rmi4_f12_report_fingers(rmi4_data, fhandler,
+			fingers_to_process);
+}
+
+ /**
+ * synaptics_rmi4_f12_report_fingers()
+ *
+ * Called by synaptics_rmi4_f12_abs_report().
+ *
+ * This function walks the Function $12 finger data already held in
+ * the function handler, reports it to the input subsystem, and
+ * returns the number of fingers detected.
+ */
+static int synaptics_rmi4_f12_report_fingers(
+		struct synaptics_rmi4_data *rmi4_data,
+		struct synaptics_rmi4_fn *fhandler,
+		unsigned char fingers_to_process)
+{
+	unsigned char touch_count = 0; /* number of touch points */
+	unsigned char finger;
+	unsigned char finger_status;
+	int x;
+	int y;
+	int wx;
+	int wy;
+	int temp;
+	struct synaptics_rmi4_f12_extra_data *extra_data;
+	struct synaptics_rmi4_f12_finger_data *data;
+	struct synaptics_rmi4_f12_finger_data *finger_data;
+
+	extra_data = (struct synaptics_rmi4_f12_extra_data *)fhandler->extra;
 	data = (struct synaptics_rmi4_f12_finger_data *)fhandler->data;
 
 	for (finger = 0; finger < fingers_to_process; finger++) {
@@ -779,7 +857,7 @@ static int synaptics_rmi4_f12_abs_report(struct synaptics_rmi4_data *rmi4_data,
 #endif
 
 #ifdef F12_DATA_15_WORKAROUND
-			fingers_already_present = finger + 1;
+			extra_data->fingers_already_present = finger + 1;
 #endif
 
 			x = (finger_data->x_msb << 8) | (finger_data->x_lsb);
@@ -1016,15 +1094,31 @@ static void synaptics_rmi4_report_touch(struct synaptics_rmi4_data *rmi4_data,
 static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 {
 	int retval;
-	unsigned char data[MAX_INTR_REGISTERS + 1];
-	unsigned char *intr = &data[1];
+	unsigned char status_data[MAX_INTR_REGISTERS + 1];
+	unsigned char *data = status_data;
+	unsigned char *intr;
+	unsigned short len = rmi4_data->num_of_intr_regs + 1;
 	struct synaptics_rmi4_f01_device_status status;
 	struct synaptics_rmi4_fn *fhandler;
+	struct synaptics_rmi4_fn *attn_f12 = rmi4_data->attn_f12;
+	struct synaptics_rmi4_f12_extra_data *extra_data;
 	struct synaptics_rmi4_exp_fhandler *exp_fhandler;
 	struct synaptics_rmi4_device_info *rmi;
 
 	rmi = &(rmi4_data->rmi4_mod_info);
 
+	/*
+	 * When the F12 finger data sits right behind the F01 interrupt
+	 * status, fetch all of it in the same transaction.
+	 */
+	if (attn_f12) {
+		data = rmi4_data->attn_data;
+		len = rmi4_data->attn_data_len;
+	}
+	intr = &data[1];
+
+	input_latency_irq(rmi4_data->input_dev, rmi4_data->irq_time);
+
 	/*
 	 * Get interrupt status information from F01 Data1 register to
 	 * determine the source(s) that are flagging the interrupt.
@@ -1032,7 +1126,7 @@ static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 	retval = synaptics_rmi4_reg_read(rmi4_data,
 			rmi4_data->f01_data_base_addr,
 			data,
-			rmi4_data->num_of_intr_regs + 1);
+			len);
 	if (retval < 0) {
 		dev_err(rmi4_data->pdev->dev.parent,
 				"%s: Failed to read interrupt status\n",
@@ -1040,6 +1134,9 @@ static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 		return;
 	}
 
+	if (attn_f12)
+		input_latency_data(rmi4_data->input_dev);
+
 	status.data[0] = data[0];
 	if (status.unconfigured && !status.flash_prog) {
 		pr_notice("%s: spontaneous reset detected\n", __func__);
@@ -1052,6 +1149,15 @@ static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 		return;
 	}
 
+	if (attn_f12 && (attn_f12->intr_mask & intr[attn_f12->intr_reg_num])) {
+		extra_data = (struct synaptics_rmi4_f12_extra_data *)
+				attn_f12->extra;
+		memcpy(attn_f12->data, data + rmi4_data->attn_f12_offset,
+				attn_f12->data_size);
+		extra_data->prefetched = true;
+		rmi4_data->irq_batched++;
+	}
+
 	/*
 	 * Traverse the function handler list and service the source(s)
 	 * of the interrupt accordingly.
@@ -1095,13 +1201,49 @@ static void synaptics_rmi4_sensor_report(struct synaptics_rmi4_data *rmi4_data)
 static irqreturn_t synaptics_rmi4_irq(int irq, void *data)
 {
 	struct synaptics_rmi4_data *rmi4_data = data;
+	struct sched_param param = { .sched_priority = IRQ_THREAD_RT_PRIO };
+	unsigned int latency;
 
-	if (!rmi4_data->touch_stopped)
-		synaptics_rmi4_sensor_report(rmi4_data);
+	/*
+	 * Run ahead of the other irq threads so that touch reports are
+	 * not held up behind less latency sensitive work.
+	 */
+	if (!rmi4_data->irq_thread_boosted) {
+		sched_setscheduler(current, SCHED_FIFO, &param);
+		rmi4_data->irq_thread_boosted = true;
+	}
+
+	if (rmi4_data->touch_stopped)
+		return IRQ_HANDLED;
+
+	synaptics_rmi4_sensor_report(rmi4_data);
+
+	latency = ktime_us_delta(ktime_get(), rmi4_data->irq_time);
+	rmi4_data->irq_count++;
+	rmi4_data->irq_lat_total_us += latency;
+	if (latency > rmi4_data->irq_lat_max_us)
+		rmi4_data->irq_lat_max_us = latency;
 
 	return IRQ_HANDLED;
 }
 
+ /**
+ * synaptics_rmi4_hardirq()
+ *
+ * Called by the kernel when the sensor asserts the attention irq.
+ *
+ * This function timestamps the interrupt for the latency statistics
+ * and wakes up the ISR thread.
+ */
+static irqreturn_t synaptics_rmi4_hardirq(int irq, void *data)
+{
+	struct synaptics_rmi4_data *rmi4_data = data;
+
+	rmi4_data->irq_time = ktime_get();
+
+	return IRQ_WAKE_THREAD;
+}
+
  /**
  * synaptics_rmi4_irq_enable()
  *
@@ -1132,8 +1274,10 @@ static int synaptics_rmi4_irq_enable(struct synaptics_rmi4_data *rmi4_data,
 		if (retval < 0)
 			return retval;
 
-		retval = request_threaded_irq(rmi4_data->irq, NULL,
-				synaptics_rmi4_irq, bdata->irq_flags,
+		rmi4_data->irq_thread_boosted = false;
+		retval = request_threaded_irq(rmi4_data->irq,
+				synaptics_rmi4_hardirq, synaptics_rmi4_irq,
+				bdata->irq_flags | IRQF_ONESHOT,
 				PLATFORM_DRIVER_NAME, rmi4_data);
 		if (retval < 0) {
 			dev_err(rmi4_data->pdev->dev.parent,
@@ -1392,6 +1536,8 @@ static int synaptics_rmi4_f12_init(struct synaptics_rmi4_data *rmi4_data,
 
 	/* Determine the presence of the Data0 register */
 	extra_data->data1_offset = query_8.data0_is_present;
+	extra_data->fingers_already_present = 0;
+	extra_data->prefetched = false;
 
 	if ((size_of_query8 >= 3) && (query_8.data15_is_present)) {
 		extra_data->data15_offset = query_8.data0_is_present +
@@ -1629,6 +1775,8 @@ static void synaptics_rmi4_empty_fn_list(struct synaptics_rmi4_data *rmi4_data)
 
 	rmi = &(rmi4_data->rmi4_mod_info);
 
+	rmi4_data->attn_f12 = NULL;
+
 	if (!list_empty(&rmi->support_fn_list)) {
 		list_for_each_entry_safe(fhandler,
 				fhandler_temp,
@@ -1749,6 +1897,77 @@ static void synaptics_rmi4_set_configured(struct synaptics_rmi4_data *rmi4_data)
 	return;
 }
 
+/**
+ * synaptics_rmi4_attn_layout()
+ *
+ * Called by synaptics_rmi4_query_device().
+ *
+ * This function works out whether the Function $12 finger data can be
+ * fetched together with the F01 device and interrupt status in one
+ * block read, and if so records where it lands in the read buffer.
+ */
+static void synaptics_rmi4_attn_layout(struct synaptics_rmi4_data *rmi4_data)
+{
+	unsigned short intr_end;
+	unsigned short data1_addr;
+	unsigned short len;
+	struct synaptics_rmi4_fn *fhandler;
+	struct synaptics_rmi4_fn *f12 = NULL;
+	struct synaptics_rmi4_f12_extra_data *extra_data;
+	struct synaptics_rmi4_device_info *rmi;
+
+	rmi = &(rmi4_data->rmi4_mod_info);
+
+	rmi4_data->attn_f12 = NULL;
+
+	list_for_each_entry(fhandler, &rmi->support_fn_list, link) {
+		if (fhandler->fn_number == SYNAPTICS_RMI4_F12) {
+			f12 = fhandler;
+			break;
+		}
+	}
+
+	if (!f12 || !f12->data || !f12->extra)
+		return;
+
+	extra_data = (struct synaptics_rmi4_f12_extra_data *)f12->extra;
+	extra_data->prefetched = false;
+	data1_addr = f12->full_addr.data_base + extra_data->data1_offset;
+	intr_end = rmi4_data->f01_data_base_addr + 1 +
+			rmi4_data->num_of_intr_regs;
+
+	/*
+	 * The read has to stay within one page and may only step over a
+	 * few unrelated data registers on its way to F12 Data1.
+	 */
+	if ((data1_addr < intr_end) ||
+			(data1_addr - intr_end > ATTN_MAX_GAP) ||
+			((data1_addr >> 8) != (intr_end >> 8)))
+		goto no_batch;
+
+	len = data1_addr - rmi4_data->f01_data_base_addr + f12->data_size;
+	if (len > sizeof(rmi4_data->attn_data))
+		goto no_batch;
+
+	rmi4_data->attn_f12_offset = data1_addr -
+			rmi4_data->f01_data_base_addr;
+	rmi4_data->attn_data_len = len;
+	rmi4_data->attn_f12 = f12;
+
+	dev_dbg(rmi4_data->pdev->dev.parent,
+			"%s: Attention block read of %d bytes\n",
+			__func__, len);
+
+	return;
+
+no_batch:
+	dev_dbg(rmi4_data->pdev->dev.parent,
+			"%s: F12 data at 0x%04x not reachable from F01 data\n",
+			__func__, data1_addr);
+
+	return;
+}
+
 static int synaptics_rmi4_alloc_fh(struct synaptics_rmi4_fn **fhandler,
 		struct synaptics_rmi4_fn_desc *rmi_fd, int page_number)
 {
@@ -2038,6 +2257,8 @@ flash_prog_mode:
 		}
 	}
 
+	synaptics_rmi4_attn_layout(rmi4_data);
+
 	synaptics_rmi4_set_configured(rmi4_data);
 
 	return 0;
@@ -3075,6 +3296,7 @@ static struct platform_driver synaptics_rmi4_driver = {
 	.driver = {
 		.name = PLATFORM_DRIVER_NAME,
 		.owner = THIS_MODULE,
+		.probe_type = PROBE_PREFER_ASYNCHRONOUS,
 #ifdef CONFIG_PM
 		.pm = &synaptics_rmi4_dev_pm_ops,
 #endif
@@ -25,6 +25,7 @@
 #define SYNAPTICS_DSX_DRIVER_VERSION 0x2001
 
 #include <linux/version.h>
+#include <linux/ktime.h>
 #ifdef CONFIG_HAS_EARLYSUSPEND
 #include <linux/earlysuspend.h>
 #endif
@@ -72,6 +73,10 @@
 #define MAX_NUMBER_OF_BUTTONS 4
 #define MAX_INTR_REGISTERS 4
 
+#define ATTN_MAX_GAP 16
+#define ATTN_DATA_SIZE (1 + MAX_INTR_REGISTERS + ATTN_MAX_GAP + \
+		F12_FINGERS_TO_SUPPORT * 8)
+
 #define MASK_16BIT 0xFFFF
 #define MASK_8BIT 0xFF
 #define MASK_7BIT 0x7F
@@ -133,6 +138,8 @@ struct synaptics_rmi4_f12_extra_data {
 	unsigned char data15_offset;
 	unsigned char data15_size;
 	unsigned char data15_data[(F12_FINGERS_TO_SUPPORT + 7) / 8];
+	unsigned char fingers_already_present;
+	bool prefetched;
 };
 
 /*
@@ -214,6 +221,16 @@ struct synaptics_rmi4_device_info {
  * @fingers_on_2d: flag to indicate presence of fingers in 2d area
  * @sensor_sleep: flag to indicate sleep state of sensor
  * @wait: wait queue for touch data polling in interrupt thread
+ * @attn_f12: f12 handler whose finger data is fetched with the attention read
+ * @attn_data: buffer for the single block read done on each attention irq
+ * @attn_data_len: length of the attention block read
+ * @attn_f12_offset: offset of the f12 finger data within attn_data
+ * @irq_time: time the attention irq fired
+ * @irq_count: number of attention irqs serviced
+ * @irq_batched: number of attention irqs serviced with a single block read
+ * @irq_lat_total_us: accumulated irq to input sync latency
+ * @irq_lat_max_us: worst irq to input sync latency
+ * @irq_thread_boosted: flag to indicate the irq thread priority was raised
  * @irq_enable: pointer to irq enable function
  */
 struct synaptics_rmi4_data {
@@ -255,6 +272,16 @@ struct synaptics_rmi4_data {
 	bool sensor_sleep;
 	bool stay_awake;
 	bool staying_awake;
+	struct synaptics_rmi4_fn *attn_f12;
+	unsigned char attn_data[ATTN_DATA_SIZE];
+	unsigned short attn_data_len;
+	unsigned short attn_f12_offset;
+	ktime_t irq_time;
+	unsigned int irq_count;
+	unsigned int irq_batched;
+	u64 irq_lat_total_us;
+	unsigned int irq_lat_max_us;
+	bool irq_thread_boosted;
 	int (*irq_enable)(struct synaptics_rmi4_data *rmi4_data, bool enable);
 	int (*reset_device)(struct synaptics_rmi4_data *rmi4_data);
 };
@@ -30,6 +30,7 @@
 #include <linux/pinctrl/consumer.h>
 #include <linux/input/synaptics_dsx.h>
 #include <linux/of_gpio.h>
+#include <linux/wakeup_reason.h>
 #include "synaptics_i2c_rmi4.h"
 #include <linux/input/mt.h>
 
@@ -3444,6 +3445,9 @@ static int synaptics_rmi4_probe(struct i2c_client *client,
 		goto err_enable_irq;
 	}
 
+	device_set_resume_critical(&client->dev, true);
+	wakeup_reason_set_interactive(rmi4_data->irq, true);
+
 	rmi4_data->dir = debugfs_create_dir(DEBUGFS_DIR_NAME, NULL);
 	if (rmi4_data->dir == NULL || IS_ERR(rmi4_data->dir)) {
 		dev_err(&client->dev,
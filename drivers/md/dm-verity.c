@@ -12,6 +12,11 @@
  * hash device. Setting this greatly improves performance when data and hash
  * are on the same disk on different partitions on devices with poor random
  * access behavior.
+ *
+ * In "/sys/module/dm_verity/parameters/parallel_blocks" you can set the
+ * minimum number of data blocks handed to each worker when the verification
+ * of a large bio is split across CPUs. Zero verifies every bio in a single
+ * worker.
  */
 
 #include "dm-bufio.h"
@@ -19,6 +24,7 @@
 #include <linux/module.h>
 #include <linux/device-mapper.h>
 #include <linux/reboot.h>
+#include <linux/vmalloc.h>
 #include <crypto/hash.h>
 
 #define DM_MSG_PREFIX			"verity"
@@ -29,6 +35,7 @@
 #define DM_VERITY_IO_VEC_INLINE		16
 #define DM_VERITY_MEMPOOL_SIZE		4
 #define DM_VERITY_DEFAULT_PREFETCH_SIZE	262144
+#define DM_VERITY_DEFAULT_PARALLEL_BLOCKS	8
 
 #define DM_VERITY_MAX_LEVELS		63
 #define DM_VERITY_MAX_CORRUPTED_ERRS	100
@@ -37,6 +44,11 @@ static unsigned dm_verity_prefetch_cluster = DM_VERITY_DEFAULT_PREFETCH_SIZE;
 
 module_param_named(prefetch_cluster, dm_verity_prefetch_cluster, uint, S_IRUGO | S_IWUSR);
 
+static unsigned dm_verity_parallel_blocks = DM_VERITY_DEFAULT_PARALLEL_BLOCKS;
+
+module_param_named(parallel_blocks, dm_verity_parallel_blocks, uint,
+		   S_IRUGO | S_IWUSR);
+
 enum verity_mode {
 	DM_VERITY_MODE_EIO = 0,
 	DM_VERITY_MODE_LOGGING = 1,
@@ -75,6 +87,9 @@ struct dm_verity {
 
 	mempool_t *vec_mempool;	/* mempool of bio vector */
 
+	/* data blocks already verified, only with "check_at_most_once" */
+	unsigned long *validated_blocks;
+
 	struct workqueue_struct *verify_wq;
 
 	/* starting blocks for each tree level. 0 is the lowest level. */
@@ -97,6 +112,17 @@ struct dm_verity_io {
 
 	struct work_struct work;
 
+	/*
+	 * A large io may be split into parts verified by several workers.
+	 * "parts" counts the workers still running, the last one to finish
+	 * ends the io with "parts_error". The parts live in "part_buf", each
+	 * points back to its io through "parent" and shares its bio vector.
+	 */
+	atomic_t parts;
+	int parts_error;
+	void *part_buf;
+	struct dm_verity_io *parent;
+
 	/* A space for short vectors; longer vectors are allocated separately. */
 	struct bio_vec io_vec_inline[DM_VERITY_IO_VEC_INLINE];
 
@@ -346,6 +372,32 @@ release_ret_r:
 	return r;
 }
 
+/*
+ * Step over one data block of the io without hashing it.
+ */
+static void verity_skip_block(struct dm_verity_io *io,
+			      unsigned *vector, unsigned *offset)
+{
+	unsigned todo = 1 << io->v->data_dev_block_bits;
+
+	do {
+		struct bio_vec *bv;
+		unsigned len;
+
+		BUG_ON(*vector >= io->io_vec_size);
+		bv = &io->io_vec[*vector];
+		len = bv->bv_len - *offset;
+		if (likely(len >= todo))
+			len = todo;
+		*offset += len;
+		if (likely(*offset == bv->bv_len)) {
+			*offset = 0;
+			(*vector)++;
+		}
+		todo -= len;
+	} while (todo);
+}
+
 /*
  * Verify one "dm_verity_io" structure.
  */
@@ -362,6 +414,12 @@ static int verity_verify_io(struct dm_verity_io *io)
 		int r;
 		unsigned todo;
 
+		if (v->validated_blocks &&
+		    likely(test_bit(io->block + b, v->validated_blocks))) {
+			verity_skip_block(io, &vector, &offset);
+			continue;
+		}
+
 		if (likely(v->levels)) {
 			/*
 			 * First, we try to get the requested hash for
@@ -450,7 +508,8 @@ test_block_hash:
 			if (verity_handle_err(v, DM_VERITY_BLOCK_TYPE_DATA,
 					      io->block + b))
 				return -EIO;
-		}
+		} else if (v->validated_blocks)
+			set_bit(io->block + b, v->validated_blocks);
 	}
 	BUG_ON(vector != io->io_vec_size);
 	BUG_ON(offset);
@@ -475,10 +534,116 @@ static void verity_finish_io(struct dm_verity_io *io, int error)
 	bio_endio(bio, error);
 }
 
+static void verity_part_done(struct dm_verity_io *io, int error)
+{
+	if (unlikely(error))
+		cmpxchg(&io->parts_error, 0, error);
+
+	if (atomic_dec_and_test(&io->parts)) {
+		kfree(io->part_buf);
+		verity_finish_io(io, io->parts_error);
+	}
+}
+
+static void verity_part_work(struct work_struct *w)
+{
+	struct dm_verity_io *part = container_of(w, struct dm_verity_io, work);
+
+	verity_part_done(part->parent, verity_verify_io(part));
+}
+
+/*
+ * Split the verification of a large io across the workqueue. The io is
+ * cut only on bio vector boundaries that are also block boundaries, so
+ * each part walks a whole run of vectors. The io itself keeps the first
+ * run, the others are queued as separate parts.
+ *
+ * Returns true if parts were queued, false if the io must be verified as
+ * a whole.
+ */
+static bool verity_split_io(struct dm_verity_io *io)
+{
+	struct dm_verity *v = io->v;
+	struct dm_verity_io *part;
+	unsigned min_blocks = ACCESS_ONCE(dm_verity_parallel_blocks);
+	unsigned part_size = v->ti->per_bio_data_size;
+	unsigned nr, per_part, vector, start, i, n_parts = 0;
+	unsigned first_vec_size = 0, first_blocks = 0;
+	sector_t block = io->block;
+	size_t bytes = 0;
+	void *buf;
+
+	if (!min_blocks)
+		return false;
+
+	nr = min(io->n_blocks / min_blocks, num_online_cpus());
+	if (nr < 2)
+		return false;
+	per_part = DIV_ROUND_UP(io->n_blocks, nr);
+
+	buf = kmalloc((nr - 1) * part_size, GFP_NOIO | __GFP_NORETRY |
+		      __GFP_NOMEMALLOC | __GFP_NOWARN);
+	if (!buf)
+		return false;
+
+	for (vector = 0, start = 0; vector < io->io_vec_size; vector++) {
+		unsigned n;
+
+		bytes += io->io_vec[vector].bv_len;
+		if (bytes & ((1 << v->data_dev_block_bits) - 1))
+			continue;
+		n = bytes >> v->data_dev_block_bits;
+		if (n < per_part && vector != io->io_vec_size - 1)
+			continue;
+
+		if (!first_blocks) {
+			first_blocks = n;
+			first_vec_size = vector + 1;
+		} else {
+			BUG_ON(n_parts >= nr - 1);
+			part = buf + n_parts++ * part_size;
+			part->v = v;
+			part->parent = io;
+			part->block = block;
+			part->n_blocks = n;
+			part->io_vec = io->io_vec + start;
+			part->io_vec_size = vector + 1 - start;
+		}
+
+		block += n;
+		bytes = 0;
+		start = vector + 1;
+	}
+
+	if (!n_parts) {
+		kfree(buf);
+		return false;
+	}
+
+	atomic_set(&io->parts, n_parts + 1);
+	io->parts_error = 0;
+	io->part_buf = buf;
+	io->n_blocks = first_blocks;
+	io->io_vec_size = first_vec_size;
+
+	for (i = 0; i < n_parts; i++) {
+		part = buf + i * part_size;
+		INIT_WORK(&part->work, verity_part_work);
+		queue_work(v->verify_wq, &part->work);
+	}
+
+	return true;
+}
+
 static void verity_work(struct work_struct *w)
 {
 	struct dm_verity_io *io = container_of(w, struct dm_verity_io, work);
 
+	if (verity_split_io(io)) {
+		verity_part_done(io, verity_verify_io(io));
+		return;
+	}
+
 	verity_finish_io(io, verity_verify_io(io));
 }
 
@@ -636,6 +801,10 @@ static void verity_status(struct dm_target *ti, status_type_t type,
 		else
 			for (x = 0; x < v->salt_size; x++)
 				DMEMIT("%02x", v->salt[x]);
+		if (v->mode != DM_VERITY_MODE_EIO || v->validated_blocks)
+			DMEMIT(" %d", v->mode);
+		if (v->validated_blocks)
+			DMEMIT(" check_at_most_once");
 		break;
 	}
 }
@@ -700,6 +869,8 @@ static void verity_dtr(struct dm_target *ti)
 	if (v->vec_mempool)
 		mempool_destroy(v->vec_mempool);
 
+	vfree(v->validated_blocks);
+
 	if (v->bufio)
 		dm_bufio_client_destroy(v->bufio);
 
@@ -733,6 +904,9 @@ static void verity_dtr(struct dm_target *ti)
  *	<algorithm>
  *	<digest>
  *	<salt>		Hex string or "-" if no salt.
+ *	[<mode>]	0 (EIO), 1 (logging) or 2 (restart) on corruption.
+ *	[check_at_most_once]
+ *			Only verify each data block the first time it is read.
  */
 static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 {
@@ -743,6 +917,7 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	int i;
 	sector_t hash_position;
 	char dummy;
+	bool check_at_most_once = false;
 
 	v = kzalloc(sizeof(struct dm_verity), GFP_KERNEL);
 	if (!v) {
@@ -758,8 +933,8 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		goto bad;
 	}
 
-	if (argc < 10 || argc > 11) {
-		ti->error = "Invalid argument count: 10-11 arguments required";
+	if (argc < 10 || argc > 12) {
+		ti->error = "Invalid argument count: 10-12 arguments required";
 		r = -EINVAL;
 		goto bad;
 	}
@@ -880,8 +1055,12 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 		}
 	}
 
-	if (argc > 10) {
-		if (sscanf(argv[10], "%d%c", &num, &dummy) != 1 ||
+	for (i = 10; i < argc; i++) {
+		if (!strcasecmp(argv[i], "check_at_most_once")) {
+			check_at_most_once = true;
+			continue;
+		}
+		if (sscanf(argv[i], "%d%c", &num, &dummy) != 1 ||
 			num < DM_VERITY_MODE_EIO ||
 			num > DM_VERITY_MODE_RESTART) {
 			ti->error = "Invalid mode";
@@ -922,6 +1101,16 @@ static int verity_ctr(struct dm_target *ti, unsigned argc, char **argv)
 	}
 	v->hash_blocks = hash_position;
 
+	if (check_at_most_once) {
+		v->validated_blocks = vzalloc(BITS_TO_LONGS(v->data_blocks) *
+					      sizeof(unsigned long));
+		if (!v->validated_blocks) {
+			ti->error = "Cannot allocate validated block bitmap";
+			r = -ENOMEM;
+			goto bad;
+		}
+	}
+
 	v->bufio = dm_bufio_client_create(v->hash_dev->bdev,
 		1 << v->hash_dev_block_bits, 1, sizeof(struct buffer_aux),
 		dm_bufio_alloc_callback, NULL);
@@ -966,7 +1155,7 @@ bad:
 
 static struct target_type verity_target = {
 	.name		= "verity",
-	.version	= {1, 2, 0},
+	.version	= {1, 3, 0},
 	.module		= THIS_MODULE,
 	.ctr		= verity_ctr,
 	.dtr		= verity_dtr,
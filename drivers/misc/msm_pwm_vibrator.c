@@ -33,6 +33,7 @@
 #include <linux/of.h>
 #include <linux/regulator/consumer.h>
 #include <linux/mutex.h>
+#include <linux/string.h>
 
 #include <mach/msm_iomap.h>
 
@@ -76,6 +77,22 @@ enum {
 	VIB_STAT_MAX,
 };
 
+#define VIB_PATTERN_MAX		8
+#define VIB_PATTERN_SEGS	32
+#define VIB_PATTERN_NAME_LEN	16
+
+/* One step of a pattern: amp in -100..100, negative amps brake */
+struct vib_pattern_seg {
+	int amp;
+	unsigned int ms;
+};
+
+struct vib_pattern {
+	char name[VIB_PATTERN_NAME_LEN];
+	int nr_segs;
+	struct vib_pattern_seg segs[VIB_PATTERN_SEGS];
+};
+
 struct timed_vibrator_data {
 	struct timed_output_dev dev;
 	struct hrtimer timer;
@@ -100,6 +117,13 @@ struct timed_vibrator_data {
 	struct delayed_work work_vibrator_on;
 	bool use_vdd_supply;
 	struct regulator *vdd_reg;
+	/* waveform playback, patterns and pattern_req are under lock */
+	struct vib_pattern patterns[VIB_PATTERN_MAX];
+	int pattern_req;        /* pattern to start, or -1 */
+	struct vib_pattern active;
+	int active_seg;
+	struct hrtimer pattern_timer;
+	struct work_struct work_pattern;
 };
 
 static struct clk *cam_gp1_clk;
@@ -212,18 +236,40 @@ static int vibrator_pwm_set(int enable, int amp, int n_value)
 	return 0;
 }
 
+/*
+ * Change the duty cycle of a running PWM. Only register writes, so this
+ * is called from the pattern hrtimer.
+ */
+static void vibrator_pwm_set_amp(int amp)
+{
+	int d_val = vibrator_adjust_amp(amp) + MMSS_CC_D_HALF;
+
+	writel(((~(d_val << 1)) & 0xff), MMSS_CC_GP1_BASE(REG_D));
+	writel(1, MMSS_CC_GP1_BASE(REG_CMD_RCGR)); /* UPDATE */
+}
+
 #ifdef ANDROID_VIBRATOR_USE_WORKQUEUE
 static inline void vibrator_schedule_work(struct delayed_work *work,
 		unsigned long delay)
 {
 	queue_delayed_work(vibrator_workqueue, work, delay);
 }
+
+static inline void vibrator_queue_work(struct work_struct *work)
+{
+	queue_work(vibrator_workqueue, work);
+}
 #else
 static inline void vibrator_schedule_work(struct delayed_work *work,
 		unsigned long delay)
 {
 	schedule_delayed_work(work, delay);
 }
+
+static inline void vibrator_queue_work(struct work_struct *work)
+{
+	schedule_work(work);
+}
 #endif
 
 static int msm_pwm_vibrator_braking(struct timed_vibrator_data *vib)
@@ -271,6 +317,9 @@ static int msm_pwm_vibrator_force_set(struct timed_vibrator_data *vib,
 {
 	int vib_duration_ms = 0;
 
+	/* a timed request or a stop ends the pattern being played */
+	hrtimer_cancel(&vib->pattern_timer);
+
 	if (gain == 0) {
 		if (msm_pwm_vibrator_braking(vib))
 			return 0;
@@ -349,6 +398,74 @@ static void msm_pwm_vibrator_off(struct work_struct *work)
 	msm_pwm_vibrator_force_set(vib, 0, vib->pwm);
 }
 
+static void msm_pwm_vibrator_pattern(struct work_struct *work)
+{
+	struct timed_vibrator_data *vib =
+		container_of(work, struct timed_vibrator_data, work_pattern);
+	struct vib_pattern_seg *seg;
+	int idx;
+
+	hrtimer_cancel(&vib->pattern_timer);
+
+	mutex_lock(&vib->lock);
+	idx = vib->pattern_req;
+	vib->pattern_req = -1;
+	if (idx >= 0)
+		vib->active = vib->patterns[idx];
+	mutex_unlock(&vib->lock);
+
+	if (idx < 0 || !vib->active.nr_segs)
+		return;
+
+	mutex_lock(&vib_lock);
+	if (!vib->gp1_clk_flag) {
+		clk_prepare_enable(cam_gp1_clk);
+		vib->gp1_clk_flag = 1;
+	}
+	mutex_unlock(&vib_lock);
+
+	cancel_delayed_work_sync(&vib->work_vibrator_off);
+	hrtimer_cancel(&vib->timer);
+
+	seg = &vib->active.segs[0];
+	vibrator_set_power(1, vib);
+	vibrator_pwm_set(1, seg->amp, vib->pwm);
+	vibrator_pwm_set_amp(seg->amp);
+	vibrator_ic_enable_set(1, vib);
+	vib->status = VIB_STAT_RUNNING;
+	vib->active_seg = 0;
+
+	hrtimer_start(&vib->pattern_timer,
+		ns_to_ktime((u64)seg->ms * NSEC_PER_MSEC),
+		HRTIMER_MODE_REL);
+}
+
+/*
+ * Step to the next segment of the active pattern. The expiry is advanced
+ * from the previous one rather than from now, so that timer latency does
+ * not add up over the pattern.
+ */
+static enum hrtimer_restart vibrator_pattern_timer_func(struct hrtimer *timer)
+{
+	struct timed_vibrator_data *vib =
+		container_of(timer, struct timed_vibrator_data, pattern_timer);
+	struct vib_pattern_seg *seg;
+
+	if (++vib->active_seg >= vib->active.nr_segs) {
+		/* patterns do their own braking */
+		vib->status = VIB_STAT_STOP;
+		vibrator_schedule_work(&vib->work_vibrator_off, 0);
+		return HRTIMER_NORESTART;
+	}
+
+	seg = &vib->active.segs[vib->active_seg];
+	vibrator_pwm_set_amp(seg->amp);
+	hrtimer_set_expires(timer, ktime_add(hrtimer_get_expires(timer),
+		ns_to_ktime((u64)seg->ms * NSEC_PER_MSEC)));
+
+	return HRTIMER_RESTART;
+}
+
 static enum hrtimer_restart vibrator_timer_func(struct hrtimer *timer)
 {
 	struct timed_vibrator_data *vib =
@@ -735,6 +852,143 @@ static ssize_t vibrator_warmup_ms_store(struct device *dev,
 	return size;
 }
 
+/* Lists the uploaded patterns, one "name amp ms [amp ms ...]" per line */
+static ssize_t vibrator_pattern_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct timed_output_dev *_dev = dev_get_drvdata(dev);
+	struct timed_vibrator_data *vib =
+		container_of(_dev, struct timed_vibrator_data, dev);
+	struct vib_pattern *pat;
+	ssize_t len = 0;
+	int i, j;
+
+	mutex_lock(&vib->lock);
+	for (i = 0; i < VIB_PATTERN_MAX; i++) {
+		pat = &vib->patterns[i];
+		if (!pat->nr_segs)
+			continue;
+
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s", pat->name);
+		for (j = 0; j < pat->nr_segs; j++)
+			len += scnprintf(buf + len, PAGE_SIZE - len, " %d %u",
+					pat->segs[j].amp, pat->segs[j].ms);
+		len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+	}
+	mutex_unlock(&vib->lock);
+
+	return len;
+}
+
+/*
+ * Uploads a pattern as "name amp ms [amp ms ...]", replacing one of the
+ * same name. A name alone removes the pattern.
+ */
+static ssize_t vibrator_pattern_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t size)
+{
+	struct timed_output_dev *_dev = dev_get_drvdata(dev);
+	struct timed_vibrator_data *vib =
+		container_of(_dev, struct timed_vibrator_data, dev);
+	struct vib_pattern pat;
+	const char *p = buf;
+	int i, n, amp, slot = -1, free_slot = -1;
+	unsigned int ms;
+
+	memset(&pat, 0, sizeof(pat));
+	if (sscanf(p, "%15s%n", pat.name, &n) != 1)
+		return -EINVAL;
+	p += n;
+
+	while (sscanf(p, "%d %u%n", &amp, &ms, &n) == 2) {
+		if (pat.nr_segs == VIB_PATTERN_SEGS) {
+			pr_err("%s: too many segments\n", __func__);
+			return -EINVAL;
+		}
+		if (amp < -100 || amp > 100 || !ms ||
+				ms > (unsigned int)vib->max_timeout) {
+			pr_err("%s: out of range\n", __func__);
+			return -EINVAL;
+		}
+		pat.segs[pat.nr_segs].amp = amp;
+		pat.segs[pat.nr_segs].ms = ms;
+		pat.nr_segs++;
+		p += n;
+	}
+
+	if (*skip_spaces(p))
+		return -EINVAL;
+
+	mutex_lock(&vib->lock);
+	for (i = 0; i < VIB_PATTERN_MAX; i++) {
+		if (!vib->patterns[i].nr_segs) {
+			if (free_slot < 0)
+				free_slot = i;
+		} else if (!strcmp(vib->patterns[i].name, pat.name)) {
+			slot = i;
+		}
+	}
+
+	if (slot < 0)
+		slot = pat.nr_segs ? free_slot : -1;
+	if (slot >= 0)
+		vib->patterns[slot] = pat;
+	mutex_unlock(&vib->lock);
+
+	if (slot < 0 && pat.nr_segs) {
+		pr_err("%s: no room for pattern %s\n", __func__, pat.name);
+		return -ENOSPC;
+	}
+
+	return size;
+}
+
+static ssize_t vibrator_play_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct timed_output_dev *_dev = dev_get_drvdata(dev);
+	struct timed_vibrator_data *vib =
+		container_of(_dev, struct timed_vibrator_data, dev);
+
+	if (!hrtimer_active(&vib->pattern_timer))
+		return sprintf(buf, "\n");
+
+	return sprintf(buf, "%s\n", vib->active.name);
+}
+
+/* Starts the named pattern, replacing whatever the motor is doing */
+static ssize_t vibrator_play_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t size)
+{
+	struct timed_output_dev *_dev = dev_get_drvdata(dev);
+	struct timed_vibrator_data *vib =
+		container_of(_dev, struct timed_vibrator_data, dev);
+	char name[VIB_PATTERN_NAME_LEN];
+	int i;
+
+	if (sscanf(buf, "%15s", name) != 1)
+		return -EINVAL;
+
+	mutex_lock(&vib->lock);
+	for (i = 0; i < VIB_PATTERN_MAX; i++) {
+		if (vib->patterns[i].nr_segs &&
+				!strcmp(vib->patterns[i].name, name))
+			break;
+	}
+	if (i < VIB_PATTERN_MAX)
+		vib->pattern_req = i;
+	mutex_unlock(&vib->lock);
+
+	if (i == VIB_PATTERN_MAX) {
+		pr_err("%s: no pattern %s\n", __func__, name);
+		return -EINVAL;
+	}
+
+	vibrator_queue_work(&vib->work_pattern);
+
+	return size;
+}
+
 static struct device_attribute vibrator_device_attrs[] = {
 	__ATTR(amp, S_IRUGO | S_IWUSR, vibrator_amp_show, vibrator_amp_store),
 	__ATTR(n_val, S_IRUGO | S_IWUSR, vibrator_pwm_show, vibrator_pwm_store),
@@ -746,6 +1000,10 @@ static struct device_attribute vibrator_device_attrs[] = {
 		vibrator_driving_ms_show, vibrator_driving_ms_store),
 	__ATTR(warmup_ms, S_IRUGO | S_IWUSR,
 		vibrator_warmup_ms_show, vibrator_warmup_ms_store),
+	__ATTR(pattern, S_IRUGO | S_IWUSR,
+		vibrator_pattern_show, vibrator_pattern_store),
+	__ATTR(play, S_IRUGO | S_IWUSR,
+		vibrator_play_show, vibrator_play_store),
 };
 
 static struct timed_vibrator_data msm_pwm_vibrator_data = {
@@ -802,6 +1060,10 @@ static int msm_pwm_vibrator_probe(struct platform_device *pdev)
 	INIT_DELAYED_WORK(&vib->work_vibrator_on, msm_pwm_vibrator_on);
 	hrtimer_init(&vib->timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
 	vib->timer.function = vibrator_timer_func;
+	INIT_WORK(&vib->work_pattern, msm_pwm_vibrator_pattern);
+	hrtimer_init(&vib->pattern_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	vib->pattern_timer.function = vibrator_pattern_timer_func;
+	vib->pattern_req = -1;
 	mutex_init(&vib->lock);
 	spin_lock_init(&vib->spinlock);
 
@@ -14,6 +14,7 @@
  */
 
 #include <linux/atomic.h>
+#include <linux/cpufreq_times.h>
 #include <linux/err.h>
 #include <linux/hashtable.h>
 #include <linux/init.h>
@@ -29,6 +30,27 @@
 #define UID_HASH_BITS	10
 DECLARE_HASHTABLE(hash_table, UID_HASH_BITS);
 
+#ifdef CONFIG_TASK_IO_ACCOUNTING
+#define UID_STATE_FOREGROUND	0
+#define UID_STATE_BACKGROUND	1
+#define UID_STATE_BUCKET_SIZE	2
+
+#define UID_STATE_TOTAL_CURR	2
+#define UID_STATE_TOTAL_LAST	3
+#define UID_STATE_DEAD_TASKS	4
+#define UID_STATE_SIZE		5
+
+struct io_stats {
+	u64 rchar;
+	u64 wchar;
+	u64 read_bytes;
+	u64 write_bytes;
+	u64 syscr;
+	u64 syscw;
+	u64 fsync;
+};
+#endif
+
 static DEFINE_MUTEX(uid_lock);
 static struct proc_dir_entry *parent;
 
@@ -38,6 +60,10 @@ struct uid_entry {
 	cputime_t stime;
 	cputime_t active_utime;
 	cputime_t active_stime;
+#ifdef CONFIG_TASK_IO_ACCOUNTING
+	int state;
+	struct io_stats io[UID_STATE_SIZE];
+#endif
 	struct hlist_node hash;
 };
 
@@ -161,6 +187,8 @@ static ssize_t uid_remove_write(struct file *file,
 		return -EINVAL;
 	}
 
+	cpufreq_times_remove_uids(uid_start, uid_end);
+
 	mutex_lock(&uid_lock);
 
 	for (; uid_start <= uid_end; uid_start++) {
@@ -181,6 +209,198 @@ static const struct file_operations uid_remove_fops = {
 	.write		= uid_remove_write,
 };
 
+#ifdef CONFIG_TASK_IO_ACCOUNTING
+/*
+ * Storage I/O is taken from the tasks' io accounting: read_bytes is
+ * charged as reads are submitted to the block layer and write_bytes as
+ * page cache pages are dirtied.  Each uid is in the foreground or the
+ * background state as set through /proc/uid_procstat/set, and the I/O
+ * done since the previous update is added to the bucket of the state
+ * the uid is in.
+ */
+static void add_uid_io_stats(struct uid_entry *uid_entry,
+			struct task_struct *task, int slot)
+{
+	struct io_stats *io = &uid_entry->io[slot];
+	struct task_io_accounting *ioac = &task->ioac;
+
+	io->rchar += ioac->rchar;
+	io->wchar += ioac->wchar;
+	io->read_bytes += ioac->read_bytes;
+	/* truncating another task's dirty pages cancels more than it wrote */
+	if (ioac->write_bytes > ioac->cancelled_write_bytes)
+		io->write_bytes += ioac->write_bytes -
+					ioac->cancelled_write_bytes;
+	io->syscr += ioac->syscr;
+	io->syscw += ioac->syscw;
+	io->fsync += ioac->syscfs;
+}
+
+/* Tasks changing uid can make the totals of a uid go down */
+static u64 io_delta(u64 total, u64 last)
+{
+	return total > last ? total - last : 0;
+}
+
+static void compute_io_bucket_stats(struct io_stats *bucket,
+			struct io_stats *curr, struct io_stats *last,
+			struct io_stats *dead)
+{
+	bucket->rchar += io_delta(curr->rchar + dead->rchar, last->rchar);
+	bucket->wchar += io_delta(curr->wchar + dead->wchar, last->wchar);
+	bucket->read_bytes += io_delta(curr->read_bytes + dead->read_bytes,
+				last->read_bytes);
+	bucket->write_bytes += io_delta(curr->write_bytes + dead->write_bytes,
+				last->write_bytes);
+	bucket->syscr += io_delta(curr->syscr + dead->syscr, last->syscr);
+	bucket->syscw += io_delta(curr->syscw + dead->syscw, last->syscw);
+	bucket->fsync += io_delta(curr->fsync + dead->fsync, last->fsync);
+
+	*last = *curr;
+	memset(dead, 0, sizeof(*dead));
+}
+
+/* Bring the buckets of @only, or of every uid if NULL, up to date */
+static void update_io_stats_locked(struct uid_entry *only)
+{
+	struct uid_entry *uid_entry;
+	struct task_struct *task, *temp;
+	unsigned long bkt;
+	uid_t uid;
+
+	hash_for_each(hash_table, bkt, uid_entry, hash)
+		if (!only || uid_entry == only)
+			memset(&uid_entry->io[UID_STATE_TOTAL_CURR], 0,
+				sizeof(struct io_stats));
+
+	read_lock(&tasklist_lock);
+	do_each_thread(temp, task) {
+		uid = from_kuid_munged(current_user_ns(), task_uid(task));
+		if (only) {
+			if (only->uid != uid)
+				continue;
+			uid_entry = only;
+		} else {
+			uid_entry = find_or_register_uid(uid);
+			if (!uid_entry)
+				continue;
+		}
+		add_uid_io_stats(uid_entry, task, UID_STATE_TOTAL_CURR);
+	} while_each_thread(temp, task);
+	read_unlock(&tasklist_lock);
+
+	hash_for_each(hash_table, bkt, uid_entry, hash) {
+		if (only && uid_entry != only)
+			continue;
+		compute_io_bucket_stats(&uid_entry->io[uid_entry->state],
+					&uid_entry->io[UID_STATE_TOTAL_CURR],
+					&uid_entry->io[UID_STATE_TOTAL_LAST],
+					&uid_entry->io[UID_STATE_DEAD_TASKS]);
+	}
+}
+
+/*
+ * One line per uid:
+ * uid: rchar wchar read_bytes write_bytes syscr syscw fsync, first for
+ * the foreground and then for the background state.
+ */
+static int uid_io_show(struct seq_file *m, void *v)
+{
+	struct uid_entry *uid_entry;
+	struct io_stats *fg, *bg;
+	unsigned long bkt;
+
+	mutex_lock(&uid_lock);
+
+	update_io_stats_locked(NULL);
+
+	hash_for_each(hash_table, bkt, uid_entry, hash) {
+		fg = &uid_entry->io[UID_STATE_FOREGROUND];
+		bg = &uid_entry->io[UID_STATE_BACKGROUND];
+		seq_printf(m, "%d: %llu %llu %llu %llu %llu %llu %llu "
+				"%llu %llu %llu %llu %llu %llu %llu\n",
+				uid_entry->uid,
+				fg->rchar, fg->wchar, fg->read_bytes,
+				fg->write_bytes, fg->syscr, fg->syscw,
+				fg->fsync,
+				bg->rchar, bg->wchar, bg->read_bytes,
+				bg->write_bytes, bg->syscr, bg->syscw,
+				bg->fsync);
+	}
+
+	mutex_unlock(&uid_lock);
+	return 0;
+}
+
+static int uid_io_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, uid_io_show, PDE_DATA(inode));
+}
+
+static const struct file_operations uid_io_fops = {
+	.open		= uid_io_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int uid_procstat_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, NULL, NULL);
+}
+
+/* "<uid> <state>", state 0 for foreground and 1 for background */
+static ssize_t uid_procstat_write(struct file *file,
+			const char __user *buffer, size_t count, loff_t *ppos)
+{
+	struct uid_entry *uid_entry;
+	char input[128];
+	char *start, *end;
+	long int uid, state;
+
+	if (count >= sizeof(input))
+		return -EINVAL;
+
+	if (copy_from_user(input, buffer, count))
+		return -EFAULT;
+
+	input[count] = '\0';
+	end = strim(input);
+	start = strsep(&end, " ");
+
+	if (!start || !end)
+		return -EINVAL;
+
+	if (kstrtol(start, 10, &uid) != 0 || kstrtol(end, 10, &state) != 0)
+		return -EINVAL;
+
+	if (state != UID_STATE_FOREGROUND && state != UID_STATE_BACKGROUND)
+		return -EINVAL;
+
+	mutex_lock(&uid_lock);
+
+	uid_entry = find_or_register_uid(uid);
+	if (!uid_entry) {
+		mutex_unlock(&uid_lock);
+		return -ENOMEM;
+	}
+
+	if (uid_entry->state != state) {
+		update_io_stats_locked(uid_entry);
+		uid_entry->state = state;
+	}
+
+	mutex_unlock(&uid_lock);
+	return count;
+}
+
+static const struct file_operations uid_procstat_fops = {
+	.open		= uid_procstat_open,
+	.release	= single_release,
+	.write		= uid_procstat_write,
+};
+#endif /* CONFIG_TASK_IO_ACCOUNTING */
+
 static int process_notifier(struct notifier_block *self,
 			unsigned long cmd, void *v)
 {
@@ -203,6 +423,9 @@ static int process_notifier(struct notifier_block *self,
 	task_cputime_adjusted(task, &utime, &stime);
 	uid_entry->utime += utime;
 	uid_entry->stime += stime;
+#ifdef CONFIG_TASK_IO_ACCOUNTING
+	add_uid_io_stats(uid_entry, task, UID_STATE_DEAD_TASKS);
+#endif
 
 exit:
 	mutex_unlock(&uid_lock);
@@ -215,6 +438,10 @@ static struct notifier_block process_notifier_block = {
 
 static int __init proc_uid_cputime_init(void)
 {
+#ifdef CONFIG_TASK_IO_ACCOUNTING
+	struct proc_dir_entry *io_parent, *procstat_parent;
+#endif
+
 	hash_init(hash_table);
 
 	parent = proc_mkdir("uid_cputime", NULL);
@@ -229,6 +456,19 @@ static int __init proc_uid_cputime_init(void)
 	proc_create_data("show_uid_stat", S_IRUGO, parent, &uid_stat_fops,
 					NULL);
 
+#ifdef CONFIG_TASK_IO_ACCOUNTING
+	io_parent = proc_mkdir("uid_io", NULL);
+	procstat_parent = proc_mkdir("uid_procstat", NULL);
+	if (!io_parent || !procstat_parent) {
+		pr_err("%s: failed to create uid_io proc entries\n", __func__);
+	} else {
+		proc_create_data("stats", S_IRUGO, io_parent, &uid_io_fops,
+					NULL);
+		proc_create_data("set", S_IWUGO, procstat_parent,
+					&uid_procstat_fops, NULL);
+	}
+#endif
+
 	profile_event_register(PROFILE_TASK_EXIT, &process_notifier_block);
 
 	return 0;
@@ -83,6 +83,9 @@ MODULE_ALIAS("mmc:block");
 #define PCKD_TRGR_URGENT_PENALTY	2
 #define PCKD_TRGR_LOWER_BOUND		5
 #define PCKD_TRGR_PRECISION_MULTIPLIER	100
+/* packed writes must beat single writes by this much to be worth it */
+#define PCKD_TPUT_GAIN_PCT		10
+#define PCKD_TPUT_EWMA_SHIFT		3
 
 static DEFINE_MUTEX(block_mutex);
 
@@ -2099,6 +2102,87 @@ static int get_packed_trigger(int potential, struct mmc_card *card,
 	return trigger;
 }
 
+/*
+ * Moves the trigger by what packing has actually bought on this card.  If
+ * packed writes do not beat single writes by PCKD_TPUT_GAIN_PCT, the card
+ * absorbs back to back writes as well on its own and packing only delays
+ * reads, so the trigger is raised; otherwise it is lowered.  Nothing is
+ * learned until both kinds of write have been seen.
+ */
+static int mmc_blk_tput_trigger(struct mmc_queue *mq, int trigger)
+{
+	struct mmc_wr_pack_stats *stats = &mq->card->wr_pack_stats;
+	int upper = (mq->card->ext_csd.max_packed_writes * 3) / 4;
+	u32 packed, single;
+
+	spin_lock(&stats->lock);
+	packed = stats->packed_kbps;
+	single = stats->single_kbps;
+	spin_unlock(&stats->lock);
+
+	if (!packed || !single)
+		return trigger;
+
+	if ((u64)packed * 100 < (u64)single * (100 + PCKD_TPUT_GAIN_PCT)) {
+		if (trigger < upper)
+			trigger++;
+	} else if (trigger > PCKD_TRGR_LOWER_BOUND) {
+		trigger--;
+	}
+
+	return trigger;
+}
+
+static u32 mmc_blk_ewma(u32 avg, u32 val)
+{
+	if (!avg)
+		return val;
+	return avg - (avg >> PCKD_TPUT_EWMA_SHIFT) +
+		(val >> PCKD_TPUT_EWMA_SHIFT);
+}
+
+/*
+ * Called for every completed request.  With two requests in flight the
+ * current one only starts once the previous one is done, so its service
+ * time runs from the later of its issue time and the last completion.
+ */
+static void mmc_blk_update_wr_tput(struct mmc_queue *mq,
+				   struct mmc_queue_req *mqrq,
+				   enum mmc_blk_status status)
+{
+	struct mmc_wr_pack_stats *stats = &mq->card->wr_pack_stats;
+	ktime_t now = ktime_get();
+	ktime_t start = mqrq->issue_time;
+	u32 bytes = mqrq->brq.data.bytes_xfered;
+	s64 us;
+	u32 kbps;
+
+	if (ktime_compare(mq->last_done, start) > 0)
+		start = mq->last_done;
+	mq->last_done = now;
+
+	if (status != MMC_BLK_SUCCESS || rq_data_dir(mqrq->req) != WRITE ||
+	    !bytes)
+		return;
+
+	us = ktime_us_delta(now, start);
+	if (us <= 0)
+		return;
+
+	kbps = div64_s64((s64)bytes * USEC_PER_SEC, us) >> 10;
+	us = min_t(s64, us, U32_MAX);
+
+	spin_lock(&stats->lock);
+	if (mqrq->cmd_type == MMC_PACKED_WRITE) {
+		stats->packed_kbps = mmc_blk_ewma(stats->packed_kbps, kbps);
+		stats->packed_lat_us = mmc_blk_ewma(stats->packed_lat_us, us);
+	} else {
+		stats->single_kbps = mmc_blk_ewma(stats->single_kbps, kbps);
+		stats->single_lat_us = mmc_blk_ewma(stats->single_lat_us, us);
+	}
+	spin_unlock(&stats->lock);
+}
+
 static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 					  struct request *req)
 {
@@ -2126,10 +2210,10 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 		if (mq->num_of_potential_packed_wr_reqs >
 				mq->num_wr_reqs_to_start_packing)
 			mq->wr_packing_enabled = true;
-		mq->num_wr_reqs_to_start_packing =
+		mq->num_wr_reqs_to_start_packing = mmc_blk_tput_trigger(mq,
 			get_packed_trigger(mq->num_of_potential_packed_wr_reqs,
 					   mq->card, req,
-					   mq->num_wr_reqs_to_start_packing);
+					   mq->num_wr_reqs_to_start_packing));
 		mq->num_of_potential_packed_wr_reqs = 0;
 		return;
 	}
@@ -2138,10 +2222,10 @@ static void mmc_blk_write_packing_control(struct mmc_queue *mq,
 
 	if (data_dir == READ) {
 		mmc_blk_disable_wr_packing(mq);
-		mq->num_wr_reqs_to_start_packing =
+		mq->num_wr_reqs_to_start_packing = mmc_blk_tput_trigger(mq,
 			get_packed_trigger(mq->num_of_potential_packed_wr_reqs,
 					   mq->card, req,
-					   mq->num_wr_reqs_to_start_packing);
+					   mq->num_wr_reqs_to_start_packing));
 		mq->num_of_potential_packed_wr_reqs = 0;
 		mq->wr_packing_enabled = false;
 		return;
@@ -2183,6 +2267,15 @@ void mmc_blk_init_packed_statistics(struct mmc_card *card)
 }
 EXPORT_SYMBOL(mmc_blk_init_packed_statistics);
 
+/* Must be called with the queue lock held */
+static bool mmc_blk_read_waiting(struct request_queue *q)
+{
+	struct elevator_queue *e = q->elevator;
+
+	return e && e->type->ops.elevator_is_urgent_fn &&
+		e->type->ops.elevator_is_urgent_fn(q);
+}
+
 static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 {
 	struct request_queue *q = mq->queue;
@@ -2246,6 +2339,16 @@ static u8 mmc_blk_prep_packed_list(struct mmc_queue *mq, struct request *req)
 		}
 
 		spin_lock_irq(q->queue_lock);
+		/*
+		 * Every request added here is written before a read the
+		 * elevator is already holding back, so close the list.
+		 */
+		if (mmc_blk_read_waiting(q)) {
+			spin_unlock_irq(q->queue_lock);
+			MMC_BLK_UPDATE_STOP_REASON(stats, READ_WAITING);
+			put_back = false;
+			break;
+		}
 		next = blk_fetch_request(q);
 		spin_unlock_irq(q->queue_lock);
 		if (!next) {
@@ -2588,6 +2691,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 			else
 				mmc_blk_rw_rq_prep(mq->mqrq_cur, card, 0, mq);
 			areq = &mq->mqrq_cur->mmc_active;
+			mq->mqrq_cur->issue_time = ktime_get();
 		} else
 			areq = NULL;
 		areq = mmc_start_req(card->host, areq, (int *) &status);
@@ -2602,6 +2706,7 @@ static int mmc_blk_issue_rw_rq(struct mmc_queue *mq, struct request *rqc)
 		req = mq_rq->req;
 		type = rq_data_dir(req) == READ ? MMC_BLK_READ : MMC_BLK_WRITE;
 		mmc_queue_bounce_post(mq_rq);
+		mmc_blk_update_wr_tput(mq, mq_rq, status);
 
 		switch (status) {
 		case MMC_BLK_URGENT:
@@ -2833,6 +2938,270 @@ out:
 	return ret;
 }
 
+#define MMC_CMDQ_RQ_TIMEOUT	(10 * HZ)
+
+/*
+ * Task completion, called from the host interrupt.  The request is
+ * finished in softirq context by mmc_blk_cmdq_softirq_done().
+ */
+static void mmc_blk_cmdq_done(struct mmc_request *mrq)
+{
+	struct mmc_cmdq_slot *slot = container_of(mrq, struct mmc_cmdq_slot,
+						  mrq);
+	struct request *req = slot->req;
+	struct mmc_queue *mq = req->q->queuedata;
+	int err = mrq->data ? mrq->data->error : mrq->cmd->error;
+
+	if (err) {
+		pr_err("%s: cmdq task %d failed: %d\n",
+			req->rq_disk->disk_name, mrq->cmdq_tag, err);
+		mq->cmdq_error = true;
+	}
+	req->errors = err;
+	blk_complete_request(req);
+}
+
+/*
+ * Failed tasks are requeued rather than failed: the queue falls back to
+ * legacy mode once it drains and retries them with the usual recovery.
+ */
+static void mmc_blk_cmdq_softirq_done(struct request *req)
+{
+	struct mmc_queue *mq = req->q->queuedata;
+	struct mmc_cmdq_slot *slot = req->special;
+	int tag = slot->mrq.cmdq_tag;
+	unsigned long flags;
+
+	req->special = NULL;
+	slot->req = NULL;
+
+	if (req->errors) {
+		req->errors = 0;
+		spin_lock_irqsave(req->q->queue_lock, flags);
+		blk_requeue_request(req->q, req);
+		spin_unlock_irqrestore(req->q->queue_lock, flags);
+	} else {
+		blk_end_request_all(req, 0);
+	}
+
+	clear_bit(tag, &mq->cmdq_busy);
+	wake_up(&mq->cmdq_wait);
+	wake_up_process(mq->thread);
+}
+
+static enum blk_eh_timer_return mmc_blk_cmdq_rq_timed_out(struct request *req)
+{
+	struct mmc_queue *mq = req->q->queuedata;
+	struct mmc_host *host;
+
+	/* requests run in legacy mode have their own timeouts */
+	if (!mq || !req->special)
+		return BLK_EH_RESET_TIMER;
+
+	host = mq->card->host;
+	pr_err("%s: cmdq task %d timed out\n", req->rq_disk->disk_name,
+		((struct mmc_cmdq_slot *)req->special)->mrq.cmdq_tag);
+	host->cmdq_ops->abort(host);
+
+	return BLK_EH_RESET_TIMER;
+}
+
+static int mmc_blk_cmdq_start(struct mmc_queue *mq,
+			      struct mmc_cmdq_slot *slot, struct request *req)
+{
+	struct mmc_host *host = mq->card->host;
+	int tag = slot->mrq.cmdq_tag;
+	int err;
+
+	slot->mrq.done = mmc_blk_cmdq_done;
+	slot->req = req;
+	req->special = slot;
+	set_bit(tag, &mq->cmdq_busy);
+
+	err = mmc_cmdq_start_req(host, &slot->mrq);
+	if (err) {
+		pr_err("%s: failed to queue cmdq task %d: %d\n",
+			req->rq_disk->disk_name, tag, err);
+		req->special = NULL;
+		slot->req = NULL;
+		clear_bit(tag, &mq->cmdq_busy);
+		mq->cmdq_error = true;
+		spin_lock_irq(mq->queue->queue_lock);
+		blk_requeue_request(mq->queue, req);
+		spin_unlock_irq(mq->queue->queue_lock);
+		return 0;
+	}
+
+	return 1;
+}
+
+static int mmc_blk_cmdq_issue_rw(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_cmdq_slot *slot;
+	int tag;
+
+	tag = find_first_zero_bit(&mq->cmdq_busy, mq->cmdq_depth);
+	if (WARN_ON(tag >= mq->cmdq_depth)) {
+		spin_lock_irq(mq->queue->queue_lock);
+		blk_requeue_request(mq->queue, req);
+		spin_unlock_irq(mq->queue->queue_lock);
+		return 0;
+	}
+
+	slot = &mq->cmdq_slots[tag];
+	memset(&slot->mrq, 0, sizeof(slot->mrq));
+	memset(&slot->cmd, 0, sizeof(slot->cmd));
+	memset(&slot->data, 0, sizeof(slot->data));
+
+	slot->cmd.arg = blk_rq_pos(req);
+	slot->cmd.flags = MMC_RSP_R1 | MMC_CMD_ADTC;
+	slot->data.blksz = 512;
+	slot->data.blocks = blk_rq_sectors(req);
+	slot->data.sg = slot->sg;
+	slot->data.sg_len = blk_rq_map_sg(mq->queue, req, slot->sg);
+	mmc_set_data_timeout(&slot->data, card);
+
+	if (rq_data_dir(req) == READ) {
+		slot->cmd.opcode = MMC_READ_MULTIPLE_BLOCK;
+		slot->data.flags = MMC_DATA_READ;
+		if (rq_is_sync(req))
+			slot->mrq.cmdq_flags |= MMC_CMDQ_PRIO;
+	} else {
+		slot->cmd.opcode = MMC_WRITE_MULTIPLE_BLOCK;
+		slot->data.flags = MMC_DATA_WRITE;
+		if (mmc_req_rel_wr(req) && (md->flags & MMC_BLK_REL_WR))
+			slot->mrq.cmdq_flags |= MMC_CMDQ_REL_WR;
+	}
+
+	slot->mrq.cmd = &slot->cmd;
+	slot->mrq.data = &slot->data;
+	slot->mrq.cmdq_tag = tag;
+
+	return mmc_blk_cmdq_start(mq, slot, req);
+}
+
+/* cache flush as a direct command, queued behind nothing */
+static int mmc_blk_cmdq_issue_flush(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_card *card = mq->card;
+	struct mmc_cmdq_slot *slot = &mq->cmdq_slots[MMC_CMDQ_DCMD_TAG];
+
+	if (!(card->host->caps2 & MMC_CAP2_CACHE_CTRL) ||
+	    (card->quirks & MMC_QUIRK_CACHE_DISABLE) ||
+	    !card->ext_csd.cache_size || !(card->ext_csd.cache_ctrl & 1)) {
+		blk_end_request_all(req, 0);
+		return 1;
+	}
+
+	if (mmc_card_cache_clean(card)) {
+		card->flush_coalesced++;
+		blk_end_request_all(req, 0);
+		return 1;
+	}
+
+	wait_event(mq->cmdq_wait,
+		   !test_bit(MMC_CMDQ_DCMD_TAG, &mq->cmdq_busy));
+	card->flush_issued++;
+
+	memset(&slot->mrq, 0, sizeof(slot->mrq));
+	memset(&slot->cmd, 0, sizeof(slot->cmd));
+	slot->cmd.opcode = MMC_SWITCH;
+	slot->cmd.arg = (MMC_SWITCH_MODE_WRITE_BYTE << 24) |
+			(EXT_CSD_FLUSH_CACHE << 16) | (1 << 8) |
+			EXT_CSD_CMD_SET_NORMAL;
+	slot->cmd.flags = MMC_RSP_R1B | MMC_CMD_AC;
+	slot->mrq.cmd = &slot->cmd;
+	slot->mrq.cmdq_tag = MMC_CMDQ_DCMD_TAG;
+
+	return mmc_blk_cmdq_start(mq, slot, req);
+}
+
+/*
+ * Any failure drops the queue back to legacy mode for good; the requests
+ * that were in flight have been requeued and are retried one at a time.
+ */
+static void mmc_blk_cmdq_fallback(struct mmc_queue *mq)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_host *host = mq->card->host;
+
+	pr_err("%s: disabling command queuing\n", md->disk->disk_name);
+	mmc_cmdq_deactivate(host);
+	host->cmdq_owner = NULL;
+	mq->cmdq_depth = 0;
+}
+
+static int mmc_blk_cmdq_issue_rq(struct mmc_queue *mq, struct request *req)
+{
+	struct mmc_blk_data *md = mq->data;
+	struct mmc_card *card = md->queue.card;
+	struct mmc_host *host = card->host;
+	int ret;
+
+	if (!req) {
+		/* queue drained */
+		if (!mq->cmdq_claimed)
+			return 0;
+		if (mq->cmdq_error)
+			mmc_blk_cmdq_fallback(mq);
+		mq->cmdq_claimed = false;
+		mmc_release_host(host);
+		mmc_rpm_release(host, &card->dev);
+		return 0;
+	}
+
+	if (!mq->cmdq_claimed) {
+		mmc_rpm_hold(host, &card->dev);
+#ifdef CONFIG_MMC_BLOCK_DEFERRED_RESUME
+		if (mmc_bus_needs_resume(host))
+			mmc_resume_bus(host);
+#endif
+		mmc_claim_host(host);
+		mq->cmdq_claimed = true;
+		if (card->ext_csd.bkops_en)
+			mmc_stop_bkops(card);
+	}
+
+	if (mq->cmdq_error) {
+		spin_lock_irq(mq->queue->queue_lock);
+		blk_requeue_request(mq->queue, req);
+		spin_unlock_irq(mq->queue->queue_lock);
+		return 0;
+	}
+
+	ret = mmc_blk_part_switch(card, md);
+	if (ret) {
+		blk_end_request_all(req, -EIO);
+		return 0;
+	}
+
+	if (req->cmd_flags & REQ_DISCARD) {
+		/* erases are not queueable, run them in legacy mode */
+		wait_event(mq->cmdq_wait, !mq->cmdq_busy);
+		mmc_cmdq_deactivate(host);
+		if (req->cmd_flags & REQ_SECURE &&
+			!(card->quirks & MMC_QUIRK_SEC_ERASE_TRIM_BROKEN))
+			return mmc_blk_issue_secdiscard_rq(mq, req);
+		return mmc_blk_issue_discard_rq(mq, req);
+	}
+
+	ret = mmc_cmdq_activate(host);
+	if (ret) {
+		mq->cmdq_error = true;
+		spin_lock_irq(mq->queue->queue_lock);
+		blk_requeue_request(mq->queue, req);
+		spin_unlock_irq(mq->queue->queue_lock);
+		return 0;
+	}
+
+	if (req->cmd_flags & REQ_FLUSH)
+		return mmc_blk_cmdq_issue_flush(mq, req);
+
+	return mmc_blk_cmdq_issue_rw(mq, req);
+}
+
 static inline int mmc_blk_readonly(struct mmc_card *card)
 {
 	return mmc_card_readonly(card) ||
@@ -2899,6 +3268,14 @@ static struct mmc_blk_data *mmc_blk_alloc_req(struct mmc_card *card,
 
 	md->queue.issue_fn = mmc_blk_issue_rq;
 	md->queue.data = md;
+	if (md->queue.cmdq_depth) {
+		md->queue.cmdq_issue_fn = mmc_blk_cmdq_issue_rq;
+		blk_queue_softirq_done(md->queue.queue,
+				       mmc_blk_cmdq_softirq_done);
+		blk_queue_rq_timed_out(md->queue.queue,
+				       mmc_blk_cmdq_rq_timed_out);
+		blk_queue_rq_timeout(md->queue.queue, MMC_CMDQ_RQ_TIMEOUT);
+	}
 
 	md->disk->major	= MMC_BLOCK_MAJOR;
 	md->disk->first_minor = devidx * perdev_minors;
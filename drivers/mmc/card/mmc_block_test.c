@@ -21,6 +21,10 @@
 #include <linux/mmc/host.h>
 #include <linux/delay.h>
 #include <linux/test-iosched.h>
+#include <linux/blktrace_api.h>
+#include <linux/sort.h>
+#include <linux/vmalloc.h>
+#include <linux/uaccess.h>
 #include "queue.h"
 #include <linux/mmc/mmc.h>
 
@@ -71,6 +75,11 @@
 				    (stats.suspend != exp_suspend))
 #define BKOPS_TEST_TIMEOUT 60000
 
+#define REPLAY_TRACE_MAX_BYTES	(4 * 1024 * 1024)
+/* Sectors a replayed request may start at, leaving room for its size */
+#define REPLAY_SECTOR_RANGE	((TEST_MAX_SECTOR_RANGE - \
+				  TEST_MAX_BIOS_PER_REQ * TEST_BIO_SIZE) >> 9)
+
 enum is_random {
 	NON_RANDOM_TEST,
 	RANDOM_TEST,
@@ -150,6 +159,8 @@ enum mmc_block_test_testcases {
 	TEST_LONG_SEQUENTIAL_WRITE,
 
 	TEST_NEW_REQ_NOTIFICATION,
+
+	TEST_REPLAY_TRACE,
 };
 
 enum mmc_block_test_group {
@@ -180,6 +191,45 @@ struct mmc_block_test_debug {
 	struct dentry *long_sequential_read_test;
 	struct dentry *long_sequential_write_test;
 	struct dentry *new_req_notification_test;
+	struct dentry *replay_trace;
+	struct dentry *replay_test;
+};
+
+enum replay_class {
+	REPLAY_READ,
+	REPLAY_SYNC_WRITE,
+	REPLAY_ASYNC_WRITE,
+	REPLAY_CLASSES,
+};
+
+/* One queued request of a replayed trace */
+struct replay_req {
+	/* Issue time relative to the first request */
+	u64 issue_ns;
+	/* Offset from the test start sector */
+	u32 sector;
+	u16 num_bios;
+	u8 class;
+	ktime_t queued;
+	u32 latency_us;
+};
+
+struct mmc_block_test_replay {
+	/* Serializes trace upload against test runs */
+	struct mutex lock;
+	/* Raw blktrace records, as written to utils/replay_trace */
+	void *trace;
+	size_t trace_len;
+	struct replay_req *reqs;
+	unsigned int nr_reqs;
+	unsigned int issued;
+	bool issuing;
+	int done;
+	atomic_t completed;
+	atomic_t errors;
+	/* Report of the last run, PAGE_SIZE */
+	char *results;
+	size_t results_len;
 };
 
 struct mmc_block_test_data {
@@ -217,6 +267,8 @@ struct mmc_block_test_data {
 	wait_queue_head_t bkops_wait_q;
 	/* A counter for the number of test requests completed */
 	unsigned int completed_req_count;
+	/* Trace replay state */
+	struct mmc_block_test_replay replay;
 };
 
 static struct mmc_block_test_data *mbtd;
@@ -651,6 +703,8 @@ switch (td->test_info.testcase) {
 		return "\"long sequential write\"";
 	case TEST_NEW_REQ_NOTIFICATION:
 		return "\"new request notification test\"";
+	case TEST_REPLAY_TRACE:
+		return "\"trace replay\"";
 	default:
 		return " Unknown testcase";
 	}
@@ -2986,6 +3040,383 @@ const struct file_operations new_req_notification_test_ops = {
 	.read = new_req_notification_test_read,
 };
 
+/*
+ * Trace replay: blktrace queue events are reissued with their recorded
+ * inter-arrival times and sizes, and the issue to completion latency of
+ * every request is kept for a per class latency and throughput report.
+ * Trace sectors are folded into the test area above start_sector.
+ */
+static const char * const replay_class_names[REPLAY_CLASSES] = {
+	"read", "sync write", "async write",
+};
+
+static int replay_parse_trace(void)
+{
+	struct mmc_block_test_replay *rp = &mbtd->replay;
+	struct blk_io_trace t;
+	struct replay_req *req;
+	size_t off = 0;
+	u64 first_time = 0, sector;
+	unsigned int nr = 0;
+	u32 tc;
+
+	rp->nr_reqs = 0;
+	if (rp->trace_len < sizeof(t))
+		return -EINVAL;
+
+	vfree(rp->reqs);
+	rp->reqs = vzalloc((rp->trace_len / sizeof(t)) * sizeof(*rp->reqs));
+	if (!rp->reqs)
+		return -ENOMEM;
+
+	while (off + sizeof(t) <= rp->trace_len) {
+		/* Records are only packed, pdu_len may leave them unaligned */
+		memcpy(&t, rp->trace + off, sizeof(t));
+		if ((t.magic & 0xffffff00) != BLK_IO_TRACE_MAGIC) {
+			pr_err("%s: bad trace magic at offset %zu", __func__,
+			       off);
+			return -EINVAL;
+		}
+		off += sizeof(t) + t.pdu_len;
+
+		tc = t.action >> BLK_TC_SHIFT;
+		if ((t.action & 0xffff) != __BLK_TA_QUEUE || !t.bytes ||
+		    (tc & (BLK_TC_NOTIFY | BLK_TC_DISCARD)))
+			continue;
+
+		if (!nr)
+			first_time = t.time;
+
+		req = &rp->reqs[nr++];
+		req->issue_ns = t.time > first_time ? t.time - first_time : 0;
+		sector = t.sector;
+		req->sector = do_div(sector, REPLAY_SECTOR_RANGE) & ~7;
+		req->num_bios = clamp_t(unsigned int,
+				DIV_ROUND_UP(t.bytes, TEST_BIO_SIZE),
+				1, TEST_MAX_BIOS_PER_REQ);
+		if (!(tc & BLK_TC_WRITE))
+			req->class = REPLAY_READ;
+		else if (tc & BLK_TC_SYNC)
+			req->class = REPLAY_SYNC_WRITE;
+		else
+			req->class = REPLAY_ASYNC_WRITE;
+	}
+
+	rp->nr_reqs = nr;
+	pr_info("%s: %u requests over %llu ms", __func__, nr,
+		nr ? div_u64(rp->reqs[nr - 1].issue_ns, NSEC_PER_MSEC) : 0);
+
+	return nr ? 0 : -EINVAL;
+}
+
+static void replay_end_io_fn(struct request *rq, int err)
+{
+	struct test_request *test_rq =
+		(struct test_request *)rq->elv.priv[0];
+	struct replay_req *req = rq->elv.priv[1];
+	struct test_data *ptd = test_get_test_data();
+
+	BUG_ON(!test_rq || !req);
+
+	req->latency_us = ktime_us_delta(ktime_get(), req->queued);
+	if (err)
+		atomic_inc(&mbtd->replay.errors);
+
+	spin_lock_irq(&ptd->lock);
+	list_del_init(&test_rq->queuelist);
+	ptd->dispatched_count--;
+	__blk_put_request(ptd->req_q, test_rq->rq);
+	spin_unlock_irq(&ptd->lock);
+
+	kfree(test_rq->bios_buffer);
+	kfree(test_rq);
+	atomic_inc(&mbtd->replay.completed);
+
+	check_test_completion();
+}
+
+/* Complete once, after the last request was both issued and completed */
+static bool replay_check_completion(void)
+{
+	struct mmc_block_test_replay *rp = &mbtd->replay;
+
+	if (rp->issuing ||
+	    atomic_read(&rp->completed) != rp->issued)
+		return false;
+
+	return !xchg(&rp->done, 1);
+}
+
+static int prepare_replay(struct test_data *td)
+{
+	struct mmc_block_test_replay *rp = &mbtd->replay;
+
+	rp->issued = 0;
+	rp->issuing = true;
+	rp->done = 0;
+	atomic_set(&rp->completed, 0);
+	atomic_set(&rp->errors, 0);
+
+	return 0;
+}
+
+static int run_replay(struct test_data *td)
+{
+	struct mmc_block_test_replay *rp = &mbtd->replay;
+	struct test_request *test_rq;
+	struct replay_req *req;
+	ktime_t start = ktime_get();
+	s64 delay_us;
+	int rw, ret = 0;
+	unsigned int i;
+
+	for (i = 0; i < rp->nr_reqs; i++) {
+		req = &rp->reqs[i];
+
+		delay_us = div_s64(req->issue_ns, NSEC_PER_USEC) -
+			   ktime_us_delta(ktime_get(), start);
+		if (delay_us > 20 * USEC_PER_MSEC)
+			msleep(div_s64(delay_us, USEC_PER_MSEC));
+		else if (delay_us > 0)
+			usleep_range(delay_us, delay_us + 50);
+
+		rw = req->class == REPLAY_READ ? READ : WRITE;
+		if (req->class != REPLAY_ASYNC_WRITE)
+			rw |= REQ_SYNC;
+
+		test_rq = test_iosched_create_test_req(0, rw,
+				td->start_sector + req->sector, req->num_bios,
+				TEST_NO_PATTERN, replay_end_io_fn);
+		if (!test_rq) {
+			pr_err("%s: failed to create request %u", __func__, i);
+			ret = -ENOMEM;
+			break;
+		}
+		test_rq->rq->elv.priv[1] = req;
+		req->queued = ktime_get();
+
+		spin_lock_irq(td->req_q->queue_lock);
+		list_add_tail(&test_rq->queuelist, &td->test_queue);
+		td->test_count++;
+		rp->issued++;
+		spin_unlock_irq(td->req_q->queue_lock);
+
+		blk_run_queue(td->req_q);
+	}
+
+	rp->issuing = false;
+	check_test_completion();
+
+	return ret;
+}
+
+static int check_replay_result(struct test_data *td)
+{
+	int errors = atomic_read(&mbtd->replay.errors);
+
+	if (errors) {
+		pr_err("%s: %d requests failed", __func__, errors);
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+static int cmp_latency(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void replay_report(void)
+{
+	struct mmc_block_test_replay *rp = &mbtd->replay;
+	u64 msec = ktime_to_ms(mbtd->test_info.test_duration);
+	u64 bytes;
+	unsigned int i, n, class;
+	size_t len;
+	u32 *lat;
+
+	lat = vmalloc(rp->issued * sizeof(*lat));
+	if (!lat)
+		return;
+
+	len = scnprintf(rp->results, PAGE_SIZE,
+			"%u requests in %llu ms, %d errors\n", rp->issued,
+			msec, atomic_read(&rp->errors));
+
+	for (class = 0; class < REPLAY_CLASSES; class++) {
+		bytes = 0;
+		for (i = n = 0; i < rp->issued; i++) {
+			if (rp->reqs[i].class != class)
+				continue;
+			lat[n++] = rp->reqs[i].latency_us;
+			bytes += rp->reqs[i].num_bios * TEST_BIO_SIZE;
+		}
+		if (!n)
+			continue;
+
+		sort(lat, n, sizeof(*lat), cmp_latency, NULL);
+		len += scnprintf(rp->results + len, PAGE_SIZE - len,
+			"%-11s n=%u p50=%uus p95=%uus p99=%uus max=%uus "
+			"%llu KiB/s\n", replay_class_names[class], n,
+			lat[n / 2], lat[n * 95 / 100], lat[n * 99 / 100],
+			lat[n - 1],
+			msec ? div64_u64(bytes * MSEC_PER_SEC, msec * SZ_1K) :
+			0);
+	}
+	rp->results_len = len;
+
+	vfree(lat);
+}
+
+static ssize_t replay_trace_write(struct file *file,
+				  const char __user *buf,
+				  size_t count,
+				  loff_t *ppos)
+{
+	struct mmc_block_test_replay *rp = &mbtd->replay;
+	ssize_t ret = count;
+
+	mutex_lock(&rp->lock);
+
+	if (!*ppos)
+		rp->trace_len = 0;
+
+	if (*ppos != rp->trace_len) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (count > REPLAY_TRACE_MAX_BYTES - rp->trace_len) {
+		ret = -EFBIG;
+		goto out;
+	}
+
+	if (!rp->trace) {
+		rp->trace = vmalloc(REPLAY_TRACE_MAX_BYTES);
+		if (!rp->trace) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	if (copy_from_user(rp->trace + rp->trace_len, buf, count)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	rp->trace_len += count;
+	*ppos += count;
+
+out:
+	mutex_unlock(&rp->lock);
+	return ret;
+}
+
+const struct file_operations replay_trace_ops = {
+	.open = test_open,
+	.write = replay_trace_write,
+};
+
+static ssize_t replay_test_write(struct file *file,
+				 const char __user *buf,
+				 size_t count,
+				 loff_t *ppos)
+{
+	struct mmc_block_test_replay *rp = &mbtd->replay;
+	int ret, i, number;
+
+	pr_info("%s: -- Trace Replay TEST --", __func__);
+
+	if (kstrtoint_from_user(buf, count, 0, &number) || number <= 0)
+		number = 1;
+
+	mutex_lock(&rp->lock);
+
+	ret = replay_parse_trace();
+	if (ret) {
+		pr_err("%s: no usable trace, write one to replay_trace first",
+		       __func__);
+		goto out;
+	}
+
+	if (!rp->results) {
+		rp->results = kzalloc(PAGE_SIZE, GFP_KERNEL);
+		if (!rp->results) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+	rp->results_len = 0;
+
+	memset(&mbtd->test_info, 0, sizeof(struct test_info));
+	mbtd->test_group = TEST_GENERAL_GROUP;
+
+	mbtd->test_info.data = mbtd;
+	mbtd->test_info.get_test_case_str_fn = get_test_case_str;
+	mbtd->test_info.prepare_test_fn = prepare_replay;
+	mbtd->test_info.run_test_fn = run_replay;
+	mbtd->test_info.check_test_result_fn = check_replay_result;
+	mbtd->test_info.check_test_completion_fn = replay_check_completion;
+	mbtd->test_info.timeout_msec = 60 * 1000 +
+		div_u64(rp->reqs[rp->nr_reqs - 1].issue_ns, NSEC_PER_MSEC);
+
+	for (i = 0 ; i < number ; ++i) {
+		pr_info("%s: Cycle # %d / %d", __func__, i+1, number);
+		pr_info("%s: ====================", __func__);
+
+		mbtd->test_info.testcase = TEST_REPLAY_TRACE;
+		ret = test_iosched_start_test(&mbtd->test_info);
+		if (ret)
+			break;
+
+		replay_report();
+		pr_info("%s", rp->results);
+
+		/* Allow FS requests to be dispatched */
+		msleep(1000);
+	}
+
+out:
+	mutex_unlock(&rp->lock);
+	return ret ? ret : count;
+}
+
+static ssize_t replay_test_read(struct file *file,
+				char __user *buffer,
+				size_t count,
+				loff_t *offset)
+{
+	struct mmc_block_test_replay *rp = &mbtd->replay;
+	static const char desc[] =
+		"\nreplay_test\n"
+		"=========\n"
+		"Description:\n"
+		"This test replays a blktrace binary dump written to\n"
+		"utils/replay_trace (e.g. from blkparse -d), keeping the\n"
+		"recorded request sizes and inter-arrival times, and reports\n"
+		"p50/p95/p99 latency and throughput per request class.\n"
+		"Reading after a run returns the results of the last cycle.\n";
+	ssize_t ret;
+
+	mutex_lock(&rp->lock);
+	if (rp->results_len)
+		ret = simple_read_from_buffer(buffer, count, offset,
+					      rp->results, rp->results_len);
+	else
+		ret = simple_read_from_buffer(buffer, count, offset, desc,
+					      sizeof(desc) - 1);
+	mutex_unlock(&rp->lock);
+
+	return ret;
+}
+
+const struct file_operations replay_test_ops = {
+	.open = test_open,
+	.write = replay_test_write,
+	.read = replay_test_read,
+};
+
 static void mmc_block_test_debugfs_cleanup(void)
 {
 	debugfs_remove(mbtd->debug.random_test_seed);
@@ -2997,6 +3428,8 @@ static void mmc_block_test_debugfs_cleanup(void)
 	debugfs_remove(mbtd->debug.long_sequential_read_test);
 	debugfs_remove(mbtd->debug.long_sequential_write_test);
 	debugfs_remove(mbtd->debug.new_req_notification_test);
+	debugfs_remove(mbtd->debug.replay_trace);
+	debugfs_remove(mbtd->debug.replay_test);
 }
 
 static int mmc_block_test_debugfs_init(void)
@@ -3098,6 +3531,24 @@ static int mmc_block_test_debugfs_init(void)
 	if (!mbtd->debug.long_sequential_write_test)
 		goto err_nomem;
 
+	mbtd->debug.replay_trace = debugfs_create_file("replay_trace",
+					S_IWUSR,
+					utils_root,
+					NULL,
+					&replay_trace_ops);
+
+	if (!mbtd->debug.replay_trace)
+		goto err_nomem;
+
+	mbtd->debug.replay_test = debugfs_create_file("replay_test",
+					S_IRUGO | S_IWUGO,
+					tests_root,
+					NULL,
+					&replay_test_ops);
+
+	if (!mbtd->debug.replay_test)
+		goto err_nomem;
+
 	return 0;
 
 err_nomem:
@@ -3146,6 +3597,7 @@ static int __init mmc_block_test_init(void)
 	}
 
 	init_waitqueue_head(&mbtd->bkops_wait_q);
+	mutex_init(&mbtd->replay.lock);
 	mbtd->bdt.init_fn = mmc_block_test_probe;
 	mbtd->bdt.exit_fn = mmc_block_test_remove;
 	INIT_LIST_HEAD(&mbtd->bdt.list);
@@ -3157,6 +3609,9 @@ static int __init mmc_block_test_init(void)
 static void __exit mmc_block_test_exit(void)
 {
 	test_iosched_unregister(&mbtd->bdt);
+	vfree(mbtd->replay.trace);
+	vfree(mbtd->replay.reqs);
+	kfree(mbtd->replay.results);
 	kfree(mbtd);
 }
 
@@ -118,6 +118,63 @@ static int mmc_queue_thread(void *d)
 	return 0;
 }
 
+/*
+ * Command queue mode: keep fetching while a task slot is free.  Tasks
+ * complete through the softirq done handler, which frees the slot and
+ * wakes the thread.  The host stays claimed while any task is in flight
+ * and is released by calling cmdq_issue_fn with no request once the
+ * queue drains.  If that switched the queue to legacy mode the thread
+ * carries on as mmc_queue_thread.
+ */
+static int mmc_cmdq_thread(void *d)
+{
+	struct mmc_queue *mq = d;
+	struct request_queue *q = mq->queue;
+	unsigned long full = (1UL << mq->cmdq_depth) - 1;
+
+	current->flags |= PF_MEMALLOC;
+	mq->card->host->cmdq_owner = current;
+
+	down(&mq->thread_sem);
+	do {
+		struct request *req = NULL;
+
+		spin_lock_irq(q->queue_lock);
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!mq->cmdq_error && (mq->cmdq_busy & full) != full)
+			req = blk_fetch_request(q);
+		spin_unlock_irq(q->queue_lock);
+
+		if (req) {
+			set_current_state(TASK_RUNNING);
+			mq->cmdq_issue_fn(mq, req);
+			continue;
+		}
+
+		if (mq->cmdq_busy) {
+			/* wait for a free slot or the last completion */
+			schedule();
+			continue;
+		}
+
+		if (mq->cmdq_claimed)
+			mq->cmdq_issue_fn(mq, NULL);
+		if (!mq->cmdq_depth || kthread_should_stop()) {
+			set_current_state(TASK_RUNNING);
+			break;
+		}
+		up(&mq->thread_sem);
+		schedule();
+		down(&mq->thread_sem);
+	} while (1);
+	up(&mq->thread_sem);
+
+	if (kthread_should_stop())
+		return 0;
+
+	return mmc_queue_thread(d);
+}
+
 /*
  * Generic MMC request handler.  This is called for any queue on a
  * particular host.  When the host is not busy, we look for a request
@@ -233,6 +290,59 @@ static void mmc_queue_setup_discard(struct request_queue *q,
 		queue_flag_set_unlocked(QUEUE_FLAG_SECDISCARD, q);
 }
 
+static void mmc_cmdq_clean(struct mmc_queue *mq)
+{
+	int i;
+
+	if (!mq->cmdq_slots)
+		return;
+
+	for (i = 0; i < MMC_CMDQ_SLOTS; i++)
+		kfree(mq->cmdq_slots[i].sg);
+	kfree(mq->cmdq_slots);
+	mq->cmdq_slots = NULL;
+	mq->cmdq_depth = 0;
+}
+
+/*
+ * Command queuing is used for the user area of block addressed cards
+ * with 512 byte sectors when both the card and the host support it.
+ * Anything that fails here just leaves the queue in legacy mode.
+ */
+static void mmc_cmdq_init(struct mmc_queue *mq, struct mmc_card *card)
+{
+	struct mmc_host *host = card->host;
+	int i, ret;
+
+	if (!(host->caps2 & MMC_CAP2_CMD_QUEUE) || !host->cmdq_ops ||
+	    !card->ext_csd.cmdq_support || !mmc_card_blockaddr(card) ||
+	    card->ext_csd.data_sector_size != 512)
+		return;
+
+	mq->cmdq_slots = kcalloc(MMC_CMDQ_SLOTS, sizeof(*mq->cmdq_slots),
+				 GFP_KERNEL);
+	if (!mq->cmdq_slots)
+		goto fail;
+
+	mq->cmdq_depth = min_t(int, card->ext_csd.cmdq_depth,
+			       MMC_CMDQ_DCMD_TAG);
+	for (i = 0; i < mq->cmdq_depth; i++) {
+		mq->cmdq_slots[i].sg = mmc_alloc_sg(host->max_segs, &ret);
+		if (ret)
+			goto fail;
+	}
+
+	init_waitqueue_head(&mq->cmdq_wait);
+	pr_info("%s: command queuing enabled, depth %d\n",
+		mmc_card_name(card), mq->cmdq_depth);
+	return;
+
+fail:
+	pr_warn("%s: unable to allocate command queue slots\n",
+		mmc_card_name(card));
+	mmc_cmdq_clean(mq);
+}
+
 /**
  * mmc_init_queue - initialise a queue structure.
  * @mq: mmc queue
@@ -373,11 +483,16 @@ cur_sg_alloc_failed:
 success:
 	sema_init(&mq->thread_sem, 1);
 
-	mq->thread = kthread_run(mmc_queue_thread, mq, "mmcqd/%d%s",
+	if (!subname && !mqrq_cur->bounce_buf)
+		mmc_cmdq_init(mq, card);
+
+	mq->thread = kthread_run(mq->cmdq_depth ? mmc_cmdq_thread :
+		mmc_queue_thread, mq, "mmcqd/%d%s",
 		host->index, subname ? subname : "");
 
 	if (IS_ERR(mq->thread)) {
 		ret = PTR_ERR(mq->thread);
+		mmc_cmdq_clean(mq);
 		goto free_bounce_sg;
 	}
 
@@ -415,6 +530,7 @@ void mmc_cleanup_queue(struct mmc_queue *mq)
 
 	/* Then terminate our worker thread */
 	kthread_stop(mq->thread);
+	mmc_cmdq_clean(mq);
 
 	/* Empty the queue */
 	spin_lock_irqsave(q->queue_lock, flags);
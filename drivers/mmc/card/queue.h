@@ -41,8 +41,21 @@ struct mmc_queue_req {
 	struct mmc_async_req	mmc_active;
 	enum mmc_packed_type	cmd_type;
 	struct mmc_packed	*packed;
+	ktime_t			issue_time;
 };
 
+/* one command queue task, the last slot carries direct commands */
+struct mmc_cmdq_slot {
+	struct request		*req;
+	struct mmc_request	mrq;
+	struct mmc_command	cmd;
+	struct mmc_data		data;
+	struct scatterlist	*sg;
+};
+
+#define MMC_CMDQ_SLOTS		32
+#define MMC_CMDQ_DCMD_TAG	(MMC_CMDQ_SLOTS - 1)
+
 struct mmc_queue {
 	struct mmc_card		*card;
 	struct task_struct	*thread;
@@ -62,6 +75,16 @@ struct mmc_queue {
 	int			num_of_potential_packed_wr_reqs;
 	int			num_wr_reqs_to_start_packing;
 	bool			no_pack_for_random;
+	ktime_t			last_done;	/* last request completion */
+	/* command queue mode, cmdq_depth is 0 once the queue runs legacy */
+	struct mmc_cmdq_slot	*cmdq_slots;
+	int			cmdq_depth;
+	unsigned long		cmdq_busy;	/* slots in flight */
+	bool			cmdq_error;	/* fall back to legacy mode */
+	bool			cmdq_claimed;
+	wait_queue_head_t	cmdq_wait;
+	int			(*cmdq_issue_fn)(struct mmc_queue *,
+						 struct request *);
 	int (*err_check_fn) (struct mmc_card *, struct mmc_async_req *);
 	void (*packed_test_fn) (struct request_queue *, struct mmc_queue_req *);
 };
@@ -260,6 +260,30 @@ void mmc_request_done(struct mmc_host *host, struct mmc_request *mrq)
 
 EXPORT_SYMBOL(mmc_request_done);
 
+/**
+ *	mmc_cmdq_request_done - finish a command queue task
+ *	@host: MMC host which completed the task
+ *	@mrq: MMC request of the task
+ *
+ *	Called by the command queue engine, usually from its interrupt
+ *	handler, once per task started with mmc_cmdq_start_req().
+ */
+void mmc_cmdq_request_done(struct mmc_host *host, struct mmc_request *mrq)
+{
+	pr_debug("%s: task %d done: %d\n", mmc_hostname(host),
+		 mrq->cmdq_tag, mrq->data ? mrq->data->error : mrq->cmd->error);
+
+	if (mrq->data)
+		trace_mmc_blk_rw_end(mrq->cmd->opcode, mrq->cmd->arg,
+				     mrq->data);
+
+	if (mrq->done)
+		mrq->done(mrq);
+
+	mmc_host_clk_release(host);
+}
+EXPORT_SYMBOL(mmc_cmdq_request_done);
+
 static void
 mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 {
@@ -298,6 +322,8 @@ mmc_start_request(struct mmc_host *host, struct mmc_request *mrq)
 	mrq->cmd->error = 0;
 	mrq->cmd->mrq = mrq;
 	if (mrq->data) {
+		if (host->card && (mrq->data->flags & MMC_DATA_WRITE))
+			mmc_card_clr_cache_clean(host->card);
 		BUG_ON(mrq->data->blksz > host->max_blk_size);
 		BUG_ON(mrq->data->blocks > host->max_blk_count);
 		BUG_ON(mrq->data->blocks * mrq->data->blksz >
@@ -1418,6 +1444,8 @@ int __mmc_claim_host(struct mmc_host *host, atomic_t *abort)
 	remove_wait_queue(&host->wq, &wait);
 	if (host->ops->enable && !stop && host->claim_cnt == 1)
 		host->ops->enable(host);
+	if (!stop && host->cmdq_active && host->cmdq_owner != current)
+		mmc_cmdq_deactivate(host);
 	return stop;
 }
 
@@ -1444,6 +1472,8 @@ int mmc_try_claim_host(struct mmc_host *host)
 	spin_unlock_irqrestore(&host->lock, flags);
 	if (host->ops->enable && claimed_host && host->claim_cnt == 1)
 		host->ops->enable(host);
+	if (claimed_host && host->cmdq_active && host->cmdq_owner != current)
+		mmc_cmdq_deactivate(host);
 	return claimed_host;
 }
 EXPORT_SYMBOL(mmc_try_claim_host);
@@ -3547,9 +3577,21 @@ int mmc_flush_cache(struct mmc_card *card)
 	if (mmc_card_mmc(card) &&
 			(card->ext_csd.cache_size > 0) &&
 			(card->ext_csd.cache_ctrl & 1)) {
+		/*
+		 * Back to back flushes (fsync storms) with no data written
+		 * in between have nothing left to flush, so they complete
+		 * with the flush that already emptied the cache.
+		 */
+		if (mmc_card_cache_clean(card)) {
+			card->flush_coalesced++;
+			return 0;
+		}
+		card->flush_issued++;
 		err = mmc_switch_ignore_timeout(card, EXT_CSD_CMD_SET_NORMAL,
 						EXT_CSD_FLUSH_CACHE, 1,
 						MMC_FLUSH_REQ_TIMEOUT_MS);
+		if (!err)
+			mmc_card_set_cache_clean(card);
 		if (err == -ETIMEDOUT) {
 			pr_err("%s: cache flush timeout\n",
 					mmc_hostname(card->host));
@@ -3567,6 +3609,115 @@ int mmc_flush_cache(struct mmc_card *card)
 }
 EXPORT_SYMBOL(mmc_flush_cache);
 
+/**
+ *	mmc_cmdq_activate - put card and host in command queue mode
+ *	@host: MMC host, claimed by host->cmdq_owner
+ *
+ *	While active only the owner may send anything to the card; any
+ *	other claim of the host goes back to legacy mode first.
+ */
+int mmc_cmdq_activate(struct mmc_host *host)
+{
+	struct mmc_card *card = host->card;
+	int err;
+
+	if (host->cmdq_active)
+		return 0;
+
+	if (!host->cmdq_ops || !card || !card->ext_csd.cmdq_support)
+		return -EOPNOTSUPP;
+
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			 1, card->ext_csd.generic_cmd6_time);
+	if (err) {
+		pr_err("%s: failed to enable command queue mode %d\n",
+			mmc_hostname(host), err);
+		return err;
+	}
+
+	err = host->cmdq_ops->enable(host);
+	if (err) {
+		pr_err("%s: failed to enable command queue engine %d\n",
+			mmc_hostname(host), err);
+		mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			   0, card->ext_csd.generic_cmd6_time);
+		return err;
+	}
+
+	host->cmdq_active = true;
+	return 0;
+}
+EXPORT_SYMBOL(mmc_cmdq_activate);
+
+/**
+ *	mmc_cmdq_deactivate - bring card and host back to legacy mode
+ *	@host: MMC host, claimed, with no task outstanding
+ *
+ *	If the card does not leave command queue mode it is reset, which
+ *	clears CMDQ_MODE_EN as well.
+ */
+int mmc_cmdq_deactivate(struct mmc_host *host)
+{
+	struct mmc_card *card = host->card;
+	int err;
+
+	if (!host->cmdq_active)
+		return 0;
+
+	host->cmdq_ops->disable(host);
+	host->cmdq_active = false;
+
+	err = mmc_switch(card, EXT_CSD_CMD_SET_NORMAL, EXT_CSD_CMDQ_MODE_EN,
+			 0, card->ext_csd.generic_cmd6_time);
+	if (err) {
+		pr_err("%s: failed to disable command queue mode %d, resetting\n",
+			mmc_hostname(host), err);
+		err = mmc_hw_reset(host);
+	}
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_cmdq_deactivate);
+
+/**
+ *	mmc_cmdq_start_req - queue a task on the command queue engine
+ *	@host: MMC host in command queue mode
+ *	@mrq: request to queue, with cmdq_tag set
+ *
+ *	Returns once the task is queued; mrq->done() is called when the
+ *	card completes it.  Data requests carry the block address in
+ *	mrq->cmd->arg, a request without data is sent as a direct command.
+ */
+int mmc_cmdq_start_req(struct mmc_host *host, struct mmc_request *mrq)
+{
+	int err;
+
+	WARN_ON(!host->claimed);
+
+	if (!host->cmdq_active)
+		return -EBUSY;
+
+	mrq->host = host;
+	mrq->cmd->error = 0;
+	mrq->cmd->mrq = mrq;
+	if (mrq->data) {
+		mrq->cmd->data = mrq->data;
+		mrq->data->error = 0;
+		mrq->data->bytes_xfered = 0;
+		mrq->data->mrq = mrq;
+		if (host->card && (mrq->data->flags & MMC_DATA_WRITE))
+			mmc_card_clr_cache_clean(host->card);
+	}
+
+	mmc_host_clk_hold(host);
+	err = host->cmdq_ops->request(host, mrq);
+	if (err)
+		mmc_host_clk_release(host);
+
+	return err;
+}
+EXPORT_SYMBOL(mmc_cmdq_start_req);
+
 /*
  * Turn the cache ON/OFF.
  * Turning the cache OFF shall trigger flushing of the data
@@ -526,6 +526,24 @@ static ssize_t mmc_wr_pack_stats_read(struct file *filp, char __user *ubuf,
 			pack_stats->pack_stop_reason[FUA]);
 		strlcat(ubuf, temp_buf, cnt);
 	}
+	if (pack_stats->pack_stop_reason[READ_WAITING]) {
+		snprintf(temp_buf, TEMP_BUF_SIZE,
+			 "%s: %d times: read waiting\n",
+			mmc_hostname(card->host),
+			pack_stats->pack_stop_reason[READ_WAITING]);
+		strlcat(ubuf, temp_buf, cnt);
+	}
+
+	snprintf(temp_buf, TEMP_BUF_SIZE,
+		 "%s: packed writes: %u KB/s, %u us avg\n",
+		 mmc_hostname(card->host), pack_stats->packed_kbps,
+		 pack_stats->packed_lat_us);
+	strlcat(ubuf, temp_buf, cnt);
+	snprintf(temp_buf, TEMP_BUF_SIZE,
+		 "%s: single writes: %u KB/s, %u us avg\n",
+		 mmc_hostname(card->host), pack_stats->single_kbps,
+		 pack_stats->single_lat_us);
+	strlcat(ubuf, temp_buf, cnt);
 
 	spin_unlock(&pack_stats->lock);
 
@@ -724,6 +742,15 @@ void mmc_add_card_debugfs(struct mmc_card *card)
 					 &mmc_dbg_wr_pack_stats_fops))
 			goto err;
 
+	if (mmc_card_mmc(card) && (card->ext_csd.cache_size > 0)) {
+		if (!debugfs_create_u32("flush_issued", S_IRUSR, root,
+					&card->flush_issued))
+			goto err;
+		if (!debugfs_create_u32("flush_coalesced", S_IRUSR, root,
+					&card->flush_coalesced))
+			goto err;
+	}
+
 	if (mmc_card_mmc(card) && (card->ext_csd.rev >= 5) &&
 	    card->ext_csd.bkops_en)
 		if (!debugfs_create_file("bkops_stats", S_IRUSR, root, card,
@@ -0,0 +1,466 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * Driver for the command queue engine of eMMC 5.1 hosts.  Tasks are
+ * written to a 32 slot task descriptor list in memory and started with
+ * the doorbell register; the engine queues them in the card, polls the
+ * card queue status and runs them in the order the card picks.  Slot 31
+ * carries direct commands (cache flush) while the queue is active.
+ *
+ * Only 32 bit DMA addresses are used, so each slot holds a 64 bit task
+ * descriptor followed by a 64 bit link to its transfer descriptor list.
+ */
+
+#include <linux/delay.h>
+#include <linux/dma-mapping.h>
+#include <linux/io.h>
+#include <linux/module.h>
+#include <linux/scatterlist.h>
+#include <linux/slab.h>
+#include <linux/mmc/card.h>
+#include <linux/mmc/host.h>
+#include <linux/mmc/mmc.h>
+
+#include "cmdq_hci.h"
+
+#define CQ_HALT_TIMEOUT_US	100000
+#define CQ_TDL_SIZE		(CQ_NUM_SLOTS * 2 * sizeof(u64))
+
+static u64 *get_desc(struct cmdq_host *cq_host, int tag)
+{
+	return cq_host->desc_base + tag * 2;
+}
+
+static u64 *get_link_desc(struct cmdq_host *cq_host, int tag)
+{
+	return get_desc(cq_host, tag) + 1;
+}
+
+static u64 *get_trans_desc(struct cmdq_host *cq_host, int tag)
+{
+	return cq_host->trans_desc_base + tag * cq_host->max_segs;
+}
+
+static dma_addr_t get_trans_desc_dma(struct cmdq_host *cq_host, int tag)
+{
+	return cq_host->trans_desc_dma_base +
+		tag * cq_host->max_segs * sizeof(u64);
+}
+
+static int cmdq_alloc_desc(struct cmdq_host *cq_host)
+{
+	struct device *dev = mmc_dev(cq_host->mmc);
+	size_t trans_size;
+	int tag;
+
+	if (cq_host->desc_base)
+		return 0;
+
+	cq_host->max_segs = cq_host->mmc->max_segs;
+	trans_size = CQ_NUM_SLOTS * cq_host->max_segs * sizeof(u64);
+
+	cq_host->desc_base = dma_alloc_coherent(dev, CQ_TDL_SIZE,
+						&cq_host->desc_dma_base,
+						GFP_KERNEL);
+	if (!cq_host->desc_base)
+		return -ENOMEM;
+
+	cq_host->trans_desc_base = dma_alloc_coherent(dev, trans_size,
+					&cq_host->trans_desc_dma_base,
+					GFP_KERNEL);
+	if (!cq_host->trans_desc_base) {
+		dma_free_coherent(dev, CQ_TDL_SIZE, cq_host->desc_base,
+				  cq_host->desc_dma_base);
+		cq_host->desc_base = NULL;
+		return -ENOMEM;
+	}
+
+	for (tag = 0; tag < CQ_NUM_SLOTS; tag++)
+		*get_link_desc(cq_host, tag) = VALID(1) | ACT(CQ_ACT_LINK) |
+			DAT_ADDR(lower_32_bits(get_trans_desc_dma(cq_host,
+								  tag)));
+
+	return 0;
+}
+
+static int cmdq_enable(struct mmc_host *mmc)
+{
+	struct cmdq_host *cq_host = mmc->cmdq_private;
+	unsigned long flags;
+	int err;
+
+	if (cq_host->enabled)
+		return 0;
+
+	err = cmdq_alloc_desc(cq_host);
+	if (err)
+		return err;
+
+	if (cq_host->ops->enable)
+		cq_host->ops->enable(mmc);
+
+	cmdq_writel(cq_host, 0, CQCFG);
+	cmdq_writel(cq_host, lower_32_bits(cq_host->desc_dma_base), CQTDLBA);
+	cmdq_writel(cq_host, upper_32_bits(cq_host->desc_dma_base), CQTDLBAU);
+	cmdq_writel(cq_host, mmc->card->rca, CQSSC2);
+	cmdq_writel(cq_host, CQ_INT_ALL, CQISTE);
+	cmdq_writel(cq_host, CQ_INT_ALL, CQISGE);
+	/* the list base must be set before the engine is enabled */
+	wmb();
+	cmdq_writel(cq_host, CQ_DCMD | CQ_ENABLE, CQCFG);
+
+	spin_lock_irqsave(&cq_host->lock, flags);
+	cq_host->err_tag = -1;
+	cq_host->recovering = false;
+	cq_host->enabled = true;
+	spin_unlock_irqrestore(&cq_host->lock, flags);
+
+	return 0;
+}
+
+static void __cmdq_disable(struct cmdq_host *cq_host)
+{
+	cq_host->enabled = false;
+	cmdq_writel(cq_host, 0, CQISGE);
+	cmdq_writel(cq_host, 0, CQCFG);
+}
+
+static void cmdq_disable(struct mmc_host *mmc)
+{
+	struct cmdq_host *cq_host = mmc->cmdq_private;
+	unsigned long flags;
+	bool was_enabled;
+
+	flush_work(&cq_host->recovery_work);
+
+	spin_lock_irqsave(&cq_host->lock, flags);
+	was_enabled = cq_host->enabled;
+	if (was_enabled)
+		__cmdq_disable(cq_host);
+	spin_unlock_irqrestore(&cq_host->lock, flags);
+
+	if (was_enabled && cq_host->ops->disable)
+		cq_host->ops->disable(mmc);
+}
+
+static int cmdq_prep_tran_desc(struct cmdq_host *cq_host,
+			       struct mmc_request *mrq)
+{
+	struct mmc_data *data = mrq->data;
+	u64 *desc = get_trans_desc(cq_host, mrq->cmdq_tag);
+	struct scatterlist *sg;
+	int i, sg_count;
+
+	sg_count = dma_map_sg(mmc_dev(cq_host->mmc), data->sg, data->sg_len,
+			      (data->flags & MMC_DATA_READ) ?
+			      DMA_FROM_DEVICE : DMA_TO_DEVICE);
+	if (!sg_count)
+		return -ENOMEM;
+
+	if (sg_count > cq_host->max_segs) {
+		dma_unmap_sg(mmc_dev(cq_host->mmc), data->sg, data->sg_len,
+			     (data->flags & MMC_DATA_READ) ?
+			     DMA_FROM_DEVICE : DMA_TO_DEVICE);
+		return -EINVAL;
+	}
+
+	/* a 64KB segment is encoded as length 0 */
+	for_each_sg(data->sg, sg, sg_count, i)
+		desc[i] = VALID(1) | END(i == sg_count - 1) |
+			ACT(CQ_ACT_TRAN) | DAT_LENGTH(sg_dma_len(sg)) |
+			DAT_ADDR(lower_32_bits(sg_dma_address(sg)));
+
+	return 0;
+}
+
+static void cmdq_prep_task_desc(struct mmc_request *mrq, u64 *desc)
+{
+	struct mmc_data *data = mrq->data;
+
+	*desc = VALID(1) | END(1) | INT(1) | ACT(CQ_ACT_TASK) |
+		DATA_DIR(!!(data->flags & MMC_DATA_READ)) |
+		PRIORITY(!!(mrq->cmdq_flags & MMC_CMDQ_PRIO)) |
+		QBAR(!!(mrq->cmdq_flags & MMC_CMDQ_QBR)) |
+		REL_WRITE(!!(mrq->cmdq_flags & MMC_CMDQ_REL_WR)) |
+		BLK_COUNT(data->blocks) | BLK_ADDR(mrq->cmd->arg);
+}
+
+static void cmdq_prep_dcmd_desc(struct mmc_request *mrq, u64 *desc)
+{
+	struct mmc_command *cmd = mrq->cmd;
+	int resp_type, timing;
+
+	if (!(cmd->flags & MMC_RSP_PRESENT)) {
+		resp_type = 0x0;
+		timing = 0x1;
+	} else if (cmd->flags & MMC_RSP_BUSY) {
+		resp_type = 0x3;
+		timing = 0x0;
+	} else {
+		resp_type = 0x2;
+		timing = 0x1;
+	}
+
+	*desc = VALID(1) | END(1) | INT(1) | ACT(CQ_ACT_TASK) | QBAR(1) |
+		CMD_INDEX(cmd->opcode) | CMD_TIMING(timing) |
+		RESP_TYPE(resp_type) | CMD_ARG(cmd->arg);
+}
+
+static void cmdq_unmap(struct cmdq_host *cq_host, struct mmc_request *mrq)
+{
+	struct mmc_data *data = mrq->data;
+
+	if (data)
+		dma_unmap_sg(mmc_dev(cq_host->mmc), data->sg, data->sg_len,
+			     (data->flags & MMC_DATA_READ) ?
+			     DMA_FROM_DEVICE : DMA_TO_DEVICE);
+}
+
+static int cmdq_request(struct mmc_host *mmc, struct mmc_request *mrq)
+{
+	struct cmdq_host *cq_host = mmc->cmdq_private;
+	int tag = mrq->cmdq_tag;
+	unsigned long flags;
+	int err = 0;
+
+	if (tag < 0 || tag >= CQ_NUM_SLOTS ||
+	    (!mrq->data && tag != CQ_DCMD_SLOT))
+		return -EINVAL;
+
+	if (mrq->data) {
+		err = cmdq_prep_tran_desc(cq_host, mrq);
+		if (err)
+			return err;
+		cmdq_prep_task_desc(mrq, get_desc(cq_host, tag));
+	} else {
+		cmdq_prep_dcmd_desc(mrq, get_desc(cq_host, tag));
+	}
+
+	spin_lock_irqsave(&cq_host->lock, flags);
+	if (!cq_host->enabled || cq_host->recovering ||
+	    cq_host->mrq_slot[tag]) {
+		err = -EBUSY;
+	} else {
+		cq_host->mrq_slot[tag] = mrq;
+		/* descriptors must reach memory before the doorbell */
+		wmb();
+		cmdq_writel(cq_host, 1 << tag, CQTDBR);
+	}
+	spin_unlock_irqrestore(&cq_host->lock, flags);
+
+	if (err)
+		cmdq_unmap(cq_host, mrq);
+
+	return err;
+}
+
+/* Called with cq_host->lock held */
+static struct mmc_request *cmdq_finish_slot(struct cmdq_host *cq_host,
+					    int tag, int err)
+{
+	struct mmc_request *mrq = cq_host->mrq_slot[tag];
+
+	if (!mrq)
+		return NULL;
+
+	cq_host->mrq_slot[tag] = NULL;
+	if (mrq->data) {
+		mrq->data->error = err;
+		if (!err)
+			mrq->data->bytes_xfered =
+				mrq->data->blksz * mrq->data->blocks;
+	} else {
+		mrq->cmd->error = err;
+		if (!err)
+			mrq->cmd->resp[0] = cmdq_readl(cq_host, CQCRDCT);
+	}
+
+	return mrq;
+}
+
+static void cmdq_complete(struct cmdq_host *cq_host,
+			  struct mmc_request **done, int nr)
+{
+	int i;
+
+	for (i = 0; i < nr; i++) {
+		cmdq_unmap(cq_host, done[i]);
+		mmc_cmdq_request_done(cq_host->mmc, done[i]);
+	}
+}
+
+/*
+ * Halts the engine, drops every queued task and fails whatever is still
+ * outstanding.  The task that reported the error gets -EIO, the others
+ * -EAGAIN; the block layer retries all of them in legacy mode.
+ */
+static void cmdq_recovery_work(struct work_struct *work)
+{
+	struct cmdq_host *cq_host = container_of(work, struct cmdq_host,
+						 recovery_work);
+	struct mmc_request *done[CQ_NUM_SLOTS];
+	unsigned long flags;
+	int tag, nr = 0, timeout;
+
+	cmdq_writel(cq_host, HALT, CQCTL);
+	for (timeout = CQ_HALT_TIMEOUT_US; timeout > 0; timeout -= 10) {
+		if (cmdq_readl(cq_host, CQCTL) & HALT)
+			break;
+		udelay(10);
+	}
+	if (timeout <= 0)
+		pr_err("%s: %s: halt timed out\n",
+			mmc_hostname(cq_host->mmc), __func__);
+
+	cmdq_writel(cq_host, CLEAR_ALL_TASKS, CQCTL);
+	for (timeout = CQ_HALT_TIMEOUT_US; timeout > 0; timeout -= 10) {
+		if (!cmdq_readl(cq_host, CQTDBR))
+			break;
+		udelay(10);
+	}
+
+	spin_lock_irqsave(&cq_host->lock, flags);
+	for (tag = 0; tag < CQ_NUM_SLOTS; tag++) {
+		struct mmc_request *mrq;
+
+		mrq = cmdq_finish_slot(cq_host, tag,
+				tag == cq_host->err_tag ? -EIO : -EAGAIN);
+		if (mrq)
+			done[nr++] = mrq;
+	}
+	__cmdq_disable(cq_host);
+	spin_unlock_irqrestore(&cq_host->lock, flags);
+
+	if (cq_host->ops->disable)
+		cq_host->ops->disable(cq_host->mmc);
+
+	cmdq_complete(cq_host, done, nr);
+}
+
+static void cmdq_abort(struct mmc_host *mmc)
+{
+	struct cmdq_host *cq_host = mmc->cmdq_private;
+	unsigned long flags;
+
+	spin_lock_irqsave(&cq_host->lock, flags);
+	if (cq_host->enabled && !cq_host->recovering) {
+		cq_host->recovering = true;
+		schedule_work(&cq_host->recovery_work);
+	}
+	spin_unlock_irqrestore(&cq_host->lock, flags);
+}
+
+/**
+ * cmdq_irq - handle a command queue interrupt
+ * @mmc: host with the engine enabled
+ * @intmask: error bits the host controller reported along with it
+ *
+ * Returns IRQ_NONE when the engine is not enabled, so that the caller
+ * handles the interrupt in legacy mode.
+ */
+irqreturn_t cmdq_irq(struct mmc_host *mmc, u32 intmask)
+{
+	struct cmdq_host *cq_host = mmc->cmdq_private;
+	struct mmc_request *done[CQ_NUM_SLOTS];
+	unsigned long comp;
+	u32 status, terri;
+	int tag, nr = 0;
+
+	if (!cq_host)
+		return IRQ_NONE;
+
+	spin_lock(&cq_host->lock);
+	if (!cq_host->enabled) {
+		spin_unlock(&cq_host->lock);
+		return IRQ_NONE;
+	}
+
+	status = cmdq_readl(cq_host, CQIS);
+	cmdq_writel(cq_host, status, CQIS);
+
+	if ((status & CQIS_RED) || intmask) {
+		terri = cmdq_readl(cq_host, CQTERRI);
+		if (terri & CQ_DTEFV)
+			cq_host->err_tag = CQ_DTETI(terri);
+		else if (terri & CQ_RMEFV)
+			cq_host->err_tag = CQ_RMETI(terri);
+		pr_err("%s: cmdq error: status 0x%08x host 0x%08x terri 0x%08x\n",
+			mmc_hostname(mmc), status, intmask, terri);
+		if (!cq_host->recovering) {
+			cq_host->recovering = true;
+			schedule_work(&cq_host->recovery_work);
+		}
+	}
+
+	if (status & CQIS_TCC) {
+		comp = cmdq_readl(cq_host, CQTCN);
+		cmdq_writel(cq_host, comp, CQTCN);
+		for_each_set_bit(tag, &comp, CQ_NUM_SLOTS) {
+			struct mmc_request *mrq;
+
+			/* the failed task is completed by the recovery */
+			if (tag == cq_host->err_tag)
+				continue;
+			mrq = cmdq_finish_slot(cq_host, tag, 0);
+			if (mrq)
+				done[nr++] = mrq;
+		}
+	}
+	spin_unlock(&cq_host->lock);
+
+	cmdq_complete(cq_host, done, nr);
+
+	return IRQ_HANDLED;
+}
+EXPORT_SYMBOL(cmdq_irq);
+
+static const struct mmc_cmdq_host_ops cmdq_host_ops = {
+	.enable = cmdq_enable,
+	.disable = cmdq_disable,
+	.request = cmdq_request,
+	.abort = cmdq_abort,
+};
+
+/**
+ * cmdq_init - register the command queue engine of a host
+ * @cq_host: engine state, owned by the host driver
+ * @mmc: host the engine belongs to
+ * @mmio: mapped engine registers
+ * @ops: host driver hooks run when entering and leaving CQ mode
+ *
+ * Descriptor memory is allocated the first time the engine is enabled,
+ * once the host has settled its segment limits.
+ */
+int cmdq_init(struct cmdq_host *cq_host, struct mmc_host *mmc,
+	      void __iomem *mmio, const struct cmdq_host_ops *ops)
+{
+	cq_host->mmc = mmc;
+	cq_host->mmio = mmio;
+	cq_host->ops = ops;
+	cq_host->err_tag = -1;
+	spin_lock_init(&cq_host->lock);
+	INIT_WORK(&cq_host->recovery_work, cmdq_recovery_work);
+
+	mmc->cmdq_private = cq_host;
+	mmc->cmdq_ops = &cmdq_host_ops;
+	mmc->caps2 |= MMC_CAP2_CMD_QUEUE;
+
+	pr_info("%s: command queue engine version 0x%08x\n",
+		mmc_hostname(mmc), cmdq_readl(cq_host, CQVER));
+
+	return 0;
+}
+EXPORT_SYMBOL(cmdq_init);
+
+MODULE_DESCRIPTION("eMMC command queue host controller driver");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,148 @@
+/* Copyright (c) 2015, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+#ifndef LINUX_MMC_CQ_HCI_H
+#define LINUX_MMC_CQ_HCI_H
+
+#include <linux/interrupt.h>
+#include <linux/spinlock.h>
+#include <linux/workqueue.h>
+
+/* registers of the JEDEC command queuing host controller interface */
+#define CQVER		0x00
+#define CQCAP		0x04
+
+#define CQCFG		0x08
+#define CQ_DCMD		0x00001000
+#define CQ_TASK_DESC_SZ	0x00000100
+#define CQ_ENABLE	0x00000001
+
+#define CQCTL		0x0C
+#define CLEAR_ALL_TASKS	0x00000100
+#define HALT		0x00000001
+
+#define CQIS		0x10
+#define CQISTE		0x14
+#define CQISGE		0x18
+#define CQIC		0x1C
+#define CQIS_HAC	(1 << 0)
+#define CQIS_TCC	(1 << 1)
+#define CQIS_RED	(1 << 2)
+#define CQIS_TCL	(1 << 3)
+#define CQ_INT_ALL	0xF
+
+#define CQTDLBA		0x20
+#define CQTDLBAU	0x24
+#define CQTDBR		0x28
+#define CQTCN		0x2C
+#define CQDQS		0x30
+#define CQDPT		0x34
+#define CQTCLR		0x38
+#define CQSSC1		0x40
+#define CQSSC2		0x44
+#define CQCRDCT		0x48
+#define CQRMEM		0x50
+
+#define CQTERRI		0x54
+#define CQ_RMEFV	(1 << 15)
+#define CQ_RMETI(x)	(((x) >> 8) & 0x1F)
+#define CQ_DTEFV	(1 << 31)
+#define CQ_DTETI(x)	(((x) >> 24) & 0x1F)
+
+#define CQCRI		0x58
+#define CQCRA		0x5C
+
+#define CQ_NUM_SLOTS	32
+#define CQ_DCMD_SLOT	(CQ_NUM_SLOTS - 1)
+
+/* task descriptor fields, 64 bit descriptors */
+#define VALID(x)	(((x) & 1) << 0)
+#define END(x)		(((x) & 1) << 1)
+#define INT(x)		(((x) & 1) << 2)
+#define ACT(x)		(((x) & 7) << 3)
+#define CONTEXT(x)	(((x) & 0xF) << 7)
+#define DATA_DIR(x)	(((x) & 1) << 12)
+#define PRIORITY(x)	(((x) & 1) << 13)
+#define QBAR(x)		(((x) & 1) << 14)
+#define REL_WRITE(x)	(((x) & 1) << 15)
+#define BLK_COUNT(x)	(((x) & 0xFFFF) << 16)
+#define BLK_ADDR(x)	((u64)(x) << 32)
+
+/* direct command fields */
+#define CMD_INDEX(x)	(((x) & 0x3F) << 16)
+#define CMD_TIMING(x)	(((x) & 1) << 22)
+#define RESP_TYPE(x)	(((x) & 0x3) << 23)
+#define CMD_ARG(x)	((u64)(x) << 32)
+
+/* transfer and link descriptor fields, 32 bit addressing */
+#define DAT_LENGTH(x)	(((x) & 0xFFFF) << 16)
+#define DAT_ADDR(x)	((u64)(x) << 32)
+
+#define CQ_ACT_TASK	0x5
+#define CQ_ACT_TRAN	0x4
+#define CQ_ACT_LINK	0x6
+
+struct mmc_host;
+struct mmc_request;
+
+/* controller glue, e.g. routing the SDHCI engine to the CQ engine */
+struct cmdq_host_ops {
+	void (*enable)(struct mmc_host *mmc);
+	void (*disable)(struct mmc_host *mmc);
+};
+
+struct cmdq_host {
+	const struct cmdq_host_ops *ops;
+	void __iomem *mmio;
+	struct mmc_host *mmc;
+	spinlock_t lock;
+	bool enabled;
+	bool recovering;
+
+	/* task descriptor list, one task and one link descriptor per slot */
+	u64 *desc_base;
+	dma_addr_t desc_dma_base;
+	/* max_segs transfer descriptors per slot */
+	u64 *trans_desc_base;
+	dma_addr_t trans_desc_dma_base;
+	int max_segs;
+
+	struct mmc_request *mrq_slot[CQ_NUM_SLOTS];
+	int err_tag;
+	struct work_struct recovery_work;
+};
+
+static inline void cmdq_writel(struct cmdq_host *host, u32 val, int reg)
+{
+	writel_relaxed(val, host->mmio + reg);
+}
+
+static inline u32 cmdq_readl(struct cmdq_host *host, int reg)
+{
+	return readl_relaxed(host->mmio + reg);
+}
+
+#ifdef CONFIG_MMC_CQ_HCI
+extern int cmdq_init(struct cmdq_host *cq_host, struct mmc_host *mmc,
+		     void __iomem *mmio, const struct cmdq_host_ops *ops);
+extern irqreturn_t cmdq_irq(struct mmc_host *mmc, u32 intmask);
+#else
+static inline int cmdq_init(struct cmdq_host *cq_host, struct mmc_host *mmc,
+			    void __iomem *mmio, const struct cmdq_host_ops *ops)
+{
+	return -ENOSYS;
+}
+static inline irqreturn_t cmdq_irq(struct mmc_host *mmc, u32 intmask)
+{
+	return IRQ_NONE;
+}
+#endif
+#endif
@@ -43,6 +43,7 @@
 #include <linux/msm-bus.h>
 
 #include "sdhci-pltfm.h"
+#include "cmdq_hci.h"
 
 enum sdc_mpm_pin_state {
 	SDC_DAT1_DISABLE,
@@ -338,6 +339,9 @@ struct sdhci_msm_host {
 	struct device_attribute auto_cmd21_attr;
 	bool is_sdiowakeup_enabled;
 	atomic_t controller_clock;
+	struct cmdq_host cq_host;
+	u32 cmdq_saved_ier;	/* SDHCI interrupts outside CQ mode */
+	u32 cmdq_saved_sig;
 };
 
 enum vdd_io_level {
@@ -2843,6 +2847,87 @@ static void sdhci_set_default_hw_caps(struct sdhci_msm_host *msm_host,
 	}
 }
 
+#ifdef CONFIG_MMC_CQ_HCI
+/*
+ * The CQ engine moves data through the SDHCI ADMA engine, set up for
+ * 512 byte ADMA2 transfers, and reports through the SDHCI interrupt.
+ */
+static void sdhci_msm_cmdq_enable(struct mmc_host *mmc)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_msm_host *msm_host = pltfm_host->priv;
+	unsigned long flags;
+	u8 ctrl;
+
+	spin_lock_irqsave(&host->lock, flags);
+	msm_host->cmdq_saved_ier = sdhci_readl(host, SDHCI_INT_ENABLE);
+	msm_host->cmdq_saved_sig = sdhci_readl(host, SDHCI_SIGNAL_ENABLE);
+
+	ctrl = sdhci_readb(host, SDHCI_HOST_CONTROL);
+	ctrl &= ~SDHCI_CTRL_DMA_MASK;
+	ctrl |= SDHCI_CTRL_ADMA32;
+	sdhci_writeb(host, ctrl, SDHCI_HOST_CONTROL);
+	sdhci_writew(host, SDHCI_MAKE_BLKSZ(7, 512), SDHCI_BLOCK_SIZE);
+	sdhci_writeb(host, 0xE, SDHCI_TIMEOUT_CONTROL);
+
+	sdhci_writel(host, SDHCI_INT_CMDQ | SDHCI_INT_ERROR_MASK,
+		     SDHCI_INT_ENABLE);
+	sdhci_writel(host, SDHCI_INT_CMDQ | SDHCI_INT_ERROR_MASK,
+		     SDHCI_SIGNAL_ENABLE);
+	spin_unlock_irqrestore(&host->lock, flags);
+}
+
+static void sdhci_msm_cmdq_disable(struct mmc_host *mmc)
+{
+	struct sdhci_host *host = mmc_priv(mmc);
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_msm_host *msm_host = pltfm_host->priv;
+	unsigned long flags;
+
+	spin_lock_irqsave(&host->lock, flags);
+	sdhci_writel(host, msm_host->cmdq_saved_ier, SDHCI_INT_ENABLE);
+	sdhci_writel(host, msm_host->cmdq_saved_sig, SDHCI_SIGNAL_ENABLE);
+	spin_unlock_irqrestore(&host->lock, flags);
+}
+
+static const struct cmdq_host_ops sdhci_msm_cmdq_ops = {
+	.enable = sdhci_msm_cmdq_enable,
+	.disable = sdhci_msm_cmdq_disable,
+};
+
+/* The engine is only described on controllers that have one */
+static void sdhci_msm_cmdq_init(struct sdhci_host *host,
+				struct platform_device *pdev)
+{
+	struct sdhci_pltfm_host *pltfm_host = sdhci_priv(host);
+	struct sdhci_msm_host *msm_host = pltfm_host->priv;
+	struct resource *cmdq_memres;
+	void __iomem *cmdq_mem;
+
+	cmdq_memres = platform_get_resource_byname(pdev, IORESOURCE_MEM,
+						   "cmdq_mem");
+	if (!cmdq_memres)
+		return;
+
+	cmdq_mem = devm_ioremap(&pdev->dev, cmdq_memres->start,
+				resource_size(cmdq_memres));
+	if (!cmdq_mem) {
+		dev_err(&pdev->dev, "Failed to remap cmdq registers\n");
+		return;
+	}
+
+	if (cmdq_init(&msm_host->cq_host, host->mmc, cmdq_mem,
+		      &sdhci_msm_cmdq_ops))
+		dev_err(&pdev->dev, "Failed to init command queue engine\n");
+}
+#else
+static inline void sdhci_msm_cmdq_init(struct sdhci_host *host,
+				       struct platform_device *pdev)
+{
+}
+#endif
+
 static int sdhci_msm_probe(struct platform_device *pdev)
 {
 	struct sdhci_host *host;
@@ -3161,6 +3246,8 @@ static int sdhci_msm_probe(struct platform_device *pdev)
 		}
 	}
 
+	sdhci_msm_cmdq_init(host, pdev);
+
 	ret = sdhci_add_host(host);
 	if (ret) {
 		dev_err(&pdev->dev, "Add host failed (%d)\n", ret);
@@ -32,6 +32,7 @@
 #include <linux/mmc/sdio.h>
 
 #include "sdhci.h"
+#include "cmdq_hci.h"
 
 #define DRIVER_NAME "sdhci"
 #define SDHCI_SUSPEND_TIMEOUT 300 /* 300 ms */
@@ -3031,6 +3032,20 @@ static irqreturn_t sdhci_irq(int irq, void *dev_id)
 		goto out;
 	}
 
+	/*
+	 * In command queue mode transfers are driven by the CQ engine, which
+	 * reports through the CMDQ bit; errors still show up here.
+	 */
+	if (host->mmc->cmdq_active &&
+	    (intmask & (SDHCI_INT_CMDQ | SDHCI_INT_ERROR_MASK))) {
+		sdhci_writel(host, intmask, SDHCI_INT_STATUS);
+		spin_unlock(&host->lock);
+		if (cmdq_irq(host->mmc, intmask & SDHCI_INT_ERROR_MASK) ==
+		    IRQ_HANDLED)
+			return IRQ_HANDLED;
+		spin_lock(&host->lock);
+	}
+
 again:
 	DBG("*** %s got interrupt: 0x%08x\n",
 		mmc_hostname(host->mmc), intmask);
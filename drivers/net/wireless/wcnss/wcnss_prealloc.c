@@ -13,44 +13,130 @@
 #include <linux/slab.h>
 #include <linux/err.h>
 #include <linux/wcnss_wlan.h>
-#include <linux/spinlock.h>
-
-static DEFINE_SPINLOCK(alloc_lock);
+#include <linux/bitops.h>
+#include <linux/atomic.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 struct wcnss_prealloc {
-	int occupied;
 	unsigned int size;
 	void *ptr;
 };
 
-/* pre-alloced mem for WLAN driver */
+/* pre-alloced mem for WLAN driver, must be sorted by size */
 static struct wcnss_prealloc wcnss_allocs[] = {
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 8  * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 32 * 1024, NULL},
-	{0, 64 * 1024, NULL},
-	{0, 64 * 1024, NULL},
+	{8  * 1024, NULL},
+	{8  * 1024, NULL},
+	{8  * 1024, NULL},
+	{8  * 1024, NULL},
+	{32 * 1024, NULL},
+	{32 * 1024, NULL},
+	{32 * 1024, NULL},
+	{32 * 1024, NULL},
+	{32 * 1024, NULL},
+	{32 * 1024, NULL},
+	{32 * 1024, NULL},
+	{64 * 1024, NULL},
+	{64 * 1024, NULL},
+};
+
+/*
+ * Slots of the same size form a bucket. A slot is claimed and released
+ * with atomic bit operations on wcnss_occupied, so get and put never
+ * take a lock and only look at buckets large enough for the request.
+ */
+struct wcnss_prealloc_bucket {
+	unsigned int size;
+	int first;
+	int count;
+	atomic_t used;
+	atomic_t peak;
+	atomic_t hits;
+};
+
+static DECLARE_BITMAP(wcnss_occupied, ARRAY_SIZE(wcnss_allocs));
+static struct wcnss_prealloc_bucket wcnss_buckets[ARRAY_SIZE(wcnss_allocs)];
+static int wcnss_nr_buckets;
+
+/* requests no slot could satisfy; the caller falls back to the heap */
+static atomic_t wcnss_prealloc_misses = ATOMIC_INIT(0);
+
+static struct dentry *wcnss_prealloc_dent;
+
+static void wcnss_prealloc_bucket_get(struct wcnss_prealloc_bucket *b)
+{
+	int used = atomic_inc_return(&b->used);
+	int peak = atomic_read(&b->peak);
+
+	while (used > peak) {
+		int old = atomic_cmpxchg(&b->peak, peak, used);
+
+		if (old == peak)
+			break;
+		peak = old;
+	}
+	atomic_inc(&b->hits);
+}
+
+static int wcnss_prealloc_show(struct seq_file *s, void *unused)
+{
+	struct wcnss_prealloc_bucket *b;
+	int i;
+
+	seq_printf(s, "%8s %5s %5s %5s %10s\n",
+		   "size", "slots", "used", "peak", "hits");
+	for (i = 0; i < wcnss_nr_buckets; i++) {
+		b = &wcnss_buckets[i];
+		seq_printf(s, "%8u %5d %5d %5d %10d\n", b->size, b->count,
+			   atomic_read(&b->used), atomic_read(&b->peak),
+			   atomic_read(&b->hits));
+	}
+	seq_printf(s, "fallback: %d\n", atomic_read(&wcnss_prealloc_misses));
+
+	return 0;
+}
+
+static int wcnss_prealloc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, wcnss_prealloc_show, inode->i_private);
+}
+
+static const struct file_operations wcnss_prealloc_fops = {
+	.open		= wcnss_prealloc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
 };
 
 int wcnss_prealloc_init(void)
 {
+	struct wcnss_prealloc_bucket *b = NULL;
 	int i;
 
+	bitmap_zero(wcnss_occupied, ARRAY_SIZE(wcnss_allocs));
+	wcnss_nr_buckets = 0;
+
 	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		wcnss_allocs[i].occupied = 0;
 		wcnss_allocs[i].ptr = kmalloc(wcnss_allocs[i].size, GFP_KERNEL);
 		if (wcnss_allocs[i].ptr == NULL)
 			return -ENOMEM;
+
+		if (!b || b->size != wcnss_allocs[i].size) {
+			b = &wcnss_buckets[wcnss_nr_buckets++];
+			b->size = wcnss_allocs[i].size;
+			b->first = i;
+			b->count = 0;
+			atomic_set(&b->used, 0);
+			atomic_set(&b->peak, 0);
+			atomic_set(&b->hits, 0);
+		}
+		b->count++;
 	}
 
+	wcnss_prealloc_dent = debugfs_create_file("wcnss_prealloc", S_IRUGO,
+						  NULL, NULL,
+						  &wcnss_prealloc_fops);
+
 	return 0;
 }
 
@@ -58,6 +144,9 @@ void wcnss_prealloc_deinit(void)
 {
 	int i = 0;
 
+	debugfs_remove(wcnss_prealloc_dent);
+	wcnss_prealloc_dent = NULL;
+
 	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
 		kfree(wcnss_allocs[i].ptr);
 		wcnss_allocs[i].ptr = NULL;
@@ -66,22 +155,25 @@ void wcnss_prealloc_deinit(void)
 
 void *wcnss_prealloc_get(unsigned int size)
 {
-	int i = 0;
-	unsigned long flags;
+	struct wcnss_prealloc_bucket *b;
+	int i, j;
 
-	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].occupied)
+	for (i = 0; i < wcnss_nr_buckets; i++) {
+		b = &wcnss_buckets[i];
+		if (b->size <= size)
 			continue;
 
-		if (wcnss_allocs[i].size > size) {
+		for (j = b->first; j < b->first + b->count; j++) {
+			if (test_and_set_bit(j, wcnss_occupied))
+				continue;
+
 			/* we found the slot */
-			wcnss_allocs[i].occupied = 1;
-			spin_unlock_irqrestore(&alloc_lock, flags);
-			return wcnss_allocs[i].ptr;
+			wcnss_prealloc_bucket_get(b);
+			return wcnss_allocs[j].ptr;
 		}
 	}
-	spin_unlock_irqrestore(&alloc_lock, flags);
+
+	atomic_inc(&wcnss_prealloc_misses);
 	pr_err("wcnss: %s: prealloc not available for size: %d\n",
 			__func__, size);
 
@@ -91,18 +183,20 @@ EXPORT_SYMBOL(wcnss_prealloc_get);
 
 int wcnss_prealloc_put(void *ptr)
 {
-	int i = 0;
-	unsigned long flags;
+	struct wcnss_prealloc_bucket *b;
+	int i, j;
 
-	spin_lock_irqsave(&alloc_lock, flags);
-	for (i = 0; i < ARRAY_SIZE(wcnss_allocs); i++) {
-		if (wcnss_allocs[i].ptr == ptr) {
-			wcnss_allocs[i].occupied = 0;
-			spin_unlock_irqrestore(&alloc_lock, flags);
+	for (i = 0; i < wcnss_nr_buckets; i++) {
+		b = &wcnss_buckets[i];
+		for (j = b->first; j < b->first + b->count; j++) {
+			if (wcnss_allocs[j].ptr != ptr)
+				continue;
+
+			if (test_and_clear_bit(j, wcnss_occupied))
+				atomic_dec(&b->used);
 			return 1;
 		}
 	}
-	spin_unlock_irqrestore(&alloc_lock, flags);
 
 	return 0;
 }
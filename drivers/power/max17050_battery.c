@@ -458,7 +458,8 @@ static void max17050_update_ext_temp(struct work_struct *work)
 		chip->ext_battery = power_supply_get_by_name("battery");
 	if (!chip->ext_battery) {
 		/* Power supply not ready - try again soon */
-		schedule_delayed_work(&chip->ext_batt_work,
+		queue_delayed_work(system_power_efficient_wq,
+				&chip->ext_batt_work,
 					msecs_to_jiffies(EXT_BATT_FAST_PERIOD));
 		return;
 	}
@@ -479,7 +480,7 @@ static void max17050_update_ext_temp(struct work_struct *work)
 	}
 
 	/* Update again after some time */
-	schedule_delayed_work(&chip->ext_batt_work,
+	queue_delayed_work(system_power_efficient_wq, &chip->ext_batt_work,
 					msecs_to_jiffies(EXT_BATT_SLOW_PERIOD));
 }
 
@@ -684,7 +685,8 @@ static void max17050_complete_init(struct max17050_chip *chip)
 	}
 
 	if (chip->use_ext_temp && chip->pdata->ext_batt_psy)
-		schedule_delayed_work(&chip->ext_batt_work, 0);
+		queue_delayed_work(system_power_efficient_wq,
+					&chip->ext_batt_work, 0);
 
 	chip->init_done = true;
 }
@@ -845,7 +847,7 @@ static int max17050_probe(struct i2c_client *client,
 
 	chip->use_ext_temp = !!(chip->pdata->config & CFG_EXT_TEMP_BIT);
 	if (chip->use_ext_temp && chip->pdata->ext_batt_psy)
-		INIT_DELAYED_WORK(&chip->ext_batt_work,
+		INIT_DEFERRABLE_WORK(&chip->ext_batt_work,
 						max17050_update_ext_temp);
 
 	if (client->irq) {
@@ -934,7 +936,8 @@ static void max17050_pm_complete(struct device *dev)
 
 	/* Schedule a temperature update, if needed */
 	if (chip->use_ext_temp && chip->pdata->ext_batt_psy)
-		schedule_delayed_work(&chip->ext_batt_work, 0);
+		queue_delayed_work(system_power_efficient_wq,
+					&chip->ext_batt_work, 0);
 }
 
 static const struct dev_pm_ops max17050_pm_ops = {
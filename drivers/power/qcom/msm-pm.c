@@ -495,8 +495,10 @@ static enum msm_pm_time_stats_id (*execute[MSM_PM_SLEEP_MODE_NR])(bool idle) = {
  *
  * The code should be with interrupts disabled and on the core on which the
  * low power is to be executed.
+ *
+ * Returns false if a power collapse was aborted, true otherwise.
  */
-void msm_cpu_pm_enter_sleep(enum msm_pm_sleep_mode mode, bool from_idle)
+bool msm_cpu_pm_enter_sleep(enum msm_pm_sleep_mode mode, bool from_idle)
 {
 	int64_t time = 0;
 	enum msm_pm_time_stats_id exit_stat = -1;
@@ -519,6 +521,9 @@ void msm_cpu_pm_enter_sleep(enum msm_pm_sleep_mode mode, bool from_idle)
 			msm_pm_add_stat(exit_stat, time);
 	}
 
+	return exit_stat != MSM_PM_STAT_IDLE_FAILED_STANDALONE_POWER_COLLAPSE &&
+		exit_stat != MSM_PM_STAT_IDLE_FAILED_POWER_COLLAPSE &&
+		exit_stat != MSM_PM_STAT_FAILED_SUSPEND;
 }
 
 /**
@@ -19,6 +19,9 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/debugfs.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/msm_pm_stats.h>
 #include <soc/qcom/spm.h>
 #include <soc/qcom/pm.h>
 
@@ -591,6 +594,95 @@ l2_err:
 	return false;
 }
 
+/*
+ * Binary snapshot of the count and total time of every enabled per-cpu
+ * mode and of the L2 modes (reported with cpu ~0), see
+ * <linux/msm_pm_stats.h>.
+ */
+struct msm_pm_stats_bin {
+	size_t len;
+	struct msm_pm_stats_snapshot_hdr hdr;
+	struct msm_lpm_stats_record rec[];
+};
+
+#define MSM_PM_STATS_BIN_MAX_RECORDS \
+	(NR_CPUS * MSM_PM_STAT_COUNT + MSM_SPM_L2_MODE_LAST)
+
+static void msm_pm_stats_bin_fill(struct msm_lpm_stats_record *rec,
+		const struct msm_pm_time_stats *stats, unsigned int cpu)
+{
+	strlcpy(rec->name, stats->name, sizeof(rec->name));
+	rec->cpu = cpu;
+	rec->count = stats->count;
+	rec->total_time = stats->total_time;
+}
+
+static void msm_pm_stats_bin_snapshot(struct msm_pm_stats_bin *bin)
+{
+	struct msm_lpm_stats_record *rec = bin->rec;
+	struct msm_pm_time_stats *stats;
+	unsigned long flags;
+	unsigned int cpu;
+	int id;
+
+	spin_lock_irqsave(&msm_pm_stats_lock, flags);
+	for_each_possible_cpu(cpu) {
+		stats = per_cpu(msm_pm_stats, cpu).stats;
+		for (id = 0; id < MSM_PM_STAT_COUNT; id++)
+			if (stats[id].enabled)
+				msm_pm_stats_bin_fill(rec++, &stats[id], cpu);
+	}
+	spin_unlock_irqrestore(&msm_pm_stats_lock, flags);
+
+	spin_lock_irqsave(&msm_pm_l2_stats_lock, flags);
+	stats = msm_pm_l2_time_stats.stats;
+	for (id = MSM_SPM_L2_MODE_DISABLED + 1; id < MSM_SPM_L2_MODE_LAST; id++)
+		if (stats[id].name)
+			msm_pm_stats_bin_fill(rec++, &stats[id], ~0U);
+	spin_unlock_irqrestore(&msm_pm_l2_stats_lock, flags);
+
+	bin->hdr.version = MSM_PM_STATS_SNAPSHOT_VERSION;
+	bin->hdr.type = MSM_PM_STATS_LPM;
+	bin->hdr.count = rec - bin->rec;
+	bin->hdr.record_size = sizeof(*rec);
+	bin->hdr.timestamp = ktime_to_ns(ktime_get());
+	bin->len = sizeof(bin->hdr) + bin->hdr.count * sizeof(*rec);
+}
+
+static ssize_t msm_pm_stats_bin_read(struct file *file, char __user *bufu,
+		size_t count, loff_t *ppos)
+{
+	struct msm_pm_stats_bin *bin = file->private_data;
+
+	if (*ppos == 0)
+		msm_pm_stats_bin_snapshot(bin);
+
+	return simple_read_from_buffer(bufu, count, ppos, &bin->hdr,
+			bin->len);
+}
+
+static int msm_pm_stats_bin_open(struct inode *inode, struct file *file)
+{
+	file->private_data = kzalloc(sizeof(struct msm_pm_stats_bin) +
+			MSM_PM_STATS_BIN_MAX_RECORDS *
+			sizeof(struct msm_lpm_stats_record), GFP_KERNEL);
+
+	return file->private_data ? 0 : -ENOMEM;
+}
+
+static int msm_pm_stats_bin_release(struct inode *inode, struct file *file)
+{
+	kfree(file->private_data);
+	return 0;
+}
+
+static const struct file_operations msm_pm_stats_bin_fops = {
+	.owner	  = THIS_MODULE,
+	.open	  = msm_pm_stats_bin_open,
+	.read	  = msm_pm_stats_bin_read,
+	.release  = msm_pm_stats_bin_release,
+	.llseek   = default_llseek,
+};
 
 static bool msm_pm_debugfs_create_root(void)
 {
@@ -609,6 +701,9 @@ static bool msm_pm_debugfs_create_root(void)
 		debugfs_remove(msm_pm_dbg_root);
 		goto root_error;
 	}
+	if (!debugfs_create_file("stats_bin", S_IRUGO, msm_pm_dbg_root,
+			NULL, &msm_pm_stats_bin_fops))
+		pr_err("%s: stats_bin create error\n", __func__);
 	ret = true;
 
 root_error:
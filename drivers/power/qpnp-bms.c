@@ -2631,7 +2631,8 @@ static void calculate_soc_work(struct work_struct *work)
 				calculate_soc_delayed_work.work);
 
 	recalculate_soc(chip);
-	schedule_delayed_work(&chip->calculate_soc_delayed_work,
+	queue_delayed_work(system_power_efficient_wq,
+		&chip->calculate_soc_delayed_work,
 		round_jiffies_relative(msecs_to_jiffies
 		(get_calculation_delay_ms(chip))));
 }
@@ -2650,7 +2651,7 @@ static void configure_vbat_monitor_low(struct qpnp_bms_chip *chip)
 			wake_lock(&chip->low_voltage_wake_lock);
 			cancel_delayed_work_sync(
 					&chip->calculate_soc_delayed_work);
-			schedule_delayed_work(
+			queue_delayed_work(system_power_efficient_wq,
 					&chip->calculate_soc_delayed_work, 0);
 		}
 		chip->vbat_monitor_params.state_request =
@@ -4414,7 +4415,8 @@ static int bms_resume(struct device *dev)
 
 	if (time_until_next_recalc == 0)
 		bms_stay_awake(&chip->soc_wake_source);
-	schedule_delayed_work(&chip->calculate_soc_delayed_work,
+	queue_delayed_work(system_power_efficient_wq,
+		&chip->calculate_soc_delayed_work,
 		round_jiffies_relative(msecs_to_jiffies
 		(time_until_next_recalc)));
 	return 0;
@@ -4433,6 +4435,7 @@ static struct spmi_driver qpnp_bms_driver = {
 		.owner		= THIS_MODULE,
 		.of_match_table	= qpnp_bms_match_table,
 		.pm		= &qpnp_bms_pm_ops,
+		.probe_type	= PROBE_PREFER_ASYNCHRONOUS,
 	},
 };
 
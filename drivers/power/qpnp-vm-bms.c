@@ -93,6 +93,17 @@
 
 #define SEC_ACCESS			0xD0
 
+/*
+ * Not cached: status and interrupt registers, the self-clearing
+ * DATA_CTL2, the accumulator and OCV data, the FIFO and SEC_ACCESS.
+ */
+static const struct spmi_reg_range bms_volatile_regs[] = {
+	{ STATUS1_REG, 0x3F },
+	{ DATA_CTL2_REG, DATA_CTL2_REG },
+	{ ACC_DATA0_SD_REG, 0x7F },
+	{ FIFO_0_LSB_REG, 0xFF },
+};
+
 #define QPNP_CHARGER_PRESENT		BIT(7)
 
 /* Constants */
@@ -169,6 +180,7 @@ struct qpnp_bms_chip {
 	bool				bms_dev_open;
 	bool				data_ready;
 	bool				charging_while_suspended;
+	bool				in_suspend;
 	bool				in_cv_state;
 	int				battery_status;
 	int				calculated_soc;
@@ -189,6 +201,7 @@ struct qpnp_bms_chip {
 	unsigned int			vadc_v1250;
 	unsigned long			tm_sec;
 	u32				seq_num;
+	u32				suspend_wakeups;
 	u8				shutdown_soc;
 	u16				last_ocv_raw;
 	u32				shutdown_ocv;
@@ -1298,7 +1311,7 @@ static void monitor_soc_work(struct work_struct *work)
 		}
 	}
 
-	schedule_delayed_work(&chip->monitor_soc_work,
+	queue_delayed_work(system_power_efficient_wq, &chip->monitor_soc_work,
 			msecs_to_jiffies(get_calculation_delay_ms(chip)));
 
 	bms_relax(&chip->vbms_soc_wake_source);
@@ -1554,14 +1567,12 @@ static int read_and_populate_fifo_data(struct qpnp_bms_chip *chip)
 	}
 
 	/* read the FIFO data */
-	for (i = 0; i < fifo_count * 2; i++) {
-		rc = qpnp_read_wrapper(chip, &fifo_data_raw[i],
-				chip->base + FIFO_0_LSB_REG + i, 1);
-		if (rc) {
-			pr_err("Unable to read FIFO register(%d) rc=%d\n",
-								i, rc);
-			return rc;
-		}
+	rc = spmi_ext_register_readl_block(chip->spmi->ctrl, chip->spmi->sid,
+				chip->base + FIFO_0_LSB_REG, fifo_data_raw,
+				fifo_count * 2);
+	if (rc) {
+		pr_err("Unable to read FIFO registers rc=%d\n", rc);
+		return rc;
 	}
 
 	/* populate the structure */
@@ -1663,6 +1674,9 @@ static irqreturn_t bms_fifo_update_done_irq_handler(int irq, void *_chip)
 
 	pr_debug("fifo_update_done triggered\n");
 
+	if (chip->in_suspend)
+		chip->suspend_wakeups++;
+
 	mutex_lock(&chip->bms_data_mutex);
 
 	rc = calib_vadc(chip);
@@ -1717,6 +1731,9 @@ static irqreturn_t bms_fsm_state_change_irq_handler(int irq, void *_chip)
 
 	pr_debug("fsm_state_changed triggered\n");
 
+	if (chip->in_suspend)
+		chip->suspend_wakeups++;
+
 	mutex_lock(&chip->bms_data_mutex);
 
 	rc = calib_vadc(chip);
@@ -2255,7 +2272,8 @@ static int show_bms_status(struct seq_file *m, void *data)
 			"current_now\t=\t%d\n"
 			"ocv_at_100\t=\t%d\n"
 			"low_voltage_ws_active\t=\t%d\n"
-			"cv_ws_active\t=\t%d\n",
+			"cv_ws_active\t=\t%d\n"
+			"suspend_wakeups\t=\t%u\n",
 			chip->bms_psy_registered,
 			chip->bms_dev_open,
 			chip->warm_reset,
@@ -2271,7 +2289,8 @@ static int show_bms_status(struct seq_file *m, void *data)
 			chip->current_now,
 			chip->ocv_at_100,
 			bms_wake_active(&chip->vbms_lv_wake_source),
-			bms_wake_active(&chip->vbms_cv_wake_source));
+			bms_wake_active(&chip->vbms_cv_wake_source),
+			chip->suspend_wakeups);
 	return 0;
 }
 
@@ -2687,6 +2706,10 @@ static int qpnp_vm_bms_probe(struct spmi_device *spmi)
 	INIT_DELAYED_WORK(&chip->voltage_soc_timeout_work,
 					voltage_soc_timeout_work);
 
+	spmi_reg_cache_register(spmi->ctrl, spmi->sid, chip->base,
+				bms_volatile_regs,
+				ARRAY_SIZE(bms_volatile_regs));
+
 	bms_init_defaults(chip);
 	bms_load_hw_defaults(chip);
 	battery_status_check(chip);
@@ -2759,7 +2782,7 @@ static int qpnp_vm_bms_probe(struct spmi_device *spmi)
 			pr_err("Couldn't create bms_status debug file\n");
 	}
 
-	schedule_delayed_work(&chip->monitor_soc_work,
+	queue_delayed_work(system_power_efficient_wq, &chip->monitor_soc_work,
 			msecs_to_jiffies(get_calculation_delay_ms(chip)));
 
 	/*
@@ -2783,6 +2806,7 @@ fail_psy:
 	cdev_del(&chip->bms_cdev);
 	unregister_chrdev_region(chip->dev_no, 1);
 fail_bms_device:
+	spmi_reg_cache_unregister(spmi->ctrl, spmi->sid, chip->base);
 	chip->bms_psy_registered = false;
 	the_chip = NULL;
 	return rc;
@@ -2801,17 +2825,18 @@ static int qpnp_vm_bms_remove(struct spmi_device *spmi)
 	mutex_destroy(&chip->last_soc_mutex);
 	mutex_destroy(&chip->bms_device_mutex);
 	power_supply_unregister(&chip->bms_psy);
+	spmi_reg_cache_unregister(spmi->ctrl, spmi->sid, chip->base);
 	dev_set_drvdata(&spmi->dev, NULL);
 	the_chip = NULL;
 
 	return 0;
 }
 
-static void process_suspended_data(struct qpnp_bms_chip *chip)
+static bool process_suspended_data(struct qpnp_bms_chip *chip)
 {
 	int rc, batt_temp = 0;
 	int old_ocv = 0;
-	bool update_data = false;
+	bool update_data = false, ocv_updated = false;
 
 	rc = get_batt_therm(chip, &batt_temp);
 	if (rc < 0) {
@@ -2833,6 +2858,7 @@ static void process_suspended_data(struct qpnp_bms_chip *chip)
 
 	if (old_ocv != chip->last_ocv_uv) {
 		update_data = true;
+		ocv_updated = true;
 		chip->calculated_soc = lookup_soc_ocv(chip,
 				chip->last_ocv_uv, batt_temp);
 		pr_debug("New OCV in sleep - sleep_new_soc=%d\n",
@@ -2877,6 +2903,8 @@ static void process_suspended_data(struct qpnp_bms_chip *chip)
 
 	}
 	mutex_unlock(&chip->bms_data_mutex);
+
+	return ocv_updated;
 }
 
 static int bms_suspend(struct device *dev)
@@ -2896,10 +2924,17 @@ static int bms_suspend(struct device *dev)
 		if (chip->dt.cfg_force_s3_on_suspend) {
 			pr_debug("Forcing S3 state\n");
 			force_fsm_state(chip, S3_STATE);
+			/*
+			 * S3 accumulates samples in the ACC registers,
+			 * which are collected on resume; there is no
+			 * need to wake up for FIFO updates meanwhile.
+			 */
+			disable_irq_wake(chip->fifo_update_done_irq.irq);
 		}
 	}
 
 	cancel_delayed_work_sync(&chip->monitor_soc_work);
+	chip->in_suspend = true;
 
 	return 0;
 }
@@ -2907,26 +2942,49 @@ static int bms_suspend(struct device *dev)
 static int bms_resume(struct device *dev)
 {
 	struct qpnp_bms_chip *chip = dev_get_drvdata(dev);
+	bool ocv_updated = false;
+	unsigned long now_tm_sec = 0;
+	int delay_ms, elapsed_ms = INT_MAX;
+
+	chip->in_suspend = false;
 
 	if (!chip->charging_while_suspended) {
 		if (chip->dt.cfg_force_s3_on_suspend) {
 			pr_debug("Unforcing S3 state, setting AUTO state\n");
 			set_auto_fsm_state(chip);
+			enable_irq_wake(chip->fifo_update_done_irq.irq);
 		}
 		/*
 		 * if we were charging while suspended, we will
 		 * be woken up by the fifo done interrupt and no
 		 * additional processing is needed
 		 */
-		process_suspended_data(chip);
+		ocv_updated = process_suspended_data(chip);
 
 		enable_bms_irq(&chip->fsm_state_change_irq);
 		enable_irq_wake(chip->fsm_state_change_irq.irq);
 	}
 
-	/* start the soc_monitor */
-	bms_stay_awake(&chip->vbms_soc_wake_source);
-	schedule_delayed_work(&chip->monitor_soc_work, 0);
+	/*
+	 * Only recalculate the SOC straight away if sleep produced a new
+	 * OCV or the last calculation is due; short wakeups otherwise
+	 * leave the regular calculation interval running.
+	 */
+	delay_ms = get_calculation_delay_ms(chip);
+	if (!get_current_time(&now_tm_sec) && now_tm_sec >= chip->tm_sec &&
+	    now_tm_sec - chip->tm_sec < delay_ms / 1000)
+		elapsed_ms = (now_tm_sec - chip->tm_sec) * 1000;
+
+	if (ocv_updated || elapsed_ms >= delay_ms) {
+		/* start the soc_monitor */
+		bms_stay_awake(&chip->vbms_soc_wake_source);
+		queue_delayed_work(system_power_efficient_wq,
+				&chip->monitor_soc_work, 0);
+	} else {
+		queue_delayed_work(system_power_efficient_wq,
+				&chip->monitor_soc_work,
+				msecs_to_jiffies(delay_ms - elapsed_ms));
+	}
 
 	return 0;
 }
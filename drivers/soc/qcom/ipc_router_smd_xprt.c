@@ -57,7 +57,7 @@ if (msm_ipc_router_smd_xprt_debug_mask) \
  * @channel: SMD channel specific info.
  * @smd_xprt_wq: Workqueue to queue read & other XPRT related works.
  * @write_avail_wait_q: wait queue for writer thread.
- * @in_pkt: Pointer to any partially read packet.
+ * @in_pkt: Packet being received, reused once handed to IPC Router.
  * @is_partial_in_pkt: check pkt completion.
  * @read_work: Read Work to perform read operation from SMD.
  * @ss_reset_lock: Lock to protect access to the ss_reset flag.
@@ -259,6 +259,86 @@ static void smd_xprt_sft_close_done(struct msm_ipc_router_xprt *xprt)
 	complete_all(&smd_xprtp->sft_close_complete);
 }
 
+/**
+ * smd_xprt_get_in_pkt() - Get an empty rr_packet to receive into
+ * @smd_xprtp: SMD XPRT the packet is received on.
+ *
+ * @return: the XPRT's receive packet, allocated on first use.
+ *
+ * IPC Router clones the packet and its skbs on notification, so once a
+ * packet has been handed over the XPRT only drops its own skb references
+ * and keeps the rr_packet and fragment queue for the next packet.
+ */
+static struct rr_packet *smd_xprt_get_in_pkt(
+			struct msm_ipc_router_smd_xprt *smd_xprtp)
+{
+	struct rr_packet *pkt = smd_xprtp->in_pkt;
+
+	if (pkt) {
+		skb_queue_purge(pkt->pkt_fragment_q);
+		memset(&pkt->hdr, 0, sizeof(pkt->hdr));
+		pkt->length = 0;
+		return pkt;
+	}
+
+	pkt = kzalloc(sizeof(struct rr_packet), GFP_KERNEL);
+	if (!pkt) {
+		pr_err("%s: Couldn't alloc rr_packet\n", __func__);
+		return NULL;
+	}
+
+	pkt->pkt_fragment_q = kmalloc(sizeof(struct sk_buff_head), GFP_KERNEL);
+	if (!pkt->pkt_fragment_q) {
+		pr_err("%s: Couldn't alloc pkt_fragment_q\n", __func__);
+		kfree(pkt);
+		return NULL;
+	}
+	skb_queue_head_init(pkt->pkt_fragment_q);
+	smd_xprtp->in_pkt = pkt;
+	D("%s: Allocated rr_packet\n", __func__);
+	return pkt;
+}
+
+/**
+ * smd_xprt_get_rx_skb() - Get an skb with room for the current packet
+ * @smd_xprtp: SMD XPRT the packet is received on.
+ * @pkt_size: Bytes of the current packet still to be read.
+ *
+ * @return: skb to read into, or NULL if the read has been rescheduled.
+ *
+ * A packet arriving in pieces keeps filling the tailroom of the skb that
+ * was sized for it, so a packet normally ends up as one linear skb. Only
+ * when that allocation fails is the packet split into smaller fragments.
+ */
+static struct sk_buff *smd_xprt_get_rx_skb(
+			struct msm_ipc_router_smd_xprt *smd_xprtp,
+			int pkt_size)
+{
+	struct sk_buff *skb;
+	int sz = pkt_size;
+
+	skb = skb_peek_tail(smd_xprtp->in_pkt->pkt_fragment_q);
+	if (skb && skb_tailroom(skb))
+		return skb;
+
+	do {
+		skb = alloc_skb(sz, GFP_KERNEL);
+		if (!skb) {
+			if (sz <= (PAGE_SIZE/2)) {
+				queue_delayed_work(smd_xprtp->smd_xprt_wq,
+						   &smd_xprtp->read_work,
+						   msecs_to_jiffies(100));
+				return NULL;
+			}
+			sz = sz / 2;
+		}
+	} while (!skb);
+
+	D("%s: Allocated the sk_buff of size %d\n", __func__, sz);
+	skb_queue_tail(smd_xprtp->in_pkt->pkt_fragment_q, skb);
+	return skb;
+}
+
 static void smd_xprt_read_data(struct work_struct *work)
 {
 	int pkt_size, sz_read, sz;
@@ -272,8 +352,8 @@ static void smd_xprt_read_data(struct work_struct *work)
 	spin_lock_irqsave(&smd_xprtp->ss_reset_lock, flags);
 	if (smd_xprtp->ss_reset) {
 		spin_unlock_irqrestore(&smd_xprtp->ss_reset_lock, flags);
-		if (smd_xprtp->in_pkt)
-			release_pkt(smd_xprtp->in_pkt);
+		release_pkt(smd_xprtp->in_pkt);
+		smd_xprtp->in_pkt = NULL;
 		smd_xprtp->is_partial_in_pkt = 0;
 		pr_err("%s: %s channel reset\n",
 			__func__, smd_xprtp->xprt.name);
@@ -287,26 +367,9 @@ static void smd_xprt_read_data(struct work_struct *work)
 	while ((pkt_size = smd_cur_packet_size(smd_xprtp->channel)) &&
 		smd_read_avail(smd_xprtp->channel)) {
 		if (!smd_xprtp->is_partial_in_pkt) {
-			smd_xprtp->in_pkt = kzalloc(sizeof(struct rr_packet),
-						    GFP_KERNEL);
-			if (!smd_xprtp->in_pkt) {
-				pr_err("%s: Couldn't alloc rr_packet\n",
-					__func__);
+			if (!smd_xprt_get_in_pkt(smd_xprtp))
 				return;
-			}
-
-			smd_xprtp->in_pkt->pkt_fragment_q =
-				kmalloc(sizeof(struct sk_buff_head),
-					GFP_KERNEL);
-			if (!smd_xprtp->in_pkt->pkt_fragment_q) {
-				pr_err("%s: Couldn't alloc pkt_fragment_q\n",
-					__func__);
-				kfree(smd_xprtp->in_pkt);
-				return;
-			}
-			skb_queue_head_init(smd_xprtp->in_pkt->pkt_fragment_q);
 			smd_xprtp->is_partial_in_pkt = 1;
-			D("%s: Allocated rr_packet\n", __func__);
 		}
 
 		if (((pkt_size >= MIN_FRAG_SZ) &&
@@ -315,33 +378,23 @@ static void smd_xprt_read_data(struct work_struct *work)
 		     (smd_read_avail(smd_xprtp->channel) < pkt_size)))
 			return;
 
-		sz = smd_read_avail(smd_xprtp->channel);
-		do {
-			ipc_rtr_pkt = alloc_skb(sz, GFP_KERNEL);
-			if (!ipc_rtr_pkt) {
-				if (sz <= (PAGE_SIZE/2)) {
-					queue_delayed_work(
-						smd_xprtp->smd_xprt_wq,
-						&smd_xprtp->read_work,
-						msecs_to_jiffies(100));
-					return;
-				}
-				sz = sz / 2;
-			}
-		} while (!ipc_rtr_pkt);
+		ipc_rtr_pkt = smd_xprt_get_rx_skb(smd_xprtp, pkt_size);
+		if (!ipc_rtr_pkt)
+			return;
 
-		D("%s: Allocated the sk_buff of size %d\n", __func__, sz);
+		sz = min_t(int, smd_read_avail(smd_xprtp->channel),
+			   skb_tailroom(ipc_rtr_pkt));
+		sz = min(sz, pkt_size);
 		data = skb_put(ipc_rtr_pkt, sz);
 		sz_read = smd_read(smd_xprtp->channel, data, sz);
 		if (sz_read != sz) {
 			pr_err("%s: Couldn't read %s completely\n",
 				__func__, smd_xprtp->xprt.name);
-			kfree_skb(ipc_rtr_pkt);
 			release_pkt(smd_xprtp->in_pkt);
+			smd_xprtp->in_pkt = NULL;
 			smd_xprtp->is_partial_in_pkt = 0;
 			return;
 		}
-		skb_queue_tail(smd_xprtp->in_pkt->pkt_fragment_q, ipc_rtr_pkt);
 		smd_xprtp->in_pkt->length += sz_read;
 		if (sz_read != pkt_size)
 			smd_xprtp->is_partial_in_pkt = 1;
@@ -354,8 +407,8 @@ static void smd_xprt_read_data(struct work_struct *work)
 			msm_ipc_router_xprt_notify(&smd_xprtp->xprt,
 						IPC_ROUTER_XPRT_EVENT_DATA,
 						(void *)smd_xprtp->in_pkt);
-			release_pkt(smd_xprtp->in_pkt);
-			smd_xprtp->in_pkt = NULL;
+			/* IPC Router holds clones; keep in_pkt for reuse */
+			skb_queue_purge(smd_xprtp->in_pkt->pkt_fragment_q);
 		}
 	}
 }
@@ -0,0 +1,251 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+/*
+ * In-kernel core parking for the secondary cpus.
+ *
+ * Every sample_ms the number of cpus needed is derived from the 50ms
+ * nr_running average kept by the scheduler and from the busy time of
+ * each online cpu.  Cpus are unparked as soon as they are needed and
+ * parked one at a time once they have been unnecessary for down_samples
+ * consecutive samples.  cpu0 is never parked.
+ *
+ * Input boost (see cpu-boost.c) keeps at least boost_cpus online, and
+ * msm_thermal's core control vetoes unparking of the cpus it has taken
+ * offline, which is honoured by skipping those cpus.  msm_thermal's
+ * mitigation chain may also lower the number of cpus allowed online;
+ * that limit wins over input boost.
+ */
+
+#define pr_fmt(fmt) "core-park: " fmt
+
+#include <linux/kernel.h>
+#include <linux/init.h>
+#include <linux/module.h>
+#include <linux/moduleparam.h>
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/sched.h>
+#include <linux/jiffies.h>
+#include <linux/workqueue.h>
+#include <linux/rq_stats.h>
+#include <soc/qcom/core_park.h>
+
+struct park_cpu_load {
+	u64 prev_idle;
+	u64 prev_wall;
+};
+
+static DEFINE_PER_CPU(struct park_cpu_load, park_load);
+
+static struct delayed_work park_work;
+static unsigned int down_count;
+static unsigned long boost_until;
+static unsigned int thermal_max_cpus;
+
+static bool enabled;
+
+static unsigned int sample_ms = 50;
+module_param(sample_ms, uint, 0644);
+
+/* nr_running * 100 per online cpu above which another cpu is needed */
+static unsigned int up_nr = 125;
+module_param(up_nr, uint, 0644);
+
+/* nr_running * 100 per remaining cpu below which one may be parked */
+static unsigned int down_nr = 75;
+module_param(down_nr, uint, 0644);
+
+/* busy percentage of any online cpu above which another cpu is needed */
+static unsigned int up_load = 85;
+module_param(up_load, uint, 0644);
+
+/* busy percentage every online cpu must stay below to park one */
+static unsigned int down_load = 40;
+module_param(down_load, uint, 0644);
+
+static unsigned int down_samples = 4;
+module_param(down_samples, uint, 0644);
+
+static unsigned int min_cpus = 1;
+module_param(min_cpus, uint, 0644);
+
+static unsigned int max_cpus = NR_CPUS;
+module_param(max_cpus, uint, 0644);
+
+static unsigned int boost_cpus = 2;
+module_param(boost_cpus, uint, 0644);
+
+/**
+ * msm_core_park_boost - keep boost_cpus online for a while
+ * @ms: duration of the boost
+ *
+ * May be called from atomic context.
+ */
+void msm_core_park_boost(unsigned int ms)
+{
+	unsigned long until = jiffies + msecs_to_jiffies(ms);
+
+	if (!enabled)
+		return;
+
+	if (time_after(until, ACCESS_ONCE(boost_until)))
+		ACCESS_ONCE(boost_until) = until;
+
+	if (num_online_cpus() < boost_cpus)
+		mod_delayed_work(system_wq, &park_work, 0);
+}
+EXPORT_SYMBOL(msm_core_park_boost);
+
+/**
+ * msm_core_park_thermal_limit - cap the number of unparked cpus
+ * @max_cpus: cpus allowed online, 0 to remove the cap
+ *
+ * Returns -ENODEV when parking is disabled and the cap would have no
+ * effect.
+ */
+int msm_core_park_thermal_limit(unsigned int max_cpus)
+{
+	ACCESS_ONCE(thermal_max_cpus) = max_cpus;
+
+	if (!enabled)
+		return -ENODEV;
+
+	mod_delayed_work(system_wq, &park_work, 0);
+	return 0;
+}
+EXPORT_SYMBOL(msm_core_park_thermal_limit);
+
+static unsigned int park_cpu_busy(unsigned int cpu)
+{
+	struct park_cpu_load *pl = &per_cpu(park_load, cpu);
+	u64 wall, idle, d_wall, d_idle;
+
+	idle = get_cpu_idle_time(cpu, &wall, 0);
+	d_wall = wall - pl->prev_wall;
+	d_idle = idle - pl->prev_idle;
+	pl->prev_wall = wall;
+	pl->prev_idle = idle;
+
+	if (!d_wall || d_idle >= d_wall)
+		return 0;
+
+	return div64_u64(100 * (d_wall - d_idle), d_wall);
+}
+
+static unsigned int park_target(unsigned int online)
+{
+	unsigned int cpu, max_busy = 0, target = online;
+	int nr, iowait;
+
+	sched_get_nr_running_avg_window(SCHED_NR_AVG_50MS, &nr, &iowait);
+
+	for_each_online_cpu(cpu)
+		max_busy = max(max_busy, park_cpu_busy(cpu));
+
+	if (nr > online * up_nr || max_busy > up_load) {
+		target = max_t(unsigned int, online + 1,
+			       DIV_ROUND_UP(nr, up_nr));
+		down_count = 0;
+	} else if (online > 1 && nr < (online - 1) * down_nr &&
+		   max_busy < down_load) {
+		if (++down_count >= down_samples) {
+			target = online - 1;
+			down_count = 0;
+		}
+	} else {
+		down_count = 0;
+	}
+
+	if (time_before(jiffies, ACCESS_ONCE(boost_until)))
+		target = max(target, boost_cpus);
+
+	target = clamp(target, max(min_cpus, 1U),
+		       min_t(unsigned int, max_cpus, num_possible_cpus()));
+	if (ACCESS_ONCE(thermal_max_cpus))
+		target = min(target, ACCESS_ONCE(thermal_max_cpus));
+
+	return target;
+}
+
+static void __ref park_apply(unsigned int online, unsigned int target)
+{
+	unsigned int cpu;
+
+	if (target > online) {
+		for_each_present_cpu(cpu) {
+			if (online >= target)
+				break;
+			if (cpu_online(cpu))
+				continue;
+			/* fails when thermal core control holds the cpu */
+			if (!cpu_up(cpu))
+				online++;
+		}
+	} else if (target < online) {
+		for (cpu = nr_cpu_ids - 1; cpu > 0; cpu--) {
+			if (cpu_online(cpu)) {
+				cpu_down(cpu);
+				break;
+			}
+		}
+	}
+}
+
+static void park_work_fn(struct work_struct *work)
+{
+	unsigned int online;
+
+	if (!enabled)
+		return;
+
+	/* set across system suspend */
+	if (!rq_info.hotplug_disabled) {
+		online = num_online_cpus();
+		park_apply(online, park_target(online));
+	}
+
+	queue_delayed_work(system_wq, &park_work,
+			   msecs_to_jiffies(sample_ms));
+}
+
+static int set_enabled(const char *val, const struct kernel_param *kp)
+{
+	bool was = enabled;
+	int ret;
+
+	ret = param_set_bool(val, kp);
+	if (ret || was == enabled)
+		return ret;
+
+	if (enabled) {
+		down_count = 0;
+		queue_delayed_work(system_wq, &park_work, 0);
+	} else {
+		cancel_delayed_work_sync(&park_work);
+	}
+
+	return 0;
+}
+
+static struct kernel_param_ops enabled_ops = {
+	.set = set_enabled,
+	.get = param_get_bool,
+};
+module_param_cb(enabled, &enabled_ops, &enabled, 0644);
+
+static int __init msm_core_park_init(void)
+{
+	INIT_DEFERRABLE_WORK(&park_work, park_work_fn);
+	return 0;
+}
+late_initcall(msm_core_park_init);
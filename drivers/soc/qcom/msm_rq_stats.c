@@ -314,8 +314,46 @@ static struct kobj_attribute cpu_normalized_load_attr =
 	__ATTR(cpu_normalized_load, S_IWUSR | S_IRUSR, show_cpu_normalized_load,
 			NULL);
 
+/*
+ * Average nr_running (and nr_iowait) * 100 over the scheduler's 10ms,
+ * 50ms and 200ms aging windows.
+ */
+static ssize_t show_nr_avg(char *buf, bool iowait)
+{
+	int avg[SCHED_NR_AVG_WINDOWS], iowait_avg[SCHED_NR_AVG_WINDOWS];
+	int *val = iowait ? iowait_avg : avg;
+	int i;
+
+	for (i = 0; i < SCHED_NR_AVG_WINDOWS; i++)
+		sched_get_nr_running_avg_window(i, &avg[i], &iowait_avg[i]);
+
+	return snprintf(buf, PAGE_SIZE, "%d %d %d\n",
+			val[SCHED_NR_AVG_10MS], val[SCHED_NR_AVG_50MS],
+			val[SCHED_NR_AVG_200MS]);
+}
+
+static ssize_t show_nr_running_avg(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return show_nr_avg(buf, false);
+}
+
+static struct kobj_attribute nr_running_avg_attr =
+	__ATTR(nr_running_avg, S_IRUGO, show_nr_running_avg, NULL);
+
+static ssize_t show_nr_iowait_avg(struct kobject *kobj,
+		struct kobj_attribute *attr, char *buf)
+{
+	return show_nr_avg(buf, true);
+}
+
+static struct kobj_attribute nr_iowait_avg_attr =
+	__ATTR(nr_iowait_avg, S_IRUGO, show_nr_iowait_avg, NULL);
+
 static struct attribute *rq_attrs[] = {
 	&cpu_normalized_load_attr.attr,
+	&nr_running_avg_attr.attr,
+	&nr_iowait_avg_attr.attr,
 	&def_timer_ms_attr.attr,
 	&run_queue_avg_attr.attr,
 	&run_queue_poll_ms_attr.attr,
@@ -32,6 +32,7 @@
 #include <linux/interrupt.h>
 #include <linux/of_gpio.h>
 #include <linux/of_address.h>
+#include <linux/async.h>
 #include <linux/io.h>
 #include <soc/qcom/ramdump.h>
 #include <soc/qcom/subsystem_restart.h>
@@ -588,12 +589,73 @@ static int pil_load_seg(struct pil_desc *desc, struct pil_seg *seg)
 		paddr += size;
 	}
 
-	if (desc->ops->verify_blob) {
-		ret = desc->ops->verify_blob(desc, seg->paddr, seg->sz);
+	return ret;
+}
+
+struct pil_seg_data {
+	struct pil_desc *desc;
+	struct pil_seg *seg;
+	int ret;
+};
+
+static void pil_load_seg_work_fn(void *data, async_cookie_t cookie)
+{
+	struct pil_seg_data *sd = data;
+
+	sd->ret = pil_load_seg(sd->desc, sd->seg);
+}
+
+/*
+ * Segments are independent blobs destined for disjoint parts of the
+ * region, so read them all in parallel and let the filesystem have
+ * several requests in flight. verify_blob() implementations track how
+ * much of the image has been loaded, so they are still called in
+ * segment order once everything is in memory.
+ */
+static int pil_load_segs(struct pil_desc *desc)
+{
+	ASYNC_DOMAIN_EXCLUSIVE(pil_async_domain);
+	struct pil_priv *priv = desc->priv;
+	struct pil_seg_data *sd;
+	struct pil_seg *seg;
+	int nr = 0, i, ret = 0;
+
+	list_for_each_entry(seg, &priv->segs, list)
+		nr++;
+
+	sd = kcalloc(nr, sizeof(*sd), GFP_KERNEL);
+	if (!sd)
+		return -ENOMEM;
+
+	i = 0;
+	list_for_each_entry(seg, &priv->segs, list) {
+		sd[i].desc = desc;
+		sd[i].seg = seg;
+		async_schedule_domain(pil_load_seg_work_fn, &sd[i],
+				      &pil_async_domain);
+		i++;
+	}
+	async_synchronize_full_domain(&pil_async_domain);
+
+	for (i = 0; i < nr; i++) {
+		ret = sd[i].ret;
 		if (ret)
-			pil_err(desc, "Blob%u failed verification\n", num);
+			goto out;
 	}
 
+	if (!desc->ops->verify_blob)
+		goto out;
+
+	for (i = 0; i < nr; i++) {
+		seg = sd[i].seg;
+		ret = desc->ops->verify_blob(desc, seg->paddr, seg->sz);
+		if (ret) {
+			pil_err(desc, "Blob%u failed verification\n", seg->num);
+			goto out;
+		}
+	}
+out:
+	kfree(sd);
 	return ret;
 }
 
@@ -642,7 +704,6 @@ int pil_boot(struct pil_desc *desc)
 	char fw_name[30];
 	const struct pil_mdt *mdt;
 	const struct elf32_hdr *ehdr;
-	struct pil_seg *seg;
 	const struct firmware *fw;
 	struct pil_priv *priv = desc->priv;
 
@@ -710,11 +771,9 @@ int pil_boot(struct pil_desc *desc)
 		goto err_boot;
 	}
 
-	list_for_each_entry(seg, &desc->priv->segs, list) {
-		ret = pil_load_seg(desc, seg);
-		if (ret)
-			goto err_boot;
-	}
+	ret = pil_load_segs(desc);
+	if (ret)
+		goto err_boot;
 
 	ret = desc->ops->auth_and_reset(desc);
 	if (ret) {
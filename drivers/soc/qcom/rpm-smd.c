@@ -51,6 +51,25 @@ module_param_named(
 	debug_mask, msm_rpm_debug_mask, int, S_IRUGO | S_IWUSR
 );
 
+/*
+ * Active set requests whose key/value pairs all match what was last sent
+ * to the RPM for the same resource are dropped before they reach SMD.
+ */
+static bool msm_rpm_active_dedup = true;
+module_param_named(
+	active_dedup, msm_rpm_active_dedup, bool, S_IRUGO | S_IWUSR
+);
+
+static unsigned int msm_rpm_active_sent;
+module_param_named(
+	active_sent, msm_rpm_active_sent, uint, S_IRUGO
+);
+
+static unsigned int msm_rpm_active_suppressed;
+module_param_named(
+	active_suppressed, msm_rpm_active_suppressed, uint, S_IRUGO
+);
+
 struct msm_rpm_driver_data {
 	const char *ch_name;
 	uint32_t ch_type;
@@ -129,6 +148,7 @@ struct slp_buf {
 	bool valid;
 };
 static struct rb_root tr_root = RB_ROOT;
+static struct rb_root act_root = RB_ROOT;
 static int msm_rpm_send_smd_buffer(char *buf, uint32_t size, bool noirq);
 static uint32_t msm_rpm_get_next_msg_id(void);
 
@@ -214,11 +234,9 @@ static void add_kvp(char *buf, struct kvp *n)
 	get_req_len(buf) += inc;
 }
 
-static struct slp_buf *tr_search(struct rb_root *root, char *slp)
+static struct slp_buf *__tr_search(struct rb_root *root, unsigned int type,
+		unsigned int id)
 {
-	unsigned int type = get_rsc_type(slp);
-	unsigned int id = get_rsc_id(slp);
-
 	struct rb_node *node = root->rb_node;
 
 	while (node) {
@@ -240,6 +258,11 @@ static struct slp_buf *tr_search(struct rb_root *root, char *slp)
 	return NULL;
 }
 
+static inline struct slp_buf *tr_search(struct rb_root *root, char *slp)
+{
+	return __tr_search(root, get_rsc_type(slp), get_rsc_id(slp));
+}
+
 static int tr_insert(struct rb_root *root, struct slp_buf *slp)
 {
 	unsigned int type = get_rsc_type(slp->buf);
@@ -460,6 +483,9 @@ LIST_HEAD(msm_rpm_wait_list);
 struct msm_rpm_wait_data {
 	struct list_head list;
 	uint32_t msg_id;
+	enum msm_rpm_set set;
+	uint32_t rsc_type;
+	uint32_t rsc_id;
 	bool ack_recd;
 	int errno;
 	struct completion ack;
@@ -735,7 +761,7 @@ static uint32_t msm_rpm_get_next_msg_id(void)
 	return id;
 }
 
-static int msm_rpm_add_wait_list(uint32_t msg_id)
+static int msm_rpm_add_wait_list(struct rpm_message_header *hdr)
 {
 	unsigned long flags;
 	struct msm_rpm_wait_data *data =
@@ -746,7 +772,10 @@ static int msm_rpm_add_wait_list(uint32_t msg_id)
 
 	init_completion(&data->ack);
 	data->ack_recd = false;
-	data->msg_id = msg_id;
+	data->msg_id = hdr->msg_id;
+	data->set = hdr->set;
+	data->rsc_type = hdr->resource_type;
+	data->rsc_id = hdr->resource_id;
 	data->errno = INIT_ERROR;
 	spin_lock_irqsave(&msm_rpm_list_lock, flags);
 	list_add(&data->list, &msm_rpm_wait_list);
@@ -765,10 +794,14 @@ static void msm_rpm_free_list_entry(struct msm_rpm_wait_data *elem)
 	kfree(elem);
 }
 
+static void msm_rpm_drop_active(uint32_t rsc_type, uint32_t rsc_id);
+
 static void msm_rpm_process_ack(uint32_t msg_id, int errno)
 {
 	struct list_head *ptr;
 	struct msm_rpm_wait_data *elem = NULL;
+	uint32_t rsc_type = 0, rsc_id = 0;
+	bool nack_active = false;
 	unsigned long flags;
 
 	spin_lock_irqsave(&msm_rpm_list_lock, flags);
@@ -778,6 +811,11 @@ static void msm_rpm_process_ack(uint32_t msg_id, int errno)
 		if (elem && (elem->msg_id == msg_id)) {
 			elem->errno = errno;
 			elem->ack_recd = true;
+			if (errno && elem->set == MSM_RPM_CTX_ACTIVE_SET) {
+				nack_active = true;
+				rsc_type = elem->rsc_type;
+				rsc_id = elem->rsc_id;
+			}
 			complete(&elem->ack);
 			break;
 		}
@@ -791,6 +829,10 @@ static void msm_rpm_process_ack(uint32_t msg_id, int errno)
 		trace_rpm_ack_recd(0, msg_id);
 
 	spin_unlock_irqrestore(&msm_rpm_list_lock, flags);
+
+	/* The RPM did not apply the request, so forget what we sent */
+	if (nack_active)
+		msm_rpm_drop_active(rsc_type, rsc_id);
 }
 
 struct msm_rpm_kvp_packet {
@@ -1015,6 +1057,156 @@ static void msm_rpm_log_request(struct msm_rpm_request *cdata)
 	pos += scnprintf(buf + pos, buflen - pos, "\n");
 	printk(buf);
 }
+
+/*
+ * The active set cache (act_root) holds the last request sent to the RPM
+ * for each active set resource, in the same wire format as the sleep
+ * buffers. It is only touched with smd_lock_write held so that its
+ * contents follow the order in which messages are written to SMD.
+ */
+static void msm_rpm_drop_active(uint32_t rsc_type, uint32_t rsc_id)
+{
+	struct slp_buf *a;
+	unsigned long flags;
+
+	spin_lock_irqsave(&msm_rpm_data.smd_lock_write, flags);
+	a = __tr_search(&act_root, rsc_type, rsc_id);
+	if (a) {
+		rb_erase(&a->node, &act_root);
+		kfree(a);
+	}
+	spin_unlock_irqrestore(&msm_rpm_data.smd_lock_write, flags);
+}
+
+/*
+ * Remove every key/value pair from @buf whose value matches the cached
+ * one. Returns the remaining length of @buf, or 0 if nothing is left
+ * to send.
+ */
+static uint32_t msm_rpm_filter_active(char *buf)
+{
+	struct slp_buf *a;
+	struct kvp *n, *e;
+
+	a = tr_search(&act_root, buf);
+	if (!a)
+		return get_buf_len(buf);
+
+	n = get_first_kvp(buf);
+	while (((void *)n - (void *)get_first_kvp(buf)) < get_data_len(buf)) {
+		bool match = false;
+
+		for_each_kvp(a->buf, e) {
+			if (n->k != e->k)
+				continue;
+			match = (n->s == e->s) &&
+				!memcmp(get_data(n), get_data(e), n->s);
+			break;
+		}
+
+		if (match)
+			delete_kvp(buf, n);
+		else
+			n = get_next_kvp(n);
+	}
+
+	return get_data_len(buf) ? get_buf_len(buf) : 0;
+}
+
+static void msm_rpm_update_active(char *buf)
+{
+	struct slp_buf *a;
+	struct kvp *n, *e;
+	uint32_t size = get_buf_len(buf);
+
+	a = tr_search(&act_root, buf);
+	if (!a) {
+		if (size > MAX_SLEEP_BUFFER)
+			return;
+		a = kzalloc(sizeof(struct slp_buf), GFP_ATOMIC);
+		if (!a)
+			return;
+		a->buf = PTR_ALIGN(&a->ubuf[0], sizeof(u32));
+		memcpy(a->buf, buf, size);
+		if (tr_insert(&act_root, a))
+			kfree(a);
+		return;
+	}
+
+	for_each_kvp(buf, n) {
+		bool found = false;
+
+		for_each_kvp(a->buf, e) {
+			if (n->k != e->k)
+				continue;
+			found = true;
+			if (n->s == e->s) {
+				update_kvp_data(e, n);
+			} else {
+				delete_kvp(a->buf, e);
+				found = false;
+			}
+			break;
+		}
+		if (found)
+			continue;
+
+		if (get_buf_len(a->buf) + sizeof(*n) + n->s >
+				MAX_SLEEP_BUFFER) {
+			/* Too big to cache, always send this one */
+			rb_erase(&a->node, &act_root);
+			kfree(a);
+			return;
+		}
+		add_kvp(a->buf, n);
+	}
+}
+
+static int msm_rpm_send_active_buffer(char *buf, uint32_t *size, bool noirq)
+{
+	unsigned long flags;
+	int ret;
+
+	spin_lock_irqsave(&msm_rpm_data.smd_lock_write, flags);
+
+	if (msm_rpm_active_dedup) {
+		*size = msm_rpm_filter_active(buf);
+		if (!*size) {
+			msm_rpm_active_suppressed++;
+			spin_unlock_irqrestore(&msm_rpm_data.smd_lock_write,
+					flags);
+			return 0;
+		}
+	}
+
+	while ((ret = smd_write_avail(msm_rpm_data.ch_info)) < *size) {
+		if (ret < 0)
+			break;
+		if (!noirq) {
+			spin_unlock_irqrestore(&msm_rpm_data.smd_lock_write,
+					flags);
+			cpu_relax();
+			spin_lock_irqsave(&msm_rpm_data.smd_lock_write, flags);
+		} else
+			udelay(5);
+	}
+
+	if (ret < 0) {
+		pr_err("%s(): SMD not initialized\n", __func__);
+		spin_unlock_irqrestore(&msm_rpm_data.smd_lock_write, flags);
+		return ret;
+	}
+
+	ret = smd_write(msm_rpm_data.ch_info, buf, *size);
+	if (ret == *size) {
+		msm_rpm_active_sent++;
+		if (msm_rpm_active_dedup)
+			msm_rpm_update_active(buf);
+	}
+	spin_unlock_irqrestore(&msm_rpm_data.smd_lock_write, flags);
+	return ret;
+}
+
 static int msm_rpm_send_smd_buffer(char *buf, uint32_t size, bool noirq)
 {
 	unsigned long flags;
@@ -1131,11 +1323,26 @@ static int msm_rpm_send_data(struct msm_rpm_request *cdata,
 		return ret;
 	}
 
-	msm_rpm_add_wait_list(cdata->msg_hdr.msg_id);
+	msm_rpm_add_wait_list(&cdata->msg_hdr);
 
-	ret = msm_rpm_send_smd_buffer(&cdata->buf[0], msg_size, noirq);
+	if (cdata->msg_hdr.set == MSM_RPM_CTX_ACTIVE_SET)
+		ret = msm_rpm_send_active_buffer(&cdata->buf[0], &msg_size,
+				noirq);
+	else
+		ret = msm_rpm_send_smd_buffer(&cdata->buf[0], msg_size, noirq);
+
+	if (!msg_size) {
+		struct msm_rpm_wait_data *rc;
 
-	if (ret == msg_size) {
+		/* Everything in the request is already in effect */
+		rc = msm_rpm_get_entry_from_msg_id(cdata->msg_hdr.msg_id);
+		if (rc)
+			msm_rpm_free_list_entry(rc);
+		for (i = 0; (i < cdata->write_idx); i++)
+			cdata->kvp[i].valid = false;
+		cdata->msg_hdr.data_len = 0;
+		ret = 1;
+	} else if (ret == msg_size) {
 		trace_rpm_send_message(noirq, cdata->msg_hdr.set,
 				cdata->msg_hdr.resource_type,
 				cdata->msg_hdr.resource_id,
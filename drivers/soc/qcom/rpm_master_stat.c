@@ -24,6 +24,8 @@
 #include <linux/mm.h>
 #include <linux/of.h>
 #include <linux/uaccess.h>
+#include <linux/msm_pm_stats.h>
+#include <asm/arch_timer.h>
 
 #include "rpm_stats.h"
 
@@ -286,6 +288,117 @@ static const struct file_operations msm_rpm_master_stats_fops = {
 	.llseek   = no_llseek,
 };
 
+/*
+ * Binary snapshot of every master in one read, see
+ * <linux/msm_pm_stats.h>. Unlike the text file this needs no global
+ * lock, as each open file has its own mapping and buffer.
+ */
+struct msm_rpm_master_stats_bin {
+	void __iomem *reg_base;
+	struct msm_rpm_master_stats_platform_data *pdata;
+	size_t len;
+	struct msm_pm_stats_snapshot_hdr hdr;
+	struct msm_rpm_master_stats_record rec[];
+};
+
+#define MASTER_READL(reg, field) \
+	readl_relaxed((reg) + offsetof(struct msm_rpm_master_stats, field))
+#define MASTER_READQ(reg, field) \
+	readq_relaxed((reg) + offsetof(struct msm_rpm_master_stats, field))
+
+static void msm_rpm_master_stats_bin_snapshot(
+		struct msm_rpm_master_stats_bin *bin)
+{
+	struct msm_rpm_master_stats_platform_data *pdata = bin->pdata;
+	struct msm_rpm_master_stats_record *rec;
+	void __iomem *reg;
+	int i;
+
+	for (i = 0; i < pdata->num_masters; i++) {
+		rec = &bin->rec[i];
+		reg = bin->reg_base + i * pdata->master_offset;
+
+		strlcpy(rec->name, pdata->masters[i], sizeof(rec->name));
+		if (pdata->version == 2) {
+			rec->active_cores = MASTER_READL(reg, active_cores);
+			rec->numshutdowns = MASTER_READL(reg, numshutdowns);
+			rec->shutdown_req = MASTER_READQ(reg, shutdown_req);
+			rec->wakeup_ind = MASTER_READQ(reg, wakeup_ind);
+			rec->bringup_req = MASTER_READQ(reg, bringup_req);
+			rec->bringup_ack = MASTER_READQ(reg, bringup_ack);
+			rec->wakeup_reason = MASTER_READL(reg, wakeup_reason);
+			rec->last_sleep_transition_duration = MASTER_READL(reg,
+					last_sleep_transition_duration);
+			rec->last_wake_transition_duration = MASTER_READL(reg,
+					last_wake_transition_duration);
+		} else {
+			rec->numshutdowns = readl_relaxed(reg + 0x0);
+			rec->active_cores = readl_relaxed(reg + 0x4);
+		}
+	}
+
+	bin->hdr.version = MSM_PM_STATS_SNAPSHOT_VERSION;
+	bin->hdr.type = MSM_PM_STATS_RPM_MASTER;
+	bin->hdr.count = pdata->num_masters;
+	bin->hdr.record_size = sizeof(*rec);
+	bin->hdr.timestamp = arch_counter_get_cntpct();
+}
+
+static ssize_t msm_rpm_master_stats_bin_read(struct file *file,
+				char __user *bufu, size_t count, loff_t *ppos)
+{
+	struct msm_rpm_master_stats_bin *bin = file->private_data;
+
+	if (*ppos == 0)
+		msm_rpm_master_stats_bin_snapshot(bin);
+
+	return simple_read_from_buffer(bufu, count, ppos, &bin->hdr,
+			bin->len);
+}
+
+static int msm_rpm_master_stats_bin_open(struct inode *inode,
+		struct file *file)
+{
+	struct msm_rpm_master_stats_platform_data *pdata = inode->i_private;
+	struct msm_rpm_master_stats_bin *bin;
+
+	bin = kzalloc(sizeof(*bin) + pdata->num_masters * sizeof(bin->rec[0]),
+			GFP_KERNEL);
+	if (!bin)
+		return -ENOMEM;
+
+	bin->reg_base = ioremap(pdata->phys_addr_base, pdata->phys_size);
+	if (!bin->reg_base) {
+		kfree(bin);
+		return -EBUSY;
+	}
+
+	bin->pdata = pdata;
+	bin->len = sizeof(bin->hdr) + pdata->num_masters * sizeof(bin->rec[0]);
+	file->private_data = bin;
+	return 0;
+}
+
+static int msm_rpm_master_stats_bin_close(struct inode *inode,
+		struct file *file)
+{
+	struct msm_rpm_master_stats_bin *bin = file->private_data;
+
+	iounmap(bin->reg_base);
+	kfree(bin);
+	return 0;
+}
+
+static const struct file_operations msm_rpm_master_stats_bin_fops = {
+	.owner	  = THIS_MODULE,
+	.open	  = msm_rpm_master_stats_bin_open,
+	.read	  = msm_rpm_master_stats_bin_read,
+	.release  = msm_rpm_master_stats_bin_close,
+	.llseek   = default_llseek,
+};
+
+static struct dentry *msm_rpm_master_stats_bin_dent;
+
 static struct msm_rpm_master_stats_platform_data
 			*msm_rpm_master_populate_pdata(struct device *dev)
 {
@@ -388,6 +501,10 @@ static  int msm_rpm_master_stats_probe(struct platform_device *pdev)
 		return -ENOMEM;
 	}
 
+	msm_rpm_master_stats_bin_dent = debugfs_create_file(
+			"rpm_master_stats_bin", S_IRUGO, NULL, pdata,
+			&msm_rpm_master_stats_bin_fops);
+
 	platform_set_drvdata(pdev, dent);
 	return 0;
 }
@@ -398,6 +515,8 @@ static int msm_rpm_master_stats_remove(struct platform_device *pdev)
 
 	dent = platform_get_drvdata(pdev);
 	debugfs_remove(dent);
+	debugfs_remove(msm_rpm_master_stats_bin_dent);
+	msm_rpm_master_stats_bin_dent = NULL;
 	platform_set_drvdata(pdev, NULL);
 	return 0;
 }
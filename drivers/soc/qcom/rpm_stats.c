@@ -25,6 +25,7 @@
 #include <linux/types.h>
 #include <linux/of.h>
 #include <linux/uaccess.h>
+#include <linux/msm_pm_stats.h>
 #include <asm/arch_timer.h>
 #include "rpm_stats.h"
 
@@ -42,6 +43,7 @@ static char *msm_rpmstats_id_labels[ID_MAX] = {
 
 #define SCLK_HZ 32768
 #define MSM_ARCH_TIMER_FREQ 19200000
+#define MSM_RPMSTATS_V2_NUM_RECORDS 2
 
 struct msm_rpmstats_record {
 	char		name[32];
@@ -286,7 +288,7 @@ static int msm_rpmstats_file_open(struct inode *inode, struct file *file)
 	prvdata->read_idx = prvdata->num_records =  prvdata->len = 0;
 	prvdata->platform_data = pdata;
 	if (pdata->version == 2)
-		prvdata->num_records = 2;
+		prvdata->num_records = MSM_RPMSTATS_V2_NUM_RECORDS;
 
 	return 0;
 }
@@ -310,6 +312,104 @@ static const struct file_operations msm_rpmstats_fops = {
 	.llseek   = no_llseek,
 };
 
+/*
+ * Binary snapshot of the v2 sleep stats, see <linux/msm_pm_stats.h>.
+ * A read at offset 0 copies the raw MSG RAM counters without any
+ * formatting, so the file can be kept open and polled with pread().
+ */
+struct msm_rpmstats_bin {
+	void __iomem *reg_base;
+	struct msm_pm_stats_snapshot_hdr hdr;
+	struct msm_rpm_sleep_stats_record rec[MSM_RPMSTATS_V2_NUM_RECORDS];
+};
+
+static void msm_rpmstats_bin_snapshot(struct msm_rpmstats_bin *bin)
+{
+	void __iomem *reg = bin->reg_base;
+	struct msm_rpm_sleep_stats_record *rec;
+	u32 stat_type;
+	int i;
+
+	for (i = 0; i < MSM_RPMSTATS_V2_NUM_RECORDS; i++) {
+		rec = &bin->rec[i];
+		stat_type = msm_rpmstats_read_long_register_v2(reg, i,
+				offsetof(struct msm_rpm_stats_data_v2,
+					stat_type));
+		memcpy(rec->name, &stat_type, sizeof(rec->name));
+		rec->count = msm_rpmstats_read_long_register_v2(reg, i,
+				offsetof(struct msm_rpm_stats_data_v2, count));
+		rec->last_entered_at = msm_rpmstats_read_quad_register_v2(reg,
+				i, offsetof(struct msm_rpm_stats_data_v2,
+					last_entered_at));
+		rec->last_exited_at = msm_rpmstats_read_quad_register_v2(reg,
+				i, offsetof(struct msm_rpm_stats_data_v2,
+					last_exited_at));
+		rec->accumulated = msm_rpmstats_read_quad_register_v2(reg,
+				i, offsetof(struct msm_rpm_stats_data_v2,
+					accumulated));
+		rec->client_votes = msm_rpmstats_read_long_register_v2(reg,
+				i, offsetof(struct msm_rpm_stats_data_v2,
+					client_votes));
+	}
+
+	bin->hdr.version = MSM_PM_STATS_SNAPSHOT_VERSION;
+	bin->hdr.type = MSM_PM_STATS_RPM_SLEEP;
+	bin->hdr.count = MSM_RPMSTATS_V2_NUM_RECORDS;
+	bin->hdr.record_size = sizeof(*rec);
+	bin->hdr.timestamp = arch_counter_get_cntpct();
+}
+
+static ssize_t msm_rpmstats_bin_read(struct file *file, char __user *bufu,
+				  size_t count, loff_t *ppos)
+{
+	struct msm_rpmstats_bin *bin = file->private_data;
+
+	if (*ppos == 0)
+		msm_rpmstats_bin_snapshot(bin);
+
+	return simple_read_from_buffer(bufu, count, ppos, &bin->hdr,
+			sizeof(bin->hdr) + sizeof(bin->rec));
+}
+
+static int msm_rpmstats_bin_open(struct inode *inode, struct file *file)
+{
+	struct msm_rpmstats_platform_data *pdata = inode->i_private;
+	struct msm_rpmstats_bin *bin;
+
+	bin = kzalloc(sizeof(*bin), GFP_KERNEL);
+	if (!bin)
+		return -ENOMEM;
+
+	bin->reg_base = ioremap_nocache(pdata->phys_addr_base,
+					pdata->phys_size);
+	if (!bin->reg_base) {
+		kfree(bin);
+		return -EBUSY;
+	}
+
+	file->private_data = bin;
+	return 0;
+}
+
+static int msm_rpmstats_bin_close(struct inode *inode, struct file *file)
+{
+	struct msm_rpmstats_bin *bin = file->private_data;
+
+	iounmap(bin->reg_base);
+	kfree(bin);
+	return 0;
+}
+
+static const struct file_operations msm_rpmstats_bin_fops = {
+	.owner	  = THIS_MODULE,
+	.open	  = msm_rpmstats_bin_open,
+	.read	  = msm_rpmstats_bin_read,
+	.release  = msm_rpmstats_bin_close,
+	.llseek   = default_llseek,
+};
+
+static struct dentry *msm_rpmstats_bin_dent;
+
 static  int msm_rpmstats_probe(struct platform_device *pdev)
 {
 	struct dentry *dent = NULL;
@@ -356,6 +456,10 @@ static  int msm_rpmstats_probe(struct platform_device *pdev)
 			return -ENOMEM;
 		}
 
+		if (pdata->version == 2)
+			msm_rpmstats_bin_dent = debugfs_create_file(
+					"rpm_stats_bin", S_IRUGO, NULL,
+					pdata, &msm_rpmstats_bin_fops);
 	} else {
 		kfree(pdata);
 		return -EINVAL;
@@ -370,6 +474,8 @@ static int msm_rpmstats_remove(struct platform_device *pdev)
 
 	dent = platform_get_drvdata(pdev);
 	debugfs_remove(dent);
+	debugfs_remove(msm_rpmstats_bin_dent);
+	msm_rpmstats_bin_dent = NULL;
 	platform_set_drvdata(pdev, NULL);
 	return 0;
 }
@@ -38,6 +38,8 @@
 #include <linux/of.h>
 #include <linux/of_irq.h>
 #include <linux/ipc_logging.h>
+#include <linux/hrtimer.h>
+#include <linux/seq_file.h>
 
 #include <soc/qcom/ramdump.h>
 #include <soc/qcom/smd.h>
@@ -144,6 +146,31 @@ int msm_smd_debug_mask = MSM_SMD_POWER_INFO | MSM_SMD_INFO |
 							MSM_SMSM_POWER_INFO;
 module_param_named(debug_mask, msm_smd_debug_mask,
 		   int, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/*
+ * When non-zero, a write that lands in a FIFO the remote has not drained
+ * yet does not raise its own interrupt; the remote is still working on
+ * the previous notification, so one interrupt is deferred by up to this
+ * many microseconds and covers the whole batch.
+ */
+static unsigned int smd_intr_coalesce_us;
+module_param_named(intr_coalesce_us, smd_intr_coalesce_us,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+
+/*
+ * Adaptive receive polling. When an edge raises more than
+ * poll_irq_threshold interrupts within SMD_POLL_WINDOW, its interrupt is
+ * masked and the edge is serviced from a timer every poll_interval_us
+ * until a pass finds no data, at which point the interrupt is unmasked
+ * again. A threshold of 0 disables polling.
+ */
+#define SMD_POLL_WINDOW msecs_to_jiffies(10)
+static unsigned int smd_poll_irq_threshold;
+module_param_named(poll_irq_threshold, smd_poll_irq_threshold,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
+static unsigned int smd_poll_interval_us = 500;
+module_param_named(poll_interval_us, smd_poll_interval_us,
+		   uint, S_IRUGO | S_IWUSR | S_IWGRP);
 void *smd_log_ctx;
 void *smsm_log_ctx;
 #define NUM_LOG_PAGES 4
@@ -221,6 +248,66 @@ static inline void smd_write_intr(unsigned int val, void __iomem *addr)
 	__raw_writel(val, addr);
 }
 
+/* user data is staged through this many bytes of stack per uaccess call */
+#define SMD_BOUNCE_SIZE 256
+
+static void *smd_memcpy_to_fifo(void *dest, const void *src, size_t num_bytes,
+								bool from_user);
+static void *smd_memcpy_from_fifo(void *dest, const void *src, size_t num_bytes,
+								bool to_user);
+
+/**
+ * smd_copy_user_to_fifo() - copy user data to SMD channel FIFO
+ * @dest: Destination address in the FIFO
+ * @src: Userspace source address
+ * @num_bytes: Number of bytes to copy
+ *
+ * Pulls user data in SMD_BOUNCE_SIZE chunks into a bounce buffer and writes
+ * it out with the double word FIFO accessors, instead of taking a uaccess
+ * round trip for every 8 bytes of uncached FIFO.
+ */
+static void smd_copy_user_to_fifo(void *dest, const void *src,
+							size_t num_bytes)
+{
+	union fifo_mem bounce[SMD_BOUNCE_SIZE / sizeof(union fifo_mem)];
+	size_t n;
+	int ret;
+
+	while (num_bytes) {
+		n = min_t(size_t, num_bytes, sizeof(bounce));
+		ret = copy_from_user(bounce, (void __user *)src, n);
+		BUG_ON(ret != 0);
+		smd_memcpy_to_fifo(dest, bounce, n, false);
+		dest += n;
+		src += n;
+		num_bytes -= n;
+	}
+}
+
+/**
+ * smd_copy_fifo_to_user() - copy from SMD channel FIFO to user
+ * @dest: Userspace destination address
+ * @src: Source address in the FIFO
+ * @num_bytes: Number of bytes to copy
+ */
+static void smd_copy_fifo_to_user(void *dest, const void *src,
+							size_t num_bytes)
+{
+	union fifo_mem bounce[SMD_BOUNCE_SIZE / sizeof(union fifo_mem)];
+	size_t n;
+	int ret;
+
+	while (num_bytes) {
+		n = min_t(size_t, num_bytes, sizeof(bounce));
+		smd_memcpy_from_fifo(bounce, src, n, false);
+		ret = copy_to_user((void __user *)dest, bounce, n);
+		BUG_ON(ret != 0);
+		dest += n;
+		src += n;
+		num_bytes -= n;
+	}
+}
+
 /**
  * smd_memcpy_to_fifo() - copy to SMD channel FIFO
  * @dest: Destination address
@@ -239,32 +326,33 @@ static void *smd_memcpy_to_fifo(void *dest, const void *src, size_t num_bytes,
 	union fifo_mem *temp_dst = (union fifo_mem *)dest;
 	union fifo_mem *temp_src = (union fifo_mem *)src;
 	uintptr_t mask = sizeof(union fifo_mem) - 1;
-	int ret;
+
+	if (from_user) {
+		smd_copy_user_to_fifo(dest, src, num_bytes);
+		return dest;
+	}
 
 	/* Do byte copies until we hit 8-byte (double word) alignment */
 	while ((uintptr_t)temp_dst & mask && num_bytes) {
-		if (from_user) {
-			ret = copy_from_user(temp_dst, temp_src, 1);
-			BUG_ON(ret != 0);
-		} else {
-			__raw_writeb_no_log(temp_src->u8, temp_dst);
-		}
-
+		__raw_writeb_no_log(temp_src->u8, temp_dst);
 		temp_src = (union fifo_mem *)((uintptr_t)temp_src + 1);
 		temp_dst = (union fifo_mem *)((uintptr_t)temp_dst + 1);
 		num_bytes--;
 	}
 
-	/* Do double word copies */
-	while (num_bytes >= sizeof(union fifo_mem)) {
-		if (from_user) {
-			ret = copy_from_user(temp_dst, temp_src,
-				sizeof(union fifo_mem));
-			BUG_ON(ret != 0);
-		} else {
-			__raw_writeq_no_log(temp_src->u64, temp_dst);
-		}
+	/* Do double word copies, four per iteration while we can */
+	while (num_bytes >= 4 * sizeof(union fifo_mem)) {
+		__raw_writeq_no_log(temp_src[0].u64, &temp_dst[0]);
+		__raw_writeq_no_log(temp_src[1].u64, &temp_dst[1]);
+		__raw_writeq_no_log(temp_src[2].u64, &temp_dst[2]);
+		__raw_writeq_no_log(temp_src[3].u64, &temp_dst[3]);
+		temp_dst += 4;
+		temp_src += 4;
+		num_bytes -= 4 * sizeof(union fifo_mem);
+	}
 
+	while (num_bytes >= sizeof(union fifo_mem)) {
+		__raw_writeq_no_log(temp_src->u64, temp_dst);
 		temp_dst++;
 		temp_src++;
 		num_bytes -= sizeof(union fifo_mem);
@@ -272,13 +360,7 @@ static void *smd_memcpy_to_fifo(void *dest, const void *src, size_t num_bytes,
 
 	/* Copy remaining bytes */
 	while (num_bytes--) {
-		if (from_user) {
-			ret = copy_from_user(temp_dst, temp_src, 1);
-			BUG_ON(ret != 0);
-		} else {
-			__raw_writeb_no_log(temp_src->u8, temp_dst);
-		}
-
+		__raw_writeb_no_log(temp_src->u8, temp_dst);
 		temp_src = (union fifo_mem *)((uintptr_t)temp_src + 1);
 		temp_dst = (union fifo_mem *)((uintptr_t)temp_dst + 1);
 	}
@@ -305,32 +387,33 @@ static void *smd_memcpy_from_fifo(void *dest, const void *src, size_t num_bytes,
 	union fifo_mem *temp_dst = (union fifo_mem *)dest;
 	union fifo_mem *temp_src = (union fifo_mem *)src;
 	uintptr_t mask = sizeof(union fifo_mem) - 1;
-	int ret;
+
+	if (to_user) {
+		smd_copy_fifo_to_user(dest, src, num_bytes);
+		return dest;
+	}
 
 	/* Do byte copies until we hit 8-byte (double word) alignment */
 	while ((uintptr_t)temp_src & mask && num_bytes) {
-		if (to_user) {
-			ret = copy_to_user(temp_dst, temp_src, 1);
-			BUG_ON(ret != 0);
-		} else {
-			temp_dst->u8 = __raw_readb_no_log(temp_src);
-		}
-
+		temp_dst->u8 = __raw_readb_no_log(temp_src);
 		temp_src = (union fifo_mem *)((uintptr_t)temp_src + 1);
 		temp_dst = (union fifo_mem *)((uintptr_t)temp_dst + 1);
 		num_bytes--;
 	}
 
-	/* Do double word copies */
-	while (num_bytes >= sizeof(union fifo_mem)) {
-		if (to_user) {
-			ret = copy_to_user(temp_dst, temp_src,
-				sizeof(union fifo_mem));
-			BUG_ON(ret != 0);
-		} else {
-			temp_dst->u64 = __raw_readq_no_log(temp_src);
-		}
+	/* Do double word copies, four per iteration while we can */
+	while (num_bytes >= 4 * sizeof(union fifo_mem)) {
+		temp_dst[0].u64 = __raw_readq_no_log(&temp_src[0]);
+		temp_dst[1].u64 = __raw_readq_no_log(&temp_src[1]);
+		temp_dst[2].u64 = __raw_readq_no_log(&temp_src[2]);
+		temp_dst[3].u64 = __raw_readq_no_log(&temp_src[3]);
+		temp_dst += 4;
+		temp_src += 4;
+		num_bytes -= 4 * sizeof(union fifo_mem);
+	}
 
+	while (num_bytes >= sizeof(union fifo_mem)) {
+		temp_dst->u64 = __raw_readq_no_log(temp_src);
 		temp_dst++;
 		temp_src++;
 		num_bytes -= sizeof(union fifo_mem);
@@ -338,13 +421,7 @@ static void *smd_memcpy_from_fifo(void *dest, const void *src, size_t num_bytes,
 
 	/* Copy remaining bytes */
 	while (num_bytes--) {
-		if (to_user) {
-			ret = copy_to_user(temp_dst, temp_src, 1);
-			BUG_ON(ret != 0);
-		} else {
-			temp_dst->u8 = __raw_readb_no_log(temp_src);
-		}
-
+		temp_dst->u8 = __raw_readb_no_log(temp_src);
 		temp_src = (union fifo_mem *)((uintptr_t)temp_src + 1);
 		temp_dst = (union fifo_mem *)((uintptr_t)temp_dst + 1);
 	}
@@ -706,6 +783,14 @@ struct remote_proc_info {
 	/* 2 total supported tables of channels */
 	unsigned char ch_allocated[SMEM_NUM_SMD_STREAM_CHANNELS * 2];
 	bool skip_pil;
+
+	/* adaptive receive polling state */
+	struct hrtimer poll_timer;
+	void (*poll_notify)(smd_channel_t *ch);
+	int poll_irq;
+	bool polling;
+	unsigned long irq_window;
+	unsigned irq_window_count;
 };
 
 static struct remote_proc_info remote_info[NUM_SMD_SUBSYSTEMS];
@@ -1226,8 +1311,11 @@ static int ch_read(struct smd_channel *ch, void *_data, int len, int user_buf)
 
 		if (n > len)
 			n = len;
-		if (_data)
+		if (_data) {
 			ch->read_from_fifo(data, ptr, n, user_buf);
+			ch->stats.rx_copies++;
+		}
+		ch->stats.rx_bytes += n;
 
 		data += n;
 		len -= n;
@@ -1315,6 +1403,52 @@ static void ch_write_done(struct smd_channel *ch, unsigned count)
 	ch->half_ch->set_fHEAD(ch->send, 1);
 }
 
+/* true if the remote still has data from an earlier write to drain */
+static bool ch_tx_pending(struct smd_channel *ch)
+{
+	return ch->half_ch->get_head(ch->send) !=
+		ch->half_ch->get_tail(ch->send);
+}
+
+static enum hrtimer_restart smd_intr_timer_fn(struct hrtimer *timer)
+{
+	struct smd_channel *ch = container_of(timer, struct smd_channel,
+					      intr_timer);
+
+	ch->stats.tx_intr++;
+	ch->notify_other_cpu(ch);
+
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * ch_notify_write() - Tell the remote about newly written data
+ * @ch: channel
+ * @was_pending: the FIFO already held undrained data before this write
+ *
+ * With coalescing enabled and the remote still draining an earlier write,
+ * the interrupt is deferred to intr_timer so back-to-back writes share it.
+ * Otherwise the remote is interrupted immediately, which also covers any
+ * deferred notification still outstanding.
+ */
+static void ch_notify_write(struct smd_channel *ch, bool was_pending)
+{
+	unsigned int delay_us = ACCESS_ONCE(smd_intr_coalesce_us);
+
+	if (delay_us && was_pending) {
+		if (!hrtimer_active(&ch->intr_timer))
+			hrtimer_start(&ch->intr_timer,
+				      ns_to_ktime(delay_us * NSEC_PER_USEC),
+				      HRTIMER_MODE_REL);
+		ch->stats.tx_intr_coalesced++;
+		return;
+	}
+
+	hrtimer_try_to_cancel(&ch->intr_timer);
+	ch->stats.tx_intr++;
+	ch->notify_other_cpu(ch);
+}
+
 static void ch_set_state(struct smd_channel *ch, unsigned n)
 {
 	if (n == SMD_SS_OPENED) {
@@ -1411,7 +1545,7 @@ static void handle_smd_irq_closing_list(void)
 	spin_unlock_irqrestore(&smd_lock, flags);
 }
 
-static void handle_smd_irq(struct remote_proc_info *r_info,
+static unsigned handle_smd_irq(struct remote_proc_info *r_info,
 		void (*notify)(smd_channel_t *ch))
 {
 	unsigned long flags;
@@ -1420,6 +1554,7 @@ static void handle_smd_irq(struct remote_proc_info *r_info,
 	unsigned tmp;
 	unsigned char state_change;
 	struct list_head *list;
+	unsigned events = 0;
 
 	list = &r_info->ch_list;
 
@@ -1463,6 +1598,7 @@ static void handle_smd_irq(struct remote_proc_info *r_info,
 				ch->half_ch->get_head(ch->recv)
 				);
 			ch->notify(ch->priv, SMD_EVENT_DATA);
+			events++;
 		}
 		if (ch_flags & 0x4 && !state_change) {
 			SMD_POWER_INFO("SMD ch%d '%s' State update\n",
@@ -1472,6 +1608,70 @@ static void handle_smd_irq(struct remote_proc_info *r_info,
 	}
 	spin_unlock_irqrestore(&smd_lock, flags);
 	do_smd_probe(r_info->remote_pid);
+
+	return events;
+}
+
+static enum hrtimer_restart smd_poll_timer_fn(struct hrtimer *timer)
+{
+	struct remote_proc_info *r_info = container_of(timer,
+					struct remote_proc_info, poll_timer);
+	unsigned events;
+
+	events = handle_smd_irq(r_info, r_info->poll_notify);
+	handle_smd_irq_closing_list();
+
+	if (events) {
+		++interrupt_stats[r_info->remote_pid].smd_poll_count;
+		hrtimer_forward_now(timer, ns_to_ktime(
+				ACCESS_ONCE(smd_poll_interval_us) *
+				NSEC_PER_USEC));
+		return HRTIMER_RESTART;
+	}
+
+	/* edge went idle, hand it back to the interrupt */
+	r_info->polling = false;
+	r_info->irq_window = jiffies;
+	r_info->irq_window_count = 0;
+	enable_irq(r_info->poll_irq);
+
+	return HRTIMER_NORESTART;
+}
+
+/**
+ * smd_edge_irq() - Service an incoming SMD interrupt for an edge
+ * @r_info: remote processor the interrupt came from
+ * @irq: the interrupt, masked if the edge switches to polling
+ * @notify: function to notify the remote processor
+ */
+static void smd_edge_irq(struct remote_proc_info *r_info, int irq,
+		void (*notify)(smd_channel_t *ch))
+{
+	unsigned threshold = ACCESS_ONCE(smd_poll_irq_threshold);
+
+	handle_smd_irq(r_info, notify);
+	handle_smd_irq_closing_list();
+
+	if (!threshold || r_info->polling)
+		return;
+
+	if (time_after(jiffies, r_info->irq_window + SMD_POLL_WINDOW)) {
+		r_info->irq_window = jiffies;
+		r_info->irq_window_count = 0;
+	}
+	if (++r_info->irq_window_count < threshold)
+		return;
+
+	SMD_POWER_INFO("SMD edge %s switching to polling\n",
+			smd_pid_to_subsystem(r_info->remote_pid));
+	r_info->polling = true;
+	r_info->poll_irq = irq;
+	r_info->poll_notify = notify;
+	disable_irq_nosync(irq);
+	hrtimer_start(&r_info->poll_timer,
+		      ns_to_ktime(ACCESS_ONCE(smd_poll_interval_us) *
+				  NSEC_PER_USEC),
+		      HRTIMER_MODE_REL);
 }
 
 static inline void log_irq(uint32_t subsystem)
@@ -1489,8 +1689,7 @@ irqreturn_t smd_modem_irq_handler(int irq, void *data)
 		return IRQ_HANDLED;
 	log_irq(SMD_APPS_MODEM);
 	++interrupt_stats[SMD_MODEM].smd_in_count;
-	handle_smd_irq(&remote_info[SMD_MODEM], notify_modem_smd);
-	handle_smd_irq_closing_list();
+	smd_edge_irq(&remote_info[SMD_MODEM], irq, notify_modem_smd);
 	return IRQ_HANDLED;
 }
 
@@ -1500,8 +1699,7 @@ irqreturn_t smd_dsp_irq_handler(int irq, void *data)
 		return IRQ_HANDLED;
 	log_irq(SMD_APPS_QDSP);
 	++interrupt_stats[SMD_Q6].smd_in_count;
-	handle_smd_irq(&remote_info[SMD_Q6], notify_dsp_smd);
-	handle_smd_irq_closing_list();
+	smd_edge_irq(&remote_info[SMD_Q6], irq, notify_dsp_smd);
 	return IRQ_HANDLED;
 }
 
@@ -1511,8 +1709,7 @@ irqreturn_t smd_dsps_irq_handler(int irq, void *data)
 		return IRQ_HANDLED;
 	log_irq(SMD_APPS_DSPS);
 	++interrupt_stats[SMD_DSPS].smd_in_count;
-	handle_smd_irq(&remote_info[SMD_DSPS], notify_dsps_smd);
-	handle_smd_irq_closing_list();
+	smd_edge_irq(&remote_info[SMD_DSPS], irq, notify_dsps_smd);
 	return IRQ_HANDLED;
 }
 
@@ -1522,8 +1719,7 @@ irqreturn_t smd_wcnss_irq_handler(int irq, void *data)
 		return IRQ_HANDLED;
 	log_irq(SMD_APPS_WCNSS);
 	++interrupt_stats[SMD_WCNSS].smd_in_count;
-	handle_smd_irq(&remote_info[SMD_WCNSS], notify_wcnss_smd);
-	handle_smd_irq_closing_list();
+	smd_edge_irq(&remote_info[SMD_WCNSS], irq, notify_wcnss_smd);
 	return IRQ_HANDLED;
 }
 
@@ -1533,8 +1729,7 @@ irqreturn_t smd_modemfw_irq_handler(int irq, void *data)
 		return IRQ_HANDLED;
 	log_irq(SMD_APPS_Q6FW);
 	++interrupt_stats[SMD_MODEM_Q6_FW].smd_in_count;
-	handle_smd_irq(&remote_info[SMD_MODEM_Q6_FW], notify_modemfw_smd);
-	handle_smd_irq_closing_list();
+	smd_edge_irq(&remote_info[SMD_MODEM_Q6_FW], irq, notify_modemfw_smd);
 	return IRQ_HANDLED;
 }
 
@@ -1544,8 +1739,7 @@ irqreturn_t smd_rpm_irq_handler(int irq, void *data)
 		return IRQ_HANDLED;
 	log_irq(SMD_APPS_RPM);
 	++interrupt_stats[SMD_RPM].smd_in_count;
-	handle_smd_irq(&remote_info[SMD_RPM], notify_rpm_smd);
-	handle_smd_irq_closing_list();
+	smd_edge_irq(&remote_info[SMD_RPM], irq, notify_rpm_smd);
 	return IRQ_HANDLED;
 }
 
@@ -1580,6 +1774,7 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	const unsigned char *buf = _data;
 	unsigned xfer;
 	int orig_len = len;
+	bool was_pending;
 
 	SMD_DBG("smd_stream_write() %d -> ch%d\n", len, ch->n);
 	if (len < 0)
@@ -1587,6 +1782,8 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	else if (len == 0)
 		return 0;
 
+	was_pending = ch_tx_pending(ch);
+
 	while ((xfer = ch_write_buffer(ch, &ptr)) != 0) {
 		if (!ch_is_open(ch)) {
 			len = orig_len;
@@ -1597,6 +1794,8 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 
 		ch->write_to_fifo(ptr, buf, xfer, user_buf);
 		ch_write_done(ch, xfer);
+		ch->stats.tx_bytes += xfer;
+		ch->stats.tx_copies++;
 		len -= xfer;
 		buf += xfer;
 		if (len == 0)
@@ -1604,7 +1803,7 @@ static int smd_stream_write(smd_channel_t *ch, const void *_data, int len,
 	}
 
 	if (orig_len - len && intr_ntfy)
-		ch->notify_other_cpu(ch);
+		ch_notify_write(ch, was_pending);
 
 	return orig_len - len;
 }
@@ -1614,6 +1813,7 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 {
 	int ret;
 	unsigned hdr[5];
+	bool was_pending;
 
 	SMD_DBG("smd_packet_write() %d -> ch%d\n", len, ch->n);
 	if (len < 0)
@@ -1624,6 +1824,8 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	if (smd_stream_write_avail(ch) < (len + SMD_HEADER_SIZE))
 		return -ENOMEM;
 
+	was_pending = ch_tx_pending(ch);
+
 	hdr[0] = len;
 	hdr[1] = hdr[2] = hdr[3] = hdr[4] = 0;
 
@@ -1636,13 +1838,16 @@ static int smd_packet_write(smd_channel_t *ch, const void *_data, int len,
 	}
 
 
-	ret = smd_stream_write(ch, _data, len, user_buf, true);
+	ret = smd_stream_write(ch, _data, len, user_buf, false);
 	if (ret < 0 || ret != len) {
 		SMD_DBG("%s failed to write pkt data: %d returned\n",
 								__func__, ret);
 		return ret;
 	}
 
+	if (intr_ntfy)
+		ch_notify_write(ch, was_pending);
+
 	return len;
 }
 
@@ -1826,6 +2031,9 @@ static int smd_alloc_channel(struct smd_alloc_elm *alloc_elm, int table_id,
 
 	ch->fifo_mask = ch->fifo_size - 1;
 
+	hrtimer_init(&ch->intr_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ch->intr_timer.function = smd_intr_timer_fn;
+
 	/* probe_worker guarentees ch->type will be a valid type */
 	if (ch->type == SMD_APPS_MODEM)
 		ch->notify_other_cpu = notify_modem_smd;
@@ -2022,6 +2230,8 @@ int smd_close(smd_channel_t *ch)
 
 	SMD_INFO("smd_close(%s)\n", ch->name);
 
+	hrtimer_cancel(&ch->intr_timer);
+
 	spin_lock_irqsave(&smd_lock, flags);
 	list_del(&ch->ch_list);
 
@@ -2042,6 +2252,32 @@ int smd_close(smd_channel_t *ch)
 }
 EXPORT_SYMBOL(smd_close);
 
+/**
+ * smd_print_ch_stats() - Print data path counters of all open channels
+ * @s: the sequential file to print to
+ */
+void smd_print_ch_stats(struct seq_file *s)
+{
+	struct smd_channel *ch;
+	unsigned long flags;
+	int i;
+
+	seq_printf(s, "%-20s %12s %8s %12s %8s %8s %8s\n", "Name",
+		   "TX bytes", "TX copy", "RX bytes", "RX copy", "TX intr",
+		   "Coalesce");
+
+	spin_lock_irqsave(&smd_lock, flags);
+	for (i = 0; i < NUM_SMD_SUBSYSTEMS; ++i) {
+		list_for_each_entry(ch, &remote_info[i].ch_list, ch_list)
+			seq_printf(s, "%-20s %12llu %8u %12llu %8u %8u %8u\n",
+				   ch->name, ch->stats.tx_bytes,
+				   ch->stats.tx_copies, ch->stats.rx_bytes,
+				   ch->stats.rx_copies, ch->stats.tx_intr,
+				   ch->stats.tx_intr_coalesced);
+	}
+	spin_unlock_irqrestore(&smd_lock, flags);
+}
+
 int smd_write_start(smd_channel_t *ch, int len)
 {
 	int ret;
@@ -3295,6 +3531,9 @@ int __init msm_smd_init(void)
 		remote_info[i].free_space = UINT_MAX;
 		INIT_WORK(&remote_info[i].probe_work, smd_channel_probe_worker);
 		INIT_LIST_HEAD(&remote_info[i].ch_list);
+		hrtimer_init(&remote_info[i].poll_timer, CLOCK_MONOTONIC,
+			     HRTIMER_MODE_REL);
+		remote_info[i].poll_timer.function = smd_poll_timer_fn;
 	}
 
 	channel_close_wq = create_singlethread_workqueue("smd_channel_close");
@@ -71,6 +71,12 @@ static void debug_int_stats(struct seq_file *s)
 				stats->smsm_interrupt_id,
 				stats->smsm_in_count,
 				stats->smsm_out_count);
+
+			if (stats->smd_poll_count)
+				seq_printf(s,
+					"%-10s %4s |              | %9u |\n",
+					smd_pid_to_subsystem(subsys), "poll",
+					stats->smd_poll_count);
 		}
 		++stats;
 	}
@@ -86,6 +92,7 @@ static void debug_int_stats_reset(struct seq_file *s)
 	for (subsys = 0; subsys < NUM_SMD_SUBSYSTEMS; ++subsys) {
 		stats->smd_in_count = 0;
 		stats->smd_out_count = 0;
+		stats->smd_poll_count = 0;
 		stats->smsm_in_count = 0;
 		stats->smsm_out_count = 0;
 		++stats;
@@ -396,6 +403,7 @@ static int __init smd_debugfs_init(void)
 	debug_create("version", 0444, dent, debug_read_smd_version);
 	debug_create("int_stats", 0444, dent, debug_int_stats);
 	debug_create("int_stats_reset", 0444, dent, debug_int_stats_reset);
+	debug_create("ch_stats", 0444, dent, smd_print_ch_stats);
 
 	return 0;
 }
@@ -22,6 +22,7 @@
 #include <linux/remote_spinlock.h>
 #include <linux/platform_device.h>
 #include <linux/interrupt.h>
+#include <linux/hrtimer.h>
 
 #include <soc/qcom/smd.h>
 #include <soc/qcom/smsm.h>
@@ -128,6 +129,16 @@ int is_word_access_ch(unsigned ch_type);
 
 struct smd_half_channel_access *get_half_ch_funcs(unsigned ch_type);
 
+/* per-channel data path counters, reported in debugfs smd/ch_stats */
+struct smd_ch_stats {
+	uint64_t tx_bytes;
+	uint64_t rx_bytes;
+	uint32_t tx_copies;
+	uint32_t rx_copies;
+	uint32_t tx_intr;
+	uint32_t tx_intr_coalesced;
+};
+
 struct smd_channel {
 	volatile void __iomem *send; /* some variant of smd_half_channel */
 	volatile void __iomem *recv; /* some variant of smd_half_channel */
@@ -171,6 +182,10 @@ struct smd_channel {
 	 * never to be exported outside of smd
 	 */
 	struct smd_half_channel_access *half_ch;
+
+	/* deferred remote notification while write interrupts are coalesced */
+	struct hrtimer intr_timer;
+	struct smd_ch_stats stats;
 };
 
 extern spinlock_t smem_lock;
@@ -179,6 +194,7 @@ struct interrupt_stat {
 	uint32_t smd_in_count;
 	uint32_t smd_out_count;
 	uint32_t smd_interrupt_id;
+	uint32_t smd_poll_count;
 
 	uint32_t smsm_in_count;
 	uint32_t smsm_out_count;
@@ -244,4 +260,7 @@ extern void smd_proc_set_skip_pil(unsigned pid, bool skip_pil);
 extern void smd_set_edge_initialized(uint32_t edge);
 extern void smd_cfg_smd_intr(uint32_t proc, uint32_t mask, void *ptr);
 extern void smd_cfg_smsm_intr(uint32_t proc, uint32_t mask, void *ptr);
+
+struct seq_file;
+extern void smd_print_ch_stats(struct seq_file *s);
 #endif
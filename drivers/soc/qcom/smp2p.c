@@ -1671,6 +1671,7 @@ static irqreturn_t smp2p_interrupt_handler(int irq, void *data)
 
 	spin_lock_irqsave(&out_list[remote_pid].out_item_lock_lha1, flags);
 	++smp2p_int_cfgs[remote_pid].in_interrupt_count;
+	smp2p_int_cfgs[remote_pid].in_interrupt_time = ktime_get();
 
 	if (out_list[remote_pid].smem_edge_state != SMP2P_EDGE_STATE_OPENED)
 		smp2p_do_negotiation(remote_pid, &out_list[remote_pid]);
@@ -16,6 +16,7 @@
 
 #include <linux/types.h>
 #include <linux/spinlock.h>
+#include <linux/ktime.h>
 #include <linux/ipc_logging.h>
 #include "smp2p_private_api.h"
 
@@ -242,6 +243,7 @@ struct smp2p_interrupt_config {
 	/* interrupt stats */
 	unsigned in_interrupt_count;
 	unsigned out_interrupt_count;
+	ktime_t in_interrupt_time;
 };
 
 struct smp2p_interrupt_config *smp2p_get_interrupt_config(void);
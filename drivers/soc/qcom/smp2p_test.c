@@ -655,6 +655,199 @@ static void smp2p_ut_remote_inout(struct seq_file *s)
 	}
 }
 
+/* Log2 usec buckets, the last one also counts everything above */
+#define SMP2P_LAT_BUCKETS 16
+#define SMP2P_LAT_ITERATIONS 200
+
+struct smp2p_lat_hist {
+	unsigned count[SMP2P_LAT_BUCKETS];
+	unsigned samples;
+	s64 min_ns;
+	s64 max_ns;
+	s64 total_ns;
+};
+
+static void smp2p_lat_hist_add(struct smp2p_lat_hist *h, s64 ns)
+{
+	s64 us = div_s64(ns, NSEC_PER_USEC);
+	int bucket = 0;
+
+	while (us > 0 && bucket < SMP2P_LAT_BUCKETS - 1) {
+		us >>= 1;
+		++bucket;
+	}
+	++h->count[bucket];
+
+	if (!h->samples || ns < h->min_ns)
+		h->min_ns = ns;
+	if (ns > h->max_ns)
+		h->max_ns = ns;
+	h->total_ns += ns;
+	++h->samples;
+}
+
+static void smp2p_lat_hist_show(struct seq_file *s, const char *name,
+		struct smp2p_lat_hist *h)
+{
+	int i;
+
+	if (!h->samples) {
+		seq_printf(s, "	%s: no samples\n", name);
+		return;
+	}
+
+	seq_printf(s, "	%s: min %lld avg %lld max %lld us\n", name,
+		div_s64(h->min_ns, NSEC_PER_USEC),
+		div_s64(div_s64(h->total_ns, h->samples), NSEC_PER_USEC),
+		div_s64(h->max_ns, NSEC_PER_USEC));
+
+	for (i = 0; i < SMP2P_LAT_BUCKETS; ++i) {
+		if (!h->count[i])
+			continue;
+		if (i == SMP2P_LAT_BUCKETS - 1)
+			seq_printf(s, "	  >= %6u us: %u\n", 1 << (i - 1),
+				h->count[i]);
+		else
+			seq_printf(s, "	  < %7u us: %u\n", 1 << i,
+				h->count[i]);
+	}
+}
+
+/**
+ * smp2p_ut_remote_latency_core - Measure loopback latency.
+ *
+ * @s: pointer to output file
+ * @remote_pid:  Remote processor to test
+ *
+ * This test sends echo requests to the remote loopback server and
+ * reports histograms of the round-trip time (local write to inbound
+ * notification) and of the time from the incoming interrupt to the
+ * notification.
+ */
+static void smp2p_ut_remote_latency_core(struct seq_file *s, int remote_pid)
+{
+	int failed = 0;
+	struct msm_smp2p_out *handle = NULL;
+	struct smp2p_interrupt_config *int_cfg;
+	struct smp2p_lat_hist rtt;
+	struct smp2p_lat_hist irq;
+	ktime_t start;
+	int ret;
+	int i;
+	uint32_t test_request;
+	uint32_t test_data;
+	static struct mock_cb_data cb_out;
+	static struct mock_cb_data cb_in;
+
+	seq_printf(s, "Running %s for '%s' remote pid %d\n",
+		   __func__, smp2p_pid_to_name(remote_pid), remote_pid);
+	int_cfg = smp2p_get_interrupt_config();
+	memset(&rtt, 0, sizeof(rtt));
+	memset(&irq, 0, sizeof(irq));
+	mock_cb_data_init(&cb_out);
+	mock_cb_data_init(&cb_in);
+	do {
+		/* Open output entry */
+		ret = msm_smp2p_out_open(remote_pid, "smp2p",
+			&cb_out.nb, &handle);
+		UT_ASSERT_INT(ret, ==, 0);
+		UT_ASSERT_INT(
+			(int)wait_for_completion_timeout(
+					&cb_out.cb_completion, HZ / 2),
+			>, 0);
+
+		/* Open inbound entry */
+		ret = msm_smp2p_in_register(remote_pid, "smp2p",
+				&cb_in.nb);
+		UT_ASSERT_INT(ret, ==, 0);
+		UT_ASSERT_INT(
+			(int)wait_for_completion_timeout(
+					&cb_in.cb_completion, HZ / 2),
+			>, 0);
+
+		/* Each echo must change the entry to be notified */
+		test_data = SMP2P_GET_RMT_DATA(
+				cb_in.entry_data.current_value);
+		for (i = 0; i < SMP2P_LAT_ITERATIONS; ++i) {
+			mock_cb_data_reset(&cb_in);
+			test_data = (test_data + 1) & 0xFFFF;
+			test_request = 0x0;
+			SMP2P_SET_RMT_CMD_TYPE(test_request, 1);
+			SMP2P_SET_RMT_CMD(test_request, SMP2P_LB_CMD_ECHO);
+			SMP2P_SET_RMT_DATA(test_request, test_data);
+
+			start = ktime_get();
+			ret = msm_smp2p_out_write(handle, test_request);
+			UT_ASSERT_INT(ret, ==, 0);
+			UT_ASSERT_INT(
+				(int)wait_for_completion_timeout(
+						&cb_in.cb_completion, HZ / 2),
+				>, 0);
+			UT_ASSERT_HEX(test_data, ==, SMP2P_GET_RMT_DATA(
+					cb_in.entry_data.current_value));
+
+			smp2p_lat_hist_add(&rtt, ktime_to_ns(
+				ktime_sub(cb_in.notify_time, start)));
+			if (int_cfg && ktime_compare(
+				int_cfg[remote_pid].in_interrupt_time,
+				start) > 0)
+				smp2p_lat_hist_add(&irq, ktime_to_ns(ktime_sub(
+				    cb_in.notify_time,
+				    int_cfg[remote_pid].in_interrupt_time)));
+		}
+		if (failed)
+			break;
+
+		/* Cleanup */
+		ret = msm_smp2p_out_close(&handle);
+		UT_ASSERT_INT(ret, ==, 0);
+		ret = msm_smp2p_in_unregister(remote_pid, "smp2p", &cb_in.nb);
+		UT_ASSERT_INT(ret, ==, 0);
+
+		smp2p_lat_hist_show(s, "round trip", &rtt);
+		smp2p_lat_hist_show(s, "interrupt to notify", &irq);
+		seq_puts(s, "\tOK\n");
+	} while (0);
+
+	if (failed) {
+		if (handle)
+			(void)msm_smp2p_out_close(&handle);
+		(void)msm_smp2p_in_unregister(remote_pid, "smp2p", &cb_in.nb);
+
+		pr_err("%s: Failed\n", __func__);
+		seq_puts(s, "\tFailed\n");
+	}
+}
+
+/**
+ * smp2p_ut_remote_latency - Measure loopback latency for all.
+ *
+ * @s: pointer to output file
+ *
+ * This test measures the loopback latency of all configured remote
+ * processors.
+ */
+static void smp2p_ut_remote_latency(struct seq_file *s)
+{
+	struct smp2p_interrupt_config *int_cfg;
+	int pid;
+
+	int_cfg = smp2p_get_interrupt_config();
+	if (!int_cfg) {
+		seq_puts(s, "Remote processor config unavailable\n");
+		return;
+	}
+
+	for (pid = 0; pid < SMP2P_NUM_PROCS; ++pid) {
+		if (!int_cfg[pid].is_configured)
+			continue;
+
+		msm_smp2p_deinit_rmt_lpb_proc(pid);
+		smp2p_ut_remote_latency_core(s, pid);
+		msm_smp2p_init_rmt_lpb_proc(pid);
+	}
+}
+
 /**
  * smp2p_ut_remote_out_max_entries_core - Verify open functionality.
  *
@@ -1242,6 +1435,8 @@ static int __init smp2p_debugfs_init(void)
 			smp2p_ut_local_ssr_ack);
 	smp2p_debug_create("ut_remote_ssr_ack",
 			smp2p_ut_remote_ssr_ack);
+	smp2p_debug_create("ut_remote_latency",
+			smp2p_ut_remote_latency);
 
 	return 0;
 }
@@ -126,6 +126,7 @@ struct mock_cb_data {
 	int event_open;
 	int event_entry_update;
 	struct msm_smp2p_update_notif entry_data;
+	ktime_t notify_time;
 };
 
 void smp2p_debug_create(const char *name, void (*show)(struct seq_file *));
@@ -184,6 +185,7 @@ static inline int smp2p_test_notify(struct notifier_block *self,
 	cb_data_ptr = container_of(self, struct mock_cb_data, nb);
 
 	spin_lock_irqsave(&cb_data_ptr->lock, flags);
+	cb_data_ptr->notify_time = ktime_get();
 
 	switch (event) {
 	case SMP2P_OPEN:
@@ -25,6 +25,7 @@
 #include <linux/of.h>
 #include <linux/cpu.h>
 #include <linux/platform_device.h>
+#include <linux/timer.h>
 #include <soc/qcom/scm.h>
 #include <soc/qcom/memory_dump.h>
 
@@ -54,6 +55,7 @@ struct msm_watchdog_data {
 	struct device *dev;
 	unsigned int pet_time;
 	unsigned int bark_time;
+	unsigned int backstop_time;
 	unsigned int bark_irq;
 	unsigned int bite_irq;
 	bool do_ipi_ping;
@@ -65,6 +67,7 @@ struct msm_watchdog_data {
 	struct mutex disable_lock;
 	struct work_struct init_dogwork_struct;
 	struct delayed_work dogwork_struct;
+	struct timer_list pet_backstop;
 	bool irq_ppi;
 	struct msm_watchdog_data __percpu **wdog_cpu_dd;
 	struct notifier_block panic_blk;
@@ -167,6 +170,7 @@ static void wdog_disable(struct msm_watchdog_data *wdog_dd)
 	atomic_notifier_chain_unregister(&panic_notifier_list,
 						&wdog_dd->panic_blk);
 	cancel_delayed_work_sync(&wdog_dd->dogwork_struct);
+	del_timer_sync(&wdog_dd->pet_backstop);
 	/* may be suspended after the first write above */
 	__raw_writel(0, wdog_dd->base + WDT0_EN);
 	mb();
@@ -287,8 +291,17 @@ static void ping_other_cpus(struct msm_watchdog_data *wdog_dd)
 	int cpu;
 	cpumask_clear(&wdog_dd->alive_mask);
 	smp_mb();
-	for_each_cpu(cpu, cpu_online_mask)
+	for_each_cpu(cpu, cpu_online_mask) {
+		/*
+		 * A cpu sitting in the idle loop is not stuck, and an IPI
+		 * would only pull it out of power collapse.
+		 */
+		if (idle_cpu(cpu)) {
+			cpumask_set_cpu(cpu, &wdog_dd->alive_mask);
+			continue;
+		}
 		smp_call_function_single(cpu, keep_alive_response, wdog_dd, 1);
+	}
 }
 
 static void pet_watchdog_work(struct work_struct *work)
@@ -306,9 +319,25 @@ static void pet_watchdog_work(struct work_struct *work)
 	}
 	/* Check again before scheduling *
 	 * Could have been changed on other cpu */
-	if (enable)
+	if (enable) {
 		queue_delayed_work_on(0, wdog_wq,
 				&wdog_dd->dogwork_struct, delay_time);
+		mod_timer(&wdog_dd->pet_backstop, jiffies +
+				msecs_to_jiffies(wdog_dd->backstop_time));
+	}
+}
+
+/*
+ * The pet work is deferrable so that it rides along with other wakeups
+ * instead of waking cpu0 on its own. If cpu0 stays idle for long
+ * enough that the bark would come first, this timer forces the pet.
+ */
+static void pet_backstop_fn(unsigned long data)
+{
+	struct msm_watchdog_data *wdog_dd = (struct msm_watchdog_data *)data;
+
+	if (enable)
+		mod_delayed_work_on(0, wdog_wq, &wdog_dd->dogwork_struct, 0);
 }
 
 static int msm_watchdog_remove(struct platform_device *pdev)
@@ -505,6 +534,8 @@ static void init_watchdog_work(struct work_struct *work)
 	mutex_init(&wdog_dd->disable_lock);
 	queue_delayed_work_on(0, wdog_wq, &wdog_dd->dogwork_struct,
 			delay_time);
+	mod_timer(&wdog_dd->pet_backstop, jiffies +
+			msecs_to_jiffies(wdog_dd->backstop_time));
 	__raw_writel(1, wdog_dd->base + WDT0_EN);
 	__raw_writel(1, wdog_dd->base + WDT0_RST);
 	wdog_dd->last_pet = sched_clock();
@@ -583,6 +614,13 @@ static int msm_wdog_dt_to_pdata(struct platform_device *pdev,
 								__func__);
 		return -ENXIO;
 	}
+	/*
+	 * Deferred pets may come up to a pet period late, so leave room
+	 * for the backstop timer half a period before the bark.
+	 */
+	if (pdata->bark_time < 2 * pdata->pet_time)
+		pdata->bark_time = 2 * pdata->pet_time;
+	pdata->backstop_time = pdata->bark_time - pdata->pet_time / 2;
 	pdata->irq_ppi = irq_is_per_cpu(pdata->bark_irq);
 	dump_pdata(pdata);
 	return 0;
@@ -611,7 +649,9 @@ static int msm_watchdog_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, wdog_dd);
 	cpumask_clear(&wdog_dd->alive_mask);
 	INIT_WORK(&wdog_dd->init_dogwork_struct, init_watchdog_work);
-	INIT_DELAYED_WORK(&wdog_dd->dogwork_struct, pet_watchdog_work);
+	INIT_DEFERRABLE_WORK(&wdog_dd->dogwork_struct, pet_watchdog_work);
+	setup_timer(&wdog_dd->pet_backstop, pet_backstop_fn,
+			(unsigned long)wdog_dd);
 	queue_work_on(0, wdog_wq, &wdog_dd->init_dogwork_struct);
 	return 0;
 err:
@@ -467,34 +467,34 @@ static const struct spmi_pmic_arb_ver spmi_pmic_arb_v2 = {
 	.irq_clear		= pmic_arb_irq_clear_v2,
 };
 
-static int pmic_arb_read_cmd(struct spmi_controller *ctrl,
+/*
+ * Extended long commands may ask for more bytes than a single transaction
+ * carries.  They are split into transactions of PMIC_ARB_MAX_TRANS_BYTES,
+ * all within the peripheral of @addr as checked by the SPMI core.  The
+ * lock is dropped between them to bound the time spent with interrupts
+ * disabled.
+ */
+static int pmic_arb_check_bc(struct spmi_pmic_arb_dev *pmic_arb, u8 opc, u8 bc)
+{
+	if (bc < PMIC_ARB_MAX_TRANS_BYTES)
+		return 0;
+	if (opc == PMIC_ARB_OP_EXT_READL || opc == PMIC_ARB_OP_EXT_WRITEL)
+		return 0;
+
+	dev_err(pmic_arb->dev
+	, "pmic-arb supports 1..%d bytes per trans, but:%d requested"
+				, PMIC_ARB_MAX_TRANS_BYTES, bc+1);
+	return  -EINVAL;
+}
+
+static int pmic_arb_read_one(struct spmi_pmic_arb_dev *pmic_arb,
 				u8 opc, u8 sid, u16 addr, u8 bc, u8 *buf)
 {
-	struct spmi_pmic_arb_dev *pmic_arb = spmi_get_ctrldata(ctrl);
 	unsigned long flags;
 	u32 cmd;
 	int rc;
 	phys_addr_t chnl_ofst = pmic_arb->ver->chnl_ofst(pmic_arb, sid, addr);
 
-	if (bc >= PMIC_ARB_MAX_TRANS_BYTES) {
-		dev_err(pmic_arb->dev
-		, "pmic-arb supports 1..%d bytes per trans, but:%d requested"
-					, PMIC_ARB_MAX_TRANS_BYTES, bc+1);
-		return  -EINVAL;
-	}
-	dev_dbg(pmic_arb->dev, "client-rd op:0x%x sid:%d addr:0x%x bc:%d\n",
-							opc, sid, addr, bc + 1);
-
-	/* Check the opcode */
-	if (opc >= 0x60 && opc <= 0x7F)
-		opc = PMIC_ARB_OP_READ;
-	else if (opc >= 0x20 && opc <= 0x2F)
-		opc = PMIC_ARB_OP_EXT_READ;
-	else if (opc >= 0x38 && opc <= 0x3F)
-		opc = PMIC_ARB_OP_EXT_READL;
-	else
-		return -EINVAL;
-
 	cmd = pmic_arb->ver->fmt_cmd(opc, sid, addr, bc);
 
 	spin_lock_irqsave(&pmic_arb->lock, flags);
@@ -519,36 +519,48 @@ done:
 	return rc;
 }
 
-static int pmic_arb_write_cmd(struct spmi_controller *ctrl,
+static int pmic_arb_read_cmd(struct spmi_controller *ctrl,
 				u8 opc, u8 sid, u16 addr, u8 bc, u8 *buf)
 {
 	struct spmi_pmic_arb_dev *pmic_arb = spmi_get_ctrldata(ctrl);
-	unsigned long flags;
-	u32 cmd;
-	int rc;
-	phys_addr_t chnl_ofst = pmic_arb->ver->chnl_ofst(pmic_arb, sid, addr);
+	int done, rc;
+	u8 n;
 
-	if (bc >= PMIC_ARB_MAX_TRANS_BYTES) {
-		dev_err(pmic_arb->dev
-		, "pmic-arb supports 1..%d bytes per trans, but:%d requested"
-					, PMIC_ARB_MAX_TRANS_BYTES, bc+1);
-		return  -EINVAL;
-	}
-	dev_dbg(pmic_arb->dev, "client-wr op:0x%x sid:%d addr:0x%x bc:%d\n",
+	dev_dbg(pmic_arb->dev, "client-rd op:0x%x sid:%d addr:0x%x bc:%d\n",
 							opc, sid, addr, bc + 1);
 
 	/* Check the opcode */
-	if (opc >= 0x40 && opc <= 0x5F)
-		opc = PMIC_ARB_OP_WRITE;
-	else if (opc >= 0x00 && opc <= 0x0F)
-		opc = PMIC_ARB_OP_EXT_WRITE;
-	else if (opc >= 0x30 && opc <= 0x37)
-		opc = PMIC_ARB_OP_EXT_WRITEL;
-	else if (opc >= 0x80 && opc <= 0xFF)
-		opc = PMIC_ARB_OP_ZERO_WRITE;
+	if (opc >= 0x60 && opc <= 0x7F)
+		opc = PMIC_ARB_OP_READ;
+	else if (opc >= 0x20 && opc <= 0x2F)
+		opc = PMIC_ARB_OP_EXT_READ;
+	else if (opc >= 0x38 && opc <= 0x3F)
+		opc = PMIC_ARB_OP_EXT_READL;
 	else
 		return -EINVAL;
 
+	rc = pmic_arb_check_bc(pmic_arb, opc, bc);
+	if (rc)
+		return rc;
+
+	for (done = 0; done <= bc; done += PMIC_ARB_MAX_TRANS_BYTES) {
+		n = min_t(int, bc - done, PMIC_ARB_MAX_TRANS_BYTES - 1);
+		rc = pmic_arb_read_one(pmic_arb, opc, sid, addr + done, n,
+				       buf + done);
+		if (rc)
+			break;
+	}
+	return rc;
+}
+
+static int pmic_arb_write_one(struct spmi_pmic_arb_dev *pmic_arb,
+				u8 opc, u8 sid, u16 addr, u8 bc, u8 *buf)
+{
+	unsigned long flags;
+	u32 cmd;
+	int rc;
+	phys_addr_t chnl_ofst = pmic_arb->ver->chnl_ofst(pmic_arb, sid, addr);
+
 	cmd = pmic_arb->ver->fmt_cmd(opc, sid, addr, bc);
 
 	/* Write data to FIFOs */
@@ -571,6 +583,42 @@ static int pmic_arb_write_cmd(struct spmi_controller *ctrl,
 	return rc;
 }
 
+static int pmic_arb_write_cmd(struct spmi_controller *ctrl,
+				u8 opc, u8 sid, u16 addr, u8 bc, u8 *buf)
+{
+	struct spmi_pmic_arb_dev *pmic_arb = spmi_get_ctrldata(ctrl);
+	int done, rc;
+	u8 n;
+
+	dev_dbg(pmic_arb->dev, "client-wr op:0x%x sid:%d addr:0x%x bc:%d\n",
+							opc, sid, addr, bc + 1);
+
+	/* Check the opcode */
+	if (opc >= 0x40 && opc <= 0x5F)
+		opc = PMIC_ARB_OP_WRITE;
+	else if (opc >= 0x00 && opc <= 0x0F)
+		opc = PMIC_ARB_OP_EXT_WRITE;
+	else if (opc >= 0x30 && opc <= 0x37)
+		opc = PMIC_ARB_OP_EXT_WRITEL;
+	else if (opc >= 0x80 && opc <= 0xFF)
+		opc = PMIC_ARB_OP_ZERO_WRITE;
+	else
+		return -EINVAL;
+
+	rc = pmic_arb_check_bc(pmic_arb, opc, bc);
+	if (rc)
+		return rc;
+
+	for (done = 0; done <= bc; done += PMIC_ARB_MAX_TRANS_BYTES) {
+		n = min_t(int, bc - done, PMIC_ARB_MAX_TRANS_BYTES - 1);
+		rc = pmic_arb_write_one(pmic_arb, opc, sid, addr + done, n,
+					buf + done);
+		if (rc)
+			break;
+	}
+	return rc;
+}
+
 /* APID to PPID */
 static u16 get_peripheral_id(struct spmi_pmic_arb_dev *pmic_arb, u8 apid)
 {
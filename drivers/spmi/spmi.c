@@ -13,6 +13,7 @@
 #define pr_fmt(fmt) "%s: " fmt, __func__
 
 #include <linux/kernel.h>
+#include <linux/bitmap.h>
 #include <linux/errno.h>
 #include <linux/idr.h>
 #include <linux/slab.h>
@@ -21,6 +22,7 @@
 #include <linux/spmi.h>
 #include <linux/module.h>
 #include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
 
 #include "spmi-dbgfs.h"
 
@@ -122,6 +124,7 @@ int spmi_del_controller(struct spmi_controller *ctrl)
 	mutex_unlock(&board_lock);
 
 	spmi_dfs_del_controller(ctrl);
+	spmi_reg_cache_free_all(ctrl);
 
 	mutex_lock(&board_lock);
 	idr_remove(&ctrl_idr, ctrl->nr);
@@ -371,6 +374,223 @@ static inline int spmi_write_cmd(struct spmi_controller *ctrl,
 	return ctrl->write_cmd(ctrl, opcode, sid, addr, bc, buf);
 }
 
+/*
+ * Register cache of one peripheral, the 256 registers at (sid, per << 8).
+ * Registers still set in @cacheable are served from @regs once @valid.
+ * The counters cover all extended long accesses to the peripheral.
+ */
+#define SPMI_PERIPH_REGS	256
+
+struct spmi_reg_cache {
+	struct list_head	list;
+	u8			sid;
+	u8			per;
+	unsigned int		users;
+	DECLARE_BITMAP(cacheable, SPMI_PERIPH_REGS);
+	DECLARE_BITMAP(valid, SPMI_PERIPH_REGS);
+	u8			regs[SPMI_PERIPH_REGS];
+	unsigned long		bus_reads;
+	unsigned long		bus_writes;
+	unsigned long		cache_hits;
+};
+
+/* Called with reg_cache_lock held */
+static struct spmi_reg_cache *spmi_reg_cache_find(struct spmi_controller *ctrl,
+						  u8 sid, u8 per)
+{
+	struct spmi_reg_cache *cache;
+
+	list_for_each_entry(cache, &ctrl->reg_caches, list)
+		if (cache->sid == sid && cache->per == per)
+			return cache;
+	return NULL;
+}
+
+static bool spmi_reg_cache_in_periph(u16 addr, int len)
+{
+	return (addr & 0xFF) + len <= SPMI_PERIPH_REGS;
+}
+
+/* Returns true if all @len registers at @addr could be read from cache */
+static bool spmi_reg_cache_read(struct spmi_controller *ctrl, u8 sid,
+				u16 addr, u8 *buf, int len)
+{
+	struct spmi_reg_cache *cache;
+	unsigned long flags;
+	bool hit = false;
+	int i, off = addr & 0xFF;
+
+	if (list_empty(&ctrl->reg_caches) ||
+	    !spmi_reg_cache_in_periph(addr, len))
+		return false;
+
+	spin_lock_irqsave(&ctrl->reg_cache_lock, flags);
+	cache = spmi_reg_cache_find(ctrl, sid, addr >> 8);
+	if (cache) {
+		for (i = off; i < off + len; i++)
+			if (!test_bit(i, cache->cacheable) ||
+			    !test_bit(i, cache->valid))
+				break;
+		hit = i == off + len;
+		if (hit) {
+			memcpy(buf, &cache->regs[off], len);
+			cache->cache_hits++;
+		}
+	}
+	spin_unlock_irqrestore(&ctrl->reg_cache_lock, flags);
+
+	return hit;
+}
+
+/* Account a bus access and keep the cacheable registers it moved */
+static void spmi_reg_cache_update(struct spmi_controller *ctrl, u8 sid,
+				  u16 addr, const u8 *buf, int len,
+				  bool write, int rc)
+{
+	struct spmi_reg_cache *cache;
+	unsigned long flags;
+	int i, off = addr & 0xFF;
+
+	if (list_empty(&ctrl->reg_caches) ||
+	    !spmi_reg_cache_in_periph(addr, len))
+		return;
+
+	spin_lock_irqsave(&ctrl->reg_cache_lock, flags);
+	cache = spmi_reg_cache_find(ctrl, sid, addr >> 8);
+	if (!cache)
+		goto out;
+
+	if (write)
+		cache->bus_writes++;
+	else
+		cache->bus_reads++;
+
+	for (i = 0; i < len; i++) {
+		if (!test_bit(off + i, cache->cacheable))
+			continue;
+		if (rc) {
+			/* a failed write leaves the register unknown */
+			if (write)
+				clear_bit(off + i, cache->valid);
+			continue;
+		}
+		cache->regs[off + i] = buf[i];
+		set_bit(off + i, cache->valid);
+	}
+out:
+	spin_unlock_irqrestore(&ctrl->reg_cache_lock, flags);
+}
+
+int spmi_reg_cache_register(struct spmi_controller *ctrl, u8 sid, u16 base,
+			    const struct spmi_reg_range *volatile_regs, int num)
+{
+	struct spmi_reg_cache *cache, *new;
+	unsigned long flags;
+	int i;
+
+	if (!ctrl || sid > SPMI_MAX_SLAVE_ID || (base & 0xFF))
+		return -EINVAL;
+
+	for (i = 0; i < num; i++)
+		if (volatile_regs[i].first > volatile_regs[i].last)
+			return -EINVAL;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+	new->sid = sid;
+	new->per = base >> 8;
+	bitmap_fill(new->cacheable, SPMI_PERIPH_REGS);
+
+	spin_lock_irqsave(&ctrl->reg_cache_lock, flags);
+	cache = spmi_reg_cache_find(ctrl, sid, base >> 8);
+	if (!cache) {
+		cache = new;
+		new = NULL;
+		list_add_tail(&cache->list, &ctrl->reg_caches);
+	}
+	cache->users++;
+	for (i = 0; i < num; i++)
+		bitmap_clear(cache->cacheable, volatile_regs[i].first,
+			     volatile_regs[i].last - volatile_regs[i].first + 1);
+	spin_unlock_irqrestore(&ctrl->reg_cache_lock, flags);
+
+	kfree(new);
+	return 0;
+}
+EXPORT_SYMBOL_GPL(spmi_reg_cache_register);
+
+void spmi_reg_cache_unregister(struct spmi_controller *ctrl, u8 sid, u16 base)
+{
+	struct spmi_reg_cache *cache;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctrl->reg_cache_lock, flags);
+	cache = spmi_reg_cache_find(ctrl, sid, base >> 8);
+	if (cache && !--cache->users)
+		list_del(&cache->list);
+	else
+		cache = NULL;
+	spin_unlock_irqrestore(&ctrl->reg_cache_lock, flags);
+
+	kfree(cache);
+}
+EXPORT_SYMBOL_GPL(spmi_reg_cache_unregister);
+
+void spmi_reg_cache_invalidate(struct spmi_controller *ctrl, u8 sid, u16 base)
+{
+	struct spmi_reg_cache *cache;
+	unsigned long flags;
+
+	spin_lock_irqsave(&ctrl->reg_cache_lock, flags);
+	cache = spmi_reg_cache_find(ctrl, sid, base >> 8);
+	if (cache)
+		bitmap_zero(cache->valid, SPMI_PERIPH_REGS);
+	spin_unlock_irqrestore(&ctrl->reg_cache_lock, flags);
+}
+EXPORT_SYMBOL_GPL(spmi_reg_cache_invalidate);
+
+static void spmi_reg_cache_free_all(struct spmi_controller *ctrl)
+{
+	struct spmi_reg_cache *cache, *tmp;
+
+	list_for_each_entry_safe(cache, tmp, &ctrl->reg_caches, list) {
+		list_del(&cache->list);
+		kfree(cache);
+	}
+}
+
+static int spmi_reg_cache_show(struct seq_file *s, void *unused)
+{
+	struct spmi_controller *ctrl = s->private;
+	struct spmi_reg_cache *cache;
+	unsigned long flags;
+
+	seq_printf(s, "%-4s %-6s %10s %10s %10s %6s\n", "sid", "base",
+		   "bus_reads", "bus_writes", "hits", "cached");
+	spin_lock_irqsave(&ctrl->reg_cache_lock, flags);
+	list_for_each_entry(cache, &ctrl->reg_caches, list)
+		seq_printf(s, "%-4u 0x%04x %10lu %10lu %10lu %6d\n",
+			   cache->sid, cache->per << 8, cache->bus_reads,
+			   cache->bus_writes, cache->cache_hits,
+			   bitmap_weight(cache->valid, SPMI_PERIPH_REGS));
+	spin_unlock_irqrestore(&ctrl->reg_cache_lock, flags);
+
+	return 0;
+}
+
+static int spmi_reg_cache_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, spmi_reg_cache_show, inode->i_private);
+}
+
+static const struct file_operations spmi_reg_cache_fops = {
+	.open		= spmi_reg_cache_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /*
  * register read/write: 5-bit address, 1 byte of data
  * extended register read/write: 8-bit address, up to 16 bytes of data
@@ -429,6 +649,22 @@ EXPORT_SYMBOL_GPL(spmi_ext_register_read);
  * Reads up to 8 bytes of data from the extended register space on a
  * Slave device using 16-bit address.
  */
+static int __spmi_ext_register_readl(struct spmi_controller *ctrl,
+				u8 sid, u16 addr, u8 *buf, int len)
+{
+	int rc;
+
+	if (!ctrl || ctrl->dev.type != &spmi_ctrl_type)
+		return -EINVAL;
+
+	if (spmi_reg_cache_read(ctrl, sid, addr, buf, len))
+		return 0;
+
+	rc = spmi_read_cmd(ctrl, SPMI_CMD_EXT_READL, sid, addr, len - 1, buf);
+	spmi_reg_cache_update(ctrl, sid, addr, buf, len, false, rc);
+	return rc;
+}
+
 int spmi_ext_register_readl(struct spmi_controller *ctrl,
 				u8 sid, u16 addr, u8 *buf, int len)
 {
@@ -436,10 +672,31 @@ int spmi_ext_register_readl(struct spmi_controller *ctrl,
 	if (sid > SPMI_MAX_SLAVE_ID || len <= 0 || len > 8)
 		return -EINVAL;
 
-	return spmi_read_cmd(ctrl, SPMI_CMD_EXT_READL, sid, addr, len - 1, buf);
+	return __spmi_ext_register_readl(ctrl, sid, addr, buf, len);
 }
 EXPORT_SYMBOL_GPL(spmi_ext_register_readl);
 
+/**
+ * spmi_ext_register_readl_block() - extended register read long of a block
+ * @dev: SPMI device.
+ * @sid: slave identifier.
+ * @ad: slave register address (16-bit address).
+ * @buf: buffer to be populated with data from the Slave.
+ * @len: the request number of bytes to read (up to 256 bytes).
+ *
+ * Reads consecutive registers of the peripheral holding @ad.
+ */
+int spmi_ext_register_readl_block(struct spmi_controller *ctrl,
+				u8 sid, u16 addr, u8 *buf, int len)
+{
+	if (sid > SPMI_MAX_SLAVE_ID || len <= 0 ||
+	    !spmi_reg_cache_in_periph(addr, len))
+		return -EINVAL;
+
+	return __spmi_ext_register_readl(ctrl, sid, addr, buf, len);
+}
+EXPORT_SYMBOL_GPL(spmi_ext_register_readl_block);
+
 /**
  * spmi_register_write() - register write
  * @dev: SPMI device.
@@ -516,19 +773,52 @@ EXPORT_SYMBOL_GPL(spmi_ext_register_write);
  * Writes up to 8 bytes of data to the extended register space of a
  * Slave device using 16-bit address.
  */
-int spmi_ext_register_writel(struct spmi_controller *ctrl,
+static int __spmi_ext_register_writel(struct spmi_controller *ctrl,
 				u8 sid, u16 addr, u8 *buf, int len)
 {
 	u8 op = SPMI_CMD_EXT_WRITEL;
+	int rc;
+
+	if (!ctrl || ctrl->dev.type != &spmi_ctrl_type)
+		return -EINVAL;
 
+	rc = spmi_write_cmd(ctrl, op, sid, addr, len - 1, buf);
+	spmi_reg_cache_update(ctrl, sid, addr, buf, len, true, rc);
+	return rc;
+}
+
+int spmi_ext_register_writel(struct spmi_controller *ctrl,
+				u8 sid, u16 addr, u8 *buf, int len)
+{
 	/* 4-bit Slave Identifier, 16-bit register address, up to 8 bytes */
 	if (sid > SPMI_MAX_SLAVE_ID || len <= 0 || len > 8)
 		return -EINVAL;
 
-	return spmi_write_cmd(ctrl, op, sid, addr, len - 1, buf);
+	return __spmi_ext_register_writel(ctrl, sid, addr, buf, len);
 }
 EXPORT_SYMBOL_GPL(spmi_ext_register_writel);
 
+/**
+ * spmi_ext_register_writel_block() - extended register write long of a block
+ * @dev: SPMI device.
+ * @sid: slave identifier.
+ * @ad: slave register address (16-bit address).
+ * @buf: buffer containing the data to be transferred to the Slave.
+ * @len: the request number of bytes to write (up to 256 bytes).
+ *
+ * Writes consecutive registers of the peripheral holding @ad.
+ */
+int spmi_ext_register_writel_block(struct spmi_controller *ctrl,
+				u8 sid, u16 addr, u8 *buf, int len)
+{
+	if (sid > SPMI_MAX_SLAVE_ID || len <= 0 ||
+	    !spmi_reg_cache_in_periph(addr, len))
+		return -EINVAL;
+
+	return __spmi_ext_register_writel(ctrl, sid, addr, buf, len);
+}
+EXPORT_SYMBOL_GPL(spmi_ext_register_writel_block);
+
 /**
  * spmi_command_reset() - sends RESET command to the specified slave
  * @dev: SPMI device.
@@ -786,6 +1076,9 @@ static int spmi_register_controller(struct spmi_controller *ctrl)
 		goto exit;
 	}
 
+	INIT_LIST_HEAD(&ctrl->reg_caches);
+	spin_lock_init(&ctrl->reg_cache_lock);
+
 	dev_set_name(&ctrl->dev, "spmi-%d", ctrl->nr);
 	ctrl->dev.bus = &spmi_bus_type;
 	ctrl->dev.type = &spmi_ctrl_type;
@@ -797,6 +1090,7 @@ static int spmi_register_controller(struct spmi_controller *ctrl)
 					ctrl->nr, &ctrl->dev);
 
 	spmi_dfs_add_controller(ctrl);
+	spmi_dfs_create_file(ctrl, "reg_cache", ctrl, &spmi_reg_cache_fops);
 	return 0;
 
 exit:
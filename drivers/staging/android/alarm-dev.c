@@ -51,12 +51,19 @@ static uint32_t alarm_pending;
 static uint32_t alarm_enabled;
 static uint32_t wait_pending;
 
+/*
+ * @exp is the time the alarm was set for.  A wakeup alarm with a @window
+ * is armed for @exp + @window instead and is delivered early, together
+ * with whichever alarm fires first once @exp has passed.
+ */
 struct devalarm {
 	union {
 		struct hrtimer hrt;
 		struct alarm alrm;
 	} u;
 	enum android_alarm_type type;
+	ktime_t exp;
+	ktime_t window;
 };
 
 static struct devalarm alarms[ANDROID_ALARM_TYPE_COUNT];
@@ -94,6 +101,14 @@ static void devalarm_cancel(struct devalarm *alrm)
 		hrtimer_cancel(&alrm->u.hrt);
 }
 
+/* current time on the clock of a wakeup alarm */
+static ktime_t devalarm_now(struct devalarm *alrm)
+{
+	if (alrm->type == ANDROID_ALARM_ELAPSED_REALTIME_WAKEUP)
+		return ktime_get_boottime();
+	return ktime_get_real();
+}
+
 static void alarm_clear(enum android_alarm_type alarm_type, struct timespec *ts)
 {
 	uint32_t alarm_type_mask = 1U << alarm_type;
@@ -120,17 +135,37 @@ static void alarm_set(enum android_alarm_type alarm_type,
 	uint32_t alarm_type_mask = 1U << alarm_type;
 	unsigned long flags;
 
+	struct devalarm *alrm = &alarms[alarm_type];
+
 	spin_lock_irqsave(&alarm_slock, flags);
 	alarm_dbg(IO, "alarm %d set %ld.%09ld\n",
 			alarm_type, ts->tv_sec, ts->tv_nsec);
 	alarm_enabled |= alarm_type_mask;
-	devalarm_start(&alarms[alarm_type], timespec_to_ktime(*ts));
+	alrm->exp = timespec_to_ktime(*ts);
+	devalarm_start(alrm, ktime_add(alrm->exp, alrm->window));
 	spin_unlock_irqrestore(&alarm_slock, flags);
 
 	if (alarm_type == ANDROID_ALARM_RTC_POWEROFF_WAKEUP)
 		set_power_on_alarm(ts->tv_sec, 1);
 }
 
+static int alarm_set_window(enum android_alarm_type alarm_type,
+			    struct timespec *ts)
+{
+	unsigned long flags;
+
+	if (!is_wakeup(alarm_type) || !timespec_valid(ts))
+		return -EINVAL;
+
+	spin_lock_irqsave(&alarm_slock, flags);
+	alarm_dbg(IO, "alarm %d window %ld.%09ld\n",
+			alarm_type, ts->tv_sec, ts->tv_nsec);
+	alarms[alarm_type].window = timespec_to_ktime(*ts);
+	spin_unlock_irqrestore(&alarm_slock, flags);
+
+	return 0;
+}
+
 static int alarm_wait(void)
 {
 	unsigned long flags;
@@ -249,6 +284,9 @@ static long alarm_do_ioctl(struct file *file, unsigned int cmd,
 	case ANDROID_ALARM_GET_TIME(0):
 		rv = alarm_get_time(alarm_type, ts);
 		break;
+	case ANDROID_ALARM_SET_WINDOW(0):
+		rv = alarm_set_window(alarm_type, ts);
+		break;
 
 	default:
 		rv = -EINVAL;
@@ -267,6 +305,7 @@ static long alarm_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	case ANDROID_ALARM_SET(0):
 	case ANDROID_ALARM_SET_RTC:
 	case ANDROID_ALARM_CLEAR(0):
+	case ANDROID_ALARM_SET_WINDOW(0):
 		if (copy_from_user(&ts, (void __user *)arg, sizeof(ts)))
 			return -EFAULT;
 		break;
@@ -297,6 +336,7 @@ static long alarm_compat_ioctl(struct file *file, unsigned int cmd,
 	case ANDROID_ALARM_SET_AND_WAIT_COMPAT(0):
 	case ANDROID_ALARM_SET_COMPAT(0):
 	case ANDROID_ALARM_SET_RTC_COMPAT:
+	case ANDROID_ALARM_SET_WINDOW_COMPAT(0):
 		if (compat_get_timespec(&ts, (void __user *)arg))
 			return -EFAULT;
 		/* fall through */
@@ -342,6 +382,7 @@ static int alarm_release(struct inode *inode, struct file *file)
 					  !!(alarm_pending & alarm_type_mask));
 				alarm_enabled &= ~alarm_type_mask;
 			}
+			alarms[i].window = ktime_set(0, 0);
 			spin_unlock_irqrestore(&alarm_slock, flags);
 			devalarm_cancel(&alarms[i]);
 			spin_lock_irqsave(&alarm_slock, flags);
@@ -365,12 +406,31 @@ static void devalarm_triggered(struct devalarm *alarm)
 	unsigned long flags;
 	uint32_t alarm_type_mask = 1U << alarm->type;
 
+	int i;
+
 	alarm_dbg(INT, "%s: type %d\n", __func__, alarm->type);
 	spin_lock_irqsave(&alarm_slock, flags);
 	if (alarm_enabled & alarm_type_mask) {
 		__pm_wakeup_event(&alarm_wake_lock, 5000); /* 5secs */
 		alarm_enabled &= ~alarm_type_mask;
 		alarm_pending |= alarm_type_mask;
+
+		/*
+		 * Hand over every other wakeup alarm that is already due and
+		 * only waits for the end of its window, so that they are all
+		 * served by this wakeup.
+		 */
+		for (i = 0; i < ANDROID_ALARM_TYPE_COUNT; i++) {
+			struct devalarm *other = &alarms[i];
+
+			if (!is_wakeup(i) || !(alarm_enabled & (1U << i)) ||
+			    ktime_compare(other->exp, devalarm_now(other)) > 0)
+				continue;
+			alarm_dbg(INT, "%s: coalesce type %d\n", __func__, i);
+			devalarm_try_to_cancel(other);
+			alarm_enabled &= ~(1U << i);
+			alarm_pending |= 1U << i;
+		}
 		wake_up(&alarm_wait_queue);
 	}
 	spin_unlock_irqrestore(&alarm_slock, flags);
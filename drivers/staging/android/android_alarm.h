@@ -60,6 +60,11 @@ enum android_alarm_return_flags {
 #define ANDROID_ALARM_SET_AND_WAIT(type)    ALARM_IOW(3, type, struct timespec)
 #define ANDROID_ALARM_GET_TIME(type)        ALARM_IOW(4, type, struct timespec)
 #define ANDROID_ALARM_SET_RTC               _IOW('a', 5, struct timespec)
+/*
+ * Let later wakeup alarms of this type fire up to the given time late, so
+ * that they can be delivered together with other alarms due by then.
+ */
+#define ANDROID_ALARM_SET_WINDOW(type)      ALARM_IOW(6, type, struct timespec)
 #define ANDROID_ALARM_BASE_CMD(cmd)         (cmd & ~(_IOC(0, 0, 0xf0, 0)))
 #define ANDROID_ALARM_IOCTL_TO_TYPE(cmd)    (_IOC_NR(cmd) >> 4)
 
@@ -73,6 +78,8 @@ enum android_alarm_return_flags {
 							struct compat_timespec)
 #define ANDROID_ALARM_SET_RTC_COMPAT		_IOW('a', 5, \
 							struct compat_timespec)
+#define ANDROID_ALARM_SET_WINDOW_COMPAT(type)	ALARM_IOW(6, type, \
+							struct compat_timespec)
 #define ANDROID_ALARM_IOCTL_NR(cmd)		(_IOC_NR(cmd) & ((1<<4)-1))
 #define ANDROID_ALARM_COMPAT_TO_NORM(cmd)  \
 				ALARM_IOW(ANDROID_ALARM_IOCTL_NR(cmd), \
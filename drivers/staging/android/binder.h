@@ -36,11 +36,24 @@ enum {
 	BINDER_TYPE_HANDLE	= B_PACK_CHARS('s', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_WEAK_HANDLE	= B_PACK_CHARS('w', 'h', '*', B_TYPE_LARGE),
 	BINDER_TYPE_FD		= B_PACK_CHARS('f', 'd', '*', B_TYPE_LARGE),
+	BINDER_TYPE_FDA		= B_PACK_CHARS('f', 'd', 'a', B_TYPE_LARGE),
+	BINDER_TYPE_PTR		= B_PACK_CHARS('p', 't', '*', B_TYPE_LARGE),
 };
 
 enum {
 	FLAT_BINDER_FLAG_PRIORITY_MASK = 0xff,
 	FLAT_BINDER_FLAG_ACCEPTS_FDS = 0x100,
+	/*
+	 * Scheduling policy (SCHED_NORMAL, SCHED_FIFO, SCHED_RR or
+	 * SCHED_BATCH) of the minimum priority transactions to the object
+	 * run at.  For SCHED_NORMAL and SCHED_BATCH the priority bits hold
+	 * a nice value, for SCHED_FIFO and SCHED_RR an RT priority.
+	 */
+	FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT = 9,
+	FLAT_BINDER_FLAG_SCHED_POLICY_MASK =
+		3U << FLAT_BINDER_FLAG_SCHED_POLICY_SHIFT,
+	/* let RT callers run transactions to the object at RT priority */
+	FLAT_BINDER_FLAG_INHERIT_RT = 0x800,
 };
 
 /*
@@ -65,6 +78,45 @@ struct flat_binder_object {
 	void __user		*cookie;
 };
 
+enum {
+	BINDER_BUFFER_FLAG_HAS_PARENT = 0x01,
+};
+
+/*
+ * Scatter-gather objects, only valid in BC_TRANSACTION_SG and BC_REPLY_SG.
+ * Like flat_binder_object they start with the type, but their layout is
+ * the same for 32 and 64 bit user code.
+ *
+ * A buffer object describes @length bytes at @buffer in the sender, which
+ * the driver copies into the target's transaction buffer, after the
+ * offsets.  @buffer is rewritten to the address of the copy.  With
+ * BINDER_BUFFER_FLAG_HAS_PARENT set, the pointer found @parent_offset
+ * bytes into the buffer object listed at offsets index @parent is
+ * rewritten to the copy as well.  Parents must come before their
+ * children, and fixups within a parent must be in increasing order.
+ */
+struct binder_buffer_object {
+	__u32		type;
+	__u32		flags;
+	__u64		buffer;
+	__u64		length;
+	__u64		parent;
+	__u64		parent_offset;
+};
+
+/*
+ * An array of @num_fds 32 bit file descriptors @parent_offset bytes into
+ * the buffer object listed at offsets index @parent.  Each one is
+ * translated to a new descriptor in the target, as for BINDER_TYPE_FD.
+ */
+struct binder_fd_array_object {
+	__u32		type;
+	__u32		pad;
+	__u64		num_fds;
+	__u64		parent;
+	__u64		parent_offset;
+};
+
 /*
  * On 64-bit platforms where user code may run in 32-bits the driver must
  * translate the buffer (and local binder) addresses appropriately.
@@ -151,6 +203,12 @@ struct binder_transaction_data {
 	} data;
 };
 
+struct binder_transaction_data_sg {
+	struct binder_transaction_data transaction_data;
+	/* total size of the buffers, each padded to 8 bytes */
+	size_t	buffers_size;
+};
+
 struct binder_ptr_cookie {
 	void *ptr;
 	void *cookie;
@@ -328,6 +386,13 @@ enum binder_driver_command_protocol {
 	/*
 	 * void *: cookie
 	 */
+
+	BC_TRANSACTION_SG = _IOW('c', 17, struct binder_transaction_data_sg),
+	BC_REPLY_SG = _IOW('c', 18, struct binder_transaction_data_sg),
+	/*
+	 * binder_transaction_data_sg: the sent command, with room for the
+	 * BINDER_TYPE_PTR buffers it carries.
+	 */
 };
 
 /* Support for 32bit userspace on a 64bit system */
@@ -391,6 +456,11 @@ struct compat_binder_transaction_data {
 	} data;
 };
 
+struct compat_binder_transaction_data_sg {
+	struct compat_binder_transaction_data transaction_data;
+	compat_size_t	buffers_size;
+};
+
 struct compat_binder_ptr_cookie {
 	compat_uptr_t ptr;
 	compat_uptr_t cookie;
@@ -432,6 +502,9 @@ enum compat_binder_driver_command_protocol {
 	COMPAT_BC_CLEAR_DEATH_NOTIFICATION = _IOW('c', 15, struct compat_binder_ptr_cookie),
 
 	COMPAT_BC_DEAD_BINDER_DONE = _IOW('c', 16, compat_uptr_t),
+
+	COMPAT_BC_TRANSACTION_SG = _IOW('c', 17, struct compat_binder_transaction_data_sg),
+	COMPAT_BC_REPLY_SG = _IOW('c', 18, struct compat_binder_transaction_data_sg),
 };
 #endif /* CONFIG_COMPAT */
 
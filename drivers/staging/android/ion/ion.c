@@ -1743,8 +1743,11 @@ void ion_device_add_heap(struct ion_device *dev, struct ion_heap *heap)
 		pr_err("%s: can not add heap with invalid ops struct.\n",
 		       __func__);
 
-	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
-		ion_heap_init_deferred_free(heap);
+	/* Without the thread, queued buffers would only ever be freed by
+	   the shrinker, so fall back to freeing them synchronously */
+	if ((heap->flags & ION_HEAP_FLAG_DEFER_FREE) &&
+	    ion_heap_init_deferred_free(heap))
+		heap->flags &= ~ION_HEAP_FLAG_DEFER_FREE;
 
 	heap->dev = dev;
 	down_write(&dev->lock);
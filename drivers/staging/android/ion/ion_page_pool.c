@@ -17,11 +17,19 @@
 #include <linux/debugfs.h>
 #include <linux/dma-mapping.h>
 #include <linux/err.h>
+#include <linux/freezer.h>
 #include <linux/fs.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
 #include <linux/list.h>
+#include <linux/log2.h>
+#include <linux/math64.h>
 #include <linux/module.h>
+#include <linux/percpu.h>
+#include <linux/sched.h>
 #include <linux/slab.h>
 #include <linux/vmalloc.h>
+#include <linux/wait.h>
 #include "ion_priv.h"
 
 struct ion_page_pool_item {
@@ -29,6 +37,13 @@ struct ion_page_pool_item {
 	struct list_head list;
 };
 
+/* Pools with dirty pages, served by the zeroing thread */
+static LIST_HEAD(ion_page_pool_zero_pools);
+static DEFINE_MUTEX(ion_page_pool_zero_lock);
+static DECLARE_WAIT_QUEUE_HEAD(ion_page_pool_zero_wait);
+static atomic_t ion_page_pool_nr_dirty = ATOMIC_INIT(0);
+static struct task_struct *ion_page_pool_zero_task;
+
 static void *ion_page_pool_alloc_pages(struct ion_page_pool *pool)
 {
 	struct page *page;
@@ -57,33 +72,46 @@ static void ion_page_pool_free_pages(struct ion_page_pool *pool,
 	__free_pages(page, pool->order);
 }
 
-static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page)
+/* Must be called with pool->mutex held */
+static void ion_page_pool_link(struct ion_page_pool *pool,
+			       struct ion_page_pool_item *item, bool dirty)
 {
-	struct ion_page_pool_item *item;
-
-	item = kmalloc(sizeof(struct ion_page_pool_item), GFP_KERNEL);
-	if (!item)
-		return -ENOMEM;
-
-	mutex_lock(&pool->mutex);
-	item->page = page;
-	if (PageHighMem(page)) {
-		list_add_tail(&item->list, &pool->high_items);
-		pool->high_count++;
+	if (PageHighMem(item->page)) {
+		if (dirty) {
+			list_add_tail(&item->list, &pool->dirty_high_items);
+			pool->dirty_high_count++;
+		} else {
+			list_add_tail(&item->list, &pool->high_items);
+			pool->high_count++;
+		}
 	} else {
-		list_add_tail(&item->list, &pool->low_items);
-		pool->low_count++;
+		if (dirty) {
+			list_add_tail(&item->list, &pool->dirty_low_items);
+			pool->dirty_low_count++;
+		} else {
+			list_add_tail(&item->list, &pool->low_items);
+			pool->low_count++;
+		}
 	}
-	mutex_unlock(&pool->mutex);
-	return 0;
 }
 
-static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
+/* Must be called with pool->mutex held */
+static struct ion_page_pool_item *ion_page_pool_unlink(
+		struct ion_page_pool *pool, bool high, bool dirty)
 {
 	struct ion_page_pool_item *item;
-	struct page *page;
 
-	if (high) {
+	if (dirty && high) {
+		BUG_ON(!pool->dirty_high_count);
+		item = list_first_entry(&pool->dirty_high_items,
+					struct ion_page_pool_item, list);
+		pool->dirty_high_count--;
+	} else if (dirty) {
+		BUG_ON(!pool->dirty_low_count);
+		item = list_first_entry(&pool->dirty_low_items,
+					struct ion_page_pool_item, list);
+		pool->dirty_low_count--;
+	} else if (high) {
 		BUG_ON(!pool->high_count);
 		item = list_first_entry(&pool->high_items,
 					struct ion_page_pool_item, list);
@@ -96,27 +124,253 @@ static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high)
 	}
 
 	list_del(&item->list);
+	return item;
+}
+
+static int ion_page_pool_add(struct ion_page_pool *pool, struct page *page,
+			     bool dirty)
+{
+	struct ion_page_pool_item *item;
+
+	item = kmalloc(sizeof(struct ion_page_pool_item), GFP_KERNEL);
+	if (!item)
+		return -ENOMEM;
+
+	mutex_lock(&pool->mutex);
+	item->page = page;
+	ion_page_pool_link(pool, item, dirty);
+	mutex_unlock(&pool->mutex);
+
+	if (dirty) {
+		atomic_inc(&ion_page_pool_nr_dirty);
+		wake_up(&ion_page_pool_zero_wait);
+	}
+	return 0;
+}
+
+static struct page *ion_page_pool_remove(struct ion_page_pool *pool, bool high,
+					 bool dirty)
+{
+	struct ion_page_pool_item *item;
+	struct page *page;
+
+	item = ion_page_pool_unlink(pool, high, dirty);
+	if (dirty)
+		atomic_dec(&ion_page_pool_nr_dirty);
 	page = item->page;
 	kfree(item);
 	return page;
 }
 
-void *ion_page_pool_alloc(struct ion_page_pool *pool)
+/*
+ * Takes a page off the current cpu's cache. The lock is only ever
+ * contended by the shrinker draining the cache.
+ */
+static struct page *ion_page_pool_cpu_get(struct ion_page_pool *pool)
 {
+	struct ion_page_pool_cpu *cache;
 	struct page *page = NULL;
 
-	BUG_ON(!pool);
+	cache = get_cpu_ptr(pool->cpu_cache);
+	spin_lock(&cache->lock);
+	if (cache->count)
+		page = cache->pages[--cache->count];
+	spin_unlock(&cache->lock);
+	put_cpu_ptr(pool->cpu_cache);
+
+	return page;
+}
+
+/*
+ * Puts up to @nr pages into the current cpu's cache and returns how many
+ * were taken.
+ */
+static int ion_page_pool_cpu_put(struct ion_page_pool *pool,
+				 struct page **pages, int nr)
+{
+	struct ion_page_pool_cpu *cache;
+	int i;
+
+	cache = get_cpu_ptr(pool->cpu_cache);
+	spin_lock(&cache->lock);
+	for (i = 0; i < nr && cache->count < ION_POOL_CPU_PAGES; i++)
+		cache->pages[cache->count++] = pages[i];
+	spin_unlock(&cache->lock);
+	put_cpu_ptr(pool->cpu_cache);
+
+	return i;
+}
+
+/*
+ * Moves a batch of ready pages from the pool lists into the current cpu's
+ * cache, so the following allocations on this cpu skip pool->mutex, and
+ * returns one of them.
+ */
+static struct page *ion_page_pool_cpu_refill(struct ion_page_pool *pool)
+{
+	struct page *pages[ION_POOL_CPU_BATCH];
+	int nr = 0, put;
 
 	mutex_lock(&pool->mutex);
-	if (pool->high_count)
-		page = ion_page_pool_remove(pool, true);
-	else if (pool->low_count)
-		page = ion_page_pool_remove(pool, false);
+	while (nr < ION_POOL_CPU_BATCH) {
+		if (pool->high_count)
+			pages[nr++] = ion_page_pool_remove(pool, true, false);
+		else if (pool->low_count)
+			pages[nr++] = ion_page_pool_remove(pool, false, false);
+		else
+			break;
+	}
 	mutex_unlock(&pool->mutex);
 
-	if (!page)
+	if (!nr)
+		return NULL;
+
+	put = ion_page_pool_cpu_put(pool, pages + 1, nr - 1);
+	/* We may have migrated to a cpu whose cache is already full */
+	while (++put < nr)
+		if (ion_page_pool_add(pool, pages[put], false))
+			ion_page_pool_free_pages(pool, pages[put]);
+
+	return pages[0];
+}
+
+/* Frees every page held in the per-cpu caches, returns the number freed */
+static int ion_page_pool_cpu_drain(struct ion_page_pool *pool)
+{
+	int cpu, nr_freed = 0;
+
+	if (!pool->cpu_cache)
+		return 0;
+
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_cpu *cache;
+		struct page *pages[ION_POOL_CPU_PAGES];
+		int i, nr;
+
+		cache = per_cpu_ptr(pool->cpu_cache, cpu);
+		spin_lock(&cache->lock);
+		nr = cache->count;
+		memcpy(pages, cache->pages, nr * sizeof(*pages));
+		cache->count = 0;
+		spin_unlock(&cache->lock);
+
+		for (i = 0; i < nr; i++)
+			ion_page_pool_free_pages(pool, pages[i]);
+		nr_freed += nr << pool->order;
+	}
+
+	return nr_freed;
+}
+
+static int ion_page_pool_cpu_count(struct ion_page_pool *pool)
+{
+	int cpu, count = 0;
+
+	if (!pool->cpu_cache)
+		return 0;
+
+	for_each_possible_cpu(cpu)
+		count += per_cpu_ptr(pool->cpu_cache, cpu)->count;
+	return count;
+}
+
+/*
+ * Takes a page off the pool lists, preferring ones that are already
+ * zeroed. If only dirty pages are left, zeroing one here is still
+ * cheaper than going to the page allocator.
+ */
+static struct page *ion_page_pool_get(struct ion_page_pool *pool)
+{
+	struct page *page = NULL;
+	bool dirty = false;
+
+	mutex_lock(&pool->mutex);
+	if (pool->high_count) {
+		page = ion_page_pool_remove(pool, true, false);
+	} else if (pool->low_count) {
+		page = ion_page_pool_remove(pool, false, false);
+	} else if (pool->dirty_high_count) {
+		page = ion_page_pool_remove(pool, true, true);
+		dirty = true;
+	} else if (pool->dirty_low_count) {
+		page = ion_page_pool_remove(pool, false, true);
+		dirty = true;
+	}
+	mutex_unlock(&pool->mutex);
+
+	if (dirty && ion_heap_high_order_page_zero(page, pool->order)) {
+		ion_page_pool_free_pages(pool, page);
+		page = NULL;
+	}
+
+	return page;
+}
+
+enum ion_page_pool_source {
+	ION_POOL_FROM_CPU,
+	ION_POOL_FROM_POOL,
+	ION_POOL_FROM_SYSTEM,
+};
+
+static void ion_page_pool_account(struct ion_page_pool *pool, ktime_t start,
+				  enum ion_page_pool_source source)
+{
+	struct ion_page_pool_stats *stats;
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	u64 us = div_u64(ns, NSEC_PER_USEC);
+	int bucket = 0;
+
+	if (us)
+		bucket = min_t(int, ilog2(us) + 1, ION_POOL_HIST_BUCKETS - 1);
+
+	stats = get_cpu_ptr(pool->stats);
+	switch (source) {
+	case ION_POOL_FROM_CPU:
+		stats->cpu_hits++;
+		break;
+	case ION_POOL_FROM_POOL:
+		stats->pool_hits++;
+		break;
+	case ION_POOL_FROM_SYSTEM:
+		stats->misses++;
+		break;
+	}
+	stats->total_ns += ns;
+	stats->total_sq_us += us * us;
+	if (ns > stats->max_ns)
+		stats->max_ns = ns;
+	stats->hist[bucket]++;
+	put_cpu_ptr(pool->stats);
+}
+
+void *ion_page_pool_alloc(struct ion_page_pool *pool)
+{
+	enum ion_page_pool_source source = ION_POOL_FROM_CPU;
+	struct page *page = NULL;
+	ktime_t start;
+
+	BUG_ON(!pool);
+
+	start = ktime_get();
+	if (pool->cpu_cache) {
+		page = ion_page_pool_cpu_get(pool);
+		if (!page)
+			page = ion_page_pool_cpu_refill(pool);
+	}
+
+	if (!page) {
+		source = ION_POOL_FROM_POOL;
+		page = ion_page_pool_get(pool);
+	}
+
+	if (!page) {
+		source = ION_POOL_FROM_SYSTEM;
 		page = ion_page_pool_alloc_pages(pool);
+		if (!page)
+			return NULL;
+	}
 
+	ion_page_pool_account(pool, start, source);
 	return page;
 }
 
@@ -124,19 +378,71 @@ void ion_page_pool_free(struct ion_page_pool *pool, struct page *page)
 {
 	int ret;
 
-	ret = ion_page_pool_add(pool, page);
+	/* Pages come back unzeroed; the zeroing thread takes care of them */
+	ret = ion_page_pool_add(pool, page, pool->gfp_mask & __GFP_ZERO);
 	if (ret)
 		ion_page_pool_free_pages(pool, page);
 }
 
+/* Zeroes the dirty pages of @pool and makes them available for allocation */
+static void ion_page_pool_zero_dirty(struct ion_page_pool *pool)
+{
+	while (!kthread_should_stop()) {
+		struct ion_page_pool_item *item;
+
+		mutex_lock(&pool->mutex);
+		if (pool->dirty_high_count) {
+			item = ion_page_pool_unlink(pool, true, true);
+		} else if (pool->dirty_low_count) {
+			item = ion_page_pool_unlink(pool, false, true);
+		} else {
+			mutex_unlock(&pool->mutex);
+			break;
+		}
+		mutex_unlock(&pool->mutex);
+		atomic_dec(&ion_page_pool_nr_dirty);
+
+		if (ion_heap_high_order_page_zero(item->page, pool->order)) {
+			ion_page_pool_free_pages(pool, item->page);
+			kfree(item);
+			continue;
+		}
+
+		mutex_lock(&pool->mutex);
+		ion_page_pool_link(pool, item, false);
+		mutex_unlock(&pool->mutex);
+		cond_resched();
+	}
+}
+
+static int ion_page_pool_zero_fn(void *data)
+{
+	struct ion_page_pool *pool;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(ion_page_pool_zero_wait,
+				     atomic_read(&ion_page_pool_nr_dirty) > 0 ||
+				     kthread_should_stop());
+
+		mutex_lock(&ion_page_pool_zero_lock);
+		list_for_each_entry(pool, &ion_page_pool_zero_pools, zero_list)
+			ion_page_pool_zero_dirty(pool);
+		mutex_unlock(&ion_page_pool_zero_lock);
+	}
+
+	return 0;
+}
+
 static int ion_page_pool_total(struct ion_page_pool *pool, bool high)
 {
-	int total = 0;
+	int total = pool->low_count + pool->dirty_low_count +
+		    ion_page_pool_cpu_count(pool);
+
+	if (high)
+		total += pool->high_count + pool->dirty_high_count;
 
-	total += high ? (pool->high_count + pool->low_count) *
-		(1 << pool->order) :
-			pool->low_count * (1 << pool->order);
-	return total;
+	return total << pool->order;
 }
 
 int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
@@ -151,14 +457,21 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	if (nr_to_scan == 0)
 		return ion_page_pool_total(pool, high);
 
-	for (i = 0; i < nr_to_scan; i++) {
+	nr_freed = ion_page_pool_cpu_drain(pool);
+
+	/* Dirty pages go first, there is no point in zeroing them */
+	for (i = nr_freed >> pool->order; i < nr_to_scan; i++) {
 		struct page *page;
 
 		mutex_lock(&pool->mutex);
-		if (pool->low_count) {
-			page = ion_page_pool_remove(pool, false);
+		if (pool->dirty_low_count) {
+			page = ion_page_pool_remove(pool, false, true);
+		} else if (high && pool->dirty_high_count) {
+			page = ion_page_pool_remove(pool, true, true);
+		} else if (pool->low_count) {
+			page = ion_page_pool_remove(pool, false, false);
 		} else if (high && pool->high_count) {
-			page = ion_page_pool_remove(pool, true);
+			page = ion_page_pool_remove(pool, true, false);
 		} else {
 			mutex_unlock(&pool->mutex);
 			break;
@@ -171,36 +484,130 @@ int ion_page_pool_shrink(struct ion_page_pool *pool, gfp_t gfp_mask,
 	return nr_freed;
 }
 
+void ion_page_pool_debug_show(struct ion_page_pool *pool, struct seq_file *s)
+{
+	struct ion_page_pool_stats sum;
+	u64 count, mean_ns, var_us;
+	int cpu, i;
+
+	memset(&sum, 0, sizeof(sum));
+	for_each_possible_cpu(cpu) {
+		struct ion_page_pool_stats *stats = per_cpu_ptr(pool->stats,
+								cpu);
+
+		sum.cpu_hits += stats->cpu_hits;
+		sum.pool_hits += stats->pool_hits;
+		sum.misses += stats->misses;
+		sum.total_ns += stats->total_ns;
+		sum.total_sq_us += stats->total_sq_us;
+		sum.max_ns = max(sum.max_ns, stats->max_ns);
+		for (i = 0; i < ION_POOL_HIST_BUCKETS; i++)
+			sum.hist[i] += stats->hist[i];
+	}
+
+	count = sum.cpu_hits + sum.pool_hits + sum.misses;
+	mean_ns = count ? div64_u64(sum.total_ns, count) : 0;
+	var_us = count ? div64_u64(sum.total_sq_us, count) : 0;
+	var_us -= min(var_us, div_u64(mean_ns * mean_ns,
+				      NSEC_PER_USEC * NSEC_PER_USEC));
+
+	seq_printf(s, "order %u pool: %d highmem %d lowmem pages to zero, %d pages in cpu caches\n",
+		   pool->order, pool->dirty_high_count, pool->dirty_low_count,
+		   ion_page_pool_cpu_count(pool));
+	seq_printf(s, "  allocs %llu: cpu %llu pool %llu system %llu\n",
+		   count, sum.cpu_hits, sum.pool_hits, sum.misses);
+	seq_printf(s, "  latency mean %lluns max %lluns jitter (stddev) %luus\n",
+		   mean_ns, sum.max_ns,
+		   int_sqrt(min_t(u64, var_us, ULONG_MAX)));
+	seq_puts(s, "  latency histogram (us):");
+	for (i = 0; i < ION_POOL_HIST_BUCKETS; i++) {
+		if (i == ION_POOL_HIST_BUCKETS - 1)
+			seq_printf(s, " >=%u:", 1U << (i - 1));
+		else
+			seq_printf(s, " <%u:", 1U << i);
+		seq_printf(s, "%u", sum.hist[i]);
+	}
+	seq_puts(s, "\n");
+}
+
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order)
 {
 	struct ion_page_pool *pool = kmalloc(sizeof(struct ion_page_pool),
 					     GFP_KERNEL);
+	int cpu;
+
 	if (!pool)
 		return NULL;
 	pool->high_count = 0;
 	pool->low_count = 0;
 	INIT_LIST_HEAD(&pool->low_items);
 	INIT_LIST_HEAD(&pool->high_items);
+	pool->dirty_high_count = 0;
+	pool->dirty_low_count = 0;
+	INIT_LIST_HEAD(&pool->dirty_low_items);
+	INIT_LIST_HEAD(&pool->dirty_high_items);
 	pool->gfp_mask = gfp_mask;
 	pool->order = order;
 	mutex_init(&pool->mutex);
 	plist_node_init(&pool->list, order);
 
+	pool->stats = alloc_percpu(struct ion_page_pool_stats);
+	if (!pool->stats)
+		goto err_free_pool;
+
+	pool->cpu_cache = NULL;
+	if (!order) {
+		pool->cpu_cache = alloc_percpu(struct ion_page_pool_cpu);
+		if (!pool->cpu_cache)
+			goto err_free_stats;
+		for_each_possible_cpu(cpu)
+			spin_lock_init(&per_cpu_ptr(pool->cpu_cache,
+						    cpu)->lock);
+	}
+
+	mutex_lock(&ion_page_pool_zero_lock);
+	list_add_tail(&pool->zero_list, &ion_page_pool_zero_pools);
+	mutex_unlock(&ion_page_pool_zero_lock);
+
 	return pool;
+
+err_free_stats:
+	free_percpu(pool->stats);
+err_free_pool:
+	kfree(pool);
+	return NULL;
 }
 
 void ion_page_pool_destroy(struct ion_page_pool *pool)
 {
+	mutex_lock(&ion_page_pool_zero_lock);
+	list_del(&pool->zero_list);
+	mutex_unlock(&ion_page_pool_zero_lock);
+
+	ion_page_pool_cpu_drain(pool);
+	free_percpu(pool->cpu_cache);
+	free_percpu(pool->stats);
 	kfree(pool);
 }
 
 static int __init ion_page_pool_init(void)
 {
+	struct sched_param param = { .sched_priority = 0 };
+
+	ion_page_pool_zero_task = kthread_run(ion_page_pool_zero_fn, NULL,
+					      "ion_pool_zero");
+	if (IS_ERR(ion_page_pool_zero_task)) {
+		pr_err("%s: creating thread for page zeroing failed\n",
+		       __func__);
+		return PTR_RET(ion_page_pool_zero_task);
+	}
+	sched_setscheduler(ion_page_pool_zero_task, SCHED_IDLE, &param);
 	return 0;
 }
 
 static void __exit ion_page_pool_exit(void)
 {
+	kthread_stop(ion_page_pool_zero_task);
 }
 
 module_init(ion_page_pool_init);
@@ -339,12 +339,53 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * invalidated from the cache, provides a significant peformance benefit on
  * many systems */
 
+#define ION_POOL_CPU_PAGES	16
+#define ION_POOL_CPU_BATCH	8
+#define ION_POOL_HIST_BUCKETS	16
+
+/**
+ * struct ion_page_pool_cpu - per-cpu cache of ready pages for order-0 pools
+ * @lock:		protects this cpu's cache; only contended by the
+ *			shrinker
+ * @count:		number of pages in @pages
+ * @pages:		cached pages, ready to be handed out
+ */
+struct ion_page_pool_cpu {
+	spinlock_t lock;
+	int count;
+	struct page *pages[ION_POOL_CPU_PAGES];
+};
+
+/**
+ * struct ion_page_pool_stats - per-cpu allocation statistics
+ * @cpu_hits:		allocations served from the per-cpu cache
+ * @pool_hits:		allocations served from the pool lists
+ * @misses:		allocations that had to go to the page allocator
+ * @total_ns:		sum of allocation latencies
+ * @total_sq_us:	sum of squared allocation latencies, in usecs
+ * @max_ns:		worst allocation latency seen
+ * @hist:		log2 histogram of allocation latencies in usecs
+ */
+struct ion_page_pool_stats {
+	u64 cpu_hits;
+	u64 pool_hits;
+	u64 misses;
+	u64 total_ns;
+	u64 total_sq_us;
+	u64 max_ns;
+	unsigned int hist[ION_POOL_HIST_BUCKETS];
+};
+
 /**
  * struct ion_page_pool - pagepool struct
  * @high_count:		number of highmem items in the pool
  * @low_count:		number of lowmem items in the pool
  * @high_items:		list of highmem items
  * @low_items:		list of lowmem items
+ * @dirty_high_count:	number of highmem items waiting to be zeroed
+ * @dirty_low_count:	number of lowmem items waiting to be zeroed
+ * @dirty_high_items:	list of highmem items waiting to be zeroed
+ * @dirty_low_items:	list of lowmem items waiting to be zeroed
  * @shrinker:		a shrinker for the items
  * @mutex:		lock protecting this struct and especially the count
  *			item list
@@ -355,21 +396,36 @@ void ion_carveout_free(struct ion_heap *heap, ion_phys_addr_t addr,
  * @gfp_mask:		gfp_mask to use from alloc
  * @order:		order of pages in the pool
  * @list:		plist node for list of pools
+ * @zero_list:		node in the list of pools served by the zeroing thread
+ * @cpu_cache:		per-cpu cache of ready pages, order-0 pools only
+ * @stats:		per-cpu allocation statistics
  *
  * Allows you to keep a pool of pre allocated pages to use from your heap.
  * Keeping a pool of pages that is ready for dma, ie any cached mapping have
  * been invalidated from the cache, provides a significant peformance benefit
  * on many systems
+ *
+ * Pools created with __GFP_ZERO take pages back without them being zeroed.
+ * Those pages sit on the dirty lists until a low priority kernel thread
+ * zeroes them and moves them to the regular lists, so neither freeing nor
+ * allocating normally pays for the memset.
  */
 struct ion_page_pool {
 	int high_count;
 	int low_count;
 	struct list_head high_items;
 	struct list_head low_items;
+	int dirty_high_count;
+	int dirty_low_count;
+	struct list_head dirty_high_items;
+	struct list_head dirty_low_items;
 	struct mutex mutex;
 	gfp_t gfp_mask;
 	unsigned int order;
 	struct plist_node list;
+	struct list_head zero_list;
+	struct ion_page_pool_cpu __percpu *cpu_cache;
+	struct ion_page_pool_stats __percpu *stats;
 };
 
 struct ion_page_pool *ion_page_pool_create(gfp_t gfp_mask, unsigned int order);
@@ -377,6 +433,13 @@ void ion_page_pool_destroy(struct ion_page_pool *);
 void *ion_page_pool_alloc(struct ion_page_pool *);
 void ion_page_pool_free(struct ion_page_pool *, struct page *);
 
+/**
+ * ion_page_pool_debug_show - print zeroing state and allocation statistics
+ * @pool:		the pool
+ * @s:			seq_file to print to
+ */
+void ion_page_pool_debug_show(struct ion_page_pool *pool, struct seq_file *s);
+
 /** ion_page_pool_shrink - shrinks the size of the memory cached in the pool
  * @pool:		the pool
  * @gfp_mask:		the memory type to reclaim
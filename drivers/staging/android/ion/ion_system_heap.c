@@ -199,9 +199,7 @@ void ion_system_heap_free(struct ion_buffer *buffer)
 	LIST_HEAD(pages);
 	int i;
 
-	if (!(buffer->flags & ION_FLAG_FREED_FROM_SHRINKER))
-		ion_heap_buffer_zero(buffer);
-
+	/* The page pools zero pages in the background before reusing them */
 	for_each_sg(table->sgl, sg, table->nents, i)
 		free_buffer_page(sys_heap, buffer, sg_page(sg),
 				get_order(sg->length));
@@ -249,8 +247,9 @@ static int ion_system_heap_shrink(struct shrinker *shrinker,
 	/* shrink the free list first, no point in zeroing the memory if
 	   we're just going to reclaim it. Also, skip any possible
 	   page pooling */
-	nr_freed += ion_heap_freelist_drain_from_shrinker(
-		heap, sc->nr_to_scan * PAGE_SIZE) / PAGE_SIZE;
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		nr_freed += ion_heap_freelist_drain_from_shrinker(
+			heap, sc->nr_to_scan * PAGE_SIZE) / PAGE_SIZE;
 
 	if (nr_freed >= sc->nr_to_scan)
 		goto end;
@@ -276,7 +275,8 @@ end:
 		nr_total += ion_page_pool_shrink(
 			sys_heap->cached_pools[i], sc->gfp_mask, 0);
 	}
-	nr_total += ion_heap_freelist_size(heap) / PAGE_SIZE;
+	if (heap->flags & ION_HEAP_FLAG_DEFER_FREE)
+		nr_total += ion_heap_freelist_size(heap) / PAGE_SIZE;
 	return nr_total;
 
 }
@@ -313,6 +313,14 @@ static int ion_system_heap_debug_show(struct ion_heap *heap, struct seq_file *s,
 			(1 << pool->order) * PAGE_SIZE * pool->low_count);
 	}
 
+	seq_puts(s, "uncached pools:\n");
+	for (i = 0; i < num_orders; i++)
+		ion_page_pool_debug_show(sys_heap->uncached_pools[i], s);
+
+	seq_puts(s, "cached pools:\n");
+	for (i = 0; i < num_orders; i++)
+		ion_page_pool_debug_show(sys_heap->cached_pools[i], s);
+
 	return 0;
 }
 
@@ -362,7 +370,8 @@ struct ion_heap *ion_system_heap_create(struct ion_platform_heap *unused)
 		return ERR_PTR(-ENOMEM);
 	heap->heap.ops = &system_heap_ops;
 	heap->heap.type = ION_HEAP_TYPE_SYSTEM;
-	heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE;
+	if (IS_ENABLED(CONFIG_ION_SYSTEM_HEAP_DEFER_FREE))
+		heap->heap.flags = ION_HEAP_FLAG_DEFER_FREE;
 
 	heap->uncached_pools = kzalloc(pools_size, GFP_KERNEL);
 	if (!heap->uncached_pools)
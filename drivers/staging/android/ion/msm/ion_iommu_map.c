@@ -11,6 +11,7 @@
  *
  */
 
+#include <linux/debugfs.h>
 #include <linux/dma-buf.h>
 #include <linux/export.h>
 #include <linux/iommu.h>
@@ -18,9 +19,13 @@
 #include <linux/kernel.h>
 #include <linux/kref.h>
 #include <linux/scatterlist.h>
+#include <linux/seq_file.h>
+#include <linux/shrinker.h>
 #include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <linux/msm_iommu_domains.h>
+#include "../ion_priv.h"
 
 enum {
 	DI_PARTITION_NUM = 0,
@@ -47,6 +52,10 @@ enum {
  * and address range. There may exist other mappings of this buffer in
  * different domains or address ranges. All mappings will have the same
  * cacheability and security.
+ *
+ * A mapping whose reference count drops to zero is not torn down; it
+ * stays in the buffer's tree and is handed out again by the next
+ * ion_map_iommu() for the same domain and partition.
  */
 struct ion_iommu_map {
 	unsigned long iova_addr;
@@ -62,6 +71,15 @@ struct ion_iommu_map {
 };
 
 
+/*
+ * struct ion_iommu_meta - the iommu mappings of one ion buffer
+ *
+ * @ref counts the outstanding ion_map_iommu() calls. Once it drops to zero
+ * the meta and its idle mappings are kept cached, still holding @dbuf so
+ * the buffer cannot go away underneath them. Cached metas are released
+ * by the reaper once @dbuf holds the last reference to the buffer, or by
+ * the shrinker under memory pressure.
+ */
 struct ion_iommu_meta {
 	struct rb_node node;
 	struct ion_handle *handle;
@@ -76,6 +94,18 @@ struct ion_iommu_meta {
 static struct rb_root iommu_root;
 DEFINE_MUTEX(msm_iommu_map_mutex);
 
+/* Protected by msm_iommu_map_mutex */
+static unsigned long ion_iommu_nr_cached;
+
+static atomic_long_t ion_iommu_hits = ATOMIC_LONG_INIT(0);
+static atomic_long_t ion_iommu_misses = ATOMIC_LONG_INIT(0);
+static atomic_long_t ion_iommu_released = ATOMIC_LONG_INIT(0);
+
+#define ION_IOMMU_REAP_DELAY	HZ
+
+static void ion_iommu_reap(struct work_struct *work);
+static DECLARE_DELAYED_WORK(ion_iommu_reap_work, ion_iommu_reap);
+
 static void ion_iommu_meta_add(struct ion_iommu_meta *meta)
 {
 	struct rb_root *root = &iommu_root;
@@ -337,6 +367,12 @@ static struct ion_iommu_meta *ion_iommu_meta_create(struct ion_client *client,
 	meta->table = table;
 	meta->size = size;
 	meta->dbuf = ion_share_dma_buf(client, handle);
+	if (IS_ERR_OR_NULL(meta->dbuf)) {
+		struct dma_buf *dbuf = meta->dbuf;
+
+		kfree(meta);
+		return dbuf ? ERR_CAST(dbuf) : ERR_PTR(-ENOMEM);
+	}
 	kref_init(&meta->ref);
 	mutex_init(&meta->lock);
 	ion_iommu_meta_add(meta);
@@ -344,27 +380,150 @@ static struct ion_iommu_meta *ion_iommu_meta_create(struct ion_client *client,
 	return meta;
 }
 
-static void ion_iommu_meta_destroy(struct kref *kref)
+static void ion_iommu_map_free(struct ion_iommu_map *map)
 {
-	struct ion_iommu_meta *meta = container_of(kref, struct ion_iommu_meta,
-						ref);
+	struct ion_iommu_meta *meta = map->meta;
 
+	rb_erase(&map->node, &meta->iommu_maps);
+	ion_iommu_heap_unmap_iommu(map);
+	kfree(map);
+}
+
+/*
+ * Tears down @meta and all of its mappings. Must be called with
+ * msm_iommu_map_mutex held. Returns the dma_buf the caller has to put
+ * once the mutex has been dropped, as that may free the buffer.
+ */
+static struct dma_buf *ion_iommu_meta_destroy(struct ion_iommu_meta *meta)
+{
+	struct dma_buf *dbuf = meta->dbuf;
+	struct rb_node *n;
+
+	while ((n = rb_first(&meta->iommu_maps)))
+		ion_iommu_map_free(rb_entry(n, struct ion_iommu_map, node));
 
 	rb_erase(&meta->node, &iommu_root);
-	dma_buf_put(meta->dbuf);
 	kfree(meta);
+	return dbuf;
+}
+
+static void ion_iommu_meta_idle(struct kref *kref)
+{
+	/* Kept around, see ion_iommu_meta_put() */
 }
 
 static void ion_iommu_meta_put(struct ion_iommu_meta *meta)
 {
+	struct dma_buf *dbuf = NULL;
+
 	/*
 	 * Need to lock here to prevent race against map/unmap
 	 */
 	mutex_lock(&msm_iommu_map_mutex);
-	kref_put(&meta->ref, ion_iommu_meta_destroy);
+	if (kref_put(&meta->ref, ion_iommu_meta_idle)) {
+		if (RB_EMPTY_ROOT(&meta->iommu_maps)) {
+			dbuf = ion_iommu_meta_destroy(meta);
+		} else {
+			ion_iommu_nr_cached++;
+			schedule_delayed_work(&ion_iommu_reap_work,
+					      ION_IOMMU_REAP_DELAY);
+		}
+	}
+	mutex_unlock(&msm_iommu_map_mutex);
+
+	if (dbuf)
+		dma_buf_put(dbuf);
+}
+
+/*
+ * The dma_buf of a meta is never handed out, so once it holds the only
+ * reference to the buffer nobody can map the buffer again.
+ */
+static bool ion_iommu_meta_orphaned(struct ion_iommu_meta *meta)
+{
+	struct ion_buffer *buffer = meta->dbuf->priv;
+
+	return atomic_read(&buffer->ref.refcount) == 1;
+}
+
+/*
+ * Releases up to @nr_to_scan cached metas, those whose buffer has already
+ * been freed by everybody else first. Must be called with
+ * msm_iommu_map_mutex held; the dma_bufs to put are returned in @dbufs.
+ */
+static int ion_iommu_release_cached(int nr_to_scan, bool orphaned_only,
+				    struct dma_buf **dbufs)
+{
+	struct rb_node *n, *next;
+	int nr = 0, pass;
+
+	for (pass = 0; pass < 2 && nr < nr_to_scan; pass++) {
+		for (n = rb_first(&iommu_root); n && nr < nr_to_scan;
+		     n = next) {
+			struct ion_iommu_meta *meta;
+
+			next = rb_next(n);
+			meta = rb_entry(n, struct ion_iommu_meta, node);
+			if (atomic_read(&meta->ref.refcount))
+				continue;
+			if (!pass && !ion_iommu_meta_orphaned(meta))
+				continue;
+			dbufs[nr++] = ion_iommu_meta_destroy(meta);
+			ion_iommu_nr_cached--;
+		}
+		if (orphaned_only)
+			break;
+	}
+
+	atomic_long_add(nr, &ion_iommu_released);
+	return nr;
+}
+
+#define ION_IOMMU_RELEASE_BATCH	32
+
+static void ion_iommu_reap(struct work_struct *work)
+{
+	struct dma_buf *dbufs[ION_IOMMU_RELEASE_BATCH];
+	int i, nr;
+
+	mutex_lock(&msm_iommu_map_mutex);
+	nr = ion_iommu_release_cached(ARRAY_SIZE(dbufs), true, dbufs);
+	if (ion_iommu_nr_cached)
+		schedule_delayed_work(&ion_iommu_reap_work,
+				      ION_IOMMU_REAP_DELAY);
 	mutex_unlock(&msm_iommu_map_mutex);
+
+	for (i = 0; i < nr; i++)
+		dma_buf_put(dbufs[i]);
 }
 
+static int ion_iommu_shrink(struct shrinker *shrinker,
+			    struct shrink_control *sc)
+{
+	struct dma_buf *dbufs[ION_IOMMU_RELEASE_BATCH];
+	int i, nr;
+
+	if (!sc->nr_to_scan)
+		return ion_iommu_nr_cached;
+
+	/* Mapping and sharing may allocate with the mutex held */
+	if (!mutex_trylock(&msm_iommu_map_mutex))
+		return -1;
+	nr = ion_iommu_release_cached(min_t(unsigned long, sc->nr_to_scan,
+					    ARRAY_SIZE(dbufs)), false, dbufs);
+	mutex_unlock(&msm_iommu_map_mutex);
+
+	for (i = 0; i < nr; i++)
+		dma_buf_put(dbufs[i]);
+
+	return ion_iommu_nr_cached;
+}
+
+static struct shrinker ion_iommu_shrinker = {
+	.shrink = ion_iommu_shrink,
+	.seeks = DEFAULT_SEEKS,
+};
+
 int ion_map_iommu(struct ion_client *client, struct ion_handle *handle,
 			int domain_num, int partition_num, unsigned long align,
 			unsigned long iova_length, ion_phys_addr_t *iova,
@@ -434,10 +593,17 @@ int ion_map_iommu(struct ion_client *client, struct ion_handle *handle,
 	mutex_lock(&msm_iommu_map_mutex);
 	iommu_meta = ion_iommu_meta_lookup(table);
 
-	if (!iommu_meta)
+	if (!iommu_meta) {
 		iommu_meta = ion_iommu_meta_create(client, handle, table, size);
-	else
-		kref_get(&iommu_meta->ref);
+		if (IS_ERR(iommu_meta)) {
+			mutex_unlock(&msm_iommu_map_mutex);
+			return PTR_ERR(iommu_meta);
+		}
+	} else if (!kref_get_unless_zero(&iommu_meta->ref)) {
+		/* Cached meta, it still holds the buffer through dbuf */
+		kref_init(&iommu_meta->ref);
+		ion_iommu_nr_cached--;
+	}
 	BUG_ON(iommu_meta->size != size);
 	mutex_unlock(&msm_iommu_map_mutex);
 
@@ -449,6 +615,7 @@ int ion_map_iommu(struct ion_client *client, struct ion_handle *handle,
 					    flags, iova);
 		if (!IS_ERR_OR_NULL(iommu_map)) {
 			iommu_map->flags = iommu_flags;
+			atomic_long_inc(&ion_iommu_misses);
 			ret = 0;
 		} else {
 			ret = PTR_ERR(iommu_map);
@@ -468,8 +635,11 @@ int ion_map_iommu(struct ion_client *client, struct ion_handle *handle,
 			ret = -EINVAL;
 			goto out_unlock;
 		} else {
-			kref_get(&iommu_map->ref);
+			/* Revive the mapping if it was cached idle */
+			if (!kref_get_unless_zero(&iommu_map->ref))
+				kref_init(&iommu_map->ref);
 			*iova = iommu_map->iova_addr;
+			atomic_long_inc(&ion_iommu_hits);
 		}
 	}
 	mutex_unlock(&iommu_meta->lock);
@@ -486,15 +656,9 @@ out:
 EXPORT_SYMBOL(ion_map_iommu);
 
 
-static void ion_iommu_map_release(struct kref *kref)
+static void ion_iommu_map_idle(struct kref *kref)
 {
-	struct ion_iommu_map *map = container_of(kref, struct ion_iommu_map,
-						ref);
-	struct ion_iommu_meta *meta = map->meta;
-
-	rb_erase(&map->node, &meta->iommu_maps);
-	ion_iommu_heap_unmap_iommu(map);
-	kfree(map);
+	/* Stays mapped until its meta is released */
 }
 
 void ion_unmap_iommu(struct ion_client *client, struct ion_handle *handle,
@@ -536,7 +700,7 @@ void ion_unmap_iommu(struct ion_client *client, struct ion_handle *handle,
 		goto out;
 	}
 
-	kref_put(&iommu_map->ref, ion_iommu_map_release);
+	kref_put(&iommu_map->ref, ion_iommu_map_idle);
 	mutex_unlock(&meta->lock);
 
 	ion_iommu_meta_put(meta);
@@ -547,3 +711,34 @@ out:
 EXPORT_SYMBOL(ion_unmap_iommu);
 
 
+
+static int ion_iommu_map_stats_show(struct seq_file *s, void *unused)
+{
+	seq_printf(s, "hits: %ld\n", atomic_long_read(&ion_iommu_hits));
+	seq_printf(s, "misses: %ld\n", atomic_long_read(&ion_iommu_misses));
+	seq_printf(s, "cached buffers: %lu\n", ion_iommu_nr_cached);
+	seq_printf(s, "released buffers: %ld\n",
+		   atomic_long_read(&ion_iommu_released));
+	return 0;
+}
+
+static int ion_iommu_map_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, ion_iommu_map_stats_show, inode->i_private);
+}
+
+static const struct file_operations ion_iommu_map_stats_fops = {
+	.open = ion_iommu_map_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init ion_iommu_map_init(void)
+{
+	register_shrinker(&ion_iommu_shrinker);
+	debugfs_create_file("ion_iommu_map", 0444, NULL, NULL,
+			    &ion_iommu_map_stats_fops);
+	return 0;
+}
+late_initcall(ion_iommu_map_init);
@@ -170,7 +170,9 @@ int ion_handle_get_size(struct ion_client *client, struct ion_handle *handle,
  * @partition_num - partition to unmap from
  *
  * Decrement the reference count on the iommu mapping. If the count is
- * 0, the mapping will be removed from the iommu.
+ * 0, the mapping is kept cached for the next ion_map_iommu of the same
+ * buffer, domain and partition. Cached mappings are removed from the iommu
+ * once the buffer is freed, or earlier under memory pressure.
  */
 void ion_unmap_iommu(struct ion_client *client, struct ion_handle *handle,
 			int domain_num, int partition_num);
@@ -0,0 +1,301 @@
+/*
+ * drivers/staging/android/ipc_bench.c
+ *
+ * Latency benchmarks for the sync and ion paths used by the graphics
+ * and media IPC. Reading /sys/kernel/debug/ipc_bench/<name> runs the
+ * benchmark and prints percentiles of the per operation latency.
+ *
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#include <linux/debugfs.h>
+#include <linux/err.h>
+#include <linux/kernel.h>
+#include <linux/ktime.h>
+#include <linux/module.h>
+#include <linux/mutex.h>
+#include <linux/seq_file.h>
+#include <linux/sizes.h>
+#include <linux/sort.h>
+#include <linux/sw_sync.h>
+#include <linux/vmalloc.h>
+
+#if IS_ENABLED(CONFIG_ION_MSM)
+#include <linux/msm_ion.h>
+#endif
+
+static unsigned int loops = 1000;
+module_param(loops, uint, 0644);
+MODULE_PARM_DESC(loops, "Iterations per measured operation");
+
+#if IS_ENABLED(CONFIG_ION_MSM)
+static unsigned int heap_mask = ION_HEAP(ION_SYSTEM_HEAP_ID) |
+				ION_HEAP(ION_SYSTEM_CONTIG_HEAP_ID);
+module_param(heap_mask, uint, 0644);
+MODULE_PARM_DESC(heap_mask, "Ion heaps to measure, one bit per heap id");
+#endif
+
+/* Runs share the sample buffers */
+static DEFINE_MUTEX(bench_lock);
+static struct dentry *bench_dir;
+
+static inline u64 bench_now(void)
+{
+	return ktime_to_ns(ktime_get());
+}
+
+static int cmp_u32(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void bench_report(struct seq_file *m, const char *name,
+			 u32 *ns, unsigned int nr)
+{
+	u64 sum = 0;
+	unsigned int i;
+
+	if (!nr) {
+		seq_printf(m, "%-20s no samples\n", name);
+		return;
+	}
+
+	for (i = 0; i < nr; i++)
+		sum += ns[i];
+	sort(ns, nr, sizeof(*ns), cmp_u32, NULL);
+
+	seq_printf(m, "%-20s n=%u avg=%llu p50=%u p90=%u p99=%u max=%u ns\n",
+		   name, nr, div_u64(sum, nr), ns[nr / 2], ns[nr * 9 / 10],
+		   ns[nr * 99 / 100], ns[nr - 1]);
+}
+
+static u32 *bench_alloc(unsigned int nr)
+{
+	return vzalloc(nr * sizeof(u32));
+}
+
+#ifdef CONFIG_SW_SYNC
+/*
+ * Each fence holds one point on a private timeline. Signaling steps the
+ * timeline by one, so every increment completes exactly one fence.
+ */
+static int bench_sync_show(struct seq_file *m, void *unused)
+{
+	struct sw_sync_timeline *tl;
+	struct sync_fence **fences;
+	struct sync_fence *fence;
+	struct sync_pt *pt;
+	u32 *create, *merge, *signal;
+	unsigned int i, nr = loops, made = 0, merged = 0;
+	u64 t0;
+	int ret = -ENOMEM;
+
+	fences = vzalloc(nr * sizeof(*fences));
+	create = bench_alloc(nr);
+	merge = bench_alloc(nr);
+	signal = bench_alloc(nr);
+	if (!fences || !create || !merge || !signal)
+		goto out_free;
+
+	tl = sw_sync_timeline_create("ipc_bench");
+	if (!tl)
+		goto out_free;
+
+	for (i = 0; i < nr; i++) {
+		t0 = bench_now();
+		pt = sw_sync_pt_create(tl, i + 1);
+		if (!pt)
+			break;
+		fence = sync_fence_create("ipc_bench", pt);
+		if (!fence) {
+			sync_pt_free(pt);
+			break;
+		}
+		create[i] = bench_now() - t0;
+		fences[made++] = fence;
+	}
+
+	for (i = 1; i < made; i++) {
+		t0 = bench_now();
+		fence = sync_fence_merge("ipc_bench", fences[i - 1],
+					 fences[i]);
+		if (!fence)
+			break;
+		merge[merged++] = bench_now() - t0;
+		sync_fence_put(fence);
+	}
+
+	for (i = 0; i < made; i++) {
+		t0 = bench_now();
+		sw_sync_timeline_inc(tl, 1);
+		signal[i] = bench_now() - t0;
+	}
+
+	for (i = 0; i < made; i++)
+		sync_fence_put(fences[i]);
+	sync_timeline_destroy(&tl->obj);
+
+	bench_report(m, "fence_create", create, made);
+	bench_report(m, "fence_merge", merge, merged);
+	bench_report(m, "fence_signal", signal, made);
+	ret = 0;
+
+out_free:
+	vfree(signal);
+	vfree(merge);
+	vfree(create);
+	vfree(fences);
+	return ret;
+}
+#endif
+
+#if IS_ENABLED(CONFIG_ION_MSM)
+static const size_t bench_ion_sizes[] = { SZ_4K, SZ_64K, SZ_1M };
+
+static void bench_ion_one(struct seq_file *m, struct ion_client *client,
+			  unsigned int heap_id, size_t size,
+			  u32 *alloc, u32 *map, u32 *free)
+{
+	struct ion_handle *handle;
+	unsigned int i, nr = 0, mapped = 0;
+	char name[32];
+	void *vaddr;
+	u64 t0;
+
+	for (i = 0; i < loops; i++) {
+		t0 = bench_now();
+		handle = ion_alloc(client, size, SZ_4K, ION_HEAP(heap_id), 0);
+		if (IS_ERR_OR_NULL(handle))
+			break;
+		alloc[nr] = bench_now() - t0;
+
+		t0 = bench_now();
+		vaddr = ion_map_kernel(client, handle);
+		if (!IS_ERR_OR_NULL(vaddr)) {
+			map[mapped++] = bench_now() - t0;
+			ion_unmap_kernel(client, handle);
+		}
+
+		t0 = bench_now();
+		ion_free(client, handle);
+		free[nr++] = bench_now() - t0;
+	}
+
+	if (!nr) {
+		seq_printf(m, "heap %u: %zuK allocation failed\n", heap_id,
+			   size / SZ_1K);
+		return;
+	}
+
+	snprintf(name, sizeof(name), "heap%u_%zuK_alloc", heap_id,
+		 size / SZ_1K);
+	bench_report(m, name, alloc, nr);
+	snprintf(name, sizeof(name), "heap%u_%zuK_map", heap_id,
+		 size / SZ_1K);
+	bench_report(m, name, map, mapped);
+	snprintf(name, sizeof(name), "heap%u_%zuK_free", heap_id,
+		 size / SZ_1K);
+	bench_report(m, name, free, nr);
+}
+
+static int bench_ion_show(struct seq_file *m, void *unused)
+{
+	struct ion_client *client;
+	unsigned int mask = heap_mask, id, i;
+	u32 *alloc, *map, *free;
+	int ret = -ENOMEM;
+
+	alloc = bench_alloc(loops);
+	map = bench_alloc(loops);
+	free = bench_alloc(loops);
+	if (!alloc || !map || !free)
+		goto out_free;
+
+	client = msm_ion_client_create(mask, "ipc_bench");
+	if (IS_ERR_OR_NULL(client)) {
+		ret = client ? PTR_ERR(client) : -ENODEV;
+		goto out_free;
+	}
+
+	for (id = 0; id < 32; id++) {
+		if (!(mask & ION_HEAP(id)))
+			continue;
+		for (i = 0; i < ARRAY_SIZE(bench_ion_sizes); i++)
+			bench_ion_one(m, client, id, bench_ion_sizes[i],
+				      alloc, map, free);
+	}
+
+	ion_client_destroy(client);
+	ret = 0;
+
+out_free:
+	vfree(free);
+	vfree(map);
+	vfree(alloc);
+	return ret;
+}
+#endif
+
+static int bench_show(struct seq_file *m, void *unused)
+{
+	int (*show)(struct seq_file *, void *) = m->private;
+	int ret;
+
+	if (!loops)
+		return -EINVAL;
+
+	mutex_lock(&bench_lock);
+	ret = show(m, NULL);
+	mutex_unlock(&bench_lock);
+	return ret;
+}
+
+static int bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, bench_show, inode->i_private);
+}
+
+static const struct file_operations bench_fops = {
+	.open		= bench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static int __init ipc_bench_init(void)
+{
+	bench_dir = debugfs_create_dir("ipc_bench", NULL);
+	if (IS_ERR_OR_NULL(bench_dir))
+		return -ENODEV;
+
+#ifdef CONFIG_SW_SYNC
+	debugfs_create_file("sync", 0400, bench_dir, bench_sync_show,
+			    &bench_fops);
+#endif
+#if IS_ENABLED(CONFIG_ION_MSM)
+	debugfs_create_file("ion", 0400, bench_dir, bench_ion_show,
+			    &bench_fops);
+#endif
+	return 0;
+}
+
+static void __exit ipc_bench_exit(void)
+{
+	debugfs_remove_recursive(bench_dir);
+}
+
+module_init(ipc_bench_init);
+module_exit(ipc_bench_exit);
+MODULE_LICENSE("GPL v2");
+MODULE_DESCRIPTION("Sync and ion latency benchmarks");
@@ -23,6 +23,7 @@
 #include <linux/module.h>
 #include <linux/fs.h>
 #include <linux/miscdevice.h>
+#include <linux/mm.h>
 #include <linux/uaccess.h>
 #include <linux/poll.h>
 #include <linux/slab.h>
@@ -37,9 +38,14 @@
 #define CONFIG_LOGCAT_SIZE 256
 #endif
 
+/* the largest entry handed to a reader, in either ABI version */
+#define LOGGER_ENTRY_MAX_LEN \
+	(sizeof(struct logger_entry) + LOGGER_ENTRY_MAX_PAYLOAD)
+
 /**
  * struct logger_log - represents a specific log, such as 'main' or 'radio'
  * @buffer:	The actual ring buffer
+ * @mmap_hdr:	The page that precedes @buffer in a read-only mapping
  * @misc:	The "misc" device representing the log
  * @wq:		The wait queue for @readers
  * @readers:	This log's readers
@@ -55,6 +61,7 @@
  */
 struct logger_log {
 	unsigned char		*buffer;
+	struct logger_mmap_header *mmap_hdr;
 	struct miscdevice	misc;
 	wait_queue_head_t	wq;
 	struct list_head	readers;
@@ -75,9 +82,13 @@ static LIST_HEAD(log_list);
  * @r_off:	The current read head offset.
  * @r_all:	Reader can read all entries
  * @r_ver:	Reader ABI version
+ * @read_mutex:	Serializes reads, which share @buf
+ * @buf:	The entry being read, copied out of the log
  *
  * This object lives from open to release, so we don't need additional
- * reference counting. The structure is protected by log->mutex.
+ * reference counting. The structure is protected by log->mutex, except
+ * for @buf which is only filled under log->mutex and then copied to
+ * userspace with just @read_mutex held.
  */
 struct logger_reader {
 	struct logger_log	*log;
@@ -85,6 +96,8 @@ struct logger_reader {
 	size_t			r_off;
 	bool			r_all;
 	int			r_ver;
+	struct mutex		read_mutex;
+	char			*buf;
 };
 
 /* logger_offset - returns index 'n' into the log via (optimized) modulus */
@@ -165,8 +178,7 @@ static size_t get_user_hdr_len(int ver)
 		return sizeof(struct logger_entry);
 }
 
-static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
-					 char __user *buf)
+static void copy_header(int ver, struct logger_entry *entry, char *buf)
 {
 	void *hdr;
 	size_t hdr_len;
@@ -186,19 +198,19 @@ static ssize_t copy_header_to_user(int ver, struct logger_entry *entry,
 		hdr_len     = sizeof(struct logger_entry);
 	}
 
-	return copy_to_user(buf, hdr, hdr_len);
+	memcpy(buf, hdr, hdr_len);
 }
 
 /*
- * do_read_log_to_user - reads exactly 'count' bytes from 'log' into the
- * user-space buffer 'buf'. Returns 'count' on success.
+ * do_read_log - reads exactly 'count' bytes from 'log' into the kernel
+ * buffer 'buf', so that the copy to userspace can be done once log->mutex
+ * is dropped and a slow reader never holds up writers. Returns 'count'.
  *
  * Caller must hold log->mutex.
  */
-static ssize_t do_read_log_to_user(struct logger_log *log,
-				   struct logger_reader *reader,
-				   char __user *buf,
-				   size_t count)
+static ssize_t do_read_log(struct logger_log *log,
+			   struct logger_reader *reader,
+			   char *buf, size_t count)
 {
 	struct logger_entry scratch;
 	struct logger_entry *entry;
@@ -210,8 +222,7 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 	 * the header requested
 	 */
 	entry = get_entry_header(log, reader->r_off, &scratch);
-	if (copy_header_to_user(reader->r_ver, entry, buf))
-		return -EFAULT;
+	copy_header(reader->r_ver, entry, buf);
 
 	count -= get_user_hdr_len(reader->r_ver);
 	buf += get_user_hdr_len(reader->r_ver);
@@ -224,16 +235,14 @@ static ssize_t do_read_log_to_user(struct logger_log *log,
 	 * the log, whichever comes first.
 	 */
 	len = min(count, log->size - msg_start);
-	if (copy_to_user(buf, log->buffer + msg_start, len))
-		return -EFAULT;
+	memcpy(buf, log->buffer + msg_start, len);
 
 	/*
 	 * Second, we read any remaining bytes, starting back at the head of
 	 * the log.
 	 */
 	if (count != len)
-		if (copy_to_user(buf + len, log->buffer, count - len))
-			return -EFAULT;
+		memcpy(buf + len, log->buffer, count - len);
 
 	reader->r_off = logger_offset(log, reader->r_off +
 		sizeof(struct logger_entry) + count);
@@ -285,6 +294,7 @@ static ssize_t logger_read(struct file *file, char __user *buf,
 	ssize_t ret;
 	DEFINE_WAIT(wait);
 
+	mutex_lock(&reader->read_mutex);
 start:
 	while (1) {
 		mutex_lock(&log->mutex);
@@ -311,7 +321,7 @@ start:
 
 	finish_wait(&log->wq, &wait);
 	if (ret)
-		return ret;
+		goto out_read;
 
 	mutex_lock(&log->mutex);
 
@@ -334,11 +344,15 @@ start:
 	}
 
 	/* get exactly one entry from the log */
-	ret = do_read_log_to_user(log, reader, buf, ret);
+	ret = do_read_log(log, reader, reader->buf, ret);
 
 out:
 	mutex_unlock(&log->mutex);
 
+	if (ret > 0 && copy_to_user(buf, reader->buf, ret))
+		ret = -EFAULT;
+out_read:
+	mutex_unlock(&reader->read_mutex);
 	return ret;
 }
 
@@ -391,6 +405,36 @@ static inline int is_between(size_t a, size_t b, size_t c)
 	return 0;
 }
 
+/*
+ * logger_update_begin - marks the start of a change to the ring buffer or
+ * to its heads, so that readers of the mapping discard what they read
+ * while it is in progress.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_update_begin(struct logger_log *log)
+{
+	log->mmap_hdr->seq++;
+	smp_wmb();
+}
+
+/*
+ * logger_update_end - publishes the start head as moved since 'old_head'
+ * and 'written' more bytes behind the write head, then ends the update.
+ *
+ * The caller needs to hold log->mutex.
+ */
+static void logger_update_end(struct logger_log *log, size_t old_head,
+			      size_t written)
+{
+	struct logger_mmap_header *hdr = log->mmap_hdr;
+
+	hdr->head_pos += logger_offset(log, log->head - old_head);
+	hdr->w_pos += written;
+	smp_wmb();
+	hdr->seq++;
+}
+
 /*
  * fix_up_readers - walk the list of all readers and "fix up" any who were
  * lapped by the writer; also do the same for the default "start head".
@@ -473,7 +517,7 @@ static ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 			 unsigned long nr_segs, loff_t ppos)
 {
 	struct logger_log *log = file_get_log(iocb->ki_filp);
-	size_t orig;
+	size_t orig, orig_head;
 	struct logger_entry header;
 	struct timespec now;
 	ssize_t ret = 0;
@@ -494,7 +538,9 @@ static ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 
 	mutex_lock(&log->mutex);
 
+	logger_update_begin(log);
 	orig = log->w_off;
+	orig_head = log->head;
 
 	/*
 	 * Fix up any readers, pulling them forward to the first readable
@@ -517,6 +563,7 @@ static ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 		nr = do_write_log_from_user(log, iov->iov_base, len);
 		if (unlikely(nr < 0)) {
 			log->w_off = orig;
+			logger_update_end(log, orig_head, 0);
 			mutex_unlock(&log->mutex);
 			return nr;
 		}
@@ -525,6 +572,7 @@ static ssize_t logger_aio_write(struct kiocb *iocb, const struct iovec *iov,
 		ret += nr;
 	}
 
+	logger_update_end(log, orig_head, sizeof(struct logger_entry) + ret);
 	mutex_unlock(&log->mutex);
 
 	/* wake up any blocked readers */
@@ -568,6 +616,13 @@ static int logger_open(struct inode *inode, struct file *file)
 		if (!reader)
 			return -ENOMEM;
 
+		reader->buf = kmalloc(LOGGER_ENTRY_MAX_LEN, GFP_KERNEL);
+		if (!reader->buf) {
+			kfree(reader);
+			return -ENOMEM;
+		}
+		mutex_init(&reader->read_mutex);
+
 		reader->log = log;
 		reader->r_ver = 1;
 		reader->r_all = in_egroup_p(inode->i_gid) ||
@@ -602,6 +657,7 @@ static int logger_release(struct inode *ignored, struct file *file)
 		list_del(&reader->list);
 		mutex_unlock(&log->mutex);
 
+		kfree(reader->buf);
 		kfree(reader);
 	}
 
@@ -709,7 +765,11 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 		}
 		list_for_each_entry(reader, &log->readers, list)
 			reader->r_off = log->w_off;
+		logger_update_begin(log);
+		log->mmap_hdr->head_pos = log->mmap_hdr->w_pos;
 		log->head = log->w_off;
+		smp_wmb();
+		log->mmap_hdr->seq++;
 		ret = 0;
 		break;
 	case LOGGER_GET_VERSION:
@@ -735,11 +795,32 @@ static long logger_ioctl(struct file *file, unsigned int cmd, unsigned long arg)
 	return ret;
 }
 
+/*
+ * logger_mmap - maps the header page and the ring buffer read-only, see
+ * struct logger_mmap_header.  Since the mapping shows every entry, only
+ * readers that may read all of them can map it.
+ */
+static int logger_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct logger_reader *reader;
+
+	if (!(file->f_mode & FMODE_READ))
+		return -EBADF;
+
+	reader = file->private_data;
+	if (!reader->r_all || (vma->vm_flags & VM_WRITE))
+		return -EPERM;
+
+	vma->vm_flags &= ~VM_MAYWRITE;
+	return remap_vmalloc_range(vma, reader->log->mmap_hdr, vma->vm_pgoff);
+}
+
 static const struct file_operations logger_fops = {
 	.owner = THIS_MODULE,
 	.read = logger_read,
 	.aio_write = logger_aio_write,
 	.poll = logger_poll,
+	.mmap = logger_mmap,
 	.unlocked_ioctl = logger_ioctl,
 	.compat_ioctl = logger_ioctl,
 	.open = logger_open,
@@ -756,7 +837,8 @@ static int __init create_log(char *log_name, int size)
 	struct logger_log *log;
 	unsigned char *buffer;
 
-	buffer = vmalloc(size);
+	/* the header page first, then the ring, mappable by readers */
+	buffer = vmalloc_user(PAGE_SIZE + size);
 	if (buffer == NULL)
 		return -ENOMEM;
 
@@ -765,7 +847,9 @@ static int __init create_log(char *log_name, int size)
 		ret = -ENOMEM;
 		goto out_free_buffer;
 	}
-	log->buffer = buffer;
+	log->mmap_hdr = (struct logger_mmap_header *)buffer;
+	log->mmap_hdr->size = size;
+	log->buffer = buffer + PAGE_SIZE;
 
 	log->misc.minor = MISC_DYNAMIC_MINOR;
 	log->misc.name = kstrdup(log_name, GFP_KERNEL);
@@ -839,7 +923,7 @@ static void __exit logger_exit(void)
 	list_for_each_entry_safe(current_log, next_log, &log_list, logs) {
 		/* we have to delete all the entry inside log_list */
 		misc_deregister(&current_log->misc);
-		vfree(current_log->buffer);
+		vfree(current_log->mmap_hdr);
 		kfree(current_log->misc.name);
 		list_del(&current_log->logs);
 		kfree(current_log);
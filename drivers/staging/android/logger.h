@@ -70,6 +70,27 @@ struct logger_entry {
 	char		msg[0];
 };
 
+/**
+ * struct logger_mmap_header - the first page of a read-only log mapping
+ * @seq:	Odd while a writer updates the log, bumped again when done
+ * @size:	The size of the ring buffer, which follows this page
+ * @w_pos:	Bytes written since boot, the write head is @w_pos % @size
+ * @head_pos:	Position of the oldest entry still in the ring buffer
+ *
+ * Readers that may read every entry of a log can mmap() it instead of
+ * calling read() for each entry.  Positions only ever grow, so they double
+ * as sequence numbers: a reader keeps its own position, samples @w_pos and
+ * @head_pos between two identical even reads of @seq, and after copying
+ * entries out of the ring checks again that @head_pos has not passed the
+ * position it started from.  Entries carry the struct logger_entry header.
+ */
+struct logger_mmap_header {
+	__u32		seq;
+	__u32		size;
+	__u64		w_pos;
+	__u64		head_pos;
+};
+
 #define LOGGER_LOG_RADIO	"log_radio"	/* radio-related messages */
 #define LOGGER_LOG_EVENTS	"log_events"	/* system/hardware events */
 #define LOGGER_LOG_SYSTEM	"log_system"	/* system/framework messages */
@@ -17,6 +17,19 @@
  * percentage of the cached memory is locked this can be very inaccurate
  * and processes may not get killed until the normal oom killer is triggered.
  *
+ * Writing 1 to /sys/module/lowmemorykiller/parameters/vmpressure makes the
+ * driver pick victims when global reclaim reports medium or critical
+ * vmpressure rather than on every shrinker call. At medium pressure the
+ * minfree/adj thresholds decide as usual; at critical pressure processes
+ * at or above the last adj value are killed even if no threshold has been
+ * crossed. The shrinker then only enforces the first (lowest) minfree
+ * threshold, as a backstop for when the vmpressure worker falls behind.
+ *
+ * Kills are counted per adj slot in
+ * /sys/module/lowmemorykiller/parameters/kill_count. Histograms of the time
+ * from victim selection until its memory has been freed, and of the time
+ * spent per scanning shrinker call, are in debugfs under lowmemorykiller/.
+ *
  * Copyright (C) 2007-2008 Google, Inc.
  *
  * This software is licensed under the terms of the GNU General Public
@@ -42,6 +55,15 @@
 #include <linux/notifier.h>
 #include <linux/mutex.h>
 #include <linux/delay.h>
+#include <linux/vmpressure.h>
+#include <linux/rbtree.h>
+#include <linux/spinlock.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+
+#define CREATE_TRACE_POINTS
+#include "trace/lowmemorykiller.h"
 
 static uint32_t lowmem_debug_level = 1;
 static uint32_t lmk_count = 0;
@@ -61,7 +83,11 @@ static int lowmem_minfree[6] = {
 };
 static int lowmem_minfree_size = 4;
 
+/* Kills per lowmem_adj slot, by the adj of the victim */
+static uint32_t lowmem_kill_count[6];
+
 static unsigned long lowmem_deathpending_timeout;
+static bool lowmem_vmpressure;
 
 #define lowmem_print(level, x...)			\
 	do {						\
@@ -69,6 +95,97 @@ static unsigned long lowmem_deathpending_timeout;
 			pr_info(x);			\
 	} while (0)
 
+/* log2 histogram: bucket 0 counts zero, bucket i counts [2^(i-1), 2^i) */
+#define LOWMEM_HIST_BUCKETS	16
+
+struct lowmem_hist {
+	const char *unit;
+	atomic_t count[LOWMEM_HIST_BUCKETS];
+};
+
+static struct lowmem_hist lowmem_kill_latency = { .unit = "ms" };
+static struct lowmem_hist lowmem_shrink_time = { .unit = "us" };
+
+static void lowmem_hist_add(struct lowmem_hist *hist, u64 val)
+{
+	int i = val ? fls64(val) : 0;
+
+	atomic_inc(&hist->count[min(i, LOWMEM_HIST_BUCKETS - 1)]);
+}
+
+/*
+ * Victims that have been killed but whose memory has not been freed yet,
+ * so that the selection-to-free latency can be measured in exit_mm().
+ * If victims pile up the oldest entry is dropped.
+ */
+#define LOWMEM_MAX_PENDING	8
+
+struct lowmem_pending {
+	pid_t tgid;
+	short oom_score_adj;
+	ktime_t selected;
+};
+
+static struct lowmem_pending lowmem_pending[LOWMEM_MAX_PENDING];
+static atomic_t lowmem_nr_pending = ATOMIC_INIT(0);
+static DEFINE_SPINLOCK(lowmem_pending_lock);
+
+static void lowmem_pending_add(struct task_struct *p, short oom_score_adj,
+			       ktime_t selected)
+{
+	struct lowmem_pending *slot = &lowmem_pending[0];
+	int i;
+
+	spin_lock(&lowmem_pending_lock);
+	for (i = 0; i < LOWMEM_MAX_PENDING; i++) {
+		struct lowmem_pending *pend = &lowmem_pending[i];
+
+		if (!pend->tgid || pend->tgid == p->tgid) {
+			slot = pend;
+			break;
+		}
+		if (ktime_compare(pend->selected, slot->selected) < 0)
+			slot = pend;
+	}
+	if (!slot->tgid)
+		atomic_inc(&lowmem_nr_pending);
+	slot->tgid = p->tgid;
+	slot->oom_score_adj = oom_score_adj;
+	slot->selected = selected;
+	spin_unlock(&lowmem_pending_lock);
+}
+
+/* Called from exit_mm() once @tsk's mm has actually been torn down */
+void lowmem_mm_released(struct task_struct *tsk)
+{
+	struct lowmem_pending pend = { 0 };
+	u64 latency_us;
+	int i;
+
+	if (likely(!atomic_read(&lowmem_nr_pending)))
+		return;
+
+	spin_lock(&lowmem_pending_lock);
+	for (i = 0; i < LOWMEM_MAX_PENDING; i++) {
+		if (lowmem_pending[i].tgid == tsk->tgid) {
+			pend = lowmem_pending[i];
+			lowmem_pending[i].tgid = 0;
+			atomic_dec(&lowmem_nr_pending);
+			break;
+		}
+	}
+	spin_unlock(&lowmem_pending_lock);
+
+	if (!pend.tgid)
+		return;
+
+	latency_us = ktime_us_delta(ktime_get(), pend.selected);
+	lowmem_hist_add(&lowmem_kill_latency, div_u64(latency_us, 1000));
+	trace_lmk_reaped(tsk, pend.oom_score_adj, latency_us);
+	lowmem_print(2, "'%s' (%d) freed %llu us after selection\n",
+		     tsk->comm, tsk->tgid, (unsigned long long)latency_us);
+}
+
 static int test_task_flag(struct task_struct *p, int flag)
 {
 	struct task_struct *t = p;
@@ -87,42 +204,303 @@ static int test_task_flag(struct task_struct *p, int flag)
 
 static DEFINE_MUTEX(scan_mutex);
 
-static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+static int lowmem_array_size(void)
 {
-	struct task_struct *tsk;
-	struct task_struct *selected = NULL;
-	int rem = 0;
+	int array_size = ARRAY_SIZE(lowmem_adj);
+
+	if (lowmem_adj_size < array_size)
+		array_size = lowmem_adj_size;
+	if (lowmem_minfree_size < array_size)
+		array_size = lowmem_minfree_size;
+
+	return array_size;
+}
+
+/*
+ * Returns the lowest oom_score_adj that may be killed at the given free
+ * and file page counts, considering the first @array_size thresholds, or
+ * OOM_SCORE_ADJ_MAX + 1 if none has been crossed.
+ */
+static short lowmem_min_score_adj(int other_free, int other_file,
+				  int array_size, int *minfree)
+{
+	int i;
+
+	for (i = 0; i < array_size; i++) {
+		*minfree = lowmem_minfree[i];
+		if (other_free < *minfree && other_file < *minfree)
+			return lowmem_adj[i];
+	}
+
+	return OOM_SCORE_ADJ_MAX + 1;
+}
+
+#ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
+/*
+ * Thread groups sorted by signal->adj_key. Protected by tasklist_lock:
+ * fork and exit already hold it for writing where groups are added and
+ * removed, victim selection holds it for reading.
+ */
+static struct rb_root lowmem_adj_root = RB_ROOT;
+
+/* Called with tasklist_lock write-held */
+void lowmem_adj_tree_insert(struct task_struct *p)
+{
+	struct signal_struct *sig = p->signal;
+	struct rb_node **link = &lowmem_adj_root.rb_node;
+	struct rb_node *parent = NULL;
+
+	sig->adj_key = sig->oom_score_adj;
+	while (*link) {
+		struct signal_struct *entry;
+
+		parent = *link;
+		entry = rb_entry(parent, struct signal_struct, adj_node);
+		if (sig->adj_key < entry->adj_key)
+			link = &parent->rb_left;
+		else
+			link = &parent->rb_right;
+	}
+
+	rb_link_node(&sig->adj_node, parent, link);
+	rb_insert_color(&sig->adj_node, &lowmem_adj_root);
+}
+
+/* Called with tasklist_lock write-held */
+void lowmem_adj_tree_remove(struct task_struct *p)
+{
+	struct signal_struct *sig = p->signal;
+
+	if (RB_EMPTY_NODE(&sig->adj_node))
+		return;
+
+	rb_erase(&sig->adj_node, &lowmem_adj_root);
+	RB_CLEAR_NODE(&sig->adj_node);
+}
+
+/* Repositions @p's thread group after its oom_score_adj was written */
+void lowmem_adj_tree_update(struct task_struct *p)
+{
+	struct signal_struct *sig;
+
+	write_lock_irq(&tasklist_lock);
+	sig = p->signal;
+	if (pid_alive(p) && !RB_EMPTY_NODE(&sig->adj_node) &&
+	    sig->adj_key != sig->oom_score_adj) {
+		lowmem_adj_tree_remove(p);
+		lowmem_adj_tree_insert(p);
+	}
+	write_unlock_irq(&tasklist_lock);
+}
+#endif
+
+struct lowmem_victim {
+	struct task_struct *task;
+	int tasksize;
+	short oom_score_adj;
+};
+
+/*
+ * Makes @tsk the victim if it is a better choice than the current one.
+ * Returns -1 if an earlier victim is still dying, 0 otherwise.
+ */
+static int lowmem_consider(struct task_struct *tsk, short min_score_adj,
+			   struct lowmem_victim *victim)
+{
+	struct task_struct *p;
+	short oom_score_adj;
 	int tasksize;
+
+	if (tsk->flags & PF_KTHREAD)
+		return 0;
+
+	/* if task no longer has any memory ignore it */
+	if (test_task_flag(tsk, TIF_MM_RELEASED))
+		return 0;
+
+	if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
+		if (test_task_flag(tsk, TIF_MEMDIE))
+			return -1;
+	}
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return 0;
+
+	/* already killed, only unreclaimable leftovers remain */
+	if (test_bit(MMF_OOM_REAPED, &p->mm->flags)) {
+		task_unlock(p);
+		return 0;
+	}
+
+	oom_score_adj = p->signal->oom_score_adj;
+	if (oom_score_adj < min_score_adj) {
+		task_unlock(p);
+		return 0;
+	}
+	tasksize = get_mm_rss(p->mm);
+	task_unlock(p);
+	if (tasksize <= 0)
+		return 0;
+	if (victim->task) {
+		if (oom_score_adj < victim->oom_score_adj)
+			return 0;
+		if (oom_score_adj == victim->oom_score_adj &&
+		    tasksize <= victim->tasksize)
+			return 0;
+	}
+	victim->task = p;
+	victim->tasksize = tasksize;
+	victim->oom_score_adj = oom_score_adj;
+	lowmem_print(2, "select '%s' (%d), adj %hd, size %d, to kill\n",
+		     p->comm, p->pid, oom_score_adj, tasksize);
+	return 0;
+}
+
+#ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
+static void lowmem_lock_tasks(void)
+{
+	read_lock(&tasklist_lock);
+}
+
+static void lowmem_unlock_tasks(void)
+{
+	read_unlock(&tasklist_lock);
+}
+
+/*
+ * Walks thread groups from the highest oom_score_adj down, stopping once
+ * the remaining ones can be neither eligible nor better than the victim.
+ */
+static int lowmem_select(short min_score_adj, struct lowmem_victim *victim)
+{
+	struct rb_node *node;
+
+	for (node = rb_last(&lowmem_adj_root); node; node = rb_prev(node)) {
+		struct signal_struct *sig;
+		struct task_struct *tsk;
+
+		sig = rb_entry(node, struct signal_struct, adj_node);
+		if (sig->adj_key < min_score_adj ||
+		    (victim->task && sig->adj_key < victim->oom_score_adj))
+			break;
+
+		tsk = list_first_entry(&sig->thread_head, struct task_struct,
+				       thread_node);
+		if (lowmem_consider(tsk, min_score_adj, victim) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+#else
+static void lowmem_lock_tasks(void)
+{
+	rcu_read_lock();
+}
+
+static void lowmem_unlock_tasks(void)
+{
+	rcu_read_unlock();
+}
+
+static int lowmem_select(short min_score_adj, struct lowmem_victim *victim)
+{
+	struct task_struct *tsk;
+
+	for_each_process(tsk) {
+		if (lowmem_consider(tsk, min_score_adj, victim) < 0)
+			return -1;
+	}
+
+	return 0;
+}
+#endif
+
+/*
+ * Kills the largest task with the highest oom_score_adj at or above
+ * @min_score_adj. Returns the size of the killed task in pages, 0 if there
+ * was nothing to kill, or -1 if an earlier victim is still dying.
+ * Called with scan_mutex held.
+ */
+static int lowmem_kill(short min_score_adj, int minfree, int other_free,
+		       int other_file)
+{
+	struct lowmem_victim victim = { .oom_score_adj = min_score_adj };
+	struct task_struct *selected;
+	ktime_t selected_time;
 	int i;
-	short min_score_adj = OOM_SCORE_ADJ_MAX + 1;
+
+	lowmem_lock_tasks();
+	if (lowmem_select(min_score_adj, &victim) < 0) {
+		lowmem_unlock_tasks();
+		/* give the system time to free up the memory */
+		msleep_interruptible(20);
+		return -1;
+	}
+	selected = victim.task;
+	if (!selected) {
+		lowmem_unlock_tasks();
+		return 0;
+	}
+	selected_time = ktime_get();
+	trace_lmk_select(selected, victim.oom_score_adj, victim.tasksize,
+			 min_score_adj);
+
+	lowmem_print(1, "Killing '%s' (%d), adj %hd,\n" \
+			"   to free %ldkB on behalf of '%s' (%d) because\n" \
+			"   cache %ldkB is below limit %ldkB for oom_score_adj %hd\n" \
+			"   Free memory is %ldkB above reserved\n",
+		     selected->comm, selected->pid,
+		     victim.oom_score_adj,
+		     victim.tasksize * (long)(PAGE_SIZE / 1024),
+		     current->comm, current->pid,
+		     other_file * (long)(PAGE_SIZE / 1024),
+		     minfree * (long)(PAGE_SIZE / 1024),
+		     min_score_adj,
+		     other_free * (long)(PAGE_SIZE / 1024));
+	lowmem_deathpending_timeout = jiffies + HZ;
+	send_sig(SIGKILL, selected, 0);
+	set_tsk_thread_flag(selected, TIF_MEMDIE);
+	wake_oom_reaper(selected);
+	trace_lmk_kill(selected, victim.oom_score_adj, victim.tasksize,
+		       other_free, other_file, minfree);
+	lowmem_pending_add(selected, victim.oom_score_adj, selected_time);
+	lowmem_unlock_tasks();
+	lmk_count++;
+	for (i = lowmem_array_size() - 1; i >= 0; i--) {
+		if (victim.oom_score_adj >= lowmem_adj[i]) {
+			lowmem_kill_count[i]++;
+			break;
+		}
+	}
+	/* give the system time to free up the memory */
+	msleep_interruptible(20);
+
+	return victim.tasksize;
+}
+
+static int __lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	int rem = 0;
+	int killed;
+	short min_score_adj;
 	int minfree = 0;
-	int selected_tasksize = 0;
-	short selected_oom_score_adj;
-	int array_size = ARRAY_SIZE(lowmem_adj);
+	int array_size = lowmem_array_size();
 	int other_free;
 	int other_file;
 	unsigned long nr_to_scan = sc->nr_to_scan;
 
-	if (nr_to_scan > 0) {
-		if (mutex_lock_interruptible(&scan_mutex) < 0)
-			return 0;
-	}
-
 	other_free = global_page_state(NR_FREE_PAGES) - totalreserve_pages;
 	other_file = global_page_state(NR_FILE_PAGES) -
 						global_page_state(NR_SHMEM);
 
-	if (lowmem_adj_size < array_size)
-		array_size = lowmem_adj_size;
-	if (lowmem_minfree_size < array_size)
-		array_size = lowmem_minfree_size;
-	for (i = 0; i < array_size; i++) {
-		minfree = lowmem_minfree[i];
-		if (other_free < minfree && other_file < minfree) {
-			min_score_adj = lowmem_adj[i];
-			break;
-		}
-	}
+	/* vmpressure does the killing, only keep the backstop here */
+	if (lowmem_vmpressure && array_size > 1)
+		array_size = 1;
+
+	min_score_adj = lowmem_min_score_adj(other_free, other_file,
+					     array_size, &minfree);
 	if (nr_to_scan > 0)
 		lowmem_print(3, "lowmem_shrink %lu, %x, ofree %d %d, ma %hd\n",
 				nr_to_scan, sc->gfp_mask, other_free,
@@ -134,105 +512,155 @@ static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
 	if (nr_to_scan <= 0 || min_score_adj == OOM_SCORE_ADJ_MAX + 1) {
 		lowmem_print(5, "lowmem_shrink %lu, %x, return %d\n",
 			     nr_to_scan, sc->gfp_mask, rem);
-
-		if (nr_to_scan > 0)
-			mutex_unlock(&scan_mutex);
-
 		return rem;
 	}
-	selected_oom_score_adj = min_score_adj;
 
-	rcu_read_lock();
-	for_each_process(tsk) {
-		struct task_struct *p;
-		short oom_score_adj;
-
-		if (tsk->flags & PF_KTHREAD)
-			continue;
-
-		/* if task no longer has any memory ignore it */
-		if (test_task_flag(tsk, TIF_MM_RELEASED))
-			continue;
-
-		if (time_before_eq(jiffies, lowmem_deathpending_timeout)) {
-			if (test_task_flag(tsk, TIF_MEMDIE)) {
-				rcu_read_unlock();
-				/* give the system time to free up the memory */
-				msleep_interruptible(20);
-				mutex_unlock(&scan_mutex);
-				return 0;
-			}
-		}
-
-		p = find_lock_task_mm(tsk);
-		if (!p)
-			continue;
+	if (mutex_lock_interruptible(&scan_mutex) < 0)
+		return 0;
 
-		oom_score_adj = p->signal->oom_score_adj;
-		if (oom_score_adj < min_score_adj) {
-			task_unlock(p);
-			continue;
-		}
-		tasksize = get_mm_rss(p->mm);
-		task_unlock(p);
-		if (tasksize <= 0)
-			continue;
-		if (selected) {
-			if (oom_score_adj < selected_oom_score_adj)
-				continue;
-			if (oom_score_adj == selected_oom_score_adj &&
-			    tasksize <= selected_tasksize)
-				continue;
-		}
-		selected = p;
-		selected_tasksize = tasksize;
-		selected_oom_score_adj = oom_score_adj;
-		lowmem_print(2, "select '%s' (%d), adj %hd, size %d, to kill\n",
-			     p->comm, p->pid, oom_score_adj, tasksize);
-	}
-	if (selected) {
-		lowmem_print(1, "Killing '%s' (%d), adj %hd,\n" \
-				"   to free %ldkB on behalf of '%s' (%d) because\n" \
-				"   cache %ldkB is below limit %ldkB for oom_score_adj %hd\n" \
-				"   Free memory is %ldkB above reserved\n",
-			     selected->comm, selected->pid,
-			     selected_oom_score_adj,
-			     selected_tasksize * (long)(PAGE_SIZE / 1024),
-			     current->comm, current->pid,
-			     other_file * (long)(PAGE_SIZE / 1024),
-			     minfree * (long)(PAGE_SIZE / 1024),
-			     min_score_adj,
-			     other_free * (long)(PAGE_SIZE / 1024));
-		lowmem_deathpending_timeout = jiffies + HZ;
-		send_sig(SIGKILL, selected, 0);
-		set_tsk_thread_flag(selected, TIF_MEMDIE);
-		rem -= selected_tasksize;
-		rcu_read_unlock();
-		lmk_count++;
-		/* give the system time to free up the memory */
-		msleep_interruptible(20);
-	} else
-		rcu_read_unlock();
+	killed = lowmem_kill(min_score_adj, minfree, other_free, other_file);
+	mutex_unlock(&scan_mutex);
+	if (killed < 0)
+		return 0;
+	rem -= killed;
 
 	lowmem_print(4, "lowmem_shrink %lu, %x, return %d\n",
 		     nr_to_scan, sc->gfp_mask, rem);
-	mutex_unlock(&scan_mutex);
 	return rem;
 }
 
+static int lowmem_shrink(struct shrinker *s, struct shrink_control *sc)
+{
+	ktime_t start;
+	int rem;
+
+	if (!sc->nr_to_scan)
+		return __lowmem_shrink(s, sc);
+
+	start = ktime_get();
+	rem = __lowmem_shrink(s, sc);
+	lowmem_hist_add(&lowmem_shrink_time,
+			ktime_us_delta(ktime_get(), start));
+
+	return rem;
+}
+
+static int lowmem_vmpressure_notify(struct notifier_block *nb,
+				    unsigned long level, void *data)
+{
+	unsigned long pressure = *(unsigned long *)data;
+	short min_score_adj;
+	int minfree = 0;
+	int array_size = lowmem_array_size();
+	int other_free;
+	int other_file;
+
+	if (!lowmem_vmpressure || level < VMPRESSURE_MEDIUM)
+		return NOTIFY_OK;
+
+	other_free = global_page_state(NR_FREE_PAGES) - totalreserve_pages;
+	other_file = global_page_state(NR_FILE_PAGES) -
+						global_page_state(NR_SHMEM);
+
+	min_score_adj = lowmem_min_score_adj(other_free, other_file,
+					     array_size, &minfree);
+	if (min_score_adj == OOM_SCORE_ADJ_MAX + 1) {
+		if (level < VMPRESSURE_CRITICAL || array_size <= 0)
+			return NOTIFY_OK;
+		/*
+		 * Reclaim is failing although no threshold has been crossed
+		 * yet; give up the most expendable tasks now rather than
+		 * waiting for free memory to drop further.
+		 */
+		min_score_adj = lowmem_adj[array_size - 1];
+		minfree = lowmem_minfree[array_size - 1];
+	}
+
+	lowmem_print(3, "vmpressure level %lu (%lu), ofree %d %d, ma %hd\n",
+		     level, pressure, other_free, other_file, min_score_adj);
+
+	mutex_lock(&scan_mutex);
+	lowmem_kill(min_score_adj, minfree, other_free, other_file);
+	mutex_unlock(&scan_mutex);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block lowmem_vmpressure_nb = {
+	.notifier_call = lowmem_vmpressure_notify,
+};
+
 static struct shrinker lowmem_shrinker = {
 	.shrink = lowmem_shrink,
 	.seeks = DEFAULT_SEEKS * 16
 };
 
+#ifdef CONFIG_DEBUG_FS
+static int lowmem_hist_show(struct seq_file *m, void *unused)
+{
+	struct lowmem_hist *hist = m->private;
+	int i;
+
+	seq_printf(m, "%12s %s: %u\n", "0", hist->unit,
+		   atomic_read(&hist->count[0]));
+	for (i = 1; i < LOWMEM_HIST_BUCKETS - 1; i++)
+		seq_printf(m, "%5lu - %5lu %s: %u\n", 1UL << (i - 1),
+			   (1UL << i) - 1, hist->unit,
+			   atomic_read(&hist->count[i]));
+	seq_printf(m, "%5lu -       %s: %u\n", 1UL << (i - 1), hist->unit,
+		   atomic_read(&hist->count[i]));
+
+	return 0;
+}
+
+static int lowmem_hist_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, lowmem_hist_show, inode->i_private);
+}
+
+static const struct file_operations lowmem_hist_fops = {
+	.owner = THIS_MODULE,
+	.open = lowmem_hist_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static struct dentry *lowmem_debugfs_root;
+
+static void lowmem_debugfs_init(void)
+{
+	lowmem_debugfs_root = debugfs_create_dir("lowmemorykiller", NULL);
+	if (!lowmem_debugfs_root)
+		return;
+
+	debugfs_create_file("kill_latency", S_IRUGO, lowmem_debugfs_root,
+			    &lowmem_kill_latency, &lowmem_hist_fops);
+	debugfs_create_file("shrink_time", S_IRUGO, lowmem_debugfs_root,
+			    &lowmem_shrink_time, &lowmem_hist_fops);
+}
+
+static void lowmem_debugfs_exit(void)
+{
+	debugfs_remove_recursive(lowmem_debugfs_root);
+}
+#else
+static void lowmem_debugfs_init(void) {}
+static void lowmem_debugfs_exit(void) {}
+#endif
+
 static int __init lowmem_init(void)
 {
 	register_shrinker(&lowmem_shrinker);
+	vmpressure_notifier_register(&lowmem_vmpressure_nb);
+	lowmem_debugfs_init();
 	return 0;
 }
 
 static void __exit lowmem_exit(void)
 {
+	lowmem_debugfs_exit();
+	vmpressure_notifier_unregister(&lowmem_vmpressure_nb);
 	unregister_shrinker(&lowmem_shrinker);
 }
 
@@ -327,7 +755,10 @@ module_param_array_named(adj, lowmem_adj, short, &lowmem_adj_size,
 module_param_array_named(minfree, lowmem_minfree, uint, &lowmem_minfree_size,
 			 S_IRUGO | S_IWUSR);
 module_param_named(debug_level, lowmem_debug_level, uint, S_IRUGO | S_IWUSR);
+module_param_named(vmpressure, lowmem_vmpressure, bool, S_IRUGO | S_IWUSR);
 module_param_named(lmkcount, lmk_count, uint, S_IRUGO);
+module_param_array_named(kill_count, lowmem_kill_count, uint, &lowmem_adj_size,
+			 S_IRUGO);
 
 module_init(lowmem_init);
 module_exit(lowmem_exit);
@@ -41,6 +41,12 @@ static DEFINE_SPINLOCK(sync_timeline_list_lock);
 static LIST_HEAD(sync_fence_list_head);
 static DEFINE_SPINLOCK(sync_fence_list_lock);
 
+/* merge and signal costs, reported in debugfs */
+static atomic_t sync_merge_count = ATOMIC_INIT(0);
+static atomic64_t sync_merge_ns = ATOMIC64_INIT(0);
+static atomic_t sync_signal_count = ATOMIC_INIT(0);
+static atomic64_t sync_signal_ns = ATOMIC64_INIT(0);
+
 struct sync_timeline *sync_timeline_create(const struct sync_timeline_ops *ops,
 					   int size, const char *name)
 {
@@ -135,24 +141,35 @@ void sync_timeline_signal(struct sync_timeline *obj)
 	unsigned long flags;
 	LIST_HEAD(signaled_pts);
 	struct list_head *pos, *n;
+	ktime_t start = ktime_get();
 
 	trace_sync_timeline(obj);
 
 	spin_lock_irqsave(&obj->active_list_lock, flags);
 
+	/*
+	 * The active list is in signaling order, see sync_pt_activate(), so
+	 * everything behind the first unsignaled pt is unsignaled as well.
+	 * Once the timeline is destroyed every pt reports -ENOENT.
+	 */
 	list_for_each_safe(pos, n, &obj->active_list_head) {
 		struct sync_pt *pt =
 			container_of(pos, struct sync_pt, active_list);
 
-		if (_sync_pt_has_signaled(pt)) {
-			list_del_init(pos);
-			list_add(&pt->signaled_list, &signaled_pts);
-			kref_get(&pt->fence->kref);
-		}
+		if (!_sync_pt_has_signaled(pt))
+			break;
+
+		list_del_init(pos);
+		list_add_tail(&pt->signaled_list, &signaled_pts);
+		kref_get(&pt->fence->kref);
 	}
 
 	spin_unlock_irqrestore(&obj->active_list_lock, flags);
 
+	atomic_inc(&sync_signal_count);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		     &sync_signal_ns);
+
 	list_for_each_safe(pos, n, &signaled_pts) {
 		struct sync_pt *pt =
 			container_of(pos, struct sync_pt, signaled_list);
@@ -218,10 +235,17 @@ static struct sync_pt *sync_pt_dup(struct sync_pt *pt)
 	return pt->parent->ops->dup(pt);
 }
 
-/* Adds a sync pt to the active queue.  Called when added to a fence */
+/*
+ * Adds a sync pt to the active queue.  Called when added to a fence
+ *
+ * The queue is kept in the order given by ops->compare(), which is the
+ * order the pts signal in.  New pts are normally the latest ones on their
+ * timeline, so the insertion point is searched from the tail.
+ */
 static void sync_pt_activate(struct sync_pt *pt)
 {
 	struct sync_timeline *obj = pt->parent;
+	struct sync_pt *pos;
 	unsigned long flags;
 	int err;
 
@@ -231,7 +255,10 @@ static void sync_pt_activate(struct sync_pt *pt)
 	if (err != 0)
 		goto out;
 
-	list_add_tail(&pt->active_list, &obj->active_list_head);
+	list_for_each_entry_reverse(pos, &obj->active_list_head, active_list)
+		if (obj->ops->compare(pos, pt) <= 0)
+			break;
+	list_add(&pt->active_list, &pos->active_list);
 
 out:
 	spin_unlock_irqrestore(&obj->active_list_lock, flags);
@@ -310,71 +337,60 @@ struct sync_fence *sync_fence_create(const char *name, struct sync_pt *pt)
 }
 EXPORT_SYMBOL(sync_fence_create);
 
-static int sync_fence_copy_pts(struct sync_fence *dst, struct sync_fence *src)
+/* appends a copy of 'pt' to 'fence', keeping its pts ordered by timeline */
+static int sync_fence_add_dup(struct sync_fence *fence, struct sync_pt *pt)
 {
-	struct list_head *pos;
+	struct sync_pt *new_pt = sync_pt_dup(pt);
 
-	list_for_each(pos, &src->pt_list_head) {
-		struct sync_pt *orig_pt =
-			container_of(pos, struct sync_pt, pt_list);
-		struct sync_pt *new_pt = sync_pt_dup(orig_pt);
-
-		if (new_pt == NULL)
-			return -ENOMEM;
-
-		new_pt->fence = dst;
-		list_add(&new_pt->pt_list, &dst->pt_list_head);
-	}
+	if (new_pt == NULL)
+		return -ENOMEM;
 
+	new_pt->fence = fence;
+	list_add_tail(&new_pt->pt_list, &fence->pt_list_head);
 	return 0;
 }
 
-static int sync_fence_merge_pts(struct sync_fence *dst, struct sync_fence *src)
+/*
+ * The pts of a fence are sorted by timeline, with at most one pt per
+ * timeline, so two fences are merged with a single walk over both lists.
+ */
+static int sync_fence_merge_pts(struct sync_fence *dst,
+				struct sync_fence *a, struct sync_fence *b)
 {
-	struct list_head *src_pos, *dst_pos, *n;
-
-	list_for_each(src_pos, &src->pt_list_head) {
-		struct sync_pt *src_pt =
-			container_of(src_pos, struct sync_pt, pt_list);
-		bool collapsed = false;
+	struct list_head *pos_a = a->pt_list_head.next;
+	struct list_head *pos_b = b->pt_list_head.next;
+	int err = 0;
 
-		list_for_each_safe(dst_pos, n, &dst->pt_list_head) {
-			struct sync_pt *dst_pt =
-				container_of(dst_pos, struct sync_pt, pt_list);
+	while (!err && (pos_a != &a->pt_list_head ||
+			pos_b != &b->pt_list_head)) {
+		struct sync_pt *pt_a = NULL, *pt_b = NULL;
+
+		if (pos_a != &a->pt_list_head)
+			pt_a = container_of(pos_a, struct sync_pt, pt_list);
+		if (pos_b != &b->pt_list_head)
+			pt_b = container_of(pos_b, struct sync_pt, pt_list);
+
+		if (!pt_b || (pt_a && pt_a->parent < pt_b->parent)) {
+			err = sync_fence_add_dup(dst, pt_a);
+			pos_a = pos_a->next;
+		} else if (!pt_a || pt_b->parent < pt_a->parent) {
+			err = sync_fence_add_dup(dst, pt_b);
+			pos_b = pos_b->next;
+		} else {
 			/* collapse two sync_pts on the same timeline
 			 * to a single sync_pt that will signal at
 			 * the later of the two
 			 */
-			if (dst_pt->parent == src_pt->parent) {
-				if (dst_pt->parent->ops->compare(dst_pt, src_pt)
-						 == -1) {
-					struct sync_pt *new_pt =
-						sync_pt_dup(src_pt);
-					if (new_pt == NULL)
-						return -ENOMEM;
-
-					new_pt->fence = dst;
-					list_replace(&dst_pt->pt_list,
-						     &new_pt->pt_list);
-					sync_pt_free(dst_pt);
-				}
-				collapsed = true;
-				break;
-			}
-		}
-
-		if (!collapsed) {
-			struct sync_pt *new_pt = sync_pt_dup(src_pt);
-
-			if (new_pt == NULL)
-				return -ENOMEM;
-
-			new_pt->fence = dst;
-			list_add(&new_pt->pt_list, &dst->pt_list_head);
+			if (pt_a->parent->ops->compare(pt_a, pt_b) == -1)
+				err = sync_fence_add_dup(dst, pt_b);
+			else
+				err = sync_fence_add_dup(dst, pt_a);
+			pos_a = pos_a->next;
+			pos_b = pos_b->next;
 		}
 	}
 
-	return 0;
+	return err;
 }
 
 static void sync_fence_detach_pts(struct sync_fence *fence)
@@ -452,17 +468,14 @@ struct sync_fence *sync_fence_merge(const char *name,
 {
 	struct sync_fence *fence;
 	struct list_head *pos;
+	ktime_t start = ktime_get();
 	int err;
 
 	fence = sync_fence_alloc(name);
 	if (fence == NULL)
 		return NULL;
 
-	err = sync_fence_copy_pts(fence, a);
-	if (err < 0)
-		goto err;
-
-	err = sync_fence_merge_pts(fence, b);
+	err = sync_fence_merge_pts(fence, a, b);
 	if (err < 0)
 		goto err;
 
@@ -480,6 +493,9 @@ struct sync_fence *sync_fence_merge(const char *name,
 					      struct sync_pt,
 					      pt_list));
 
+	atomic_inc(&sync_merge_count);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		     &sync_merge_ns);
 	return fence;
 err:
 	sync_fence_free_pts(fence);
@@ -939,6 +955,13 @@ static int sync_debugfs_show(struct seq_file *s, void *unused)
 	unsigned long flags;
 	struct list_head *pos;
 
+	seq_printf(s, "stats:\n--------------\n");
+	seq_printf(s, "merges %d, %lld ns\n", atomic_read(&sync_merge_count),
+		   (long long)atomic64_read(&sync_merge_ns));
+	seq_printf(s, "signals %d, %lld ns\n\n",
+		   atomic_read(&sync_signal_count),
+		   (long long)atomic64_read(&sync_signal_ns));
+
 	seq_printf(s, "objs:\n--------------\n");
 
 	spin_lock_irqsave(&sync_timeline_list_lock, flags);
@@ -0,0 +1,97 @@
+#undef TRACE_SYSTEM
+#define TRACE_INCLUDE_PATH ../../drivers/staging/android/trace
+#define TRACE_SYSTEM lowmemorykiller
+
+#if !defined(_TRACE_LOWMEMORYKILLER_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_LOWMEMORYKILLER_H
+
+#include <linux/sched.h>
+#include <linux/tracepoint.h>
+
+TRACE_EVENT(lmk_select,
+	TP_PROTO(struct task_struct *p, short oom_score_adj, int tasksize,
+		 short min_score_adj),
+
+	TP_ARGS(p, oom_score_adj, tasksize, min_score_adj),
+
+	TP_STRUCT__entry(
+			__field(pid_t, pid)
+			__array(char, comm, TASK_COMM_LEN)
+			__field(short, oom_score_adj)
+			__field(int, tasksize)
+			__field(short, min_score_adj)
+	),
+
+	TP_fast_assign(
+			__entry->pid = p->pid;
+			memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+			__entry->oom_score_adj = oom_score_adj;
+			__entry->tasksize = tasksize;
+			__entry->min_score_adj = min_score_adj;
+	),
+
+	TP_printk("pid=%d comm=%s adj=%hd size=%d min_adj=%hd",
+		  __entry->pid, __entry->comm, __entry->oom_score_adj,
+		  __entry->tasksize, __entry->min_score_adj)
+);
+
+TRACE_EVENT(lmk_kill,
+	TP_PROTO(struct task_struct *p, short oom_score_adj, int tasksize,
+		 int other_free, int other_file, int minfree),
+
+	TP_ARGS(p, oom_score_adj, tasksize, other_free, other_file, minfree),
+
+	TP_STRUCT__entry(
+			__field(pid_t, pid)
+			__array(char, comm, TASK_COMM_LEN)
+			__field(short, oom_score_adj)
+			__field(int, tasksize)
+			__field(int, other_free)
+			__field(int, other_file)
+			__field(int, minfree)
+	),
+
+	TP_fast_assign(
+			__entry->pid = p->pid;
+			memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+			__entry->oom_score_adj = oom_score_adj;
+			__entry->tasksize = tasksize;
+			__entry->other_free = other_free;
+			__entry->other_file = other_file;
+			__entry->minfree = minfree;
+	),
+
+	TP_printk("pid=%d comm=%s adj=%hd size=%d free=%d file=%d minfree=%d",
+		  __entry->pid, __entry->comm, __entry->oom_score_adj,
+		  __entry->tasksize, __entry->other_free, __entry->other_file,
+		  __entry->minfree)
+);
+
+TRACE_EVENT(lmk_reaped,
+	TP_PROTO(struct task_struct *p, short oom_score_adj, u64 latency_us),
+
+	TP_ARGS(p, oom_score_adj, latency_us),
+
+	TP_STRUCT__entry(
+			__field(pid_t, tgid)
+			__array(char, comm, TASK_COMM_LEN)
+			__field(short, oom_score_adj)
+			__field(u64, latency_us)
+	),
+
+	TP_fast_assign(
+			__entry->tgid = p->tgid;
+			memcpy(__entry->comm, p->comm, TASK_COMM_LEN);
+			__entry->oom_score_adj = oom_score_adj;
+			__entry->latency_us = latency_us;
+	),
+
+	TP_printk("tgid=%d comm=%s adj=%hd latency_us=%llu",
+		  __entry->tgid, __entry->comm, __entry->oom_score_adj,
+		  (unsigned long long)__entry->latency_us)
+);
+
+#endif /* _TRACE_LOWMEMORYKILLER_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -29,10 +29,17 @@
 #include <linux/genhd.h>
 #include <linux/highmem.h>
 #include <linux/slab.h>
-#include <linux/lzo.h>
 #include <linux/string.h>
 #include <linux/vmalloc.h>
 #include <linux/ratelimit.h>
+#include <linux/err.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/workqueue.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
+#include <linux/cpu.h>
+#include <linux/ktime.h>
 
 #include "zram_drv.h"
 
@@ -49,6 +56,12 @@ static struct zram *zram_devices;
 /* Module params (documentation at end) */
 static unsigned int num_devices = 1;
 
+#ifdef CONFIG_ZRAM_LZ4_COMPRESS
+#define ZRAM_COMPRESSOR_DEFAULT "lz4"
+#else
+#define ZRAM_COMPRESSOR_DEFAULT "lzo"
+#endif
+
 static inline struct zram *dev_to_zram(struct device *dev)
 {
 	return (struct zram *)dev_to_disk(dev)->private_data;
@@ -111,7 +124,15 @@ static ssize_t zero_pages_show(struct device *dev,
 {
 	struct zram *zram = dev_to_zram(dev);
 
-	return sprintf(buf, "%u\n", zram->stats.pages_zero);
+	return sprintf(buf, "%u\n", atomic_read(&zram->stats.pages_zero));
+}
+
+static ssize_t same_pages_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return sprintf(buf, "%u\n", atomic_read(&zram->stats.pages_same));
 }
 
 static ssize_t orig_data_size_show(struct device *dev,
@@ -120,7 +141,7 @@ static ssize_t orig_data_size_show(struct device *dev,
 	struct zram *zram = dev_to_zram(dev);
 
 	return sprintf(buf, "%llu\n",
-		(u64)(zram->stats.pages_stored) << PAGE_SHIFT);
+		(u64)(atomic_read(&zram->stats.pages_stored)) << PAGE_SHIFT);
 }
 
 static ssize_t compr_data_size_show(struct device *dev,
@@ -147,6 +168,119 @@ static ssize_t mem_used_total_show(struct device *dev,
 	return sprintf(buf, "%llu\n", val);
 }
 
+static ssize_t compact_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	zs_compact(zram->meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t pages_compacted_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	unsigned long val = 0;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	if (zram->init_done)
+		val = zs_get_pages_compacted(zram->meta->mem_pool);
+	up_read(&zram->init_lock);
+
+	return sprintf(buf, "%lu\n", val);
+}
+
+static ssize_t max_comp_streams_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	int val;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	val = zram->max_comp_streams;
+	up_read(&zram->init_lock);
+
+	return sprintf(buf, "%d\n", val);
+}
+
+static ssize_t max_comp_streams_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	int num;
+	struct zram *zram = dev_to_zram(dev);
+	int ret;
+
+	ret = kstrtoint(buf, 0, &num);
+	if (ret < 0)
+		return ret;
+	if (num < 1)
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		if (!zcomp_set_max_streams(zram->comp, num)) {
+			pr_info("Cannot change max compression streams\n");
+			ret = -EINVAL;
+			goto out;
+		}
+	}
+
+	zram->max_comp_streams = num;
+	ret = len;
+out:
+	up_write(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t comp_algorithm_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	size_t sz;
+	struct zram *zram = dev_to_zram(dev);
+
+	down_read(&zram->init_lock);
+	sz = zcomp_available_show(zram->compressor, buf);
+	up_read(&zram->init_lock);
+
+	return sz;
+}
+
+static ssize_t comp_algorithm_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char compressor[sizeof(zram->compressor)];
+	size_t sz;
+
+	strlcpy(compressor, buf, sizeof(compressor));
+	/* ignore trailing newline */
+	sz = strlen(compressor);
+	if (sz > 0 && compressor[sz - 1] == '\n')
+		compressor[sz - 1] = 0x00;
+
+	if (!zcomp_available_algorithm(compressor))
+		return -EINVAL;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		up_write(&zram->init_lock);
+		pr_info("Can't change algorithm for initialized device\n");
+		return -EBUSY;
+	}
+	strlcpy(zram->compressor, compressor, sizeof(compressor));
+	up_write(&zram->init_lock);
+	return len;
+}
+
 static int zram_test_flag(struct zram_meta *meta, u32 index,
 			enum zram_pageflags flag)
 {
@@ -197,8 +331,9 @@ static inline int valid_io_request(struct zram *zram, struct bio *bio)
 static void zram_meta_free(struct zram_meta *meta)
 {
 	zs_destroy_pool(meta->mem_pool);
-	kfree(meta->compress_workmem);
-	free_pages((unsigned long)meta->compress_buffer, 1);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	vfree(meta->idle_map);
+#endif
 	vfree(meta->table);
 	kfree(meta);
 }
@@ -210,39 +345,37 @@ static struct zram_meta *zram_meta_alloc(u64 disksize)
 	if (!meta)
 		goto out;
 
-	meta->compress_workmem = kzalloc(LZO1X_MEM_COMPRESS, GFP_KERNEL);
-	if (!meta->compress_workmem)
-		goto free_meta;
-
-	meta->compress_buffer =
-		(void *)__get_free_pages(GFP_KERNEL | __GFP_ZERO, 1);
-	if (!meta->compress_buffer) {
-		pr_err("Error allocating compressor buffer space\n");
-		goto free_workmem;
-	}
-
 	num_pages = disksize >> PAGE_SHIFT;
 	meta->table = vzalloc(num_pages * sizeof(*meta->table));
 	if (!meta->table) {
 		pr_err("Error allocating zram address table\n");
-		goto free_buffer;
+		goto free_meta;
 	}
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+	meta->idle_map = vzalloc(BITS_TO_LONGS(num_pages) * sizeof(long));
+	if (!meta->idle_map) {
+		pr_err("Error allocating zram idle map\n");
+		goto free_table;
+	}
+#endif
+
 	meta->mem_pool = zs_create_pool(GFP_NOIO | __GFP_HIGHMEM |
 					__GFP_NOWARN);
 	if (!meta->mem_pool) {
 		pr_err("Error creating memory pool\n");
-		goto free_table;
+		goto free_idle_map;
 	}
 
+	rwlock_init(&meta->tb_lock);
 	return meta;
 
+free_idle_map:
+#ifdef CONFIG_ZRAM_WRITEBACK
+	vfree(meta->idle_map);
+#endif
 free_table:
 	vfree(meta->table);
-free_buffer:
-	free_pages((unsigned long)meta->compress_buffer, 1);
-free_workmem:
-	kfree(meta->compress_workmem);
 free_meta:
 	kfree(meta);
 	meta = NULL;
@@ -257,92 +390,455 @@ static void update_position(u32 *index, int *offset, struct bio_vec *bvec)
 	*offset = (*offset + bvec->bv_len) % PAGE_SIZE;
 }
 
-static int page_zero_filled(void *ptr)
+/*
+ * Check whether the page is one machine word repeated throughout; if so,
+ * return that word in *element.
+ */
+static int page_same_filled(void *ptr, unsigned long *element)
 {
 	unsigned int pos;
 	unsigned long *page;
+	unsigned long val;
 
 	page = (unsigned long *)ptr;
+	val = page[0];
 
-	for (pos = 0; pos != PAGE_SIZE / sizeof(*page); pos++) {
-		if (page[pos])
+	for (pos = 1; pos != PAGE_SIZE / sizeof(*page); pos++) {
+		if (page[pos] != val)
 			return 0;
 	}
 
+	*element = val;
 	return 1;
 }
 
-static void handle_zero_page(struct bio_vec *bvec)
+static void zram_fill_page(void *ptr, unsigned long len,
+			   unsigned long value)
+{
+	unsigned long *page = ptr;
+	unsigned long pos;
+
+	WARN_ON_ONCE(!IS_ALIGNED(len, sizeof(unsigned long)));
+	if (likely(value == 0)) {
+		memset(ptr, 0, len);
+	} else {
+		for (pos = 0; pos < len / sizeof(*page); pos++)
+			page[pos] = value;
+	}
+}
+
+static void handle_same_page(struct bio_vec *bvec, unsigned long element)
 {
 	struct page *page = bvec->bv_page;
 	void *user_mem;
 
 	user_mem = kmap_atomic(page);
 	if (is_partial_io(bvec))
-		memset(user_mem + bvec->bv_offset, 0, bvec->bv_len);
-	else
+		zram_fill_page(user_mem + bvec->bv_offset, bvec->bv_len,
+				element);
+	else if (!element)
 		clear_page(user_mem);
+	else
+		zram_fill_page(user_mem, PAGE_SIZE, element);
 	kunmap_atomic(user_mem);
 
 	flush_dcache_page(page);
 }
 
+#ifdef CONFIG_ZRAM_WRITEBACK
+static void zram_clear_idle(struct zram_meta *meta, u32 index)
+{
+	clear_bit(index, meta->idle_map);
+}
+
+static void reset_bdev(struct zram *zram)
+{
+	if (!zram->backing_dev)
+		return;
+
+	blkdev_put(zram->bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+	filp_close(zram->backing_dev, NULL);
+	zram->backing_dev = NULL;
+	zram->bdev = NULL;
+
+	vfree(zram->bitmap);
+	zram->bitmap = NULL;
+	zram->nr_pages = 0;
+}
+
+static ssize_t backing_dev_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+	char *p;
+	ssize_t ret;
+
+	down_read(&zram->init_lock);
+	if (!zram->backing_dev) {
+		memcpy(buf, "none\n", 5);
+		up_read(&zram->init_lock);
+		return 5;
+	}
+
+	p = d_path(&zram->backing_dev->f_path, buf, PAGE_SIZE - 1);
+	if (IS_ERR(p)) {
+		ret = PTR_ERR(p);
+		goto out;
+	}
+
+	ret = strlen(p);
+	memmove(buf, p, ret);
+	buf[ret++] = '\n';
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t backing_dev_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	char *file_name;
+	size_t sz;
+	struct file *backing_dev = NULL;
+	struct inode *inode;
+	struct block_device *bdev = NULL;
+	unsigned long nr_pages, *bitmap = NULL;
+	int err;
+	struct zram *zram = dev_to_zram(dev);
+
+	file_name = kmalloc(PATH_MAX, GFP_KERNEL);
+	if (!file_name)
+		return -ENOMEM;
+
+	down_write(&zram->init_lock);
+	if (zram->init_done) {
+		pr_info("Can't setup backing device for initialized device\n");
+		err = -EBUSY;
+		goto out;
+	}
+
+	strlcpy(file_name, buf, PATH_MAX);
+	/* ignore trailing newline */
+	sz = strlen(file_name);
+	if (sz > 0 && file_name[sz - 1] == '\n')
+		file_name[sz - 1] = 0x00;
+
+	backing_dev = filp_open(file_name, O_RDWR | O_LARGEFILE, 0);
+	if (IS_ERR(backing_dev)) {
+		err = PTR_ERR(backing_dev);
+		backing_dev = NULL;
+		goto out;
+	}
+
+	inode = backing_dev->f_mapping->host;
+
+	/* Support only block device in this moment */
+	if (!S_ISBLK(inode->i_mode)) {
+		err = -ENOTBLK;
+		goto out;
+	}
+
+	bdev = bdgrab(I_BDEV(inode));
+	err = blkdev_get(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL, zram);
+	if (err < 0) {
+		/* blkdev_get() drops the reference on failure */
+		bdev = NULL;
+		goto out;
+	}
+
+	nr_pages = i_size_read(inode) >> PAGE_SHIFT;
+	bitmap = vzalloc(BITS_TO_LONGS(nr_pages) * sizeof(long));
+	if (!bitmap) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	reset_bdev(zram);
+
+	zram->bdev = bdev;
+	zram->backing_dev = backing_dev;
+	zram->bitmap = bitmap;
+	zram->nr_pages = nr_pages;
+	up_write(&zram->init_lock);
+
+	pr_info("setup backing device %s\n", file_name);
+	kfree(file_name);
+
+	return len;
+out:
+	if (bdev)
+		blkdev_put(bdev, FMODE_READ | FMODE_WRITE | FMODE_EXCL);
+
+	if (backing_dev)
+		filp_close(backing_dev, NULL);
+
+	up_write(&zram->init_lock);
+	kfree(file_name);
+
+	return err;
+}
+
+/*
+ * Block 0 of the backing device is never handed out, so that an
+ * element of 0 is never a valid block number.
+ */
+static unsigned long alloc_block_bdev(struct zram *zram)
+{
+	unsigned long blk_idx = 1;
+retry:
+	blk_idx = find_next_zero_bit(zram->bitmap, zram->nr_pages, blk_idx);
+	if (blk_idx >= zram->nr_pages)
+		return 0;
+
+	if (test_and_set_bit(blk_idx, zram->bitmap))
+		goto retry;
+
+	atomic64_inc(&zram->stats.bd_count);
+	return blk_idx;
+}
+
+static void free_block_bdev(struct zram *zram, unsigned long blk_idx)
+{
+	int was_set;
+
+	was_set = test_and_clear_bit(blk_idx, zram->bitmap);
+	WARN_ON_ONCE(!was_set);
+	atomic64_dec(&zram->stats.bd_count);
+}
+
+/* Synchronous single page I/O against the backing device */
+static int zram_bdev_rw(struct zram *zram, int rw, struct page *page,
+			unsigned long blk)
+{
+	struct bio *bio;
+	int ret;
+
+	bio = bio_alloc(GFP_NOIO, 1);
+	if (!bio)
+		return -ENOMEM;
+
+	bio->bi_sector = blk * (PAGE_SIZE >> SECTOR_SHIFT);
+	bio->bi_bdev = zram->bdev;
+	if (!bio_add_page(bio, page, PAGE_SIZE, 0)) {
+		bio_put(bio);
+		return -EIO;
+	}
+
+	ret = submit_bio_wait(rw, bio);
+	bio_put(bio);
+
+	if (rw == READ)
+		atomic64_inc(&zram->stats.bd_reads);
+	else
+		atomic64_inc(&zram->stats.bd_writes);
+	return ret;
+}
+
+struct zram_work {
+	struct work_struct work;
+	struct zram *zram;
+	unsigned long entry;
+	struct page *page;
+	int error;
+};
+
+static void zram_sync_read(struct work_struct *work)
+{
+	struct zram_work *zw = container_of(work, struct zram_work, work);
+
+	zw->error = zram_bdev_rw(zw->zram, READ, zw->page, zw->entry);
+}
+
+/*
+ * Bios submitted from zram_make_request() are only dispatched once it
+ * returns (see current->bio_list in generic_make_request()), so waiting
+ * for one there would deadlock. Issue the read from a worker instead.
+ */
+static int read_from_bdev_sync(struct zram *zram, struct page *page,
+			       unsigned long entry)
+{
+	struct zram_work work;
+
+	work.page = page;
+	work.zram = zram;
+	work.entry = entry;
+
+	INIT_WORK_ONSTACK(&work.work, zram_sync_read);
+	queue_work(system_unbound_wq, &work.work);
+	flush_work(&work.work);
+	destroy_work_on_stack(&work.work);
+
+	return work.error;
+}
+
+/* Read a written back slot into a kernel buffer */
+static int zram_bdev_read_buf(struct zram *zram, char *mem,
+			      unsigned long entry)
+{
+	struct page *page;
+	void *src;
+	int ret;
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = read_from_bdev_sync(zram, page, entry);
+	if (!ret) {
+		src = kmap_atomic(page);
+		copy_page(mem, src);
+		kunmap_atomic(src);
+	}
+	__free_page(page);
+	return ret;
+}
+
+/* Read a written back slot into the bio_vec */
+static int zram_bdev_read_bvec(struct zram *zram, struct bio_vec *bvec,
+			       unsigned long entry, int offset)
+{
+	struct page *page;
+	void *src, *dst;
+	int ret;
+
+	if (!is_partial_io(bvec)) {
+		ret = read_from_bdev_sync(zram, bvec->bv_page, entry);
+		if (!ret)
+			flush_dcache_page(bvec->bv_page);
+		return ret;
+	}
+
+	page = alloc_page(GFP_NOIO);
+	if (!page)
+		return -ENOMEM;
+
+	ret = read_from_bdev_sync(zram, page, entry);
+	if (!ret) {
+		src = kmap_atomic(page);
+		dst = kmap_atomic(bvec->bv_page);
+		memcpy(dst + bvec->bv_offset, src + offset, bvec->bv_len);
+		kunmap_atomic(dst);
+		kunmap_atomic(src);
+		flush_dcache_page(bvec->bv_page);
+	}
+	__free_page(page);
+	return ret;
+}
+
+#else
+static inline void zram_clear_idle(struct zram_meta *meta, u32 index) {}
+static inline void reset_bdev(struct zram *zram) {}
+static inline void free_block_bdev(struct zram *zram, unsigned long blk) {}
+
+static int zram_bdev_read_buf(struct zram *zram, char *mem,
+			      unsigned long entry)
+{
+	return -EIO;
+}
+
+static int zram_bdev_read_bvec(struct zram *zram, struct bio_vec *bvec,
+			       unsigned long entry, int offset)
+{
+	return -EIO;
+}
+#endif
+
+/* NOTE: caller should hold meta->tb_lock with write-side */
 static void zram_free_page(struct zram *zram, size_t index)
 {
 	struct zram_meta *meta = zram->meta;
 	unsigned long handle = meta->table[index].handle;
 	u16 size = meta->table[index].size;
 
-	if (unlikely(!handle)) {
-		/*
-		 * No memory is allocated for zero filled pages.
-		 * Simply clear zero page flag.
-		 */
-		if (zram_test_flag(meta, index, ZRAM_ZERO)) {
-			zram_clear_flag(meta, index, ZRAM_ZERO);
-			zram->stats.pages_zero--;
-		}
+	zram_clear_idle(meta, index);
+	zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+	zram_clear_flag(meta, index, ZRAM_HUGE);
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		zram_clear_flag(meta, index, ZRAM_WB);
+		free_block_bdev(zram, meta->table[index].element);
+		meta->table[index].element = 0;
+		return;
+	}
+
+	/*
+	 * No memory is allocated for same element filled pages.
+	 * Simply clear same page flag.
+	 */
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		zram_clear_flag(meta, index, ZRAM_SAME);
+		if (!meta->table[index].element)
+			atomic_dec(&zram->stats.pages_zero);
+		atomic_dec(&zram->stats.pages_same);
+		meta->table[index].element = 0;
 		return;
 	}
 
+	if (unlikely(!handle))
+		return;
+
 	if (unlikely(size > max_zpage_size))
-		zram->stats.bad_compress--;
+		atomic_dec(&zram->stats.bad_compress);
 
 	zs_free(meta->mem_pool, handle);
 
 	if (size <= PAGE_SIZE / 2)
-		zram->stats.good_compress--;
+		atomic_dec(&zram->stats.good_compress);
 
 	atomic64_sub(meta->table[index].size, &zram->stats.compr_size);
-	zram->stats.pages_stored--;
+	atomic_dec(&zram->stats.pages_stored);
 
 	meta->table[index].handle = 0;
 	meta->table[index].size = 0;
 }
 
-static int zram_decompress_page(struct zram *zram, char *mem, u32 index)
+/*
+ * Returns -EAGAIN with the block number in *blk if the slot lives on the
+ * backing device; the caller has to read it from there.
+ */
+static int zram_decompress_page(struct zram *zram, char *mem, u32 index,
+				unsigned long *blk)
 {
-	int ret = LZO_E_OK;
-	size_t clen = PAGE_SIZE;
+	int ret = 0;
 	unsigned char *cmem;
 	struct zram_meta *meta = zram->meta;
-	unsigned long handle = meta->table[index].handle;
+	unsigned long handle;
+	u16 size;
+
+	read_lock(&meta->tb_lock);
+	handle = meta->table[index].handle;
+	size = meta->table[index].size;
 
-	if (!handle || zram_test_flag(meta, index, ZRAM_ZERO)) {
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		unsigned long element = meta->table[index].element;
+
+		read_unlock(&meta->tb_lock);
+		zram_fill_page(mem, PAGE_SIZE, element);
+		return 0;
+	}
+
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		*blk = meta->table[index].element;
+		read_unlock(&meta->tb_lock);
+		return -EAGAIN;
+	}
+
+	if (!handle) {
+		read_unlock(&meta->tb_lock);
 		clear_page(mem);
 		return 0;
 	}
 
 	cmem = zs_map_object(meta->mem_pool, handle, ZS_MM_RO);
-	if (meta->table[index].size == PAGE_SIZE)
+	if (size == PAGE_SIZE)
 		copy_page(mem, cmem);
 	else
-		ret = lzo1x_decompress_safe(cmem, meta->table[index].size,
-						mem, &clen);
+		ret = zcomp_decompress(zram->comp, cmem, size, mem);
 	zs_unmap_object(meta->mem_pool, handle);
+	read_unlock(&meta->tb_lock);
 
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Decompression failed! err=%d, page=%u\n", ret, index);
 		atomic64_inc(&zram->stats.failed_reads);
 		return ret;
@@ -358,13 +854,29 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 	struct page *page;
 	unsigned char *user_mem, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
+	unsigned long blk;
 	page = bvec->bv_page;
 
-	if (unlikely(!meta->table[index].handle) ||
-			zram_test_flag(meta, index, ZRAM_ZERO)) {
-		handle_zero_page(bvec);
+	read_lock(&meta->tb_lock);
+	zram_clear_idle(meta, index);
+	if (zram_test_flag(meta, index, ZRAM_SAME)) {
+		unsigned long element = meta->table[index].element;
+
+		read_unlock(&meta->tb_lock);
+		handle_same_page(bvec, element);
 		return 0;
 	}
+	if (zram_test_flag(meta, index, ZRAM_WB)) {
+		blk = meta->table[index].element;
+		read_unlock(&meta->tb_lock);
+		return zram_bdev_read_bvec(zram, bvec, blk, offset);
+	}
+	if (unlikely(!meta->table[index].handle)) {
+		read_unlock(&meta->tb_lock);
+		handle_same_page(bvec, 0);
+		return 0;
+	}
+	read_unlock(&meta->tb_lock);
 
 	if (is_partial_io(bvec))
 		/* Use  a temporary buffer to decompress the page */
@@ -380,9 +892,9 @@ static int zram_bvec_read(struct zram *zram, struct bio_vec *bvec,
 		goto out_cleanup;
 	}
 
-	ret = zram_decompress_page(zram, uncmem, index);
+	ret = zram_decompress_page(zram, uncmem, index, &blk);
 	/* Should NEVER happen. Return bio error if it does. */
-	if (unlikely(ret != LZO_E_OK))
+	if (unlikely(ret))
 		goto out_cleanup;
 
 	if (is_partial_io(bvec))
@@ -395,6 +907,9 @@ out_cleanup:
 	kunmap_atomic(user_mem);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
+	/* written back since we looked; we can sleep now, read it back */
+	if (unlikely(ret == -EAGAIN))
+		ret = zram_bdev_read_bvec(zram, bvec, blk, offset);
 	return ret;
 }
 
@@ -403,14 +918,14 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 {
 	int ret = 0;
 	size_t clen;
-	unsigned long handle;
+	unsigned long handle, element, blk;
 	struct page *page;
 	unsigned char *user_mem, *cmem, *src, *uncmem = NULL;
 	struct zram_meta *meta = zram->meta;
+	struct zcomp_strm *zstrm = NULL;
 	static unsigned long zram_rs_time;
 
 	page = bvec->bv_page;
-	src = meta->compress_buffer;
 
 	if (is_partial_io(bvec)) {
 		/*
@@ -422,11 +937,15 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 			ret = -ENOMEM;
 			goto out;
 		}
-		ret = zram_decompress_page(zram, uncmem, index);
+		ret = zram_decompress_page(zram, uncmem, index, &blk);
+		if (ret == -EAGAIN)
+			ret = zram_bdev_read_buf(zram, uncmem, blk);
 		if (ret)
 			goto out;
 	}
 
+	/* may sleep, so pick a stream before mapping the page */
+	zstrm = zcomp_strm_find(zram->comp);
 	user_mem = kmap_atomic(page);
 
 	if (is_partial_io(bvec)) {
@@ -438,27 +957,24 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = user_mem;
 	}
 
-	if (page_zero_filled(uncmem)) {
-		kunmap_atomic(user_mem);
+	if (page_same_filled(uncmem, &element)) {
+		if (user_mem)
+			kunmap_atomic(user_mem);
 		/* Free memory associated with this sector now. */
+		write_lock(&meta->tb_lock);
 		zram_free_page(zram, index);
+		zram_set_flag(meta, index, ZRAM_SAME);
+		meta->table[index].element = element;
+		write_unlock(&meta->tb_lock);
 
-		zram->stats.pages_zero++;
-		zram_set_flag(meta, index, ZRAM_ZERO);
+		atomic_inc(&zram->stats.pages_same);
+		if (!element)
+			atomic_inc(&zram->stats.pages_zero);
 		ret = 0;
 		goto out;
 	}
 
-	/*
-	 * zram_slot_free_notify could miss free so that let's
-	 * double check.
-	 */
-	if (unlikely(meta->table[index].handle ||
-			zram_test_flag(meta, index, ZRAM_ZERO)))
-		zram_free_page(zram, index);
-
-	ret = lzo1x_1_compress(uncmem, PAGE_SIZE, src, &clen,
-			       meta->compress_workmem);
+	ret = zcomp_compress(zram->comp, zstrm, uncmem, &clen);
 
 	if (!is_partial_io(bvec)) {
 		kunmap_atomic(user_mem);
@@ -466,13 +982,14 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		uncmem = NULL;
 	}
 
-	if (unlikely(ret != LZO_E_OK)) {
+	if (unlikely(ret)) {
 		pr_err("Compression failed! err=%d\n", ret);
 		goto out;
 	}
+	src = zstrm->buffer;
 
 	if (unlikely(clen > max_zpage_size)) {
-		zram->stats.bad_compress++;
+		atomic_inc(&zram->stats.bad_compress);
 		clen = PAGE_SIZE;
 		src = NULL;
 		if (is_partial_io(bvec))
@@ -498,24 +1015,32 @@ static int zram_bvec_write(struct zram *zram, struct bio_vec *bvec, u32 index,
 		memcpy(cmem, src, clen);
 	}
 
+	zcomp_strm_release(zram->comp, zstrm);
+	zstrm = NULL;
 	zs_unmap_object(meta->mem_pool, handle);
 
 	/*
 	 * Free memory associated with this sector
 	 * before overwriting unused sectors.
 	 */
+	write_lock(&meta->tb_lock);
 	zram_free_page(zram, index);
 
 	meta->table[index].handle = handle;
 	meta->table[index].size = clen;
+	if (clen > huge_zpage_size)
+		zram_set_flag(meta, index, ZRAM_HUGE);
+	write_unlock(&meta->tb_lock);
 
 	/* Update stats */
 	atomic64_add(clen, &zram->stats.compr_size);
-	zram->stats.pages_stored++;
+	atomic_inc(&zram->stats.pages_stored);
 	if (clen <= PAGE_SIZE / 2)
-		zram->stats.good_compress++;
+		atomic_inc(&zram->stats.good_compress);
 
 out:
+	if (zstrm)
+		zcomp_strm_release(zram->comp, zstrm);
 	if (is_partial_io(bvec))
 		kfree(uncmem);
 
@@ -524,46 +1049,470 @@ out:
 	return ret;
 }
 
-static void handle_pending_slot_free(struct zram *zram)
-{
-	struct zram_slot_free *free_rq;
-
-	spin_lock(&zram->slot_free_lock);
-	while (zram->slot_free_rq) {
-		free_rq = zram->slot_free_rq;
-		zram->slot_free_rq = free_rq->next;
-		zram_free_page(zram, free_rq->index);
-		kfree(free_rq);
-	}
-	spin_unlock(&zram->slot_free_lock);
-}
-
 static int zram_bvec_rw(struct zram *zram, struct bio_vec *bvec, u32 index,
 			int offset, struct bio *bio, int rw)
 {
 	int ret;
 
-	if (rw == READ) {
-		down_read(&zram->lock);
-		handle_pending_slot_free(zram);
+	if (rw == READ)
 		ret = zram_bvec_read(zram, bvec, index, offset, bio);
-		up_read(&zram->lock);
-	} else {
-		down_write(&zram->lock);
-		handle_pending_slot_free(zram);
+	else
 		ret = zram_bvec_write(zram, bvec, index, offset);
-		up_write(&zram->lock);
+
+	return ret;
+}
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static bool zram_wb_candidate(struct zram_meta *meta, u32 index,
+			      enum zram_wb_mode mode)
+{
+	if (!meta->table[index].handle ||
+	    zram_test_flag(meta, index, ZRAM_SAME) ||
+	    zram_test_flag(meta, index, ZRAM_WB) ||
+	    zram_test_flag(meta, index, ZRAM_UNDER_WB))
+		return false;
+
+	if (mode == ZRAM_WB_IDLE)
+		return test_bit(index, meta->idle_map);
+	return zram_test_flag(meta, index, ZRAM_HUGE);
+}
+
+static void zram_writeback_work(struct work_struct *work)
+{
+	struct zram *zram = container_of(work, struct zram, wb_work);
+	struct zram_meta *meta;
+	unsigned long nr_pages, index, blk, unused;
+	struct page *page;
+	int ret;
+
+	page = alloc_page(GFP_KERNEL);
+	if (!page)
+		return;
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done || !zram->backing_dev)
+		goto out;
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	for (index = 0; index < nr_pages; index++) {
+		write_lock(&meta->tb_lock);
+		if (!zram_wb_candidate(meta, index, zram->wb_mode)) {
+			write_unlock(&meta->tb_lock);
+			continue;
+		}
+		zram_set_flag(meta, index, ZRAM_UNDER_WB);
+		write_unlock(&meta->tb_lock);
+
+		blk = alloc_block_bdev(zram);
+		if (!blk) {
+			write_lock(&meta->tb_lock);
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			write_unlock(&meta->tb_lock);
+			break;
+		}
+
+		ret = zram_decompress_page(zram, page_address(page), index,
+				&unused);
+		if (!ret)
+			ret = zram_bdev_rw(zram, WRITE, page, blk);
+
+		write_lock(&meta->tb_lock);
+		/*
+		 * The slot may have been freed or rewritten while we were
+		 * at it, in which case ZRAM_UNDER_WB is gone and the copy
+		 * on the backing device is stale.
+		 */
+		if (ret || !zram_test_flag(meta, index, ZRAM_UNDER_WB)) {
+			zram_clear_flag(meta, index, ZRAM_UNDER_WB);
+			write_unlock(&meta->tb_lock);
+			free_block_bdev(zram, blk);
+			continue;
+		}
+
+		zram_free_page(zram, index);
+		zram_set_flag(meta, index, ZRAM_WB);
+		meta->table[index].element = blk;
+		write_unlock(&meta->tb_lock);
+
+		cond_resched();
+	}
+out:
+	up_read(&zram->init_lock);
+	__free_page(page);
+}
+
+static ssize_t idle_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	struct zram_meta *meta;
+	unsigned long nr_pages, index;
+
+	if (!sysfs_streq(buf, "all"))
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		up_read(&zram->init_lock);
+		return -EINVAL;
+	}
+
+	meta = zram->meta;
+	nr_pages = zram->disksize >> PAGE_SHIFT;
+	read_lock(&meta->tb_lock);
+	for (index = 0; index < nr_pages; index++) {
+		if (meta->table[index].handle &&
+		    !zram_test_flag(meta, index, ZRAM_SAME) &&
+		    !zram_test_flag(meta, index, ZRAM_WB))
+			set_bit(index, meta->idle_map);
+	}
+	read_unlock(&meta->tb_lock);
+	up_read(&zram->init_lock);
+
+	return len;
+}
+
+static ssize_t writeback_store(struct device *dev,
+		struct device_attribute *attr, const char *buf, size_t len)
+{
+	struct zram *zram = dev_to_zram(dev);
+	enum zram_wb_mode mode;
+	ssize_t ret = len;
+
+	if (sysfs_streq(buf, "idle"))
+		mode = ZRAM_WB_IDLE;
+	else if (sysfs_streq(buf, "huge"))
+		mode = ZRAM_WB_HUGE;
+	else
+		return -EINVAL;
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	if (!zram->backing_dev) {
+		ret = -ENODEV;
+		goto out;
+	}
+
+	/* Only one pass at a time; the work item runs asynchronously */
+	if (work_busy(&zram->wb_work)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	zram->wb_mode = mode;
+	queue_work(system_unbound_wq, &zram->wb_work);
+out:
+	up_read(&zram->init_lock);
+	return ret;
+}
+
+static ssize_t bd_stat_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct zram *zram = dev_to_zram(dev);
+
+	return scnprintf(buf, PAGE_SIZE, "%8llu %8llu %8llu\n",
+			(u64)atomic64_read(&zram->stats.bd_count),
+			(u64)atomic64_read(&zram->stats.bd_reads),
+			(u64)atomic64_read(&zram->stats.bd_writes));
+}
+#endif
+
+#ifdef CONFIG_ZRAM_BENCH
+/*
+ * Benchmark on a corpus of real page dumps written to
+ * <debugfs>/zram_bench/corpus. Reading zram_bench/zram<id> stores the
+ * corpus in slots 0..n of that (empty, unused) device through the
+ * normal bvec path on each online CPU in turn, reads it back, and
+ * frees the slots again.
+ */
+#define ZRAM_BENCH_MAX_PAGES	16384
+
+static DEFINE_MUTEX(zram_bench_lock);
+static struct dentry *zram_bench_dir;
+static struct page **zram_bench_corpus;
+static unsigned long zram_bench_pages;
+static size_t zram_bench_bytes;
+
+struct zram_bench_run {
+	struct zram *zram;
+	struct page *scratch;
+	u64 write_ns;
+	u64 read_ns;
+	bool verify;
+	unsigned long mismatches;
+	unsigned long errors;
+};
+
+static void zram_bench_free_corpus(void)
+{
+	unsigned long i;
+
+	for (i = 0; i < zram_bench_pages; i++)
+		__free_page(zram_bench_corpus[i]);
+	zram_bench_pages = 0;
+	zram_bench_bytes = 0;
+}
+
+static long zram_bench_cpu(void *data)
+{
+	struct zram_bench_run *run = data;
+	struct zram *zram = run->zram;
+	struct bio_vec bv;
+	unsigned long i;
+	void *src, *dst;
+	u64 start;
+
+	bv.bv_len = PAGE_SIZE;
+	bv.bv_offset = 0;
+
+	start = ktime_to_ns(ktime_get());
+	for (i = 0; i < zram_bench_pages; i++) {
+		bv.bv_page = zram_bench_corpus[i];
+		if (zram_bvec_rw(zram, &bv, i, 0, NULL, WRITE))
+			run->errors++;
+	}
+	run->write_ns = ktime_to_ns(ktime_get()) - start;
+
+	bv.bv_page = run->scratch;
+	start = ktime_to_ns(ktime_get());
+	for (i = 0; i < zram_bench_pages; i++)
+		if (zram_bvec_rw(zram, &bv, i, 0, NULL, READ))
+			run->errors++;
+	run->read_ns = ktime_to_ns(ktime_get()) - start;
+
+	/* Check the round trip in a separate, untimed pass */
+	for (i = 0; run->verify && i < zram_bench_pages; i++) {
+		if (zram_bvec_rw(zram, &bv, i, 0, NULL, READ))
+			continue;
+		src = kmap_atomic(zram_bench_corpus[i]);
+		dst = kmap_atomic(run->scratch);
+		if (memcmp(src, dst, PAGE_SIZE))
+			run->mismatches++;
+		kunmap_atomic(dst);
+		kunmap_atomic(src);
 	}
 
+	return 0;
+}
+
+static void zram_bench_free_slots(struct zram *zram)
+{
+	unsigned long i;
+
+	write_lock(&zram->meta->tb_lock);
+	for (i = 0; i < zram_bench_pages; i++)
+		zram_free_page(zram, i);
+	write_unlock(&zram->meta->tb_lock);
+}
+
+static u64 zram_bench_mibps(u64 bytes, u64 ns)
+{
+	return ns ? div64_u64(bytes * NSEC_PER_SEC, ns) >> 20 : 0;
+}
+
+static int zram_bench_show(struct seq_file *s, void *unused)
+{
+	struct zram *zram = s->private;
+	struct zram_bench_run run;
+	struct block_device *bdev;
+	u64 bytes, compr, used;
+	unsigned int same;
+	bool first = true;
+	int cpu, ret = 0;
+
+	mutex_lock(&zram_bench_lock);
+	if (!zram_bench_pages) {
+		seq_puts(s, "no corpus\n");
+		goto out_unlock;
+	}
+	bytes = (u64)zram_bench_pages << PAGE_SHIFT;
+
+	bdev = bdget_disk(zram->disk, 0);
+	if (!bdev) {
+		ret = -ENODEV;
+		goto out_unlock;
+	}
+
+	down_read(&zram->init_lock);
+	if (!zram->init_done || zram->disksize < bytes) {
+		seq_puts(s, "device not initialized or smaller than corpus\n");
+		goto out;
+	}
+	/* The slots are overwritten, so only bench an idle, empty device */
+	if (bdev->bd_openers || atomic_read(&zram->stats.pages_stored) ||
+	    atomic_read(&zram->stats.pages_same)) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	memset(&run, 0, sizeof(run));
+	run.zram = zram;
+	run.scratch = alloc_page(GFP_KERNEL);
+	if (!run.scratch) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	seq_printf(s, "%s: %s, %lu pages\n", zram->disk->disk_name,
+		   zram->compressor, zram_bench_pages);
+
+	get_online_cpus();
+	for_each_online_cpu(cpu) {
+		run.write_ns = run.read_ns = 0;
+		run.verify = first;
+		work_on_cpu(cpu, zram_bench_cpu, &run);
+
+		if (first) {
+			first = false;
+			compr = atomic64_read(&zram->stats.compr_size);
+			same = atomic_read(&zram->stats.pages_same);
+			used = zs_get_total_size_bytes(zram->meta->mem_pool);
+			seq_printf(s, "ratio %llu.%02llu, %llu KiB compressed, "
+				   "%u same-filled pages\n",
+				   div64_u64(bytes, compr ?: 1),
+				   div64_u64(bytes * 100, compr ?: 1) % 100,
+				   compr >> 10, same);
+			seq_printf(s, "zsmalloc %llu KiB used, %llu%% "
+				   "fragmentation\n", used >> 10,
+				   used > compr ?
+				   div64_u64((used - compr) * 100, used) : 0);
+		}
+
+		seq_printf(s, "cpu%d: compress %llu MiB/s, "
+			   "decompress %llu MiB/s\n", cpu,
+			   zram_bench_mibps(bytes, run.write_ns),
+			   zram_bench_mibps(bytes, run.read_ns));
+
+		zram_bench_free_slots(zram);
+	}
+	put_online_cpus();
+
+	if (run.errors || run.mismatches)
+		seq_printf(s, "%lu I/O errors, %lu mismatches\n",
+			   run.errors, run.mismatches);
+
+	__free_page(run.scratch);
+out:
+	up_read(&zram->init_lock);
+	bdput(bdev);
+out_unlock:
+	mutex_unlock(&zram_bench_lock);
 	return ret;
 }
 
+static int zram_bench_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, zram_bench_show, inode->i_private);
+}
+
+static const struct file_operations zram_bench_fops = {
+	.open		= zram_bench_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static ssize_t zram_bench_corpus_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	unsigned long idx;
+	size_t done = 0, off, len;
+	ssize_t ret = 0;
+
+	mutex_lock(&zram_bench_lock);
+	if (!*ppos)
+		zram_bench_free_corpus();
+	if (*ppos != zram_bench_bytes) {
+		ret = -EINVAL;
+		goto out;
+	}
+
+	while (done < count) {
+		idx = zram_bench_bytes >> PAGE_SHIFT;
+		off = zram_bench_bytes & ~PAGE_MASK;
+		if (idx >= ZRAM_BENCH_MAX_PAGES) {
+			ret = -EFBIG;
+			break;
+		}
+		if (!off) {
+			zram_bench_corpus[idx] =
+				alloc_page(GFP_KERNEL | __GFP_ZERO);
+			if (!zram_bench_corpus[idx]) {
+				ret = -ENOMEM;
+				break;
+			}
+			zram_bench_pages = idx + 1;
+		}
+
+		len = min(count - done, PAGE_SIZE - off);
+		if (copy_from_user(page_address(zram_bench_corpus[idx]) + off,
+				   buf + done, len)) {
+			ret = -EFAULT;
+			break;
+		}
+		done += len;
+		zram_bench_bytes += len;
+	}
+	*ppos += done;
+out:
+	mutex_unlock(&zram_bench_lock);
+	return done ? done : ret;
+}
+
+static const struct file_operations zram_bench_corpus_fops = {
+	.write		= zram_bench_corpus_write,
+};
+
+static void zram_bench_init(void)
+{
+	char name[16];
+	int i;
+
+	zram_bench_corpus = vzalloc(ZRAM_BENCH_MAX_PAGES *
+				    sizeof(*zram_bench_corpus));
+	if (!zram_bench_corpus)
+		return;
+
+	zram_bench_dir = debugfs_create_dir("zram_bench", NULL);
+	if (IS_ERR_OR_NULL(zram_bench_dir))
+		return;
+
+	debugfs_create_file("corpus", S_IWUSR, zram_bench_dir, NULL,
+			    &zram_bench_corpus_fops);
+	for (i = 0; i < num_devices; i++) {
+		snprintf(name, sizeof(name), "zram%d", i);
+		debugfs_create_file(name, S_IRUSR, zram_bench_dir,
+				    &zram_devices[i], &zram_bench_fops);
+	}
+}
+
+static void zram_bench_exit(void)
+{
+	debugfs_remove_recursive(zram_bench_dir);
+	if (zram_bench_corpus) {
+		zram_bench_free_corpus();
+		vfree(zram_bench_corpus);
+	}
+}
+#else
+static inline void zram_bench_init(void) {}
+static inline void zram_bench_exit(void) {}
+#endif
+
 static void zram_reset_device(struct zram *zram, bool reset_capacity)
 {
 	size_t index;
 	struct zram_meta *meta;
 
-	flush_work(&zram->free_work);
+#ifdef CONFIG_ZRAM_WRITEBACK
+	flush_work(&zram->wb_work);
+#endif
 
 	down_write(&zram->init_lock);
 	if (!zram->init_done) {
@@ -577,16 +1526,22 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	/* Free all pages that are still in this zram device */
 	for (index = 0; index < zram->disksize >> PAGE_SHIFT; index++) {
 		unsigned long handle = meta->table[index].handle;
-		if (!handle)
+		if (!handle || zram_test_flag(meta, index, ZRAM_SAME) ||
+		    zram_test_flag(meta, index, ZRAM_WB))
 			continue;
 
 		zs_free(meta->mem_pool, handle);
 	}
 
+	zcomp_destroy(zram->comp);
+	zram->comp = NULL;
+
 	zram_meta_free(zram->meta);
 	zram->meta = NULL;
+	reset_bdev(zram);
 	/* Reset stats */
 	memset(&zram->stats, 0, sizeof(zram->stats));
+	zram->max_comp_streams = num_online_cpus();
 
 	zram->disksize = 0;
 	if (reset_capacity)
@@ -594,7 +1549,8 @@ static void zram_reset_device(struct zram *zram, bool reset_capacity)
 	up_write(&zram->init_lock);
 }
 
-static void zram_init_device(struct zram *zram, struct zram_meta *meta)
+static void zram_init_device(struct zram *zram, struct zram_meta *meta,
+		struct zcomp *comp)
 {
 	if (zram->disksize > 2 * (totalram_pages << PAGE_SHIFT)) {
 		pr_info(
@@ -614,6 +1570,7 @@ static void zram_init_device(struct zram *zram, struct zram_meta *meta)
 	queue_flag_set_unlocked(QUEUE_FLAG_NONROT, zram->disk->queue);
 
 	zram->meta = meta;
+	zram->comp = comp;
 	zram->init_done = 1;
 
 	pr_debug("Initialization done!\n");
@@ -624,7 +1581,9 @@ static ssize_t disksize_store(struct device *dev,
 {
 	u64 disksize;
 	struct zram_meta *meta;
+	struct zcomp *comp;
 	struct zram *zram = dev_to_zram(dev);
+	int err;
 
 	disksize = memparse(buf, NULL);
 	if (!disksize)
@@ -632,20 +1591,35 @@ static ssize_t disksize_store(struct device *dev,
 
 	disksize = PAGE_ALIGN(disksize);
 	meta = zram_meta_alloc(disksize);
+	if (!meta)
+		return -ENOMEM;
+
 	down_write(&zram->init_lock);
 	if (zram->init_done) {
-		up_write(&zram->init_lock);
-		zram_meta_free(meta);
 		pr_info("Cannot change disksize for initialized device\n");
-		return -EBUSY;
+		err = -EBUSY;
+		goto out_free_meta;
+	}
+
+	comp = zcomp_create(zram->compressor, zram->max_comp_streams);
+	if (IS_ERR(comp)) {
+		pr_info("Cannot initialise %s compressing backend\n",
+				zram->compressor);
+		err = PTR_ERR(comp);
+		goto out_free_meta;
 	}
 
 	zram->disksize = disksize;
 	set_capacity(zram->disk, zram->disksize >> SECTOR_SHIFT);
-	zram_init_device(zram, meta);
+	zram_init_device(zram, meta, comp);
 	up_write(&zram->init_lock);
 
 	return len;
+
+out_free_meta:
+	up_write(&zram->init_lock);
+	zram_meta_free(meta);
+	return err;
 }
 
 static ssize_t reset_store(struct device *dev,
@@ -759,40 +1733,19 @@ error:
 	bio_io_error(bio);
 }
 
-static void zram_slot_free(struct work_struct *work)
-{
-	struct zram *zram;
-
-	zram = container_of(work, struct zram, free_work);
-	down_write(&zram->lock);
-	handle_pending_slot_free(zram);
-	up_write(&zram->lock);
-}
-
-static void add_slot_free(struct zram *zram, struct zram_slot_free *free_rq)
-{
-	spin_lock(&zram->slot_free_lock);
-	free_rq->next = zram->slot_free_rq;
-	zram->slot_free_rq = free_rq;
-	spin_unlock(&zram->slot_free_lock);
-}
-
 static void zram_slot_free_notify(struct block_device *bdev,
 				unsigned long index)
 {
 	struct zram *zram;
-	struct zram_slot_free *free_rq;
+	struct zram_meta *meta;
 
 	zram = bdev->bd_disk->private_data;
-	atomic64_inc(&zram->stats.notify_free);
-
-	free_rq = kmalloc(sizeof(struct zram_slot_free), GFP_ATOMIC);
-	if (!free_rq)
-		return;
+	meta = zram->meta;
 
-	free_rq->index = index;
-	add_slot_free(zram, free_rq);
-	schedule_work(&zram->free_work);
+	write_lock(&meta->tb_lock);
+	zram_free_page(zram, index);
+	write_unlock(&meta->tb_lock);
+	atomic64_inc(&zram->stats.notify_free);
 }
 
 static const struct block_device_operations zram_devops = {
@@ -809,9 +1762,24 @@ static DEVICE_ATTR(num_writes, S_IRUGO, num_writes_show, NULL);
 static DEVICE_ATTR(invalid_io, S_IRUGO, invalid_io_show, NULL);
 static DEVICE_ATTR(notify_free, S_IRUGO, notify_free_show, NULL);
 static DEVICE_ATTR(zero_pages, S_IRUGO, zero_pages_show, NULL);
+static DEVICE_ATTR(same_pages, S_IRUGO, same_pages_show, NULL);
 static DEVICE_ATTR(orig_data_size, S_IRUGO, orig_data_size_show, NULL);
 static DEVICE_ATTR(compr_data_size, S_IRUGO, compr_data_size_show, NULL);
 static DEVICE_ATTR(mem_used_total, S_IRUGO, mem_used_total_show, NULL);
+static DEVICE_ATTR(compact, S_IWUSR, NULL, compact_store);
+static DEVICE_ATTR(pages_compacted, S_IRUGO, pages_compacted_show, NULL);
+static DEVICE_ATTR(max_comp_streams, S_IRUGO | S_IWUSR,
+		max_comp_streams_show, max_comp_streams_store);
+static DEVICE_ATTR(comp_algorithm, S_IRUGO | S_IWUSR,
+		comp_algorithm_show, comp_algorithm_store);
+
+#ifdef CONFIG_ZRAM_WRITEBACK
+static DEVICE_ATTR(backing_dev, S_IRUGO | S_IWUSR,
+		backing_dev_show, backing_dev_store);
+static DEVICE_ATTR(idle, S_IWUSR, NULL, idle_store);
+static DEVICE_ATTR(writeback, S_IWUSR, NULL, writeback_store);
+static DEVICE_ATTR(bd_stat, S_IRUGO, bd_stat_show, NULL);
+#endif
 
 static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_disksize.attr,
@@ -822,9 +1790,20 @@ static struct attribute *zram_disk_attrs[] = {
 	&dev_attr_invalid_io.attr,
 	&dev_attr_notify_free.attr,
 	&dev_attr_zero_pages.attr,
+	&dev_attr_same_pages.attr,
 	&dev_attr_orig_data_size.attr,
 	&dev_attr_compr_data_size.attr,
 	&dev_attr_mem_used_total.attr,
+	&dev_attr_compact.attr,
+	&dev_attr_pages_compacted.attr,
+	&dev_attr_max_comp_streams.attr,
+	&dev_attr_comp_algorithm.attr,
+#ifdef CONFIG_ZRAM_WRITEBACK
+	&dev_attr_backing_dev.attr,
+	&dev_attr_idle.attr,
+	&dev_attr_writeback.attr,
+	&dev_attr_bd_stat.attr,
+#endif
 	NULL,
 };
 
@@ -836,12 +1815,10 @@ static int create_device(struct zram *zram, int device_id)
 {
 	int ret = -ENOMEM;
 
-	init_rwsem(&zram->lock);
 	init_rwsem(&zram->init_lock);
-
-	INIT_WORK(&zram->free_work, zram_slot_free);
-	spin_lock_init(&zram->slot_free_lock);
-	zram->slot_free_rq = NULL;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	INIT_WORK(&zram->wb_work, zram_writeback_work);
+#endif
 
 	zram->queue = blk_alloc_queue(GFP_KERNEL);
 	if (!zram->queue) {
@@ -890,6 +1867,9 @@ static int create_device(struct zram *zram, int device_id)
 		goto out_free_disk;
 	}
 
+	strlcpy(zram->compressor, ZRAM_COMPRESSOR_DEFAULT,
+			sizeof(zram->compressor));
+	zram->max_comp_streams = num_online_cpus();
 	zram->init_done = 0;
 	return 0;
 
@@ -947,6 +1927,7 @@ static int __init zram_init(void)
 			goto free_devices;
 	}
 
+	zram_bench_init();
 	pr_info("Created %u device(s) ...\n", num_devices);
 
 	return 0;
@@ -966,6 +1947,7 @@ static void __exit zram_exit(void)
 	int i;
 	struct zram *zram;
 
+	zram_bench_exit();
 	for (i = 0; i < num_devices; i++) {
 		zram = &zram_devices[i];
 
@@ -17,8 +17,10 @@
 
 #include <linux/spinlock.h>
 #include <linux/mutex.h>
+#include <linux/workqueue.h>
 
 #include "../zsmalloc/zsmalloc.h"
+#include "zcomp.h"
 
 /*
  * Some arbitrary value. This is just to catch
@@ -34,6 +36,12 @@ static const unsigned max_num_devices = 32;
  */
 static const size_t max_zpage_size = PAGE_SIZE / 10 * 9;
 
+/*
+ * Pages that compress to size greater than this are flagged ZRAM_HUGE
+ * and can be written back to the backing device (see writeback).
+ */
+static const size_t huge_zpage_size = PAGE_SIZE / 4 * 3;
+
 /*
  * NOTE: max_zpage_size must be less than or equal to:
  *   ZS_MAX_ALLOC_SIZE. Otherwise, zs_malloc() would
@@ -53,8 +61,18 @@ static const size_t max_zpage_size = PAGE_SIZE / 10 * 9;
 
 /* Flags for zram pages (table[page_no].flags) */
 enum zram_pageflags {
-	/* Page consists entirely of zeros */
-	ZRAM_ZERO,
+	/*
+	 * Page consists of one repeated word (all zeros being the common
+	 * case); the word is kept in table[page_no].element and nothing
+	 * is allocated from zsmalloc.
+	 */
+	ZRAM_SAME,
+	/* Page lives on the backing device at block table[page_no].element */
+	ZRAM_WB,
+	/* Page is being written back; cleared if the slot is freed */
+	ZRAM_UNDER_WB,
+	/* Compressed size is above huge_zpage_size */
+	ZRAM_HUGE,
 
 	__NR_ZRAM_PAGEFLAGS,
 };
@@ -63,16 +81,16 @@ enum zram_pageflags {
 
 /* Allocated for each disk page */
 struct table {
-	unsigned long handle;
+	union {
+		unsigned long handle;
+		/* fill word of a ZRAM_SAME page, block of a ZRAM_WB page */
+		unsigned long element;
+	};
 	u16 size;	/* object size (excluding header) */
 	u8 count;	/* object ref count (not yet used) */
 	u8 flags;
 } __aligned(4);
 
-/*
- * All 64bit fields should only be manipulated by 64bit atomic accessors.
- * All modifications to 32bit counter should be protected by zram->lock.
- */
 struct zram_stats {
 	atomic64_t compr_size;	/* compressed size of pages stored */
 	atomic64_t num_reads;	/* failed + successful */
@@ -81,32 +99,36 @@ struct zram_stats {
 	atomic64_t failed_writes;	/* can happen when memory is too low */
 	atomic64_t invalid_io;	/* non-page-aligned I/O requests */
 	atomic64_t notify_free;	/* no. of swap slot free notifications */
-	u32 pages_zero;		/* no. of zero filled pages */
-	u32 pages_stored;	/* no. of pages currently stored */
-	u32 good_compress;	/* % of pages with compression ratio<=50% */
-	u32 bad_compress;	/* % of pages with compression ratio>=75% */
+	atomic_t pages_zero;		/* no. of zero filled pages */
+	atomic_t pages_same;		/* no. of same element filled pages */
+	atomic_t pages_stored;		/* no. of pages currently stored */
+	atomic_t good_compress;	/* % of pages with compression ratio<=50% */
+	atomic_t bad_compress;	/* % of pages with compression ratio>=75% */
+#ifdef CONFIG_ZRAM_WRITEBACK
+	atomic64_t bd_count;	/* no. of pages in backing device */
+	atomic64_t bd_reads;	/* no. of reads from backing device */
+	atomic64_t bd_writes;	/* no. of writes to backing device */
+#endif
+};
+
+enum zram_wb_mode {
+	ZRAM_WB_IDLE,		/* write back slots marked idle */
+	ZRAM_WB_HUGE,		/* write back ZRAM_HUGE slots */
 };
 
 struct zram_meta {
-	void *compress_workmem;
-	void *compress_buffer;
+	rwlock_t tb_lock;	/* protect table */
 	struct table *table;
 	struct zs_pool *mem_pool;
-};
-
-struct zram_slot_free {
-	unsigned long index;
-	struct zram_slot_free *next;
+#ifdef CONFIG_ZRAM_WRITEBACK
+	/* slots not accessed since they were last marked idle */
+	unsigned long *idle_map;
+#endif
 };
 
 struct zram {
 	struct zram_meta *meta;
-	struct rw_semaphore lock; /* protect compression buffers, table,
-				   * 32bit stat counters against concurrent
-				   * notifications, reads and writes */
-
-	struct work_struct free_work;  /* handle pending free request */
-	struct zram_slot_free *slot_free_rq; /* list head of free request */
+	struct zcomp *comp;
 
 	struct request_queue *queue;
 	struct gendisk *disk;
@@ -118,8 +140,18 @@ struct zram {
 	 * we can store in a disk.
 	 */
 	u64 disksize;	/* bytes */
-	spinlock_t slot_free_lock;
+	int max_comp_streams;
 
 	struct zram_stats stats;
+
+	char compressor[10];
+#ifdef CONFIG_ZRAM_WRITEBACK
+	struct file *backing_dev;
+	struct block_device *bdev;
+	unsigned long nr_pages;	/* size of backing device in pages */
+	unsigned long *bitmap;	/* allocated blocks of backing device */
+	struct work_struct wb_work;
+	enum zram_wb_mode wb_mode;
+#endif
 };
 #endif
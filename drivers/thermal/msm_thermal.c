@@ -40,6 +40,7 @@
 #include <linux/msm_thermal_ioctl.h>
 #include <soc/qcom/rpm-smd.h>
 #include <soc/qcom/scm.h>
+#include <soc/qcom/core_park.h>
 
 #define MAX_CURRENT_UA 100000
 #define MAX_RAILS 5
@@ -101,6 +102,8 @@ static DEFINE_MUTEX(gfx_mutex);
 static DEFINE_MUTEX(ocr_mutex);
 static DEFINE_MUTEX(vdd_mx_mutex);
 static uint32_t min_freq_limit;
+static uint32_t pid_max_freq = UINT_MAX;
+static uint32_t chain_max_freq = UINT_MAX;
 static uint32_t curr_gfx_band;
 static uint32_t curr_cx_band;
 static struct kobj_attribute cx_mode_attr;
@@ -298,7 +301,9 @@ static int  msm_thermal_cpufreq_callback(struct notifier_block *nfb,
 		unsigned long event, void *data)
 {
 	struct cpufreq_policy *policy = data;
-	uint32_t max_freq_req = cpus[policy->cpu].limited_max_freq;
+	uint32_t max_freq_req = min3(cpus[policy->cpu].limited_max_freq,
+				     ACCESS_ONCE(pid_max_freq),
+				     ACCESS_ONCE(chain_max_freq));
 	uint32_t min_freq_req = cpus[policy->cpu].limited_min_freq;
 
 	switch (event) {
@@ -1757,6 +1762,364 @@ static void do_freq_control(long temp)
 	put_online_cpus();
 }
 
+/*
+ * Predictive frequency control. The PID controller tracks a target
+ * temperature. Its error comes from the temperature extrapolated
+ * pid_horizon_ms ahead along the recent slope. The output is a
+ * continuously moving cap on the CPU maximum frequency, so the CPU
+ * settles at a sustainable frequency instead of stepping between full
+ * speed and limit_temp_degC throttling.
+ *
+ * pid_target_degC of 0 targets limit_temp_degC - temp_hysteresis_degC.
+ * Gains are in kHz per degC (kp), per degC*s (ki) and per degC/s (kd).
+ * The integral only takes the cap down; the cap returns to full speed
+ * as it winds back up.
+ */
+#define PID_HIST_LEN	8
+
+static int pid_enabled;
+static int pid_target_degC;
+static int pid_horizon_ms = 2000;
+static int pid_sample_ms = 250;
+static int pid_kp = 50000;
+static int pid_ki = 10000;
+static int pid_kd = 100000;
+module_param(pid_target_degC, int, 0644);
+module_param(pid_horizon_ms, int, 0644);
+module_param(pid_sample_ms, int, 0644);
+module_param(pid_kp, int, 0644);
+module_param(pid_ki, int, 0644);
+module_param(pid_kd, int, 0644);
+
+static struct pid_state {
+	long temp[PID_HIST_LEN];
+	u64 time_ms[PID_HIST_LEN];
+	unsigned int nsamp;
+	unsigned int head;
+	long slope;		/* mdegC per second */
+	long predicted;		/* mdegC */
+	long error;		/* mdegC */
+	s64 integral;		/* mdegC * ms */
+	uint32_t cap;		/* kHz, unquantized */
+} pid;
+static DEFINE_MUTEX(pid_mutex);
+
+static void do_pid_control(struct work_struct *work);
+static DECLARE_DELAYED_WORK(pid_work, do_pid_control);
+
+static void pid_apply(uint32_t max_freq)
+{
+	uint32_t cpu;
+
+	if (max_freq == pid_max_freq)
+		return;
+
+	pr_debug("PID limiting max frequency to %u\n", max_freq);
+	pid_max_freq = max_freq;
+	get_online_cpus();
+	for_each_possible_cpu(cpu)
+		update_cpu_freq(cpu);
+	put_online_cpus();
+}
+
+static void pid_reset(void)
+{
+	memset(&pid, 0, sizeof(pid));
+	pid_apply(UINT_MAX);
+}
+
+static void do_pid_control(struct work_struct *work)
+{
+	uint32_t fmin, fmax, max_freq = UINT_MAX;
+	unsigned int oldest;
+	long temp = 0;
+	s64 out, p, i, d, span;
+	u64 now;
+	int j, target;
+
+	mutex_lock(&pid_mutex);
+	if (!pid_enabled)
+		goto unlock;
+
+	if (!table && msm_thermal_get_freq_table())
+		goto reschedule;
+	if (therm_get_temp(msm_thermal_info.sensor_id, THERM_TSENS_ID,
+			   &temp))
+		goto reschedule;
+
+	now = ktime_to_ms(ktime_get());
+	pid.temp[pid.head] = temp * 1000;
+	pid.time_ms[pid.head] = now;
+	pid.head = (pid.head + 1) % PID_HIST_LEN;
+	if (pid.nsamp < PID_HIST_LEN)
+		pid.nsamp++;
+	if (pid.nsamp < 2)
+		goto reschedule;
+
+	oldest = (pid.head + PID_HIST_LEN - pid.nsamp) % PID_HIST_LEN;
+	span = now - pid.time_ms[oldest];
+	if (span <= 0)
+		goto reschedule;
+	pid.slope = div64_s64((s64)(temp * 1000 - pid.temp[oldest]) *
+			      MSEC_PER_SEC, span);
+	pid.predicted = temp * 1000 + pid.slope * pid_horizon_ms /
+			(long)MSEC_PER_SEC;
+	target = pid_target_degC ?: msm_thermal_info.limit_temp_degC -
+				    msm_thermal_info.temp_hysteresis_degC;
+	pid.error = target * 1000L - pid.predicted;
+
+	fmin = table[limit_idx_low].frequency;
+	fmax = table[limit_idx_high].frequency;
+
+	pid.integral += (s64)pid.error * pid_sample_ms;
+	p = div_s64((s64)pid_kp * pid.error, 1000);
+	i = div64_s64((s64)pid_ki * pid.integral, 1000000LL);
+	/* anti-windup: the integral may only hold the cap down to fmin */
+	if (i > 0) {
+		pid.integral = 0;
+		i = 0;
+	} else if (pid_ki && i < -(s64)(fmax - fmin)) {
+		pid.integral = div_s64(-(s64)(fmax - fmin) * 1000000LL,
+				       pid_ki);
+		i = -(s64)(fmax - fmin);
+	}
+	d = div_s64((s64)pid_kd * pid.slope, 1000);
+
+	out = (s64)fmax + p + i - d;
+	out = clamp_t(s64, out, fmin, fmax);
+	pid.cap = out;
+
+	/* highest table frequency not above the cap */
+	if (pid.cap < fmax) {
+		max_freq = fmin;
+		for (j = limit_idx_low; j <= limit_idx_high; j++) {
+			if (table[j].frequency == CPUFREQ_ENTRY_INVALID)
+				continue;
+			if (table[j].frequency <= pid.cap)
+				max_freq = max(max_freq, table[j].frequency);
+		}
+	}
+	pid_apply(max_freq);
+
+reschedule:
+	queue_delayed_work(system_power_efficient_wq, &pid_work,
+			   msecs_to_jiffies(max(pid_sample_ms, 10)));
+unlock:
+	mutex_unlock(&pid_mutex);
+}
+
+static int set_pid_enabled(const char *val, const struct kernel_param *kp)
+{
+	int ret;
+
+	mutex_lock(&pid_mutex);
+	ret = param_set_bool(val, kp);
+	if (!ret) {
+		pid_reset();
+		if (pid_enabled)
+			queue_delayed_work(system_power_efficient_wq,
+					   &pid_work, 0);
+	}
+	mutex_unlock(&pid_mutex);
+
+	return ret;
+}
+
+static struct kernel_param_ops pid_enabled_ops = {
+	.set = set_pid_enabled,
+	.get = param_get_bool,
+};
+module_param_cb(pid_enabled, &pid_enabled_ops, &pid_enabled, 0644);
+MODULE_PARM_DESC(pid_enabled, "predictive frequency control");
+
+static int get_pid_state(char *buf, const struct kernel_param *kp)
+{
+	int ret;
+
+	mutex_lock(&pid_mutex);
+	ret = snprintf(buf, PAGE_SIZE,
+		"temp=%ld slope=%ld predicted=%ld error=%ld integral=%lld cap=%u max_freq=%u\n",
+		pid.nsamp ? pid.temp[(pid.head + PID_HIST_LEN - 1) %
+				     PID_HIST_LEN] : 0,
+		pid.slope, pid.predicted, pid.error, pid.integral, pid.cap,
+		pid_max_freq);
+	mutex_unlock(&pid_mutex);
+
+	return ret;
+}
+
+static struct kernel_param_ops pid_state_ops = {
+	.get = get_pid_state,
+};
+module_param_cb(pid_state, &pid_state_ops, NULL, 0444);
+MODULE_PARM_DESC(pid_state,
+	"temps in mdegC, slope in mdegC/s, cap and max_freq in kHz");
+
+/*
+ * Mitigation chain. qcom,mitigation-chain lists <stage temp hysteresis>
+ * triples in the order they should engage:
+ *   1 - park cores through msm_core_park, one core per step
+ *   2 - cap the GPU through kgsl, one power level per step
+ *   3 - lower the CPU maximum frequency by qcom,freq-step per step
+ * Every poll_ms, the first stage above its temperature that is not yet
+ * at its limit goes one step further. Once below temp - hysteresis,
+ * the last engaged stage steps back first. Putting the CPU frequency
+ * stage last lets single threaded work keep its peak clock longest.
+ */
+enum mitigation_stage_type {
+	MITIGATION_CORE_PARK = 1,
+	MITIGATION_GPU_CAP,
+	MITIGATION_CPU_FREQ,
+	MITIGATION_NR,
+};
+
+static const char * const mitigation_stage_names[MITIGATION_NR] = {
+	[MITIGATION_CORE_PARK]	= "core_park",
+	[MITIGATION_GPU_CAP]	= "gpu_cap",
+	[MITIGATION_CPU_FREQ]	= "cpu_freq",
+};
+
+struct mitigation_stage {
+	uint32_t type;
+	int32_t temp_degC;
+	int32_t hyst_degC;
+	unsigned int level;
+	bool saturated;
+};
+
+static struct mitigation_stage *mitigation_chain;
+static int mitigation_chain_len;
+static bool chain_has_cpu_freq;
+static DEFINE_MUTEX(chain_mutex);
+static BLOCKING_NOTIFIER_HEAD(gpu_cap_notifier_list);
+
+static void do_mitigation_chain(struct work_struct *work);
+static DECLARE_DELAYED_WORK(chain_work, do_mitigation_chain);
+
+int msm_thermal_gpu_cap_register_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&gpu_cap_notifier_list, nb);
+}
+EXPORT_SYMBOL(msm_thermal_gpu_cap_register_notifier);
+
+int msm_thermal_gpu_cap_unregister_notifier(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&gpu_cap_notifier_list, nb);
+}
+EXPORT_SYMBOL(msm_thermal_gpu_cap_unregister_notifier);
+
+/* Apply @level steps of @stage, return how many steps took effect */
+static unsigned int mitigation_stage_set(struct mitigation_stage *stage,
+					 unsigned int level)
+{
+	struct msm_thermal_gpu_cap cap = { .levels = level };
+	unsigned int ncpus = num_possible_cpus();
+	uint32_t cpu, max_freq = UINT_MAX;
+	int idx;
+
+	switch (stage->type) {
+	case MITIGATION_CORE_PARK:
+		level = min(level, ncpus - 1);
+		if (msm_core_park_thermal_limit(level ? ncpus - level : 0))
+			return 0;
+		return level;
+	case MITIGATION_GPU_CAP:
+		blocking_notifier_call_chain(&gpu_cap_notifier_list, 0, &cap);
+		return cap.applied;
+	case MITIGATION_CPU_FREQ:
+		if (!table || !msm_thermal_info.bootup_freq_step)
+			return 0;
+		level = min_t(unsigned int, level,
+			DIV_ROUND_UP(limit_idx_high - limit_idx_low,
+				     msm_thermal_info.bootup_freq_step));
+		if (level) {
+			idx = limit_idx_high -
+				level * msm_thermal_info.bootup_freq_step;
+			max_freq = table[max(idx, limit_idx_low)].frequency;
+		}
+		if (max_freq != chain_max_freq) {
+			chain_max_freq = max_freq;
+			get_online_cpus();
+			for_each_possible_cpu(cpu)
+				update_cpu_freq(cpu);
+			put_online_cpus();
+		}
+		return level;
+	}
+	return 0;
+}
+
+static void do_mitigation_chain(struct work_struct *work)
+{
+	struct mitigation_stage *stage;
+	unsigned int applied;
+	long temp = 0;
+	int i;
+
+	mutex_lock(&chain_mutex);
+	if (!table && msm_thermal_get_freq_table())
+		goto reschedule;
+	if (therm_get_temp(msm_thermal_info.sensor_id, THERM_TSENS_ID,
+			   &temp))
+		goto reschedule;
+
+	for (i = 0; i < mitigation_chain_len; i++) {
+		stage = &mitigation_chain[i];
+		if (temp < stage->temp_degC || stage->saturated)
+			continue;
+		applied = mitigation_stage_set(stage, stage->level + 1);
+		stage->saturated = applied <= stage->level;
+		if (applied > stage->level) {
+			stage->level = applied;
+			goto reschedule;
+		}
+	}
+
+	for (i = mitigation_chain_len - 1; i >= 0; i--) {
+		stage = &mitigation_chain[i];
+		if (temp > stage->temp_degC - stage->hyst_degC)
+			continue;
+		/* retry a stage that could not engage, e.g. no GPU yet */
+		stage->saturated = false;
+		if (stage->level) {
+			stage->level = mitigation_stage_set(stage,
+							    stage->level - 1);
+			break;
+		}
+	}
+
+reschedule:
+	mutex_unlock(&chain_mutex);
+	queue_delayed_work(system_power_efficient_wq, &chain_work,
+			   msecs_to_jiffies(msm_thermal_info.poll_ms));
+}
+
+static int get_mitigation_chain(char *buf, const struct kernel_param *kp)
+{
+	struct mitigation_stage *stage;
+	int i, len = 0;
+
+	mutex_lock(&chain_mutex);
+	for (i = 0; i < mitigation_chain_len; i++) {
+		stage = &mitigation_chain[i];
+		len += snprintf(buf + len, PAGE_SIZE - len,
+				"%s temp=%d hyst=%d level=%u%s\n",
+				mitigation_stage_names[stage->type],
+				stage->temp_degC, stage->hyst_degC,
+				stage->level,
+				stage->saturated ? " saturated" : "");
+	}
+	mutex_unlock(&chain_mutex);
+
+	return len;
+}
+
+static struct kernel_param_ops mitigation_chain_ops = {
+	.get = get_mitigation_chain,
+};
+module_param_cb(mitigation_chain, &mitigation_chain_ops, NULL, 0444);
+MODULE_PARM_DESC(mitigation_chain, "mitigation chain stages and levels");
+
 static void check_temp(struct work_struct *work)
 {
 	static int limit_init;
@@ -1787,11 +2150,13 @@ static void check_temp(struct work_struct *work)
 	}
 
 	do_vdd_restriction();
-	do_freq_control(temp);
+	if (!pid_enabled && !chain_has_cpu_freq)
+		do_freq_control(temp);
 
 reschedule:
 	if (polling_enabled)
-		schedule_delayed_work(&check_temp_work,
+		queue_delayed_work(system_power_efficient_wq,
+				&check_temp_work,
 				msecs_to_jiffies(msm_thermal_info.poll_ms));
 }
 
@@ -2965,8 +3330,15 @@ int msm_thermal_init(struct msm_thermal_data *pdata)
 	if (ret)
 		pr_err("cannot register cpufreq notifier. err:%d\n", ret);
 
-	INIT_DELAYED_WORK(&check_temp_work, check_temp);
-	schedule_delayed_work(&check_temp_work, 0);
+	/*
+	 * Polling does not need to wake up an idle CPU: a CPU that is idle
+	 * is not heating up.
+	 */
+	INIT_DEFERRABLE_WORK(&check_temp_work, check_temp);
+	queue_delayed_work(system_power_efficient_wq, &check_temp_work, 0);
+
+	if (mitigation_chain_len)
+		queue_delayed_work(system_power_efficient_wq, &chain_work, 0);
 
 	if (num_possible_cpus() > 1)
 		register_cpu_notifier(&msm_thermal_cpu_notifier);
@@ -3934,6 +4306,60 @@ PROBE_FREQ_EXIT:
 	return ret;
 }
 
+static int probe_mitigation_chain(struct device_node *node,
+		struct msm_thermal_data *data,
+		struct platform_device *pdev)
+{
+	char *key = "qcom,mitigation-chain";
+	u32 *vals = NULL;
+	int ret = 0, len, i;
+
+	if (!of_get_property(node, key, &len))
+		return 0;
+
+	len /= sizeof(u32);
+	if (!len || len % 3) {
+		ret = -EINVAL;
+		goto PROBE_CHAIN_EXIT;
+	}
+
+	vals = kcalloc(len, sizeof(u32), GFP_KERNEL);
+	mitigation_chain = devm_kzalloc(&pdev->dev,
+			len / 3 * sizeof(*mitigation_chain), GFP_KERNEL);
+	if (!vals || !mitigation_chain) {
+		ret = -ENOMEM;
+		goto PROBE_CHAIN_EXIT;
+	}
+
+	ret = of_property_read_u32_array(node, key, vals, len);
+	if (ret)
+		goto PROBE_CHAIN_EXIT;
+
+	for (i = 0; i < len / 3; i++) {
+		if (!vals[i * 3] || vals[i * 3] >= MITIGATION_NR) {
+			ret = -EINVAL;
+			goto PROBE_CHAIN_EXIT;
+		}
+		mitigation_chain[i].type = vals[i * 3];
+		mitigation_chain[i].temp_degC = vals[i * 3 + 1];
+		mitigation_chain[i].hyst_degC = vals[i * 3 + 2];
+		if (mitigation_chain[i].type == MITIGATION_CPU_FREQ)
+			chain_has_cpu_freq = true;
+	}
+	mitigation_chain_len = len / 3;
+
+PROBE_CHAIN_EXIT:
+	kfree(vals);
+	if (ret) {
+		dev_info(&pdev->dev,
+		"%s:Failed reading node=%s, key=%s. err=%d. KTM continues\n",
+			__func__, node->full_name, key, ret);
+		mitigation_chain_len = 0;
+		chain_has_cpu_freq = false;
+	}
+	return ret;
+}
+
 static int msm_thermal_dev_probe(struct platform_device *pdev)
 {
 	int ret = 0;
@@ -3981,6 +4407,7 @@ static int msm_thermal_dev_probe(struct platform_device *pdev)
 	ret = probe_cc(node, &data, pdev);
 
 	ret = probe_freq_mitigation(node, &data, pdev);
+	ret = probe_mitigation_chain(node, &data, pdev);
 	ret = probe_cx_phase_ctrl(node, &data, pdev);
 	ret = probe_gfx_phase_ctrl(node, &data, pdev);
 	ret = probe_therm_reset(node, &data, pdev);
@@ -96,6 +96,12 @@ struct qpnp_tm_chip {
 	struct qpnp_vadc_chip		*vadc_dev;
 };
 
+/* Status, interrupt and self-clearing registers are not cached */
+static const struct spmi_reg_range qpnp_tm_volatile_regs[] = {
+	{ QPNP_TM_REG_STATUS, 0x3F },
+	{ QPNP_TM_REG_SHUTDOWN_CTRL2, QPNP_TM_REG_SHUTDOWN_CTRL2 },
+};
+
 /* Delay between TEMP_STAT IRQ going high and status value changing in ms. */
 #define STATUS_REGISTER_DELAY_MS       40
 
@@ -527,6 +533,10 @@ static int qpnp_tm_probe(struct spmi_device *spmi)
 	}
 	chip->tm_name = tm_name;
 
+	spmi_reg_cache_register(spmi->ctrl, spmi->sid, chip->base_addr,
+				qpnp_tm_volatile_regs,
+				ARRAY_SIZE(qpnp_tm_volatile_regs));
+
 	INIT_DELAYED_WORK(&chip->irq_work, qpnp_tm_work);
 
 	/* These bindings are optional, so it is okay if they are not found. */
@@ -632,6 +642,7 @@ err_free_tz:
 	thermal_zone_device_unregister(chip->tz_dev);
 err_cancel_work:
 	cancel_delayed_work_sync(&chip->irq_work);
+	spmi_reg_cache_unregister(spmi->ctrl, spmi->sid, chip->base_addr);
 	kfree(chip->tm_name);
 free_chip:
 	dev_set_drvdata(&spmi->dev, NULL);
@@ -649,6 +660,7 @@ static int qpnp_tm_remove(struct spmi_device *spmi)
 	qpnp_tm_shutdown_override(chip, SOFTWARE_OVERRIDE_DISABLED);
 	free_irq(chip->irq, chip);
 	cancel_delayed_work_sync(&chip->irq_work);
+	spmi_reg_cache_unregister(spmi->ctrl, spmi->sid, chip->base_addr);
 	kfree(chip);
 
 	return 0;
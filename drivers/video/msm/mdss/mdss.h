@@ -134,6 +134,9 @@ struct mdss_data_type {
 	u8 vsync_ena;
 	unsigned long min_mdp_clk;
 
+	u32 pipe_setup_cnt;
+	u32 pipe_setup_skip_cnt;
+
 	u32 res_init;
 
 	u32 highest_bank_bit;
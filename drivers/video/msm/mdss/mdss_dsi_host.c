@@ -680,11 +680,38 @@ static int mdss_dsi_cmd_dma_tx(struct mdss_dsi_ctrl_pdata *ctrl,
 static int mdss_dsi_cmd_dma_rx(struct mdss_dsi_ctrl_pdata *ctrl,
 			struct dsi_buf *rp, int rlen);
 
+static inline int mdss_dsi_cmd_pkt_len(struct dsi_cmd_desc *cm)
+{
+	return DSI_HOST_HDR_SIZE + ALIGN(cm->dchdr.dlen, 4);
+}
+
+/*
+ * A command marked as the last of its DMA transfer, that doesn't need a
+ * delay after it, can still be sent along with the next one as long as
+ * both fit in the tx buffer.  Not done while a video mode panel is active,
+ * where commands are only sent in the blanking period.
+ */
+static bool mdss_dsi_cmd_can_batch(struct mdss_dsi_ctrl_pdata *ctrl,
+		struct dsi_buf *tp, struct dsi_cmd_desc *cm, int cnt)
+{
+	if (!cnt || cm->dchdr.wait)
+		return false;
+
+	if ((ctrl->panel_mode == DSI_VIDEO_MODE) &&
+			(ctrl->ctrl_state & CTRL_STATE_MDP_ACTIVE))
+		return false;
+
+	/* leave room for the 8 byte alignment of the buffer start */
+	return (tp->len + mdss_dsi_cmd_pkt_len(cm) +
+		mdss_dsi_cmd_pkt_len(cm + 1)) <= (tp->size - 8);
+}
+
 static int mdss_dsi_cmds2buf_tx(struct mdss_dsi_ctrl_pdata *ctrl,
 			struct dsi_cmd_desc *cmds, int cnt)
 {
 	struct dsi_buf *tp;
 	struct dsi_cmd_desc *cm;
+	struct dsi_cmd_desc desc;
 	struct dsi_ctrl_hdr *dchdr;
 	int len, wait, tot = 0;
 
@@ -693,9 +720,12 @@ static int mdss_dsi_cmds2buf_tx(struct mdss_dsi_ctrl_pdata *ctrl,
 	cm = cmds;
 	len = 0;
 	while (cnt--) {
-		dchdr = &cm->dchdr;
+		desc = *cm;
+		dchdr = &desc.dchdr;
+		if (dchdr->last && mdss_dsi_cmd_can_batch(ctrl, tp, cm, cnt))
+			dchdr->last = 0;
 		mdss_dsi_buf_reserve(tp, len);
-		len = mdss_dsi_cmd_dma_add(tp, cm);
+		len = mdss_dsi_cmd_dma_add(tp, &desc);
 		if (!len) {
 			pr_err("%s: failed to add cmd = 0x%x\n",
 				__func__,  cm->payload[0]);
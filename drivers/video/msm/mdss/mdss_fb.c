@@ -36,6 +36,7 @@
 #include <linux/of_address.h>
 #include <linux/proc_fs.h>
 #include <linux/pm_runtime.h>
+#include <linux/seq_file.h>
 #include <linux/slab.h>
 #include <linux/string.h>
 #include <linux/uaccess.h>
@@ -54,6 +55,10 @@
 
 #include "mdss_dsi.h"
 #include "mdss_fb.h"
+#include <linux/cpu_boost.h>
+
+#define CREATE_TRACE_POINTS
+#include "mdss_fb_trace.h"
 
 #ifdef CONFIG_LGE_HANDLE_PANIC
 #include <mach/lge_handle_panic.h>
@@ -77,6 +82,7 @@ static u32 mdss_fb_pseudo_palette[16] = {
 };
 
 static struct msm_mdp_interface *mdp_instance;
+static struct dentry *mdss_fb_debugfs_root;
 
 static int mdss_fb_register(struct msm_fb_data_type *mfd);
 static int mdss_fb_open(struct fb_info *info, int user);
@@ -475,6 +481,134 @@ static void mdss_fb_remove_sysfs(struct msm_fb_data_type *mfd)
 	sysfs_remove_group(&mfd->fbi->dev->kobj, &mdss_fb_attr_group);
 }
 
+static void mdss_fb_frame_stats_hist(struct mdss_fb_frame_stats *stats,
+		enum mdss_fb_frame_stage stage, s64 us)
+{
+	int bucket = us > 0 ? fls64((u64)us) : 0;
+
+	stats->hist[stage][min(bucket, MDSS_FB_HIST_BUCKETS - 1)]++;
+}
+
+/*
+ * Account a frame whose transfer has completed and whose release fence has
+ * just been signaled.  Frames that take more than a vsync since the last
+ * one, while the display is being updated continuously, count as a missed
+ * vsync with the previous frame repeated on screen.
+ */
+static void mdss_fb_frame_stats_done(struct msm_fb_data_type *mfd)
+{
+	struct mdss_fb_frame_stats *stats = &mfd->frame_stats;
+	u32 fps = mdss_panel_get_framerate(mfd->panel_info);
+	u32 frame_us = USEC_PER_SEC / (fps ? fps : DEFAULT_FRAME_RATE);
+	ktime_t now = ktime_get();
+	s64 queue_us, kickoff_us, transfer_us, release_us, delta_us;
+	u32 vsyncs = 0;
+
+	if (!ktime_to_us(stats->flushed) || !ktime_to_us(stats->flush_queued))
+		return;
+
+	queue_us = ktime_us_delta(stats->flush_kickoff, stats->flush_queued);
+	kickoff_us = ktime_us_delta(stats->flushed, stats->flush_kickoff);
+	transfer_us = ktime_us_delta(now, stats->flushed);
+	release_us = ktime_us_delta(now, stats->flush_queued);
+	delta_us = ktime_us_delta(now, stats->last_done);
+
+	if (ktime_to_us(stats->last_done) && delta_us < 4 * frame_us)
+		vsyncs = DIV_ROUND_CLOSEST((u32)delta_us, frame_us);
+
+	spin_lock(&stats->lock);
+	stats->frames++;
+	mdss_fb_frame_stats_hist(stats, MDSS_FB_STAGE_QUEUE, queue_us);
+	mdss_fb_frame_stats_hist(stats, MDSS_FB_STAGE_KICKOFF, kickoff_us);
+	mdss_fb_frame_stats_hist(stats, MDSS_FB_STAGE_TRANSFER, transfer_us);
+	mdss_fb_frame_stats_hist(stats, MDSS_FB_STAGE_RELEASE, release_us);
+	if (vsyncs > 1) {
+		stats->missed_vsync++;
+		stats->repeated += vsyncs - 1;
+	}
+	spin_unlock(&stats->lock);
+
+	stats->last_done = now;
+	stats->flushed = ktime_set(0, 0);
+
+	trace_mdss_fb_frame_done(mfd->index, queue_us, kickoff_us,
+			transfer_us, release_us);
+	if (vsyncs > 1)
+		trace_mdss_fb_frame_repeat(mfd->index, vsyncs);
+}
+
+static int mdss_fb_frame_stats_show(struct seq_file *s, void *unused)
+{
+	struct msm_fb_data_type *mfd = s->private;
+	struct mdss_fb_frame_stats *stats = &mfd->frame_stats;
+	static const char * const names[MDSS_FB_STAGE_MAX] = {
+		"queue", "kickoff", "transfer", "release",
+	};
+	int i, j;
+
+	spin_lock(&stats->lock);
+	seq_printf(s, "frames: %u\nmissed_vsync: %u\nrepeated: %u\n",
+			stats->frames, stats->missed_vsync, stats->repeated);
+
+	seq_printf(s, "%-9s", "us <");
+	for (j = 0; j < MDSS_FB_HIST_BUCKETS - 1; j++)
+		seq_printf(s, " %6u", 1 << j);
+	seq_printf(s, " %6s\n", "inf");
+
+	for (i = 0; i < MDSS_FB_STAGE_MAX; i++) {
+		seq_printf(s, "%-9s", names[i]);
+		for (j = 0; j < MDSS_FB_HIST_BUCKETS; j++)
+			seq_printf(s, " %6u", stats->hist[i][j]);
+		seq_putc(s, '\n');
+	}
+	spin_unlock(&stats->lock);
+
+	return 0;
+}
+
+static int mdss_fb_frame_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, mdss_fb_frame_stats_show, inode->i_private);
+}
+
+static ssize_t mdss_fb_frame_stats_write(struct file *file,
+		const char __user *buf, size_t count, loff_t *ppos)
+{
+	struct seq_file *s = file->private_data;
+	struct msm_fb_data_type *mfd = s->private;
+	struct mdss_fb_frame_stats *stats = &mfd->frame_stats;
+
+	/* any write clears the counters */
+	spin_lock(&stats->lock);
+	stats->frames = 0;
+	stats->missed_vsync = 0;
+	stats->repeated = 0;
+	memset(stats->hist, 0, sizeof(stats->hist));
+	spin_unlock(&stats->lock);
+
+	return count;
+}
+
+static const struct file_operations mdss_fb_frame_stats_fops = {
+	.open = mdss_fb_frame_stats_open,
+	.read = seq_read,
+	.write = mdss_fb_frame_stats_write,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static void mdss_fb_create_debugfs(struct msm_fb_data_type *mfd)
+{
+	char name[24];
+
+	if (IS_ERR_OR_NULL(mdss_fb_debugfs_root))
+		return;
+
+	snprintf(name, sizeof(name), "fb%d_frame_stats", mfd->index);
+	mfd->frame_stats.debugfs = debugfs_create_file(name, 0644,
+			mdss_fb_debugfs_root, mfd, &mdss_fb_frame_stats_fops);
+}
+
 static void mdss_fb_shutdown(struct platform_device *pdev)
 {
 	struct msm_fb_data_type *mfd = platform_get_drvdata(pdev);
@@ -531,6 +665,7 @@ static int mdss_fb_probe(struct platform_device *pdev)
 	INIT_LIST_HEAD(&mfd->proc_list);
 
 	mutex_init(&mfd->bl_lock);
+	spin_lock_init(&mfd->frame_stats.lock);
 
 	fbi_list[fbi_list_index++] = fbi;
 
@@ -566,6 +701,7 @@ static int mdss_fb_probe(struct platform_device *pdev)
 	}
 
 	mdss_fb_create_sysfs(mfd);
+	mdss_fb_create_debugfs(mfd);
 	mdss_fb_send_panel_event(mfd, MDSS_EVENT_FB_REGISTERED, fbi);
 
 	mfd->mdp_sync_pt_data.fence_name = "mdp-fence";
@@ -623,6 +759,7 @@ static int mdss_fb_remove(struct platform_device *pdev)
 		return -ENODEV;
 
 	mdss_fb_remove_sysfs(mfd);
+	debugfs_remove(mfd->frame_stats.debugfs);
 
 	pm_runtime_disable(mfd->fbi->dev);
 
@@ -1619,13 +1756,39 @@ static void mdss_fb_power_setting_idle(struct msm_fb_data_type *mfd)
 	}
 }
 
-int mdss_fb_wait_for_fence(struct msm_sync_pt_data *sync_pt_data)
+/**
+ * mdss_fb_add_implicit_fence() - wait on a fence at the next commit
+ * @sync_pt_data:	Sync point data structure of the display.
+ * @fence:		Fence attached to a queued buffer, the reference is
+ *			handed over.
+ *
+ * Buffers written by another driver may carry the producer's fence, in
+ * which case userspace does not need to pass it through the buffer sync
+ * ioctl. These are kept apart from the acquire fences since that ioctl
+ * flushes any acquire fences left over from before.
+ */
+void mdss_fb_add_implicit_fence(struct msm_sync_pt_data *sync_pt_data,
+				struct sync_fence *fence)
 {
-	struct sync_fence *fences[MDP_MAX_FENCE_FD];
-	int fence_cnt;
-	int i, ret = 0;
+	mutex_lock(&sync_pt_data->sync_mutex);
+	if (sync_pt_data->imp_fen_cnt < MDP_MAX_FENCE_FD) {
+		sync_pt_data->imp_fen[sync_pt_data->imp_fen_cnt++] = fence;
+		fence = NULL;
+	}
+	mutex_unlock(&sync_pt_data->sync_mutex);
 
-	pr_debug("%s: wait for fences\n", sync_pt_data->fence_name);
+	if (fence) {
+		pr_debug("%s: implicit fences full, waiting now\n",
+				sync_pt_data->fence_name);
+		sync_fence_wait(fence, WAIT_FENCE_FINAL_TIMEOUT);
+		sync_fence_put(fence);
+	}
+}
+
+static int __mdss_fb_take_fences(struct msm_sync_pt_data *sync_pt_data,
+				 struct sync_fence **fences, bool implicit)
+{
+	int fence_cnt;
 
 	mutex_lock(&sync_pt_data->sync_mutex);
 	/*
@@ -1637,8 +1800,46 @@ int mdss_fb_wait_for_fence(struct msm_sync_pt_data *sync_pt_data)
 	if (fence_cnt)
 		memcpy(fences, sync_pt_data->acq_fen,
 				fence_cnt * sizeof(struct sync_fence *));
+	if (implicit && sync_pt_data->imp_fen_cnt) {
+		memcpy(fences + fence_cnt, sync_pt_data->imp_fen,
+				sync_pt_data->imp_fen_cnt *
+				sizeof(struct sync_fence *));
+		fence_cnt += sync_pt_data->imp_fen_cnt;
+		sync_pt_data->imp_fen_cnt = 0;
+	}
 	mutex_unlock(&sync_pt_data->sync_mutex);
 
+	return fence_cnt;
+}
+
+/**
+ * mdss_fb_take_fences() - take over the fences of the next commit
+ * @sync_pt_data:	Sync point data structure of the display.
+ * @fences:		Room for 2 * MDP_MAX_FENCE_FD fences.
+ *
+ * Moves the acquire and implicit fences set up for the next commit to
+ * @fences, for a commit that is queued now and run later to wait on with
+ * mdss_fb_wait_fences(). Returns the number of fences moved.
+ */
+int mdss_fb_take_fences(struct msm_sync_pt_data *sync_pt_data,
+			struct sync_fence **fences)
+{
+	return __mdss_fb_take_fences(sync_pt_data, fences, true);
+}
+
+/**
+ * mdss_fb_wait_fences() - wait on and release a list of fences
+ * @sync_pt_data:	Sync point data structure the fences were taken from.
+ * @fences:		The fences.
+ * @fence_cnt:		Number of fences in @fences.
+ */
+void mdss_fb_wait_fences(struct msm_sync_pt_data *sync_pt_data,
+			 struct sync_fence **fences, int fence_cnt)
+{
+	int i, ret = 0;
+
+	pr_debug("%s: wait for fences\n", sync_pt_data->fence_name);
+
 	/* buf sync */
 	for (i = 0; i < fence_cnt && !ret; i++) {
 		ret = sync_fence_wait(fences[i],
@@ -1660,10 +1861,25 @@ int mdss_fb_wait_for_fence(struct msm_sync_pt_data *sync_pt_data)
 		for (; i < fence_cnt; i++)
 			sync_fence_put(fences[i]);
 	}
+}
+
+static int __mdss_fb_wait_for_fence(struct msm_sync_pt_data *sync_pt_data,
+				    bool implicit)
+{
+	struct sync_fence *fences[2 * MDP_MAX_FENCE_FD];
+	int fence_cnt;
+
+	fence_cnt = __mdss_fb_take_fences(sync_pt_data, fences, implicit);
+	mdss_fb_wait_fences(sync_pt_data, fences, fence_cnt);
 
 	return fence_cnt;
 }
 
+int mdss_fb_wait_for_fence(struct msm_sync_pt_data *sync_pt_data)
+{
+	return __mdss_fb_wait_for_fence(sync_pt_data, true);
+}
+
 /**
  * mdss_fb_signal_timeline() - signal a single release fence
  * @sync_pt_data:	Sync point data structure for the timeline which
@@ -1746,6 +1962,9 @@ static int __mdss_fb_sync_buf_done_callback(struct notifier_block *p,
 	case MDP_NOTIFY_FRAME_FLUSHED:
 		pr_debug("%s: frame flushed\n", sync_pt_data->fence_name);
 		sync_pt_data->flushed = true;
+		mfd->frame_stats.flush_queued = mfd->frame_stats.queued;
+		mfd->frame_stats.flush_kickoff = mfd->frame_stats.kickoff;
+		mfd->frame_stats.flushed = ktime_get();
 		break;
 	case MDP_NOTIFY_FRAME_TIMEOUT:
 		pr_err("%s: frame timeout\n", sync_pt_data->fence_name);
@@ -1754,6 +1973,7 @@ static int __mdss_fb_sync_buf_done_callback(struct notifier_block *p,
 	case MDP_NOTIFY_FRAME_DONE:
 		pr_debug("%s: frame done\n", sync_pt_data->fence_name);
 		mdss_fb_signal_timeline(sync_pt_data);
+		mdss_fb_frame_stats_done(mfd);
 		break;
 	}
 
@@ -1827,6 +2047,7 @@ static int mdss_fb_pan_display_ex(struct fb_info *info,
 
 	atomic_inc(&mfd->mdp_sync_pt_data.commit_cnt);
 	atomic_inc(&mfd->commits_pending);
+	mfd->frame_stats.queued = ktime_get();
 	wake_up_all(&mfd->commit_wait_q);
 	mutex_unlock(&mfd->mdp_sync_pt_data.sync_mutex);
 	if (wait_for_finish)
@@ -1902,6 +2123,7 @@ static int __mdss_fb_perform_commit(struct msm_fb_data_type *mfd)
 	struct msm_fb_backup_type *fb_backup = &mfd->msm_fb_backup;
 	int ret = -ENOSYS;
 
+	mfd->frame_stats.kickoff = ktime_get();
 	if (!sync_pt_data->async_wait_fences)
 		mdss_fb_wait_for_fence(sync_pt_data);
 	sync_pt_data->flushed = false;
@@ -1929,6 +2151,28 @@ static int __mdss_fb_perform_commit(struct msm_fb_data_type *mfd)
 	return ret;
 }
 
+/*
+ * Tell cpu-boost whether this commit of the primary panel came more than
+ * half a frame later than one vsync after the previous one.  Commits
+ * following an idle display are not counted either way.
+ */
+static void mdss_fb_frame_boost(struct msm_fb_data_type *mfd)
+{
+	ktime_t now = ktime_get();
+	u32 fps = mdss_panel_get_framerate(mfd->panel_info);
+	u32 frame_us = USEC_PER_SEC / (fps ? fps : DEFAULT_FRAME_RATE);
+	s64 delta_us = ktime_us_delta(now, mfd->last_commit_time);
+
+	if (mfd->index)
+		return;
+
+	mfd->last_commit_time = now;
+	if (delta_us > 4 * frame_us)
+		return;
+
+	cpu_boost_frame_commit(delta_us > frame_us + frame_us / 2);
+}
+
 static int __mdss_fb_display_thread(void *data)
 {
 	struct msm_fb_data_type *mfd = data;
@@ -1955,6 +2199,7 @@ static int __mdss_fb_display_thread(void *data)
 			break;
 
 		ret = __mdss_fb_perform_commit(mfd);
+		mdss_fb_frame_boost(mfd);
 		atomic_dec(&mfd->commits_pending);
 		wake_up_all(&mfd->idle_wait_q);
 	}
@@ -2309,7 +2554,7 @@ static int mdss_fb_handle_buf_sync_ioctl(struct msm_sync_pt_data *sync_pt_data,
 		return ret;
 	}
 
-	i = mdss_fb_wait_for_fence(sync_pt_data);
+	i = __mdss_fb_wait_for_fence(sync_pt_data, false);
 	if (i > 0)
 		pr_warn("%s: waited on %d active fences\n",
 				sync_pt_data->fence_name, i);
@@ -2636,6 +2881,16 @@ int mdss_register_panel(struct platform_device *pdev,
 			fb_pdev->dev.platform_data = pdata;
 	}
 
+	/*
+	 * The framebuffer turns the panel on and off through its interface
+	 * controller, and waits for the MDP as its parent, so it can resume
+	 * alongside unrelated devices.
+	 */
+	if (fb_pdev) {
+		device_pm_add_dependency(&fb_pdev->dev, &pdev->dev);
+		device_enable_async_suspend(&fb_pdev->dev);
+	}
+
 	if (master_panel && mdp_instance->panel_register_done)
 		mdp_instance->panel_register_done(pdata);
 
@@ -2687,6 +2942,8 @@ int __init mdss_fb_init(void)
 {
 	int rc = -ENODEV;
 
+	mdss_fb_debugfs_root = debugfs_create_dir("mdss_fb", NULL);
+
 	if (platform_driver_register(&mdss_fb_driver))
 		return rc;
 
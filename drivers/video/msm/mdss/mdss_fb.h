@@ -95,6 +95,9 @@ struct msm_sync_pt_data {
 	char *fence_name;
 	u32 acq_fen_cnt;
 	struct sync_fence *acq_fen[MDP_MAX_FENCE_FD];
+	/* fences picked up from the queued dma-bufs themselves */
+	u32 imp_fen_cnt;
+	struct sync_fence *imp_fen[MDP_MAX_FENCE_FD];
 
 	struct sw_sync_timeline *timeline;
 	int timeline_value;
@@ -158,6 +161,44 @@ struct msm_fb_backup_type {
 	struct mdp_display_commit disp_commit;
 };
 
+/**
+ * enum mdss_fb_frame_stage - commit latency histograms
+ * @MDSS_FB_STAGE_QUEUE:	display commit until the display thread picks
+ *				it up
+ * @MDSS_FB_STAGE_KICKOFF:	programming until the frame has been flushed
+ * @MDSS_FB_STAGE_TRANSFER:	flush until the frame transfer is done
+ * @MDSS_FB_STAGE_RELEASE:	display commit until its release fence has
+ *				been signaled
+ */
+enum mdss_fb_frame_stage {
+	MDSS_FB_STAGE_QUEUE,
+	MDSS_FB_STAGE_KICKOFF,
+	MDSS_FB_STAGE_TRANSFER,
+	MDSS_FB_STAGE_RELEASE,
+	MDSS_FB_STAGE_MAX,
+};
+
+/* log2 buckets in us, the last one collects everything from 16ms up */
+#define MDSS_FB_HIST_BUCKETS 16
+
+struct mdss_fb_frame_stats {
+	spinlock_t lock;
+	ktime_t queued;
+	ktime_t kickoff;
+	/* stage times of the frame being transferred */
+	ktime_t flush_queued;
+	ktime_t flush_kickoff;
+	ktime_t flushed;
+	ktime_t last_done;
+
+	u32 frames;
+	u32 missed_vsync;
+	u32 repeated;
+	u32 hist[MDSS_FB_STAGE_MAX][MDSS_FB_HIST_BUCKETS];
+
+	struct dentry *debugfs;
+};
+
 struct msm_fb_data_type {
 	u32 key;
 	u32 index;
@@ -216,6 +257,8 @@ struct msm_fb_data_type {
 	/* for non-blocking */
 	struct task_struct *disp_thread;
 	atomic_t commits_pending;
+	ktime_t last_commit_time;
+	struct mdss_fb_frame_stats frame_stats;
 	wait_queue_head_t commit_wait_q;
 	wait_queue_head_t idle_wait_q;
 	bool shutdown_pending;
@@ -257,6 +300,12 @@ int mdss_fb_get_phys_info(dma_addr_t *start, unsigned long *len, int fb_num);
 void mdss_fb_set_backlight(struct msm_fb_data_type *mfd, u32 bkl_lvl);
 void mdss_fb_update_backlight(struct msm_fb_data_type *mfd);
 int mdss_fb_wait_for_fence(struct msm_sync_pt_data *sync_pt_data);
+int mdss_fb_take_fences(struct msm_sync_pt_data *sync_pt_data,
+			struct sync_fence **fences);
+void mdss_fb_wait_fences(struct msm_sync_pt_data *sync_pt_data,
+			 struct sync_fence **fences, int fence_cnt);
+void mdss_fb_add_implicit_fence(struct msm_sync_pt_data *sync_pt_data,
+				struct sync_fence *fence);
 void mdss_fb_signal_timeline(struct msm_sync_pt_data *sync_pt_data);
 struct sync_fence *mdss_fb_sync_get_fence(struct sw_sync_timeline *timeline,
 				const char *fence_name, int val);
@@ -0,0 +1,89 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ */
+
+#if !defined(_MDSS_FB_TRACE_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _MDSS_FB_TRACE_H
+
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM mdss
+#undef TRACE_INCLUDE_PATH
+#define TRACE_INCLUDE_PATH .
+#undef TRACE_INCLUDE_FILE
+#define TRACE_INCLUDE_FILE mdss_fb_trace
+
+#include <linux/tracepoint.h>
+
+/*
+ * Tracepoint for a completed frame, with the time spent in each stage
+ * from display commit to release fence
+ */
+TRACE_EVENT(mdss_fb_frame_done,
+
+	TP_PROTO(u32 index, s64 queue_us, s64 kickoff_us, s64 transfer_us,
+		s64 release_us),
+
+	TP_ARGS(index, queue_us, kickoff_us, transfer_us, release_us),
+
+	TP_STRUCT__entry(
+		__field(u32, index)
+		__field(s64, queue_us)
+		__field(s64, kickoff_us)
+		__field(s64, transfer_us)
+		__field(s64, release_us)
+	),
+
+	TP_fast_assign(
+		__entry->index = index;
+		__entry->queue_us = queue_us;
+		__entry->kickoff_us = kickoff_us;
+		__entry->transfer_us = transfer_us;
+		__entry->release_us = release_us;
+	),
+
+	TP_printk(
+		"fb%u queue=%lld kickoff=%lld transfer=%lld release=%lld",
+		__entry->index, __entry->queue_us, __entry->kickoff_us,
+		__entry->transfer_us, __entry->release_us
+	)
+);
+
+/*
+ * Tracepoint for a frame that stayed on screen for more than one vsync
+ * while frames were being committed back to back
+ */
+TRACE_EVENT(mdss_fb_frame_repeat,
+
+	TP_PROTO(u32 index, u32 vsyncs),
+
+	TP_ARGS(index, vsyncs),
+
+	TP_STRUCT__entry(
+		__field(u32, index)
+		__field(u32, vsyncs)
+	),
+
+	TP_fast_assign(
+		__entry->index = index;
+		__entry->vsyncs = vsyncs;
+	),
+
+	TP_printk(
+		"fb%u vsyncs=%u",
+		__entry->index, __entry->vsyncs
+	)
+);
+
+#endif /* _MDSS_FB_TRACE_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -1007,6 +1007,9 @@ static int mdss_debug_dump_stats(void *data, char *buf, int len)
 		total += scnprintf(buf + total, len - total,
 			"DMA%d :   %08u\t", i, pipe->play_cnt);
 	}
+	total += scnprintf(buf + total, len - total,
+		"\npipe setup: %u skipped: %u\n", mdata->pipe_setup_cnt,
+		mdata->pipe_setup_skip_cnt);
 	return total;
 }
 
@@ -1379,6 +1382,7 @@ static int mdss_mdp_probe(struct platform_device *pdev)
 	platform_set_drvdata(pdev, mdata);
 	mdss_res = mdata;
 	mutex_init(&mdata->reg_lock);
+	device_set_resume_critical(&pdev->dev, true);
 
 	res = platform_get_resource_byname(pdev, IORESOURCE_MEM, "mdp_phys");
 	if (!res) {
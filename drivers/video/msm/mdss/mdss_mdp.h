@@ -167,6 +167,11 @@ struct mdss_mdp_ctl {
 	u32 vsync_cnt;
 	u32 underrun_cnt;
 
+	/* DSI ULPS with MDSS power collapsed, command mode only */
+	u32 ulps_cnt;
+	u64 ulps_time_us;
+	ktime_t ulps_start;
+
 	u16 width;
 	u16 height;
 	u32 dst_format;
@@ -386,6 +391,7 @@ struct mdss_mdp_pipe {
 	u8 vert_deci;
 	struct mdss_mdp_img_rect src;
 	struct mdss_mdp_img_rect dst;
+	struct mdss_mdp_img_rect prev_dst; /* dst at the last kickoff */
 	struct mdss_mdp_format_params *src_fmt;
 	struct mdss_mdp_plane_sizes src_planes;
 
@@ -406,6 +412,10 @@ struct mdss_mdp_pipe {
 	struct mdp_overlay req_data;
 	u32 params_changed;
 
+	/* request as passed to the last successful setup, for reuse */
+	struct mdp_overlay setup_req;
+	bool setup_cached;
+
 	struct mdss_mdp_pipe_smp_map smp_map[MAX_PLANES];
 
 	struct mdss_mdp_data back_buf;
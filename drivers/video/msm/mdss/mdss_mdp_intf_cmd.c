@@ -25,6 +25,9 @@
 
 #define STOP_TIMEOUT msecs_to_jiffies(16 * (VSYNC_EXPIRE_TICK + 2))
 #define ULPS_ENTER_TIME msecs_to_jiffies(100)
+/* in panel idle (ambient) mode, updates are rare so power down right away */
+#define AMBIENT_EXPIRE_TICK 1
+#define AMBIENT_ULPS_ENTER_TIME 0
 
 struct mdss_mdp_cmd_ctx {
 	struct mdss_mdp_ctl *ctl;
@@ -177,14 +180,59 @@ static int mdss_mdp_cmd_tearcheck_setup(struct mdss_mdp_ctl *ctl)
 	return rc;
 }
 
+static inline bool mdss_mdp_cmd_is_ambient(struct mdss_mdp_cmd_ctx *ctx)
+{
+	struct mdss_panel_data *pdata = ctx->ctl->panel_data;
+
+	return pdata->get_idle && pdata->get_idle(pdata);
+}
+
+/*
+ * Put the DSI link into ULPS and power collapse MDSS.  Register state is
+ * kept in the retention domain and restored by mdss_mdp_ctl_restore()
+ * on the next kickoff.
+ */
+static void mdss_mdp_cmd_ulps_enter(struct mdss_mdp_cmd_ctx *ctx)
+{
+	if (mdss_mdp_ctl_intf_event(ctx->ctl, MDSS_EVENT_DSI_ULPS_CTRL,
+			(void *)1))
+		return;
+
+	ctx->ulps = true;
+	ctx->ctl->play_cnt = 0;
+	ctx->ctl->ulps_cnt++;
+	ctx->ctl->ulps_start = ktime_get();
+	mdss_mdp_footswitch_ctrl_ulps(0, &ctx->ctl->mfd->pdev->dev);
+}
+
+static void mdss_mdp_cmd_ulps_exit(struct mdss_mdp_cmd_ctx *ctx)
+{
+	struct mdss_mdp_ctl *ctl = ctx->ctl;
+
+	mdss_mdp_footswitch_ctrl_ulps(1, &ctl->mfd->pdev->dev);
+	mdss_mdp_ctl_restore(ctl);
+	mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_ON, false);
+
+	if (mdss_mdp_cmd_tearcheck_setup(ctl))
+		pr_warn("tearcheck setup failed\n");
+	mdss_mdp_ctl_intf_event(ctl, MDSS_EVENT_DSI_ULPS_CTRL, (void *)0);
+	ctx->ulps = false;
+
+	ctl->ulps_time_us += ktime_us_delta(ktime_get(), ctl->ulps_start);
+	ctl->ulps_start = ktime_set(0, 0);
+}
+
 static inline void mdss_mdp_cmd_clk_on(struct mdss_mdp_cmd_ctx *ctx)
 {
 	unsigned long flags;
 	struct mdss_data_type *mdata = mdss_mdp_get_mdata();
+	bool ambient;
 
 	if (!ctx->panel_on)
 		return;
 
+	ambient = mdss_mdp_cmd_is_ambient(ctx);
+
 	mutex_lock(&ctx->clk_mtx);
 	if (!ctx->clk_enabled) {
 		ctx->clk_enabled = 1;
@@ -192,21 +240,11 @@ static inline void mdss_mdp_cmd_clk_on(struct mdss_mdp_cmd_ctx *ctx)
 		if (cancel_delayed_work_sync(&ctx->ulps_work))
 			pr_debug("deleted pending ulps work\n");
 
-		if (ctx->ulps) {
-			mdss_mdp_footswitch_ctrl_ulps(1,
-				&ctx->ctl->mfd->pdev->dev);
-			mdss_mdp_ctl_restore(ctx->ctl);
+		if (ctx->ulps)
+			mdss_mdp_cmd_ulps_exit(ctx);
+		else
 			mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_ON, false);
 
-			if (mdss_mdp_cmd_tearcheck_setup(ctx->ctl))
-				pr_warn("tearcheck setup failed\n");
-			mdss_mdp_ctl_intf_event(ctx->ctl,
-				MDSS_EVENT_DSI_ULPS_CTRL, (void *)0);
-			ctx->ulps = false;
-		} else {
-			mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_ON, false);
-		}
-
 		mdss_mdp_ctl_intf_event
 			(ctx->ctl, MDSS_EVENT_PANEL_CLK_CTRL, (void *)1);
 
@@ -215,7 +253,7 @@ static inline void mdss_mdp_cmd_clk_on(struct mdss_mdp_cmd_ctx *ctx)
 	spin_lock_irqsave(&ctx->clk_lock, flags);
 	if (!ctx->rdptr_enabled)
 		mdss_mdp_irq_enable(MDSS_MDP_IRQ_PING_PONG_RD_PTR, ctx->pp_num);
-	ctx->rdptr_enabled = VSYNC_EXPIRE_TICK;
+	ctx->rdptr_enabled = ambient ? AMBIENT_EXPIRE_TICK : VSYNC_EXPIRE_TICK;
 	spin_unlock_irqrestore(&ctx->clk_lock, flags);
 	mutex_unlock(&ctx->clk_mtx);
 }
@@ -239,7 +277,9 @@ static inline void mdss_mdp_cmd_clk_off(struct mdss_mdp_cmd_ctx *ctx)
 			(ctx->ctl, MDSS_EVENT_PANEL_CLK_CTRL, (void *)0);
 		mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_OFF, false);
 		if (ctx->panel_on && !ctx->off_pan_on)
-			schedule_delayed_work(&ctx->ulps_work, ULPS_ENTER_TIME);
+			schedule_delayed_work(&ctx->ulps_work,
+				mdss_mdp_cmd_is_ambient(ctx) ?
+				AMBIENT_ULPS_ENTER_TIME : ULPS_ENTER_TIME);
 	}
 	mutex_unlock(&ctx->clk_mtx);
 }
@@ -393,12 +433,7 @@ static void __mdss_mdp_cmd_ulps_work(struct work_struct *work)
 		return;
 	}
 
-	if (!mdss_mdp_ctl_intf_event(ctx->ctl, MDSS_EVENT_DSI_ULPS_CTRL,
-		(void *)1)) {
-		ctx->ulps = true;
-		ctx->ctl->play_cnt = 0;
-		mdss_mdp_footswitch_ctrl_ulps(0, &ctx->ctl->mfd->pdev->dev);
-	}
+	mdss_mdp_cmd_ulps_enter(ctx);
 }
 
 static int mdss_mdp_cmd_add_vsync_handler(struct mdss_mdp_ctl *ctl,
@@ -649,13 +684,7 @@ int mdss_mdp_cmd_off_pan_on(struct mdss_mdp_ctl *ctl)
 	if (!ctx->ulps) {
 		pr_debug("%s: forcing ulps with panel always on feature\n",
 			__func__);
-		if (!mdss_mdp_ctl_intf_event(ctx->ctl,
-			MDSS_EVENT_DSI_ULPS_CTRL, (void *)1)) {
-			ctx->ulps = true;
-			ctx->ctl->play_cnt = 0;
-			mdss_mdp_footswitch_ctrl_ulps(0,
-				&ctx->ctl->mfd->pdev->dev);
-		}
+		mdss_mdp_cmd_ulps_enter(ctx);
 	}
 
 	return 0;
@@ -728,6 +757,12 @@ int mdss_mdp_cmd_stop(struct mdss_mdp_ctl *ctl)
 	mdss_mdp_set_intr_callback(MDSS_MDP_IRQ_PING_PONG_COMP, ctx->pp_num,
 				   NULL, NULL);
 
+	if (ctx->ulps) {
+		ctl->ulps_time_us += ktime_us_delta(ktime_get(),
+				ctl->ulps_start);
+		ctl->ulps_start = ktime_set(0, 0);
+	}
+
 	memset(ctx, 0, sizeof(*ctx));
 	ctl->priv_data = NULL;
 
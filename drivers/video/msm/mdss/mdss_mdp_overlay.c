@@ -21,10 +21,12 @@
 #include <linux/pm_runtime.h>
 #include <linux/uaccess.h>
 #include <linux/delay.h>
+#include <linux/dma-buf.h>
 #include <linux/msm_mdp.h>
 #include <linux/memblock.h>
 #include <linux/sort.h>
 #include <linux/sw_sync.h>
+#include <linux/cpu_boost.h>
 #include <soc/qcom/scm.h>
 
 #include <linux/msm_iommu_domains.h>
@@ -589,6 +591,7 @@ static int mdss_mdp_overlay_pipe_setup(struct msm_fb_data_type *mfd,
 		pipe->mfd = mfd;
 		pipe->pid = current->tgid;
 		pipe->play_cnt = 0;
+		pipe->setup_cached = false;
 	} else {
 		pipe = __overlay_find_pipe(mfd, req->id);
 		if (!pipe) {
@@ -844,11 +847,56 @@ exit_fail:
 		pr_debug("freeing allocations for pipe %d\n", pipe->num);
 		mdss_mdp_smp_unreserve(pipe);
 		pipe->params_changed = 0;
+		pipe->setup_cached = false;
 	}
 	mutex_unlock(&mdp5_data->list_lock);
 	return ret;
 }
 
+/*
+ * __overlay_pipe_setup_cached() - reuse a pipe setup for an unchanged layer
+ * @mfd: framebuffer data
+ * @req: overlay request, with the z_order already offset by stage 0
+ *
+ * Most frames keep the layer stack of the previous one and only queue new
+ * buffers.  If the request is identical to the one the pipe was last set up
+ * with and the pipe is still staged where it was, its format, scaling, smp
+ * and bandwidth setup are all still valid and the pipe is left untouched.
+ * Requests carrying post processing configuration always take the full
+ * path since their tables are passed by user pointer.
+ */
+static struct mdss_mdp_pipe *__overlay_pipe_setup_cached(
+		struct msm_fb_data_type *mfd, struct mdp_overlay *req)
+{
+	struct mdss_mdp_pipe *pipe;
+	struct mdss_mdp_mixer *mixer;
+
+	if ((req->id == MSMFB_NEW_REQUEST) ||
+			(req->flags & MDP_OVERLAY_PP_CFG_EN))
+		return NULL;
+
+	pipe = __overlay_find_pipe(mfd, req->id);
+	if (!pipe || !pipe->setup_cached || pipe->is_right_blend ||
+			pipe->src_split_req || !pipe->play_cnt)
+		return NULL;
+
+	mixer = pipe->mixer_left;
+	if (!mixer || (mixer->type != MDSS_MDP_MIXER_TYPE_INTF) ||
+			mixer->params_changed ||
+			(mixer->stage_pipe[req->z_order * MAX_PIPES_PER_STAGE] !=
+			 pipe))
+		return NULL;
+
+	if (memcmp(&pipe->setup_req, req, sizeof(*req)))
+		return NULL;
+
+	*req = pipe->req_data;
+	req->vert_deci = pipe->vert_deci;
+	pipe->has_buf = 0;
+
+	return pipe;
+}
+
 static int mdss_mdp_overlay_set(struct msm_fb_data_type *mfd,
 				struct mdp_overlay *req)
 {
@@ -871,10 +919,27 @@ static int mdss_mdp_overlay_set(struct msm_fb_data_type *mfd,
 	} else {
 		struct mdss_mdp_pipe *pipe;
 
+		struct mdss_data_type *mdata = mfd_to_mdata(mfd);
+		struct mdp_overlay setup_req;
+
 		/* userspace zorder start with stage 0 */
 		req->z_order += MDSS_MDP_STAGE_0;
 
-		ret = mdss_mdp_overlay_pipe_setup(mfd, req, &pipe, NULL);
+		mdata->pipe_setup_cnt++;
+		pipe = __overlay_pipe_setup_cached(mfd, req);
+		if (pipe) {
+			mdata->pipe_setup_skip_cnt++;
+		} else {
+			setup_req = *req;
+			ret = mdss_mdp_overlay_pipe_setup(mfd, req, &pipe,
+					NULL);
+			if (!ret) {
+				/* later requests refer to the allocated pipe */
+				setup_req.id = pipe->ndx;
+				pipe->setup_req = setup_req;
+				pipe->setup_cached = true;
+			}
+		}
 
 		req->z_order -= MDSS_MDP_STAGE_0;
 	}
@@ -1242,7 +1307,7 @@ static int __overlay_queue_pipes(struct msm_fb_data_type *mfd)
 
 		if (pipe->back_buf.num_planes) {
 			buf = &pipe->back_buf;
-		} else if (!pipe->params_changed) {
+		} else if (!pipe->params_changed && !ctl->roi_changed) {
 			continue;
 		} else if (pipe->front_buf.num_planes) {
 			buf = &pipe->front_buf;
@@ -1276,6 +1341,144 @@ static void __overlay_kickoff_requeue(struct msm_fb_data_type *mfd)
 	mdss_mdp_display_wait4comp(ctl);
 }
 
+static void __roi_union(struct mdss_mdp_img_rect *roi,
+		const struct mdss_mdp_img_rect *rect)
+{
+	int l, t, r, b;
+
+	if (!rect->w || !rect->h)
+		return;
+	if (!roi->w || !roi->h) {
+		*roi = *rect;
+		return;
+	}
+
+	l = min(roi->x, rect->x);
+	t = min(roi->y, rect->y);
+	r = max(roi->x + roi->w, rect->x + rect->w);
+	b = max(roi->y + roi->h, rect->y + rect->h);
+	*roi = (struct mdss_mdp_img_rect) {l, t, r - l, b - t};
+}
+
+/*
+ * Grow the region to the panel's ROI alignment and clip it to the mixer.
+ */
+static void __roi_align(struct mdss_mdp_img_rect *roi,
+		struct mdss_panel_info *pinfo, struct mdss_mdp_mixer *mixer)
+{
+	u32 l = roi->x, t = roi->y;
+	u32 r = roi->x + roi->w, b = roi->y + roi->h;
+
+	if (pinfo->xstart_pix_align)
+		l = rounddown(l, pinfo->xstart_pix_align);
+	if (pinfo->ystart_pix_align)
+		t = rounddown(t, pinfo->ystart_pix_align);
+	if (pinfo->width_pix_align)
+		r = l + roundup(r - l, pinfo->width_pix_align);
+	if (pinfo->height_pix_align)
+		b = t + roundup(b - t, pinfo->height_pix_align);
+
+	r = min(r, mixer->width);
+	b = min(b, mixer->height);
+	*roi = (struct mdss_mdp_img_rect) {l, t, r - l, b - t};
+}
+
+/*
+ * mdss_mdp_crop_rect() crops source and destination one to one, so only
+ * unscaled RGB layers that aren't compressed may be cut by the ROI.
+ */
+static bool __pipe_can_crop(struct mdss_mdp_pipe *pipe)
+{
+	return (pipe->src.w == pipe->dst.w) && (pipe->src.h == pipe->dst.h) &&
+		!pipe->horz_deci && !pipe->vert_deci && !pipe->bwc_mode &&
+		!(pipe->src_fmt && pipe->src_fmt->is_yuv);
+}
+
+/*
+ * __overlay_auto_roi() - work out the partial update region of a commit
+ * @mfd: framebuffer data
+ * @roi: filled in with the region, left empty for a full frame update
+ *
+ * When userspace doesn't pass a ROI to a command mode panel that supports
+ * partial update, only the area covered by layers that got a new buffer,
+ * moved, appeared or went away needs to go over DSI.  The region is then
+ * grown until every layer is either inside it or can be cropped to it, and
+ * aligned to what the panel accepts.  Called with the list lock held.
+ */
+static void __overlay_auto_roi(struct msm_fb_data_type *mfd,
+		struct mdp_rect *roi)
+{
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	struct mdss_mdp_ctl *ctl = mdp5_data->ctl;
+	struct mdss_panel_info *pinfo = &ctl->panel_data->panel_info;
+	struct mdss_mdp_mixer *mixer = ctl->mixer_left;
+	struct mdss_mdp_img_rect dirty = {0, 0, 0, 0};
+	struct mdss_mdp_img_rect res, prev;
+	struct mdss_mdp_pipe *pipe;
+	bool full = false;
+	bool grown;
+
+	memset(roi, 0, sizeof(*roi));
+
+	if (!pinfo->partial_update_enabled || pinfo->type != MIPI_CMD_PANEL ||
+			!mixer || ctl->mixer_right || !ctl->play_cnt ||
+			mixer->params_changed)
+		full = true;
+
+	list_for_each_entry(pipe, &mdp5_data->pipes_cleanup, list)
+		__roi_union(&dirty, &pipe->dst);
+
+	list_for_each_entry(pipe, &mdp5_data->pipes_used, list) {
+		struct mdss_mdp_data *buf = &pipe->back_buf;
+
+		if (pipe->src_split_req || pipe->is_right_blend ||
+				pipe->mixer_left != mixer)
+			full = true;
+
+		if (pipe->params_changed) {
+			if (pipe->play_cnt)
+				__roi_union(&dirty, &pipe->prev_dst);
+			__roi_union(&dirty, &pipe->dst);
+		} else if (buf->num_planes &&
+				(buf->num_planes != pipe->front_buf.num_planes ||
+				 buf->p[0].addr != pipe->front_buf.p[0].addr)) {
+			__roi_union(&dirty, &pipe->dst);
+		}
+
+		pipe->prev_dst = pipe->dst;
+	}
+
+	if (full || !dirty.w || !dirty.h)
+		return;
+
+	do {
+		grown = false;
+		__roi_align(&dirty, pinfo, mixer);
+
+		list_for_each_entry(pipe, &mdp5_data->pipes_used, list) {
+			mdss_mdp_intersect_rect(&res, &pipe->dst, &dirty);
+			if ((res.w == pipe->dst.w) && (res.h == pipe->dst.h))
+				continue;
+			if (res.w && res.h && __pipe_can_crop(pipe))
+				continue;
+
+			prev = dirty;
+			__roi_union(&dirty, &pipe->dst);
+			__roi_align(&dirty, pinfo, mixer);
+			if (memcmp(&prev, &dirty, sizeof(dirty)))
+				grown = true;
+		}
+	} while (grown);
+
+	if ((dirty.w == mixer->width) && (dirty.h == mixer->height))
+		return;
+
+	roi->x = dirty.x;
+	roi->y = dirty.y;
+	roi->w = dirty.w;
+	roi->h = dirty.h;
+}
+
 int mdss_mdp_overlay_kickoff(struct msm_fb_data_type *mfd,
 				struct mdp_display_commit *data)
 {
@@ -1313,8 +1516,15 @@ int mdss_mdp_overlay_kickoff(struct msm_fb_data_type *mfd,
 	mdss_mdp_ctl_notify(ctl, MDP_NOTIFY_FRAME_BEGIN);
 	mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_ON, false);
 
-	if (data)
+	if (data && data->roi.w && data->roi.h) {
 		mdss_mdp_set_roi(ctl, data);
+	} else {
+		struct mdp_display_commit commit;
+
+		memset(&commit, 0, sizeof(commit));
+		__overlay_auto_roi(mfd, &commit.roi);
+		mdss_mdp_set_roi(ctl, &commit);
+	}
 
 	/*
 	 * Setup pipe in solid fill before unstaging,
@@ -1568,6 +1778,18 @@ static int mdss_mdp_overlay_queue(struct msm_fb_data_type *mfd,
 	ret = mdss_mdp_overlay_get_buf(mfd, src_data, &req->data, 1, flags);
 	if (IS_ERR_VALUE(ret)) {
 		pr_err("src_data pmem error\n");
+	} else if (!(req->data.flags &
+		     (MDP_BLIT_SRC_GEM | MDP_MEMORY_ID_TYPE_FB))) {
+		struct dma_buf *dmabuf = dma_buf_get(req->data.memory_id);
+		struct sync_fence *fence = NULL;
+
+		if (!IS_ERR(dmabuf)) {
+			fence = dma_buf_get_fence(dmabuf);
+			dma_buf_put(dmabuf);
+		}
+		if (fence)
+			mdss_fb_add_implicit_fence(&mfd->mdp_sync_pt_data,
+						   fence);
 	}
 	pipe->has_buf = 1;
 	mdss_mdp_pipe_unmap(pipe);
@@ -1948,6 +2170,10 @@ int mdss_mdp_overlay_vsync_ctrl(struct msm_fb_data_type *mfd, int en)
 		rc = ctl->remove_vsync_handler(ctl, &ctl->vsync_handler);
 	mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_OFF, false);
 
+	/* the compositor is about to draw, let the GPU start waking up */
+	if (en && !rc && !mfd->index)
+		cpu_boost_vsync_hint();
+
 	return rc;
 }
 
@@ -2125,14 +2351,37 @@ static ssize_t mdss_mdp_ad_store(struct device *dev,
 	return count;
 }
 
+static ssize_t mdss_mdp_ulps_stats_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct fb_info *fbi = dev_get_drvdata(dev);
+	struct msm_fb_data_type *mfd = (struct msm_fb_data_type *)fbi->par;
+	struct mdss_overlay_private *mdp5_data = mfd_to_mdp5_data(mfd);
+	struct mdss_mdp_ctl *ctl = mdp5_data->ctl;
+	u64 ulps_us;
+
+	if (!ctl)
+		return -ENODEV;
+
+	ulps_us = ctl->ulps_time_us;
+	if (ktime_to_us(ctl->ulps_start))
+		ulps_us += ktime_us_delta(ktime_get(), ctl->ulps_start);
+
+	return scnprintf(buf, PAGE_SIZE,
+			"count=%u\ntime_ms=%llu\nactive=%d\n", ctl->ulps_cnt,
+			div_u64(ulps_us, USEC_PER_MSEC),
+			ktime_to_us(ctl->ulps_start) ? 1 : 0);
+}
 
 static DEVICE_ATTR(vsync_event, S_IRUGO, mdss_mdp_vsync_show_event, NULL);
 static DEVICE_ATTR(ad, S_IRUGO | S_IWUSR | S_IWGRP, mdss_mdp_ad_show,
 	mdss_mdp_ad_store);
+static DEVICE_ATTR(ulps_stats, S_IRUGO, mdss_mdp_ulps_stats_show, NULL);
 
 static struct attribute *mdp_overlay_sysfs_attrs[] = {
 	&dev_attr_vsync_event.attr,
 	&dev_attr_ad.attr,
+	&dev_attr_ulps_stats.attr,
 	NULL,
 };
 
@@ -20,6 +20,7 @@
 #include <linux/uaccess.h>
 #include <linux/spinlock.h>
 #include <linux/delay.h>
+#include <linux/jhash.h>
 #include <linux/msm-bus.h>
 #include <linux/msm-bus-board.h>
 
@@ -337,6 +338,31 @@ struct mdss_pp_res_type {
 static DEFINE_MUTEX(mdss_pp_mutex);
 static struct mdss_pp_res_type *mdss_pp_res;
 
+enum pp_lut_blk {
+	PP_LUT_PA,
+	PP_LUT_PCC,
+	PP_LUT_IGC,
+	PP_LUT_ENHIST,
+	PP_LUT_DITHER,
+	PP_LUT_GAMUT,
+	PP_LUT_PGC,
+	PP_LUT_MAX,
+};
+
+/*
+ * Hash of the table contents last written to each DSPP block, so that
+ * configurations that are reapplied unchanged (by userspace, or by
+ * mdss_mdp_pp_resume() when the registers were retained) don't rewrite
+ * the LUTs.  Protected by mdss_pp_mutex.
+ */
+struct pp_lut_cache {
+	u32 valid;
+	u32 hash[PP_LUT_MAX];
+	u32 opmode;
+};
+
+static struct pp_lut_cache pp_lut_cache[MDSS_MDP_MAX_DSPP];
+
 static u32 pp_hist_read(char __iomem *v_addr,
 				struct pp_hist_col_info *hist_info);
 static int pp_hist_setup(u32 *op, u32 block, struct mdss_mdp_mixer *mix);
@@ -1542,10 +1568,121 @@ static void pp_dspp_opmode_config(struct mdss_mdp_ctl *ctl, u32 num,
 		*opmode |= MDSS_MDP_DSPP_OP_ARGC_LUT_EN;
 }
 
+/*
+ * Returns true if @hash matches what was last programmed to block @blk of
+ * the dspp, otherwise records it as the new contents.
+ */
+static bool pp_lut_cached(u32 dspp_num, enum pp_lut_blk blk, u32 hash)
+{
+	struct pp_lut_cache *cache = &pp_lut_cache[dspp_num];
+
+	if ((cache->valid & BIT(blk)) && (cache->hash[blk] == hash))
+		return true;
+
+	cache->hash[blk] = hash;
+	cache->valid |= BIT(blk);
+	return false;
+}
+
+static void pp_lut_cache_invalidate(void)
+{
+	mutex_lock(&mdss_pp_mutex);
+	memset(pp_lut_cache, 0, sizeof(pp_lut_cache));
+	mutex_unlock(&mdss_pp_mutex);
+}
+
+static u32 pp_pa_hash(struct mdp_pa_cfg *cfg)
+{
+	return jhash(&cfg->hue_adj, sizeof(*cfg) -
+			offsetof(struct mdp_pa_cfg, hue_adj),
+			cfg->flags & ~MDP_PP_OPS_WRITE);
+}
+
+static u32 pp_pa_v2_hash(struct mdp_pa_v2_data *cfg)
+{
+	u32 hash;
+
+	hash = jhash(&cfg->global_hue_adj,
+			offsetof(struct mdp_pa_v2_data, six_zone_curve_p0) -
+			offsetof(struct mdp_pa_v2_data, global_hue_adj),
+			cfg->flags & ~MDP_PP_OPS_WRITE);
+	if (cfg->six_zone_len) {
+		hash = jhash2(cfg->six_zone_curve_p0, cfg->six_zone_len, hash);
+		hash = jhash2(cfg->six_zone_curve_p1, cfg->six_zone_len, hash);
+	}
+	return hash;
+}
+
+static u32 pp_igc_hash(struct mdp_igc_lut_data *cfg)
+{
+	u32 hash;
+
+	hash = jhash2(cfg->c0_c1_data, cfg->len, cfg->len);
+	return jhash2(cfg->c2_data, cfg->len, hash);
+}
+
+static u32 pp_gamut_hash(struct mdp_gamut_cfg_data *cfg)
+{
+	u32 hash = cfg->gamut_first;
+	int i;
+
+	for (i = 0; i < MDP_GAMUT_TABLE_NUM; i++) {
+		hash = jhash(cfg->r_tbl[i], cfg->tbl_size[i] * sizeof(u16),
+				hash + cfg->tbl_size[i]);
+		hash = jhash(cfg->g_tbl[i], cfg->tbl_size[i] * sizeof(u16),
+				hash);
+		hash = jhash(cfg->b_tbl[i], cfg->tbl_size[i] * sizeof(u16),
+				hash);
+	}
+	return hash;
+}
+
+static u32 pp_pgc_hash(struct mdp_pgc_lut_data *cfg)
+{
+	u32 hash;
+
+	hash = jhash(cfg->r_data, cfg->num_r_stages * sizeof(*cfg->r_data),
+			cfg->num_r_stages);
+	hash = jhash(cfg->g_data, cfg->num_g_stages * sizeof(*cfg->g_data),
+			hash + cfg->num_g_stages);
+	return jhash(cfg->b_data, cfg->num_b_stages * sizeof(*cfg->b_data),
+			hash + cfg->num_b_stages);
+}
+
+/*
+ * Called on display on.  If the dspp registers kept their contents (the
+ * op mode still reads back as last written), the LUT cache stays valid and
+ * the configurations reapplied by mdss_mdp_pp_resume() only update state.
+ */
+static void pp_lut_cache_resume(u32 dspp_num)
+{
+	struct pp_lut_cache *cache = &pp_lut_cache[dspp_num];
+	char __iomem *base = mdss_mdp_get_dspp_addr_off(dspp_num);
+	u32 opmode;
+
+	mutex_lock(&mdss_pp_mutex);
+	mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_ON, false);
+	opmode = readl_relaxed(base + MDSS_MDP_REG_DSPP_OP_MODE);
+	mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_OFF, false);
+
+	if (!cache->opmode || (opmode != cache->opmode)) {
+		pr_debug("dspp%d lost state, op mode %x\n", dspp_num, opmode);
+		memset(cache, 0, sizeof(*cache));
+	}
+	mutex_unlock(&mdss_pp_mutex);
+}
+
 static int pp_dspp_setup(u32 disp_num, struct mdss_mdp_mixer *mixer)
 {
 	u32 ad_flags, flags, dspp_num, opmode = 0, ad_bypass;
-	struct mdp_pgc_lut_data *pgc_config;
+	struct mdp_pgc_lut_data pgc_config;
+	struct mdp_pa_cfg pa_config;
+	struct mdp_pa_v2_data pa_v2_config;
+	struct mdp_pcc_cfg_data pcc_config;
+	struct mdp_igc_lut_data igc_config;
+	struct mdp_hist_lut_data enhist_config;
+	struct mdp_dither_cfg_data dither_config;
+	struct mdp_gamut_cfg_data gamut_config;
 	struct pp_sts_type *pp_sts;
 	char __iomem *base, *addr;
 	int ret = 0;
@@ -1598,23 +1735,61 @@ static int pp_dspp_setup(u32 disp_num, struct mdss_mdp_mixer *mixer)
 
 	pp_sts = &mdss_pp_res->pp_disp_sts[disp_num];
 
+	/*
+	 * Work on copies of the configurations so the write op can be
+	 * dropped for tables this dspp already holds, while the enable
+	 * state is still applied.
+	 */
 	if (mdata->mdp_rev >= MDSS_MDP_HW_REV_103) {
+		pa_v2_config = mdss_pp_res->pa_v2_disp_cfg[disp_num];
+		if ((flags & PP_FLAGS_DIRTY_PA) &&
+				(pa_v2_config.flags & MDP_PP_OPS_WRITE) &&
+				pp_lut_cached(dspp_num, PP_LUT_PA,
+					pp_pa_v2_hash(&pa_v2_config))) {
+			/* state is only updated along with the registers */
+			flags &= ~PP_FLAGS_DIRTY_PA;
+		}
 		pp_pa_v2_config(flags, base + MDSS_MDP_REG_DSPP_PA_BASE, pp_sts,
-				&mdss_pp_res->pa_v2_disp_cfg[disp_num],
-				PP_DSPP);
-	} else
+				&pa_v2_config, PP_DSPP);
+	} else {
+		pa_config = mdss_pp_res->pa_disp_cfg[disp_num];
+		if ((flags & PP_FLAGS_DIRTY_PA) &&
+				(pa_config.flags & MDP_PP_OPS_WRITE) &&
+				pp_lut_cached(dspp_num, PP_LUT_PA,
+					pp_pa_hash(&pa_config)))
+			pa_config.flags &= ~MDP_PP_OPS_WRITE;
 		pp_pa_config(flags, base + MDSS_MDP_REG_DSPP_PA_BASE, pp_sts,
-				&mdss_pp_res->pa_disp_cfg[disp_num]);
+				&pa_config);
+	}
 
+	pcc_config = mdss_pp_res->pcc_disp_cfg[disp_num];
+	if ((flags & PP_FLAGS_DIRTY_PCC) &&
+			(pcc_config.ops & MDP_PP_OPS_WRITE) &&
+			pp_lut_cached(dspp_num, PP_LUT_PCC,
+				jhash(&pcc_config.r, 3 * sizeof(pcc_config.r),
+					0)))
+		pcc_config.ops &= ~MDP_PP_OPS_WRITE;
 	pp_pcc_config(flags, base + MDSS_MDP_REG_DSPP_PCC_BASE, pp_sts,
-					&mdss_pp_res->pcc_disp_cfg[disp_num]);
-
+			&pcc_config);
+
+	igc_config = mdss_pp_res->igc_disp_cfg[disp_num];
+	if ((flags & PP_FLAGS_DIRTY_IGC) &&
+			(igc_config.ops & MDP_PP_OPS_WRITE) &&
+			pp_lut_cached(dspp_num, PP_LUT_IGC,
+				pp_igc_hash(&igc_config)))
+		igc_config.ops &= ~MDP_PP_OPS_WRITE;
 	pp_igc_config(flags, mdata->mdp_base + MDSS_MDP_REG_IGC_DSPP_BASE,
-				pp_sts, &mdss_pp_res->igc_disp_cfg[disp_num],
-				dspp_num);
-
+				pp_sts, &igc_config, dspp_num);
+
+	enhist_config = mdss_pp_res->enhist_disp_cfg[disp_num];
+	if ((flags & PP_FLAGS_DIRTY_ENHIST) &&
+			(enhist_config.ops & MDP_PP_OPS_WRITE) &&
+			pp_lut_cached(dspp_num, PP_LUT_ENHIST,
+				jhash2(enhist_config.data, enhist_config.len,
+					enhist_config.len)))
+		enhist_config.ops &= ~MDP_PP_OPS_WRITE;
 	pp_enhist_config(flags, base + MDSS_MDP_REG_DSPP_HIST_LUT_BASE,
-			pp_sts, &mdss_pp_res->enhist_disp_cfg[disp_num]);
+			pp_sts, &enhist_config);
 
 	if (pp_sts->enhist_sts & PP_STS_ENABLE &&
 			!(pp_sts->pa_sts & PP_STS_ENABLE)) {
@@ -1626,25 +1801,37 @@ static int pp_dspp_setup(u32 disp_num, struct mdss_mdp_mixer *mixer)
 		writel_relaxed(0, addr + 12);
 	}
 	if (flags & PP_FLAGS_DIRTY_DITHER) {
+		dither_config = mdss_pp_res->dither_disp_cfg[disp_num];
+		if ((dither_config.flags & MDP_PP_OPS_WRITE) &&
+				pp_lut_cached(dspp_num, PP_LUT_DITHER,
+					jhash(&dither_config.g_y_depth,
+						3 * sizeof(u32), 0)))
+			dither_config.flags &= ~MDP_PP_OPS_WRITE;
 		addr = base + MDSS_MDP_REG_DSPP_DITHER_DEPTH;
-		pp_dither_config(addr, pp_sts,
-				&mdss_pp_res->dither_disp_cfg[disp_num]);
+		pp_dither_config(addr, pp_sts, &dither_config);
+	}
+	if (flags & PP_FLAGS_DIRTY_GAMUT) {
+		gamut_config = mdss_pp_res->gamut_disp_cfg[disp_num];
+		if ((gamut_config.flags & MDP_PP_OPS_WRITE) &&
+				pp_lut_cached(dspp_num, PP_LUT_GAMUT,
+					pp_gamut_hash(&gamut_config)))
+			gamut_config.flags &= ~MDP_PP_OPS_WRITE;
+		pp_gamut_config(&gamut_config, base, pp_sts);
 	}
-	if (flags & PP_FLAGS_DIRTY_GAMUT)
-		pp_gamut_config(&mdss_pp_res->gamut_disp_cfg[disp_num], base,
-				pp_sts);
 
 	if (flags & PP_FLAGS_DIRTY_PGC) {
-		pgc_config = &mdss_pp_res->pgc_disp_cfg[disp_num];
-		if (pgc_config->flags & MDP_PP_OPS_WRITE) {
+		pgc_config = mdss_pp_res->pgc_disp_cfg[disp_num];
+		if ((pgc_config.flags & MDP_PP_OPS_WRITE) &&
+				!pp_lut_cached(dspp_num, PP_LUT_PGC,
+					pp_pgc_hash(&pgc_config))) {
 			addr = base + MDSS_MDP_REG_DSPP_GC_BASE;
-			pp_update_argc_lut(addr, pgc_config);
+			pp_update_argc_lut(addr, &pgc_config);
 		}
-		if (pgc_config->flags & MDP_PP_OPS_DISABLE)
+		if (pgc_config.flags & MDP_PP_OPS_DISABLE)
 			pp_sts->pgc_sts &= ~PP_STS_ENABLE;
-		else if (pgc_config->flags & MDP_PP_OPS_ENABLE)
+		else if (pgc_config.flags & MDP_PP_OPS_ENABLE)
 			pp_sts->pgc_sts |= PP_STS_ENABLE;
-		pp_sts_set_split_bits(&pp_sts->pgc_sts, pgc_config->flags);
+		pp_sts_set_split_bits(&pp_sts->pgc_sts, pgc_config.flags);
 	}
 
 	pp_dspp_opmode_config(ctl, dspp_num, pp_sts, mdata->mdp_rev, &opmode);
@@ -1665,6 +1852,7 @@ flush_exit:
 	}
 
 	writel_relaxed(opmode, base + MDSS_MDP_REG_DSPP_OP_MODE);
+	pp_lut_cache[dspp_num].opmode = opmode;
 
 	if (dspp_num == MDSS_MDP_DSPP3)
 		ctl->flush_bits |= BIT(21);
@@ -1780,6 +1968,8 @@ int mdss_mdp_pp_resume(struct mdss_mdp_ctl *ctl, u32 dspp_num)
 	}
 	disp_num = ctl->mfd->index;
 
+	pp_lut_cache_resume(dspp_num);
+
 	if (dspp_num < mdata->nad_cfgs) {
 		ret = mdss_mdp_get_ad(ctl->mfd, &ad);
 		if (ret)
@@ -5199,6 +5389,9 @@ int mdss_mdp_calib_config(struct mdp_calib_config_data *cfg, u32 *copyback)
 		ret = 0;
 	}
 	mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_OFF, false);
+
+	if (cfg->ops & MDP_PP_OPS_WRITE)
+		pp_lut_cache_invalidate();
 	return ret;
 }
 
@@ -5270,6 +5463,9 @@ int mdss_mdp_calib_config_buffer(struct mdp_calib_config_buffer *cfg,
 
 	mdss_mdp_clk_ctrl(MDP_BLOCK_POWER_OFF, false);
 
+	if (cfg->ops & MDP_PP_OPS_WRITE)
+		pp_lut_cache_invalidate();
+
 	kfree(buff_org);
 	return ret;
 }
@@ -16,6 +16,7 @@
 #include <linux/errno.h>
 #include <linux/list.h>
 #include <linux/mutex.h>
+#include <linux/slab.h>
 #include <linux/types.h>
 #include <linux/sync.h>
 #include <linux/sw_sync.h>
@@ -30,10 +31,33 @@ static DEFINE_MUTEX(rotator_lock);
 static struct mdss_mdp_rotator_session rotator_session[MAX_ROTATOR_SESSIONS];
 static LIST_HEAD(rotator_queue);
 
+/**
+ * struct mdss_mdp_rotator_job - rotation queued on a session with sync points
+ * @list:	Entry in the job queue of the session
+ * @src_buf:	Buffer to rotate
+ * @dst_buf:	Buffer to write the rotated image to
+ * @fence_cnt:	Number of acquire fences still to wait on
+ * @fences:	Acquire fences taken from the session at queue time
+ * @cancelled:	Session was released while the job waited on its fences
+ *
+ * Each job holds one count on the commit_cnt of the session timeline, so
+ * the release fence handed out for it signals once it is done.
+ */
+struct mdss_mdp_rotator_job {
+	struct list_head list;
+	struct mdss_mdp_data src_buf;
+	struct mdss_mdp_data dst_buf;
+	int fence_cnt;
+	struct sync_fence *fences[2 * MDP_MAX_FENCE_FD];
+	bool cancelled;
+};
+
 static int mdss_mdp_rotator_finish(struct mdss_mdp_rotator_session *rot);
 static void mdss_mdp_rotator_commit_wq_handler(struct work_struct *work);
 static int mdss_mdp_rotator_busy_wait(struct mdss_mdp_rotator_session *rot);
-static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot);
+static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot,
+					 struct mdss_mdp_data *src_data,
+					 struct mdss_mdp_data *dst_data);
 static struct msm_sync_pt_data *mdss_mdp_rotator_sync_pt_create(
 			struct mdss_mdp_rotator_session *rot);
 
@@ -50,6 +74,7 @@ static struct mdss_mdp_rotator_session *mdss_mdp_rotator_session_alloc(void)
 			mutex_init(&rot->lock);
 			INIT_LIST_HEAD(&rot->head);
 			INIT_LIST_HEAD(&rot->list);
+			INIT_LIST_HEAD(&rot->job_queue);
 			break;
 		}
 	}
@@ -292,26 +317,51 @@ error:
 	return ret;
 }
 
+static void mdss_mdp_rotator_job_free(struct mdss_mdp_rotator_job *job)
+{
+	int i;
+
+	mdss_mdp_overlay_free_buf(&job->src_buf);
+	mdss_mdp_overlay_free_buf(&job->dst_buf);
+	for (i = 0; i < job->fence_cnt; i++)
+		sync_fence_put(job->fences[i]);
+	kfree(job);
+}
+
 static void mdss_mdp_rotator_commit_wq_handler(struct work_struct *work)
 {
 	struct mdss_mdp_rotator_session *rot;
+	struct mdss_mdp_rotator_job *job;
+	struct msm_sync_pt_data *sync_pt_data;
 	int ret;
 
 	rot = container_of(work, struct mdss_mdp_rotator_session, commit_work);
+	sync_pt_data = rot->rot_sync_pt_data;
 
 	mutex_lock(&rotator_lock);
+	while (!list_empty(&rot->job_queue)) {
+		job = list_first_entry(&rot->job_queue,
+				       struct mdss_mdp_rotator_job, list);
+		list_del_init(&job->list);
+		rot->active_job = job;
+		mutex_unlock(&rotator_lock);
+
+		/* other sessions may use the rotator while this one waits */
+		mdss_fb_wait_fences(sync_pt_data, job->fences, job->fence_cnt);
+		job->fence_cnt = 0;
+
+		mutex_lock(&rotator_lock);
+		rot->active_job = NULL;
+		if (!job->cancelled) {
+			ret = mdss_mdp_rotator_queue_helper(rot,
+					&job->src_buf, &job->dst_buf);
+			if (ret)
+				pr_err("rotator queue failed\n");
+		}
 
-	ret = mdss_mdp_rotator_queue_helper(rot);
-	if (ret)
-		pr_err("rotator queue failed\n");
-
-	if (rot->rot_sync_pt_data) {
-		atomic_inc(&rot->rot_sync_pt_data->commit_cnt);
-		mdss_fb_signal_timeline(rot->rot_sync_pt_data);
-	} else {
-		pr_err("rot_sync_pt_data is NULL\n");
+		mdss_mdp_rotator_job_free(job);
+		mdss_fb_signal_timeline(sync_pt_data);
 	}
-
 	mutex_unlock(&rotator_lock);
 }
 
@@ -352,13 +402,12 @@ static int mdss_mdp_rotator_busy_wait_ex(struct mdss_mdp_rotator_session *rot)
 	for (tmp = rot; tmp; tmp = tmp->next)
 		mdss_mdp_rotator_busy_wait(tmp);
 
-	if (rot->use_sync_pt)
-		mdss_fb_wait_for_fence(rot->rot_sync_pt_data);
-
 	return 0;
 }
 
-static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot)
+static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot,
+					 struct mdss_mdp_data *src_data,
+					 struct mdss_mdp_data *dst_data)
 {
 	int ret;
 	struct mdss_mdp_rotator_session *tmp;
@@ -366,8 +415,7 @@ static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot)
 	pr_debug("rotator session=%x start\n", rot->session_id);
 
 	for (ret = 0, tmp = rot; ret == 0 && tmp; tmp = tmp->next)
-		ret = mdss_mdp_rotator_queue_sub(tmp,
-				&rot->src_buf, &rot->dst_buf);
+		ret = mdss_mdp_rotator_queue_sub(tmp, src_data, dst_data);
 
 	if (ret) {
 		pr_err("rotation failed %d for rot=%d\n", ret, rot->session_id);
@@ -382,18 +430,65 @@ static int mdss_mdp_rotator_queue_helper(struct mdss_mdp_rotator_session *rot)
 
 static int mdss_mdp_rotator_queue(struct mdss_mdp_rotator_session *rot)
 {
-	int ret = 0;
+	int ret;
 
-	if (rot->use_sync_pt)
-		schedule_work(&rot->commit_work);
-	else
-		ret = mdss_mdp_rotator_queue_helper(rot);
+	ret = mdss_mdp_rotator_queue_helper(rot, &rot->src_buf, &rot->dst_buf);
 
 	pr_debug("rotator session=%x queue done\n", rot->session_id);
 
 	return ret;
 }
 
+/**
+ * mdss_mdp_rotator_queue_job() - queue a rotation on a session with sync pts
+ * @mfd:	Msm frame buffer data structure for the associated fb
+ * @rot:	Rotator session
+ * @req:	Source and destination buffers of the rotation
+ * @flgs:	Flags for mapping the buffers
+ *
+ * The job takes over the acquire fences set up by the last buffer sync
+ * ioctl and runs from the commit work of the session, so that the caller
+ * can go on with the next frame instead of waiting for the previous
+ * rotation to finish. Completion is reported through the release fence.
+ */
+static int mdss_mdp_rotator_queue_job(struct msm_fb_data_type *mfd,
+				      struct mdss_mdp_rotator_session *rot,
+				      struct msmfb_overlay_data *req, u32 flgs)
+{
+	struct mdss_mdp_rotator_job *job;
+	int ret;
+
+	job = kzalloc(sizeof(*job), GFP_KERNEL);
+	if (!job)
+		return -ENOMEM;
+
+	ret = mdss_mdp_overlay_get_buf(mfd, &job->src_buf, &req->data, 1, flgs);
+	if (ret) {
+		pr_err("src_data pmem error\n");
+		goto error;
+	}
+
+	ret = mdss_mdp_overlay_get_buf(mfd, &job->dst_buf,
+			&req->dst_data, 1, flgs);
+	if (ret) {
+		pr_err("dst_data pmem error\n");
+		goto error;
+	}
+
+	job->fence_cnt = mdss_fb_take_fences(rot->rot_sync_pt_data,
+					     job->fences);
+	atomic_inc(&rot->rot_sync_pt_data->commit_cnt);
+	list_add_tail(&job->list, &rot->job_queue);
+	schedule_work(&rot->commit_work);
+
+	pr_debug("rotator session=%x job queued\n", rot->session_id);
+
+	return 0;
+error:
+	mdss_mdp_rotator_job_free(job);
+	return ret;
+}
+
 /*
  * Try to reserve hardware resources for rotator session if possible, if this
  * is not possible we may still have a chance to reuse existing pipes used by
@@ -618,6 +713,7 @@ static int mdss_mdp_rotator_finish(struct mdss_mdp_rotator_session *rot)
 	int ret = 0;
 	struct msm_sync_pt_data *rot_sync_pt_data;
 	struct work_struct commit_work;
+	struct mdss_mdp_rotator_job *job, *tmp_job;
 
 	if (!rot)
 		return -ENODEV;
@@ -636,11 +732,21 @@ static int mdss_mdp_rotator_finish(struct mdss_mdp_rotator_session *rot)
 	if (!list_empty(&rot->list))
 		list_del(&rot->list);
 
+	/* drop queued jobs, the work frees the one waiting on its fences */
+	list_for_each_entry_safe(job, tmp_job, &rot->job_queue, list) {
+		list_del(&job->list);
+		mdss_mdp_rotator_job_free(job);
+		mdss_fb_signal_timeline(rot->rot_sync_pt_data);
+	}
+	if (rot->active_job)
+		rot->active_job->cancelled = true;
+
 	rot_sync_pt_data = rot->rot_sync_pt_data;
 	commit_work = rot->commit_work;
 	memset(rot, 0, sizeof(*rot));
 	rot->rot_sync_pt_data = rot_sync_pt_data;
 	rot->commit_work = commit_work;
+	INIT_LIST_HEAD(&rot->job_queue);
 
 	if (rot_pipe) {
 		struct mdss_mdp_mixer *mixer = rot_pipe->mixer_left;
@@ -706,15 +812,24 @@ int mdss_mdp_rotator_play(struct msm_fb_data_type *mfd,
 
 	flgs = rot->flags & MDP_SECURE_OVERLAY_SESSION;
 
-	ret = mdss_mdp_rotator_busy_wait_ex(rot);
-	if (ret) {
-		pr_err("rotator busy wait error\n");
-		goto dst_buf_fail;
+	if (!rot->use_sync_pt) {
+		ret = mdss_mdp_rotator_busy_wait_ex(rot);
+		if (ret) {
+			pr_err("rotator busy wait error\n");
+			goto dst_buf_fail;
+		}
 	}
 
 	if (!mfd->panel_info->cont_splash_enabled)
 		mdss_iommu_attach(mdp5_data->mdata);
 
+	if (rot->use_sync_pt) {
+		ret = mdss_mdp_rotator_queue_job(mfd, rot, req, flgs);
+		if (ret)
+			pr_err("rotator queue error session id=%x\n", req->id);
+		goto dst_buf_fail;
+	}
+
 	mdss_mdp_overlay_free_buf(&rot->src_buf);
 	ret = mdss_mdp_overlay_get_buf(mfd, &rot->src_buf, &req->data, 1, flgs);
 	if (ret) {
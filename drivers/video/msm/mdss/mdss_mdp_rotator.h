@@ -49,6 +49,8 @@ struct mdss_mdp_rotator_session {
 	struct mdss_mdp_rotator_session *next;
 	struct msm_sync_pt_data *rot_sync_pt_data;
 	struct work_struct commit_work;
+	struct list_head job_queue;
+	struct mdss_mdp_rotator_job *active_job;
 };
 
 static inline u32 mdss_mdp_get_rotator_dst_format(u32 in_format, u8 in_rot90,
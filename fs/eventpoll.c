@@ -42,6 +42,7 @@
 #include <linux/proc_fs.h>
 #include <linux/seq_file.h>
 #include <linux/compat.h>
+#include <linux/hrtimer.h>
 
 /*
  * LOCKING:
@@ -92,7 +93,10 @@
  */
 
 /* Epoll private bits inside the event mask */
-#define EP_PRIVATE_BITS (EPOLLWAKEUP | EPOLLONESHOT | EPOLLET)
+#define EP_PRIVATE_BITS (EPOLLBATCH | EPOLLWAKEUP | EPOLLONESHOT | EPOLLET)
+
+/* Ready events that are never held back by wakeup batching */
+#define EP_BATCH_URGENT (POLLPRI | POLLERR | POLLHUP | POLLRDHUP)
 
 /* Maximum number of nesting allowed inside epoll sets */
 #define EP_MAX_NESTS 4
@@ -215,6 +219,16 @@ struct eventpoll {
 	/* used to optimize loop detection check */
 	int visited;
 	struct list_head visited_list_link;
+
+	/*
+	 * Wakeup batching, see EPOLL_CTL_BATCH. Waiters are woken once
+	 * batch_events EPOLLBATCH items got ready, or batch_usecs after
+	 * the first of them did. Protected by "lock".
+	 */
+	struct hrtimer batch_timer;
+	unsigned int batch_events;
+	unsigned int batch_usecs;
+	unsigned int batch_pending;
 };
 
 /* Wait structure used by the poll hooks */
@@ -612,6 +626,7 @@ static int ep_scan_ready_list(struct eventpoll *ep,
 	spin_lock_irqsave(&ep->lock, flags);
 	list_splice_init(&ep->rdllist, &txlist);
 	ep->ovflist = NULL;
+	ep->batch_pending = 0;
 	spin_unlock_irqrestore(&ep->lock, flags);
 
 	/*
@@ -761,6 +776,8 @@ static void ep_free(struct eventpoll *ep)
 	mutex_destroy(&ep->mtx);
 	free_uid(ep->user);
 	wakeup_source_unregister(ep->ws);
+	/* no poll callback can arm it anymore */
+	hrtimer_cancel(&ep->batch_timer);
 	kfree(ep);
 }
 
@@ -903,6 +920,86 @@ void eventpoll_release_file(struct file *file)
 	mutex_unlock(&epmutex);
 }
 
+/*
+ * Fires batch_usecs after the first deferred wakeup and delivers it,
+ * along with those of any batched events that got ready since.
+ */
+static enum hrtimer_restart ep_batch_timer_fn(struct hrtimer *timer)
+{
+	struct eventpoll *ep = container_of(timer, struct eventpoll,
+					    batch_timer);
+	unsigned long flags;
+	int pwake = 0;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	ep->batch_pending = 0;
+	if (ep_events_available(ep)) {
+		if (waitqueue_active(&ep->wq))
+			wake_up_locked(&ep->wq);
+		if (waitqueue_active(&ep->poll_wait))
+			pwake++;
+	}
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	/* We have to call this outside the lock */
+	if (pwake)
+		ep_poll_safewake(&ep->poll_wait);
+
+	return HRTIMER_NORESTART;
+}
+
+/*
+ * Called with "lock" held once @epi is on the ready list. Returns true
+ * if waking up the waiters can be left to the batch timer, arming it if
+ * it is not already pending or running.
+ */
+static bool ep_batch_defer(struct eventpoll *ep, struct epitem *epi,
+			   unsigned long key)
+{
+	if (!ep->batch_usecs || !(epi->event.events & EPOLLBATCH) ||
+	    (key & EP_BATCH_URGENT))
+		goto wake;
+
+	if (ep->batch_events && ++ep->batch_pending >= ep->batch_events)
+		goto wake;
+
+	if (!hrtimer_active(&ep->batch_timer))
+		hrtimer_start(&ep->batch_timer,
+			      ns_to_ktime((u64)ep->batch_usecs * NSEC_PER_USEC),
+			      HRTIMER_MODE_REL);
+	return true;
+
+wake:
+	ep->batch_pending = 0;
+	hrtimer_try_to_cancel(&ep->batch_timer);
+	return false;
+}
+
+/*
+ * EPOLL_CTL_BATCH: @epds->events is the number of batched events that
+ * wakes the waiters at once, 0 for none, and @epds->data the longest a
+ * wakeup may be held back in microseconds, 0 to disable batching.
+ */
+static int ep_set_batch(struct eventpoll *ep, struct epoll_event *epds)
+{
+	unsigned long flags;
+
+	if (epds->data > USEC_PER_SEC || (epds->events && !epds->data))
+		return -EINVAL;
+
+	spin_lock_irqsave(&ep->lock, flags);
+	ep->batch_events = epds->events;
+	ep->batch_usecs = epds->data;
+	ep->batch_pending = 0;
+	spin_unlock_irqrestore(&ep->lock, flags);
+
+	/* deliver anything held back under the old setting */
+	if (hrtimer_try_to_cancel(&ep->batch_timer) > 0)
+		ep_batch_timer_fn(&ep->batch_timer);
+
+	return 0;
+}
+
 static int ep_alloc(struct eventpoll **pep)
 {
 	int error;
@@ -923,6 +1020,8 @@ static int ep_alloc(struct eventpoll **pep)
 	ep->rbr = RB_ROOT;
 	ep->ovflist = EP_UNACTIVE_PTR;
 	ep->user = user;
+	hrtimer_init(&ep->batch_timer, CLOCK_MONOTONIC, HRTIMER_MODE_REL);
+	ep->batch_timer.function = ep_batch_timer_fn;
 
 	*pep = ep;
 
@@ -1033,6 +1132,9 @@ static int ep_poll_callback(wait_queue_t *wait, unsigned mode, int sync, void *k
 		ep_pm_stay_awake_rcu(epi);
 	}
 
+	if (ep_batch_defer(ep, epi, (unsigned long)key))
+		goto out_unlock;
+
 	/*
 	 * Wake up ( if active ) both the eventpoll wait list and the ->poll()
 	 * wait list.
@@ -1808,6 +1910,13 @@ SYSCALL_DEFINE4(epoll_ctl, int, epfd, int, op, int, fd,
 	if (!file)
 		goto error_return;
 
+	if (op == EPOLL_CTL_BATCH) {
+		error = -EINVAL;
+		if (fd == epfd && is_file_epoll(file))
+			error = ep_set_batch(file->private_data, &epds);
+		goto error_fput;
+	}
+
 	/* Get the "struct file *" for the target file */
 	tfile = fget(fd);
 	if (!tfile)
@@ -178,8 +178,11 @@ static struct posix_acl *__f2fs_get_acl(struct inode *inode, int type,
 	if (acl != ACL_NOT_CACHED)
 		return acl;
 
-	if (type == ACL_TYPE_ACCESS)
+	if (type == ACL_TYPE_ACCESS) {
+		/* an RCU walk permission check had to drop out for this */
+		stat_inc_acl_miss(inode);
 		name_index = F2FS_XATTR_INDEX_POSIX_ACL_ACCESS;
+	}
 
 	retval = f2fs_getxattr(inode, name_index, "", NULL, 0, dpage);
 	if (retval > 0) {
@@ -209,6 +212,56 @@ struct posix_acl *f2fs_get_acl(struct inode *inode, int type)
 	return __f2fs_get_acl(inode, type, NULL);
 }
 
+/*
+ * Look for ACL entries in the inline xattrs of @ipage.  Returns false
+ * if there may be one, including when the list does not end there.
+ */
+static bool f2fs_inline_xattrs_have_no_acl(struct inode *inode,
+						struct page *ipage)
+{
+	void *base_addr = inline_xattr_addr(ipage);
+	void *end = base_addr + inline_xattr_size(inode);
+	struct f2fs_xattr_entry *entry;
+
+	if (le32_to_cpu(XATTR_HDR(base_addr)->h_magic) != F2FS_XATTR_MAGIC)
+		return true;
+
+	for (entry = XATTR_FIRST_ENTRY(base_addr);
+			(void *)entry + sizeof(__u32) <= end;
+			entry = XATTR_NEXT_ENTRY(entry)) {
+		if (IS_XATTR_LAST_ENTRY(entry))
+			return true;
+		if (entry->e_name_index == F2FS_XATTR_INDEX_POSIX_ACL_ACCESS ||
+		    entry->e_name_index == F2FS_XATTR_INDEX_POSIX_ACL_DEFAULT)
+			return false;
+	}
+	return false;
+}
+
+/*
+ * Called as an inode is read in, with its node page.  When its xattrs
+ * can be seen to hold no ACL without further I/O, cache that, so that
+ * permission checks in RCU path walk do not have to drop out to ref
+ * walk just to find out through ->get_acl().
+ */
+void f2fs_init_acl_cache(struct inode *inode, struct page *ipage)
+{
+	if (!test_opt(F2FS_I_SB(inode), POSIX_ACL))
+		return;
+
+	/* the xattr node block is only read when the ACL is needed */
+	if (F2FS_I(inode)->i_xattr_nid)
+		return;
+
+	if (f2fs_has_inline_xattr(inode) &&
+	    !f2fs_inline_xattrs_have_no_acl(inode, ipage))
+		return;
+
+	set_cached_acl(inode, ACL_TYPE_ACCESS, NULL);
+	set_cached_acl(inode, ACL_TYPE_DEFAULT, NULL);
+	stat_inc_acl_none(inode);
+}
+
 static int f2fs_set_acl(struct inode *inode, int type,
 			struct posix_acl *acl, struct page *ipage)
 {
@@ -297,6 +350,14 @@ int f2fs_init_acl(struct inode *inode, struct inode *dir, struct page *ipage,
 		error = f2fs_set_acl(inode, ACL_TYPE_ACCESS, acl, ipage);
 cleanup:
 	posix_acl_release(acl);
+
+	/* a new inode has no ACL unless one was just set */
+	if (!error) {
+		if (inode->i_acl == ACL_NOT_CACHED)
+			set_cached_acl(inode, ACL_TYPE_ACCESS, NULL);
+		if (inode->i_default_acl == ACL_NOT_CACHED)
+			set_cached_acl(inode, ACL_TYPE_DEFAULT, NULL);
+	}
 	return error;
 }
 
@@ -40,6 +40,7 @@ extern struct posix_acl *f2fs_get_acl(struct inode *, int);
 extern int f2fs_acl_chmod(struct inode *);
 extern int f2fs_init_acl(struct inode *, struct inode *, struct page *,
 							struct page *);
+extern void f2fs_init_acl_cache(struct inode *, struct page *);
 #else
 #define f2fs_check_acl	NULL
 #define f2fs_get_acl	NULL
@@ -55,5 +56,10 @@ static inline int f2fs_init_acl(struct inode *inode, struct inode *dir,
 {
 	return 0;
 }
+
+static inline void f2fs_init_acl_cache(struct inode *inode,
+				struct page *ipage)
+{
+}
 #endif
 #endif /* __F2FS_ACL_H__ */
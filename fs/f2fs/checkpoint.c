@@ -16,6 +16,9 @@
 #include <linux/f2fs_fs.h>
 #include <linux/pagevec.h>
 #include <linux/swap.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/hrtimer.h>
 
 #include "f2fs.h"
 #include "node.h"
@@ -1096,6 +1099,114 @@ out:
 	trace_f2fs_write_checkpoint(sbi->sb, cpc->reason, "finish checkpoint");
 }
 
+/*
+ * One checkpoint serves every request queued before it started, so sync
+ * calls that pile up behind a running checkpoint share the next one
+ * instead of writing one each.
+ */
+static void __checkpoint_and_complete_reqs(struct f2fs_sb_info *sbi)
+{
+	struct ckpt_req_control *cprc = sbi->cprc_info;
+	struct llist_node *dispatch_list;
+	struct ckpt_req *req;
+	struct cp_control cpc;
+	ktime_t now;
+
+	dispatch_list = llist_del_all(&cprc->issue_list);
+	if (!dispatch_list)
+		return;
+
+	cpc.reason = __get_cp_reason(sbi);
+	mutex_lock(&sbi->gc_mutex);
+	write_checkpoint(sbi, &cpc);
+	mutex_unlock(&sbi->gc_mutex);
+
+	now = ktime_get();
+	cprc->issued_ckpt++;
+	while (dispatch_list) {
+		s64 us;
+
+		/* the request goes away once completed */
+		req = llist_entry(dispatch_list, struct ckpt_req, llnode);
+		dispatch_list = dispatch_list->next;
+
+		us = ktime_us_delta(now, req->queue_time);
+		cprc->total_waiters++;
+		cprc->total_wait_us += us;
+		if (us > cprc->peak_wait_us)
+			cprc->peak_wait_us = us;
+		complete(&req->wait);
+	}
+}
+
+static int issue_checkpoint_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct ckpt_req_control *cprc = sbi->cprc_info;
+	wait_queue_head_t *q = &cprc->ckpt_wait_queue;
+repeat:
+	if (kthread_should_stop())
+		return 0;
+
+	__checkpoint_and_complete_reqs(sbi);
+
+	wait_event_interruptible(*q,
+		kthread_should_stop() || !llist_empty(&cprc->issue_list));
+	goto repeat;
+}
+
+int f2fs_issue_checkpoint(struct f2fs_sb_info *sbi)
+{
+	struct ckpt_req_control *cprc = sbi->cprc_info;
+	struct ckpt_req req;
+
+	init_completion(&req.wait);
+	req.queue_time = ktime_get();
+
+	llist_add(&req.llnode, &cprc->issue_list);
+	wake_up(&cprc->ckpt_wait_queue);
+
+	wait_for_completion(&req.wait);
+	return 0;
+}
+
+int create_ckpt_req_control(struct f2fs_sb_info *sbi)
+{
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct ckpt_req_control *cprc;
+	int err = 0;
+
+	cprc = kzalloc(sizeof(struct ckpt_req_control), GFP_KERNEL);
+	if (!cprc)
+		return -ENOMEM;
+	init_waitqueue_head(&cprc->ckpt_wait_queue);
+	init_llist_head(&cprc->issue_list);
+	sbi->cprc_info = cprc;
+	cprc->f2fs_issue_ckpt = kthread_run(issue_checkpoint_thread, sbi,
+				"f2fs_ckpt-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(cprc->f2fs_issue_ckpt)) {
+		err = PTR_ERR(cprc->f2fs_issue_ckpt);
+		kfree(cprc);
+		sbi->cprc_info = NULL;
+		return err;
+	}
+
+	return err;
+}
+
+void destroy_ckpt_req_control(struct f2fs_sb_info *sbi)
+{
+	struct ckpt_req_control *cprc = sbi->cprc_info;
+
+	if (!cprc)
+		return;
+	kthread_stop(cprc->f2fs_issue_ckpt);
+	/* serve whoever queued while the thread was stopping */
+	__checkpoint_and_complete_reqs(sbi);
+	kfree(cprc);
+	sbi->cprc_info = NULL;
+}
+
 void init_ino_entry_info(struct f2fs_sb_info *sbi)
 {
 	int i;
@@ -0,0 +1,675 @@
+/*
+ * fs/f2fs/compress.c
+ *
+ * Transparent compression of regular files flagged with FS_COMPR_FL.
+ *
+ * A file is handled in clusters of F2FS_CLUSTER_SIZE pages. Writeback
+ * stores a fully cached cluster compressed when that saves at least one
+ * block, and any other cluster raw. Compressed clusters are never updated
+ * in place: the first write into one turns it back into raw dirty pages.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+#include <linux/fs.h>
+#include <linux/f2fs_fs.h>
+#include <linux/pagemap.h>
+#include <linux/pagevec.h>
+#include <linux/writeback.h>
+#include <linux/vmalloc.h>
+#include <linux/highmem.h>
+#include <linux/lzo.h>
+#include <linux/lz4.h>
+
+#include "f2fs.h"
+#include "node.h"
+#include "segment.h"
+
+#define CLUSTER_BYTES		(F2FS_CLUSTER_SIZE << PAGE_CACHE_SHIFT)
+#define COMPRESS_HDR_SIZE	sizeof(struct f2fs_compress_header)
+
+/* a cluster is stored compressed only if that saves one block at least */
+#define MAX_COMPRESS_BYTES	((F2FS_CLUSTER_SIZE - 1) << PAGE_CACHE_SHIFT)
+
+#define COMPRESS_WRKMEM_SIZE	max_t(size_t, LZO1X_1_MEM_COMPRESS,	\
+							LZ4_MEM_COMPRESS)
+#define COMPRESS_BUF_SIZE	(COMPRESS_HDR_SIZE +			\
+		max_t(size_t, lzo1x_worst_compress(CLUSTER_BYTES),	\
+				lz4_compressbound(CLUSTER_BYTES)))
+
+static inline pgoff_t cluster_start(pgoff_t index)
+{
+	return index & ~((pgoff_t)F2FS_CLUSTER_SIZE - 1);
+}
+
+/*
+ * Get the compressed block addresses of the cluster starting at @start.
+ * Returns their number, or 0 if the cluster is not stored compressed.
+ */
+static int lookup_compressed_cluster(struct inode *inode, pgoff_t start,
+							block_t *blkaddr)
+{
+	struct dnode_of_data dn;
+	int i, nr = 0, err;
+
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, start, LOOKUP_NODE);
+	if (err)
+		return err == -ENOENT ? 0 : err;
+
+	if (dn.data_blkaddr != COMPRESS_ADDR)
+		goto out;
+
+	for (i = 1; i < F2FS_CLUSTER_SIZE; i++) {
+		block_t addr = datablock_addr(dn.node_page, dn.ofs_in_node + i);
+
+		if (addr == NULL_ADDR)
+			break;
+		blkaddr[nr++] = addr;
+	}
+	if (!nr)
+		nr = -EIO;
+out:
+	f2fs_put_dnode(&dn);
+	return nr;
+}
+
+/*
+ * Compressed blocks are cached in META_MAPPING by block address. Both the
+ * compression and the GC path write them through that cache, so a cached
+ * page of a block that currently holds compressed data is never stale.
+ */
+static int read_compressed_blocks(struct f2fs_sb_info *sbi, block_t *blkaddr,
+					int nr, struct page **cpages)
+{
+	struct f2fs_io_info fio = {
+		.type = DATA,
+		.rw = READ_SYNC,
+	};
+	int i, err = 0;
+
+	for (i = 0; i < nr; i++) {
+		cpages[i] = grab_cache_page(META_MAPPING(sbi), blkaddr[i]);
+		if (!cpages[i])
+			return -ENOMEM;
+
+		if (PageUptodate(cpages[i])) {
+			unlock_page(cpages[i]);
+			continue;
+		}
+
+		fio.blk_addr = blkaddr[i];
+		err = f2fs_submit_page_bio(sbi, cpages[i], &fio);
+		if (err) {
+			/* the page was already released */
+			cpages[i] = NULL;
+			return err;
+		}
+	}
+
+	for (i = 0; i < nr; i++) {
+		wait_on_page_locked(cpages[i]);
+		if (unlikely(!PageUptodate(cpages[i])))
+			err = -EIO;
+	}
+	return err;
+}
+
+static int decompress_cluster(const void *src, int nr_cpages, void *dst)
+{
+	const struct f2fs_compress_header *hdr = src;
+	size_t clen = le32_to_cpu(hdr->clen);
+	size_t dlen = CLUSTER_BYTES;
+	int ret;
+
+	if (clen > ((size_t)nr_cpages << PAGE_CACHE_SHIFT) - COMPRESS_HDR_SIZE)
+		return -EIO;
+
+	switch (hdr->algorithm) {
+	case F2FS_COMPRESS_LZO:
+		ret = lzo1x_decompress_safe(src + COMPRESS_HDR_SIZE, clen,
+								dst, &dlen);
+		break;
+	case F2FS_COMPRESS_LZ4:
+		ret = lz4_decompress_unknownoutputsize(src + COMPRESS_HDR_SIZE,
+							clen, dst, &dlen);
+		break;
+	default:
+		return -EIO;
+	}
+
+	if (ret || dlen != CLUSTER_BYTES)
+		return -EIO;
+	return 0;
+}
+
+/*
+ * Fill the locked @page from its compressed cluster, together with the
+ * other pages of the cluster that are not cached yet. Returns -EAGAIN if
+ * the cluster is stored raw, so that the caller reads @page as usual.
+ * Otherwise @page is unlocked on return.
+ */
+int f2fs_read_compressed_page(struct page *page)
+{
+	struct address_space *mapping = page->mapping;
+	struct f2fs_sb_info *sbi = F2FS_P_SB(page);
+	struct page *pages[F2FS_CLUSTER_SIZE] = { NULL, };
+	struct page *cpages[F2FS_CLUSTER_SIZE - 1] = { NULL, };
+	block_t blkaddr[F2FS_CLUSTER_SIZE - 1];
+	pgoff_t start = cluster_start(page->index);
+	unsigned int scratch = 0;
+	void *src = NULL, *dst = NULL;
+	int i, nr, err;
+
+	nr = lookup_compressed_cluster(mapping->host, start, blkaddr);
+	if (!nr)
+		return -EAGAIN;
+	if (nr < 0) {
+		err = nr;
+		goto out;
+	}
+
+	err = read_compressed_blocks(sbi, blkaddr, nr, cpages);
+	if (err)
+		goto out;
+
+	/*
+	 * The whole cluster is decompressed at once, so the pages nobody
+	 * else holds are filled as well. Those we cannot get without
+	 * blocking are decompressed into scratch pages and thrown away.
+	 */
+	for (i = 0; i < F2FS_CLUSTER_SIZE; i++) {
+		if (start + i == page->index) {
+			pages[i] = page;
+			continue;
+		}
+		pages[i] = grab_cache_page_nowait(mapping, start + i);
+		if (pages[i] && PageUptodate(pages[i])) {
+			f2fs_put_page(pages[i], 1);
+			pages[i] = NULL;
+		}
+		if (!pages[i]) {
+			pages[i] = alloc_page(GFP_NOFS);
+			if (!pages[i]) {
+				err = -ENOMEM;
+				goto out;
+			}
+			scratch |= 1 << i;
+		}
+	}
+
+	src = vm_map_ram(cpages, nr, -1, PAGE_KERNEL);
+	dst = vm_map_ram(pages, F2FS_CLUSTER_SIZE, -1, PAGE_KERNEL);
+	if (!src || !dst) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	err = decompress_cluster(src, nr, dst);
+out:
+	if (src)
+		vm_unmap_ram(src, nr);
+	if (dst)
+		vm_unmap_ram(dst, F2FS_CLUSTER_SIZE);
+
+	for (i = 0; i < nr; i++)
+		if (cpages[i])
+			page_cache_release(cpages[i]);
+
+	for (i = 0; i < F2FS_CLUSTER_SIZE; i++) {
+		if (!pages[i] || pages[i] == page)
+			continue;
+		if (scratch & (1 << i)) {
+			__free_page(pages[i]);
+			continue;
+		}
+		if (!err) {
+			flush_dcache_page(pages[i]);
+			SetPageUptodate(pages[i]);
+		}
+		f2fs_put_page(pages[i], 1);
+	}
+
+	if (err) {
+		SetPageError(page);
+	} else {
+		flush_dcache_page(page);
+		SetPageUptodate(page);
+	}
+	unlock_page(page);
+	return err;
+}
+
+/*
+ * Turn the compressed cluster holding @index back into raw dirty pages,
+ * with reserved block addresses, before any of its pages gets modified.
+ * Pages at and beyond @nr_pages, i.e. past a new EOF, are dropped.
+ */
+int f2fs_uncompress_cluster(struct inode *inode, pgoff_t index,
+							pgoff_t nr_pages)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct page *pages[F2FS_CLUSTER_SIZE] = { NULL, };
+	block_t blkaddr[F2FS_CLUSTER_SIZE - 1];
+	pgoff_t start = cluster_start(index);
+	struct dnode_of_data dn;
+	unsigned int ofs;
+	int i, nr, nr_keep, err;
+repeat:
+	nr = lookup_compressed_cluster(inode, start, blkaddr);
+	if (nr <= 0)
+		return nr;
+
+	for (nr_keep = 0; nr_keep < F2FS_CLUSTER_SIZE; nr_keep++) {
+		struct page *page;
+
+		if (start + nr_keep >= nr_pages)
+			break;
+
+		page = read_mapping_page(inode->i_mapping, start + nr_keep,
+									NULL);
+		if (IS_ERR(page)) {
+			err = PTR_ERR(page);
+			goto out;
+		}
+		lock_page(page);
+		pages[nr_keep] = page;
+		if (unlikely(page->mapping != inode->i_mapping ||
+						!PageUptodate(page))) {
+			err = -EAGAIN;
+			goto out;
+		}
+		f2fs_wait_on_page_writeback(page, DATA);
+	}
+
+	f2fs_lock_op(sbi);
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, start, LOOKUP_NODE);
+	if (err)
+		goto unlock_out;
+
+	/* someone else did it while we were reading the cluster */
+	if (dn.data_blkaddr != COMPRESS_ADDR)
+		goto put_out;
+
+	if (nr_keep > nr &&
+			!inc_valid_block_count(sbi, inode, nr_keep - nr)) {
+		err = -ENOSPC;
+		goto put_out;
+	}
+
+	ofs = dn.ofs_in_node;
+	for (i = 0; i < F2FS_CLUSTER_SIZE; i++) {
+		block_t addr;
+
+		dn.ofs_in_node = ofs + i;
+		addr = datablock_addr(dn.node_page, dn.ofs_in_node);
+		if (addr != NULL_ADDR && addr != COMPRESS_ADDR)
+			invalidate_blocks(sbi, addr);
+
+		dn.data_blkaddr = i < nr_keep ? NEW_ADDR : NULL_ADDR;
+		set_data_blkaddr(&dn);
+	}
+	dn.ofs_in_node = ofs;
+
+	if (nr > nr_keep)
+		dec_valid_block_count(sbi, inode, nr - nr_keep);
+	mark_inode_dirty(inode);
+	sync_inode_page(&dn);
+
+	for (i = 0; i < nr_keep; i++)
+		set_page_dirty(pages[i]);
+put_out:
+	f2fs_put_dnode(&dn);
+unlock_out:
+	f2fs_unlock_op(sbi);
+	if (!err)
+		for (i = 0; i < nr; i++)
+			invalidate_mapping_pages(META_MAPPING(sbi),
+						blkaddr[i], blkaddr[i]);
+out:
+	for (i = 0; i < F2FS_CLUSTER_SIZE; i++) {
+		if (pages[i])
+			f2fs_put_page(pages[i], 1);
+		pages[i] = NULL;
+	}
+	/* raced with truncation */
+	if (err == -EAGAIN)
+		goto repeat;
+	return err;
+}
+
+static int compressed_seg_type(struct f2fs_sb_info *sbi, bool cold)
+{
+	/* the same data logs __get_segment_type() picks for a regular file */
+	if (sbi->active_logs == 2)
+		return CURSEG_HOT_DATA;
+	if (sbi->active_logs == 4 || cold)
+		return CURSEG_COLD_DATA;
+	return CURSEG_WARM_DATA;
+}
+
+/*
+ * Write one compressed block for the slot @dn points to, replacing the
+ * block address in dn->data_blkaddr, and cache it in META_MAPPING.
+ */
+static void write_compressed_block(struct dnode_of_data *dn,
+		unsigned char version, const void *data, bool cold, int rw)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(dn->inode);
+	struct f2fs_summary sum;
+	struct page *page;
+	struct f2fs_io_info fio = {
+		.type = DATA,
+		.rw = rw,
+	};
+
+	set_summary(&sum, dn->nid, dn->ofs_in_node, version);
+	allocate_data_block(sbi, NULL, dn->data_blkaddr, &fio.blk_addr,
+				&sum, compressed_seg_type(sbi, cold));
+
+	page = grab_meta_page(sbi, fio.blk_addr);
+	memcpy(page_address(page), data, PAGE_CACHE_SIZE);
+	set_page_writeback(page);
+	f2fs_submit_page_mbio(sbi, page, &fio);
+	f2fs_put_page(page, 1);
+
+	dn->data_blkaddr = fio.blk_addr;
+	set_data_blkaddr(dn);
+}
+
+static void *get_compress_ws(struct f2fs_sb_info *sbi)
+{
+	if (!sbi->compress_ws)
+		sbi->compress_ws = vmalloc(COMPRESS_WRKMEM_SIZE +
+							COMPRESS_BUF_SIZE);
+	return sbi->compress_ws;
+}
+
+/*
+ * Store the cluster starting at @start compressed, if all of its pages are
+ * cached and some are dirty. Returns the number of dirty pages it cleaned,
+ * or 0 if the cluster is left to the raw writepage path.
+ */
+static int write_compressed_cluster(struct inode *inode, pgoff_t start,
+		struct writeback_control *wbc, block_t *first, block_t *last)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct page *pages[F2FS_CLUSTER_SIZE] = { NULL, };
+	struct f2fs_compress_header *hdr;
+	struct dnode_of_data dn;
+	struct node_info ni;
+	int rw = (wbc->sync_mode == WB_SYNC_ALL) ? WRITE_SYNC : WRITE;
+	int algorithm = sbi->compress_algorithm;
+	size_t clen = 0, cbytes;
+	void *ws, *src;
+	unsigned int ofs;
+	int i, ret, nr_cpages, nr_blocks = 0, nr_dirty = 0;
+
+	for (i = 0; i < F2FS_CLUSTER_SIZE; i++) {
+		pages[i] = find_lock_page(inode->i_mapping, start + i);
+		if (!pages[i] || !PageUptodate(pages[i]))
+			goto fail;
+		if (PageWriteback(pages[i])) {
+			if (wbc->sync_mode == WB_SYNC_NONE)
+				goto fail;
+			f2fs_wait_on_page_writeback(pages[i], DATA);
+		}
+		if (PageDirty(pages[i]))
+			nr_dirty++;
+	}
+	if (!nr_dirty)
+		goto out;
+
+	src = vm_map_ram(pages, F2FS_CLUSTER_SIZE, -1, PAGE_KERNEL);
+	if (!src)
+		goto fail;
+
+	mutex_lock(&sbi->compress_mutex);
+	ws = get_compress_ws(sbi);
+	if (!ws) {
+		ret = -ENOMEM;
+		goto unmap;
+	}
+
+	hdr = ws + COMPRESS_WRKMEM_SIZE;
+	if (algorithm == F2FS_COMPRESS_LZO)
+		ret = lzo1x_1_compress(src, CLUSTER_BYTES,
+				(void *)hdr + COMPRESS_HDR_SIZE, &clen, ws);
+	else
+		ret = lz4_compress(src, CLUSTER_BYTES,
+				(void *)hdr + COMPRESS_HDR_SIZE, &clen, ws);
+unmap:
+	vm_unmap_ram(src, F2FS_CLUSTER_SIZE);
+
+	cbytes = clen + COMPRESS_HDR_SIZE;
+	if (ret || cbytes > MAX_COMPRESS_BYTES)
+		goto out_unlock;
+
+	hdr->clen = cpu_to_le32(clen);
+	hdr->algorithm = algorithm;
+	memset(hdr->reserved, 0, sizeof(hdr->reserved));
+	nr_cpages = DIV_ROUND_UP(cbytes, PAGE_CACHE_SIZE);
+	memset((void *)hdr + cbytes, 0,
+			(nr_cpages << PAGE_CACHE_SHIFT) - cbytes);
+
+	f2fs_lock_op(sbi);
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	if (get_dnode_of_data(&dn, start, LOOKUP_NODE))
+		goto unlock_op;
+
+	/* a compressed cluster must not span two direct nodes */
+	if (dn.ofs_in_node + F2FS_CLUSTER_SIZE >
+				ADDRS_PER_PAGE(dn.node_page, F2FS_I(inode)))
+		goto put_dnode;
+
+	for (i = 0; i < F2FS_CLUSTER_SIZE; i++) {
+		block_t addr = datablock_addr(dn.node_page, dn.ofs_in_node + i);
+
+		if (addr == COMPRESS_ADDR)
+			goto put_dnode;
+		if (addr != NULL_ADDR)
+			nr_blocks++;
+	}
+
+	if (nr_cpages > nr_blocks &&
+		!inc_valid_block_count(sbi, inode, nr_cpages - nr_blocks))
+		goto put_dnode;
+
+	get_node_info(sbi, dn.nid, &ni);
+
+	ofs = dn.ofs_in_node;
+	for (i = 0; i < F2FS_CLUSTER_SIZE; i++) {
+		dn.ofs_in_node = ofs + i;
+		dn.data_blkaddr = datablock_addr(dn.node_page, dn.ofs_in_node);
+
+		if (i && i <= nr_cpages) {
+			if (dn.data_blkaddr == NULL_ADDR)
+				dn.data_blkaddr = NEW_ADDR;
+			write_compressed_block(&dn, ni.version,
+				(void *)hdr + ((i - 1) << PAGE_CACHE_SHIFT),
+				file_is_cold(inode), rw);
+			*first = min(*first, dn.data_blkaddr);
+			*last = max(*last, dn.data_blkaddr);
+			continue;
+		}
+
+		if (dn.data_blkaddr != NULL_ADDR)
+			invalidate_blocks(sbi, dn.data_blkaddr);
+		dn.data_blkaddr = i ? NULL_ADDR : COMPRESS_ADDR;
+		set_data_blkaddr(&dn);
+	}
+	dn.ofs_in_node = ofs;
+
+	if (nr_blocks > nr_cpages)
+		dec_valid_block_count(sbi, inode, nr_blocks - nr_cpages);
+	mark_inode_dirty(inode);
+	sync_inode_page(&dn);
+
+	set_inode_flag(F2FS_I(inode), FI_APPEND_WRITE);
+	if (start == 0)
+		set_inode_flag(F2FS_I(inode), FI_FIRST_BLOCK_WRITTEN);
+
+	f2fs_put_dnode(&dn);
+	f2fs_unlock_op(sbi);
+	mutex_unlock(&sbi->compress_mutex);
+
+	for (i = 0; i < F2FS_CLUSTER_SIZE; i++) {
+		if (clear_page_dirty_for_io(pages[i]))
+			inode_dec_dirty_pages(inode);
+		clear_cold_data(pages[i]);
+	}
+	goto out;
+
+put_dnode:
+	f2fs_put_dnode(&dn);
+unlock_op:
+	f2fs_unlock_op(sbi);
+out_unlock:
+	mutex_unlock(&sbi->compress_mutex);
+fail:
+	nr_dirty = 0;
+out:
+	for (i = 0; i < F2FS_CLUSTER_SIZE; i++)
+		if (pages[i])
+			f2fs_put_page(pages[i], 1);
+	return nr_dirty;
+}
+
+/*
+ * Called by ->writepages of a compressed file before the dirty pages go
+ * through write_cache_pages(). Every fully cached cluster within i_size
+ * that compresses well is written here; the rest is left dirty for the
+ * raw path.
+ */
+void f2fs_write_compressed_pages(struct inode *inode,
+					struct writeback_control *wbc)
+{
+	struct address_space *mapping = inode->i_mapping;
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	pgoff_t nr_full = i_size_read(inode) >> PAGE_CACHE_SHIFT;
+	pgoff_t index, end, last_start = ULONG_MAX;
+	block_t first = (block_t)-1, last = 0;
+	struct pagevec pvec;
+	unsigned int i, nr_pages;
+	bool written = false;
+
+	if (unlikely(f2fs_cp_error(sbi)) || f2fs_is_atomic_file(inode) ||
+			f2fs_is_volatile_file(inode) || !nr_full)
+		return;
+
+	if (wbc->range_cyclic) {
+		index = 0;
+		end = nr_full - 1;
+	} else {
+		index = wbc->range_start >> PAGE_CACHE_SHIFT;
+		end = min_t(pgoff_t, wbc->range_end >> PAGE_CACHE_SHIFT,
+								nr_full - 1);
+	}
+
+	pagevec_init(&pvec, 0);
+	while (index <= end && wbc->nr_to_write > 0) {
+		nr_pages = pagevec_lookup_tag(&pvec, mapping, &index,
+				PAGECACHE_TAG_DIRTY, PAGEVEC_SIZE);
+		if (!nr_pages)
+			break;
+
+		for (i = 0; i < nr_pages; i++) {
+			pgoff_t start = cluster_start(pvec.pages[i]->index);
+			int nr;
+
+			if (pvec.pages[i]->index > end)
+				break;
+			if (start == last_start ||
+					start + F2FS_CLUSTER_SIZE > nr_full)
+				continue;
+			last_start = start;
+
+			if (has_not_enough_free_secs(sbi, 0)) {
+				pagevec_release(&pvec);
+				goto out;
+			}
+
+			nr = write_compressed_cluster(inode, start, wbc,
+							&first, &last);
+			if (nr) {
+				wbc->nr_to_write -= nr;
+				written = true;
+			}
+		}
+		pagevec_release(&pvec);
+		cond_resched();
+	}
+out:
+	if (!written)
+		return;
+
+	/* fsync has to wait for the compressed blocks as for the pages */
+	if (wbc->sync_mode == WB_SYNC_ALL) {
+		f2fs_submit_merged_bio(sbi, DATA, WRITE);
+		filemap_fdatawait_range(META_MAPPING(sbi),
+			(loff_t)first << PAGE_CACHE_SHIFT,
+			((loff_t)last << PAGE_CACHE_SHIFT) + PAGE_CACHE_SIZE - 1);
+	}
+	f2fs_balance_fs(sbi);
+}
+
+/*
+ * Move a valid block of a compressed cluster for GC. The block is copied
+ * through META_MAPPING since the page cache only has the decompressed
+ * pages. Returns -EAGAIN if @bidx belongs to a raw cluster.
+ */
+int f2fs_move_compressed_block(struct inode *inode, pgoff_t bidx,
+							block_t blkaddr)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	pgoff_t start = cluster_start(bidx);
+	struct page *page = NULL;
+	struct dnode_of_data dn;
+	struct node_info ni;
+	int err;
+
+	/* the first slot of a compressed cluster is never a valid block */
+	if (bidx == start)
+		return -EAGAIN;
+
+	f2fs_lock_op(sbi);
+	set_new_dnode(&dn, inode, NULL, NULL, 0);
+	err = get_dnode_of_data(&dn, start, LOOKUP_NODE);
+	if (err) {
+		f2fs_unlock_op(sbi);
+		return 0;
+	}
+
+	if (dn.data_blkaddr != COMPRESS_ADDR) {
+		err = -EAGAIN;
+		goto out;
+	}
+
+	dn.ofs_in_node += bidx - start;
+	dn.data_blkaddr = datablock_addr(dn.node_page, dn.ofs_in_node);
+	if (dn.data_blkaddr != blkaddr)
+		goto out;
+
+	if (read_compressed_blocks(sbi, &blkaddr, 1, &page))
+		goto out;
+
+	get_node_info(sbi, dn.nid, &ni);
+	write_compressed_block(&dn, ni.version, page_address(page), true,
+						WRITE_SYNC);
+out:
+	f2fs_put_dnode(&dn);
+	f2fs_unlock_op(sbi);
+	if (page) {
+		page_cache_release(page);
+		invalidate_mapping_pages(META_MAPPING(sbi), blkaddr, blkaddr);
+	}
+	return err == -EAGAIN ? err : 0;
+}
+
+void f2fs_destroy_compress_ws(struct f2fs_sb_info *sbi)
+{
+	vfree(sbi->compress_ws);
+	sbi->compress_ws = NULL;
+}
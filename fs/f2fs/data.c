@@ -1335,6 +1335,10 @@ static int get_data_block_fiemap(struct inode *inode, sector_t iblock,
 int f2fs_fiemap(struct inode *inode, struct fiemap_extent_info *fieinfo,
 		u64 start, u64 len)
 {
+	/* compressed clusters have no block mapping to report */
+	if (f2fs_compressed_file(inode))
+		return -EOPNOTSUPP;
+
 	return generic_block_fiemap(inode, fieinfo,
 				start, len, get_data_block_fiemap);
 }
@@ -1349,6 +1353,8 @@ static int f2fs_read_data_page(struct file *file, struct page *page)
 	/* If the file has inline data, try to read it directly */
 	if (f2fs_has_inline_data(inode))
 		ret = f2fs_read_inline_data(inode, page);
+	else if (f2fs_compressed_file(inode))
+		ret = f2fs_read_compressed_page(page);
 	if (ret == -EAGAIN)
 		ret = mpage_readpage(page, get_data_block);
 
@@ -1365,6 +1371,27 @@ static int f2fs_read_data_pages(struct file *file,
 	if (f2fs_has_inline_data(inode))
 		return 0;
 
+	/*
+	 * Compressed clusters are read through readpage, which fills the
+	 * whole cluster at once and leaves raw clusters to mpage_readpage.
+	 */
+	if (f2fs_compressed_file(inode)) {
+		unsigned page_idx;
+
+		for (page_idx = 0; page_idx < nr_pages; page_idx++) {
+			struct page *page = list_entry(pages->prev,
+							struct page, lru);
+
+			prefetchw(&page->flags);
+			list_del(&page->lru);
+			if (!add_to_page_cache_lru(page, mapping,
+						page->index, GFP_KERNEL))
+				f2fs_read_data_page(file, page);
+			page_cache_release(page);
+		}
+		return 0;
+	}
+
 	return mpage_readpages(mapping, pages, nr_pages, get_data_block);
 }
 
@@ -1533,6 +1560,10 @@ static int f2fs_write_data_pages(struct address_space *mapping,
 
 	diff = nr_pages_to_write(sbi, DATA, wbc);
 
+	/* full clusters go first, what is left dirty is written raw */
+	if (f2fs_compressed_file(inode))
+		f2fs_write_compressed_pages(inode, wbc);
+
 	ret = write_cache_pages(mapping, wbc, __f2fs_writepage, mapping);
 
 	f2fs_submit_merged_bio(sbi, DATA, WRITE);
@@ -1572,6 +1603,18 @@ static int f2fs_write_begin(struct file *file, struct address_space *mapping,
 
 	f2fs_balance_fs(sbi);
 
+	/*
+	 * Drop the transaction once it outgrows its memory cap; the writer
+	 * gets -ENOMEM and SQLite rolls back and retries with its journal.
+	 */
+	if (f2fs_is_atomic_file(inode) &&
+			!may_register_inmem_page(inode, index)) {
+		commit_inmem_pages(inode, true);
+		clear_inode_flag(F2FS_I(inode), FI_ATOMIC_FILE);
+		err = -ENOMEM;
+		goto fail;
+	}
+
 	/*
 	 * We should check this at this moment to avoid deadlock on inode page
 	 * and #0 page. The locking rule for inline_data conversion should be:
@@ -1582,6 +1625,14 @@ static int f2fs_write_begin(struct file *file, struct address_space *mapping,
 		if (err)
 			goto fail;
 	}
+
+	/* compressed clusters are not updated in place */
+	if (f2fs_compressed_file(inode)) {
+		err = f2fs_uncompress_cluster(inode, index,
+				DIV_ROUND_UP(i_size_read(inode), PAGE_CACHE_SIZE));
+		if (err)
+			goto fail;
+	}
 repeat:
 	page = grab_cache_page_write_begin(mapping, index, flags);
 	if (!page) {
@@ -1731,6 +1782,10 @@ static ssize_t f2fs_direct_IO(int rw, struct kiocb *iocb,
 	if (check_direct_IO(inode, rw, iov, offset, nr_segs))
 		return 0;
 
+	/* fall back to buffered IO, which knows the cluster layout */
+	if (f2fs_compressed_file(inode))
+		return 0;
+
 	trace_f2fs_direct_IO_enter(inode, offset, count, rw);
 
 	if (rw & WRITE)
@@ -1809,6 +1864,11 @@ static sector_t f2fs_bmap(struct address_space *mapping, sector_t block)
 		if (err)
 			return err;
 	}
+
+	/* there is no block holding a compressed page alone */
+	if (f2fs_compressed_file(inode))
+		return 0;
+
 	return generic_block_bmap(mapping, block, get_data_block);
 }
 
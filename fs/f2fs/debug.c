@@ -51,6 +51,8 @@ static void update_general_status(struct f2fs_sb_info *sbi)
 	si->valid_inode_count = valid_inode_count(sbi);
 	si->inline_inode = atomic_read(&sbi->inline_inode);
 	si->inline_dir = atomic_read(&sbi->inline_dir);
+	si->acl_none = atomic_read(&sbi->acl_none);
+	si->acl_miss = atomic_read(&sbi->acl_miss);
 	si->utilization = utilization(sbi);
 
 	si->free_segs = free_segments(sbi);
@@ -229,6 +231,9 @@ static int stat_show(struct seq_file *s, void *v)
 			   si->inline_inode);
 		seq_printf(s, "  - Inline_dentry Inode: %u\n",
 			   si->inline_dir);
+		seq_printf(s, "  - ACL: no-ACL cached at iget: %u, "
+			   "ref-walk reads: %u\n",
+			   si->acl_none, si->acl_miss);
 		seq_printf(s, "\nMain area: %d segs, %d secs %d zones\n",
 			   si->main_area_segs, si->main_area_sections,
 			   si->main_area_zones);
@@ -367,6 +372,8 @@ int f2fs_build_stats(struct f2fs_sb_info *sbi)
 
 	atomic_set(&sbi->inline_inode, 0);
 	atomic_set(&sbi->inline_dir, 0);
+	atomic_set(&sbi->acl_none, 0);
+	atomic_set(&sbi->acl_miss, 0);
 	atomic_set(&sbi->inplace_count, 0);
 
 	mutex_lock(&f2fs_stat_mutex);
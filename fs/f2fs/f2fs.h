@@ -51,6 +51,7 @@
 #define F2FS_MOUNT_NOBARRIER		0x00000800
 #define F2FS_MOUNT_FASTBOOT		0x00001000
 #define F2FS_MOUNT_EXTENT_CACHE		0x00002000
+#define F2FS_MOUNT_CHECKPOINT_MERGE	0x00004000
 
 #define clear_opt(sbi, option)	(sbi->mount_opt.opt &= ~F2FS_MOUNT_##option)
 #define set_opt(sbi, option)	(sbi->mount_opt.opt |= F2FS_MOUNT_##option)
@@ -70,20 +71,9 @@ struct f2fs_mount_info {
 	unsigned int	opt;
 };
 
-#define CRCPOLY_LE 0xedb88320
-
 static inline __u32 f2fs_crc32(void *buf, size_t len)
 {
-	unsigned char *p = (unsigned char *)buf;
-	__u32 crc = F2FS_SUPER_MAGIC;
-	int i;
-
-	while (len--) {
-		crc ^= *p++;
-		for (i = 0; i < 8; i++)
-			crc = (crc >> 1) ^ ((crc & 1) ? CRCPOLY_LE : 0);
-	}
-	return crc;
+	return crc32_le(F2FS_SUPER_MAGIC, (unsigned char *)buf, len);
 }
 
 static inline bool f2fs_crc_valid(__u32 blk_crc, void *buf, size_t buf_size)
@@ -354,6 +344,12 @@ struct f2fs_inode_info {
 	struct radix_tree_root inmem_root;	/* radix tree for inmem pages */
 	struct list_head inmem_pages;	/* inmemory pages managed by f2fs */
 	struct mutex inmem_lock;	/* lock for inmemory pages */
+	unsigned int inmem_cnt;		/* # of inmemory pages */
+
+	/* learned data temperature, updated locklessly on block writes */
+	unsigned int i_write_score;	/* decayed # of block rewrites */
+	unsigned long i_score_stamp;	/* jiffies of the last decay */
+	unsigned long i_temp_start;	/* jiffies the inode was loaded */
 };
 
 static inline void get_extent_info(struct extent_info *ext,
@@ -499,6 +495,34 @@ struct flush_cmd_control {
 	struct llist_node *dispatch_list;	/* list for command dispatch */
 };
 
+struct discard_cmd_control {
+	struct task_struct *f2fs_issue_discard;	/* discard thread */
+	wait_queue_head_t discard_wait_queue;	/* waiting queue for wake-up */
+	struct mutex cmd_lock;			/* protects cmd_list */
+	struct list_head cmd_list;		/* pending ranges, by address */
+	unsigned int nr_cmds;			/* # of ranges in cmd_list */
+	struct mutex issue_lock;		/* held while ranges are issued */
+	unsigned int max_discard_issue;		/* max. ranges per batch */
+	unsigned int discard_granularity;	/* min. blocks of a discard */
+};
+
+/* for the sync calls served by the checkpoint thread */
+struct ckpt_req {
+	struct completion wait;
+	struct llist_node llnode;
+	ktime_t queue_time;
+};
+
+struct ckpt_req_control {
+	struct task_struct *f2fs_issue_ckpt;	/* checkpoint thread */
+	wait_queue_head_t ckpt_wait_queue;	/* waiting queue for wake-up */
+	struct llist_head issue_list;		/* list for checkpoint requests */
+	unsigned int issued_ckpt;		/* # of checkpoints written */
+	unsigned int total_waiters;		/* # of requests served */
+	u64 total_wait_us;			/* time requests waited */
+	unsigned int peak_wait_us;		/* longest wait of a request */
+};
+
 struct f2fs_sm_info {
 	struct sit_info *sit_info;		/* whole segment information */
 	struct free_segmap_info *free_info;	/* free segment information */
@@ -530,10 +554,21 @@ struct f2fs_sm_info {
 	unsigned int ipu_policy;	/* in-place-update policy */
 	unsigned int min_ipu_util;	/* in-place-update threshold */
 	unsigned int min_fsync_blocks;	/* threshold for fsync */
+	unsigned int max_inmem_pages;	/* per-inode cap of atomic writes */
+
+	/* learned hot/cold data separation, hot_data_thresh 0 disables */
+	unsigned int hot_data_thresh;	/* decayed rewrites for hot data */
+	unsigned int temp_decay_interval;	/* ms to halve rewrite score */
+	atomic_t data_blocks[NR_CURSEG_DATA_TYPE];	/* blocks per log */
+	atomic_t learned_hot_blocks;	/* sent hot by rewrite score */
+	atomic_t learned_cold_blocks;	/* sent cold for no rewrites */
 
 	/* for flush command control */
 	struct flush_cmd_control *cmd_control_info;
 
+	/* for discard command control */
+	struct discard_cmd_control *dcc_info;
+
 };
 
 /*
@@ -631,6 +666,7 @@ struct f2fs_sb_info {
 	struct f2fs_checkpoint *ckpt;		/* raw checkpoint pointer */
 	struct inode *meta_inode;		/* cache meta blocks */
 	struct mutex cp_mutex;			/* checkpoint procedure lock */
+	struct ckpt_req_control *cprc_info;	/* checkpoint merge thread */
 	struct rw_semaphore cp_rwsem;		/* blocking FS operations */
 	struct rw_semaphore node_write;		/* locking node writes */
 	wait_queue_head_t cp_wait;
@@ -679,6 +715,11 @@ struct f2fs_sb_info {
 
 	struct f2fs_mount_info mount_opt;	/* mount options */
 
+	/* for compressed files */
+	int compress_algorithm;			/* algorithm of new clusters */
+	struct mutex compress_mutex;		/* protect compress_ws */
+	void *compress_ws;			/* workspace for compression */
+
 	/* for cleaning operations */
 	struct mutex gc_mutex;			/* mutex for GC */
 	struct f2fs_gc_kthread	*gc_thread;	/* GC thread */
@@ -699,6 +740,8 @@ struct f2fs_sb_info {
 	int total_hit_ext, read_hit_ext;	/* extent cache hit ratio */
 	atomic_t inline_inode;			/* # of inline_data inodes */
 	atomic_t inline_dir;			/* # of inline_dentry inodes */
+	atomic_t acl_none;			/* # of no-ACL cached at iget */
+	atomic_t acl_miss;			/* # of ACL reads in ref-walk */
 	int bg_gc;				/* background gc calls */
 	unsigned int n_dirty_dirs;		/* # of dir inodes */
 #endif
@@ -1381,6 +1424,12 @@ static inline bool f2fs_is_drop_cache(struct inode *inode)
 	return is_inode_flag_set(F2FS_I(inode), FI_DROP_CACHE);
 }
 
+static inline bool f2fs_compressed_file(struct inode *inode)
+{
+	return S_ISREG(inode->i_mode) &&
+		(F2FS_I(inode)->i_flags & FS_COMPR_FL);
+}
+
 static inline void *inline_data_addr(struct page *page)
 {
 	struct f2fs_inode *ri = F2FS_INODE(page);
@@ -1524,6 +1573,7 @@ int wait_on_node_pages_writeback(struct f2fs_sb_info *, nid_t);
 void remove_inode_page(struct inode *);
 struct page *new_inode_page(struct inode *);
 struct page *new_node_page(struct dnode_of_data *, unsigned int, struct page *);
+void ra_nat_block(struct f2fs_sb_info *, nid_t);
 void ra_node_page(struct f2fs_sb_info *, nid_t);
 struct page *get_node_page(struct f2fs_sb_info *, pgoff_t);
 struct page *get_node_page_ra(struct page *, int);
@@ -1546,6 +1596,7 @@ void destroy_node_manager_caches(void);
 /*
  * segment.c
  */
+bool may_register_inmem_page(struct inode *, pgoff_t);
 void register_inmem_page(struct inode *, struct page *);
 void commit_inmem_pages(struct inode *, bool);
 void f2fs_balance_fs(struct f2fs_sb_info *);
@@ -1553,6 +1604,8 @@ void f2fs_balance_fs_bg(struct f2fs_sb_info *);
 int f2fs_issue_flush(struct f2fs_sb_info *);
 int create_flush_cmd_control(struct f2fs_sb_info *);
 void destroy_flush_cmd_control(struct f2fs_sb_info *);
+int create_discard_cmd_control(struct f2fs_sb_info *);
+void destroy_discard_cmd_control(struct f2fs_sb_info *);
 void invalidate_blocks(struct f2fs_sb_info *, block_t);
 void refresh_sit_entry(struct f2fs_sb_info *, block_t, block_t);
 void clear_prefree_segments(struct f2fs_sb_info *);
@@ -1606,6 +1659,9 @@ void add_dirty_dir_inode(struct inode *);
 void remove_dirty_dir_inode(struct inode *);
 void sync_dirty_dir_inodes(struct f2fs_sb_info *);
 void write_checkpoint(struct f2fs_sb_info *, struct cp_control *);
+int f2fs_issue_checkpoint(struct f2fs_sb_info *);
+int create_ckpt_req_control(struct f2fs_sb_info *);
+void destroy_ckpt_req_control(struct f2fs_sb_info *);
 void init_ino_entry_info(struct f2fs_sb_info *);
 int __init create_checkpoint_caches(void);
 void destroy_checkpoint_caches(void);
@@ -1646,6 +1702,15 @@ block_t start_bidx_of_node(unsigned int, struct f2fs_inode_info *);
 int f2fs_gc(struct f2fs_sb_info *);
 void build_gc_manager(struct f2fs_sb_info *);
 
+/*
+ * compress.c
+ */
+int f2fs_read_compressed_page(struct page *);
+int f2fs_uncompress_cluster(struct inode *, pgoff_t, pgoff_t);
+void f2fs_write_compressed_pages(struct inode *, struct writeback_control *);
+int f2fs_move_compressed_block(struct inode *, pgoff_t, block_t);
+void f2fs_destroy_compress_ws(struct f2fs_sb_info *);
+
 /*
  * recovery.c
  */
@@ -1666,6 +1731,7 @@ struct f2fs_stat_info {
 	int nats, dirty_nats, sits, dirty_sits, fnids;
 	int total_count, utilization;
 	int bg_gc, inline_inode, inline_dir, inmem_pages, wb_pages;
+	int acl_none, acl_miss;
 	unsigned int valid_count, valid_node_count, valid_inode_count;
 	unsigned int bimodal, avg_vblocks;
 	int util_free, util_valid, util_invalid;
@@ -1718,6 +1784,10 @@ static inline struct f2fs_stat_info *F2FS_STAT(struct f2fs_sb_info *sbi)
 		if (f2fs_has_inline_dentry(inode))			\
 			(atomic_dec(&F2FS_I_SB(inode)->inline_dir));	\
 	} while (0)
+#define stat_inc_acl_none(inode)					\
+		(atomic_inc(&F2FS_I_SB(inode)->acl_none))
+#define stat_inc_acl_miss(inode)					\
+		(atomic_inc(&F2FS_I_SB(inode)->acl_miss))
 #define stat_inc_seg_type(sbi, curseg)					\
 		((sbi)->segment_count[(curseg)->alloc_type]++)
 #define stat_inc_block_count(sbi, curseg)				\
@@ -1772,6 +1842,8 @@ void f2fs_destroy_root_stats(void);
 #define stat_dec_inline_inode(inode)
 #define stat_inc_inline_dir(inode)
 #define stat_dec_inline_dir(inode)
+#define stat_inc_acl_none(inode)
+#define stat_inc_acl_miss(inode)
 #define stat_inc_seg_type(sbi, curseg)
 #define stat_inc_block_count(sbi, curseg)
 #define stat_inc_inplace_blocks(sbi)
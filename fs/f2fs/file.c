@@ -44,6 +44,13 @@ static int f2fs_vm_page_mkwrite(struct vm_area_struct *vma,
 
 	f2fs_bug_on(sbi, f2fs_has_inline_data(inode));
 
+	if (f2fs_compressed_file(inode)) {
+		err = f2fs_uncompress_cluster(inode, page->index,
+				DIV_ROUND_UP(i_size_read(inode), PAGE_CACHE_SIZE));
+		if (err)
+			goto out;
+	}
+
 	/* block allocation */
 	f2fs_lock_op(sbi);
 	set_new_dnode(&dn, inode, NULL, NULL, 0);
@@ -454,8 +461,16 @@ int truncate_data_blocks_range(struct dnode_of_data *dn, int count)
 
 		dn->data_blkaddr = NULL_ADDR;
 		set_data_blkaddr(dn);
+
+		/* the cluster marker does not own a block */
+		if (blkaddr == COMPRESS_ADDR)
+			continue;
+
 		f2fs_update_extent_cache(dn);
 		invalidate_blocks(sbi, blkaddr);
+		if (f2fs_compressed_file(dn->inode) && blkaddr != NEW_ADDR)
+			invalidate_mapping_pages(META_MAPPING(sbi),
+							blkaddr, blkaddr);
 		if (dn->ofs_in_node == 0 && IS_INODE(dn->node_page))
 			clear_inode_flag(F2FS_I(dn->inode),
 						FI_FIRST_BLOCK_WRITTEN);
@@ -519,6 +534,20 @@ int truncate_blocks(struct inode *inode, u64 from, bool lock)
 
 	free_from = (pgoff_t)F2FS_BYTES_TO_BLK(from + blocksize - 1);
 
+	/*
+	 * A compressed cluster cannot be cut in the middle, nor can its
+	 * last page be zeroed partially, so unpack the one at the new EOF.
+	 */
+	if (lock && f2fs_compressed_file(inode) &&
+			((from & (blocksize - 1)) ||
+			(free_from & (F2FS_CLUSTER_SIZE - 1)))) {
+		err = f2fs_uncompress_cluster(inode,
+				(from & (blocksize - 1)) ? free_from - 1 : free_from,
+				free_from);
+		if (err)
+			return err;
+	}
+
 	if (lock)
 		f2fs_lock_op(sbi);
 
@@ -852,6 +881,10 @@ static long f2fs_fallocate(struct file *file, int mode,
 	if (mode & ~(FALLOC_FL_KEEP_SIZE | FALLOC_FL_PUNCH_HOLE))
 		return -EOPNOTSUPP;
 
+	/* preallocated or punched blocks would split the clusters */
+	if (f2fs_compressed_file(inode))
+		return -EOPNOTSUPP;
+
 	mutex_lock(&inode->i_mutex);
 
 	if (mode & FALLOC_FL_PUNCH_HOLE)
@@ -896,6 +929,34 @@ static inline __u32 f2fs_mask_flags(umode_t mode, __u32 flags)
 		return flags & F2FS_OTHER_FLMASK;
 }
 
+/*
+ * The compressed layout only exists for regular files. A file may be
+ * flagged at any time, since clusters written before stay raw, but the
+ * flag is kept on a file that may hold compressed clusters already.
+ */
+static int f2fs_set_compress_flag(struct inode *inode, bool set)
+{
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	int err;
+
+	if (!S_ISREG(inode->i_mode))
+		return -EINVAL;
+
+	if (!set)
+		return i_size_read(inode) ? -EINVAL : 0;
+
+	err = f2fs_convert_inline_inode(inode);
+	if (err)
+		return err;
+
+	/* a compressed cluster has no contiguous mapping to cache */
+	write_lock(&fi->ext_lock);
+	fi->ext.len = 0;
+	write_unlock(&fi->ext_lock);
+	set_inode_flag(fi, FI_NO_EXTENT);
+	return 0;
+}
+
 static int f2fs_ioc_getflags(struct file *filp, unsigned long arg)
 {
 	struct inode *inode = file_inode(filp);
@@ -942,6 +1003,15 @@ static int f2fs_ioc_setflags(struct file *filp, unsigned long arg)
 
 	flags = flags & FS_FL_USER_MODIFIABLE;
 	flags |= oldflags & ~FS_FL_USER_MODIFIABLE;
+
+	if ((flags ^ oldflags) & FS_COMPR_FL) {
+		ret = f2fs_set_compress_flag(inode, flags & FS_COMPR_FL);
+		if (ret) {
+			mutex_unlock(&inode->i_mutex);
+			goto out;
+		}
+	}
+
 	fi->i_flags = flags;
 	mutex_unlock(&inode->i_mutex);
 
@@ -972,6 +1042,10 @@ static int f2fs_ioc_start_atomic_write(struct file *filp)
 	if (f2fs_is_atomic_file(inode))
 		return 0;
 
+	/* no room for another transaction, let the caller use its journal */
+	if (!available_free_memory(F2FS_I_SB(inode), INMEM_PAGES))
+		return -ENOMEM;
+
 	set_inode_flag(F2FS_I(inode), FI_ATOMIC_FILE);
 
 	return f2fs_convert_inline_inode(inode);
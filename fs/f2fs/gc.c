@@ -38,11 +38,14 @@ static int gc_thread_func(void *data)
 			continue;
 		else
 			wait_event_interruptible_timeout(*wq,
-						kthread_should_stop(),
+						kthread_should_stop() ||
+						gc_th->gc_wake,
 						msecs_to_jiffies(wait_ms));
 		if (kthread_should_stop())
 			break;
 
+		gc_th->gc_wake = 0;
+
 		if (sbi->sb->s_writers.frozen >= SB_FREEZE_WRITE) {
 			increase_sleep_time(gc_th, &wait_ms);
 			continue;
@@ -54,7 +57,12 @@ static int gc_thread_func(void *data)
 		 * 1. There are enough dirty segments.
 		 * 2. IO subsystem is idle by checking the # of writeback pages.
 		 * 3. IO subsystem is idle by checking the # of requests in
-		 *    bdev's request list.
+		 *    bdev's request list, and the disk has been quiet for
+		 *    idle_interval.
+		 *
+		 * In urgent mode, set from userspace when the screen goes off
+		 * or charging starts, GC runs every urgent_sleep_time without
+		 * waiting for the disk to become idle.
 		 *
 		 * Note) We have to avoid triggering GCs frequently.
 		 * Because it is possible that some segments can be
@@ -64,7 +72,12 @@ static int gc_thread_func(void *data)
 		if (!mutex_trylock(&sbi->gc_mutex))
 			continue;
 
-		if (!is_idle(sbi)) {
+		if (gc_th->gc_urgent) {
+			wait_ms = gc_th->urgent_sleep_time;
+			goto do_gc;
+		}
+
+		if (!is_device_idle(sbi, gc_th->idle_interval)) {
 			increase_sleep_time(gc_th, &wait_ms);
 			mutex_unlock(&sbi->gc_mutex);
 			continue;
@@ -74,7 +87,7 @@ static int gc_thread_func(void *data)
 			decrease_sleep_time(gc_th, &wait_ms);
 		else
 			increase_sleep_time(gc_th, &wait_ms);
-
+do_gc:
 		stat_inc_bggc_count(sbi);
 
 		/* if return value is not zero, no victim was selected */
@@ -104,7 +117,12 @@ int start_gc_thread(struct f2fs_sb_info *sbi)
 	gc_th->max_sleep_time = DEF_GC_THREAD_MAX_SLEEP_TIME;
 	gc_th->no_gc_sleep_time = DEF_GC_THREAD_NOGC_SLEEP_TIME;
 
+	gc_th->urgent_sleep_time = DEF_GC_THREAD_URGENT_SLEEP_TIME;
+	gc_th->idle_interval = DEF_GC_IDLE_INTERVAL;
+
 	gc_th->gc_idle = 0;
+	gc_th->gc_urgent = 0;
+	gc_th->gc_wake = 0;
 
 	sbi->gc_thread = gc_th;
 	init_waitqueue_head(&sbi->gc_thread->gc_wait_queue_head);
@@ -394,9 +412,9 @@ static int check_valid_map(struct f2fs_sb_info *sbi,
 static void gc_node_segment(struct f2fs_sb_info *sbi,
 		struct f2fs_summary *sum, unsigned int segno, int gc_type)
 {
-	bool initial = true;
 	struct f2fs_summary *entry;
 	int off;
+	int phase = 0;
 
 next_step:
 	entry = sum;
@@ -412,7 +430,13 @@ next_step:
 		if (check_valid_map(sbi, segno, off) == 0)
 			continue;
 
-		if (initial) {
+		/* readahead NAT blocks first, then the node pages they locate */
+		if (phase == 0) {
+			ra_nat_block(sbi, nid);
+			continue;
+		}
+
+		if (phase == 1) {
 			ra_node_page(sbi, nid);
 			continue;
 		}
@@ -438,10 +462,8 @@ next_step:
 		stat_inc_node_blk_count(sbi, 1, gc_type);
 	}
 
-	if (initial) {
-		initial = false;
+	if (++phase < 3)
 		goto next_step;
-	}
 
 	if (gc_type == FG_GC) {
 		struct writeback_control wbc = {
@@ -578,7 +600,16 @@ next_step:
 		if (check_valid_map(sbi, segno, off) == 0)
 			continue;
 
+		/*
+		 * Each lookup needs the NAT entry before the node page, so
+		 * both are read ahead for every block before any is waited on.
+		 */
 		if (phase == 0) {
+			ra_nat_block(sbi, le32_to_cpu(entry->nid));
+			continue;
+		}
+
+		if (phase == 1) {
 			ra_node_page(sbi, le32_to_cpu(entry->nid));
 			continue;
 		}
@@ -587,18 +618,29 @@ next_step:
 		if (check_dnode(sbi, entry, &dni, start_addr + off, &nofs) == 0)
 			continue;
 
-		if (phase == 1) {
+		if (phase == 2) {
+			ra_nat_block(sbi, dni.ino);
+			continue;
+		}
+
+		if (phase == 3) {
 			ra_node_page(sbi, dni.ino);
 			continue;
 		}
 
 		ofs_in_node = le16_to_cpu(entry->ofs_in_node);
 
-		if (phase == 2) {
+		if (phase == 4) {
 			inode = f2fs_iget(sb, dni.ino);
 			if (IS_ERR(inode) || is_bad_inode(inode))
 				continue;
 
+			/* slots of a compressed cluster are no data pages */
+			if (f2fs_compressed_file(inode)) {
+				add_gc_inode(gc_list, inode);
+				continue;
+			}
+
 			start_bidx = start_bidx_of_node(nofs, F2FS_I(inode));
 
 			data_page = find_data_page(inode,
@@ -617,6 +659,13 @@ next_step:
 		inode = find_gc_inode(gc_list, dni.ino);
 		if (inode) {
 			start_bidx = start_bidx_of_node(nofs, F2FS_I(inode));
+			if (f2fs_compressed_file(inode) &&
+				f2fs_move_compressed_block(inode,
+					start_bidx + ofs_in_node,
+					start_addr + off) != -EAGAIN) {
+				stat_inc_data_blk_count(sbi, 1, gc_type);
+				continue;
+			}
 			data_page = get_lock_data_page(inode,
 						start_bidx + ofs_in_node);
 			if (IS_ERR(data_page))
@@ -626,7 +675,7 @@ next_step:
 		}
 	}
 
-	if (++phase < 4)
+	if (++phase < 6)
 		goto next_step;
 
 	if (gc_type == FG_GC) {
@@ -637,7 +686,7 @@ next_step:
 		 * completely.
 		 */
 		if (get_valid_blocks(sbi, segno, 1) != 0) {
-			phase = 2;
+			phase = 4;
 			goto next_step;
 		}
 	}
@@ -16,6 +16,8 @@
 #define DEF_GC_THREAD_MIN_SLEEP_TIME	30000	/* milliseconds */
 #define DEF_GC_THREAD_MAX_SLEEP_TIME	60000
 #define DEF_GC_THREAD_NOGC_SLEEP_TIME	300000	/* wait 5 min */
+#define DEF_GC_THREAD_URGENT_SLEEP_TIME	500	/* 500 ms */
+#define DEF_GC_IDLE_INTERVAL		5000	/* quiet disk time before GC */
 #define LIMIT_INVALID_BLOCK	40 /* percentage over total user space */
 #define LIMIT_FREE_BLOCK	40 /* percentage over invalid + free space */
 
@@ -33,6 +35,12 @@ struct f2fs_gc_kthread {
 
 	/* for changing gc mode */
 	unsigned int gc_idle;
+	unsigned int gc_urgent;
+	unsigned int gc_wake;
+
+	/* for urgent mode and device idleness */
+	unsigned int urgent_sleep_time;
+	unsigned int idle_interval;
 };
 
 struct gc_inode_list {
@@ -108,3 +116,19 @@ static inline int is_idle(struct f2fs_sb_info *sbi)
 	struct request_list *rl = &q->root_rl;
 	return !(rl->count[BLK_RW_SYNC]) && !(rl->count[BLK_RW_ASYNC]);
 }
+
+/*
+ * The whole disk, not just this partition, has had nothing in flight
+ * and has neither started nor completed a request for interval_ms.
+ */
+static inline bool is_device_idle(struct f2fs_sb_info *sbi,
+						unsigned int interval_ms)
+{
+	struct hd_struct *part = &sbi->sb->s_bdev->bd_disk->part0;
+
+	if (!is_idle(sbi) || part_in_flight(part))
+		return false;
+
+	return time_after(jiffies, ACCESS_ONCE(part->stamp) +
+					msecs_to_jiffies(interval_ms));
+}
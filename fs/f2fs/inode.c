@@ -15,6 +15,7 @@
 
 #include "f2fs.h"
 #include "node.h"
+#include "acl.h"
 
 #include <trace/events/f2fs.h>
 
@@ -138,6 +139,9 @@ static int do_read_inode(struct inode *inode)
 	fi->i_pino = le32_to_cpu(ri->i_pino);
 	fi->i_dir_level = ri->i_dir_level;
 
+	if (f2fs_compressed_file(inode))
+		set_inode_flag(fi, FI_NO_EXTENT);
+
 	f2fs_init_extent_cache(inode, &ri->i_ext);
 
 	get_inline_info(fi, ri);
@@ -152,6 +156,8 @@ static int do_read_inode(struct inode *inode)
 	if (__written_first_block(ri))
 		set_inode_flag(F2FS_I(inode), FI_FIRST_BLOCK_WRITTEN);
 
+	f2fs_init_acl_cache(inode, node_page);
+
 	f2fs_put_page(node_page, 1);
 
 	stat_inc_inline_inode(inode);
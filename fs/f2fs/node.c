@@ -69,6 +69,10 @@ bool available_free_memory(struct f2fs_sb_info *sbi, int type)
 				atomic_read(&sbi->total_ext_node) *
 				sizeof(struct extent_node)) >> PAGE_CACHE_SHIFT;
 		res = mem_size < ((avail_ram * nm_i->ram_thresh / 100) >> 1);
+	} else if (type == INMEM_PAGES) {
+		/* atomic writes may pin up to 20% of total ram */
+		mem_size = get_pages(sbi, F2FS_INMEM_PAGES);
+		res = mem_size < (val.totalram / 5);
 	} else {
 		if (sbi->sb->s_bdi->dirty_exceeded)
 			return false;
@@ -1014,6 +1018,33 @@ static int read_node_page(struct page *page, int rw)
 	return f2fs_submit_page_bio(sbi, page, &fio);
 }
 
+/*
+ * Readahead the NAT block of a nid missing from the NAT cache, so that a
+ * later get_node_info() on it does not wait for its own block read.
+ * Callers walk many nids under a plug so the reads go out together.
+ */
+void ra_nat_block(struct f2fs_sb_info *sbi, nid_t nid)
+{
+	struct f2fs_nm_info *nm_i = NM_I(sbi);
+	struct nat_entry *e;
+	struct page *page;
+
+	down_read(&nm_i->nat_tree_lock);
+	e = __lookup_nat_cache(nm_i, nid);
+	up_read(&nm_i->nat_tree_lock);
+	if (e)
+		return;
+
+	/* cached or already being read, which would block ra_meta_pages */
+	page = find_get_page(META_MAPPING(sbi), current_nat_addr(sbi, nid));
+	if (page) {
+		f2fs_put_page(page, 0);
+		return;
+	}
+
+	ra_meta_pages(sbi, NAT_BLOCK_OFFSET(nid), 1, META_NAT);
+}
+
 /*
  * Readahead a node page
  */
@@ -169,7 +169,7 @@ static int find_fsync_dnodes(struct f2fs_sb_info *sbi, struct list_head *head)
 	curseg = CURSEG_I(sbi, CURSEG_WARM_NODE);
 	blkaddr = NEXT_FREE_BLKADDR(sbi, curseg);
 
-	ra_meta_pages(sbi, blkaddr, 1, META_POR);
+	ra_meta_pages_cond(sbi, blkaddr);
 
 	while (1) {
 		struct fsync_inode_entry *entry;
@@ -351,7 +351,7 @@ static int do_recover_data(struct f2fs_sb_info *sbi, struct inode *inode,
 	struct dnode_of_data dn;
 	struct f2fs_summary sum;
 	struct node_info ni;
-	int err = 0, recovered = 0;
+	int err = 0, recovered = 0, cluster_left = 0;
 
 	/* step 1: recover xattr */
 	if (IS_INODE(page)) {
@@ -395,6 +395,31 @@ static int do_recover_data(struct f2fs_sb_info *sbi, struct inode *inode,
 		src = datablock_addr(dn.node_page, dn.ofs_in_node);
 		dest = datablock_addr(page, dn.ofs_in_node);
 
+		/*
+		 * A cluster compressed since the checkpoint frees the raw
+		 * blocks it replaces, one uncompressed since drops its marker
+		 * before its raw blocks are recovered below.
+		 */
+		if (dest == COMPRESS_ADDR)
+			cluster_left = F2FS_CLUSTER_SIZE;
+		if (cluster_left) {
+			cluster_left--;
+			if (src != dest && src != NULL_ADDR &&
+				(dest == COMPRESS_ADDR || dest == NULL_ADDR)) {
+				truncate_data_blocks_range(&dn, 1);
+				src = NULL_ADDR;
+			}
+			if (dest == COMPRESS_ADDR && src != dest) {
+				dn.data_blkaddr = COMPRESS_ADDR;
+				set_data_blkaddr(&dn);
+				recovered++;
+			}
+		} else if (src == COMPRESS_ADDR && src != dest) {
+			dn.data_blkaddr = NULL_ADDR;
+			set_data_blkaddr(&dn);
+			src = NULL_ADDR;
+		}
+
 		if (src != dest && dest != NEW_ADDR && dest != NULL_ADDR &&
 			dest >= MAIN_BLKADDR(sbi) && dest < MAX_BLKADDR(sbi)) {
 
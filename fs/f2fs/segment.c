@@ -13,6 +13,7 @@
 #include <linux/bio.h>
 #include <linux/blkdev.h>
 #include <linux/prefetch.h>
+#include <linux/pagevec.h>
 #include <linux/kthread.h>
 #include <linux/vmalloc.h>
 #include <linux/swap.h>
@@ -21,6 +22,7 @@
 #include "segment.h"
 #include "node.h"
 #include "trace.h"
+#include "gc.h"
 #include <trace/events/f2fs.h>
 
 #define __reverse_ffz(x) __reverse_ffs(~(x))
@@ -234,6 +236,29 @@ found_middle:
 	return result + __reverse_ffz(tmp);
 }
 
+/*
+ * Atomic written pages stay pinned until commit, so a transaction may only
+ * grow while the inode is under max_inmem_pages and all atomic files under
+ * the global budget.  Rewriting a page that is already registered costs
+ * nothing and is always allowed.
+ */
+bool may_register_inmem_page(struct inode *inode, pgoff_t index)
+{
+	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	bool ret = true;
+
+	mutex_lock(&fi->inmem_lock);
+	if (radix_tree_lookup(&fi->inmem_root, index))
+		goto out;
+	if (fi->inmem_cnt >= SM_I(sbi)->max_inmem_pages ||
+			!available_free_memory(sbi, INMEM_PAGES))
+		ret = false;
+out:
+	mutex_unlock(&fi->inmem_lock);
+	return ret;
+}
+
 void register_inmem_page(struct inode *inode, struct page *page)
 {
 	struct f2fs_inode_info *fi = F2FS_I(inode);
@@ -262,6 +287,7 @@ retry:
 	}
 	get_page(page);
 	list_add_tail(&new->list, &fi->inmem_pages);
+	fi->inmem_cnt++;
 	inc_page_count(F2FS_I_SB(inode), F2FS_INMEM_PAGES);
 	mutex_unlock(&fi->inmem_lock);
 
@@ -272,7 +298,10 @@ void commit_inmem_pages(struct inode *inode, bool abort)
 {
 	struct f2fs_sb_info *sbi = F2FS_I_SB(inode);
 	struct f2fs_inode_info *fi = F2FS_I(inode);
-	struct inmem_pages *cur, *tmp;
+	struct inmem_pages *batch[PAGEVEC_SIZE];
+	struct inmem_pages *cur;
+	unsigned int nr, i;
+	pgoff_t start = 0;
 	bool submit_bio = false;
 	struct f2fs_io_info fio = {
 		.type = DATA,
@@ -291,27 +320,43 @@ void commit_inmem_pages(struct inode *inode, bool abort)
 		f2fs_lock_op(sbi);
 	}
 
+	/*
+	 * Walk the pages in file offset order rather than in the order they
+	 * were dirtied, so that the blocks are allocated back to back and the
+	 * whole transaction goes out as a few merged bios submitted at once.
+	 */
 	mutex_lock(&fi->inmem_lock);
-	list_for_each_entry_safe(cur, tmp, &fi->inmem_pages, list) {
-		if (!abort) {
+	while ((nr = radix_tree_gang_lookup(&fi->inmem_root, (void **)batch,
+							start, PAGEVEC_SIZE))) {
+		start = batch[nr - 1]->page->index + 1;
+
+		for (i = 0; i < nr; i++) {
+			cur = batch[i];
 			lock_page(cur->page);
-			if (cur->page->mapping == inode->i_mapping) {
+			if (cur->page->mapping != inode->i_mapping)
+				goto next;
+			if (!abort) {
 				f2fs_wait_on_page_writeback(cur->page, DATA);
 				if (clear_page_dirty_for_io(cur->page))
 					inode_dec_dirty_pages(inode);
 				trace_f2fs_commit_inmem_page(cur->page, INMEM);
 				do_write_data_page(cur->page, &fio);
 				submit_bio = true;
+			} else {
+				/* let the next reader see the on-disk data */
+				trace_f2fs_commit_inmem_page(cur->page,
+								INMEM_DROP);
+				if (!PageDirty(cur->page))
+					ClearPageUptodate(cur->page);
 			}
+next:
+			radix_tree_delete(&fi->inmem_root, cur->page->index);
 			f2fs_put_page(cur->page, 1);
-		} else {
-			trace_f2fs_commit_inmem_page(cur->page, INMEM_DROP);
-			put_page(cur->page);
+			list_del(&cur->list);
+			kmem_cache_free(inmem_entry_slab, cur);
+			fi->inmem_cnt--;
+			dec_page_count(sbi, F2FS_INMEM_PAGES);
 		}
-		radix_tree_delete(&fi->inmem_root, cur->page->index);
-		list_del(&cur->list);
-		kmem_cache_free(inmem_entry_slab, cur);
-		dec_page_count(F2FS_I_SB(inode), F2FS_INMEM_PAGES);
 	}
 	mutex_unlock(&fi->inmem_lock);
 
@@ -529,6 +574,197 @@ static int f2fs_issue_discard(struct f2fs_sb_info *sbi,
 	return blkdev_issue_discard(sbi->sb->s_bdev, start, len, GFP_NOFS, 0);
 }
 
+/* issue and free a list of ranges taken off the discard thread's list */
+static void __issue_discard_list(struct f2fs_sb_info *sbi,
+			struct list_head *head, unsigned int granularity)
+{
+	struct discard_entry *entry, *this;
+
+	list_for_each_entry_safe(entry, this, head, list) {
+		if (entry->len >= granularity)
+			f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		list_del(&entry->list);
+		kmem_cache_free(discard_entry_slab, entry);
+	}
+}
+
+/*
+ * Ranges are issued with issue_lock held, so that once a caller holds it
+ * nothing taken off cmd_list is still on its way to the device.
+ */
+static void issue_discard_cmds(struct f2fs_sb_info *sbi,
+			unsigned int max, unsigned int granularity)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct discard_entry *entry, *this;
+	LIST_HEAD(batch);
+
+	mutex_lock(&dcc->issue_lock);
+	mutex_lock(&dcc->cmd_lock);
+	list_for_each_entry_safe(entry, this, &dcc->cmd_list, list) {
+		if (!max--)
+			break;
+		list_move_tail(&entry->list, &batch);
+		dcc->nr_cmds--;
+	}
+	mutex_unlock(&dcc->cmd_lock);
+
+	__issue_discard_list(sbi, &batch, granularity);
+	mutex_unlock(&dcc->issue_lock);
+}
+
+/*
+ * A segment is about to be written again, so any pending discard over
+ * it has to reach the device first.
+ */
+static void wait_discard_segment(struct f2fs_sb_info *sbi, unsigned int segno)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	block_t start = START_BLOCK(sbi, segno);
+	block_t end = start + sbi->blocks_per_seg;
+	struct discard_entry *entry, *this;
+	LIST_HEAD(batch);
+
+	if (!dcc)
+		return;
+
+	mutex_lock(&dcc->issue_lock);
+	mutex_lock(&dcc->cmd_lock);
+	list_for_each_entry_safe(entry, this, &dcc->cmd_list, list) {
+		if (entry->blkaddr >= end)
+			break;
+		if (entry->blkaddr + entry->len <= start)
+			continue;
+		list_move_tail(&entry->list, &batch);
+		dcc->nr_cmds--;
+	}
+	mutex_unlock(&dcc->cmd_lock);
+
+	__issue_discard_list(sbi, &batch, 1);
+	mutex_unlock(&dcc->issue_lock);
+}
+
+/* add a range to the address ordered list, merging it with its neighbours */
+static void queue_discard_cmd(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	struct list_head *head = &dcc->cmd_list;
+	struct discard_entry *entry, *prev = NULL, *next;
+
+	mutex_lock(&dcc->cmd_lock);
+	list_for_each_entry(entry, head, list) {
+		if (entry->blkaddr > blkstart)
+			break;
+		prev = entry;
+	}
+
+	if (prev && prev->blkaddr + prev->len == blkstart) {
+		prev->len += blklen;
+		entry = prev;
+	} else {
+		entry = f2fs_kmem_cache_alloc(discard_entry_slab, GFP_NOFS);
+		entry->blkaddr = blkstart;
+		entry->len = blklen;
+		list_add(&entry->list, prev ? &prev->list : head);
+		dcc->nr_cmds++;
+	}
+
+	if (!list_is_last(&entry->list, head)) {
+		next = list_entry(entry->list.next, struct discard_entry, list);
+		if (entry->blkaddr + entry->len == next->blkaddr) {
+			entry->len += next->len;
+			list_del(&next->list);
+			kmem_cache_free(discard_entry_slab, next);
+			dcc->nr_cmds--;
+		}
+	}
+	mutex_unlock(&dcc->cmd_lock);
+
+	wake_up(&dcc->discard_wait_queue);
+}
+
+static void f2fs_queue_discard(struct f2fs_sb_info *sbi,
+				block_t blkstart, block_t blklen)
+{
+	if (SM_I(sbi)->dcc_info)
+		queue_discard_cmd(sbi, blkstart, blklen);
+	else
+		f2fs_issue_discard(sbi, blkstart, blklen);
+}
+
+/*
+ * Pending discards go out in small batches while the disk is idle, so
+ * they stay off the checkpoint path and out of the way of foreground
+ * I/O.  A list that keeps growing on a busy disk is issued anyway.
+ */
+static int issue_discard_thread(void *data)
+{
+	struct f2fs_sb_info *sbi = data;
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+	wait_queue_head_t *q = &dcc->discard_wait_queue;
+repeat:
+	if (kthread_should_stop())
+		return 0;
+
+	if (!list_empty(&dcc->cmd_list)) {
+		if (is_device_idle(sbi, 0) ||
+				dcc->nr_cmds > MAX_DISCARD_PENDING)
+			issue_discard_cmds(sbi, dcc->max_discard_issue,
+						dcc->discard_granularity);
+
+		wait_event_interruptible_timeout(*q, kthread_should_stop(),
+				msecs_to_jiffies(DEF_DISCARD_ISSUE_INTERVAL));
+		goto repeat;
+	}
+
+	wait_event_interruptible(*q,
+		kthread_should_stop() || !list_empty(&dcc->cmd_list));
+	goto repeat;
+}
+
+int create_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	dev_t dev = sbi->sb->s_bdev->bd_dev;
+	struct discard_cmd_control *dcc;
+	int err = 0;
+
+	dcc = kzalloc(sizeof(struct discard_cmd_control), GFP_KERNEL);
+	if (!dcc)
+		return -ENOMEM;
+	init_waitqueue_head(&dcc->discard_wait_queue);
+	mutex_init(&dcc->cmd_lock);
+	mutex_init(&dcc->issue_lock);
+	INIT_LIST_HEAD(&dcc->cmd_list);
+	dcc->max_discard_issue = DEF_MAX_DISCARD_ISSUE;
+	dcc->discard_granularity = DEF_DISCARD_GRANULARITY;
+	SM_I(sbi)->dcc_info = dcc;
+	dcc->f2fs_issue_discard = kthread_run(issue_discard_thread, sbi,
+				"f2fs_discard-%u:%u", MAJOR(dev), MINOR(dev));
+	if (IS_ERR(dcc->f2fs_issue_discard)) {
+		err = PTR_ERR(dcc->f2fs_issue_discard);
+		kfree(dcc);
+		SM_I(sbi)->dcc_info = NULL;
+		return err;
+	}
+
+	return err;
+}
+
+void destroy_discard_cmd_control(struct f2fs_sb_info *sbi)
+{
+	struct discard_cmd_control *dcc = SM_I(sbi)->dcc_info;
+
+	if (!dcc)
+		return;
+	if (dcc->f2fs_issue_discard)
+		kthread_stop(dcc->f2fs_issue_discard);
+	/* whatever is left was asked for, send it before going away */
+	issue_discard_cmds(sbi, UINT_MAX, dcc->discard_granularity);
+	kfree(dcc);
+	SM_I(sbi)->dcc_info = NULL;
+}
+
 void discard_next_dnode(struct f2fs_sb_info *sbi, block_t blkaddr)
 {
 	if (f2fs_issue_discard(sbi, blkaddr, 1)) {
@@ -634,6 +870,18 @@ void release_discard_addrs(struct f2fs_sb_info *sbi)
 	}
 }
 
+static bool curseg_in_range(struct f2fs_sb_info *sbi,
+				block_t blkaddr, block_t len)
+{
+	unsigned int segno = GET_SEGNO(sbi, blkaddr);
+	unsigned int end = GET_SEGNO(sbi, blkaddr + len - 1);
+
+	for (; segno <= end; segno++)
+		if (IS_CURSEG(sbi, segno))
+			return true;
+	return false;
+}
+
 /*
  * Should call clear_prefree_segments after checkpoint is done.
  */
@@ -674,14 +922,20 @@ void clear_prefree_segments(struct f2fs_sb_info *sbi)
 		if (!test_opt(sbi, DISCARD))
 			continue;
 
-		f2fs_issue_discard(sbi, START_BLOCK(sbi, start),
+		f2fs_queue_discard(sbi, START_BLOCK(sbi, start),
 				(end - start) << sbi->log_blocks_per_seg);
 	}
 	mutex_unlock(&dirty_i->seglist_lock);
 
-	/* send small discards */
+	/*
+	 * send small discards; an SSR current segment may reuse these
+	 * blocks without allocating again, so those cannot wait
+	 */
 	list_for_each_entry_safe(entry, this, head, list) {
-		f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		if (curseg_in_range(sbi, entry->blkaddr, entry->len))
+			f2fs_issue_discard(sbi, entry->blkaddr, entry->len);
+		else
+			f2fs_queue_discard(sbi, entry->blkaddr, entry->len);
 		list_del(&entry->list);
 		SM_I(sbi)->nr_discards -= entry->len;
 		kmem_cache_free(discard_entry_slab, entry);
@@ -980,6 +1234,7 @@ static void new_curseg(struct f2fs_sb_info *sbi, int type, bool new_sec)
 		dir = ALLOC_RIGHT;
 
 	get_new_segment(sbi, &segno, new_sec, dir);
+	wait_discard_segment(sbi, segno);
 	curseg->next_segno = segno;
 	reset_curseg(sbi, type, 1);
 	curseg->alloc_type = LFS;
@@ -1032,6 +1287,7 @@ static void change_curseg(struct f2fs_sb_info *sbi, int type, bool reuse)
 	write_sum_page(sbi, curseg->sum_blk,
 				GET_SUM_BLOCK(sbi, curseg->segno));
 	__set_test_and_inuse(sbi, new_segno);
+	wait_discard_segment(sbi, new_segno);
 
 	mutex_lock(&dirty_i->seglist_lock);
 	__remove_dirty_segment(sbi, new_segno, PRE);
@@ -1145,6 +1401,10 @@ int f2fs_trim_fs(struct f2fs_sb_info *sbi, struct fstrim_range *range)
 		write_checkpoint(sbi, &cpc);
 		mutex_unlock(&sbi->gc_mutex);
 	}
+
+	/* FITRIM returns once the ranges have reached the device */
+	if (SM_I(sbi)->dcc_info)
+		issue_discard_cmds(sbi, UINT_MAX, 1);
 out:
 	range->len = F2FS_BLK_TO_BYTES(cpc.trimmed);
 	return 0;
@@ -1183,17 +1443,65 @@ static int __get_segment_type_4(struct page *page, enum page_type p_type)
 	}
 }
 
-static int __get_segment_type_6(struct page *page, enum page_type p_type)
+/*
+ * Learned temperature of a regular file's data. Rewriting a block that
+ * already has an address adds to the inode's write score, which halves
+ * every temp_decay_interval. Data of a file rewritten faster than its score
+ * decays goes to the hot log. Data appended to a file that has been loaded
+ * for a whole interval and has no rewrites left in its score goes to the
+ * cold log. The rest stays warm.
+ */
+static int __get_data_temp(struct inode *inode, block_t old_blkaddr)
 {
-	if (p_type == DATA) {
+	struct f2fs_sm_info *sm_i = SM_I(F2FS_I_SB(inode));
+	struct f2fs_inode_info *fi = F2FS_I(inode);
+	unsigned long interval = msecs_to_jiffies(sm_i->temp_decay_interval);
+	unsigned long now = jiffies;
+	unsigned long periods;
+	bool rewrite = old_blkaddr != NEW_ADDR && old_blkaddr != NULL_ADDR;
+
+	if (!sm_i->hot_data_thresh || !interval)
+		return CURSEG_WARM_DATA;
+
+	periods = (now - fi->i_score_stamp) / interval;
+	if (periods) {
+		fi->i_write_score = periods < 32 ?
+					fi->i_write_score >> periods : 0;
+		fi->i_score_stamp += periods * interval;
+	}
+
+	if (rewrite && fi->i_write_score < UINT_MAX)
+		fi->i_write_score++;
+
+	if (fi->i_write_score >= sm_i->hot_data_thresh) {
+		atomic_inc(&sm_i->learned_hot_blocks);
+		return CURSEG_HOT_DATA;
+	}
+
+	if (!rewrite && !fi->i_write_score &&
+	    time_after(now, fi->i_temp_start + interval)) {
+		atomic_inc(&sm_i->learned_cold_blocks);
+		return CURSEG_COLD_DATA;
+	}
+
+	return CURSEG_WARM_DATA;
+}
+
+static int __get_segment_type_6(struct page *page, struct f2fs_io_info *fio)
+{
+	if (fio->type == DATA) {
 		struct inode *inode = page->mapping->host;
+		int type;
 
 		if (S_ISDIR(inode->i_mode))
-			return CURSEG_HOT_DATA;
+			type = CURSEG_HOT_DATA;
 		else if (is_cold_data(page) || file_is_cold(inode))
-			return CURSEG_COLD_DATA;
+			type = CURSEG_COLD_DATA;
 		else
-			return CURSEG_WARM_DATA;
+			type = __get_data_temp(inode, fio->blk_addr);
+
+		atomic_inc(&SM_I(F2FS_P_SB(page))->data_blocks[type]);
+		return type;
 	} else {
 		if (IS_DNODE(page))
 			return is_cold_node(page) ? CURSEG_WARM_NODE :
@@ -1203,18 +1511,18 @@ static int __get_segment_type_6(struct page *page, enum page_type p_type)
 	}
 }
 
-static int __get_segment_type(struct page *page, enum page_type p_type)
+static int __get_segment_type(struct page *page, struct f2fs_io_info *fio)
 {
 	switch (F2FS_P_SB(page)->active_logs) {
 	case 2:
-		return __get_segment_type_2(page, p_type);
+		return __get_segment_type_2(page, fio->type);
 	case 4:
-		return __get_segment_type_4(page, p_type);
+		return __get_segment_type_4(page, fio->type);
 	}
 	/* NR_CURSEG_TYPE(6) logs by default */
 	f2fs_bug_on(F2FS_P_SB(page),
 		F2FS_P_SB(page)->active_logs != NR_CURSEG_TYPE);
-	return __get_segment_type_6(page, p_type);
+	return __get_segment_type_6(page, fio);
 }
 
 void allocate_data_block(struct f2fs_sb_info *sbi, struct page *page,
@@ -1269,7 +1577,7 @@ static void do_write_page(struct f2fs_sb_info *sbi, struct page *page,
 			struct f2fs_summary *sum,
 			struct f2fs_io_info *fio)
 {
-	int type = __get_segment_type(page, fio->type);
+	int type = __get_segment_type(page, fio);
 
 	allocate_data_block(sbi, page, fio->blk_addr, &fio->blk_addr, sum, type);
 
@@ -2022,11 +2330,16 @@ static void build_sit_entries(struct f2fs_sb_info *sbi)
 	struct f2fs_summary_block *sum = curseg->sum_blk;
 	int sit_blk_cnt = SIT_BLK_CNT(sbi);
 	unsigned int i, start, end;
-	unsigned int readed, start_blk = 0;
+	unsigned int readed, next, start_blk = 0;
 	int nrpages = MAX_BIO_BLOCKS(sbi);
 
+	readed = ra_meta_pages(sbi, start_blk, nrpages, META_SIT);
 	do {
-		readed = ra_meta_pages(sbi, start_blk, nrpages, META_SIT);
+		/* keep the next batch in flight while this one is parsed */
+		next = 0;
+		if (start_blk + readed < sit_blk_cnt)
+			next = ra_meta_pages(sbi, start_blk + readed, nrpages,
+								META_SIT);
 
 		start = start_blk * sit_i->sents_per_block;
 		end = (start_blk + readed) * sit_i->sents_per_block;
@@ -2061,6 +2374,7 @@ got_it:
 			}
 		}
 		start_blk += readed;
+		readed = next;
 	} while (start_blk < sit_blk_cnt);
 }
 
@@ -2197,6 +2511,9 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 	sm_info->ipu_policy = 1 << F2FS_IPU_FSYNC;
 	sm_info->min_ipu_util = DEF_MIN_IPU_UTIL;
 	sm_info->min_fsync_blocks = DEF_MIN_FSYNC_BLOCKS;
+	sm_info->max_inmem_pages = DEF_MAX_INMEM_PAGES;
+	sm_info->hot_data_thresh = DEF_HOT_DATA_THRESH;
+	sm_info->temp_decay_interval = DEF_TEMP_DECAY_INTERVAL;
 
 	INIT_LIST_HEAD(&sm_info->discard_list);
 	sm_info->nr_discards = 0;
@@ -2212,6 +2529,12 @@ int build_segment_manager(struct f2fs_sb_info *sbi)
 			return err;
 	}
 
+	if (test_opt(sbi, DISCARD) && !f2fs_readonly(sbi->sb)) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			return err;
+	}
+
 	err = build_sit_info(sbi);
 	if (err)
 		return err;
@@ -2324,6 +2647,7 @@ void destroy_segment_manager(struct f2fs_sb_info *sbi)
 	if (!sm_info)
 		return;
 	destroy_flush_cmd_control(sbi);
+	destroy_discard_cmd_control(sbi);
 	destroy_dirty_segmap(sbi);
 	destroy_curseg(sbi);
 	destroy_free_segmap(sbi);
@@ -16,6 +16,12 @@
 
 #define DEF_RECLAIM_PREFREE_SEGMENTS	5	/* 5% over total segments */
 
+/* discard thread */
+#define DEF_MAX_DISCARD_ISSUE		8	/* ranges issued per batch */
+#define DEF_DISCARD_ISSUE_INTERVAL	50	/* ms between two batches */
+#define DEF_DISCARD_GRANULARITY		1	/* min. blocks of a discard */
+#define MAX_DISCARD_PENDING		1024	/* issue even if not idle */
+
 /* L: Logical segment # in volume, R: Relative segment # in main area */
 #define GET_L2R_SEGNO(free_i, segno)	(segno - free_i->start_segno)
 #define GET_R2L_SEGNO(free_i, segno)	(segno + free_i->start_segno)
@@ -495,6 +501,16 @@ static inline int utilization(struct f2fs_sb_info *sbi)
 #define DEF_MIN_IPU_UTIL	70
 #define DEF_MIN_FSYNC_BLOCKS	8
 
+/* max # of pages an atomic write transaction can pin in memory per inode */
+#define DEF_MAX_INMEM_PAGES	4096
+
+/*
+ * Learned data temperature: block rewrites in a file, halved every
+ * DEF_TEMP_DECAY_INTERVAL ms, that send its data to the hot log.
+ */
+#define DEF_HOT_DATA_THRESH	32
+#define DEF_TEMP_DECAY_INTERVAL	30000
+
 enum {
 	F2FS_IPU_FORCE,
 	F2FS_IPU_SSR,
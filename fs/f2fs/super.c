@@ -55,10 +55,12 @@ enum {
 	Opt_inline_data,
 	Opt_inline_dentry,
 	Opt_flush_merge,
+	Opt_checkpoint_merge,
 	Opt_nobarrier,
 	Opt_fastboot,
 	Opt_extent_cache,
 	Opt_noinline_data,
+	Opt_compress_algorithm,
 	Opt_err,
 };
 
@@ -78,10 +80,12 @@ static match_table_t f2fs_tokens = {
 	{Opt_inline_data, "inline_data"},
 	{Opt_inline_dentry, "inline_dentry"},
 	{Opt_flush_merge, "flush_merge"},
+	{Opt_checkpoint_merge, "checkpoint_merge"},
 	{Opt_nobarrier, "nobarrier"},
 	{Opt_fastboot, "fastboot"},
 	{Opt_extent_cache, "extent_cache"},
 	{Opt_noinline_data, "noinline_data"},
+	{Opt_compress_algorithm, "compress_algorithm=%s"},
 	{Opt_err, NULL},
 };
 
@@ -91,6 +95,7 @@ enum {
 	SM_INFO,	/* struct f2fs_sm_info */
 	NM_INFO,	/* struct f2fs_nm_info */
 	F2FS_SBI,	/* struct f2fs_sb_info */
+	DCC_INFO,	/* struct discard_cmd_control */
 };
 
 struct f2fs_attr {
@@ -112,6 +117,8 @@ static unsigned char *__struct_ptr(struct f2fs_sb_info *sbi, int struct_type)
 		return (unsigned char *)NM_I(sbi);
 	else if (struct_type == F2FS_SBI)
 		return (unsigned char *)sbi;
+	else if (struct_type == DCC_INFO)
+		return (unsigned char *)SM_I(sbi)->dcc_info;
 	return NULL;
 }
 
@@ -149,9 +156,48 @@ static ssize_t f2fs_sbi_store(struct f2fs_attr *a,
 	if (ret < 0)
 		return ret;
 	*ui = t;
+
+	/* start urgent GC right away rather than after the current sleep */
+	if (a->struct_type == GC_THREAD && t &&
+	    a->offset == offsetof(struct f2fs_gc_kthread, gc_urgent)) {
+		sbi->gc_thread->gc_wake = 1;
+		wake_up_interruptible_all(&sbi->gc_thread->gc_wait_queue_head);
+	}
 	return count;
 }
 
+static ssize_t f2fs_ckpt_merge_show(struct f2fs_attr *a,
+			struct f2fs_sb_info *sbi, char *buf)
+{
+	struct ckpt_req_control *cprc = sbi->cprc_info;
+	u64 avg_us = 0;
+
+	if (!cprc)
+		return -EINVAL;
+
+	if (cprc->total_waiters)
+		avg_us = div_u64(cprc->total_wait_us, cprc->total_waiters);
+
+	return snprintf(buf, PAGE_SIZE,
+		"checkpoints %u requests %u avg_wait_us %llu peak_wait_us %u\n",
+		cprc->issued_ckpt, cprc->total_waiters,
+		(unsigned long long)avg_us, cprc->peak_wait_us);
+}
+
+static ssize_t f2fs_data_temp_show(struct f2fs_attr *a,
+			struct f2fs_sb_info *sbi, char *buf)
+{
+	struct f2fs_sm_info *sm_i = SM_I(sbi);
+
+	return snprintf(buf, PAGE_SIZE,
+		"hot %d warm %d cold %d learned_hot %d learned_cold %d\n",
+		atomic_read(&sm_i->data_blocks[CURSEG_HOT_DATA]),
+		atomic_read(&sm_i->data_blocks[CURSEG_WARM_DATA]),
+		atomic_read(&sm_i->data_blocks[CURSEG_COLD_DATA]),
+		atomic_read(&sm_i->learned_hot_blocks),
+		atomic_read(&sm_i->learned_cold_blocks));
+}
+
 static ssize_t f2fs_attr_show(struct kobject *kobj,
 				struct attribute *attr, char *buf)
 {
@@ -197,15 +243,31 @@ F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_min_sleep_time, min_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_max_sleep_time, max_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_no_gc_sleep_time, no_gc_sleep_time);
 F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_idle, gc_idle);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_urgent, gc_urgent);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_urgent_sleep_time,
+							urgent_sleep_time);
+F2FS_RW_ATTR(GC_THREAD, f2fs_gc_kthread, gc_idle_interval, idle_interval);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, reclaim_segments, rec_prefree_segments);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, max_small_discards, max_discards);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, batched_trim_sections, trim_sections);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, ipu_policy, ipu_policy);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, min_ipu_util, min_ipu_util);
 F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, min_fsync_blocks, min_fsync_blocks);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, max_inmem_pages, max_inmem_pages);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, hot_data_thresh, hot_data_thresh);
+F2FS_RW_ATTR(SM_INFO, f2fs_sm_info, temp_decay_interval,
+							temp_decay_interval);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, discard_granularity,
+							discard_granularity);
+F2FS_RW_ATTR(DCC_INFO, discard_cmd_control, max_discard_issue,
+							max_discard_issue);
 F2FS_RW_ATTR(NM_INFO, f2fs_nm_info, ram_thresh, ram_thresh);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, max_victim_search, max_victim_search);
 F2FS_RW_ATTR(F2FS_SBI, f2fs_sb_info, dir_level, dir_level);
+F2FS_ATTR_OFFSET(F2FS_SBI, ckpt_merge_stats, 0444,
+		f2fs_ckpt_merge_show, NULL, 0);
+F2FS_ATTR_OFFSET(SM_INFO, data_temp_stats, 0444,
+		f2fs_data_temp_show, NULL, 0);
 
 #define ATTR_LIST(name) (&f2fs_attr_##name.attr)
 static struct attribute *f2fs_attrs[] = {
@@ -213,14 +275,24 @@ static struct attribute *f2fs_attrs[] = {
 	ATTR_LIST(gc_max_sleep_time),
 	ATTR_LIST(gc_no_gc_sleep_time),
 	ATTR_LIST(gc_idle),
+	ATTR_LIST(gc_urgent),
+	ATTR_LIST(gc_urgent_sleep_time),
+	ATTR_LIST(gc_idle_interval),
 	ATTR_LIST(reclaim_segments),
 	ATTR_LIST(max_small_discards),
 	ATTR_LIST(batched_trim_sections),
 	ATTR_LIST(ipu_policy),
 	ATTR_LIST(min_ipu_util),
 	ATTR_LIST(min_fsync_blocks),
+	ATTR_LIST(max_inmem_pages),
+	ATTR_LIST(hot_data_thresh),
+	ATTR_LIST(temp_decay_interval),
+	ATTR_LIST(data_temp_stats),
+	ATTR_LIST(discard_granularity),
+	ATTR_LIST(max_discard_issue),
 	ATTR_LIST(max_victim_search),
 	ATTR_LIST(dir_level),
+	ATTR_LIST(ckpt_merge_stats),
 	ATTR_LIST(ram_thresh),
 	NULL,
 };
@@ -365,6 +437,9 @@ static int parse_options(struct super_block *sb, char *options)
 		case Opt_flush_merge:
 			set_opt(sbi, FLUSH_MERGE);
 			break;
+		case Opt_checkpoint_merge:
+			set_opt(sbi, CHECKPOINT_MERGE);
+			break;
 		case Opt_nobarrier:
 			set_opt(sbi, NOBARRIER);
 			break;
@@ -377,6 +452,21 @@ static int parse_options(struct super_block *sb, char *options)
 		case Opt_noinline_data:
 			clear_opt(sbi, INLINE_DATA);
 			break;
+		case Opt_compress_algorithm:
+			name = match_strdup(&args[0]);
+
+			if (!name)
+				return -ENOMEM;
+			if (strlen(name) == 3 && !strncmp(name, "lzo", 3))
+				sbi->compress_algorithm = F2FS_COMPRESS_LZO;
+			else if (strlen(name) == 3 && !strncmp(name, "lz4", 3))
+				sbi->compress_algorithm = F2FS_COMPRESS_LZ4;
+			else {
+				kfree(name);
+				return -EINVAL;
+			}
+			kfree(name);
+			break;
 		default:
 			f2fs_msg(sb, KERN_ERR,
 				"Unrecognized mount option \"%s\" or missing value",
@@ -407,6 +497,9 @@ static struct inode *f2fs_alloc_inode(struct super_block *sb)
 	INIT_RADIX_TREE(&fi->inmem_root, GFP_NOFS);
 	INIT_LIST_HEAD(&fi->inmem_pages);
 	mutex_init(&fi->inmem_lock);
+	fi->inmem_cnt = 0;
+	fi->i_write_score = 0;
+	fi->i_score_stamp = fi->i_temp_start = jiffies;
 
 	set_inode_flag(fi, FI_NEW_INODE);
 
@@ -466,6 +559,7 @@ static void f2fs_put_super(struct super_block *sb)
 
 	f2fs_destroy_stats(sbi);
 	stop_gc_thread(sbi);
+	destroy_ckpt_req_control(sbi);
 
 	/*
 	 * We don't need to do checkpoint when superblock is clean.
@@ -493,6 +587,7 @@ static void f2fs_put_super(struct super_block *sb)
 	/* destroy f2fs internal modules */
 	destroy_node_manager(sbi);
 	destroy_segment_manager(sbi);
+	f2fs_destroy_compress_ws(sbi);
 
 	kfree(sbi->ckpt);
 	kobject_put(&sbi->s_kobj);
@@ -514,9 +609,13 @@ int f2fs_sync_fs(struct super_block *sb, int sync)
 
 		cpc.reason = __get_cp_reason(sbi);
 
-		mutex_lock(&sbi->gc_mutex);
-		write_checkpoint(sbi, &cpc);
-		mutex_unlock(&sbi->gc_mutex);
+		if (sbi->cprc_info) {
+			f2fs_issue_checkpoint(sbi);
+		} else {
+			mutex_lock(&sbi->gc_mutex);
+			write_checkpoint(sbi, &cpc);
+			mutex_unlock(&sbi->gc_mutex);
+		}
 	} else {
 		f2fs_balance_fs(sbi);
 	}
@@ -607,6 +706,8 @@ static int f2fs_show_options(struct seq_file *seq, struct dentry *root)
 		seq_puts(seq, ",inline_dentry");
 	if (!f2fs_readonly(sbi->sb) && test_opt(sbi, FLUSH_MERGE))
 		seq_puts(seq, ",flush_merge");
+	if (!f2fs_readonly(sbi->sb) && test_opt(sbi, CHECKPOINT_MERGE))
+		seq_puts(seq, ",checkpoint_merge");
 	if (test_opt(sbi, NOBARRIER))
 		seq_puts(seq, ",nobarrier");
 	if (test_opt(sbi, FASTBOOT))
@@ -614,6 +715,8 @@ static int f2fs_show_options(struct seq_file *seq, struct dentry *root)
 	if (test_opt(sbi, EXTENT_CACHE))
 		seq_puts(seq, ",extent_cache");
 	seq_printf(seq, ",active_logs=%u", sbi->active_logs);
+	seq_printf(seq, ",compress_algorithm=%s",
+		sbi->compress_algorithm == F2FS_COMPRESS_LZO ? "lzo" : "lz4");
 
 	return 0;
 }
@@ -662,7 +765,7 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 {
 	struct f2fs_sb_info *sbi = F2FS_SB(sb);
 	struct f2fs_mount_info org_mount_opt;
-	int err, active_logs;
+	int err, active_logs, compress_algorithm;
 	bool need_restart_gc = false;
 	bool need_stop_gc = false;
 
@@ -674,9 +777,11 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 	 */
 	org_mount_opt = sbi->mount_opt;
 	active_logs = sbi->active_logs;
+	compress_algorithm = sbi->compress_algorithm;
 
 	sbi->mount_opt.opt = 0;
 	sbi->active_logs = NR_CURSEG_TYPE;
+	sbi->compress_algorithm = F2FS_COMPRESS_LZ4;
 
 	/* parse mount options */
 	err = parse_options(sb, data);
@@ -712,6 +817,14 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 	 * We stop issue flush thread if FS is mounted as RO
 	 * or if flush_merge is not passed in mount option.
 	 */
+	if ((*flags & MS_RDONLY) || !test_opt(sbi, CHECKPOINT_MERGE)) {
+		destroy_ckpt_req_control(sbi);
+	} else if (!sbi->cprc_info) {
+		err = create_ckpt_req_control(sbi);
+		if (err)
+			goto restore_gc;
+	}
+
 	if ((*flags & MS_RDONLY) || !test_opt(sbi, FLUSH_MERGE)) {
 		destroy_flush_cmd_control(sbi);
 	} else if (!SM_I(sbi)->cmd_control_info) {
@@ -719,6 +832,15 @@ static int f2fs_remount(struct super_block *sb, int *flags, char *data)
 		if (err)
 			goto restore_gc;
 	}
+
+	/* likewise for the discard thread and the discard option */
+	if ((*flags & MS_RDONLY) || !test_opt(sbi, DISCARD)) {
+		destroy_discard_cmd_control(sbi);
+	} else if (!SM_I(sbi)->dcc_info) {
+		err = create_discard_cmd_control(sbi);
+		if (err)
+			goto restore_gc;
+	}
 skip:
 	/* Update the POSIXACL Flag */
 	 sb->s_flags = (sb->s_flags & ~MS_POSIXACL) |
@@ -735,6 +857,7 @@ restore_gc:
 restore_opts:
 	sbi->mount_opt = org_mount_opt;
 	sbi->active_logs = active_logs;
+	sbi->compress_algorithm = compress_algorithm;
 	return err;
 }
 
@@ -996,6 +1119,7 @@ try_onemore:
 	sb->s_fs_info = sbi;
 	/* init some FS parameters */
 	sbi->active_logs = NR_CURSEG_TYPE;
+	sbi->compress_algorithm = F2FS_COMPRESS_LZ4;
 
 	set_opt(sbi, BG_GC);
 	set_opt(sbi, INLINE_DATA);
@@ -1036,6 +1160,7 @@ try_onemore:
 	sbi->raw_super_buf = raw_super_buf;
 	mutex_init(&sbi->gc_mutex);
 	mutex_init(&sbi->cp_mutex);
+	mutex_init(&sbi->compress_mutex);
 	init_rwsem(&sbi->node_write);
 	clear_sbi_flag(sbi, SBI_POR_DOING);
 	spin_lock_init(&sbi->stat_lock);
@@ -1196,6 +1321,14 @@ try_onemore:
 		if (err)
 			goto free_kobj;
 	}
+
+	if (test_opt(sbi, CHECKPOINT_MERGE) && !f2fs_readonly(sb)) {
+		err = create_ckpt_req_control(sbi);
+		if (err) {
+			stop_gc_thread(sbi);
+			goto free_kobj;
+		}
+	}
 	kfree(options);
 	return 0;
 
@@ -857,7 +857,7 @@ static long wb_writeback(struct bdi_writeback *wb,
 		 */
 		if (work->for_kupdate) {
 			oldest_jif = jiffies -
-				msecs_to_jiffies(dirty_expire_interval * 10);
+				msecs_to_jiffies(dirty_expire_centisecs() * 10);
 		} else if (work->for_background)
 			oldest_jif = jiffies;
 
@@ -966,7 +966,7 @@ static long wb_check_old_data_flush(struct bdi_writeback *wb)
 		return 0;
 
 	expired = wb->last_old_flush +
-			msecs_to_jiffies(dirty_writeback_interval * 10);
+			msecs_to_jiffies(dirty_writeback_centisecs() * 10);
 	if (time_before(jiffies, expired))
 		return 0;
 
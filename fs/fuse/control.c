@@ -61,6 +61,23 @@ static ssize_t fuse_conn_waiting_read(struct file *file, char __user *buf,
 	return simple_read_from_buffer(buf, len, ppos, tmp, size);
 }
 
+static ssize_t fuse_conn_splice_read(struct file *file, char __user *buf,
+				     size_t len, loff_t *ppos)
+{
+	char tmp[64];
+	size_t size;
+	struct fuse_conn *fc = fuse_ctl_file_conn_get(file);
+
+	if (!fc)
+		return 0;
+
+	size = sprintf(tmp, "moved %llu\ncopied %llu\n",
+		       (unsigned long long)atomic64_read(&fc->splice_moved),
+		       (unsigned long long)atomic64_read(&fc->splice_copied));
+	fuse_conn_put(fc);
+	return simple_read_from_buffer(buf, len, ppos, tmp, size);
+}
+
 static ssize_t fuse_conn_limit_read(struct file *file, char __user *buf,
 				    size_t len, loff_t *ppos, unsigned val)
 {
@@ -182,6 +199,12 @@ static const struct file_operations fuse_ctl_waiting_ops = {
 	.llseek = no_llseek,
 };
 
+static const struct file_operations fuse_ctl_splice_ops = {
+	.open = nonseekable_open,
+	.read = fuse_conn_splice_read,
+	.llseek = no_llseek,
+};
+
 static const struct file_operations fuse_conn_max_background_ops = {
 	.open = nonseekable_open,
 	.read = fuse_conn_max_background_read,
@@ -256,6 +279,8 @@ int fuse_ctl_add_conn(struct fuse_conn *fc)
 				 NULL, &fuse_ctl_waiting_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "abort", S_IFREG | 0200, 1,
 				 NULL, &fuse_ctl_abort_ops) ||
+	    !fuse_ctl_add_dentry(parent, fc, "splice", S_IFREG | 0400, 1,
+				 NULL, &fuse_ctl_splice_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "max_background", S_IFREG | 0600,
 				 1, NULL, &fuse_conn_max_background_ops) ||
 	    !fuse_ctl_add_dentry(parent, fc, "congestion_threshold",
@@ -921,36 +921,49 @@ static int fuse_copy_page(struct fuse_copy_state *cs, struct page **pagep,
 {
 	int err;
 	struct page *page = *pagep;
+	unsigned copied = 0;
 
 	if (page && zeroing && count < PAGE_SIZE)
 		clear_highpage(page);
 
 	while (count) {
 		if (cs->write && cs->pipebufs && page) {
-			return fuse_ref_page(cs, page, offset, count);
+			err = fuse_ref_page(cs, page, offset, count);
+			if (!err)
+				atomic64_add(count, &cs->fc->splice_moved);
+			goto out;
 		} else if (!cs->len) {
 			if (cs->move_pages && page &&
 			    offset == 0 && count == PAGE_SIZE) {
 				err = fuse_try_move_page(cs, pagep);
+				if (!err)
+					atomic64_add(count, &cs->fc->splice_moved);
 				if (err <= 0)
-					return err;
+					goto out;
 			} else {
 				err = fuse_copy_fill(cs);
 				if (err)
-					return err;
+					goto out;
 			}
 		}
 		if (page) {
 			void *mapaddr = kmap_atomic(page);
 			void *buf = mapaddr + offset;
-			offset += fuse_copy_do(cs, &buf, &count);
+			unsigned ncpy = fuse_copy_do(cs, &buf, &count);
+
+			offset += ncpy;
+			copied += ncpy;
 			kunmap_atomic(mapaddr);
 		} else
 			offset += fuse_copy_do(cs, NULL, &count);
 	}
 	if (page && !cs->write)
 		flush_dcache_page(page);
-	return 0;
+	err = 0;
+out:
+	if (copied)
+		atomic64_add(copied, &cs->fc->splice_copied);
+	return err;
 }
 
 /* Copy pages in the request to/from userspace buffer */
@@ -1876,6 +1889,9 @@ static ssize_t fuse_dev_do_write(struct fuse_conn *fc,
 	err = copy_out_args(cs, &req->out, nbytes);
 	fuse_copy_finish(cs);
 
+	if (!err && fc->passthrough)
+		fuse_passthrough_get(req);
+
 	spin_lock(&fc->lock);
 	req->locked = 0;
 	if (!err) {
@@ -459,6 +459,8 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 	req->out.args[1].value = &outopen;
 	fuse_request_send(fc, req);
 	err = req->out.h.error;
+	ff->passthrough_filp = req->passthrough_filp;
+	req->passthrough_filp = NULL;
 	if (err)
 		goto out_free_ff;
 
@@ -487,6 +489,7 @@ static int fuse_create_open(struct inode *dir, struct dentry *entry,
 	if (err) {
 		fuse_sync_release(ff, flags);
 	} else {
+		fuse_passthrough_setup(ff, file);
 		file->private_data = fuse_file_get(ff);
 		fuse_finish_open(inode, file);
 	}
@@ -33,7 +33,9 @@
 #define FUSE_NAME_MAX 1024
 
 /** Number of dentries for each connection in the control filesystem */
-#define FUSE_CTL_NUM_DENTRIES 5
+#define FUSE_CTL_NUM_DENTRIES 6
+
+#define FUSE_SUPER_MAGIC 0x65735546
 
 /** If the FUSE_DEFAULT_PERMISSIONS flag is given, the filesystem
     module will check permissions based on the file mode.  Otherwise no
@@ -155,6 +157,9 @@ struct fuse_file {
 
 	/** Has flock been performed on this file? */
 	bool flock:1;
+
+	/** Lower file serving read, write and mmap, or NULL */
+	struct file *passthrough_filp;
 };
 
 /** One input argument of a request */
@@ -345,6 +350,9 @@ struct fuse_req {
 	/** File used in the request (or NULL) */
 	struct fuse_file *ff;
 
+	/** Lower file handed over in an open reply (or NULL) */
+	struct file *passthrough_filp;
+
 	/** Inode used in the request or NULL */
 	struct inode *inode;
 
@@ -546,9 +554,18 @@ struct fuse_conn {
 	/** Does the filesystem support asynchronous direct-IO submission? */
 	unsigned async_dio:1;
 
+	/** May open replies hand over a lower file for passthrough? */
+	unsigned passthrough:1;
+
 	/** The number of requests waiting for completion */
 	atomic_t num_waiting;
 
+	/** Bytes of page data spliced without a copy, by reference or move */
+	atomic64_t splice_moved;
+
+	/** Bytes of page data copied to or from the daemon */
+	atomic64_t splice_copied;
+
 	/** Negotiated minor version */
 	unsigned minor;
 
@@ -871,4 +888,14 @@ void fuse_write_update_size(struct inode *inode, loff_t pos);
 int fuse_do_setattr(struct inode *inode, struct iattr *attr,
 		    struct file *file);
 
+/* passthrough.c */
+void fuse_passthrough_get(struct fuse_req *req);
+void fuse_passthrough_setup(struct fuse_file *ff, struct file *file);
+void fuse_passthrough_release(struct fuse_file *ff);
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos);
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos);
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma);
+
 #endif /* _FS_FUSE_I_H */
@@ -0,0 +1,158 @@
+/*
+  FUSE: Filesystem in Userspace
+
+  Passthrough of read, write and mmap to a file of the lower filesystem
+  handed over by the daemon in its OPEN or CREATE reply.
+
+  This program can be distributed under the terms of the GNU GPL.
+  See the file COPYING.
+*/
+
+#include "fuse_i.h"
+
+#include <linux/file.h>
+#include <linux/aio.h>
+#include <linux/fsnotify.h>
+#include <linux/cred.h>
+
+/*
+ * Called from the daemon's write to the device, so that the descriptor
+ * is looked up in the daemon's file table.  The file is taken over by
+ * whoever sent the request; see fuse_passthrough_setup().
+ */
+void fuse_passthrough_get(struct fuse_req *req)
+{
+	struct fuse_open_out *outarg;
+	int opcode = req->in.h.opcode;
+
+	if (req->out.h.error || (opcode != FUSE_OPEN && opcode != FUSE_CREATE))
+		return;
+
+	outarg = req->out.args[req->out.numargs - 1].value;
+	if (outarg->open_flags & FOPEN_PASSTHROUGH)
+		req->passthrough_filp = fget(outarg->passthrough_fd);
+}
+
+/*
+ * Keep the lower file only if it can serve every access @file was opened
+ * for.  Otherwise the file silently falls back to regular FUSE I/O.
+ */
+void fuse_passthrough_setup(struct fuse_file *ff, struct file *file)
+{
+	struct file *lower = ff->passthrough_filp;
+	struct inode *inode;
+
+	if (!lower)
+		return;
+
+	inode = file_inode(lower);
+	if ((ff->open_flags & FOPEN_DIRECT_IO) || !S_ISREG(inode->i_mode) ||
+	    inode->i_sb->s_magic == FUSE_SUPER_MAGIC ||
+	    !lower->f_op || !lower->f_op->aio_read || !lower->f_op->aio_write ||
+	    (file->f_mode & (FMODE_READ | FMODE_WRITE) & ~lower->f_mode))
+		fuse_passthrough_release(ff);
+}
+
+void fuse_passthrough_release(struct fuse_file *ff)
+{
+	if (ff->passthrough_filp) {
+		fput(ff->passthrough_filp);
+		ff->passthrough_filp = NULL;
+	}
+}
+
+static ssize_t fuse_passthrough_rw(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos, int rw)
+{
+	struct file *file = iocb->ki_filp;
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	struct inode *inode = file_inode(file);
+	size_t count = iov_length(iov, nr_segs);
+	const struct cred *old_cred;
+	struct kiocb kiocb;
+	ssize_t ret;
+
+	if (rw == WRITE) {
+		/* appends are serialized on the FUSE inode */
+		mutex_lock(&inode->i_mutex);
+		if (file->f_flags & O_APPEND)
+			pos = i_size_read(file_inode(lower));
+	}
+
+	ret = rw_verify_area(rw, lower, &pos, count);
+	if (ret < 0)
+		goto out;
+
+	/* the lower file is accessed on behalf of the daemon that opened it */
+	old_cred = override_creds(lower->f_cred);
+
+	init_sync_kiocb(&kiocb, lower);
+	kiocb.ki_pos = pos;
+	kiocb.ki_left = count;
+	kiocb.ki_nbytes = count;
+
+	if (rw == WRITE) {
+		file_start_write(lower);
+		ret = lower->f_op->aio_write(&kiocb, iov, nr_segs, pos);
+	} else {
+		ret = lower->f_op->aio_read(&kiocb, iov, nr_segs, pos);
+	}
+	if (ret == -EIOCBQUEUED)
+		ret = wait_on_sync_kiocb(&kiocb);
+	if (rw == WRITE)
+		file_end_write(lower);
+
+	revert_creds(old_cred);
+
+	if (ret > 0) {
+		iocb->ki_pos = pos + ret;
+		if (rw == WRITE) {
+			fsnotify_modify(lower);
+			fuse_write_update_size(inode, pos + ret);
+			fuse_invalidate_attr(inode);
+		} else {
+			fsnotify_access(lower);
+		}
+	}
+out:
+	if (rw == WRITE)
+		mutex_unlock(&inode->i_mutex);
+	return ret;
+}
+
+ssize_t fuse_passthrough_aio_read(struct kiocb *iocb, const struct iovec *iov,
+				  unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, READ);
+}
+
+ssize_t fuse_passthrough_aio_write(struct kiocb *iocb, const struct iovec *iov,
+				   unsigned long nr_segs, loff_t pos)
+{
+	return fuse_passthrough_rw(iocb, iov, nr_segs, pos, WRITE);
+}
+
+/*
+ * The mapping is set up on the lower file, so that page faults are served
+ * from its page cache and never reach the FUSE inode.
+ */
+int fuse_passthrough_mmap(struct file *file, struct vm_area_struct *vma)
+{
+	struct fuse_file *ff = file->private_data;
+	struct file *lower = ff->passthrough_filp;
+	int ret;
+
+	if (!lower->f_op->mmap)
+		return -ENODEV;
+
+	vma->vm_file = get_file(lower);
+	ret = lower->f_op->mmap(lower, vma);
+	if (ret) {
+		vma->vm_file = file;
+		fput(lower);
+	} else {
+		fput(file);
+	}
+	return ret;
+}
@@ -146,7 +146,7 @@ static const char * const task_state_array[] = {
 	"P (parked)",		/* 512 */
 };
 
-static inline const char *get_task_state(struct task_struct *tsk)
+const char *get_task_state(struct task_struct *tsk)
 {
 	unsigned int state = (tsk->state & TASK_REPORT) | tsk->exit_state;
 	const char * const *p = &task_state_array[0];
@@ -590,9 +590,9 @@ int proc_setattr(struct dentry *dentry, struct iattr *attr)
  * May current process learn task's sched/cmdline info (for hide_pid_min=1)
  * or euid/egid (for hide_pid_min=2)?
  */
-static bool has_pid_permissions(struct pid_namespace *pid,
-				 struct task_struct *task,
-				 int hide_pid_min)
+bool has_pid_permissions(struct pid_namespace *pid,
+			 struct task_struct *task,
+			 int hide_pid_min)
 {
 	if (pid->hide_pid < hide_pid_min)
 		return true;
@@ -1001,6 +1001,8 @@ err_sighand:
 	unlock_task_sighand(task, &flags);
 err_task_lock:
 	task_unlock(task);
+	if (!err)
+		lowmem_adj_tree_update(task);
 	put_task_struct(task);
 out:
 	return err < 0 ? err : count;
@@ -1119,6 +1121,8 @@ err_sighand:
 	unlock_task_sighand(task, &flags);
 err_task_lock:
 	task_unlock(task);
+	if (!err)
+		lowmem_adj_tree_update(task);
 	put_task_struct(task);
 out:
 	return err < 0 ? err : count;
@@ -1333,6 +1337,57 @@ static const struct file_operations proc_pid_sched_operations = {
 
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * Print the wakeup latency histogram; any write clears it.
+ */
+static int schedlat_show(struct seq_file *m, void *v)
+{
+	struct inode *inode = m->private;
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+	proc_sched_lat_show_task(p, m);
+
+	put_task_struct(p);
+
+	return 0;
+}
+
+static ssize_t
+schedlat_write(struct file *file, const char __user *buf,
+	       size_t count, loff_t *offset)
+{
+	struct inode *inode = file_inode(file);
+	struct task_struct *p;
+
+	p = get_proc_task(inode);
+	if (!p)
+		return -ESRCH;
+	proc_sched_lat_set_task(p);
+
+	put_task_struct(p);
+
+	return count;
+}
+
+static int schedlat_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, schedlat_show, inode);
+}
+
+static const struct file_operations proc_pid_schedlat_operations = {
+	.open		= schedlat_open,
+	.read		= seq_read,
+	.write		= schedlat_write,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+#endif
+
 #ifdef CONFIG_SCHED_AUTOGROUP
 /*
  * Print out autogroup related information:
@@ -2736,6 +2791,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 #ifdef CONFIG_SCHED_DEBUG
 	REG("sched",      S_IRUGO|S_IWUSR, proc_pid_sched_operations),
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	REG("schedlat",   S_IRUGO|S_IWUSR, proc_pid_schedlat_operations),
+#endif
 #ifdef CONFIG_SCHED_AUTOGROUP
 	REG("autogroup",  S_IRUGO|S_IWUSR, proc_pid_sched_autogroup_operations),
 #endif
@@ -2762,6 +2820,9 @@ static const struct pid_entry tgid_base_stuff[] = {
 	REG("smaps",      S_IRUGO, proc_pid_smaps_operations),
 	REG("pagemap",    S_IRUGO, proc_pagemap_operations),
 #endif
+#ifdef CONFIG_PROCESS_RECLAIM
+	REG("reclaim",    S_IWUSR, proc_reclaim_operations),
+#endif
 #ifdef CONFIG_SECURITY
 	DIR("attr",       S_IRUGO|S_IXUGO, proc_attr_dir_inode_operations, proc_attr_dir_operations),
 #endif
@@ -3093,6 +3154,9 @@ static const struct pid_entry tid_base_stuff[] = {
 	INF("limits",	 S_IRUGO, proc_pid_limits),
 #ifdef CONFIG_SCHED_DEBUG
 	REG("sched",     S_IRUGO|S_IWUSR, proc_pid_sched_operations),
+#endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	REG("schedlat",  S_IRUGO|S_IWUSR, proc_pid_schedlat_operations),
 #endif
 	REG("comm",      S_IRUGO|S_IWUSR, proc_pid_set_comm_operations),
 #ifdef CONFIG_HAVE_ARCH_TRACEHOOK
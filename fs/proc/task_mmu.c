@@ -11,6 +11,7 @@
 #include <linux/rmap.h>
 #include <linux/swap.h>
 #include <linux/swapops.h>
+#include <linux/mm_inline.h>
 
 #include <asm/elf.h>
 #include <asm/uaccess.h>
@@ -1203,6 +1204,135 @@ const struct file_operations proc_pagemap_operations = {
 };
 #endif /* CONFIG_PROC_PAGE_MONITOR */
 
+#ifdef CONFIG_PROCESS_RECLAIM
+static int reclaim_pte_range(pmd_t *pmd, unsigned long addr,
+				unsigned long end, struct mm_walk *walk)
+{
+	struct vm_area_struct *vma = walk->private;
+	pte_t *pte, ptent;
+	spinlock_t *ptl;
+	struct page *page;
+	LIST_HEAD(page_list);
+	int isolated = 0;
+
+	split_huge_page_pmd(vma, addr, pmd);
+	if (pmd_trans_unstable(pmd))
+		return 0;
+
+	pte = pte_offset_map_lock(vma->vm_mm, pmd, addr, &ptl);
+	for (; addr != end; pte++, addr += PAGE_SIZE) {
+		ptent = *pte;
+		if (!pte_present(ptent))
+			continue;
+
+		page = vm_normal_page(vma, addr, ptent);
+		if (!page)
+			continue;
+
+		/* Leave pages other processes are using alone */
+		if (page_mapcount(page) != 1)
+			continue;
+
+		if (isolate_lru_page(page))
+			continue;
+
+		list_add(&page->lru, &page_list);
+		inc_zone_page_state(page, NR_ISOLATED_ANON +
+				    page_is_file_cache(page));
+		isolated++;
+	}
+	pte_unmap_unlock(pte - 1, ptl);
+
+	if (isolated)
+		reclaim_pages_from_list(&page_list);
+	cond_resched();
+	return 0;
+}
+
+enum reclaim_type {
+	RECLAIM_FILE,
+	RECLAIM_ANON,
+	RECLAIM_ALL,
+};
+
+static void reclaim_mm(struct mm_struct *mm, enum reclaim_type type)
+{
+	struct vm_area_struct *vma;
+	struct mm_walk reclaim_walk = {
+		.pmd_entry = reclaim_pte_range,
+		.mm = mm,
+	};
+
+	down_read(&mm->mmap_sem);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		reclaim_walk.private = vma;
+		if (is_vm_hugetlb_page(vma))
+			continue;
+		if (vma->vm_flags & VM_LOCKED)
+			continue;
+		if (type == RECLAIM_ANON && vma->vm_file)
+			continue;
+		if (type == RECLAIM_FILE && !vma->vm_file)
+			continue;
+		walk_page_range(vma->vm_start, vma->vm_end, &reclaim_walk);
+	}
+	flush_tlb_mm(mm);
+	up_read(&mm->mmap_sem);
+}
+
+/**
+ * reclaim_mm_anon - push the private anonymous pages of @mm out to swap
+ * @mm: address space to reclaim, the caller holds a reference
+ */
+void reclaim_mm_anon(struct mm_struct *mm)
+{
+	reclaim_mm(mm, RECLAIM_ANON);
+}
+
+static ssize_t reclaim_write(struct file *file, const char __user *buf,
+				size_t count, loff_t *ppos)
+{
+	struct task_struct *task;
+	char buffer[PROC_NUMBUF];
+	struct mm_struct *mm;
+	enum reclaim_type type;
+	char *type_buf;
+
+	memset(buffer, 0, sizeof(buffer));
+	if (count > sizeof(buffer) - 1)
+		count = sizeof(buffer) - 1;
+	if (copy_from_user(buffer, buf, count))
+		return -EFAULT;
+
+	type_buf = strstrip(buffer);
+	if (!strcmp(type_buf, "file"))
+		type = RECLAIM_FILE;
+	else if (!strcmp(type_buf, "anon"))
+		type = RECLAIM_ANON;
+	else if (!strcmp(type_buf, "all"))
+		type = RECLAIM_ALL;
+	else
+		return -EINVAL;
+
+	task = get_proc_task(file_inode(file));
+	if (!task)
+		return -ESRCH;
+	mm = get_task_mm(task);
+	if (mm) {
+		reclaim_mm(mm, type);
+		mmput(mm);
+	}
+	put_task_struct(task);
+
+	return count;
+}
+
+const struct file_operations proc_reclaim_operations = {
+	.write		= reclaim_write,
+	.llseek		= noop_llseek,
+};
+#endif /* CONFIG_PROCESS_RECLAIM */
+
 #ifdef CONFIG_NUMA
 
 struct numa_maps {
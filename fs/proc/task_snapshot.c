@@ -0,0 +1,237 @@
+/*
+ * /proc/task_snapshot: the fields monitoring daemons poll from the stat,
+ * statm and oom_score_adj files of every process, for all processes or
+ * a selected set of them in a single read, see <linux/task_snapshot.h>.
+ */
+#include <linux/cgroup.h>
+#include <linux/fs.h>
+#include <linux/init.h>
+#include <linux/ktime.h>
+#include <linux/mm.h>
+#include <linux/mutex.h>
+#include <linux/oom.h>
+#include <linux/pid_namespace.h>
+#include <linux/proc_fs.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+#include <linux/task_snapshot.h>
+
+#include "internal.h"
+
+/* Room for processes forked between sizing the buffer and filling it */
+#define TASK_SNAPSHOT_SLACK	32
+#define TASK_SNAPSHOT_MAX_PIDS	4096
+
+struct task_snapshot {
+	struct mutex lock;
+	pid_t *pids;			/* selected processes, NULL for all */
+	unsigned int nr_pids;
+	struct task_snapshot_hdr *buf;
+	size_t size;			/* bytes allocated at @buf */
+	size_t len;			/* bytes of the last snapshot */
+};
+
+static void task_snapshot_cgroup(struct task_snapshot_record *rec,
+				 struct task_struct *p)
+{
+#ifdef CONFIG_CGROUP_SCHED
+	struct cgroup *cgrp;
+
+	cgrp = task_subsys_state(p, cpu_cgroup_subsys_id)->cgroup;
+	if (cgroup_path(cgrp, rec->cgroup, sizeof(rec->cgroup)))
+		rec->cgroup[0] = '\0';
+#endif
+}
+
+/* Called under rcu_read_lock() for a thread group leader */
+static void task_snapshot_fill(struct task_snapshot_record *rec,
+			       struct task_struct *p, struct pid_namespace *ns)
+{
+	struct task_struct *t;
+	cputime_t utime, stime;
+
+	memset(rec, 0, sizeof(*rec));
+	rec->pid = task_tgid_nr_ns(p, ns);
+	if (pid_alive(p))
+		rec->ppid = task_tgid_nr_ns(rcu_dereference(p->real_parent),
+					    ns);
+	rec->uid = from_kuid_munged(current_user_ns(), task_uid(p));
+	rec->oom_score_adj = p->signal->oom_score_adj;
+	rec->state = get_task_state(p)[0];
+	rec->nr_threads = get_nr_threads(p);
+	rec->start_time = timespec_to_ns(&p->real_start_time);
+
+	thread_group_cputime_adjusted(p, &utime, &stime);
+	rec->utime = cputime_to_usecs(utime);
+	rec->stime = cputime_to_usecs(stime);
+
+	/* the leader may have exited with other threads still running */
+	t = find_lock_task_mm(p);
+	if (t) {
+		rec->vsize = (u64)t->mm->total_vm << PAGE_SHIFT;
+		rec->rss = get_mm_rss(t->mm);
+		rec->swap = get_mm_counter(t->mm, MM_SWAPENTS);
+		task_unlock(t);
+	}
+
+	task_snapshot_cgroup(rec, p);
+}
+
+static bool task_snapshot_visible(struct task_struct *p,
+				  struct pid_namespace *ns)
+{
+	return task_tgid_nr_ns(p, ns) && has_pid_permissions(ns, p, 1);
+}
+
+static unsigned int task_snapshot_collect(struct task_snapshot *ts,
+					  struct pid_namespace *ns,
+					  unsigned int max)
+{
+	struct task_snapshot_record *rec = (void *)(ts->buf + 1);
+	struct task_struct *p;
+	unsigned int i, n = 0;
+
+	rcu_read_lock();
+	if (ts->pids) {
+		for (i = 0; i < ts->nr_pids && n < max; i++) {
+			p = find_task_by_pid_ns(ts->pids[i], ns);
+			if (!p)
+				continue;
+			p = p->group_leader;
+			if (task_snapshot_visible(p, ns))
+				task_snapshot_fill(&rec[n++], p, ns);
+		}
+	} else {
+		for_each_process(p) {
+			if (n == max)
+				break;
+			if (task_snapshot_visible(p, ns))
+				task_snapshot_fill(&rec[n++], p, ns);
+		}
+	}
+	rcu_read_unlock();
+
+	return n;
+}
+
+static int task_snapshot_take(struct task_snapshot *ts,
+			      struct pid_namespace *ns)
+{
+	unsigned int max;
+	size_t size;
+
+	max = ts->pids ? ts->nr_pids : nr_processes() + TASK_SNAPSHOT_SLACK;
+	size = sizeof(*ts->buf) + max * sizeof(struct task_snapshot_record);
+	if (size > ts->size) {
+		vfree(ts->buf);
+		ts->size = 0;
+		ts->buf = vmalloc(size);
+		if (!ts->buf)
+			return -ENOMEM;
+		ts->size = size;
+	}
+
+	/* a buffer kept from an earlier, larger snapshot may hold more */
+	max = (ts->size - sizeof(*ts->buf)) /
+		sizeof(struct task_snapshot_record);
+
+	memset(ts->buf, 0, sizeof(*ts->buf));
+	ts->buf->version = TASK_SNAPSHOT_VERSION;
+	ts->buf->record_size = sizeof(struct task_snapshot_record);
+	ts->buf->timestamp = ktime_to_ns(ktime_get());
+	ts->buf->count = task_snapshot_collect(ts, ns, max);
+	ts->len = sizeof(*ts->buf) +
+		ts->buf->count * sizeof(struct task_snapshot_record);
+
+	return 0;
+}
+
+static ssize_t task_snapshot_read(struct file *file, char __user *buf,
+				  size_t count, loff_t *ppos)
+{
+	struct task_snapshot *ts = file->private_data;
+	struct pid_namespace *ns = file->f_path.dentry->d_sb->s_fs_info;
+	ssize_t ret = 0;
+
+	mutex_lock(&ts->lock);
+	if (*ppos == 0)
+		ret = task_snapshot_take(ts, ns);
+	if (!ret && ts->buf)
+		ret = simple_read_from_buffer(buf, count, ppos, ts->buf,
+					      ts->len);
+	mutex_unlock(&ts->lock);
+
+	return ret;
+}
+
+static ssize_t task_snapshot_write(struct file *file, const char __user *buf,
+				   size_t count, loff_t *ppos)
+{
+	struct task_snapshot *ts = file->private_data;
+	pid_t *pids = NULL;
+	unsigned int nr;
+
+	if (!count || count % sizeof(pid_t) ||
+	    count > TASK_SNAPSHOT_MAX_PIDS * sizeof(pid_t))
+		return -EINVAL;
+
+	nr = count / sizeof(pid_t);
+	pids = memdup_user(buf, count);
+	if (IS_ERR(pids))
+		return PTR_ERR(pids);
+
+	if (nr == 1 && pids[0] == 0) {
+		kfree(pids);
+		pids = NULL;
+		nr = 0;
+	}
+
+	mutex_lock(&ts->lock);
+	kfree(ts->pids);
+	ts->pids = pids;
+	ts->nr_pids = nr;
+	mutex_unlock(&ts->lock);
+
+	return count;
+}
+
+static int task_snapshot_open(struct inode *inode, struct file *file)
+{
+	struct task_snapshot *ts;
+
+	ts = kzalloc(sizeof(*ts), GFP_KERNEL);
+	if (!ts)
+		return -ENOMEM;
+
+	mutex_init(&ts->lock);
+	file->private_data = ts;
+	return 0;
+}
+
+static int task_snapshot_release(struct inode *inode, struct file *file)
+{
+	struct task_snapshot *ts = file->private_data;
+
+	vfree(ts->buf);
+	kfree(ts->pids);
+	kfree(ts);
+	return 0;
+}
+
+static const struct file_operations task_snapshot_fops = {
+	.open		= task_snapshot_open,
+	.read		= task_snapshot_read,
+	.write		= task_snapshot_write,
+	.llseek		= default_llseek,
+	.release	= task_snapshot_release,
+};
+
+static int __init proc_task_snapshot_init(void)
+{
+	proc_create("task_snapshot", S_IRUGO | S_IWUGO, NULL,
+		    &task_snapshot_fops);
+	return 0;
+}
+module_init(proc_task_snapshot_init);
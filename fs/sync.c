@@ -109,7 +109,7 @@ static void do_sync(void)
 	iterate_supers(sync_fs_one_sb, &wait);
 	iterate_bdevs(fdatawrite_one_bdev, NULL);
 	iterate_bdevs(fdatawait_one_bdev, NULL);
-	if (unlikely(laptop_mode))
+	if (unlikely(writeback_batching()))
 		laptop_sync_completion();
 	return;
 }
@@ -259,6 +259,7 @@ static int do_fsync(unsigned int fd, int datasync)
 	if (f.file) {
 		ret = vfs_fsync(f.file, datasync);
 		fdput(f);
+		inc_syscfs(current);
 	}
 	return ret;
 }
@@ -34,11 +34,11 @@ typedef u64 __nocast cputime64_t;
 	cputime_div(__ct, NSEC_PER_SEC / HZ)
 #define cputime_to_scaled(__ct)		(__ct)
 #define jiffies_to_cputime(__jif)	\
-	(__force cputime_t)((__jif) * (NSEC_PER_SEC / HZ))
+	(__force cputime_t)((u64)(__jif) * (NSEC_PER_SEC / HZ))
 #define cputime64_to_jiffies64(__ct)	\
 	cputime_div(__ct, NSEC_PER_SEC / HZ)
 #define jiffies64_to_cputime64(__jif)	\
-	(__force cputime64_t)((__jif) * (NSEC_PER_SEC / HZ))
+	(__force cputime64_t)((u64)(__jif) * (NSEC_PER_SEC / HZ))
 
 
 /*
@@ -53,9 +53,9 @@ typedef u64 __nocast cputime64_t;
 #define cputime_to_usecs(__ct)		\
 	cputime_div(__ct, NSEC_PER_USEC)
 #define usecs_to_cputime(__usecs)	\
-	(__force cputime_t)((__usecs) * NSEC_PER_USEC)
+	(__force cputime_t)((u64)(__usecs) * NSEC_PER_USEC)
 #define usecs_to_cputime64(__usecs)	\
-	(__force cputime64_t)((__usecs) * NSEC_PER_USEC)
+	(__force cputime64_t)((u64)(__usecs) * NSEC_PER_USEC)
 
 /*
  * Convert cputime <-> seconds
@@ -63,14 +63,14 @@ typedef u64 __nocast cputime64_t;
 #define cputime_to_secs(__ct)		\
 	cputime_div(__ct, NSEC_PER_SEC)
 #define secs_to_cputime(__secs)		\
-	(__force cputime_t)((__secs) * NSEC_PER_SEC)
+	(__force cputime_t)((u64)(__secs) * NSEC_PER_SEC)
 
 /*
  * Convert cputime <-> timespec (nsec)
  */
 static inline cputime_t timespec_to_cputime(const struct timespec *val)
 {
-	u64 ret = val->tv_sec * NSEC_PER_SEC + val->tv_nsec;
+	u64 ret = (u64)val->tv_sec * NSEC_PER_SEC + val->tv_nsec;
 	return (__force cputime_t) ret;
 }
 static inline void cputime_to_timespec(const cputime_t ct, struct timespec *val)
@@ -86,7 +86,8 @@ static inline void cputime_to_timespec(const cputime_t ct, struct timespec *val)
  */
 static inline cputime_t timeval_to_cputime(const struct timeval *val)
 {
-	u64 ret = val->tv_sec * NSEC_PER_SEC + val->tv_usec * NSEC_PER_USEC;
+	u64 ret = (u64)val->tv_sec * NSEC_PER_SEC +
+		  val->tv_usec * NSEC_PER_USEC;
 	return (__force cputime_t) ret;
 }
 static inline void cputime_to_timeval(const cputime_t ct, struct timeval *val)
@@ -103,7 +104,7 @@ static inline void cputime_to_timeval(const cputime_t ct, struct timeval *val)
 #define cputime_to_clock_t(__ct)	\
 	cputime_div(__ct, (NSEC_PER_SEC / USER_HZ))
 #define clock_t_to_cputime(__x)		\
-	(__force cputime_t)((__x) * (NSEC_PER_SEC / USER_HZ))
+	(__force cputime_t)((u64)(__x) * (NSEC_PER_SEC / USER_HZ))
 
 /*
  * Convert cputime64 to clock.
@@ -103,6 +103,13 @@ struct backing_dev_info {
 
 	struct timer_list laptop_mode_wb_timer;
 
+	/* MADV_WILLNEED_ASYNC readahead, see mm/readahead.c */
+	spinlock_t ra_async_lock;
+	struct list_head ra_async_list[2];	/* foreground, background */
+	unsigned int ra_async_nr;
+	struct ra_async_req *ra_async_active;
+	struct work_struct ra_async_work;
+
 #ifdef CONFIG_DEBUG_FS
 	struct dentry *debug_dir;
 	struct dentry *debug_stats;
@@ -111,6 +118,8 @@ struct backing_dev_info {
 
 int bdi_init(struct backing_dev_info *bdi);
 void bdi_destroy(struct backing_dev_info *bdi);
+void bdi_ra_async_init(struct backing_dev_info *bdi);
+void bdi_ra_async_destroy(struct backing_dev_info *bdi);
 
 __printf(3, 4)
 int bdi_register(struct backing_dev_info *bdi, struct device *parent,
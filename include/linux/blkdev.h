@@ -149,6 +149,14 @@ struct request {
 	struct request_list *rl;		/* rl this rq is alloced from */
 	unsigned long long start_time_ns;
 	unsigned long long io_start_time_ns;    /* when passed to hardware */
+#endif
+#ifdef CONFIG_BLK_DEV_IO_HIST
+	u64 io_hist_insert_ns;		/* when inserted into the queue */
+	u64 io_hist_dispatch_ns;	/* when handed to the driver */
+#endif
+#ifdef CONFIG_BLK_WBT
+	u64 wbt_issue_ns;		/* when a read was dispatched */
+	bool wbt_tracked;		/* counted as throttled writeback */
 #endif
 	/* Number of scatter-gather DMA addr+len pairs after
 	 * physical address coalescing is performed.
@@ -285,6 +293,30 @@ struct queue_limits {
 	unsigned char		discard_zeroes_data;
 };
 
+#ifdef CONFIG_BLK_DEV_IO_HIST
+enum {
+	BLK_IO_HIST_QUEUE,
+	BLK_IO_HIST_SERVICE,
+	BLK_IO_HIST_STAGES,
+};
+
+enum {
+	BLK_IO_HIST_READ,
+	BLK_IO_HIST_WRITE,
+	BLK_IO_HIST_DISCARD,
+	BLK_IO_HIST_FLUSH,
+	BLK_IO_HIST_OPS,
+};
+
+#define BLK_IO_HIST_BUCKETS	24
+
+struct blk_io_hist {
+	/* [stage][op][sync][log2 usec] */
+	unsigned int count[BLK_IO_HIST_STAGES][BLK_IO_HIST_OPS][2]
+			  [BLK_IO_HIST_BUCKETS];
+};
+#endif
+
 struct request_queue {
 	/*
 	 * Together with queue_head for cacheline sharing
@@ -446,6 +478,15 @@ struct request_queue {
 #ifdef CONFIG_BLK_DEV_THROTTLING
 	/* Throttle data */
 	struct throtl_data *td;
+#endif
+#ifdef CONFIG_BLK_DEV_IO_HIST
+	/* Latency histograms, see block/blk-io-hist.c */
+	struct blk_io_hist __percpu *io_hist;
+	bool			io_hist_enabled;
+#endif
+#ifdef CONFIG_BLK_WBT
+	/* Writeback throttling, see block/blk-wbt.c */
+	struct rq_wb		*rq_wb;
 #endif
 	struct rcu_head		rcu_head;
 };
@@ -181,6 +181,10 @@ struct clk {
 	unsigned prepare_count;
 	struct mutex prepare_lock;
 
+	/* hardware enables and rate changes, for debugfs */
+	unsigned long enable_cnt;
+	unsigned long rate_change_cnt;
+
 	struct dentry *clk_dir;
 };
 
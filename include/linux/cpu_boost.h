@@ -0,0 +1,53 @@
+/*
+ * Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_CPU_BOOST_H
+#define _LINUX_CPU_BOOST_H
+
+#include <linux/notifier.h>
+
+/* frame boost notifier events, for other clock domains such as the GPU */
+#define FRAME_BOOST_END		0
+#define FRAME_BOOST_START	1
+/* vsync was turned on for the primary panel, a frame is about to be drawn */
+#define FRAME_HINT_VSYNC	2
+
+#ifdef CONFIG_CPU_BOOST
+void cpu_boost_frame_commit(bool missed);
+void cpu_boost_vsync_hint(void);
+int frame_boost_register_notifier(struct notifier_block *nb);
+int frame_boost_unregister_notifier(struct notifier_block *nb);
+int input_boost_register_notifier(struct notifier_block *nb);
+int input_boost_unregister_notifier(struct notifier_block *nb);
+#else
+static inline void cpu_boost_frame_commit(bool missed) { }
+static inline void cpu_boost_vsync_hint(void) { }
+static inline int frame_boost_register_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int frame_boost_unregister_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int input_boost_register_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+static inline int input_boost_unregister_notifier(struct notifier_block *nb)
+{
+	return 0;
+}
+#endif
+
+#endif /* _LINUX_CPU_BOOST_H */
@@ -0,0 +1,36 @@
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifndef _LINUX_CPUFREQ_TIMES_H
+#define _LINUX_CPUFREQ_TIMES_H
+
+#include <linux/types.h>
+
+struct task_struct;
+
+#ifdef CONFIG_CPU_FREQ_TIMES
+void cpufreq_task_times_alloc(struct task_struct *p);
+void cpufreq_task_times_free(struct task_struct *p);
+void cpufreq_task_times_exit(struct task_struct *p);
+void cpufreq_task_times_switch(struct task_struct *prev,
+			       struct task_struct *next);
+void cpufreq_times_remove_uids(uid_t uid_start, uid_t uid_end);
+#else
+static inline void cpufreq_task_times_alloc(struct task_struct *p) { }
+static inline void cpufreq_task_times_free(struct task_struct *p) { }
+static inline void cpufreq_task_times_exit(struct task_struct *p) { }
+static inline void cpufreq_task_times_switch(struct task_struct *prev,
+					     struct task_struct *next) { }
+static inline void cpufreq_times_remove_uids(uid_t uid_start,
+					     uid_t uid_end) { }
+#endif
+
+#endif /* _LINUX_CPUFREQ_TIMES_H */
@@ -178,6 +178,22 @@ extern int bus_unregister_notifier(struct bus_type *bus,
 extern struct kset *bus_get_kset(struct bus_type *bus);
 extern struct klist *bus_get_device_klist(struct bus_type *bus);
 
+/**
+ * enum probe_type - device driver probe type to try
+ * @PROBE_DEFAULT_STRATEGY: Devices are probed synchronously from
+ *	driver_register().
+ * @PROBE_PREFER_ASYNCHRONOUS: Devices already on the bus when the driver
+ *	registers are probed from an async domain, so driver_register() does
+ *	not wait for slow probes. Devices added later are probed
+ *	synchronously as usual. All pending probes are finished before init
+ *	is started and before the driver is unregistered. Not usable with
+ *	platform_driver_probe(), which needs the binding result at once.
+ */
+enum probe_type {
+	PROBE_DEFAULT_STRATEGY,
+	PROBE_PREFER_ASYNCHRONOUS,
+};
+
 /**
  * struct device_driver - The basic device driver structure
  * @name:	Name of the device driver.
@@ -185,6 +201,7 @@ extern struct klist *bus_get_device_klist(struct bus_type *bus);
  * @owner:	The module owner.
  * @mod_name:	Used for built-in modules.
  * @suppress_bind_attrs: Disables bind/unbind via sysfs.
+ * @probe_type:	Type of the probe (synchronous or asynchronous) to use.
  * @of_match_table: The open firmware table.
  * @acpi_match_table: The ACPI match table.
  * @probe:	Called to query the existence of a specific device,
@@ -218,6 +235,7 @@ struct device_driver {
 	const char		*mod_name;	/* used for built-in modules */
 
 	bool suppress_bind_attrs;	/* disables bind/unbind via sysfs */
+	enum probe_type probe_type;
 
 	const struct of_device_id	*of_match_table;
 	const struct acpi_device_id	*acpi_match_table;
@@ -806,6 +824,15 @@ static inline bool device_async_suspend_enabled(struct device *dev)
 	return !!dev->power.async_suspend;
 }
 
+/*
+ * Resume @dev, its ancestors and its suppliers ahead of all other devices
+ * after an interactive wakeup, see wakeup_reason_set_interactive().
+ */
+static inline void device_set_resume_critical(struct device *dev, bool val)
+{
+	dev->power.resume_critical = val;
+}
+
 static inline void pm_suspend_ignore_children(struct device *dev, bool enable)
 {
 	dev->power.ignore_children = enable;
@@ -34,6 +34,7 @@
 struct device;
 struct dma_buf;
 struct dma_buf_attachment;
+struct sync_fence;
 
 /**
  * struct dma_buf_ops - operations possible on struct dma_buf
@@ -128,6 +129,10 @@ struct dma_buf {
 	const char *exp_name;
 	struct list_head list_node;
 	void *priv;
+#ifdef CONFIG_SYNC
+	/* implicit fence of the last writer, protected by lock */
+	struct sync_fence *fence;
+#endif
 };
 
 /**
@@ -196,4 +201,19 @@ void *dma_buf_vmap(struct dma_buf *);
 void dma_buf_vunmap(struct dma_buf *, void *vaddr);
 int dma_buf_debugfs_create_file(const char *name,
 				int (*write)(struct seq_file *));
+
+#ifdef CONFIG_SYNC
+void dma_buf_attach_fence(struct dma_buf *dmabuf, struct sync_fence *fence);
+struct sync_fence *dma_buf_get_fence(struct dma_buf *dmabuf);
+#else
+static inline void dma_buf_attach_fence(struct dma_buf *dmabuf,
+					struct sync_fence *fence)
+{
+}
+
+static inline struct sync_fence *dma_buf_get_fence(struct dma_buf *dmabuf)
+{
+	return NULL;
+}
+#endif
 #endif /* __DMA_BUF_H__ */
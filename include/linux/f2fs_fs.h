@@ -25,6 +25,7 @@
 
 #define NULL_ADDR		((block_t)0)	/* used as block_t addresses */
 #define NEW_ADDR		((block_t)-1)	/* used as block_t addresses */
+#define COMPRESS_ADDR		((block_t)-2)	/* used as compressed data flag */
 
 #define F2FS_BYTES_TO_BLK(bytes)	((bytes) >> F2FS_BLKSIZE_BITS)
 #define F2FS_BLK_TO_BYTES(blk)		((blk) << F2FS_BLKSIZE_BITS)
@@ -148,6 +149,29 @@ struct f2fs_orphan_block {
 	__le32 check_sum;	/* CRC32 for orphan inode block */
 } __packed;
 
+/*
+ * For compressed files
+ *
+ * A compressed cluster of F2FS_CLUSTER_SIZE pages keeps COMPRESS_ADDR in
+ * the first block address slot of the cluster, and the addresses of its
+ * compressed blocks in the slots that follow. The first compressed block
+ * starts with struct f2fs_compress_header.
+ */
+#define F2FS_CLUSTER_LOG	2
+#define F2FS_CLUSTER_SIZE	(1 << F2FS_CLUSTER_LOG)
+
+enum {
+	F2FS_COMPRESS_LZO,
+	F2FS_COMPRESS_LZ4,
+	F2FS_COMPRESS_MAX,
+};
+
+struct f2fs_compress_header {
+	__le32 clen;			/* compressed data length */
+	__u8 algorithm;			/* F2FS_COMPRESS_* */
+	__u8 reserved[3];
+} __packed;
+
 /*
  * For NODE structure
  */
@@ -22,6 +22,7 @@
 #include <linux/device.h>
 #include <linux/fs.h>
 #include <linux/timer.h>
+#include <linux/ktime.h>
 #include <linux/mod_devicetable.h>
 
 /**
@@ -36,6 +37,30 @@ struct input_value {
 	__s32 value;
 };
 
+enum input_latency_stage {
+	INPUT_LAT_IRQ_TO_DATA,
+	INPUT_LAT_DATA_TO_SYNC,
+	INPUT_LAT_SYNC_TO_READ,
+	INPUT_LAT_STAGES,
+};
+
+#define INPUT_LAT_BUCKETS	12
+
+/**
+ * struct input_latency - timing of the frame currently in flight
+ * @irq: time the device raised the interrupt for the frame
+ * @data: time the driver finished fetching the frame from the device
+ * @sync: time the frame was flushed with SYN_REPORT
+ * @hist: per stage histograms, bucket n counts latencies below 64us << n
+ *	and the last bucket holds everything slower
+ */
+struct input_latency {
+	ktime_t irq;
+	ktime_t data;
+	ktime_t sync;
+	unsigned int hist[INPUT_LAT_STAGES][INPUT_LAT_BUCKETS];
+};
+
 /**
  * struct input_dev - represents an input device
  * @name: name of the device
@@ -117,6 +142,8 @@ struct input_value {
  * @vals: array of values queued in the current frame
  * @devres_managed: indicates that devices is managed with devres framework
  *	and needs not be explicitly unregistered or freed.
+ * @latency: timestamps and histograms of the stages a frame goes through
+ *	from the device interrupt to the evdev reader
  */
 struct input_dev {
 	const char *name;
@@ -187,6 +214,8 @@ struct input_dev {
 	struct input_value *vals;
 
 	bool devres_managed;
+
+	struct input_latency latency;
 };
 #define to_input_dev(d) container_of(d, struct input_dev, dev)
 
@@ -419,6 +448,10 @@ static inline void input_mt_sync(struct input_dev *dev)
 	input_event(dev, EV_SYN, SYN_MT_REPORT, 0);
 }
 
+void input_latency_irq(struct input_dev *dev, ktime_t time);
+void input_latency_data(struct input_dev *dev);
+void input_latency_read(struct input_dev *dev);
+
 void input_set_capability(struct input_dev *dev, unsigned int type, unsigned int code);
 
 /**
@@ -1625,6 +1625,9 @@ void task_dirty_inc(struct task_struct *tsk);
 
 int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 			pgoff_t offset, unsigned long nr_to_read);
+bool readahead_async(struct file *filp, pgoff_t offset,
+			unsigned long nr_to_read);
+void readahead_async_cancel(struct vm_area_struct *vma);
 
 void page_cache_sync_readahead(struct address_space *mapping,
 			       struct file_ra_state *ra,
@@ -1689,6 +1692,58 @@ static inline struct vm_area_struct *find_exact_vma(struct mm_struct *mm,
 	return vma;
 }
 
+#ifdef CONFIG_PER_VMA_LOCK
+static inline void vma_lock_init(struct vm_area_struct *vma)
+{
+	init_rwsem(&vma->vm_lock);
+	vma->vm_lock_seq = -1;
+	vma->vm_detached = false;
+}
+
+/*
+ * Must be called with mmap_sem held for write before @vma is changed in a
+ * way a page fault could observe. Waits for the faults already running
+ * under the vma lock, and keeps new ones out until vma_end_write_all().
+ */
+static inline void vma_start_write(struct vm_area_struct *vma)
+{
+	int mm_lock_seq = vma->vm_mm->mm_lock_seq;
+
+	if (vma->vm_lock_seq == mm_lock_seq)
+		return;
+
+	down_write(&vma->vm_lock);
+	vma->vm_lock_seq = mm_lock_seq;
+	up_write(&vma->vm_lock);
+}
+
+static inline void vma_mark_detached(struct vm_area_struct *vma)
+{
+	vma_start_write(vma);
+	vma->vm_detached = true;
+}
+
+/*
+ * Releases every vma write locked under the current mmap_sem write
+ * section; called just before up_write(&mm->mmap_sem). Leaving it out
+ * only keeps faults on the mmap_sem path until the next call.
+ */
+static inline void vma_end_write_all(struct mm_struct *mm)
+{
+	smp_wmb();
+	ACCESS_ONCE(mm->mm_lock_seq) = mm->mm_lock_seq + 1;
+}
+
+extern struct vm_area_struct *lock_vma_under_rcu(struct mm_struct *mm,
+						 unsigned long address);
+extern void vma_end_read(struct vm_area_struct *vma);
+#else
+static inline void vma_lock_init(struct vm_area_struct *vma) {}
+static inline void vma_start_write(struct vm_area_struct *vma) {}
+static inline void vma_mark_detached(struct vm_area_struct *vma) {}
+static inline void vma_end_write_all(struct mm_struct *mm) {}
+#endif
+
 #ifdef CONFIG_MMU
 pgprot_t vm_get_page_prot(unsigned long vm_flags);
 #else
@@ -294,6 +294,17 @@ struct vm_area_struct {
 #ifdef CONFIG_NUMA
 	struct mempolicy *vm_policy;	/* NUMA policy for the VMA */
 #endif
+#ifdef CONFIG_PER_VMA_LOCK
+	/*
+	 * Page faults hold vm_lock for read instead of mmap_sem. The vma
+	 * is write locked for the rest of an mmap_sem write section once
+	 * vm_lock_seq matches mm->mm_lock_seq.
+	 */
+	int vm_lock_seq;
+	bool vm_detached;		/* removed from the mm, being freed */
+	struct rw_semaphore vm_lock;
+	struct rcu_head vm_rcu;		/* lockless lookups may still see it */
+#endif
 };
 
 struct core_thread {
@@ -347,6 +358,9 @@ struct mm_struct {
 
 	spinlock_t page_table_lock;		/* Protects page tables and some counters */
 	struct rw_semaphore mmap_sem;
+#ifdef CONFIG_PER_VMA_LOCK
+	int mm_lock_seq;			/* see vma_end_write_all() */
+#endif
 
 	struct list_head mmlist;		/* List of maybe swapped mm's.	These are globally strung
 						 * together off init_mm.mmlist, and are protected
@@ -87,6 +87,8 @@ struct mmc_ext_csd {
 	bool			bkops_en;	/* background enable bit */
 	unsigned int            data_sector_size;       /* 512 bytes or 4KB */
 	unsigned int            data_tag_unit_size;     /* DATA TAG UNIT size */
+	bool			cmdq_support;	/* command queuing supported */
+	unsigned int		cmdq_depth;	/* tasks the card can queue */
 	unsigned int		boot_ro_lock;		/* ro lock support */
 	bool			boot_ro_lockable;
 	u8			raw_exception_status;	/* 54 */
@@ -222,6 +224,7 @@ enum mmc_packed_stop_reasons {
 	LARGE_SEC_ALIGN,
 	RANDOM,
 	FUA,
+	READ_WAITING,
 	MAX_REASONS,
 };
 
@@ -231,6 +234,11 @@ struct mmc_wr_pack_stats {
 	spinlock_t lock;
 	bool enabled;
 	bool print_in_read;
+	/* running averages of completed writes, kept even when !enabled */
+	u32 packed_kbps;
+	u32 single_kbps;
+	u32 packed_lat_us;
+	u32 single_lat_us;
 };
 
 /* The number of MMC physical partitions.  These consist of:
@@ -337,6 +345,7 @@ struct mmc_card {
 #define MMC_STATE_HIGHSPEED_400	(1<<9)		/* card is in HS400 mode */
 #define MMC_STATE_DOING_BKOPS	(1<<10)		/* card is doing BKOPS */
 #define MMC_STATE_NEED_BKOPS	(1<<11)		/* card needs to do BKOPS */
+#define MMC_STATE_CACHE_CLEAN	(1<<12)		/* no write since last flush */
 	unsigned int		quirks; 	/* card quirks */
 #define MMC_QUIRK_LENIENT_FN0	(1<<0)		/* allow SDIO FN0 writes outside of the VS CCCR range */
 #define MMC_QUIRK_BLKSZ_FOR_BYTE_MODE (1<<1)	/* use func->cur_blksize */
@@ -394,6 +403,9 @@ struct mmc_card {
 
 	struct mmc_bkops_info	bkops_info;
 
+	u32			flush_issued;	/* cache flushes sent */
+	u32			flush_coalesced; /* flushes with nothing to do */
+
 	struct device_attribute rpm_attrib;
 	unsigned int		idle_timeout;
 	struct notifier_block        reboot_notify;
@@ -540,6 +552,7 @@ static inline void __maybe_unused remove_quirk(struct mmc_card *card, int data)
 #define mmc_card_removed(c)	((c) && ((c)->state & MMC_CARD_REMOVED))
 #define mmc_card_doing_bkops(c)	((c)->state & MMC_STATE_DOING_BKOPS)
 #define mmc_card_need_bkops(c)	((c)->state & MMC_STATE_NEED_BKOPS)
+#define mmc_card_cache_clean(c)	((c)->state & MMC_STATE_CACHE_CLEAN)
 
 #define mmc_card_set_present(c)	((c)->state |= MMC_STATE_PRESENT)
 #define mmc_card_set_readonly(c) ((c)->state |= MMC_STATE_READONLY)
@@ -560,6 +573,8 @@ static inline void __maybe_unused remove_quirk(struct mmc_card *card, int data)
 #define mmc_card_clr_doing_bkops(c)	((c)->state &= ~MMC_STATE_DOING_BKOPS)
 #define mmc_card_set_need_bkops(c)	((c)->state |= MMC_STATE_NEED_BKOPS)
 #define mmc_card_clr_need_bkops(c)	((c)->state &= ~MMC_STATE_NEED_BKOPS)
+#define mmc_card_set_cache_clean(c)	((c)->state |= MMC_STATE_CACHE_CLEAN)
+#define mmc_card_clr_cache_clean(c)	((c)->state &= ~MMC_STATE_CACHE_CLEAN)
 /*
  * Quirk add/remove for MMC products.
  */
@@ -107,6 +107,12 @@ struct mmc_request {
 	struct completion	completion;
 	void			(*done)(struct mmc_request *);/* completion function */
 	struct mmc_host		*host;
+
+	int			cmdq_tag;	/* task slot in CQ mode */
+	unsigned int		cmdq_flags;
+#define MMC_CMDQ_PRIO		(1 << 0)	/* high priority task */
+#define MMC_CMDQ_REL_WR		(1 << 1)	/* reliable write */
+#define MMC_CMDQ_QBR		(1 << 2)	/* queue barrier */
 };
 
 struct mmc_card;
@@ -170,6 +176,9 @@ extern void mmc_release_host(struct mmc_host *host);
 extern int mmc_try_claim_host(struct mmc_host *host);
 extern void mmc_set_ios(struct mmc_host *host);
 extern int mmc_flush_cache(struct mmc_card *);
+extern int mmc_cmdq_activate(struct mmc_host *);
+extern int mmc_cmdq_deactivate(struct mmc_host *);
+extern int mmc_cmdq_start_req(struct mmc_host *, struct mmc_request *);
 
 extern int mmc_detect_card_removed(struct mmc_host *host);
 
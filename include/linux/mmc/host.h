@@ -156,6 +156,22 @@ struct mmc_host_ops {
 	unsigned int	(*get_xfer_remain)(struct mmc_host *host);
 };
 
+/*
+ * Command queue engine of the host.  Tasks are identified by
+ * mrq->cmdq_tag and run in any order the card chooses; completion is
+ * reported through mmc_cmdq_request_done().
+ */
+struct mmc_cmdq_host_ops {
+	/* enter CQ mode, the card already has CMDQ_MODE_EN set */
+	int	(*enable)(struct mmc_host *host);
+	/* leave CQ mode, no task may be outstanding */
+	void	(*disable)(struct mmc_host *host);
+	/* queue mrq in task slot mrq->cmdq_tag */
+	int	(*request)(struct mmc_host *host, struct mmc_request *mrq);
+	/* halt the engine and complete every outstanding task with an error */
+	void	(*abort)(struct mmc_host *host);
+};
+
 struct mmc_card;
 struct device;
 
@@ -327,6 +343,7 @@ struct mmc_host {
 #define MMC_CAP2_HS400_1_8V	(1 << 22)        /* can support */
 #define MMC_CAP2_HS400_1_2V	(1 << 23)        /* can support */
 #define MMC_CAP2_CORE_PM       (1 << 24)       /* use PM framework */
+#define MMC_CAP2_CMD_QUEUE	(1 << 25)	/* eMMC command queuing */
 #define MMC_CAP2_HS400		(MMC_CAP2_HS400_1_8V | \
 				 MMC_CAP2_HS400_1_2V)
 	mmc_pm_flag_t		pm_caps;	/* supported pm features */
@@ -454,6 +471,12 @@ struct mmc_host {
 	 * actually disabling the clock from it's source.
 	 */
 	bool			card_clock_off;
+
+	const struct mmc_cmdq_host_ops *cmdq_ops;
+	void			*cmdq_private;
+	bool			cmdq_active;	/* card and host in CQ mode */
+	struct task_struct	*cmdq_owner;	/* issues tasks while active */
+
 	unsigned long		private[0] ____cacheline_aligned;
 };
 
@@ -503,6 +526,7 @@ int mmc_power_restore_host(struct mmc_host *host);
 
 void mmc_detect_change(struct mmc_host *, unsigned long delay);
 void mmc_request_done(struct mmc_host *, struct mmc_request *);
+void mmc_cmdq_request_done(struct mmc_host *, struct mmc_request *);
 
 int mmc_cache_ctrl(struct mmc_host *, u8);
 
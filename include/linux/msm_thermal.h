@@ -55,11 +55,24 @@ struct msm_thermal_data {
 	int32_t therm_reset_temp_degC;
 };
 
+/*
+ * Passed to GPU cap notifiers: levels is how many power levels below the
+ * top the GPU should be held, applied is filled in with what was done.
+ */
+struct msm_thermal_gpu_cap {
+	unsigned int levels;
+	unsigned int applied;
+};
+
+struct notifier_block;
+
 #ifdef CONFIG_THERMAL_MONITOR
 extern int msm_thermal_init(struct msm_thermal_data *pdata);
 extern int msm_thermal_device_init(void);
 extern int msm_thermal_set_frequency(uint32_t cpu, uint32_t freq,
 	bool is_max);
+extern int msm_thermal_gpu_cap_register_notifier(struct notifier_block *nb);
+extern int msm_thermal_gpu_cap_unregister_notifier(struct notifier_block *nb);
 #else
 static inline int msm_thermal_init(struct msm_thermal_data *pdata)
 {
@@ -74,6 +87,16 @@ static inline int msm_thermal_set_frequency(uint32_t cpu, uint32_t freq,
 {
 	return -ENOSYS;
 }
+static inline int msm_thermal_gpu_cap_register_notifier(
+	struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
+static inline int msm_thermal_gpu_cap_unregister_notifier(
+	struct notifier_block *nb)
+{
+	return -ENOSYS;
+}
 #endif
 
 #endif /*__MSM_THERMAL_H*/
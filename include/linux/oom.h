@@ -87,6 +87,28 @@ static inline void oom_killer_enable(void)
 
 extern struct task_struct *find_lock_task_mm(struct task_struct *p);
 
+#ifdef CONFIG_MMU
+extern void wake_oom_reaper(struct task_struct *tsk);
+#else
+static inline void wake_oom_reaper(struct task_struct *tsk) {}
+#endif
+
+#ifdef CONFIG_ANDROID_LOW_MEMORY_KILLER
+extern void lowmem_mm_released(struct task_struct *tsk);
+#else
+static inline void lowmem_mm_released(struct task_struct *tsk) {}
+#endif
+
+#ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
+extern void lowmem_adj_tree_insert(struct task_struct *p);
+extern void lowmem_adj_tree_remove(struct task_struct *p);
+extern void lowmem_adj_tree_update(struct task_struct *p);
+#else
+static inline void lowmem_adj_tree_insert(struct task_struct *p) {}
+static inline void lowmem_adj_tree_remove(struct task_struct *p) {}
+static inline void lowmem_adj_tree_update(struct task_struct *p) {}
+#endif
+
 extern void dump_tasks(const struct mem_cgroup *memcg,
 		const nodemask_t *nodemask);
 
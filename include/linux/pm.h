@@ -523,10 +523,13 @@ struct dev_pm_info {
 	bool			is_suspended:1;	/* Ditto */
 	bool			ignore_children:1;
 	bool			early_init:1;	/* Owned by the PM core */
+	bool			resume_critical:1;
 	spinlock_t		lock;
 #ifdef CONFIG_PM_SLEEP
 	struct list_head	entry;
 	struct completion	completion;
+	struct list_head	suppliers;	/* Owned by the PM core */
+	struct list_head	consumers;	/* Ditto */
 	struct wakeup_source	*wakeup;
 	bool			wakeup_path:1;
 	bool			syscore:1;
@@ -652,6 +655,8 @@ extern void __suspend_report_result(const char *function, void *fn, int ret);
 	} while (0)
 
 extern int device_pm_wait_for_dev(struct device *sub, struct device *dev);
+extern int device_pm_add_dependency(struct device *consumer,
+				    struct device *supplier);
 extern void dpm_for_each_dev(void *data, void (*fn)(struct device *, void *));
 
 extern int pm_generic_prepare(struct device *dev);
@@ -692,6 +697,12 @@ static inline int device_pm_wait_for_dev(struct device *a, struct device *b)
 	return 0;
 }
 
+static inline int device_pm_add_dependency(struct device *consumer,
+					   struct device *supplier)
+{
+	return 0;
+}
+
 static inline void dpm_for_each_dev(void *data, void (*fn)(struct device *, void *))
 {
 }
@@ -9,6 +9,7 @@
 #include <linux/miscdevice.h>
 #include <linux/device.h>
 #include <linux/workqueue.h>
+#include <linux/cpumask.h>
 
 enum {
 	PM_QOS_RESERVED = 0,
@@ -37,10 +38,23 @@ enum pm_qos_flags_status {
 #define PM_QOS_FLAG_NO_POWER_OFF	(1 << 0)
 #define PM_QOS_FLAG_REMOTE_WAKEUP	(1 << 1)
 
+enum pm_qos_req_type {
+	PM_QOS_REQ_ALL_CORES = 0,
+	PM_QOS_REQ_AFFINE_CORES,
+};
+
+/*
+ * A request normally constrains every cpu. Set @type to
+ * PM_QOS_REQ_AFFINE_CORES and fill in @cpus_affine before adding it to
+ * restrict it to those cpus, as seen by pm_qos_request_for_cpu().
+ */
 struct pm_qos_request {
+	enum pm_qos_req_type type;
+	struct cpumask cpus_affine;
 	struct plist_node node;
 	int pm_qos_class;
 	struct delayed_work work; /* for pm_qos_update_request_timeout */
+	void *owner;
 };
 
 struct pm_qos_flags_request {
@@ -79,6 +93,7 @@ struct pm_qos_constraints {
 	s32 default_value;
 	enum pm_qos_type type;
 	struct blocking_notifier_head *notifiers;
+	s32 *target_per_cpu;	/* NULL unless per-cpu targets are kept */
 };
 
 struct pm_qos_flags {
@@ -119,6 +134,8 @@ void pm_qos_update_request_timeout(struct pm_qos_request *req,
 void pm_qos_remove_request(struct pm_qos_request *req);
 
 int pm_qos_request(int pm_qos_class);
+int pm_qos_request_for_cpu(int pm_qos_class, int cpu);
+int pm_qos_request_for_cpumask(int pm_qos_class, const struct cpumask *mask);
 int pm_qos_add_notifier(int pm_qos_class, struct notifier_block *notifier);
 int pm_qos_remove_notifier(int pm_qos_class, struct notifier_block *notifier);
 int pm_qos_request_active(struct pm_qos_request *req);
@@ -0,0 +1,29 @@
+#ifndef _LINUX_PREFETCH_TRACE_H
+#define _LINUX_PREFETCH_TRACE_H
+
+#include <linux/fs.h>
+#include <uapi/linux/prefetch_trace.h>
+
+#ifdef CONFIG_PREFETCH_TRACE
+extern bool prefetch_trace_recording;
+extern void __prefetch_trace_miss(struct file *file, pgoff_t index,
+				  unsigned long nr);
+
+/*
+ * Called on a page cache miss for @nr pages at @index of @file. Only does
+ * any work while a recording window is open.
+ */
+static inline void prefetch_trace_miss(struct file *file, pgoff_t index,
+				       unsigned long nr)
+{
+	if (unlikely(prefetch_trace_recording))
+		__prefetch_trace_miss(file, index, nr);
+}
+#else
+static inline void prefetch_trace_miss(struct file *file, pgoff_t index,
+				       unsigned long nr)
+{
+}
+#endif
+
+#endif /* _LINUX_PREFETCH_TRACE_H */
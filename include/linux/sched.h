@@ -106,6 +106,15 @@ extern unsigned long this_cpu_load(void);
 extern void sched_update_nr_prod(int cpu, unsigned long nr, bool inc);
 extern void sched_get_nr_running_avg(int *avg, int *iowait_avg);
 
+enum {
+	SCHED_NR_AVG_10MS,
+	SCHED_NR_AVG_50MS,
+	SCHED_NR_AVG_200MS,
+	SCHED_NR_AVG_WINDOWS,
+};
+extern void sched_get_nr_running_avg_window(int window, int *avg,
+					    int *iowait_avg);
+
 extern void calc_global_load(unsigned long ticks);
 extern void update_cpu_load_nohz(void);
 
@@ -130,6 +139,10 @@ extern void proc_sched_set_task(struct task_struct *p);
 extern void
 print_cfs_rq(struct seq_file *m, int cpu, struct cfs_rq *cfs_rq);
 #endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+extern void proc_sched_lat_show_task(struct task_struct *p, struct seq_file *m);
+extern void proc_sched_lat_set_task(struct task_struct *p);
+#endif
 
 /*
  * Task state bitmask. NOTE! These bits are also
@@ -373,6 +386,7 @@ extern int get_dumpable(struct mm_struct *mm);
 
 #define MMF_HAS_UPROBES		19	/* has uprobes */
 #define MMF_RECALC_UPROBES	20	/* MMF_HAS_UPROBES can be wrong */
+#define MMF_OOM_REAPED		21	/* anon memory torn down by oom_reaper */
 
 #define MMF_INIT_MASK		(MMF_DUMPABLE_MASK | MMF_DUMP_FILTER_MASK)
 
@@ -618,6 +632,10 @@ struct signal_struct {
 	short oom_score_adj;		/* OOM kill score adjustment */
 	short oom_score_adj_min;	/* OOM kill score adjustment min value.
 					 * Only settable by CAP_SYS_RESOURCE. */
+#ifdef CONFIG_ANDROID_LMK_ADJ_RBTREE
+	struct rb_node adj_node;	/* lowmemorykiller tree, sorted by */
+	short adj_key;			/* oom_score_adj as of last update */
+#endif
 
 	struct mutex cred_guard_mutex;	/* guard against foreign influences on
 					 * credential calculations
@@ -939,6 +957,12 @@ struct sched_avg {
 };
 
 #ifdef CONFIG_SCHEDSTATS
+/*
+ * Wakeup-to-run latency histogram: bucket 0 counts latencies below 1us,
+ * bucket n counts [2^(n-1), 2^n) us and the last bucket everything above.
+ */
+#define SCHED_LAT_HIST_BUCKETS	16
+
 struct sched_statistics {
 	u64			wait_start;
 	u64			wait_max;
@@ -971,6 +995,13 @@ struct sched_statistics {
 	u64			nr_wakeups_affine_attempts;
 	u64			nr_wakeups_passive;
 	u64			nr_wakeups_idle;
+	u64			nr_wakeups_energy_pack;
+	u64			nr_wakeups_energy_spread;
+
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	u64			wakeup_lat_start;
+	u32			wakeup_lat_hist[SCHED_LAT_HIST_BUCKETS];
+#endif
 };
 #endif
 
@@ -1084,6 +1115,10 @@ struct task_struct {
 #ifdef CONFIG_CGROUP_SCHED
 	struct task_group *sched_task_group;
 #endif
+#ifdef CONFIG_SCHED_TUNE
+	/* boost lent by a client waiting on this task, see sched_set_boost_hint() */
+	unsigned int boost_hint;
+#endif
 
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	/* list of struct preempt_notifier: */
@@ -1208,6 +1243,9 @@ struct task_struct {
 	} vtime_snap_whence;
 #endif
 	unsigned long nvcsw, nivcsw; /* context switch counts */
+#ifdef CONFIG_CPU_FREQ_TIMES
+	struct cpufreq_task_times *cpufreq_times;
+#endif
 	struct timespec start_time; 		/* monotonic time */
 	struct timespec real_start_time;	/* boot based time */
 /* mm fault and swap info: this can arguably be seen as either mm-specific or thread-specific */
@@ -1965,6 +2003,27 @@ extern int sched_setscheduler(struct task_struct *, int,
 			      const struct sched_param *);
 extern int sched_setscheduler_nocheck(struct task_struct *, int,
 				      const struct sched_param *);
+#ifdef CONFIG_SCHED_TUNE
+extern unsigned int sched_task_boost(struct task_struct *p);
+extern void sched_set_boost_hint(struct task_struct *p, unsigned int boost);
+static inline unsigned int sched_boost_hint(struct task_struct *p)
+{
+	return ACCESS_ONCE(p->boost_hint);
+}
+#else
+static inline unsigned int sched_task_boost(struct task_struct *p)
+{
+	return 0;
+}
+static inline unsigned int sched_boost_hint(struct task_struct *p)
+{
+	return 0;
+}
+static inline void sched_set_boost_hint(struct task_struct *p,
+					unsigned int boost)
+{
+}
+#endif
 extern struct task_struct *idle_task(int cpu);
 /**
  * is_idle_task - is the specified task an idle task?
@@ -2732,6 +2791,11 @@ static inline void inc_syscw(struct task_struct *tsk)
 {
 	tsk->ioac.syscw++;
 }
+
+static inline void inc_syscfs(struct task_struct *tsk)
+{
+	tsk->ioac.syscfs++;
+}
 #else
 static inline void add_rchar(struct task_struct *tsk, ssize_t amt)
 {
@@ -2748,6 +2812,10 @@ static inline void inc_syscr(struct task_struct *tsk)
 static inline void inc_syscw(struct task_struct *tsk)
 {
 }
+
+static inline void inc_syscfs(struct task_struct *tsk)
+{
+}
 #endif
 
 #ifndef TASK_SIZE_OF
@@ -2789,4 +2857,17 @@ static inline unsigned long rlimit_max(unsigned int limit)
 	return task_rlimit_max(current, limit);
 }
 
+#ifdef CONFIG_CPU_FREQ
+/*
+ * Utilization callback for cpufreq governors, invoked by the scheduler
+ * with the runqueue lock held whenever the CPU's load average changes.
+ */
+struct update_util_data {
+	void (*func)(struct update_util_data *data,
+		     u64 time, unsigned long util, unsigned long max);
+};
+
+void cpufreq_set_update_util_data(int cpu, struct update_util_data *data);
+#endif /* CONFIG_CPU_FREQ */
+
 #endif
@@ -0,0 +1,43 @@
+#ifndef _LINUX_SCHED_ENERGY_H
+#define _LINUX_SCHED_ENERGY_H
+
+/*
+ * Per-CPU energy model used by energy aware task placement
+ * (CONFIG_SCHED_ENERGY_AWARE). Powers are per core and only need to be
+ * consistent with one another; any unit will do.
+ */
+
+struct sched_energy_opp {
+	unsigned int	freq;		/* kHz */
+	unsigned int	power;		/* while busy at this frequency */
+};
+
+struct sched_energy_idle {
+	unsigned int	power;		/* while in this idle state */
+};
+
+/**
+ * struct sched_energy - energy model of the CPUs of a single cluster
+ * @opps:		operating points, in increasing frequency order
+ * @nr_opps:		number of entries in @opps
+ * @idle_states:	idle states, from the shallowest (entered between
+ *			bursts of a busy CPU) to the deepest (entered by a
+ *			CPU with nothing to run)
+ * @nr_idle_states:	number of entries in @idle_states
+ */
+struct sched_energy {
+	const struct sched_energy_opp	*opps;
+	int				nr_opps;
+	const struct sched_energy_idle	*idle_states;
+	int				nr_idle_states;
+};
+
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+extern void sched_energy_register(const struct sched_energy *em);
+#else
+static inline void sched_energy_register(const struct sched_energy *em)
+{
+}
+#endif
+
+#endif /* _LINUX_SCHED_ENERGY_H */
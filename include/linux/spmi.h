@@ -16,6 +16,7 @@
 #include <linux/types.h>
 #include <linux/device.h>
 #include <linux/mod_devicetable.h>
+#include <linux/spinlock.h>
 
 /* Maximum slave identifier */
 #define SPMI_MAX_SLAVE_ID		16
@@ -50,6 +51,8 @@ struct spmi_device;
  * @cmd: sends a non-data command sequence on the SPMI bus.
  * @read_cmd: sends a register read command sequence on the SPMI bus.
  * @write_cmd: sends a register write command sequence on the SPMI bus.
+ * @reg_caches: register caches of peripherals on this bus.
+ * @reg_cache_lock: protects @reg_caches and their contents.
  */
 struct spmi_controller {
 	struct device		dev;
@@ -60,6 +63,8 @@ struct spmi_controller {
 				u8 opcode, u8 sid, u16 addr, u8 bc, u8 *buf);
 	int		(*write_cmd)(struct spmi_controller *,
 				u8 opcode, u8 sid, u16 addr, u8 bc, u8 *buf);
+	struct list_head	reg_caches;
+	spinlock_t		reg_cache_lock;
 };
 #define to_spmi_controller(d) container_of(d, struct spmi_controller, dev)
 
@@ -317,6 +322,21 @@ extern int spmi_ext_register_read(struct spmi_controller *ctrl,
 extern int spmi_ext_register_readl(struct spmi_controller *ctrl,
 					u8 sid, u16 ad, u8 *buf, int len);
 
+/**
+ * spmi_ext_register_readl_block() - extended register read long of a block
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @ad: slave register address (16-bit address).
+ * @buf: buffer to be populated with data from the Slave.
+ * @len: the request number of bytes to read (up to 256 bytes).
+ *
+ * Reads consecutive registers of one peripheral, in as few transactions
+ * as the controller allows.  The block may not cross the end of the
+ * peripheral holding @ad.
+ */
+extern int spmi_ext_register_readl_block(struct spmi_controller *ctrl,
+					u8 sid, u16 ad, u8 *buf, int len);
+
 /**
  * spmi_register_write() - register write
  * @ctrl: SPMI controller.
@@ -368,6 +388,73 @@ extern int spmi_ext_register_write(struct spmi_controller *ctrl,
 extern int spmi_ext_register_writel(struct spmi_controller *ctrl,
 					u8 sid, u16 ad, u8 *buf, int len);
 
+/**
+ * spmi_ext_register_writel_block() - extended register write long of a block
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @ad: slave register address (16-bit address).
+ * @buf: buffer containing the data to be transferred to the Slave.
+ * @len: the request number of bytes to write (up to 256 bytes).
+ *
+ * Writes consecutive registers of one peripheral, in as few transactions
+ * as the controller allows.  The block may not cross the end of the
+ * peripheral holding @ad.
+ */
+extern int spmi_ext_register_writel_block(struct spmi_controller *ctrl,
+					u8 sid, u16 ad, u8 *buf, int len);
+
+/**
+ * struct spmi_reg_range - range of registers within a peripheral
+ * @first: offset of the first register.
+ * @last: offset of the last register, inclusive.
+ */
+struct spmi_reg_range {
+	u8	first;
+	u8	last;
+};
+
+/**
+ * spmi_reg_cache_register() - cache the registers of a peripheral
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @base: base address of the peripheral (16-bit address, 256 aligned).
+ * @volatile_regs: registers that are never cached, such as status,
+ *	interrupt and self-clearing registers.
+ * @num: number of entries in @volatile_regs.
+ *
+ * Once read or written through the extended long commands, the other
+ * registers of the peripheral are served from memory.  Writes are
+ * always passed on to the Slave.  Registering a peripheral again adds
+ * to its volatile registers.
+ *
+ * Returns 0 on success, -EINVAL for a bad address, -ENOMEM otherwise.
+ */
+extern int spmi_reg_cache_register(struct spmi_controller *ctrl, u8 sid,
+				u16 base,
+				const struct spmi_reg_range *volatile_regs,
+				int num);
+
+/**
+ * spmi_reg_cache_unregister() - drop a reference to a peripheral cache
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @base: base address of the peripheral.
+ */
+extern void spmi_reg_cache_unregister(struct spmi_controller *ctrl, u8 sid,
+				u16 base);
+
+/**
+ * spmi_reg_cache_invalidate() - forget the cached registers of a peripheral
+ * @ctrl: SPMI controller.
+ * @sid: slave identifier.
+ * @base: base address of the peripheral.
+ *
+ * For use after the peripheral has been reset or reprogrammed by
+ * another execution environment.
+ */
+extern void spmi_reg_cache_invalidate(struct spmi_controller *ctrl, u8 sid,
+				u16 base);
+
 /**
  * spmi_command_reset() - sends RESET command to the specified slave
  * @ctrl: SPMI controller.
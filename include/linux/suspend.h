@@ -96,6 +96,45 @@ static inline void dpm_save_failed_step(enum suspend_stat_step step)
 	suspend_stats.last_failed_step %= REC_FAILED_NUM;
 }
 
+/* Phases of a suspend/resume cycle timed by the suspend profiler */
+enum suspend_phase {
+	SUSPEND_PHASE_FREEZE,
+	SUSPEND_PHASE_PREPARE,
+	SUSPEND_PHASE_SUSPEND,
+	SUSPEND_PHASE_SUSPEND_LATE,
+	SUSPEND_PHASE_SUSPEND_NOIRQ,
+	SUSPEND_PHASE_SYSCORE_SUSPEND,
+	SUSPEND_PHASE_SYSCORE_RESUME,
+	SUSPEND_PHASE_RESUME_NOIRQ,
+	SUSPEND_PHASE_RESUME_EARLY,
+	SUSPEND_PHASE_RESUME,
+	SUSPEND_PHASE_COMPLETE,
+	SUSPEND_PHASE_THAW,
+	SUSPEND_PHASE_COUNT
+};
+
+struct device;
+
+#ifdef CONFIG_SUSPEND_TIME
+extern u64 suspend_time_now(void);
+extern void suspend_time_begin(void);
+extern void suspend_time_end(int error);
+extern u64 suspend_time_phase_begin(enum suspend_phase phase);
+extern void suspend_time_phase_end(enum suspend_phase phase, u64 start);
+extern void suspend_time_device(struct device *dev, u64 start);
+#else
+static inline u64 suspend_time_now(void) { return 0; }
+static inline void suspend_time_begin(void) {}
+static inline void suspend_time_end(int error) {}
+static inline u64 suspend_time_phase_begin(enum suspend_phase phase)
+{
+	return 0;
+}
+static inline void suspend_time_phase_end(enum suspend_phase phase,
+					  u64 start) {}
+static inline void suspend_time_device(struct device *dev, u64 start) {}
+#endif
+
 /**
  * struct platform_suspend_ops - Callbacks for managing platform dependent
  *	system sleep states.
@@ -39,6 +39,8 @@ struct seq_file;
  *			  1 if b will signal before a
  *			  0 if a and b will signal at the same time
  *			 -1 if a will signabl before b
+ *			pts signal in this order: once a pt has signaled,
+ *			every pt that compares before it has signaled too
  * @free_pt:		called before sync_pt is freed
  * @release_obj:	called before sync_timeline is freed
  * @print_obj:		deprecated
@@ -95,7 +97,8 @@ struct sync_timeline_ops {
  * @child_list_head:	list of children sync_pts for this sync_timeline
  * @child_list_lock:	lock protecting @child_list_head, destroyed, and
  *			  sync_pt.status
- * @active_list_head:	list of active (unsignaled/errored) sync_pts
+ * @active_list_head:	list of active (unsignaled/errored) sync_pts, in
+ *			  signaling order
  * @sync_timeline_list:	membership in global sync_timeline_list
  */
 struct sync_timeline {
@@ -148,7 +151,8 @@ struct sync_pt {
  * @file:		file representing this fence
  * @kref:		referenace count on fence.
  * @name:		name of sync_fence.  Useful for debugging
- * @pt_list_head:	list of sync_pts in ths fence.  immutable once fence
+ * @pt_list_head:	list of sync_pts in ths fence, sorted by timeline with
+ *			  at most one per timeline.  immutable once fence
  *			  is created
  * @waiter_list_head:	list of asynchronous waiters on this fence
  * @waiter_list_lock:	lock protecting @waiter_list_head and @status
@@ -202,6 +202,7 @@ extern unsigned long get_next_timer_interrupt(unsigned long now);
 extern int timer_stats_active;
 
 #define TIMER_STATS_FLAG_DEFERRABLE	0x1
+#define TIMER_STATS_FLAG_WAKEUP		0x2	/* expired on an idle CPU */
 
 extern void init_timer_stats(void);
 
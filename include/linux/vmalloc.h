@@ -43,6 +43,7 @@ struct vmap_area {
 	unsigned long va_end;
 	unsigned long flags;
 	struct rb_node rb_node;         /* address sorted rbtree */
+	unsigned long subtree_gap;      /* largest free gap in subtree */
 	struct list_head list;          /* address sorted list */
 	struct list_head purge_list;    /* "lazy purge" list */
 	struct vm_struct *vm;
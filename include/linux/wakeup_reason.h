@@ -18,10 +18,22 @@
 #ifndef _LINUX_WAKEUP_REASON_H
 #define _LINUX_WAKEUP_REASON_H
 
+#include <linux/types.h>
+
 #define MAX_SUSPEND_ABORT_LEN 256
 
-void log_wakeup_reason(int irq);
 void log_suspend_abort_reason(const char *fmt, ...);
+void log_autosleep_abort_reason(const char *reason);
 int check_wakeup_reason(int irq);
 
+#ifdef CONFIG_SUSPEND
+void log_wakeup_reason(int irq);
+void wakeup_reason_set_interactive(int irq, bool interactive);
+bool wakeup_reason_interactive(void);
+#else
+static inline void log_wakeup_reason(int irq) {}
+static inline void wakeup_reason_set_interactive(int irq, bool interactive) {}
+static inline bool wakeup_reason_interactive(void) { return false; }
+#endif
+
 #endif /* _LINUX_WAKEUP_REASON_H */
@@ -132,6 +132,44 @@ extern unsigned int dirty_expire_interval;
 extern int vm_highmem_is_dirtyable;
 extern int block_dump;
 extern int laptop_mode;
+extern unsigned int dirty_screen_off_interval;
+
+extern bool dirty_screen_off;
+
+/* Delay before the batched flush that follows disk activity */
+#define DIRTY_SCREEN_OFF_FLUSH_DELAY	(5 * HZ)
+
+static inline bool dirty_screen_off_batching(void)
+{
+	return dirty_screen_off && dirty_screen_off_interval;
+}
+
+/*
+ * Non-zero while dirty data is batched up, either in laptop mode or with
+ * the screen off: the time in jiffies after disk activity stops before
+ * everything is written out.
+ */
+static inline int writeback_batching(void)
+{
+	if (laptop_mode)
+		return laptop_mode;
+	return dirty_screen_off_batching() ? DIRTY_SCREEN_OFF_FLUSH_DELAY : 0;
+}
+
+/* The kupdate period and dirty expiry in effect, in centisecs */
+static inline unsigned int dirty_writeback_centisecs(void)
+{
+	if (dirty_writeback_interval && dirty_screen_off_batching())
+		return max(dirty_writeback_interval, dirty_screen_off_interval);
+	return dirty_writeback_interval;
+}
+
+static inline unsigned int dirty_expire_centisecs(void)
+{
+	if (dirty_screen_off_batching())
+		return max(dirty_expire_interval, dirty_screen_off_interval);
+	return dirty_expire_interval;
+}
 
 extern int dirty_background_ratio_handler(struct ctl_table *table, int write,
 		void __user *buffer, size_t *lenp,
@@ -298,6 +298,7 @@ extern atomic_long_t tcp_memory_allocated;
 /* sysctl variables for controlling various tcp parameters */
 extern int sysctl_tcp_delack_seg;
 extern int sysctl_tcp_use_userconfig;
+extern int sysctl_tcp_lowpower_timers;
 
 extern struct percpu_counter tcp_sockets_allocated;
 extern int tcp_memory_pressure;
@@ -10,8 +10,25 @@
  * GNU General Public License for more details.
  */
 
+#ifndef __SOC_QCOM_BOOT_STATS_H
+#define __SOC_QCOM_BOOT_STATS_H
+
+#include <linux/types.h>
+
+struct device;
+
 #ifdef CONFIG_MSM_BOOT_STATS
 int boot_stats_init(void);
+__printf(1, 2) void boot_stats_mark(const char *fmt, ...);
+u64 boot_stats_probe_start(void);
+void boot_stats_probe(struct device *dev, u64 start, int ret);
 #else
 static inline int boot_stats_init(void) { return 0; }
+static inline __printf(1, 2) void boot_stats_mark(const char *fmt, ...) { }
+static inline u64 boot_stats_probe_start(void) { return 0; }
+static inline void boot_stats_probe(struct device *dev, u64 start, int ret)
+{
+}
+#endif
+
 #endif
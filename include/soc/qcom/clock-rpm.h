@@ -30,6 +30,12 @@ struct clk_rpmrs_data;
 extern struct clk_ops clk_ops_rpm;
 extern struct clk_ops clk_ops_rpm_branch;
 
+enum {
+	RPM_CLK_ACTIVE_SET,
+	RPM_CLK_SLEEP_SET,
+	RPM_CLK_NR_SETS,
+};
+
 struct rpm_clk {
 	const int rpm_res_type;
 	const int rpm_key;
@@ -38,6 +44,9 @@ struct rpm_clk {
 	const bool active_only;
 	bool enabled;
 	bool branch; /* true: RPM only accepts 1 for ON and 0 for OFF */
+	/* last votes sent for the resource, kept in sync with the peer */
+	uint32_t last_vote[RPM_CLK_NR_SETS];
+	bool last_vote_valid[RPM_CLK_NR_SETS];
 	struct clk_rpmrs_data *rpmrs_data;
 	struct rpm_clk *peer;
 	struct clk c;
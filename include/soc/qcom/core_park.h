@@ -0,0 +1,22 @@
+/* Copyright (c) 2014, The Linux Foundation. All rights reserved.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 and
+ * only version 2 as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ */
+
+#ifdef CONFIG_MSM_CORE_PARK
+void msm_core_park_boost(unsigned int ms);
+int msm_core_park_thermal_limit(unsigned int max_cpus);
+#else
+static inline void msm_core_park_boost(unsigned int ms) { }
+static inline int msm_core_park_thermal_limit(unsigned int max_cpus)
+{
+	return -ENODEV;
+}
+#endif
@@ -39,6 +39,21 @@ struct lsm_sound_model {
 	uint32_t	mem_map_handle;
 };
 
+/*
+ * Look ahead buffer: the DSP writes the audio around a detection into
+ * this ION ring, one period per read command, and userspace maps it.
+ */
+struct lsm_lab_buffer {
+	dma_addr_t	phys;
+	void		*data;
+	size_t		size;
+	uint32_t	period_size;
+	uint32_t	periods;
+	struct ion_handle *handle;
+	struct ion_client *client;
+	uint32_t	mem_map_handle;
+};
+
 struct snd_lsm_event_status_v2 {
 	uint16_t status;
 	uint16_t payload_size;
@@ -66,6 +81,9 @@ struct lsm_client {
 	dma_addr_t	lsm_cal_phy_addr;
 	uint32_t	lsm_cal_size;
 	uint16_t	app_id;
+	bool		lab_enable;
+	bool		lab_started;
+	struct lsm_lab_buffer lab_buffer;
 };
 
 struct lsm_stream_cmd_open_tx {
@@ -119,6 +137,18 @@ struct lsm_param_min_confidence_levels {
 	uint8_t		confidence_level[MAX_NUM_CONFIDENCE];
 } __packed;
 
+struct lsm_param_lab_enable {
+	struct lsm_param_payload_common common;
+	uint16_t	enable;
+	uint16_t	reserved;
+} __packed;
+
+struct lsm_param_lab_config {
+	struct lsm_param_payload_common common;
+	uint32_t	minor_version;
+	/* audio the DSP keeps from before the detection event */
+	uint32_t	wake_up_latency_ms;
+} __packed;
 
 struct lsm_params_payload {
 	struct lsm_param_connect_to_port connect_to_port;
@@ -159,6 +189,43 @@ struct lsm_cmd_set_params_v2 {
 	struct lsm_params_payload_v2	payload;
 } __packed;
 
+struct lsm_cmd_set_params_lab_enable {
+	struct apr_hdr  hdr;
+	uint32_t	data_payload_size;
+	uint32_t	data_payload_addr_lsw;
+	uint32_t	data_payload_addr_msw;
+	uint32_t	mem_map_handle;
+	struct lsm_param_lab_enable	lab_enable;
+} __packed;
+
+struct lsm_cmd_set_params_lab_config {
+	struct apr_hdr  hdr;
+	uint32_t	data_payload_size;
+	uint32_t	data_payload_addr_lsw;
+	uint32_t	data_payload_addr_msw;
+	uint32_t	mem_map_handle;
+	struct lsm_param_lab_config	lab_config;
+} __packed;
+
+struct lsm_cmd_read {
+	struct apr_hdr	hdr;
+	uint32_t	buf_addr_lsw;
+	uint32_t	buf_addr_msw;
+	uint32_t	mem_map_handle;
+	uint32_t	buf_size;
+} __packed;
+
+struct lsm_cmd_read_done {
+	uint32_t	status;
+	uint32_t	buf_addr_lsw;
+	uint32_t	buf_addr_msw;
+	uint32_t	mem_map_handle;
+	uint32_t	total_size;
+	uint32_t	offset;
+	uint32_t	timestamp_lsw;
+	uint32_t	timestamp_msw;
+	uint32_t	flags;
+} __packed;
 
 struct lsm_cmd_reg_snd_model {
 	struct apr_hdr	hdr;
@@ -182,5 +249,11 @@ int q6lsm_register_sound_model(struct lsm_client *client,
 int q6lsm_deregister_sound_model(struct lsm_client *client);
 int q6lsm_set_kw_sensitivity_level(struct lsm_client *client,
 				   u16 minkeyword, u16 minuser);
+int q6lsm_lab_control(struct lsm_client *client, bool enable);
+int q6lsm_lab_buffer_alloc(struct lsm_client *client, uint32_t period_size,
+			   uint32_t periods);
+int q6lsm_lab_buffer_free(struct lsm_client *client);
+int q6lsm_read(struct lsm_client *client, uint32_t idx);
+int q6lsm_stop_lab(struct lsm_client *client);
 
 #endif /* __Q6LSM_H__ */
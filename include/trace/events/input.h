@@ -0,0 +1,61 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM input
+
+#if !defined(_TRACE_INPUT_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_INPUT_H
+
+#include <linux/input.h>
+#include <linux/tracepoint.h>
+
+DECLARE_EVENT_CLASS(input_latency,
+
+	TP_PROTO(struct input_dev *dev, s64 delta_us),
+
+	TP_ARGS(dev, delta_us),
+
+	TP_STRUCT__entry(
+		__string(name, dev_name(&dev->dev))
+		__field(s64, delta_us)
+	),
+
+	TP_fast_assign(
+		__assign_str(name, dev_name(&dev->dev));
+		__entry->delta_us = delta_us;
+	),
+
+	TP_printk("dev=%s delta_us=%lld", __get_str(name),
+		__entry->delta_us)
+);
+
+DEFINE_EVENT(input_latency, input_irq,
+
+	TP_PROTO(struct input_dev *dev, s64 delta_us),
+
+	TP_ARGS(dev, delta_us)
+);
+
+DEFINE_EVENT(input_latency, input_data,
+
+	TP_PROTO(struct input_dev *dev, s64 delta_us),
+
+	TP_ARGS(dev, delta_us)
+);
+
+DEFINE_EVENT(input_latency, input_sync,
+
+	TP_PROTO(struct input_dev *dev, s64 delta_us),
+
+	TP_ARGS(dev, delta_us)
+);
+
+DEFINE_EVENT(input_latency, input_evdev_read,
+
+	TP_PROTO(struct input_dev *dev, s64 delta_us),
+
+	TP_ARGS(dev, delta_us)
+);
+
+#endif /* if !defined(_TRACE_INPUT_H) || defined(TRACE_HEADER_MULTI_READ) */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
@@ -124,6 +124,85 @@ DEFINE_EVENT(set, cpufreq_freq_synced,
 	TP_ARGS(cpu_id, currfreq, load)
 );
 
+DECLARE_EVENT_CLASS(cpu_boost,
+	TP_PROTO(unsigned int cpu, const char *src, unsigned int freq),
+	TP_ARGS(cpu, src, freq),
+
+	TP_STRUCT__entry(
+	    __field(unsigned int, cpu)
+	    __string(src, src)
+	    __field(unsigned int, freq)
+	),
+
+	TP_fast_assign(
+	    __entry->cpu = cpu;
+	    __assign_str(src, src);
+	    __entry->freq = freq;
+	),
+
+	TP_printk("cpu=%u src=%s freq=%u",
+	      __entry->cpu, __get_str(src), __entry->freq)
+);
+
+DEFINE_EVENT(cpu_boost, cpu_boost_on,
+	TP_PROTO(unsigned int cpu, const char *src, unsigned int freq),
+	TP_ARGS(cpu, src, freq)
+);
+
+DEFINE_EVENT(cpu_boost, cpu_boost_off,
+	TP_PROTO(unsigned int cpu, const char *src, unsigned int freq),
+	TP_ARGS(cpu, src, freq)
+);
+
+TRACE_EVENT(cpubw_hwmon_meas,
+	TP_PROTO(unsigned int r_mbps, unsigned int w_mbps, unsigned int us,
+		 int irq),
+	TP_ARGS(r_mbps, w_mbps, us, irq),
+
+	TP_STRUCT__entry(
+	    __field(unsigned int, r_mbps)
+	    __field(unsigned int, w_mbps)
+	    __field(unsigned int, us)
+	    __field(int, irq)
+	),
+
+	TP_fast_assign(
+	    __entry->r_mbps = r_mbps;
+	    __entry->w_mbps = w_mbps;
+	    __entry->us = us;
+	    __entry->irq = irq;
+	),
+
+	TP_printk("r_mbps=%u w_mbps=%u us=%u irq=%d",
+	      __entry->r_mbps, __entry->w_mbps, __entry->us, __entry->irq)
+);
+
+TRACE_EVENT(cpubw_hwmon_update,
+	TP_PROTO(unsigned int mbps, unsigned int miss_pct, int mem_bound,
+		 unsigned long ab, unsigned long freq),
+	TP_ARGS(mbps, miss_pct, mem_bound, ab, freq),
+
+	TP_STRUCT__entry(
+	    __field(unsigned int, mbps)
+	    __field(unsigned int, miss_pct)
+	    __field(int, mem_bound)
+	    __field(unsigned long, ab)
+	    __field(unsigned long, freq)
+	),
+
+	TP_fast_assign(
+	    __entry->mbps = mbps;
+	    __entry->miss_pct = miss_pct;
+	    __entry->mem_bound = mem_bound;
+	    __entry->ab = ab;
+	    __entry->freq = freq;
+	),
+
+	TP_printk("mbps=%u miss_pct=%u mem_bound=%d ab=%lu freq=%lu",
+	      __entry->mbps, __entry->miss_pct, __entry->mem_bound,
+	      __entry->ab, __entry->freq)
+);
+
 TRACE_EVENT(machine_suspend,
 
 	TP_PROTO(unsigned int state),
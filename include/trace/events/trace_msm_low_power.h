@@ -127,6 +127,61 @@ DEFINE_EVENT(msm_pm_exit, msm_pm_exit_wfi,
 	TP_ARGS(cpu, success)
 );
 
+TRACE_EVENT(lpm_cpu_idle_enter,
+
+	TP_PROTO(unsigned int cpu, int index, uint32_t sleep_us),
+
+	TP_ARGS(cpu, index, sleep_us),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, cpu)
+		__field(int, index)
+		__field(uint32_t, sleep_us)
+	),
+
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->index = index;
+		__entry->sleep_us = sleep_us;
+	),
+
+	TP_printk("cpu:%u idx:%d sleep:%uus",
+		__entry->cpu,
+		__entry->index,
+		__entry->sleep_us)
+);
+
+TRACE_EVENT(lpm_cpu_idle_exit,
+
+	TP_PROTO(unsigned int cpu, int index, bool success,
+		uint64_t residency_ns, uint64_t wake_latency_ns),
+
+	TP_ARGS(cpu, index, success, residency_ns, wake_latency_ns),
+
+	TP_STRUCT__entry(
+		__field(unsigned int, cpu)
+		__field(int, index)
+		__field(int, success)
+		__field(uint64_t, residency_ns)
+		__field(uint64_t, wake_latency_ns)
+	),
+
+	TP_fast_assign(
+		__entry->cpu = cpu;
+		__entry->index = index;
+		__entry->success = success;
+		__entry->residency_ns = residency_ns;
+		__entry->wake_latency_ns = wake_latency_ns;
+	),
+
+	TP_printk("cpu:%u idx:%d success:%d residency:%lluns wake_latency:%lluns",
+		__entry->cpu,
+		__entry->index,
+		__entry->success,
+		__entry->residency_ns,
+		__entry->wake_latency_ns)
+);
+
 TRACE_EVENT(lpm_resources,
 
 	TP_PROTO(uint32_t sleep_value , char *name),
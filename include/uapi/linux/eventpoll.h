@@ -25,6 +25,14 @@
 #define EPOLL_CTL_ADD 1
 #define EPOLL_CTL_DEL 2
 #define EPOLL_CTL_MOD 3
+#define EPOLL_CTL_BATCH 4
+
+/*
+ * Allow the wakeups for this file descriptor to be batched as set up with
+ * EPOLL_CTL_BATCH on the epoll descriptor.  POLLPRI, POLLERR and POLLHUP
+ * are always reported at once.
+ */
+#define EPOLLBATCH (1 << 27)
 
 /*
  * Request the handling of system wakeup events so as to prevent system suspends
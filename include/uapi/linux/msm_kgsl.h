@@ -220,6 +220,7 @@ enum kgsl_property_type {
 	KGSL_PROP_GPU_RESET_STAT  = 0x00000009,
 	KGSL_PROP_PWRCTRL         = 0x0000000E,
 	KGSL_PROP_PWR_CONSTRAINT  = 0x00000012,
+	KGSL_PROP_TIMING_BUFFER   = 0x00000030,
 };
 
 struct kgsl_shadowprop {
@@ -228,6 +229,30 @@ struct kgsl_shadowprop {
 	unsigned int flags; /* contains KGSL_FLAGS_ values */
 };
 
+/*
+ * Per submission GPU timing.  KGSL_PROP_TIMING_BUFFER returns a
+ * struct kgsl_shadowprop describing a buffer that can be mapped read only
+ * with mmap() at offset gpuaddr.  The buffer holds a struct
+ * kgsl_timing_header followed by a ring of header.count struct
+ * kgsl_timing_entry.  start and end are samples of the GPU busy cycle
+ * counter taken before and after the IBs of the submission; an entry is
+ * complete once retired equals timestamp.
+ */
+struct kgsl_timing_header {
+	unsigned int head;	/* index of the next entry to be written */
+	unsigned int count;	/* number of entries in the ring */
+	unsigned int __pad[6];
+};
+
+struct kgsl_timing_entry {
+	unsigned int context_id;
+	unsigned int timestamp;
+	unsigned int start;
+	unsigned int end;
+	unsigned int retired;
+	unsigned int __pad[3];
+};
+
 struct kgsl_version {
 	unsigned int drv_major;
 	unsigned int drv_minor;
@@ -600,6 +625,15 @@ struct kgsl_timestamp_event_fence {
 	int fence_fd; /* Fence to signal */
 };
 
+/*
+ * Same as above, but the fence is also attached to the dma-buf the GPU is
+ * writing so that other drivers importing it can wait on it implicitly.
+ */
+struct kgsl_timestamp_event_fence_dmabuf {
+	int fence_fd; /* Fence to signal */
+	int dmabuf_fd; /* Buffer written up to the timestamp */
+};
+
 /*
  * Set a property within the kernel.  Uses the same structure as
  * IOCTL_KGSL_GETPROPERTY
@@ -924,6 +958,97 @@ struct kgsl_submit_commands {
 #define IOCTL_KGSL_SUBMIT_COMMANDS \
 	_IOWR(KGSL_IOC_TYPE, 0x3D, struct kgsl_submit_commands)
 
+#define KGSL_SUBMIT_RING_MAX_IBS 8
+#define KGSL_SUBMIT_RING_MAX_SIZE 256
+
+/**
+ * struct kgsl_submit_ring_ib - An indirect buffer in a submit ring entry
+ * @gpuaddr: GPU address of the IB
+ * @sizedwords: Size of the IB in dwords
+ * @ctrl: Same as kgsl_ibdesc.ctrl
+ */
+struct kgsl_submit_ring_ib {
+	unsigned long long gpuaddr;
+	unsigned int sizedwords;
+	unsigned int ctrl;
+};
+
+/**
+ * struct kgsl_submit_ring_entry - A command in a submit ring
+ * @flags: Same as kgsl_submit_commands.flags, KGSL_CONTEXT_SYNC is not
+ * supported
+ * @numibs: Number of IBs used in @ibs
+ * @timestamp: Written by the kernel, the timestamp assigned to the command
+ * @result: Written by the kernel, 0 or the error that
+ * IOCTL_KGSL_SUBMIT_COMMANDS would have returned for the command
+ * @ibs: The indirect buffers of the command
+ */
+struct kgsl_submit_ring_entry {
+	unsigned int flags;
+	unsigned int numibs;
+	unsigned int timestamp;
+	int result;
+	struct kgsl_submit_ring_ib ibs[KGSL_SUBMIT_RING_MAX_IBS];
+};
+
+/**
+ * struct kgsl_submit_ring_header - Start of a submit ring
+ * @head: Written by the kernel, index of the next entry it will submit
+ * @tail: Written by the user, index of the next entry it will fill
+ * @size: Number of entries in the ring
+ *
+ * The entries follow the header.  @head and @tail run freely and are
+ * taken modulo @size, the ring is empty when they are equal.
+ */
+struct kgsl_submit_ring_header {
+	unsigned int head;
+	unsigned int tail;
+	unsigned int size;
+/* private: reserved for future use */
+	unsigned int __pad[5];
+};
+
+/**
+ * struct kgsl_submit_ring_setup - Argument to IOCTL_KGSL_SUBMIT_RING_SETUP
+ * @context_id: KGSL context ID that will submit from the ring
+ * @size: Number of entries, a power of two up to KGSL_SUBMIT_RING_MAX_SIZE
+ * @addr: Page aligned user address of the ring, which must have room for
+ * the header and @size entries
+ *
+ * The memory at @addr is shared with the kernel until the context is
+ * destroyed.  Commands added to it are submitted in order by
+ * IOCTL_KGSL_SUBMIT_RING_DOORBELL, so that a batch of them costs one
+ * system call and one context lookup.
+ */
+struct kgsl_submit_ring_setup {
+	unsigned int context_id;
+	unsigned int size;
+	unsigned long long addr;
+/* private: reserved for future use */
+	unsigned int __pad[4];
+};
+
+#define IOCTL_KGSL_SUBMIT_RING_SETUP \
+	_IOW(KGSL_IOC_TYPE, 0x3E, struct kgsl_submit_ring_setup)
+
+/**
+ * struct kgsl_submit_ring_doorbell - Argument to
+ * IOCTL_KGSL_SUBMIT_RING_DOORBELL
+ * @context_id: KGSL context ID that owns the ring
+ * @count: On exit the number of entries submitted
+ * @timestamp: On exit the timestamp of the last entry submitted
+ */
+struct kgsl_submit_ring_doorbell {
+	unsigned int context_id;
+	unsigned int count;
+	unsigned int timestamp;
+/* private: reserved for future use */
+	unsigned int __pad[5];
+};
+
+#define IOCTL_KGSL_SUBMIT_RING_DOORBELL \
+	_IOWR(KGSL_IOC_TYPE, 0x3F, struct kgsl_submit_ring_doorbell)
+
 /**
  * struct kgsl_device_constraint - device constraint argument
  * @context_id: KGSL context ID
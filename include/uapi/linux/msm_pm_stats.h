@@ -0,0 +1,63 @@
+#ifndef _UAPI_MSM_PM_STATS_H
+#define _UAPI_MSM_PM_STATS_H
+
+#include <linux/types.h>
+
+/*
+ * Binary snapshots of the RPM sleep, RPM master and CPU low power mode
+ * statistics. Each debugfs *_bin file returns one header followed by
+ * @count records of @record_size bytes; a single read() at offset 0
+ * takes a fresh snapshot. New fields are only ever appended to a
+ * record, so readers should use @record_size to step through them.
+ */
+#define MSM_PM_STATS_SNAPSHOT_VERSION	1
+
+enum msm_pm_stats_snapshot_type {
+	MSM_PM_STATS_RPM_SLEEP,
+	MSM_PM_STATS_RPM_MASTER,
+	MSM_PM_STATS_LPM,
+};
+
+struct msm_pm_stats_snapshot_hdr {
+	__u32 version;
+	__u32 type;
+	__u32 count;
+	__u32 record_size;
+	__u64 timestamp;	/* arch counter or ns, as the records */
+};
+
+/* RPM sleep mode, times in 19.2MHz arch counter ticks */
+struct msm_rpm_sleep_stats_record {
+	char name[4];		/* not NUL terminated, e.g. "vmin" */
+	__u32 count;
+	__u64 last_entered_at;
+	__u64 last_exited_at;
+	__u64 accumulated;
+	__u32 client_votes;
+	__u32 reserved;
+};
+
+/* RPM master, times in 19.2MHz arch counter ticks */
+struct msm_rpm_master_stats_record {
+	char name[16];
+	__u32 active_cores;
+	__u32 numshutdowns;
+	__u64 shutdown_req;
+	__u64 wakeup_ind;
+	__u64 bringup_req;
+	__u64 bringup_ack;
+	__u32 wakeup_reason;
+	__u32 last_sleep_transition_duration;
+	__u32 last_wake_transition_duration;
+	__u32 reserved;
+};
+
+/* CPU low power mode, times in ns */
+struct msm_lpm_stats_record {
+	char name[32];
+	__u32 cpu;
+	__u32 count;
+	__u64 total_time;
+};
+
+#endif /* _UAPI_MSM_PM_STATS_H */
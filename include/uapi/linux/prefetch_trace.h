@@ -0,0 +1,36 @@
+#ifndef _UAPI_LINUX_PREFETCH_TRACE_H
+#define _UAPI_LINUX_PREFETCH_TRACE_H
+
+#include <linux/types.h>
+
+/*
+ * Binary page cache miss trace, as read from and written back to
+ * /sys/kernel/mm/prefetch_trace/trace and .../replay:
+ *
+ *	struct prefetch_trace_header
+ *	struct prefetch_trace_range	[nr_ranges]
+ *	char				names[names_len]
+ *
+ * names holds nr_files NUL-terminated paths; a range refers to a file by
+ * its position in that list. Ranges are in first-miss order and are
+ * counted in pages.
+ */
+#define PREFETCH_TRACE_MAGIC	0x50465452	/* "PFTR" */
+#define PREFETCH_TRACE_VERSION	1
+
+struct prefetch_trace_header {
+	__u32	magic;
+	__u16	version;
+	__u16	page_shift;
+	__u32	nr_files;
+	__u32	nr_ranges;
+	__u32	names_len;
+};
+
+struct prefetch_trace_range {
+	__u32	file;
+	__u32	start;
+	__u32	nr;
+};
+
+#endif /* _UAPI_LINUX_PREFETCH_TRACE_H */
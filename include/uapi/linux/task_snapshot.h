@@ -0,0 +1,44 @@
+#ifndef _UAPI_LINUX_TASK_SNAPSHOT_H
+#define _UAPI_LINUX_TASK_SNAPSHOT_H
+
+#include <linux/types.h>
+
+/*
+ * Binary process statistics.  A read() of /proc/task_snapshot at offset
+ * 0 takes a fresh snapshot and returns one header followed by @count
+ * records of @record_size bytes, one per process.  Writing an array of
+ * __s32 pids limits the snapshots taken through that file descriptor to
+ * those processes; writing a single 0 selects all processes again.  New
+ * fields are only ever appended to a record, so readers should use
+ * @record_size to step through them.
+ */
+#define TASK_SNAPSHOT_VERSION		1
+#define TASK_SNAPSHOT_CGROUP_LEN	64
+
+struct task_snapshot_hdr {
+	__u32 version;
+	__u32 count;
+	__u32 record_size;
+	__u32 reserved;
+	__u64 timestamp;	/* CLOCK_MONOTONIC, ns */
+};
+
+struct task_snapshot_record {
+	__s32 pid;		/* thread group id */
+	__s32 ppid;
+	__u32 uid;
+	__s16 oom_score_adj;
+	__u8 state;		/* as in /proc/<pid>/stat, e.g. 'R' */
+	__u8 reserved;
+	__u32 nr_threads;
+	__u32 reserved2;
+	__u64 start_time;	/* ns since boot */
+	__u64 utime;		/* us, whole thread group */
+	__u64 stime;		/* us, whole thread group */
+	__u64 vsize;		/* bytes */
+	__u64 rss;		/* pages */
+	__u64 swap;		/* pages */
+	char cgroup[TASK_SNAPSHOT_CGROUP_LEN];	/* cpu cgroup path */
+};
+
+#endif /* _UAPI_LINUX_TASK_SNAPSHOT_H */
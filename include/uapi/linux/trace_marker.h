@@ -0,0 +1,22 @@
+#ifndef _UAPI_LINUX_TRACE_MARKER_H
+#define _UAPI_LINUX_TRACE_MARKER_H
+
+#include <linux/types.h>
+
+/*
+ * Records written to the tracing/trace_marker_bin file.  A write may hold
+ * several records back to back; they are timestamped at the write.
+ */
+enum trace_marker_type {
+	TRACE_MARKER_BEGIN,
+	TRACE_MARKER_END,
+	TRACE_MARKER_COUNTER,
+};
+
+struct trace_marker_bin {
+	__u32 id;	/* event id, meaning is up to userspace */
+	__u32 type;	/* enum trace_marker_type */
+	__u64 value;	/* counter value or extra data */
+};
+
+#endif /* _UAPI_LINUX_TRACE_MARKER_H */
@@ -76,6 +76,7 @@
 #include <linux/elevator.h>
 #include <linux/sched_clock.h>
 #include <linux/random.h>
+#include <soc/qcom/boot_stats.h>
 
 #include <asm/io.h>
 #include <asm/bugs.h>
@@ -756,6 +757,8 @@ static void __init do_initcall_level(int level)
 
 	for (fn = initcall_levels[level]; fn < initcall_levels[level+1]; fn++)
 		do_one_initcall(*fn);
+
+	boot_stats_mark("initcall level %s done", initcall_level_names[level]);
 }
 
 static void __init do_initcalls(void)
@@ -792,6 +795,8 @@ static void __init do_pre_smp_initcalls(void)
 
 	for (fn = __initcall_start; fn < __initcall0_start; fn++)
 		do_one_initcall(*fn);
+
+	boot_stats_mark("initcall level early done");
 }
 
 /*
@@ -808,6 +813,7 @@ void __init load_default_modules(void)
 static int run_init_process(const char *init_filename)
 {
 	argv_init[0] = init_filename;
+	boot_stats_mark("exec %s", init_filename);
 	return do_execve(init_filename,
 		(const char __user *const __user *)argv_init,
 		(const char __user *const __user *)envp_init);
@@ -904,6 +910,7 @@ static noinline void __init kernel_init_freeable(void)
 		ramdisk_execute_command = NULL;
 		prepare_namespace();
 	}
+	boot_stats_mark("rootfs ready");
 
 	/*
 	 * Ok, we have completed the initial bootup, and
@@ -21,6 +21,9 @@
 #include <linux/uaccess.h>
 #include <linux/freezer.h>
 #include <linux/seq_file.h>
+#include <linux/eventfd.h>
+#include <linux/workqueue.h>
+#include <linux/swap.h>
 
 /*
  * A cgroup is freezing if any FREEZING flags are set.  FREEZING_SELF is
@@ -39,10 +42,22 @@ enum freezer_state_flags {
 	CGROUP_FREEZING		= CGROUP_FREEZING_SELF | CGROUP_FREEZING_PARENT,
 };
 
+/* eventfd registered on freezer.state, signaled on reaching FROZEN */
+struct freezer_event {
+	struct list_head		list;
+	struct eventfd_ctx		*eventfd;
+};
+
 struct freezer {
 	struct cgroup_subsys_state	css;
 	unsigned int			state;
 	spinlock_t			lock;
+	struct list_head		events;
+	struct work_struct		frozen_work;
+#ifdef CONFIG_PROCESS_RECLAIM
+	bool				reclaim_on_freeze;
+	struct work_struct		reclaim_work;
+#endif
 };
 
 static inline struct freezer *cgroup_freezer(struct cgroup *cgroup)
@@ -92,6 +107,11 @@ static const char *freezer_state_strs(unsigned int state)
 
 struct cgroup_subsys freezer_subsys;
 
+static void freezer_frozen_workfn(struct work_struct *work);
+#ifdef CONFIG_PROCESS_RECLAIM
+static void freezer_reclaim_workfn(struct work_struct *work);
+#endif
+
 static struct cgroup_subsys_state *freezer_css_alloc(struct cgroup *cgroup)
 {
 	struct freezer *freezer;
@@ -101,6 +121,11 @@ static struct cgroup_subsys_state *freezer_css_alloc(struct cgroup *cgroup)
 		return ERR_PTR(-ENOMEM);
 
 	spin_lock_init(&freezer->lock);
+	INIT_LIST_HEAD(&freezer->events);
+	INIT_WORK(&freezer->frozen_work, freezer_frozen_workfn);
+#ifdef CONFIG_PROCESS_RECLAIM
+	INIT_WORK(&freezer->reclaim_work, freezer_reclaim_workfn);
+#endif
 	return &freezer->css;
 }
 
@@ -163,7 +188,13 @@ static void freezer_css_offline(struct cgroup *cgroup)
 
 static void freezer_css_free(struct cgroup *cgroup)
 {
-	kfree(cgroup_freezer(cgroup));
+	struct freezer *freezer = cgroup_freezer(cgroup);
+
+	cancel_work_sync(&freezer->frozen_work);
+#ifdef CONFIG_PROCESS_RECLAIM
+	cancel_work_sync(&freezer->reclaim_work);
+#endif
+	kfree(freezer);
 }
 
 /*
@@ -242,6 +273,24 @@ out:
 	rcu_read_unlock();
 }
 
+/*
+ * @freezer has just become FROZEN, called with @freezer->lock held.  Wake
+ * up the eventfd waiters and start pushing the group's memory out if
+ * asked to.
+ */
+static void freezer_frozen_notify(struct freezer *freezer)
+{
+	struct freezer_event *ev;
+
+	list_for_each_entry(ev, &freezer->events, list)
+		eventfd_signal(ev->eventfd, 1);
+
+#ifdef CONFIG_PROCESS_RECLAIM
+	if (freezer->reclaim_on_freeze)
+		queue_work(system_unbound_wq, &freezer->reclaim_work);
+#endif
+}
+
 /**
  * update_if_frozen - update whether a cgroup finished freezing
  * @cgroup: cgroup of interest
@@ -299,6 +348,7 @@ static void update_if_frozen(struct cgroup *cgroup)
 	}
 
 	freezer->state |= CGROUP_FROZEN;
+	freezer_frozen_notify(freezer);
 out_iter_end:
 	cgroup_iter_end(cgroup, &it);
 out_unlock:
@@ -324,6 +374,97 @@ static int freezer_read(struct cgroup *cgroup, struct cftype *cft,
 	return 0;
 }
 
+/*
+ * Run from a task of a FREEZING cgroup entering the refrigerator, so that
+ * the transition to FROZEN is noticed without anyone polling
+ * freezer.state.  All the tasks of a group freezing at about the same time
+ * share one pending work item.
+ */
+static void freezer_frozen_workfn(struct work_struct *work)
+{
+	struct freezer *freezer = container_of(work, struct freezer,
+					       frozen_work);
+	struct freezer *parent;
+	struct cgroup *pos;
+
+	rcu_read_lock();
+
+	/* ancestors may complete too, update from the topmost freezing one */
+	while ((parent = parent_freezer(freezer)) &&
+	       (parent->state & CGROUP_FREEZING))
+		freezer = parent;
+
+	cgroup_for_each_descendant_post(pos, freezer->css.cgroup)
+		update_if_frozen(pos);
+	update_if_frozen(freezer->css.cgroup);
+
+	rcu_read_unlock();
+}
+
+void cgroup_freezer_frozen(struct task_struct *task)
+{
+	struct freezer *freezer;
+
+	rcu_read_lock();
+	freezer = task_freezer(task);
+	if ((freezer->state & CGROUP_FREEZING) &&
+	    !(freezer->state & CGROUP_FROZEN))
+		schedule_work(&freezer->frozen_work);
+	rcu_read_unlock();
+}
+
+#ifdef CONFIG_PROCESS_RECLAIM
+/*
+ * Swap out the anonymous memory of every process in a frozen cgroup.  The
+ * mms are collected first since reclaim sleeps and the task iterator may
+ * not.  Processes attached later are left alone; thawing stops the walk.
+ */
+static void freezer_reclaim_workfn(struct work_struct *work)
+{
+	struct freezer *freezer = container_of(work, struct freezer,
+					       reclaim_work);
+	struct cgroup *cgroup = freezer->css.cgroup;
+	struct cgroup_iter it;
+	struct task_struct *task;
+	struct mm_struct **mms;
+	int i, nr = 0, max = cgroup_task_count(cgroup);
+
+	mms = kcalloc(max, sizeof(*mms), GFP_KERNEL);
+	if (!mms)
+		return;
+
+	cgroup_iter_start(cgroup, &it);
+	while ((task = cgroup_iter_next(cgroup, &it)) && nr < max) {
+		if (!thread_group_leader(task))
+			continue;
+		mms[nr] = get_task_mm(task);
+		if (mms[nr])
+			nr++;
+	}
+	cgroup_iter_end(cgroup, &it);
+
+	for (i = 0; i < nr; i++) {
+		if (ACCESS_ONCE(freezer->state) & CGROUP_FROZEN)
+			reclaim_mm_anon(mms[i]);
+		mmput(mms[i]);
+	}
+	kfree(mms);
+}
+
+static u64 freezer_reclaim_on_freeze_read(struct cgroup *cgroup,
+					  struct cftype *cft)
+{
+	return cgroup_freezer(cgroup)->reclaim_on_freeze;
+}
+
+static int freezer_reclaim_on_freeze_write(struct cgroup *cgroup,
+					   struct cftype *cft, u64 val)
+{
+	cgroup_freezer(cgroup)->reclaim_on_freeze = !!val;
+	return 0;
+}
+#endif
+
 static void freeze_cgroup(struct freezer *freezer)
 {
 	struct cgroup *cgroup = freezer->css.cgroup;
@@ -441,6 +582,46 @@ static int freezer_write(struct cgroup *cgroup, struct cftype *cft,
 	return 0;
 }
 
+static int freezer_register_event(struct cgroup *cgroup, struct cftype *cft,
+				  struct eventfd_ctx *eventfd, const char *args)
+{
+	struct freezer *freezer = cgroup_freezer(cgroup);
+	struct freezer_event *ev;
+
+	ev = kmalloc(sizeof(*ev), GFP_KERNEL);
+	if (!ev)
+		return -ENOMEM;
+	ev->eventfd = eventfd;
+
+	spin_lock_irq(&freezer->lock);
+	list_add(&ev->list, &freezer->events);
+	/* FROZEN is updated lazily, recheck in case we just got there */
+	if (freezer->state & CGROUP_FROZEN)
+		eventfd_signal(eventfd, 1);
+	else if (freezer->state & CGROUP_FREEZING)
+		schedule_work(&freezer->frozen_work);
+	spin_unlock_irq(&freezer->lock);
+
+	return 0;
+}
+
+static void freezer_unregister_event(struct cgroup *cgroup,
+				     struct cftype *cft,
+				     struct eventfd_ctx *eventfd)
+{
+	struct freezer *freezer = cgroup_freezer(cgroup);
+	struct freezer_event *ev, *tmp;
+
+	spin_lock_irq(&freezer->lock);
+	list_for_each_entry_safe(ev, tmp, &freezer->events, list) {
+		if (ev->eventfd == eventfd) {
+			list_del(&ev->list);
+			kfree(ev);
+		}
+	}
+	spin_unlock_irq(&freezer->lock);
+}
+
 static u64 freezer_self_freezing_read(struct cgroup *cgroup, struct cftype *cft)
 {
 	struct freezer *freezer = cgroup_freezer(cgroup);
@@ -461,6 +642,8 @@ static struct cftype files[] = {
 		.flags = CFTYPE_NOT_ON_ROOT,
 		.read_seq_string = freezer_read,
 		.write_string = freezer_write,
+		.register_event = freezer_register_event,
+		.unregister_event = freezer_unregister_event,
 	},
 	{
 		.name = "self_freezing",
@@ -472,6 +655,14 @@ static struct cftype files[] = {
 		.flags = CFTYPE_NOT_ON_ROOT,
 		.read_u64 = freezer_parent_freezing_read,
 	},
+#ifdef CONFIG_PROCESS_RECLAIM
+	{
+		.name = "reclaim_on_freeze",
+		.flags = CFTYPE_NOT_ON_ROOT,
+		.read_u64 = freezer_reclaim_on_freeze_read,
+		.write_u64 = freezer_reclaim_on_freeze_write,
+	},
+#endif
 	{ }	/* terminate */
 };
 
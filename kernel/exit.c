@@ -53,6 +53,7 @@
 #include <linux/oom.h>
 #include <linux/writeback.h>
 #include <linux/shm.h>
+#include <linux/cpufreq_times.h>
 
 #include <asm/uaccess.h>
 #include <asm/unistd.h>
@@ -70,6 +71,7 @@ static void __unhash_process(struct task_struct *p, bool group_dead)
 		detach_pid(p, PIDTYPE_SID);
 
 		list_del_rcu(&p->tasks);
+		lowmem_adj_tree_remove(p);
 		list_del_init(&p->sibling);
 		__this_cpu_dec(process_counts);
 	}
@@ -204,6 +206,7 @@ repeat:
 	}
 
 	write_unlock_irq(&tasklist_lock);
+	cpufreq_task_times_exit(p);
 	release_thread(p);
 	call_rcu(&p->rcu, delayed_put_task_struct);
 
@@ -503,8 +506,10 @@ static void exit_mm(struct task_struct * tsk)
 	mm_update_next_owner(mm);
 
 	mm_released = mmput(mm);
-	if (mm_released)
+	if (mm_released) {
 		set_tsk_thread_flag(tsk, TIF_MM_RELEASED);
+		lowmem_mm_released(tsk);
+	}
 }
 
 /*
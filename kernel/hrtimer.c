@@ -836,7 +836,9 @@ static inline void timer_stats_account_hrtimer(struct hrtimer *timer)
 	if (likely(!timer_stats_active))
 		return;
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
-				 timer->function, timer->start_comm, 0);
+				 timer->function, timer->start_comm,
+				 is_idle_task(current) ?
+				 TIMER_STATS_FLAG_WAKEUP : 0);
 #endif
 }
 
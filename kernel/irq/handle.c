@@ -134,6 +134,7 @@ handle_irq_event_percpu(struct irq_desc *desc, struct irqaction *action)
 {
 	irqreturn_t retval = IRQ_NONE;
 	unsigned int flags = 0, irq = desc->irq_data.irq;
+	u64 start = irq_stats_start();
 
 	do {
 		irqreturn_t res;
@@ -172,6 +173,7 @@ handle_irq_event_percpu(struct irq_desc *desc, struct irqaction *action)
 		action = action->next;
 	} while (action);
 
+	irq_stats_account_hard(desc, start);
 	add_interrupt_randomness(irq, flags);
 
 	if (!noirqdebug)
@@ -58,6 +58,30 @@ enum {
 #include "debug.h"
 #include "settings.h"
 
+#ifdef CONFIG_IRQ_STATS
+#include <linux/sched.h>
+
+extern void irq_stats_alloc(struct irq_desc *desc);
+extern void irq_stats_free(struct irq_desc *desc);
+extern void irq_stats_reset(struct irq_desc *desc);
+extern void irq_stats_account_hard(struct irq_desc *desc, u64 start);
+extern void irq_stats_account_thread(struct irq_desc *desc, u64 start);
+extern void irq_stats_show(struct seq_file *m, struct irq_desc *desc);
+
+static inline u64 irq_stats_start(void)
+{
+	return sched_clock();
+}
+#else
+static inline void irq_stats_alloc(struct irq_desc *desc) { }
+static inline void irq_stats_free(struct irq_desc *desc) { }
+static inline void irq_stats_reset(struct irq_desc *desc) { }
+static inline void irq_stats_account_hard(struct irq_desc *desc, u64 start) { }
+static inline void
+irq_stats_account_thread(struct irq_desc *desc, u64 start) { }
+static inline u64 irq_stats_start(void) { return 0; }
+#endif
+
 #define irq_data_to_desc(data)	container_of(data, struct irq_desc, irq_data)
 
 extern int __irq_set_trigger(struct irq_desc *desc, unsigned int irq,
@@ -883,10 +883,13 @@ static int irq_thread(void *data)
 
 	while (!irq_wait_for_interrupt(action)) {
 		irqreturn_t action_ret;
+		u64 start;
 
 		irq_thread_check_affinity(desc, action);
 
+		start = irq_stats_start();
 		action_ret = handler_fn(desc, action);
+		irq_stats_account_thread(desc, start);
 		if (action_ret == IRQ_HANDLED)
 			atomic_inc(&desc->threads_handled);
 
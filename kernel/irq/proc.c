@@ -286,6 +286,26 @@ static const struct file_operations irq_wake_depth_proc_fops = {
 	.release	= single_release,
 };
 
+#ifdef CONFIG_IRQ_STATS
+static int irq_stats_proc_show(struct seq_file *m, void *v)
+{
+	irq_stats_show(m, irq_to_desc((long) m->private));
+	return 0;
+}
+
+static int irq_stats_proc_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, irq_stats_proc_show, PDE_DATA(inode));
+}
+
+static const struct file_operations irq_stats_proc_fops = {
+	.open		= irq_stats_proc_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+#endif
+
 static int irq_disable_depth_proc_show(struct seq_file *m, void *v)
 {
 	struct irq_desc *desc = irq_to_desc((long) m->private);
@@ -384,6 +404,10 @@ void register_irq_proc(unsigned int irq, struct irq_desc *desc)
 			 &irq_disable_depth_proc_fops, (void *)(long)irq);
 	proc_create_data("wake_depth", 0444, desc->dir,
 			 &irq_wake_depth_proc_fops, (void *)(long)irq);
+#ifdef CONFIG_IRQ_STATS
+	proc_create_data("stats", 0444, desc->dir,
+			 &irq_stats_proc_fops, (void *)(long)irq);
+#endif
 }
 
 void unregister_irq_proc(unsigned int irq, struct irq_desc *desc)
@@ -399,6 +423,9 @@ void unregister_irq_proc(unsigned int irq, struct irq_desc *desc)
 	remove_proc_entry("node", desc->dir);
 #endif
 	remove_proc_entry("spurious", desc->dir);
+#ifdef CONFIG_IRQ_STATS
+	remove_proc_entry("stats", desc->dir);
+#endif
 
 	memset(name, 0, MAX_NAMELEN);
 	sprintf(name, "%u", irq);
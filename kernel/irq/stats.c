@@ -0,0 +1,145 @@
+/*
+ * linux/kernel/irq/stats.c
+ *
+ * Per interrupt handler time and rate accounting, shown in
+ * /proc/irq/<irq>/stats.
+ *
+ * Each cpu accumulates into its own slot, so the hard interrupt path only
+ * touches local data with interrupts disabled.  The threaded handler part
+ * is charged to the cpu it finished on.  Readers sum the slots without
+ * locking and may see a torn 64-bit value on 32-bit machines.
+ */
+
+#include <linux/irq.h>
+#include <linux/kernel_stat.h>
+#include <linux/percpu.h>
+#include <linux/seq_file.h>
+#include <linux/sched.h>
+
+#include "internals.h"
+
+/* interrupts are counted per window, windows then go into log2 buckets */
+#define IRQ_STATS_WINDOW_NS	(100 * NSEC_PER_MSEC)
+#define IRQ_STATS_RATE_BUCKETS	8
+
+struct irq_stats {
+	u64	hard_time;
+	u64	thread_time;
+	u32	hard_max;
+	u32	thread_max;
+	u32	thread_count;
+	u32	window_count;
+	u64	window_start;
+	u32	rate_hist[IRQ_STATS_RATE_BUCKETS];
+};
+
+void irq_stats_alloc(struct irq_desc *desc)
+{
+	desc->stats = alloc_percpu(struct irq_stats);
+}
+
+void irq_stats_free(struct irq_desc *desc)
+{
+	free_percpu(desc->stats);
+	desc->stats = NULL;
+}
+
+void irq_stats_reset(struct irq_desc *desc)
+{
+	int cpu;
+
+	if (!desc->stats)
+		return;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(desc->stats, cpu), 0,
+		       sizeof(struct irq_stats));
+}
+
+static inline u32 irq_stats_clamp(u64 delta)
+{
+	return delta > U32_MAX ? U32_MAX : delta;
+}
+
+/* Called with interrupts disabled after the primary handlers have run */
+void irq_stats_account_hard(struct irq_desc *desc, u64 start)
+{
+	struct irq_stats *st;
+	u64 now = sched_clock();
+	u32 delta = irq_stats_clamp(now - start);
+
+	if (unlikely(!desc->stats))
+		return;
+
+	st = this_cpu_ptr(desc->stats);
+	st->hard_time += delta;
+	if (delta > st->hard_max)
+		st->hard_max = delta;
+
+	if (now - st->window_start >= IRQ_STATS_WINDOW_NS) {
+		if (st->window_count)
+			st->rate_hist[min(fls(st->window_count) - 1,
+					  IRQ_STATS_RATE_BUCKETS - 1)]++;
+		st->window_start = now;
+		st->window_count = 0;
+	}
+	st->window_count++;
+}
+
+/* Called from the irq thread after the threaded handler has run */
+void irq_stats_account_thread(struct irq_desc *desc, u64 start)
+{
+	struct irq_stats *st;
+	u32 delta = irq_stats_clamp(sched_clock() - start);
+
+	if (unlikely(!desc->stats))
+		return;
+
+	st = get_cpu_ptr(desc->stats);
+	st->thread_time += delta;
+	if (delta > st->thread_max)
+		st->thread_max = delta;
+	st->thread_count++;
+	put_cpu_ptr(desc->stats);
+}
+
+void irq_stats_show(struct seq_file *m, struct irq_desc *desc)
+{
+	struct irq_stats sum = { };
+	int cpu, i;
+
+	if (!desc->stats)
+		return;
+
+	for_each_possible_cpu(cpu) {
+		struct irq_stats *st = per_cpu_ptr(desc->stats, cpu);
+
+		sum.hard_time += st->hard_time;
+		sum.thread_time += st->thread_time;
+		sum.hard_max = max(sum.hard_max, st->hard_max);
+		sum.thread_max = max(sum.thread_max, st->thread_max);
+		sum.thread_count += st->thread_count;
+		for (i = 0; i < IRQ_STATS_RATE_BUCKETS; i++)
+			sum.rate_hist[i] += st->rate_hist[i];
+	}
+
+	seq_printf(m, "count %u\n", kstat_irqs(desc->irq_data.irq));
+	seq_printf(m, "hardirq_ns %llu\nhardirq_max_ns %u\n",
+		   sum.hard_time, sum.hard_max);
+	seq_printf(m, "thread_count %u\nthread_ns %llu\nthread_max_ns %u\n",
+		   sum.thread_count, sum.thread_time, sum.thread_max);
+
+	seq_printf(m, "rate_per_%ldms", IRQ_STATS_WINDOW_NS / NSEC_PER_MSEC);
+	for (i = 0; i < IRQ_STATS_RATE_BUCKETS; i++)
+		seq_printf(m, " %u%s:%u", 1 << i,
+			   i == IRQ_STATS_RATE_BUCKETS - 1 ? "+" : "",
+			   sum.rate_hist[i]);
+	seq_putc(m, '\n');
+
+	for_each_possible_cpu(cpu) {
+		struct irq_stats *st = per_cpu_ptr(desc->stats, cpu);
+
+		seq_printf(m, "cpu%d hardirq_ns %llu thread_ns %llu\n", cpu,
+			   st->hard_time, st->thread_time);
+	}
+}
@@ -9,6 +9,7 @@
 #include <linux/device.h>
 #include <linux/mutex.h>
 #include <linux/pm_wakeup.h>
+#include <linux/wakeup_reason.h>
 
 #include "power.h"
 
@@ -23,9 +24,34 @@ static struct workqueue_struct *autosleep_wq;
 static DEFINE_MUTEX(autosleep_lock);
 static struct wakeup_source *autosleep_ws;
 
+/*
+ * After repeated aborted suspend attempts, wait before the next one,
+ * doubling the delay from AUTOSLEEP_BACKOFF_MIN_MS up to
+ * AUTOSLEEP_BACKOFF_MAX_MS, so that bursts of wakeup events do not turn
+ * into back to back freeze/thaw cycles.
+ */
+#define AUTOSLEEP_BACKOFF_MIN_MS	20
+#define AUTOSLEEP_BACKOFF_MAX_MS	1000
+
+static unsigned int autosleep_aborts;
+
+static void autosleep_backoff(void)
+{
+	unsigned int ms = AUTOSLEEP_BACKOFF_MAX_MS;
+
+	if (autosleep_aborts < 2)
+		return;
+	if (autosleep_aborts - 2 < ilog2(AUTOSLEEP_BACKOFF_MAX_MS))
+		ms = min(AUTOSLEEP_BACKOFF_MIN_MS << (autosleep_aborts - 2),
+			 AUTOSLEEP_BACKOFF_MAX_MS);
+	schedule_timeout_uninterruptible(msecs_to_jiffies(ms));
+}
+
 static void try_to_suspend(struct work_struct *work)
 {
+	char reason[MAX_SUSPEND_ABORT_LEN];
 	unsigned int initial_count, final_count;
+	int error;
 
 	if (!pm_get_wakeup_count(&initial_count, true))
 		goto out;
@@ -42,13 +68,35 @@ static void try_to_suspend(struct work_struct *work)
 		mutex_unlock(&autosleep_lock);
 		return;
 	}
+
+	/*
+	 * A wakeup event that arrived since the count was saved would only
+	 * abort the suspend after the filesystems were synced and the tasks
+	 * frozen.  Checking it here is much cheaper.
+	 */
+	if (pm_wakeup_pending()) {
+		mutex_unlock(&autosleep_lock);
+		pm_get_active_wakeup_sources(reason, sizeof(reason));
+		log_autosleep_abort_reason(reason);
+		autosleep_aborts++;
+		autosleep_backoff();
+		goto out;
+	}
+
 	if (autosleep_state >= PM_SUSPEND_MAX)
-		hibernate();
+		error = hibernate();
 	else
-		pm_suspend(autosleep_state);
+		error = pm_suspend(autosleep_state);
 
 	mutex_unlock(&autosleep_lock);
 
+	if (error) {
+		autosleep_aborts++;
+		autosleep_backoff();
+		goto out;
+	}
+	autosleep_aborts = 0;
+
 	if (!pm_get_wakeup_count(&final_count, false))
 		goto out;
 
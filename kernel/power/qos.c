@@ -41,6 +41,8 @@
 #include <linux/platform_device.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 
 #include <linux/uaccess.h>
 #include <linux/export.h>
@@ -61,12 +63,16 @@ static DEFINE_SPINLOCK(pm_qos_lock);
 static struct pm_qos_object null_pm_qos;
 
 static BLOCKING_NOTIFIER_HEAD(cpu_dma_lat_notifier);
+static s32 cpu_dma_target_per_cpu[NR_CPUS] = {
+	[0 ... NR_CPUS - 1] = PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE,
+};
 static struct pm_qos_constraints cpu_dma_constraints = {
 	.list = PLIST_HEAD_INIT(cpu_dma_constraints.list),
 	.target_value = PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE,
 	.default_value = PM_QOS_CPU_DMA_LAT_DEFAULT_VALUE,
 	.type = PM_QOS_MIN,
 	.notifiers = &cpu_dma_lat_notifier,
+	.target_per_cpu = cpu_dma_target_per_cpu,
 };
 static struct pm_qos_object cpu_dma_pm_qos = {
 	.constraints = &cpu_dma_constraints,
@@ -153,6 +159,51 @@ static inline void pm_qos_set_value(struct pm_qos_constraints *c, s32 value)
 	c->target_value = value;
 }
 
+/*
+ * Recompute the per-cpu targets of a class whose list holds struct
+ * pm_qos_request nodes. Returns true if any of them changed.
+ */
+static bool pm_qos_set_value_for_cpus(struct pm_qos_constraints *c)
+{
+	struct pm_qos_request *req;
+	s32 qos_val[NR_CPUS];
+	bool changed = false;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		qos_val[cpu] = c->default_value;
+
+	plist_for_each_entry(req, &c->list, node) {
+		const struct cpumask *mask = cpu_possible_mask;
+
+		if (req->type == PM_QOS_REQ_AFFINE_CORES)
+			mask = &req->cpus_affine;
+
+		for_each_cpu(cpu, mask) {
+			switch (c->type) {
+			case PM_QOS_MIN:
+				if (req->node.prio < qos_val[cpu])
+					qos_val[cpu] = req->node.prio;
+				break;
+			case PM_QOS_MAX:
+				if (req->node.prio > qos_val[cpu])
+					qos_val[cpu] = req->node.prio;
+				break;
+			default:
+				BUG();
+			}
+		}
+	}
+
+	for_each_possible_cpu(cpu) {
+		if (c->target_per_cpu[cpu] != qos_val[cpu])
+			changed = true;
+		c->target_per_cpu[cpu] = qos_val[cpu];
+	}
+
+	return changed;
+}
+
 /**
  * pm_qos_update_target - manages the constraints list and calls the notifiers
  *  if needed
@@ -169,6 +220,7 @@ int pm_qos_update_target(struct pm_qos_constraints *c, struct plist_node *node,
 {
 	unsigned long flags;
 	int prev_value, curr_value, new_value;
+	bool cpus_changed = false;
 
 	spin_lock_irqsave(&pm_qos_lock, flags);
 	prev_value = pm_qos_get_value(c);
@@ -199,17 +251,17 @@ int pm_qos_update_target(struct pm_qos_constraints *c, struct plist_node *node,
 
 	curr_value = pm_qos_get_value(c);
 	pm_qos_set_value(c, curr_value);
+	if (c->target_per_cpu)
+		cpus_changed = pm_qos_set_value_for_cpus(c);
 
 	spin_unlock_irqrestore(&pm_qos_lock, flags);
 
-	if (prev_value != curr_value) {
+	if (prev_value != curr_value || cpus_changed)
 		blocking_notifier_call_chain(c->notifiers,
 					     (unsigned long)curr_value,
 					     NULL);
-		return 1;
-	} else {
-		return 0;
-	}
+
+	return prev_value != curr_value;
 }
 
 /**
@@ -287,6 +339,47 @@ int pm_qos_request(int pm_qos_class)
 }
 EXPORT_SYMBOL_GPL(pm_qos_request);
 
+/**
+ * pm_qos_request_for_cpu - returns the qos expectation for one cpu
+ * @pm_qos_class: identification of which qos value is requested
+ * @cpu: cpu the value applies to
+ *
+ * Unlike pm_qos_request(), this leaves out requests affine to other cpus.
+ * Classes that do not keep per-cpu targets return the system wide value.
+ */
+int pm_qos_request_for_cpu(int pm_qos_class, int cpu)
+{
+	struct pm_qos_constraints *c = pm_qos_array[pm_qos_class]->constraints;
+
+	if (!c->target_per_cpu)
+		return pm_qos_read_value(c);
+	return c->target_per_cpu[cpu];
+}
+EXPORT_SYMBOL_GPL(pm_qos_request_for_cpu);
+
+/**
+ * pm_qos_request_for_cpumask - returns the qos expectation for some cpus
+ * @pm_qos_class: identification of which qos value is requested
+ * @mask: cpus the value must satisfy
+ */
+int pm_qos_request_for_cpumask(int pm_qos_class, const struct cpumask *mask)
+{
+	struct pm_qos_constraints *c = pm_qos_array[pm_qos_class]->constraints;
+	int cpu, val = c->default_value;
+
+	if (!c->target_per_cpu)
+		return pm_qos_read_value(c);
+
+	for_each_cpu(cpu, mask) {
+		if (c->type == PM_QOS_MIN)
+			val = min(val, c->target_per_cpu[cpu]);
+		else
+			val = max(val, c->target_per_cpu[cpu]);
+	}
+	return val;
+}
+EXPORT_SYMBOL_GPL(pm_qos_request_for_cpumask);
+
 int pm_qos_request_active(struct pm_qos_request *req)
 {
 	return req->pm_qos_class != 0;
@@ -340,6 +433,10 @@ void pm_qos_add_request(struct pm_qos_request *req,
 		WARN(1, KERN_ERR "pm_qos_add_request() called for already added request\n");
 		return;
 	}
+	if (req->type != PM_QOS_REQ_AFFINE_CORES ||
+	    cpumask_empty(&req->cpus_affine))
+		req->type = PM_QOS_REQ_ALL_CORES;
+	req->owner = __builtin_return_address(0);
 	req->pm_qos_class = pm_qos_class;
 	INIT_DELAYED_WORK(&req->work, pm_qos_work_fn);
 	pm_qos_update_target(pm_qos_array[pm_qos_class]->constraints,
@@ -582,6 +679,72 @@ static ssize_t pm_qos_power_write(struct file *filp, const char __user *buf,
 }
 
 
+#ifdef CONFIG_DEBUG_FS
+/*
+ * List every request of a class with its owner, marking the ones that
+ * currently set the system wide target with '*'.
+ */
+static int pm_qos_debug_show(struct seq_file *s, void *unused)
+{
+	struct pm_qos_object *qos = s->private;
+	struct pm_qos_constraints *c = qos->constraints;
+	struct pm_qos_request *req;
+	unsigned long flags;
+	int cpu;
+
+	spin_lock_irqsave(&pm_qos_lock, flags);
+
+	seq_printf(s, "target: %d\n", c->target_value);
+	if (c->target_per_cpu)
+		for_each_possible_cpu(cpu)
+			seq_printf(s, "cpu%d: %d\n", cpu,
+				   c->target_per_cpu[cpu]);
+
+	plist_for_each_entry(req, &c->list, node) {
+		seq_printf(s, "%c %10d ",
+			   req->node.prio == c->target_value ? '*' : ' ',
+			   req->node.prio);
+		if (req->type == PM_QOS_REQ_AFFINE_CORES)
+			seq_cpumask_list(s, &req->cpus_affine);
+		else
+			seq_puts(s, "all");
+		seq_printf(s, " %pf\n", req->owner);
+	}
+
+	spin_unlock_irqrestore(&pm_qos_lock, flags);
+
+	return 0;
+}
+
+static int pm_qos_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, pm_qos_debug_show, inode->i_private);
+}
+
+static const struct file_operations pm_qos_debug_fops = {
+	.open		= pm_qos_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static void __init pm_qos_debugfs_init(void)
+{
+	struct dentry *d;
+	int i;
+
+	d = debugfs_create_dir("pm_qos", NULL);
+	if (!d)
+		return;
+
+	for (i = 1; i < PM_QOS_NUM_CLASSES; i++)
+		debugfs_create_file(pm_qos_array[i]->name, S_IRUGO, d,
+				    pm_qos_array[i], &pm_qos_debug_fops);
+}
+#else
+static inline void pm_qos_debugfs_init(void) { }
+#endif
+
 static int __init pm_qos_power_init(void)
 {
 	int ret = 0;
@@ -589,6 +752,8 @@ static int __init pm_qos_power_init(void)
 
 	BUILD_BUG_ON(ARRAY_SIZE(pm_qos_array) != PM_QOS_NUM_CLASSES);
 
+	pm_qos_debugfs_init();
+
 	for (i = 1; i < PM_QOS_NUM_CLASSES; i++) {
 		ret = register_pm_qos_misc(pm_qos_array[i]);
 		if (ret < 0) {
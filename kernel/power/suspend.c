@@ -126,6 +126,7 @@ static int suspend_test(int level)
  */
 static int suspend_prepare(suspend_state_t state)
 {
+	u64 start;
 	int error;
 
 	if (need_suspend_ops(state) && (!suspend_ops || !suspend_ops->enter))
@@ -137,7 +138,9 @@ static int suspend_prepare(suspend_state_t state)
 	if (error)
 		goto Finish;
 
+	start = suspend_time_phase_begin(SUSPEND_PHASE_FREEZE);
 	error = suspend_freeze_processes();
+	suspend_time_phase_end(SUSPEND_PHASE_FREEZE, start);
 	if (!error)
 		return 0;
 	log_suspend_abort_reason("One or more tasks refusing to freeze");
@@ -172,6 +175,7 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 {
 	char suspend_abort[MAX_SUSPEND_ABORT_LEN];
 	int error, last_dev;
+	u64 start;
 
 	if (need_suspend_ops(state) && suspend_ops->prepare) {
 		error = suspend_ops->prepare();
@@ -218,7 +222,9 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 	arch_suspend_disable_irqs();
 	BUG_ON(!irqs_disabled());
 
+	start = suspend_time_phase_begin(SUSPEND_PHASE_SYSCORE_SUSPEND);
 	error = syscore_suspend();
+	suspend_time_phase_end(SUSPEND_PHASE_SYSCORE_SUSPEND, start);
 	if (!error) {
 		*wakeup = pm_wakeup_pending();
 		if (!(suspend_test(TEST_CORE) || *wakeup)) {
@@ -230,7 +236,9 @@ static int suspend_enter(suspend_state_t state, bool *wakeup)
 			log_suspend_abort_reason(suspend_abort);
 			error = -EBUSY;
 		}
+		start = suspend_time_phase_begin(SUSPEND_PHASE_SYSCORE_RESUME);
 		syscore_resume();
+		suspend_time_phase_end(SUSPEND_PHASE_SYSCORE_RESUME, start);
 	}
 
 	arch_suspend_enable_irqs();
@@ -314,7 +322,11 @@ int suspend_devices_and_enter(suspend_state_t state)
  */
 static void suspend_finish(void)
 {
+	u64 start;
+
+	start = suspend_time_phase_begin(SUSPEND_PHASE_THAW);
 	suspend_thaw_processes();
+	suspend_time_phase_end(SUSPEND_PHASE_THAW, start);
 	pm_notifier_call_chain(PM_POST_SUSPEND);
 	pm_restore_console();
 }
@@ -353,6 +365,7 @@ static int enter_state(suspend_state_t state)
 	printk("done.\n");
 
 	pr_debug("PM: Preparing system for %s sleep\n", pm_states[state].label);
+	suspend_time_begin();
 	error = suspend_prepare(state);
 	if (error)
 		goto Unlock;
@@ -369,6 +382,7 @@ static int enter_state(suspend_state_t state)
 	pr_debug("PM: Finishing wakeup.\n");
 	suspend_finish();
  Unlock:
+	suspend_time_end(error);
 	mutex_unlock(&pm_mutex);
 	return error;
 }
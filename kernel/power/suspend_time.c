@@ -15,16 +15,150 @@
  */
 
 #include <linux/debugfs.h>
+#include <linux/device.h>
 #include <linux/err.h>
 #include <linux/init.h>
 #include <linux/kernel.h>
+#include <linux/sched.h>
 #include <linux/seq_file.h>
+#include <linux/sort.h>
+#include <linux/spinlock.h>
+#include <linux/string.h>
+#include <linux/suspend.h>
 #include <linux/syscore_ops.h>
 #include <linux/time.h>
 
 static struct timespec suspend_time_before;
 static unsigned int time_in_suspend_bins[32];
 
+/*
+ * Profile of the last SUSPEND_PROFILE_CYCLES suspend/resume cycles: the
+ * time spent in each phase and the slowest device callbacks.  Times come
+ * from local_clock(), which keeps working once timekeeping is suspended.
+ */
+#define SUSPEND_PROFILE_CYCLES	16
+#define SUSPEND_PROFILE_DEVS	8
+
+struct suspend_profile_dev {
+	char name[32];
+	enum suspend_phase phase;
+	u32 usecs;
+};
+
+struct suspend_profile {
+	unsigned int seq;
+	int error;
+	struct timespec slept;
+	u32 phase_usecs[SUSPEND_PHASE_COUNT];
+	struct suspend_profile_dev devs[SUSPEND_PROFILE_DEVS];
+};
+
+static const char * const suspend_phase_names[SUSPEND_PHASE_COUNT] = {
+	[SUSPEND_PHASE_FREEZE]		= "freeze",
+	[SUSPEND_PHASE_PREPARE]		= "prepare",
+	[SUSPEND_PHASE_SUSPEND]		= "suspend",
+	[SUSPEND_PHASE_SUSPEND_LATE]	= "suspend_late",
+	[SUSPEND_PHASE_SUSPEND_NOIRQ]	= "suspend_noirq",
+	[SUSPEND_PHASE_SYSCORE_SUSPEND]	= "syscore_suspend",
+	[SUSPEND_PHASE_SYSCORE_RESUME]	= "syscore_resume",
+	[SUSPEND_PHASE_RESUME_NOIRQ]	= "resume_noirq",
+	[SUSPEND_PHASE_RESUME_EARLY]	= "resume_early",
+	[SUSPEND_PHASE_RESUME]		= "resume",
+	[SUSPEND_PHASE_COMPLETE]	= "complete",
+	[SUSPEND_PHASE_THAW]		= "thaw",
+};
+
+static DEFINE_SPINLOCK(suspend_profile_lock);
+static struct suspend_profile suspend_profiles[SUSPEND_PROFILE_CYCLES];
+static unsigned int suspend_profile_seq;
+/* cycle being recorded, NULL outside of suspend (and during hibernation) */
+static struct suspend_profile *suspend_profile_cur;
+static enum suspend_phase suspend_profile_phase;
+
+static u32 suspend_time_usecs(u64 start)
+{
+	u64 delta = local_clock() - start;
+
+	do_div(delta, NSEC_PER_USEC);
+	return min_t(u64, delta, U32_MAX);
+}
+
+u64 suspend_time_now(void)
+{
+	return local_clock();
+}
+
+void suspend_time_begin(void)
+{
+	struct suspend_profile *prof;
+	unsigned long flags;
+
+	spin_lock_irqsave(&suspend_profile_lock, flags);
+	prof = &suspend_profiles[suspend_profile_seq % SUSPEND_PROFILE_CYCLES];
+	memset(prof, 0, sizeof(*prof));
+	prof->seq = ++suspend_profile_seq;
+	suspend_profile_cur = prof;
+	spin_unlock_irqrestore(&suspend_profile_lock, flags);
+}
+
+void suspend_time_end(int error)
+{
+	unsigned long flags;
+
+	spin_lock_irqsave(&suspend_profile_lock, flags);
+	if (suspend_profile_cur)
+		suspend_profile_cur->error = error;
+	suspend_profile_cur = NULL;
+	spin_unlock_irqrestore(&suspend_profile_lock, flags);
+}
+
+u64 suspend_time_phase_begin(enum suspend_phase phase)
+{
+	suspend_profile_phase = phase;
+	return local_clock();
+}
+
+void suspend_time_phase_end(enum suspend_phase phase, u64 start)
+{
+	u32 usecs = suspend_time_usecs(start);
+	unsigned long flags;
+
+	spin_lock_irqsave(&suspend_profile_lock, flags);
+	/* phases repeat when the platform asks to suspend again */
+	if (suspend_profile_cur)
+		suspend_profile_cur->phase_usecs[phase] += usecs;
+	spin_unlock_irqrestore(&suspend_profile_lock, flags);
+}
+
+/*
+ * Called after each device callback; may run concurrently for devices
+ * that suspend and resume asynchronously.
+ */
+void suspend_time_device(struct device *dev, u64 start)
+{
+	u32 usecs = suspend_time_usecs(start);
+	struct suspend_profile_dev *slot;
+	unsigned long flags;
+	int i;
+
+	spin_lock_irqsave(&suspend_profile_lock, flags);
+	if (!suspend_profile_cur)
+		goto out;
+
+	slot = &suspend_profile_cur->devs[0];
+	for (i = 1; i < SUSPEND_PROFILE_DEVS; i++)
+		if (suspend_profile_cur->devs[i].usecs < slot->usecs)
+			slot = &suspend_profile_cur->devs[i];
+	if (usecs <= slot->usecs)
+		goto out;
+
+	strlcpy(slot->name, dev_name(dev), sizeof(slot->name));
+	slot->phase = suspend_profile_phase;
+	slot->usecs = usecs;
+out:
+	spin_unlock_irqrestore(&suspend_profile_lock, flags);
+}
+
 #ifdef CONFIG_DEBUG_FS
 static int suspend_time_debug_show(struct seq_file *s, void *data)
 {
@@ -53,6 +187,64 @@ static const struct file_operations suspend_time_debug_fops = {
 	.release	= single_release,
 };
 
+static int suspend_dev_cmp(const void *a, const void *b)
+{
+	const struct suspend_profile_dev *da = a, *db = b;
+
+	return (db->usecs > da->usecs) - (db->usecs < da->usecs);
+}
+
+static int suspend_profile_debug_show(struct seq_file *s, void *data)
+{
+	struct suspend_profile prof;
+	unsigned long flags;
+	unsigned int seq, last;
+	int i;
+
+	spin_lock_irqsave(&suspend_profile_lock, flags);
+	last = suspend_profile_seq;
+	spin_unlock_irqrestore(&suspend_profile_lock, flags);
+
+	seq = last > SUSPEND_PROFILE_CYCLES ? last - SUSPEND_PROFILE_CYCLES : 0;
+	for (seq++; seq <= last; seq++) {
+		spin_lock_irqsave(&suspend_profile_lock, flags);
+		prof = suspend_profiles[(seq - 1) % SUSPEND_PROFILE_CYCLES];
+		spin_unlock_irqrestore(&suspend_profile_lock, flags);
+		if (prof.seq != seq)
+			continue;
+
+		seq_printf(s, "cycle %u: error %d, slept %lu.%03lu s\n",
+			   prof.seq, prof.error, prof.slept.tv_sec,
+			   prof.slept.tv_nsec / NSEC_PER_MSEC);
+		for (i = 0; i < SUSPEND_PHASE_COUNT; i++)
+			seq_printf(s, "  %-16s %8ld.%03ld ms\n",
+				   suspend_phase_names[i],
+				   prof.phase_usecs[i] / USEC_PER_MSEC,
+				   prof.phase_usecs[i] % USEC_PER_MSEC);
+
+		sort(prof.devs, SUSPEND_PROFILE_DEVS, sizeof(prof.devs[0]),
+		     suspend_dev_cmp, NULL);
+		for (i = 0; i < SUSPEND_PROFILE_DEVS && prof.devs[i].usecs; i++)
+			seq_printf(s, "  %-32s %-16s %8u us\n",
+				   prof.devs[i].name,
+				   suspend_phase_names[prof.devs[i].phase],
+				   prof.devs[i].usecs);
+	}
+	return 0;
+}
+
+static int suspend_profile_debug_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, suspend_profile_debug_show, NULL);
+}
+
+static const struct file_operations suspend_profile_debug_fops = {
+	.open		= suspend_profile_debug_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 static int __init suspend_time_debug_init(void)
 {
 	struct dentry *d;
@@ -64,6 +256,13 @@ static int __init suspend_time_debug_init(void)
 		return -ENOMEM;
 	}
 
+	d = debugfs_create_file("suspend_profile", 0444, NULL, NULL,
+		&suspend_profile_debug_fops);
+	if (!d) {
+		pr_err("Failed to create suspend_profile debug file\n");
+		return -ENOMEM;
+	}
+
 	return 0;
 }
 
@@ -86,6 +285,8 @@ static void suspend_time_syscore_resume(void)
 	after = timespec_sub(after, suspend_time_before);
 
 	time_in_suspend_bins[fls(after.tv_sec)]++;
+	if (suspend_profile_cur)
+		suspend_profile_cur->slept = after;
 
 	pr_info("Suspended for %lu.%03lu seconds\n", after.tv_sec,
 		after.tv_nsec / NSEC_PER_MSEC);
@@ -17,6 +17,7 @@
 
 #include <linux/wakeup_reason.h>
 #include <linux/kernel.h>
+#include <linux/export.h>
 #include <linux/irq.h>
 #include <linux/interrupt.h>
 #include <linux/io.h>
@@ -26,6 +27,8 @@
 #include <linux/spinlock.h>
 #include <linux/notifier.h>
 #include <linux/suspend.h>
+#include <linux/kernel_stat.h>
+#include <linux/ktime.h>
 
 
 #define MAX_WAKEUP_REASON_IRQS 32
@@ -36,11 +39,43 @@ static char abort_reason[MAX_SUSPEND_ABORT_LEN];
 static struct kobject *wakeup_reason;
 static DEFINE_SPINLOCK(resume_reason_lock);
 
+/*
+ * Wakeup IRQs behind which the user is waiting for the screen, such as
+ * the power key.  After such a wakeup the devices marked resume_critical
+ * are resumed first, see dpm_resume().
+ */
+#define MAX_INTERACTIVE_IRQS	16
+static int interactive_irqs[MAX_INTERACTIVE_IRQS];
+static int interactive_count;
+
 static struct timespec last_xtime; /* wall time before last suspend */
 static struct timespec curr_xtime; /* wall time after last suspend */
 static struct timespec last_stime; /* total_sleep_time before last suspend */
 static struct timespec curr_stime; /* total_sleep_time after last suspend */
 
+/*
+ * What each reason to be awake cost: the resumes (or aborted suspends) it
+ * was behind, the time until the next suspend attempt and the CPU time
+ * used meanwhile.  A resume is charged to its first wakeup IRQ, an abort
+ * to its reason.  Reasons beyond the table size share the last entry.
+ */
+#define MAX_WAKEUP_COSTS	32
+#define WAKEUP_COST_NAME_LEN	32
+
+struct wakeup_cost {
+	int irq;			/* -1 if keyed by name */
+	char name[WAKEUP_COST_NAME_LEN];
+	unsigned int count;
+	u64 awake_us;
+	u64 cpu_us;
+};
+
+static struct wakeup_cost wakeup_costs[MAX_WAKEUP_COSTS];
+static int wakeup_cost_count;
+static struct wakeup_cost *wakeup_cost_cur;	/* charged until next suspend */
+static ktime_t wakeup_cost_start;
+static u64 wakeup_cost_cpu_start;
+
 static ssize_t last_resume_reason_show(struct kobject *kobj, struct kobj_attribute *attr,
 		char *buf)
 {
@@ -84,12 +119,77 @@ static ssize_t last_suspend_time_show(struct kobject *kobj,
 				sleep_time.tv_sec, sleep_time.tv_nsec);
 }
 
+static ssize_t wakeup_costs_show(struct kobject *kobj,
+			struct kobj_attribute *attr, char *buf)
+{
+	struct wakeup_cost *cost;
+	struct irq_desc *desc;
+	const char *name;
+	int i, len;
+
+	len = scnprintf(buf, PAGE_SIZE, "%-4s %-24s %8s %12s %12s\n",
+			"irq", "reason", "wakeups", "awake_ms", "cpu_ms");
+	spin_lock(&resume_reason_lock);
+	for (i = 0; i < wakeup_cost_count; i++) {
+		cost = &wakeup_costs[i];
+		name = cost->name;
+		if (cost->irq >= 0) {
+			desc = irq_to_desc(cost->irq);
+			if (desc && desc->action && desc->action->name)
+				name = desc->action->name;
+		}
+		len += scnprintf(buf + len, PAGE_SIZE - len,
+				 "%-4d %-24s %8u %12llu %12llu\n",
+				 cost->irq, name, cost->count,
+				 div_u64(cost->awake_us, USEC_PER_MSEC),
+				 div_u64(cost->cpu_us, USEC_PER_MSEC));
+	}
+	spin_unlock(&resume_reason_lock);
+	return len;
+}
+
+static ssize_t interactive_irqs_show(struct kobject *kobj,
+			struct kobj_attribute *attr, char *buf)
+{
+	int i, len = 0;
+
+	spin_lock(&resume_reason_lock);
+	for (i = 0; i < interactive_count; i++)
+		len += sprintf(buf + len, "%d\n", interactive_irqs[i]);
+	spin_unlock(&resume_reason_lock);
+	return len;
+}
+
+/* "<irq>" adds an IRQ to the interactive set, "-<irq>" removes it */
+static ssize_t interactive_irqs_store(struct kobject *kobj,
+			struct kobj_attribute *attr, const char *buf,
+			size_t count)
+{
+	int irq, ret;
+
+	ret = kstrtoint(buf, 10, &irq);
+	if (ret)
+		return ret;
+
+	if (irq < 0)
+		wakeup_reason_set_interactive(-irq, false);
+	else
+		wakeup_reason_set_interactive(irq, true);
+	return count;
+}
+
 static struct kobj_attribute resume_reason = __ATTR_RO(last_resume_reason);
 static struct kobj_attribute suspend_time = __ATTR_RO(last_suspend_time);
+static struct kobj_attribute wakeup_costs_attr = __ATTR_RO(wakeup_costs);
+static struct kobj_attribute interactive_irqs_attr =
+	__ATTR(interactive_irqs, 0644, interactive_irqs_show,
+	       interactive_irqs_store);
 
 static struct attribute *attrs[] = {
 	&resume_reason.attr,
 	&suspend_time.attr,
+	&wakeup_costs_attr.attr,
+	&interactive_irqs_attr.attr,
 	NULL,
 };
 static struct attribute_group attr_group = {
@@ -137,6 +237,46 @@ int check_wakeup_reason(int irq)
 	return ret;
 }
 
+/**
+ * wakeup_reason_set_interactive - Add or remove an interactive wakeup IRQ.
+ * @irq: Wakeup IRQ.
+ * @interactive: Whether a wakeup from @irq is waited on by the user.
+ */
+void wakeup_reason_set_interactive(int irq, bool interactive)
+{
+	int i;
+
+	spin_lock(&resume_reason_lock);
+	for (i = 0; i < interactive_count; i++)
+		if (interactive_irqs[i] == irq)
+			break;
+
+	if (interactive && i == interactive_count &&
+	    interactive_count < MAX_INTERACTIVE_IRQS)
+		interactive_irqs[interactive_count++] = irq;
+	else if (!interactive && i < interactive_count)
+		interactive_irqs[i] = interactive_irqs[--interactive_count];
+	spin_unlock(&resume_reason_lock);
+}
+EXPORT_SYMBOL_GPL(wakeup_reason_set_interactive);
+
+/* Whether the last resume was caused by an interactive wakeup IRQ */
+bool wakeup_reason_interactive(void)
+{
+	bool ret = false;
+	int i, j;
+
+	spin_lock(&resume_reason_lock);
+	for (i = 0; i < irqcount && !ret; i++)
+		for (j = 0; j < interactive_count; j++)
+			if (irq_list[i] == interactive_irqs[j]) {
+				ret = true;
+				break;
+			}
+	spin_unlock(&resume_reason_lock);
+	return ret;
+}
+
 void log_suspend_abort_reason(const char *fmt, ...)
 {
 	va_list args;
@@ -156,6 +296,92 @@ void log_suspend_abort_reason(const char *fmt, ...)
 	spin_unlock(&resume_reason_lock);
 }
 
+/* CPU time used so far by all CPUs outside of idle */
+static u64 wakeup_cost_cpu_time(void)
+{
+	u64 busy = 0;
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		u64 *cpustat = kcpustat_cpu(cpu).cpustat;
+
+		busy += cputime_to_usecs(cpustat[CPUTIME_USER] +
+					 cpustat[CPUTIME_NICE] +
+					 cpustat[CPUTIME_SYSTEM] +
+					 cpustat[CPUTIME_IRQ] +
+					 cpustat[CPUTIME_SOFTIRQ]);
+	}
+	return busy;
+}
+
+/* Called under resume_reason_lock */
+static struct wakeup_cost *wakeup_cost_find(int irq, const char *name)
+{
+	struct wakeup_cost *cost;
+	int i;
+
+	for (i = 0; i < wakeup_cost_count; i++) {
+		cost = &wakeup_costs[i];
+		if (cost->irq == irq &&
+		    (irq >= 0 || !strncmp(cost->name, name, sizeof(cost->name) - 1)))
+			return cost;
+	}
+
+	if (wakeup_cost_count == MAX_WAKEUP_COSTS) {
+		cost = &wakeup_costs[MAX_WAKEUP_COSTS - 1];
+		cost->irq = -1;
+		strlcpy(cost->name, "other", sizeof(cost->name));
+		return cost;
+	}
+
+	cost = &wakeup_costs[wakeup_cost_count++];
+	cost->irq = irq;
+	strlcpy(cost->name, name, sizeof(cost->name));
+	return cost;
+}
+
+/* Called under resume_reason_lock when a suspend attempt has ended */
+static void wakeup_cost_open(void)
+{
+	if (suspend_abort)
+		wakeup_cost_cur = wakeup_cost_find(-1, abort_reason);
+	else if (irqcount)
+		wakeup_cost_cur = wakeup_cost_find(irq_list[0], "");
+	else
+		wakeup_cost_cur = wakeup_cost_find(-1, "unknown");
+	wakeup_cost_cur->count++;
+	wakeup_cost_start = ktime_get();
+	wakeup_cost_cpu_start = wakeup_cost_cpu_time();
+}
+
+/* Called under resume_reason_lock before the next suspend attempt */
+static void wakeup_cost_close(void)
+{
+	if (!wakeup_cost_cur)
+		return;
+	wakeup_cost_cur->awake_us += ktime_us_delta(ktime_get(),
+						    wakeup_cost_start);
+	wakeup_cost_cur->cpu_us += wakeup_cost_cpu_time() -
+				   wakeup_cost_cpu_start;
+	wakeup_cost_cur = NULL;
+}
+
+/*
+ * Autosleep gave up on a suspend attempt before starting it.  Report it
+ * as an aborted suspend of its own, so that it shows up in
+ * last_resume_reason and is charged in wakeup_costs.
+ */
+void log_autosleep_abort_reason(const char *reason)
+{
+	spin_lock(&resume_reason_lock);
+	wakeup_cost_close();
+	irqcount = 0;
+	suspend_abort = true;
+	strlcpy(abort_reason, reason, MAX_SUSPEND_ABORT_LEN);
+	wakeup_cost_open();
+	spin_unlock(&resume_reason_lock);
+}
+
 /* Detects a suspend and clears all the previous wake up reasons*/
 static int wakeup_reason_pm_event(struct notifier_block *notifier,
 		unsigned long pm_event, void *unused)
@@ -165,6 +391,7 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 	switch (pm_event) {
 	case PM_SUSPEND_PREPARE:
 		spin_lock(&resume_reason_lock);
+		wakeup_cost_close();
 		irqcount = 0;
 		suspend_abort = false;
 		spin_unlock(&resume_reason_lock);
@@ -175,6 +402,9 @@ static int wakeup_reason_pm_event(struct notifier_block *notifier,
 	case PM_POST_SUSPEND:
 		get_xtime_and_monotonic_and_sleep_offset(&curr_xtime, &xtom,
 			&curr_stime);
+		spin_lock(&resume_reason_lock);
+		wakeup_cost_open();
+		spin_unlock(&resume_reason_lock);
 		break;
 	default:
 		break;
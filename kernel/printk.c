@@ -45,6 +45,7 @@
 #include <linux/poll.h>
 #include <linux/irq_work.h>
 #include <linux/utsname.h>
+#include <linux/kthread.h>
 
 #include <asm/uaccess.h>
 
@@ -1658,6 +1659,27 @@ static inline void printk_delay(void)
 	}
 }
 
+/*
+ * With deferred_console set, printk() only stores the message and the
+ * console drivers are run from a low priority kthread instead of the
+ * caller's context. Oopses, panics and shutdown still print directly.
+ */
+static bool __read_mostly deferred_console;
+module_param(deferred_console, bool, S_IRUGO | S_IWUSR);
+MODULE_PARM_DESC(deferred_console, "print to consoles from a kthread");
+
+static struct task_struct *console_flush_thread;
+static DECLARE_WAIT_QUEUE_HEAD(console_flush_wait);
+static bool console_flush_pending;
+
+static void wake_up_console_flush(void);
+
+static bool console_flush_deferred(void)
+{
+	return deferred_console && console_flush_thread &&
+	       !oops_in_progress && system_state == SYSTEM_RUNNING;
+}
+
 /*
  * Continuation lines are buffered, and not committed to the record buffer
  * until the line is complete, or a race forces it. The line fragments
@@ -1894,7 +1916,11 @@ asmlinkage int vprintk_emit(int facility, int level,
 	 * The console_trylock_for_printk() function will release 'logbuf_lock'
 	 * regardless of whether it actually gets the console semaphore or not.
 	 */
-	if (console_trylock_for_printk(this_cpu))
+	if (console_flush_deferred()) {
+		logbuf_cpu = UINT_MAX;
+		raw_spin_unlock(&logbuf_lock);
+		wake_up_console_flush();
+	} else if (console_trylock_for_printk(this_cpu))
 		console_unlock();
 
 	lockdep_on();
@@ -2748,6 +2774,7 @@ late_initcall(printk_late_init);
 
 #define PRINTK_PENDING_WAKEUP	0x01
 #define PRINTK_PENDING_SCHED	0x02
+#define PRINTK_PENDING_CONSOLE	0x04
 
 static DEFINE_PER_CPU(int, printk_pending);
 static DEFINE_PER_CPU(char [PRINTK_BUF_SIZE], printk_sched_buf);
@@ -2763,6 +2790,11 @@ static void wake_up_klogd_work_func(struct irq_work *irq_work)
 
 	if (pending & PRINTK_PENDING_WAKEUP)
 		wake_up_interruptible(&log_wait);
+
+	if (pending & PRINTK_PENDING_CONSOLE) {
+		console_flush_pending = true;
+		wake_up_interruptible(&console_flush_wait);
+	}
 }
 
 static DEFINE_PER_CPU(struct irq_work, wake_up_klogd_work) = {
@@ -2780,6 +2812,43 @@ void wake_up_klogd(void)
 	preempt_enable();
 }
 
+/* Called with interrupts disabled, possibly under the scheduler locks */
+static void wake_up_console_flush(void)
+{
+	__this_cpu_or(printk_pending, PRINTK_PENDING_CONSOLE);
+	irq_work_queue(&__get_cpu_var(wake_up_klogd_work));
+}
+
+static int console_flush_thread_func(void *unused)
+{
+	set_user_nice(current, 19);
+
+	while (!kthread_should_stop()) {
+		wait_event_interruptible(console_flush_wait,
+					 console_flush_pending ||
+					 kthread_should_stop());
+		console_flush_pending = false;
+
+		/* Prints everything stored so far */
+		console_lock();
+		console_unlock();
+	}
+
+	return 0;
+}
+
+static int __init console_flush_init(void)
+{
+	struct task_struct *thread;
+
+	thread = kthread_run(console_flush_thread_func, NULL, "kconsoled");
+	if (IS_ERR(thread))
+		return PTR_ERR(thread);
+	console_flush_thread = thread;
+	return 0;
+}
+late_initcall(console_flush_init);
+
 int printk_deferred(const char *fmt, ...)
 {
 	unsigned long flags;
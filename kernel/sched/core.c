@@ -76,6 +76,8 @@
 #include <linux/binfmts.h>
 #include <linux/context_tracking.h>
 #include <linux/cpufreq.h>
+#include <linux/cpufreq_times.h>
+#include <linux/cpu_boost.h>
 
 #include <asm/switch_to.h>
 #include <asm/tlb.h>
@@ -1510,6 +1512,7 @@ ttwu_do_activate(struct rq *rq, struct task_struct *p, int wake_flags)
 #endif
 
 	ttwu_activate(rq, p, ENQUEUE_WAKEUP | ENQUEUE_WAKING);
+	sched_lat_wakeup(rq, p);
 	ttwu_do_wakeup(rq, p, wake_flags);
 }
 
@@ -1807,6 +1810,10 @@ static void __sched_fork(struct task_struct *p)
 
 	INIT_LIST_HEAD(&p->rt.run_list);
 
+#ifdef CONFIG_SCHED_TUNE
+	p->boost_hint = 0;
+#endif
+
 #ifdef CONFIG_PREEMPT_NOTIFIERS
 	INIT_HLIST_HEAD(&p->preempt_notifiers);
 #endif
@@ -3193,6 +3200,7 @@ need_resched:
 
 	put_prev_task(rq, prev);
 	next = pick_next_task(rq);
+	sched_lat_arrive(rq, next);
 	clear_tsk_need_resched(prev);
 	rq->skip_clock_update = 0;
 
@@ -3201,6 +3209,7 @@ need_resched:
 		rq->curr = next;
 		++*switch_count;
 
+		cpufreq_task_times_switch(prev, next);
 		context_switch(rq, prev, next); /* unlocks the rq */
 		/*
 		 * The context switch have flipped the stack from under us
@@ -4242,6 +4251,40 @@ int sched_setscheduler_nocheck(struct task_struct *p, int policy,
 	return __sched_setscheduler(p, policy, param, false);
 }
 
+#ifdef CONFIG_SCHED_TUNE
+/**
+ * sched_task_boost - utilization boost applied to a task.
+ * @p: the task in question.
+ *
+ * Returns the cpu.boost of the task's group, or the boost hint lent to
+ * the task, whichever is higher.
+ */
+unsigned int sched_task_boost(struct task_struct *p)
+{
+	unsigned int boost;
+
+	rcu_read_lock();
+	boost = task_boost(p);
+	rcu_read_unlock();
+
+	return boost;
+}
+
+/**
+ * sched_set_boost_hint - lend a utilization boost to a task.
+ * @p: the task in question.
+ * @boost: percentage from 0 to 100, 0 drops the hint.
+ *
+ * Lets IPC drivers run a server thread with the boost of the client
+ * waiting on it.  The hint only raises the boost of @p, it never lowers
+ * the boost of its group, and it is not inherited across fork.
+ */
+void sched_set_boost_hint(struct task_struct *p, unsigned int boost)
+{
+	ACCESS_ONCE(p->boost_hint) = min(boost, 100U);
+}
+#endif
+
 static int
 do_sched_setscheduler(pid_t pid, int policy, struct sched_param __user *param)
 {
@@ -7196,6 +7239,9 @@ int in_sched_functions(unsigned long addr)
  */
 struct task_group root_task_group;
 LIST_HEAD(task_groups);
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static DEFINE_PER_CPU(struct sched_lat_hist, root_lat_hist);
+#endif
 #endif
 
 DECLARE_PER_CPU(cpumask_var_t, load_balance_mask);
@@ -7257,6 +7303,9 @@ void __init sched_init(void)
 	list_add(&root_task_group.list, &task_groups);
 	INIT_LIST_HEAD(&root_task_group.children);
 	INIT_LIST_HEAD(&root_task_group.siblings);
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	root_task_group.lat_hist = &root_lat_hist;
+#endif
 	autogroup_init(&init_task);
 
 #endif /* CONFIG_CGROUP_SCHED */
@@ -7549,6 +7598,9 @@ static void free_sched_group(struct task_group *tg)
 	free_fair_sched_group(tg);
 	free_rt_sched_group(tg);
 	autogroup_free(tg);
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	free_percpu(tg->lat_hist);
+#endif
 	kfree(tg);
 }
 
@@ -7567,6 +7619,12 @@ struct task_group *sched_create_group(struct task_group *parent)
 	if (!alloc_rt_sched_group(tg, parent))
 		goto err;
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	tg->lat_hist = alloc_percpu(struct sched_lat_hist);
+	if (!tg->lat_hist)
+		goto err;
+#endif
+
 	return tg;
 
 err:
@@ -7999,10 +8057,17 @@ static int cpu_cgroup_css_online(struct cgroup *cgrp)
 	return 0;
 }
 
+#ifdef CONFIG_CFS_BANDWIDTH
+static void tg_cfs_input_remove(struct task_group *tg);
+#else
+static inline void tg_cfs_input_remove(struct task_group *tg) { }
+#endif
+
 static void cpu_cgroup_css_free(struct cgroup *cgrp)
 {
 	struct task_group *tg = cgroup_tg(cgrp);
 
+	tg_cfs_input_remove(tg);
 	sched_destroy_group(tg);
 }
 
@@ -8087,42 +8152,94 @@ static u64 cpu_shares_read_u64(struct cgroup *cgrp, struct cftype *cft)
 	return (u64) scale_load_down(tg->shares);
 }
 
+#ifdef CONFIG_SCHED_TUNE
+static int cpu_boost_write_u64(struct cgroup *cgrp, struct cftype *cftype,
+			       u64 boost)
+{
+	if (boost > 100)
+		return -EINVAL;
+
+	cgroup_tg(cgrp)->boost = boost;
+	return 0;
+}
+
+static u64 cpu_boost_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+
+	return tg->boost;
+}
+#endif /* CONFIG_SCHED_TUNE */
+
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static int cpu_wakeup_latency_show(struct cgroup *cgrp, struct cftype *cft,
+				   struct seq_file *m)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	u32 hist[SCHED_LAT_HIST_BUCKETS] = { 0 };
+	int cpu, i;
+
+	for_each_possible_cpu(cpu) {
+		struct sched_lat_hist *lh = per_cpu_ptr(tg->lat_hist, cpu);
+
+		for (i = 0; i < SCHED_LAT_HIST_BUCKETS; i++)
+			hist[i] += lh->bucket[i];
+	}
+
+	sched_lat_hist_show(m, hist);
+	return 0;
+}
+
+static int cpu_wakeup_latency_reset(struct cgroup *cgrp, unsigned int event)
+{
+	struct task_group *tg = cgroup_tg(cgrp);
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		memset(per_cpu_ptr(tg->lat_hist, cpu), 0,
+		       sizeof(struct sched_lat_hist));
+
+	return 0;
+}
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 #ifdef CONFIG_CFS_BANDWIDTH
 static DEFINE_MUTEX(cfs_constraints_mutex);
 
 const u64 max_cfs_quota_period = 1 * NSEC_PER_SEC; /* 1s */
 const u64 min_cfs_quota_period = 1 * NSEC_PER_MSEC; /* 1ms */
 
+/*
+ * While the user is interacting, groups with a cpu.cfs_input_quota_us run
+ * under that quota instead of their own if it is tighter.  Both the list
+ * of such groups and the state are protected by cfs_constraints_mutex.
+ */
+static LIST_HEAD(cfs_input_groups);
+static bool cfs_input_active;
+static unsigned long cfs_input_expires;
+static u64 cfs_input_ms = 3000;
+
 static int __cfs_schedulable(struct task_group *tg, u64 period, u64 runtime);
 
-static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+static u64 cfs_effective_quota(struct cfs_bandwidth *cfs_b, u64 quota)
+{
+	if (cfs_input_active)
+		return min(quota, cfs_b->input_quota);
+	return quota;
+}
+
+/* requires cfs_constraints_mutex */
+static int __tg_set_cfs_bandwidth(struct task_group *tg, u64 period,
+				  u64 quota)
 {
 	int i, ret = 0, runtime_enabled, runtime_was_enabled;
 	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
 
-	if (tg == &root_task_group)
-		return -EINVAL;
-
-	/*
-	 * Ensure we have at some amount of bandwidth every period.  This is
-	 * to prevent reaching a state of large arrears when throttled via
-	 * entity_tick() resulting in prolonged exit starvation.
-	 */
-	if (quota < min_cfs_quota_period || period < min_cfs_quota_period)
-		return -EINVAL;
-
-	/*
-	 * Likewise, bound things on the otherside by preventing insane quota
-	 * periods.  This also allows us to normalize in computing quota
-	 * feasibility.
-	 */
-	if (period > max_cfs_quota_period)
-		return -EINVAL;
+	lockdep_assert_held(&cfs_constraints_mutex);
 
-	mutex_lock(&cfs_constraints_mutex);
 	ret = __cfs_schedulable(tg, period, quota);
 	if (ret)
-		goto out_unlock;
+		return ret;
 
 	runtime_enabled = quota != RUNTIME_INF;
 	runtime_was_enabled = cfs_b->quota != RUNTIME_INF;
@@ -8140,8 +8257,7 @@ static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
 	/* restart the period timer (if active) to handle new period expiry */
 	if (runtime_enabled && cfs_b->timer_active) {
 		/* force a reprogram */
-		cfs_b->timer_active = 0;
-		__start_cfs_bandwidth(cfs_b);
+		__start_cfs_bandwidth(cfs_b, true);
 	}
 	raw_spin_unlock_irq(&cfs_b->lock);
 
@@ -8159,7 +8275,39 @@ static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
 	}
 	if (runtime_was_enabled && !runtime_enabled)
 		cfs_bandwidth_usage_dec();
-out_unlock:
+
+	return 0;
+}
+
+static int tg_set_cfs_bandwidth(struct task_group *tg, u64 period, u64 quota)
+{
+	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
+	int ret;
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	/*
+	 * Ensure we have at some amount of bandwidth every period.  This is
+	 * to prevent reaching a state of large arrears when throttled via
+	 * entity_tick() resulting in prolonged exit starvation.
+	 */
+	if (quota < min_cfs_quota_period || period < min_cfs_quota_period)
+		return -EINVAL;
+
+	/*
+	 * Likewise, bound things on the otherside by preventing insane quota
+	 * periods.  This also allows us to normalize in computing quota
+	 * feasibility.
+	 */
+	if (period > max_cfs_quota_period)
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+	ret = __tg_set_cfs_bandwidth(tg, period,
+				     cfs_effective_quota(cfs_b, quota));
+	if (!ret)
+		cfs_b->user_quota = quota;
 	mutex_unlock(&cfs_constraints_mutex);
 
 	return ret;
@@ -8182,10 +8330,10 @@ long tg_get_cfs_quota(struct task_group *tg)
 {
 	u64 quota_us;
 
-	if (tg->cfs_bandwidth.quota == RUNTIME_INF)
+	if (tg->cfs_bandwidth.user_quota == RUNTIME_INF)
 		return -1;
 
-	quota_us = tg->cfs_bandwidth.quota;
+	quota_us = tg->cfs_bandwidth.user_quota;
 	do_div(quota_us, NSEC_PER_USEC);
 
 	return quota_us;
@@ -8196,7 +8344,7 @@ int tg_set_cfs_period(struct task_group *tg, long cfs_period_us)
 	u64 quota, period;
 
 	period = (u64)cfs_period_us * NSEC_PER_USEC;
-	quota = tg->cfs_bandwidth.quota;
+	quota = tg->cfs_bandwidth.user_quota;
 
 	return tg_set_cfs_bandwidth(tg, period, quota);
 }
@@ -8211,6 +8359,147 @@ long tg_get_cfs_period(struct task_group *tg)
 	return cfs_period_us;
 }
 
+/* requires cfs_constraints_mutex */
+static void cfs_input_apply(void)
+{
+	struct cfs_bandwidth *cfs_b;
+	struct task_group *tg;
+
+	list_for_each_entry(cfs_b, &cfs_input_groups, input_node) {
+		tg = container_of(cfs_b, struct task_group, cfs_bandwidth);
+		__tg_set_cfs_bandwidth(tg, ktime_to_ns(cfs_b->period),
+				cfs_effective_quota(cfs_b, cfs_b->user_quota));
+	}
+}
+
+static void cfs_input_end_workfn(struct work_struct *work)
+{
+	mutex_lock(&cfs_constraints_mutex);
+	if (cfs_input_active && time_after_eq(jiffies, cfs_input_expires)) {
+		cfs_input_active = false;
+		cfs_input_apply();
+	}
+	mutex_unlock(&cfs_constraints_mutex);
+}
+
+static DECLARE_DELAYED_WORK(cfs_input_end_work, cfs_input_end_workfn);
+
+static void cfs_input_start_workfn(struct work_struct *work)
+{
+	unsigned long delay;
+
+	mutex_lock(&cfs_constraints_mutex);
+	delay = msecs_to_jiffies(cfs_input_ms);
+	cfs_input_expires = jiffies + delay;
+	if (delay && !cfs_input_active) {
+		cfs_input_active = true;
+		cfs_input_apply();
+	}
+	mutex_unlock(&cfs_constraints_mutex);
+
+	mod_delayed_work(system_wq, &cfs_input_end_work, delay);
+}
+
+static DECLARE_WORK(cfs_input_start_work, cfs_input_start_workfn);
+
+/* called from the input event handler, already rate limited */
+static int cfs_input_notify(struct notifier_block *nb, unsigned long val,
+			    void *data)
+{
+	if (!list_empty(&cfs_input_groups))
+		schedule_work(&cfs_input_start_work);
+	return NOTIFY_OK;
+}
+
+static struct notifier_block cfs_input_nb = {
+	.notifier_call = cfs_input_notify,
+};
+
+static int __init cfs_input_init(void)
+{
+	return input_boost_register_notifier(&cfs_input_nb);
+}
+late_initcall(cfs_input_init);
+
+static int tg_set_cfs_input_quota(struct task_group *tg, long cfs_quota_us)
+{
+	struct cfs_bandwidth *cfs_b = &tg->cfs_bandwidth;
+	u64 quota, old;
+	int ret = 0;
+
+	if (tg == &root_task_group)
+		return -EINVAL;
+
+	if (cfs_quota_us < 0)
+		quota = RUNTIME_INF;
+	else
+		quota = (u64)cfs_quota_us * NSEC_PER_USEC;
+
+	if (quota < min_cfs_quota_period)
+		return -EINVAL;
+
+	mutex_lock(&cfs_constraints_mutex);
+	old = cfs_b->input_quota;
+	cfs_b->input_quota = quota;
+	if (cfs_input_active) {
+		ret = __tg_set_cfs_bandwidth(tg, ktime_to_ns(cfs_b->period),
+				cfs_effective_quota(cfs_b, cfs_b->user_quota));
+		if (ret)
+			cfs_b->input_quota = old;
+	}
+	if (cfs_b->input_quota == RUNTIME_INF)
+		list_del_init(&cfs_b->input_node);
+	else if (list_empty(&cfs_b->input_node))
+		list_add(&cfs_b->input_node, &cfs_input_groups);
+	mutex_unlock(&cfs_constraints_mutex);
+
+	return ret;
+}
+
+static long tg_get_cfs_input_quota(struct task_group *tg)
+{
+	u64 quota_us;
+
+	if (tg->cfs_bandwidth.input_quota == RUNTIME_INF)
+		return -1;
+
+	quota_us = tg->cfs_bandwidth.input_quota;
+	do_div(quota_us, NSEC_PER_USEC);
+
+	return quota_us;
+}
+
+static void tg_cfs_input_remove(struct task_group *tg)
+{
+	mutex_lock(&cfs_constraints_mutex);
+	list_del_init(&tg->cfs_bandwidth.input_node);
+	mutex_unlock(&cfs_constraints_mutex);
+}
+
+static s64 cpu_cfs_input_quota_read_s64(struct cgroup *cgrp,
+					struct cftype *cft)
+{
+	return tg_get_cfs_input_quota(cgroup_tg(cgrp));
+}
+
+static int cpu_cfs_input_quota_write_s64(struct cgroup *cgrp,
+					 struct cftype *cftype, s64 cfs_quota_us)
+{
+	return tg_set_cfs_input_quota(cgroup_tg(cgrp), cfs_quota_us);
+}
+
+static u64 cpu_cfs_input_ms_read_u64(struct cgroup *cgrp, struct cftype *cft)
+{
+	return cfs_input_ms;
+}
+
+static int cpu_cfs_input_ms_write_u64(struct cgroup *cgrp,
+				      struct cftype *cftype, u64 ms)
+{
+	cfs_input_ms = ms;
+	return 0;
+}
+
 static s64 cpu_cfs_quota_read_s64(struct cgroup *cgrp, struct cftype *cft)
 {
 	return tg_get_cfs_quota(cgroup_tg(cgrp));
@@ -8363,6 +8652,20 @@ static struct cftype cpu_files[] = {
 		.write_u64 = cpu_shares_write_u64,
 	},
 #endif
+#ifdef CONFIG_SCHED_TUNE
+	{
+		.name = "boost",
+		.read_u64 = cpu_boost_read_u64,
+		.write_u64 = cpu_boost_write_u64,
+	},
+#endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	{
+		.name = "wakeup_latency",
+		.read_seq_string = cpu_wakeup_latency_show,
+		.trigger = cpu_wakeup_latency_reset,
+	},
+#endif
 #ifdef CONFIG_CFS_BANDWIDTH
 	{
 		.name = "cfs_quota_us",
@@ -8378,6 +8681,17 @@ static struct cftype cpu_files[] = {
 		.name = "stat",
 		.read_map = cpu_stats_show,
 	},
+	{
+		.name = "cfs_input_quota_us",
+		.read_s64 = cpu_cfs_input_quota_read_s64,
+		.write_s64 = cpu_cfs_input_quota_write_s64,
+	},
+	{
+		.name = "cfs_input_ms",
+		.flags = CFTYPE_ONLY_ON_ROOT,
+		.read_u64 = cpu_cfs_input_ms_read_u64,
+		.write_u64 = cpu_cfs_input_ms_write_u64,
+	},
 #endif
 #ifdef CONFIG_RT_GROUP_SCHED
 	{
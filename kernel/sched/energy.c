@@ -0,0 +1,55 @@
+/*
+ * Energy model for energy aware task placement.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Platform code registers a table of operating points and idle states
+ * with sched_energy_register(); select_task_rq_fair() consults it when
+ * the ENERGY_AWARE scheduler feature is enabled.  The current frequency
+ * of each CPU is tracked with a cpufreq transition notifier so that the
+ * wakeup path never has to take cpufreq locks.
+ */
+
+#include <linux/cpufreq.h>
+#include <linux/init.h>
+#include <linux/percpu.h>
+#include <linux/sched_energy.h>
+
+#include "sched.h"
+
+const struct sched_energy *sched_energy_model;
+
+/* Current frequency of each CPU in kHz, 0 until the first transition */
+DEFINE_PER_CPU(unsigned int, sched_energy_freq);
+
+void __init sched_energy_register(const struct sched_energy *em)
+{
+	if (WARN_ON(!em->nr_opps || !em->nr_idle_states))
+		return;
+
+	sched_energy_model = em;
+}
+
+static int sched_energy_cpufreq_notifier(struct notifier_block *nb,
+					 unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freq = data;
+
+	if (val == CPUFREQ_POSTCHANGE)
+		per_cpu(sched_energy_freq, freq->cpu) = freq->new;
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block sched_energy_cpufreq_nb = {
+	.notifier_call = sched_energy_cpufreq_notifier,
+};
+
+static int __init sched_energy_init(void)
+{
+	return cpufreq_register_notifier(&sched_energy_cpufreq_nb,
+					 CPUFREQ_TRANSITION_NOTIFIER);
+}
+core_initcall(sched_energy_init);
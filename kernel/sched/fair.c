@@ -29,6 +29,7 @@
 #include <linux/mempolicy.h>
 #include <linux/migrate.h>
 #include <linux/task_work.h>
+#include <linux/sched_energy.h>
 
 #include <trace/events/sched.h>
 
@@ -1547,6 +1548,7 @@ static inline void update_rq_runnable_avg(struct rq *rq, int runnable)
 {
 	__update_entity_runnable_avg(rq->clock_task, &rq->avg, runnable);
 	__update_tg_runnable_avg(&rq->avg, &rq->cfs);
+	cpufreq_update_util(rq);
 }
 
 /* Add the load generated by se into cfs_rq's child load-average */
@@ -2158,7 +2160,7 @@ static int assign_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 		 */
 		if (!cfs_b->timer_active) {
 			__refill_cfs_bandwidth_runtime(cfs_b);
-			__start_cfs_bandwidth(cfs_b);
+			__start_cfs_bandwidth(cfs_b, false);
 		}
 
 		if (cfs_b->runtime > 0) {
@@ -2339,7 +2341,7 @@ static void throttle_cfs_rq(struct cfs_rq *cfs_rq)
 	raw_spin_lock(&cfs_b->lock);
 	list_add_tail_rcu(&cfs_rq->throttled_list, &cfs_b->throttled_cfs_rq);
 	if (!cfs_b->timer_active)
-		__start_cfs_bandwidth(cfs_b);
+		__start_cfs_bandwidth(cfs_b, false);
 	raw_spin_unlock(&cfs_b->lock);
 }
 
@@ -2706,6 +2708,9 @@ void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 	raw_spin_lock_init(&cfs_b->lock);
 	cfs_b->runtime = 0;
 	cfs_b->quota = RUNTIME_INF;
+	cfs_b->user_quota = RUNTIME_INF;
+	cfs_b->input_quota = RUNTIME_INF;
+	INIT_LIST_HEAD(&cfs_b->input_node);
 	cfs_b->period = ns_to_ktime(default_cfs_period());
 
 	INIT_LIST_HEAD(&cfs_b->throttled_cfs_rq);
@@ -2722,7 +2727,7 @@ static void init_cfs_rq_runtime(struct cfs_rq *cfs_rq)
 }
 
 /* requires cfs_b->lock, may release to reprogram timer */
-void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
+void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b, bool force)
 {
 	/*
 	 * The timer may be active because we're trying to set a new bandwidth
@@ -2737,7 +2742,7 @@ void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b)
 		cpu_relax();
 		raw_spin_lock(&cfs_b->lock);
 		/* if someone else restarted the timer then we're done */
-		if (cfs_b->timer_active)
+		if (!force && cfs_b->timer_active)
 			return;
 	}
 
@@ -3385,6 +3390,168 @@ done:
 	return target;
 }
 
+#ifdef CONFIG_SCHED_TUNE
+/*
+ * Highest boost among the groups with entities queued on @rq: a group
+ * counts while any of its tasks or child groups is runnable there.  The
+ * boost hint of the task currently running on @rq counts as well.
+ * Called with @rq locked.
+ */
+unsigned int rq_boost(struct rq *rq)
+{
+	struct cfs_rq *cfs_rq;
+	unsigned int boost = ACCESS_ONCE(rq->curr->boost_hint);
+
+	for_each_leaf_cfs_rq(rq, cfs_rq) {
+		if (cfs_rq->nr_running && cfs_rq->tg->boost > boost)
+			boost = cfs_rq->tg->boost;
+	}
+
+	return boost;
+}
+#endif /* CONFIG_SCHED_TUNE */
+
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+/* Waking tasks up to this utilization are candidates for packing */
+#define ENERGY_SMALL_TASK_UTIL	(SCHED_POWER_SCALE / 4)
+
+/*
+ * Share of a CPU's capacity at a given frequency that packing may fill:
+ * the headroom a utilization driven governor keeps before it raises the
+ * frequency (1 / 1.25).
+ */
+#define ENERGY_PACK_UTIL	(SCHED_POWER_SCALE * 4 / 5)
+
+static inline unsigned long energy_util(struct sched_avg *sa)
+{
+	u64 util = ((u64)sa->runnable_avg_sum << SCHED_POWER_SHIFT);
+
+	do_div(util, sa->runnable_avg_period + 1);
+	return min_t(unsigned long, util, SCHED_POWER_SCALE);
+}
+
+static unsigned int energy_cpu_freq(const struct sched_energy *em, int cpu)
+{
+	unsigned int freq = per_cpu(sched_energy_freq, cpu);
+
+	return freq ? freq : em->opps[em->nr_opps - 1].freq;
+}
+
+/*
+ * Frequency, in kHz, that would keep @cpu busy all the time with its
+ * current load: utilization is measured at the current frequency.
+ */
+static unsigned long energy_cpu_demand(const struct sched_energy *em, int cpu)
+{
+	return (energy_util(&cpu_rq(cpu)->avg) * energy_cpu_freq(em, cpu)) >>
+		SCHED_POWER_SHIFT;
+}
+
+static bool energy_fits(unsigned long demand, unsigned int freq)
+{
+	return (u64)demand * SCHED_POWER_SCALE <= (u64)freq * ENERGY_PACK_UTIL;
+}
+
+/*
+ * Estimate the power drawn by @cpus once @delta kHz of demand is added to
+ * @dst_cpu.  The cluster shares its clock, so it runs at the lowest
+ * operating point that fits the busiest CPU.  Each CPU is busy for
+ * demand / freq of the time at that point's power; for the rest it idles
+ * in the deepest state if it has no load at all, or only in the
+ * shallowest one between bursts otherwise.
+ */
+static unsigned long energy_estimate(const struct sched_energy *em,
+				     const struct cpumask *cpus,
+				     int dst_cpu, unsigned long delta)
+{
+	const struct sched_energy_opp *opp;
+	unsigned long demand, max_demand = 0, energy = 0;
+	int i;
+
+	for_each_cpu(i, cpus) {
+		demand = energy_cpu_demand(em, i) + (i == dst_cpu ? delta : 0);
+		max_demand = max(max_demand, demand);
+	}
+
+	for (opp = em->opps; opp < em->opps + em->nr_opps - 1; opp++)
+		if (energy_fits(max_demand, opp->freq))
+			break;
+
+	for_each_cpu(i, cpus) {
+		unsigned long busy;
+		unsigned int idle_power;
+
+		demand = energy_cpu_demand(em, i) + (i == dst_cpu ? delta : 0);
+		busy = min_t(unsigned long,
+			     demand * SCHED_POWER_SCALE / opp->freq,
+			     SCHED_POWER_SCALE);
+		if (demand)
+			idle_power = em->idle_states[0].power;
+		else
+			idle_power =
+				em->idle_states[em->nr_idle_states - 1].power;
+
+		energy += busy * opp->power +
+			  (SCHED_POWER_SCALE - busy) * idle_power;
+	}
+
+	return energy;
+}
+
+/*
+ * Energy aware wakeup placement: put a small waking task on an already
+ * busy CPU that has room for it at its current frequency, provided the
+ * energy model expects that to be cheaper than bringing an idle CPU out
+ * of its idle state.  Returns -1 to let the regular wakeup path spread
+ * the task instead.
+ */
+static int energy_aware_wake_cpu(struct task_struct *p, int prev_cpu)
+{
+	const struct sched_energy *em = sched_energy_model;
+	unsigned long util, delta, energy, best_energy = ULONG_MAX;
+	int i, best_cpu = -1, spread_cpu = -1;
+
+	if (!em)
+		return -1;
+
+	util = energy_util(&p->se.avg);
+#ifdef CONFIG_SCHED_TUNE
+	util = boosted_util(util, task_boost(p));
+#endif
+	if (util > ENERGY_SMALL_TASK_UTIL)
+		return -1;
+	delta = (util * energy_cpu_freq(em, prev_cpu)) >> SCHED_POWER_SHIFT;
+
+	for_each_cpu_and(i, tsk_cpus_allowed(p), cpu_active_mask) {
+		if (idle_cpu(i)) {
+			if (spread_cpu < 0 || i == prev_cpu)
+				spread_cpu = i;
+			continue;
+		}
+
+		if (!energy_fits(energy_cpu_demand(em, i) + delta,
+				 energy_cpu_freq(em, i)))
+			continue;
+
+		energy = energy_estimate(em, cpu_active_mask, i, delta);
+		if (energy < best_energy ||
+		    (energy == best_energy && i == prev_cpu)) {
+			best_energy = energy;
+			best_cpu = i;
+		}
+	}
+
+	if (best_cpu >= 0 && (spread_cpu < 0 || best_energy <=
+	    energy_estimate(em, cpu_active_mask, spread_cpu, delta))) {
+		schedstat_inc(p, se.statistics.nr_wakeups_energy_pack);
+		return best_cpu;
+	}
+
+	schedstat_inc(p, se.statistics.nr_wakeups_energy_spread);
+	return -1;
+}
+#endif /* CONFIG_SCHED_ENERGY_AWARE */
+
 /*
  * sched_balance_self: balance the current task (running on cpu) in domains
  * that have the 'flag' flag set. In practice, this is SD_BALANCE_FORK and
@@ -3415,6 +3582,15 @@ select_task_rq_fair(struct task_struct *p, int sd_flag, int wake_flags)
 		new_cpu = prev_cpu;
 	}
 
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+	if ((sd_flag & SD_BALANCE_WAKE) && sched_feat(ENERGY_AWARE)) {
+		int energy_cpu = energy_aware_wake_cpu(p, prev_cpu);
+
+		if (energy_cpu >= 0)
+			return energy_cpu;
+	}
+#endif
+
 	rcu_read_lock();
 	for_each_domain(cpu, tmp) {
 		if (!(tmp->flags & SD_LOAD_BALANCE))
@@ -60,6 +60,15 @@ SCHED_FEAT(FORCE_SD_OVERLAP, false)
 SCHED_FEAT(RT_RUNTIME_SHARE, true)
 SCHED_FEAT(LB_MIN, false)
 
+/*
+ * Pack small waking tasks onto busy CPUs that have room for them at the
+ * current frequency when the energy model says it is cheaper than
+ * waking an idle CPU. Needs an energy model from the platform.
+ */
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+SCHED_FEAT(ENERGY_AWARE, true)
+#endif
+
 /*
  * Apply the automatic NUMA scheduling policy. Enabled automatically
  * at runtime if running on a NUMA machine. Can be controlled via
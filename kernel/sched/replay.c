@@ -0,0 +1,617 @@
+/*
+ * Scheduler workload replay.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ *
+ * Replays per task run/sleep patterns, as extracted offline from
+ * sched_switch/sched_wakeup traces, with one kthread per recorded task,
+ * so that placement, DVFS and idle policy changes can be compared on
+ * the same load.  Each line written to sched_replay/trace in debugfs is
+ *
+ *	<task id> <run usec> <sleep usec>
+ *
+ * and the lines of a task are replayed in order.  A run phase is a
+ * fixed amount of work (loops_per_us busy loops per usec), so it takes
+ * longer at lower frequencies, as the recorded work would.  Writing
+ * "start" to sched_replay/control runs the trace to completion; the
+ * frequency and idle residency of every CPU, an energy estimate from
+ * the registered energy model and the wakeup latency of the replay
+ * threads are then readable from sched_replay/report.
+ */
+
+#include <linux/cpu.h>
+#include <linux/cpufreq.h>
+#include <linux/debugfs.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+#include <linux/sched_energy.h>
+#include <linux/seq_file.h>
+#include <linux/slab.h>
+#include <linux/tick.h>
+#include <linux/uaccess.h>
+#include <linux/vmalloc.h>
+
+#include "sched.h"
+
+#define REPLAY_MAX_TASKS	64
+#define REPLAY_MAX_FREQS	32
+#define REPLAY_LAT_BUCKETS	16
+#define REPLAY_TRACE_MAX_BYTES	(1024 * 1024)
+
+struct replay_phase {
+	u32 run_us;
+	u32 sleep_us;
+};
+
+struct replay_task {
+	int id;
+	struct replay_phase *phases;
+	unsigned int nr_phases;
+	struct task_struct *thread;
+};
+
+/* Time spent at each frequency since the start of the run */
+struct replay_cpu {
+	spinlock_t lock;
+	unsigned int cur_freq;
+	u64 last_ns;
+	u64 last_idle_us;
+	unsigned int nr_freqs;
+	unsigned int freqs[REPLAY_MAX_FREQS];
+	u64 busy_ns[REPLAY_MAX_FREQS];
+	u64 idle_ns[REPLAY_MAX_FREQS];
+};
+
+static DEFINE_MUTEX(replay_mutex);
+static DEFINE_PER_CPU(struct replay_cpu, replay_cpu);
+
+static char *replay_text;
+static size_t replay_text_len;
+
+static struct replay_task replay_tasks[REPLAY_MAX_TASKS];
+static int replay_nr_tasks;
+static unsigned int replay_nr_phases;
+
+static u32 replay_loops_per_us;
+static atomic_t replay_running;
+static bool replay_abort;
+static DECLARE_COMPLETION(replay_done);
+static u64 replay_duration_ns;
+static bool replay_valid;
+
+/* Wakeup latency of all replay threads, hrtimer expiry to running */
+static DEFINE_SPINLOCK(replay_lat_lock);
+static unsigned int replay_lat_hist[REPLAY_LAT_BUCKETS];
+static unsigned int replay_lat_count;
+static u64 replay_lat_total_ns;
+static u64 replay_lat_max_ns;
+
+static void replay_free_tasks(void)
+{
+	int i;
+
+	for (i = 0; i < replay_nr_tasks; i++)
+		kfree(replay_tasks[i].phases);
+	memset(replay_tasks, 0, sizeof(replay_tasks));
+	replay_nr_tasks = 0;
+	replay_nr_phases = 0;
+}
+
+static struct replay_task *replay_find_task(int id, bool create)
+{
+	int i;
+
+	for (i = 0; i < replay_nr_tasks; i++)
+		if (replay_tasks[i].id == id)
+			return &replay_tasks[i];
+
+	if (!create || replay_nr_tasks == REPLAY_MAX_TASKS)
+		return NULL;
+
+	replay_tasks[replay_nr_tasks].id = id;
+	return &replay_tasks[replay_nr_tasks++];
+}
+
+/*
+ * Two passes over the text: count the phases of every task, then fill
+ * them in.
+ */
+static int replay_parse(void)
+{
+	struct replay_task *t;
+	unsigned int run_us, sleep_us;
+	char *line, *next;
+	int pass, id;
+
+	replay_free_tasks();
+
+	for (pass = 0; pass < 2; pass++) {
+		for (line = replay_text; line < replay_text + replay_text_len;
+		     line = next + 1) {
+			next = strchr(line, '\n');
+			if (!next)
+				break;
+			if (*line == '#' || line == next)
+				continue;
+			if (sscanf(line, "%d %u %u", &id, &run_us,
+				   &sleep_us) != 3) {
+				pr_err("sched_replay: bad line '%.*s'\n",
+				       (int)(next - line), line);
+				goto err;
+			}
+
+			t = replay_find_task(id, !pass);
+			if (!t) {
+				pr_err("sched_replay: more than %d tasks\n",
+				       REPLAY_MAX_TASKS);
+				goto err;
+			}
+			if (!pass) {
+				t->nr_phases++;
+				continue;
+			}
+			t->phases[t->nr_phases].run_us = run_us;
+			t->phases[t->nr_phases].sleep_us = sleep_us;
+			t->nr_phases++;
+			replay_nr_phases++;
+		}
+
+		if (pass)
+			break;
+		for (id = 0; id < replay_nr_tasks; id++) {
+			t = &replay_tasks[id];
+			t->phases = kcalloc(t->nr_phases, sizeof(*t->phases),
+					    GFP_KERNEL);
+			if (!t->phases)
+				goto err;
+			t->nr_phases = 0;
+		}
+	}
+
+	return replay_nr_tasks ? 0 : -EINVAL;
+
+err:
+	replay_free_tasks();
+	return -EINVAL;
+}
+
+static noinline void replay_spin_loops(u32 loops)
+{
+	while (loops--)
+		cpu_relax();
+}
+
+static void replay_spin(u32 run_us)
+{
+	u64 loops = (u64)run_us * replay_loops_per_us;
+
+	/* In chunks of about 1ms of work so that we can be preempted */
+	while (loops && !ACCESS_ONCE(replay_abort)) {
+		u32 chunk = min_t(u64, loops, replay_loops_per_us * 1000);
+
+		replay_spin_loops(chunk);
+		loops -= chunk;
+		cond_resched();
+	}
+}
+
+static void replay_wakeup_latency(u64 ns)
+{
+	unsigned long flags;
+	u64 us = ns;
+	int bucket = 0;
+
+	do_div(us, NSEC_PER_USEC);
+	while (us && bucket < REPLAY_LAT_BUCKETS - 1) {
+		us >>= 1;
+		bucket++;
+	}
+
+	spin_lock_irqsave(&replay_lat_lock, flags);
+	replay_lat_hist[bucket]++;
+	replay_lat_count++;
+	replay_lat_total_ns += ns;
+	if (ns > replay_lat_max_ns)
+		replay_lat_max_ns = ns;
+	spin_unlock_irqrestore(&replay_lat_lock, flags);
+}
+
+static int replay_thread(void *data)
+{
+	struct replay_task *t = data;
+	struct replay_phase *p;
+	ktime_t expires, now;
+	unsigned int i;
+
+	for (i = 0; i < t->nr_phases && !ACCESS_ONCE(replay_abort); i++) {
+		p = &t->phases[i];
+		replay_spin(p->run_us);
+		if (!p->sleep_us)
+			continue;
+
+		expires = ktime_add_us(ktime_get(), p->sleep_us);
+		set_current_state(TASK_UNINTERRUPTIBLE);
+		schedule_hrtimeout_range(&expires, 0, HRTIMER_MODE_ABS);
+		now = ktime_get();
+		if (ktime_compare(now, expires) > 0)
+			replay_wakeup_latency(ktime_to_ns(ktime_sub(now,
+								    expires)));
+	}
+
+	if (atomic_dec_and_test(&replay_running))
+		complete(&replay_done);
+
+	while (!kthread_should_stop()) {
+		set_current_state(TASK_INTERRUPTIBLE);
+		if (!kthread_should_stop())
+			schedule();
+		__set_current_state(TASK_RUNNING);
+	}
+
+	return 0;
+}
+
+/* Charge the time since the last update to the current frequency */
+static void replay_cpu_account(int cpu, u64 now)
+{
+	struct replay_cpu *rc = &per_cpu(replay_cpu, cpu);
+	u64 idle_us = get_cpu_idle_time_us(cpu, NULL);
+	u64 wall, idle = 0;
+	unsigned int i;
+
+	wall = now - rc->last_ns;
+	/* -1 without NO_HZ: everything is then counted as busy */
+	if (idle_us != -1ULL) {
+		idle = (idle_us - rc->last_idle_us) * NSEC_PER_USEC;
+		rc->last_idle_us = idle_us;
+	}
+	idle = min(idle, wall);
+	rc->last_ns = now;
+
+	for (i = 0; i < rc->nr_freqs; i++)
+		if (rc->freqs[i] == rc->cur_freq)
+			break;
+	if (i == rc->nr_freqs) {
+		if (i == REPLAY_MAX_FREQS)
+			return;
+		rc->freqs[rc->nr_freqs++] = rc->cur_freq;
+	}
+	rc->busy_ns[i] += wall - idle;
+	rc->idle_ns[i] += idle;
+}
+
+static int replay_cpufreq_notifier(struct notifier_block *nb,
+				   unsigned long val, void *data)
+{
+	struct cpufreq_freqs *freq = data;
+	struct replay_cpu *rc = &per_cpu(replay_cpu, freq->cpu);
+	unsigned long flags;
+
+	if (val != CPUFREQ_POSTCHANGE)
+		return NOTIFY_OK;
+
+	spin_lock_irqsave(&rc->lock, flags);
+	replay_cpu_account(freq->cpu, ktime_to_ns(ktime_get()));
+	rc->cur_freq = freq->new;
+	spin_unlock_irqrestore(&rc->lock, flags);
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block replay_cpufreq_nb = {
+	.notifier_call = replay_cpufreq_notifier,
+};
+
+static void replay_cpus_start(void)
+{
+	struct replay_cpu *rc;
+	u64 now = ktime_to_ns(ktime_get());
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		spin_lock_irq(&rc->lock);
+		rc->nr_freqs = 0;
+		memset(rc->busy_ns, 0, sizeof(rc->busy_ns));
+		memset(rc->idle_ns, 0, sizeof(rc->idle_ns));
+		rc->cur_freq = cpufreq_quick_get(cpu);
+		rc->last_ns = now;
+		rc->last_idle_us = get_cpu_idle_time_us(cpu, NULL);
+		spin_unlock_irq(&rc->lock);
+	}
+}
+
+static void replay_cpus_stop(void)
+{
+	struct replay_cpu *rc;
+	u64 now = ktime_to_ns(ktime_get());
+	int cpu;
+
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		spin_lock_irq(&rc->lock);
+		replay_cpu_account(cpu, now);
+		spin_unlock_irq(&rc->lock);
+	}
+}
+
+static void replay_calibrate(void)
+{
+	const u32 loops = 1000000;
+	u64 start, ns;
+
+	preempt_disable();
+	start = ktime_to_ns(ktime_get());
+	replay_spin_loops(loops);
+	ns = ktime_to_ns(ktime_get()) - start;
+	preempt_enable();
+
+	replay_loops_per_us = max_t(u64, 1, div64_u64((u64)loops *
+						NSEC_PER_USEC, ns ?: 1));
+	pr_info("sched_replay: calibrated %u loops per usec at %u kHz\n",
+		replay_loops_per_us, cpufreq_quick_get(raw_smp_processor_id()));
+}
+
+static int replay_run(void)
+{
+	struct replay_task *t;
+	u64 start;
+	int i, ret;
+
+	ret = replay_parse();
+	if (ret)
+		return ret;
+
+	if (!replay_loops_per_us)
+		replay_calibrate();
+
+	spin_lock_irq(&replay_lat_lock);
+	memset(replay_lat_hist, 0, sizeof(replay_lat_hist));
+	replay_lat_count = 0;
+	replay_lat_total_ns = 0;
+	replay_lat_max_ns = 0;
+	spin_unlock_irq(&replay_lat_lock);
+
+	replay_valid = false;
+	replay_abort = false;
+	INIT_COMPLETION(replay_done);
+	atomic_set(&replay_running, replay_nr_tasks);
+
+	for (i = 0; i < replay_nr_tasks; i++) {
+		t = &replay_tasks[i];
+		t->thread = kthread_create(replay_thread, t, "replay/%d",
+					   t->id);
+		if (IS_ERR(t->thread)) {
+			ret = PTR_ERR(t->thread);
+			t->thread = NULL;
+			goto stop;
+		}
+	}
+
+	cpufreq_register_notifier(&replay_cpufreq_nb,
+				  CPUFREQ_TRANSITION_NOTIFIER);
+	replay_cpus_start();
+	start = ktime_to_ns(ktime_get());
+
+	for (i = 0; i < replay_nr_tasks; i++)
+		wake_up_process(replay_tasks[i].thread);
+
+	if (wait_for_completion_interruptible(&replay_done)) {
+		replay_abort = true;
+		wait_for_completion(&replay_done);
+		ret = -EINTR;
+	}
+
+	replay_duration_ns = ktime_to_ns(ktime_get()) - start;
+	replay_cpus_stop();
+	cpufreq_unregister_notifier(&replay_cpufreq_nb,
+				    CPUFREQ_TRANSITION_NOTIFIER);
+	replay_valid = !ret;
+
+stop:
+	/* Threads that never ran exit without running their phases */
+	replay_abort = true;
+	for (i = 0; i < replay_nr_tasks; i++) {
+		if (replay_tasks[i].thread)
+			kthread_stop(replay_tasks[i].thread);
+		replay_tasks[i].thread = NULL;
+	}
+
+	return ret;
+}
+
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+/* Power of the lowest operating point at or above @freq */
+static unsigned int replay_opp_power(unsigned int freq)
+{
+	const struct sched_energy *em = sched_energy_model;
+	int i;
+
+	for (i = 0; i < em->nr_opps - 1; i++)
+		if (em->opps[i].freq >= freq)
+			break;
+
+	return em->opps[i].power;
+}
+
+static void replay_show_energy(struct seq_file *m)
+{
+	const struct sched_energy *em = sched_energy_model;
+	struct replay_cpu *rc;
+	u64 busy = 0, idle = 0;
+	unsigned int idle_power;
+	int cpu, i;
+
+	if (!em) {
+		seq_puts(m, "energy: no energy model registered\n");
+		return;
+	}
+
+	/* A CPU with nothing to run sits in the deepest idle state */
+	idle_power = em->idle_states[em->nr_idle_states - 1].power;
+
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		for (i = 0; i < rc->nr_freqs; i++) {
+			busy += div_u64(rc->busy_ns[i], NSEC_PER_USEC) *
+				replay_opp_power(rc->freqs[i]);
+			idle += div_u64(rc->idle_ns[i], NSEC_PER_USEC) *
+				idle_power;
+		}
+	}
+
+	seq_printf(m, "energy: busy %llu idle %llu total %llu (power x ms)\n",
+		   div_u64(busy, USEC_PER_MSEC), div_u64(idle, USEC_PER_MSEC),
+		   div_u64(busy + idle, USEC_PER_MSEC));
+}
+#else
+static void replay_show_energy(struct seq_file *m)
+{
+}
+#endif
+
+static int replay_report_show(struct seq_file *m, void *unused)
+{
+	struct replay_cpu *rc;
+	int cpu, i;
+
+	mutex_lock(&replay_mutex);
+	if (!replay_valid) {
+		seq_puts(m, "no completed run\n");
+		goto out;
+	}
+
+	seq_printf(m, "tasks %d phases %u duration %llu ms loops_per_us %u\n",
+		   replay_nr_tasks, replay_nr_phases,
+		   div_u64(replay_duration_ns, NSEC_PER_MSEC),
+		   replay_loops_per_us);
+
+	for_each_possible_cpu(cpu) {
+		rc = &per_cpu(replay_cpu, cpu);
+		seq_printf(m, "cpu%d:\n", cpu);
+		for (i = 0; i < rc->nr_freqs; i++)
+			seq_printf(m, "  %8u kHz busy %8llu ms idle %8llu ms\n",
+				   rc->freqs[i],
+				   div_u64(rc->busy_ns[i], NSEC_PER_MSEC),
+				   div_u64(rc->idle_ns[i], NSEC_PER_MSEC));
+	}
+
+	replay_show_energy(m);
+
+	seq_printf(m, "wakeup latency: n %u avg %llu us max %llu us\n",
+		   replay_lat_count,
+		   replay_lat_count ? div_u64(div_u64(replay_lat_total_ns,
+			replay_lat_count), NSEC_PER_USEC) : 0,
+		   div_u64(replay_lat_max_ns, NSEC_PER_USEC));
+	for (i = 0; i < REPLAY_LAT_BUCKETS; i++)
+		if (replay_lat_hist[i])
+			seq_printf(m, "  < %6u us: %u\n", 1 << i,
+				   replay_lat_hist[i]);
+out:
+	mutex_unlock(&replay_mutex);
+	return 0;
+}
+
+static int replay_report_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, replay_report_show, NULL);
+}
+
+static const struct file_operations replay_report_fops = {
+	.open		= replay_report_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
+static ssize_t replay_trace_write(struct file *file, const char __user *ubuf,
+				  size_t cnt, loff_t *ppos)
+{
+	ssize_t ret = cnt;
+
+	mutex_lock(&replay_mutex);
+	if (!*ppos)
+		replay_text_len = 0;
+	if (*ppos != replay_text_len) {
+		ret = -EINVAL;
+		goto out;
+	}
+	if (cnt > REPLAY_TRACE_MAX_BYTES - replay_text_len) {
+		ret = -EFBIG;
+		goto out;
+	}
+	if (!replay_text) {
+		replay_text = vmalloc(REPLAY_TRACE_MAX_BYTES);
+		if (!replay_text) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+	if (copy_from_user(replay_text + replay_text_len, ubuf, cnt)) {
+		ret = -EFAULT;
+		goto out;
+	}
+	replay_text_len += cnt;
+	*ppos += cnt;
+out:
+	mutex_unlock(&replay_mutex);
+	return ret;
+}
+
+static const struct file_operations replay_trace_fops = {
+	.write		= replay_trace_write,
+};
+
+static ssize_t replay_control_write(struct file *file,
+				    const char __user *ubuf,
+				    size_t cnt, loff_t *ppos)
+{
+	char buf[16];
+	int ret;
+
+	if (cnt >= sizeof(buf))
+		return -EINVAL;
+	if (copy_from_user(buf, ubuf, cnt))
+		return -EFAULT;
+	buf[cnt] = 0;
+
+	if (strcmp(strstrip(buf), "start"))
+		return -EINVAL;
+
+	mutex_lock(&replay_mutex);
+	ret = replay_text ? replay_run() : -EINVAL;
+	mutex_unlock(&replay_mutex);
+
+	return ret ? ret : cnt;
+}
+
+static const struct file_operations replay_control_fops = {
+	.write		= replay_control_write,
+};
+
+static int __init sched_replay_init(void)
+{
+	struct dentry *dir;
+	int cpu;
+
+	for_each_possible_cpu(cpu)
+		spin_lock_init(&per_cpu(replay_cpu, cpu).lock);
+
+	dir = debugfs_create_dir("sched_replay", NULL);
+	if (!dir)
+		return -ENOMEM;
+
+	debugfs_create_file("trace", S_IWUSR, dir, NULL, &replay_trace_fops);
+	debugfs_create_file("control", S_IWUSR, dir, NULL,
+			    &replay_control_fops);
+	debugfs_create_file("report", S_IRUSR, dir, NULL,
+			    &replay_report_fops);
+	/* 0 recalibrates on the next start, at the current frequency */
+	debugfs_create_u32("loops_per_us", S_IRUSR | S_IWUSR, dir,
+			   &replay_loops_per_us);
+
+	return 0;
+}
+late_initcall(sched_replay_init);
@@ -117,6 +117,13 @@ struct cfs_bandwidth {
 	ktime_t period;
 	u64 quota, runtime;
 	s64 hierarchal_quota;
+	/*
+	 * quota is what is in force; user_quota is the one set through
+	 * cpu.cfs_quota_us and input_quota the tighter one applied for a
+	 * while after user input, both protected by cfs_constraints_mutex.
+	 */
+	u64 user_quota, input_quota;
+	struct list_head input_node;
 	u64 runtime_expires;
 
 	int idle, timer_active;
@@ -129,11 +136,25 @@ struct cfs_bandwidth {
 #endif
 };
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+struct sched_lat_hist {
+	u32 bucket[SCHED_LAT_HIST_BUCKETS];
+};
+#endif
+
 /* task group related information */
 struct task_group {
 	struct cgroup_subsys_state css;
 
 	bool notify_on_migrate;
+#ifdef CONFIG_SCHED_TUNE
+	/* percentage of spare capacity added to the group's utilization */
+	unsigned int boost;
+#endif
+#ifdef CONFIG_SCHED_LATENCY_HIST
+	/* wakeup latency of member tasks, per cpu */
+	struct sched_lat_hist __percpu *lat_hist;
+#endif
 
 #ifdef CONFIG_FAIR_GROUP_SCHED
 	/* schedulable entities of this group on each cpu */
@@ -211,7 +232,7 @@ extern void init_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
 extern int sched_group_set_shares(struct task_group *tg, unsigned long shares);
 
 extern void __refill_cfs_bandwidth_runtime(struct cfs_bandwidth *cfs_b);
-extern void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b);
+extern void __start_cfs_bandwidth(struct cfs_bandwidth *cfs_b, bool force);
 extern void unthrottle_cfs_rq(struct cfs_rq *cfs_rq);
 
 extern void free_rt_sched_group(struct task_group *tg);
@@ -694,6 +715,13 @@ static inline bool task_notify_on_migrate(struct task_struct *p)
 	return task_group(p)->notify_on_migrate;
 }
 
+#ifdef CONFIG_SCHED_TUNE
+static inline unsigned int task_boost(struct task_struct *p)
+{
+	return max(task_group(p)->boost, ACCESS_ONCE(p->boost_hint));
+}
+#endif
+
 /* Change a task's cfs_rq and parent entity if it moves across CPUs/groups */
 static inline void set_task_rq(struct task_struct *p, unsigned int cpu)
 {
@@ -1189,6 +1217,62 @@ static inline void sched_rt_avg_update(struct rq *rq, u64 rt_delta) { }
 static inline void sched_avg_update(struct rq *rq) { }
 #endif
 
+#ifdef CONFIG_SCHED_TUNE
+extern unsigned int rq_boost(struct rq *rq);
+
+/* Add @boost percent of the capacity left above @util */
+static inline unsigned long boosted_util(unsigned long util,
+					 unsigned int boost)
+{
+	return util + (SCHED_POWER_SCALE - util) * boost / 100;
+}
+#endif
+
+#ifdef CONFIG_CPU_FREQ
+DECLARE_PER_CPU(struct update_util_data *, cpufreq_update_util_data);
+
+/**
+ * cpufreq_update_util - Report the runqueue's utilization to cpufreq.
+ * @rq: Runqueue whose load average has just been updated.
+ *
+ * Passes the runnable fraction of the runqueue's per-entity load average,
+ * scaled to SCHED_POWER_SCALE and boosted by the groups runnable on it
+ * (CONFIG_SCHED_TUNE), to the governor hook registered for its CPU.
+ * Only the local runqueue is reported, so the hook always runs on the CPU
+ * it describes.
+ *
+ * Called with the runqueue lock held; the hook is protected by RCU-sched.
+ */
+static inline void cpufreq_update_util(struct rq *rq)
+{
+	struct update_util_data *data;
+	unsigned long util;
+
+	if (cpu_of(rq) != smp_processor_id())
+		return;
+
+	data = rcu_dereference_sched(*this_cpu_ptr(&cpufreq_update_util_data));
+	if (!data)
+		return;
+
+	util = ((unsigned long)rq->avg.runnable_avg_sum << SCHED_POWER_SHIFT) /
+		(rq->avg.runnable_avg_period + 1);
+	util = min_t(unsigned long, util, SCHED_POWER_SCALE);
+#ifdef CONFIG_SCHED_TUNE
+	util = boosted_util(util, rq_boost(rq));
+#endif
+	data->func(data, rq->clock, util, SCHED_POWER_SCALE);
+}
+#else
+static inline void cpufreq_update_util(struct rq *rq) { }
+#endif /* CONFIG_CPU_FREQ */
+
+#ifdef CONFIG_SCHED_ENERGY_AWARE
+struct sched_energy;
+extern const struct sched_energy *sched_energy_model;
+DECLARE_PER_CPU(unsigned int, sched_energy_freq);
+#endif
+
 extern void start_bandwidth_timer(struct hrtimer *period_timer, ktime_t period);
 
 #ifdef CONFIG_SMP
@@ -17,14 +17,110 @@
 #include <linux/percpu.h>
 #include <linux/hrtimer.h>
 #include <linux/sched.h>
+#include <linux/seqlock.h>
 #include <linux/math64.h>
 
-static DEFINE_PER_CPU(u64, nr_prod_sum);
-static DEFINE_PER_CPU(u64, last_time);
-static DEFINE_PER_CPU(u64, nr);
-static DEFINE_PER_CPU(unsigned long, iowait_prod_sum);
-static DEFINE_PER_CPU(spinlock_t, nr_lock) = __SPIN_LOCK_UNLOCKED(nr_lock);
-static s64 last_get_time;
+/*
+ * Every cpu accumulates nr_running * time and nr_iowait * time.  The
+ * writer is always called with the runqueue lock of @cpu held, which
+ * serializes updates; readers use the seqcount and never block the
+ * scheduler.
+ *
+ * Besides the cumulative sums, each aging window keeps the sum of the
+ * current period and of the previous complete one.  Readers combine the
+ * two into an estimate of the average over the last window length.
+ */
+struct nr_avg_win {
+	u64 start;
+	u64 cur, prev;
+	u64 io_cur, io_prev;
+};
+
+struct nr_stats {
+	seqcount_t seq;
+	u64 last_time;
+	unsigned long nr;
+	u64 nr_prod_sum;
+	u64 iowait_prod_sum;
+	struct nr_avg_win win[SCHED_NR_AVG_WINDOWS];
+};
+
+static const u64 nr_avg_win_len[SCHED_NR_AVG_WINDOWS] = {
+	[SCHED_NR_AVG_10MS]	= 10 * NSEC_PER_MSEC,
+	[SCHED_NR_AVG_50MS]	= 50 * NSEC_PER_MSEC,
+	[SCHED_NR_AVG_200MS]	= 200 * NSEC_PER_MSEC,
+};
+
+static DEFINE_PER_CPU(struct nr_stats, nr_stats);
+
+/* state of sched_get_nr_running_avg(), which has a single caller */
+static DEFINE_PER_CPU(u64, last_nr_prod_sum);
+static DEFINE_PER_CPU(u64, last_iowait_prod_sum);
+static u64 last_get_time;
+
+static void nr_avg_win_account(struct nr_avg_win *w, u64 len, u64 now,
+			       u64 delta, unsigned long nr, unsigned long io)
+{
+	u64 end = w->start + len;
+
+	if (now < end) {
+		w->cur += nr * delta;
+		w->io_cur += io * delta;
+		return;
+	}
+
+	if (now >= end + len) {
+		/* idle for longer than a window, nothing is left to age */
+		w->prev = nr * len;
+		w->io_prev = io * len;
+		w->start = now;
+		w->cur = 0;
+		w->io_cur = 0;
+		return;
+	}
+
+	w->prev = w->cur + nr * (end - (now - delta));
+	w->io_prev = w->io_cur + io * (end - (now - delta));
+	w->start = end;
+	w->cur = nr * (now - end);
+	w->io_cur = io * (now - end);
+}
+
+/* Account the time since the last update at the previous nr_running */
+static void nr_stats_account(struct nr_stats *ns, u64 now, unsigned long io)
+{
+	u64 delta;
+	int i;
+
+	if (now <= ns->last_time)
+		return;
+
+	delta = now - ns->last_time;
+	ns->last_time = now;
+	ns->nr_prod_sum += ns->nr * delta;
+	ns->iowait_prod_sum += io * delta;
+
+	for (i = 0; i < SCHED_NR_AVG_WINDOWS; i++)
+		nr_avg_win_account(&ns->win[i], nr_avg_win_len[i], now, delta,
+				   ns->nr, io);
+}
+
+/*
+ * Take a consistent copy of @cpu's statistics, brought forward to @now
+ * as if nr_running had been updated at that time.
+ */
+static void nr_stats_snapshot(int cpu, u64 now, struct nr_stats *snap)
+{
+	struct nr_stats *ns = &per_cpu(nr_stats, cpu);
+	unsigned seq;
+
+	do {
+		seq = read_seqcount_begin(&ns->seq);
+		*snap = *ns;
+	} while (read_seqcount_retry(&ns->seq, seq));
+
+	nr_stats_account(snap, now, nr_iowait_cpu(cpu));
+}
 
 /**
  * sched_get_nr_running_avg
@@ -49,21 +145,15 @@ void sched_get_nr_running_avg(int *avg, int *iowait_avg)
 		return;
 
 	last_get_time = curr_time;
-	/* read and reset nr_running counts */
 	for_each_possible_cpu(cpu) {
-		unsigned long flags;
-
-		spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
-		tmp_avg += per_cpu(nr_prod_sum, cpu);
-		tmp_avg += per_cpu(nr, cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		tmp_iowait = per_cpu(iowait_prod_sum, cpu);
-		tmp_iowait +=  nr_iowait_cpu(cpu) *
-			(curr_time - per_cpu(last_time, cpu));
-		per_cpu(last_time, cpu) = curr_time;
-		per_cpu(nr_prod_sum, cpu) = 0;
-		per_cpu(iowait_prod_sum, cpu) = 0;
-		spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+		struct nr_stats snap;
+
+		nr_stats_snapshot(cpu, curr_time, &snap);
+		tmp_avg += snap.nr_prod_sum - per_cpu(last_nr_prod_sum, cpu);
+		tmp_iowait += snap.iowait_prod_sum -
+			per_cpu(last_iowait_prod_sum, cpu);
+		per_cpu(last_nr_prod_sum, cpu) = snap.nr_prod_sum;
+		per_cpu(last_iowait_prod_sum, cpu) = snap.iowait_prod_sum;
 	}
 
 	*avg = (int)div64_u64(tmp_avg * 100, diff);
@@ -76,6 +166,50 @@ void sched_get_nr_running_avg(int *avg, int *iowait_avg)
 }
 EXPORT_SYMBOL(sched_get_nr_running_avg);
 
+/**
+ * sched_get_nr_running_avg_window
+ * @window: One of the SCHED_NR_AVG_* aging windows.
+ * @return: Average nr_running and iowait value, summed over all cpus,
+ *	    over roughly the last window length.  Returns the avg * 100
+ *	    to return up to two decimal points of accuracy.
+ *
+ * Unlike sched_get_nr_running_avg() this does not reset anything and
+ * may be called concurrently from any context.
+ */
+void sched_get_nr_running_avg_window(int window, int *avg, int *iowait_avg)
+{
+	u64 len, now = sched_clock();
+	u64 tmp_avg = 0, tmp_iowait = 0;
+	int cpu;
+
+	*avg = 0;
+	*iowait_avg = 0;
+
+	if (WARN_ON(window < 0 || window >= SCHED_NR_AVG_WINDOWS))
+		return;
+
+	len = nr_avg_win_len[window];
+	for_each_possible_cpu(cpu) {
+		struct nr_stats snap;
+		struct nr_avg_win *w = &snap.win[window];
+		u64 elapsed, aged;
+
+		nr_stats_snapshot(cpu, now, &snap);
+		elapsed = now > w->start ? min(now - w->start, len) : 0;
+
+		/* the part of the previous period still inside the window */
+		aged = len - elapsed;
+		tmp_avg += div64_u64(w->cur * 100, len) +
+			div64_u64(div64_u64(w->prev * 100, len) * aged, len);
+		tmp_iowait += div64_u64(w->io_cur * 100, len) +
+			div64_u64(div64_u64(w->io_prev * 100, len) * aged, len);
+	}
+
+	*avg = (int)tmp_avg;
+	*iowait_avg = (int)tmp_iowait;
+}
+EXPORT_SYMBOL(sched_get_nr_running_avg_window);
+
 /**
  * sched_update_nr_prod
  * @cpu: The core id of the nr running driver.
@@ -83,24 +217,16 @@ EXPORT_SYMBOL(sched_get_nr_running_avg);
  * @inc: Whether we are increasing or decreasing the count
  * @return: N/A
  *
- * Update average with latest nr_running value for CPU
+ * Update average with latest nr_running value for CPU.  Called with the
+ * runqueue lock of @cpu held.
  */
 void sched_update_nr_prod(int cpu, unsigned long nr_running, bool inc)
 {
-	int diff;
-	s64 curr_time;
-	unsigned long flags;
-
-	spin_lock_irqsave(&per_cpu(nr_lock, cpu), flags);
-	curr_time = sched_clock();
-	diff = curr_time - per_cpu(last_time, cpu);
-	per_cpu(last_time, cpu) = curr_time;
-	per_cpu(nr, cpu) = nr_running + (inc ? 1 : -1);
-
-	BUG_ON(per_cpu(nr, cpu) < 0);
+	struct nr_stats *ns = &per_cpu(nr_stats, cpu);
 
-	per_cpu(nr_prod_sum, cpu) += nr_running * diff;
-	per_cpu(iowait_prod_sum, cpu) += nr_iowait_cpu(cpu) * diff;
-	spin_unlock_irqrestore(&per_cpu(nr_lock, cpu), flags);
+	write_seqcount_begin(&ns->seq);
+	nr_stats_account(ns, sched_clock(), nr_iowait_cpu(cpu));
+	ns->nr = nr_running + (inc ? 1 : -1);
+	write_seqcount_end(&ns->seq);
 }
 EXPORT_SYMBOL(sched_update_nr_prod);
@@ -137,6 +137,71 @@ static const struct file_operations proc_schedstat_operations = {
 	.release = seq_release,
 };
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+static inline unsigned int sched_lat_bucket(u64 delta)
+{
+	u64 us = div_u64(delta, NSEC_PER_USEC);
+
+	if (!us)
+		return 0;
+
+	return min_t(unsigned int, fls64(us), SCHED_LAT_HIST_BUCKETS - 1);
+}
+
+/*
+ * Called with the runqueue lock held when @p is picked to run.  Only the
+ * first pick after a wakeup is accounted; preemption and yield are not
+ * wakeup latency.
+ */
+void sched_lat_arrive(struct rq *rq, struct task_struct *p)
+{
+	u64 start = p->se.statistics.wakeup_lat_start;
+	s64 delta;
+	unsigned int bucket;
+
+	if (!start)
+		return;
+
+	p->se.statistics.wakeup_lat_start = 0;
+
+	/* the task may have been migrated to a cpu whose clock lags */
+	delta = rq->clock - start;
+	bucket = sched_lat_bucket(delta > 0 ? delta : 0);
+
+	p->se.statistics.wakeup_lat_hist[bucket]++;
+#ifdef CONFIG_CGROUP_SCHED
+	per_cpu_ptr(task_group(p)->lat_hist, cpu_of(rq))->bucket[bucket]++;
+#endif
+}
+
+void sched_lat_hist_show(struct seq_file *m, const u32 *hist)
+{
+	unsigned int i, lo = 0, hi = 1;
+
+	for (i = 0; i < SCHED_LAT_HIST_BUCKETS - 1; i++) {
+		seq_printf(m, "%6u - %-6u us : %u\n", lo, hi, hist[i]);
+		lo = hi;
+		hi <<= 1;
+	}
+	seq_printf(m, "%6u - %-6s us : %u\n", lo, "inf", hist[i]);
+}
+
+void proc_sched_lat_show_task(struct task_struct *p, struct seq_file *m)
+{
+	u32 hist[SCHED_LAT_HIST_BUCKETS];
+
+	/* racy snapshot, the histogram is only written under the rq lock */
+	memcpy(hist, p->se.statistics.wakeup_lat_hist, sizeof(hist));
+	sched_lat_hist_show(m, hist);
+}
+
+void proc_sched_lat_set_task(struct task_struct *p)
+{
+	memset(p->se.statistics.wakeup_lat_hist, 0,
+	       sizeof(p->se.statistics.wakeup_lat_hist));
+}
+#endif /* CONFIG_SCHED_LATENCY_HIST */
+
 static int __init proc_schedstat_init(void)
 {
 	proc_create("schedstat", 0, NULL, &proc_schedstat_operations);
@@ -47,6 +47,24 @@ rq_sched_info_depart(struct rq *rq, unsigned long long delta)
 # define schedstat_set(var, val)	do { } while (0)
 #endif
 
+#ifdef CONFIG_SCHED_LATENCY_HIST
+/*
+ * Stamp a task that has just been enqueued by a wakeup; the latency is
+ * recorded by sched_lat_arrive() once it is picked to run.
+ */
+static inline void sched_lat_wakeup(struct rq *rq, struct task_struct *p)
+{
+	p->se.statistics.wakeup_lat_start = rq->clock;
+}
+extern void sched_lat_arrive(struct rq *rq, struct task_struct *p);
+extern void sched_lat_hist_show(struct seq_file *m, const u32 *hist);
+#else
+static inline void sched_lat_wakeup(struct rq *rq, struct task_struct *p)
+{}
+static inline void sched_lat_arrive(struct rq *rq, struct task_struct *p)
+{}
+#endif
+
 #if defined(CONFIG_SCHEDSTATS) || defined(CONFIG_TASK_DELAY_ACCT)
 static inline void sched_info_reset_dequeued(struct task_struct *t)
 {
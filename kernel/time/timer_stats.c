@@ -42,6 +42,7 @@
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/kallsyms.h>
+#include <linux/sort.h>
 
 #include <asm/uaccess.h>
 
@@ -65,9 +66,11 @@ struct entry {
 	pid_t			pid;
 
 	/*
-	 * Number of timeout events:
+	 * Number of timeout events, and how many of them happened on a
+	 * CPU that was idle:
 	 */
 	unsigned long		count;
+	unsigned long		wakeups;
 	unsigned int		timer_flag;
 
 	/*
@@ -204,6 +207,7 @@ static struct entry *tstat_lookup(struct entry *entry, char *comm)
 	if (curr) {
 		*curr = *entry;
 		curr->count = 0;
+		curr->wakeups = 0;
 		curr->next = NULL;
 		memcpy(curr->comm, comm, TASK_COMM_LEN);
 
@@ -251,16 +255,18 @@ void timer_stats_update_stats(void *timer, pid_t pid, void *startf,
 	input.start_func = startf;
 	input.expire_func = timerf;
 	input.pid = pid;
-	input.timer_flag = timer_flag;
+	input.timer_flag = timer_flag & ~TIMER_STATS_FLAG_WAKEUP;
 
 	raw_spin_lock_irqsave(lock, flags);
 	if (!timer_stats_active)
 		goto out_unlock;
 
 	entry = tstat_lookup(&input, comm);
-	if (likely(entry))
+	if (likely(entry)) {
 		entry->count++;
-	else
+		if (timer_flag & TIMER_STATS_FLAG_WAKEUP)
+			entry->wakeups++;
+	} else
 		atomic_inc(&overflow_count);
 
  out_unlock:
@@ -338,6 +344,61 @@ static int tstats_show(struct seq_file *m, void *v)
 	return 0;
 }
 
+/*
+ * /proc/timer_wakeups lists the timers of the current sample that
+ * expired on an idle CPU, the most frequent first, in the format of
+ * /proc/timer_stats:
+ */
+static struct entry *wakeup_entries[MAX_ENTRIES];
+
+static int wakeup_cmp(const void *a, const void *b)
+{
+	const struct entry *ea = *(const struct entry **)a;
+	const struct entry *eb = *(const struct entry **)b;
+
+	return (eb->wakeups > ea->wakeups) - (eb->wakeups < ea->wakeups);
+}
+
+static int twakeups_show(struct seq_file *m, void *v)
+{
+	unsigned long i, n = 0, nr = ACCESS_ONCE(nr_entries);
+	unsigned long wakeups = 0;
+	struct entry *entry;
+
+	mutex_lock(&show_mutex);
+	for (i = 0; i < nr; i++)
+		if (entries[i].wakeups)
+			wakeup_entries[n++] = entries + i;
+	sort(wakeup_entries, n, sizeof(wakeup_entries[0]), wakeup_cmp, NULL);
+
+	for (i = 0; i < n; i++) {
+		entry = wakeup_entries[i];
+		seq_printf(m, " %4lu, %5d %-16s ",
+			   entry->wakeups, entry->pid, entry->comm);
+		print_name_offset(m, (unsigned long)entry->start_func);
+		seq_puts(m, " (");
+		print_name_offset(m, (unsigned long)entry->expire_func);
+		seq_puts(m, ")\n");
+		wakeups += entry->wakeups;
+	}
+	seq_printf(m, "%lu total wakeups\n", wakeups);
+	mutex_unlock(&show_mutex);
+
+	return 0;
+}
+
+static int twakeups_open(struct inode *inode, struct file *filp)
+{
+	return single_open(filp, twakeups_show, NULL);
+}
+
+static const struct file_operations twakeups_fops = {
+	.open		= twakeups_open,
+	.read		= seq_read,
+	.llseek		= seq_lseek,
+	.release	= single_release,
+};
+
 /*
  * After a state change, make sure all concurrent lookup/update
  * activities have stopped:
@@ -418,6 +479,9 @@ static int __init init_tstats_procfs(void)
 	struct proc_dir_entry *pe;
 
 	pe = proc_create("timer_stats", 0644, NULL, &tstats_fops);
+	if (!pe)
+		return -ENOMEM;
+	pe = proc_create("timer_wakeups", 0444, NULL, &twakeups_fops);
 	if (!pe)
 		return -ENOMEM;
 	return 0;
@@ -92,6 +92,25 @@ struct tvec_base boot_tvec_bases;
 EXPORT_SYMBOL(boot_tvec_bases);
 static DEFINE_PER_CPU(struct tvec_base *, tvec_bases) = &boot_tvec_bases;
 
+#ifdef CONFIG_SMP
+/*
+ * With "deferrable_global" on the command line, deferrable timers that
+ * are not pinned go to a single base that is run by whichever CPU takes
+ * its tick first, instead of the base of the CPU that armed them.  Such a
+ * timer then never keeps a particular CPU from staying idle.
+ */
+static struct tvec_base tvec_base_deferrable;
+static bool deferrable_global __read_mostly;
+static atomic_t deferrable_running = ATOMIC_INIT(0);
+
+static int __init deferrable_global_setup(char *str)
+{
+	deferrable_global = true;
+	return 1;
+}
+__setup("deferrable_global", deferrable_global_setup);
+#endif
+
 /* Functions below help us manage 'deferrable' flag */
 static inline unsigned int tbase_get_deferrable(struct tvec_base *base)
 {
@@ -413,6 +432,8 @@ static void timer_stats_account_timer(struct timer_list *timer)
 		return;
 	if (unlikely(tbase_get_deferrable(timer->base)))
 		flag |= TIMER_STATS_FLAG_DEFERRABLE;
+	else if (is_idle_task(current))
+		flag |= TIMER_STATS_FLAG_WAKEUP;
 
 	timer_stats_update_stats(timer, timer->start_pid, timer->start_site,
 				 timer->function, timer->start_comm, flag);
@@ -747,6 +768,10 @@ __mod_timer(struct timer_list *timer, unsigned long expires,
 		cpu = get_nohz_timer_target();
 #endif
 	new_base = per_cpu(tvec_bases, cpu);
+#ifdef CONFIG_SMP
+	if (deferrable_global && !pinned && tbase_get_deferrable(timer->base))
+		new_base = &tvec_base_deferrable;
+#endif
 
 	if (base != new_base) {
 		/*
@@ -1375,6 +1400,16 @@ static void run_timer_softirq(struct softirq_action *h)
 
 	if (time_after_eq(jiffies, base->timer_jiffies))
 		__run_timers(base);
+
+#ifdef CONFIG_SMP
+	/* one CPU at a time is enough, the others have their own timers */
+	if (deferrable_global &&
+	    time_after_eq(jiffies, tvec_base_deferrable.timer_jiffies) &&
+	    !atomic_cmpxchg(&deferrable_running, 0, 1)) {
+		__run_timers(&tvec_base_deferrable);
+		atomic_set(&deferrable_running, 0);
+	}
+#endif
 }
 
 /*
@@ -1506,9 +1541,26 @@ signed long __sched schedule_timeout_uninterruptible(signed long timeout)
 }
 EXPORT_SYMBOL(schedule_timeout_uninterruptible);
 
-static int __cpuinit init_timers_cpu(int cpu)
+static void init_timer_lists(struct tvec_base *base)
 {
 	int j;
+
+	for (j = 0; j < TVN_SIZE; j++) {
+		INIT_LIST_HEAD(base->tv5.vec + j);
+		INIT_LIST_HEAD(base->tv4.vec + j);
+		INIT_LIST_HEAD(base->tv3.vec + j);
+		INIT_LIST_HEAD(base->tv2.vec + j);
+	}
+	for (j = 0; j < TVR_SIZE; j++)
+		INIT_LIST_HEAD(base->tv1.vec + j);
+
+	base->timer_jiffies = jiffies;
+	base->next_timer = base->timer_jiffies;
+	base->active_timers = 0;
+}
+
+static int __cpuinit init_timers_cpu(int cpu)
+{
 	struct tvec_base *base;
 	static char __cpuinitdata tvec_base_done[NR_CPUS];
 
@@ -1548,19 +1600,7 @@ static int __cpuinit init_timers_cpu(int cpu)
 		base = per_cpu(tvec_bases, cpu);
 	}
 
-
-	for (j = 0; j < TVN_SIZE; j++) {
-		INIT_LIST_HEAD(base->tv5.vec + j);
-		INIT_LIST_HEAD(base->tv4.vec + j);
-		INIT_LIST_HEAD(base->tv3.vec + j);
-		INIT_LIST_HEAD(base->tv2.vec + j);
-	}
-	for (j = 0; j < TVR_SIZE; j++)
-		INIT_LIST_HEAD(base->tv1.vec + j);
-
-	base->timer_jiffies = jiffies;
-	base->next_timer = base->timer_jiffies;
-	base->active_timers = 0;
+	init_timer_lists(base);
 	return 0;
 }
 
@@ -1651,6 +1691,10 @@ void __init init_timers(void)
 	err = timer_cpu_notify(&timers_nb, (unsigned long)CPU_UP_PREPARE,
 			       (void *)(long)smp_processor_id());
 	init_timer_stats();
+#ifdef CONFIG_SMP
+	spin_lock_init(&tvec_base_deferrable.lock);
+	init_timer_lists(&tvec_base_deferrable);
+#endif
 
 	BUG_ON(err != NOTIFY_OK);
 	register_cpu_notifier(&timers_nb);
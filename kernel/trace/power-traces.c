@@ -14,4 +14,8 @@
 #include <trace/events/power.h>
 
 EXPORT_TRACEPOINT_SYMBOL_GPL(cpu_idle);
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpu_boost_on);
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpu_boost_off);
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpubw_hwmon_meas);
+EXPORT_TRACEPOINT_SYMBOL_GPL(cpubw_hwmon_update);
 
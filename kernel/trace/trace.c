@@ -40,6 +40,7 @@
 #include <linux/fs.h>
 #include <linux/sched/rt.h>
 #include <linux/coresight-stm.h>
+#include <linux/trace_marker.h>
 
 #include "trace.h"
 #include "trace_output.h"
@@ -3534,6 +3535,7 @@ static const char readme_msg[] =
 	"     x86-tsc:   TSC cycle counter\n"
 #endif
 	"\n  trace_marker\t\t- Writes into this file writes into the kernel buffer\n"
+	"  trace_marker_bin\t- Same, with binary struct trace_marker_bin\n"
 	"  tracing_cpumask\t- Limit which CPUs to trace\n"
 	"  instances\t\t- Make sub-buffers with: mkdir instances/foo\n"
 	"\t\t\t  Remove sub-buffer with rmdir\n"
@@ -4696,6 +4698,69 @@ tracing_mark_write(struct file *filp, const char __user *ubuf,
 	return written;
 }
 
+/* records accepted by a single write to trace_marker_bin */
+#define TRACE_MARKER_BIN_BATCH	16
+
+/*
+ * Binary counterpart of trace_marker for frequent userspace events: the
+ * fixed size records are copied in one go and each becomes a small
+ * TRACE_MARKER_BIN event, with no formatting or page pinning involved.
+ */
+static ssize_t
+tracing_mark_bin_write(struct file *filp, const char __user *ubuf,
+		       size_t cnt, loff_t *fpos)
+{
+	struct trace_marker_bin recs[TRACE_MARKER_BIN_BATCH];
+	struct trace_array *tr = filp->private_data;
+	struct ring_buffer_event *event;
+	struct marker_bin_entry *entry;
+	struct ring_buffer *buffer;
+	unsigned long irq_flags;
+	int i, nr;
+
+	if (tracing_disabled)
+		return -EINVAL;
+
+	if (!(trace_flags & TRACE_ITER_MARKERS))
+		return -EINVAL;
+
+	if (!cnt || cnt % sizeof(recs[0]))
+		return -EINVAL;
+
+	if (cnt > sizeof(recs))
+		cnt = sizeof(recs);
+
+	if (copy_from_user(recs, ubuf, cnt))
+		return -EFAULT;
+
+	nr = cnt / sizeof(recs[0]);
+	local_save_flags(irq_flags);
+	buffer = tr->trace_buffer.buffer;
+
+	for (i = 0; i < nr; i++) {
+		event = trace_buffer_lock_reserve(buffer, TRACE_MARKER_BIN,
+						  sizeof(*entry), irq_flags,
+						  preempt_count());
+		if (!event)
+			break;
+
+		entry = ring_buffer_event_data(event);
+		entry->id = recs[i].id;
+		entry->type = recs[i].type;
+		entry->value = recs[i].value;
+		__buffer_unlock_commit(buffer, event);
+	}
+
+	/* Ring buffer disabled, return as if not open for write */
+	if (!i)
+		return -EBADF;
+
+	cnt = i * sizeof(recs[0]);
+	*fpos += cnt;
+
+	return cnt;
+}
+
 static int tracing_clock_show(struct seq_file *m, void *v)
 {
 	struct trace_array *tr = m->private;
@@ -5002,6 +5067,13 @@ static const struct file_operations tracing_mark_fops = {
 	.release	= tracing_release_generic_tr,
 };
 
+static const struct file_operations tracing_mark_bin_fops = {
+	.open		= tracing_open_generic_tr,
+	.write		= tracing_mark_bin_write,
+	.llseek		= generic_file_llseek,
+	.release	= tracing_release_generic_tr,
+};
+
 static const struct file_operations trace_clock_fops = {
 	.open		= tracing_clock_open,
 	.read		= seq_read,
@@ -6257,6 +6329,9 @@ init_tracer_debugfs(struct trace_array *tr, struct dentry *d_tracer)
 	trace_create_file("trace_marker", 0220, d_tracer,
 			  tr, &tracing_mark_fops);
 
+	trace_create_file("trace_marker_bin", 0220, d_tracer,
+			  tr, &tracing_mark_bin_fops);
+
 	trace_create_file("saved_tgids", 0444, d_tracer,
 			  tr, &tracing_saved_tgids_fops);
 
@@ -259,6 +259,22 @@ FTRACE_ENTRY(bputs, bputs_entry,
 	FILTER_OTHER
 );
 
+FTRACE_ENTRY(marker_bin, marker_bin_entry,
+
+	TRACE_MARKER_BIN,
+
+	F_STRUCT(
+		__field(	unsigned int,		id	)
+		__field(	unsigned int,		type	)
+		__field(	unsigned long long,	value	)
+	),
+
+	F_printk("id=%u type=%u value=%llu",
+		 __entry->id, __entry->type, __entry->value),
+
+	FILTER_OTHER
+);
+
 FTRACE_ENTRY(mmiotrace_rw, trace_mmiotrace_rw,
 
 	TRACE_MMIO_RW,
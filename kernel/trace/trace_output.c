@@ -1599,6 +1599,50 @@ static struct trace_event trace_print_event = {
 };
 
 
+/* TRACE_MARKER_BIN */
+static enum print_line_t trace_marker_bin_print(struct trace_iterator *iter,
+						int flags,
+						struct trace_event *event)
+{
+	static const char types[] = { 'B', 'E', 'C' };
+	struct marker_bin_entry *field;
+
+	trace_assign_type(field, iter->ent);
+
+	if (!trace_seq_printf(&iter->seq, "marker: %c id=%u value=%llu\n",
+			      field->type < ARRAY_SIZE(types) ?
+			      types[field->type] : '?',
+			      field->id, field->value))
+		return TRACE_TYPE_PARTIAL_LINE;
+
+	return TRACE_TYPE_HANDLED;
+}
+
+static enum print_line_t trace_marker_bin_raw(struct trace_iterator *iter,
+					      int flags,
+					      struct trace_event *event)
+{
+	struct marker_bin_entry *field;
+
+	trace_assign_type(field, iter->ent);
+
+	if (!trace_seq_printf(&iter->seq, "# %u %u %llu\n",
+			      field->id, field->type, field->value))
+		return TRACE_TYPE_PARTIAL_LINE;
+
+	return TRACE_TYPE_HANDLED;
+}
+
+static struct trace_event_functions trace_marker_bin_funcs = {
+	.trace		= trace_marker_bin_print,
+	.raw		= trace_marker_bin_raw,
+};
+
+static struct trace_event trace_marker_bin_event = {
+	.type		= TRACE_MARKER_BIN,
+	.funcs		= &trace_marker_bin_funcs,
+};
+
 static struct trace_event *events[] __initdata = {
 	&trace_fn_event,
 	&trace_graph_ent_event,
@@ -1610,6 +1654,7 @@ static struct trace_event *events[] __initdata = {
 	&trace_bputs_event,
 	&trace_bprint_event,
 	&trace_print_event,
+	&trace_marker_bin_event,
 	NULL
 };
 
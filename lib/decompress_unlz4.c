@@ -0,0 +1,172 @@
+/*
+ * Wrapper for decompressing LZ4-compressed kernel, initramfs, and initrd
+ *
+ * The input is in the legacy LZ4 stream format written by "lz4 -l": a
+ * little endian magic number followed by blocks, each preceded by its
+ * little endian compressed size. Every block but the last decompresses
+ * to exactly 8MiB. A stream may be the concatenation of several such
+ * streams, so the magic number may also appear between blocks.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifdef STATIC
+#define PREBOOT
+#include "lz4/lz4_decompress.c"
+#else
+#include <linux/decompress/unlz4.h>
+#endif
+
+#include <linux/types.h>
+#include <linux/lz4.h>
+#include <linux/decompress/mm.h>
+
+#include <linux/compiler.h>
+#include <asm/unaligned.h>
+
+#define LZ4_ARCHIVE_MAGIC		0x184C2102
+#define LZ4_LEGACY_BLOCK_SIZE		(8 << 20)
+
+STATIC inline int INIT unlz4(u8 *input, int in_len,
+			     int (*fill)(void *, unsigned int),
+			     int (*flush)(void *, unsigned int),
+			     u8 *output, int *posp,
+			     void (*error)(char *x))
+{
+	int ret = -1;
+	size_t max_chunksize = lz4_compressbound(LZ4_LEGACY_BLOCK_SIZE);
+	size_t chunksize, dest_len;
+	long size = in_len;
+	u8 *inp, *inp_start, *outp;
+
+	if (output) {
+		outp = output;
+	} else if (!flush) {
+		error("NULL output pointer and no flush function provided");
+		goto exit_0;
+	} else {
+		outp = large_malloc(LZ4_LEGACY_BLOCK_SIZE);
+		if (!outp) {
+			error("Could not allocate output buffer");
+			goto exit_0;
+		}
+	}
+
+	if (input && fill) {
+		error("Both input pointer and fill function provided");
+		goto exit_1;
+	} else if (input) {
+		inp = input;
+	} else if (!fill) {
+		error("NULL input pointer and missing fill function");
+		goto exit_1;
+	} else {
+		inp = large_malloc(max_chunksize);
+		if (!inp) {
+			error("Could not allocate input buffer");
+			goto exit_1;
+		}
+	}
+	inp_start = inp;
+
+	if (posp)
+		*posp = 0;
+
+	if (fill ? fill(inp, 4) < 4 : size < 4) {
+		error("invalid header");
+		goto exit_2;
+	}
+	if (get_unaligned_le32(inp) != LZ4_ARCHIVE_MAGIC) {
+		error("invalid header");
+		goto exit_2;
+	}
+	if (!fill) {
+		inp += 4;
+		size -= 4;
+	}
+	if (posp)
+		*posp += 4;
+
+	for (;;) {
+		/* The input ends after the last block */
+		if (fill ? fill(inp, 4) < 4 : size < 4)
+			break;
+
+		chunksize = get_unaligned_le32(inp);
+		if (!fill) {
+			inp += 4;
+			size -= 4;
+		}
+		if (posp)
+			*posp += 4;
+
+		/* Concatenated streams repeat the magic number */
+		if (chunksize == LZ4_ARCHIVE_MAGIC)
+			continue;
+
+		if (!chunksize || chunksize > max_chunksize) {
+			/*
+			 * An initramfs may carry padding or another archive
+			 * after the stream; leave that to the caller.
+			 */
+			if (posp) {
+				*posp -= 4;
+				break;
+			}
+			error("invalid block size");
+			goto exit_2;
+		}
+
+		if (fill ? fill(inp, chunksize) < (int)chunksize :
+			   (long)chunksize > size) {
+			error("data corrupted");
+			goto exit_2;
+		}
+
+		dest_len = LZ4_LEGACY_BLOCK_SIZE;
+		if (lz4_decompress_unknownoutputsize(inp, chunksize, outp,
+						     &dest_len) < 0) {
+			error("Decoding failed");
+			goto exit_2;
+		}
+
+		if (flush && flush(outp, dest_len) != dest_len)
+			goto exit_2;
+		if (output)
+			outp += dest_len;
+		if (posp)
+			*posp += chunksize;
+
+		if (!fill) {
+			inp += chunksize;
+			size -= chunksize;
+		}
+	}
+
+	ret = 0;
+exit_2:
+	if (!input)
+		large_free(inp_start);
+exit_1:
+	if (!output)
+		large_free(outp);
+exit_0:
+	return ret;
+}
+
+#ifdef PREBOOT
+/*
+ * The kernel image has its uncompressed size appended by the build, which
+ * is not part of the LZ4 stream.
+ */
+STATIC int INIT decompress(unsigned char *buf, int in_len,
+			   int (*fill)(void *, unsigned int),
+			   int (*flush)(void *, unsigned int),
+			   unsigned char *output, int *posp,
+			   void (*error)(char *x))
+{
+	return unlz4(buf, in_len - 4, fill, flush, output, posp, error);
+}
+#endif
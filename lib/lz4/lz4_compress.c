@@ -0,0 +1,193 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * Compressor producing the LZ4 block format, using a single hash probe
+ * per position and an accelerating skip over incompressible regions.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#include <linux/module.h>
+#include <linux/kernel.h>
+#include <linux/string.h>
+#include <linux/bitops.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+static inline u32 lz4_hash(const u8 *p)
+{
+	return (lz4_read32(p) * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+/*
+ * Number of leading bytes that are equal in two words whose XOR is
+ * 'diff' (which must be non-zero), in memory order.
+ */
+static inline unsigned int lz4_nb_common_bytes(unsigned long diff)
+{
+#ifdef __BIG_ENDIAN
+	return (BITS_PER_LONG - 1 - __fls(diff)) >> 3;
+#else
+	return __ffs(diff) >> 3;
+#endif
+}
+
+/* Length of the common run at 'ip' and 'ref', never reading past 'limit' */
+static inline size_t lz4_count(const u8 *ip, const u8 *ref, const u8 *limit)
+{
+	const u8 *start = ip;
+
+	while (ip + sizeof(unsigned long) <= limit) {
+		unsigned long diff = lz4_read_word(ref) ^ lz4_read_word(ip);
+
+		if (diff)
+			return ip - start + lz4_nb_common_bytes(diff);
+		ip += sizeof(unsigned long);
+		ref += sizeof(unsigned long);
+	}
+
+	while (ip < limit && *ip == *ref) {
+		ip++;
+		ref++;
+	}
+
+	return ip - start;
+}
+
+/* Emits the 255-continued extension of a literal or match length */
+static inline u8 *lz4_put_length(u8 *op, size_t len)
+{
+	while (len >= 255) {
+		*op++ = 255;
+		len -= 255;
+	}
+	*op++ = (u8)len;
+	return op;
+}
+
+static int lz4_compress_ctx(u32 *hash_table, const u8 *src, size_t isize,
+		u8 *dst, size_t osize, size_t *out_len)
+{
+	const u8 *ip = src;
+	const u8 *anchor = src;
+	const u8 * const iend = src + isize;
+	const u8 * const mflimit = iend - LZ4_MFLIMIT;
+	const u8 * const matchlimit = iend - LZ4_LASTLITERALS;
+	u8 *op = dst;
+	u8 * const oend = dst + osize;
+	size_t litlen;
+
+	if (isize < LZ4_MINLENGTH)
+		goto last_literals;
+
+	memset(hash_table, 0, LZ4_HASH_SIZE * sizeof(*hash_table));
+	hash_table[lz4_hash(ip)] = 0;
+	ip++;
+
+	for (;;) {
+		const u8 *ref;
+		unsigned int attempts = 1U << LZ4_SKIP_STRENGTH;
+		size_t matchlen;
+		u8 *token;
+
+		/* Find a match */
+		for (;;) {
+			u32 h;
+
+			if (unlikely(ip > mflimit))
+				goto last_literals;
+
+			h = lz4_hash(ip);
+			ref = src + hash_table[h];
+			hash_table[h] = (u32)(ip - src);
+
+			if (ref < ip && ip - ref <= LZ4_MAX_DISTANCE &&
+			    lz4_read32(ref) == lz4_read32(ip))
+				break;
+
+			ip += attempts++ >> LZ4_SKIP_STRENGTH;
+		}
+
+		/* Extend the match backwards over pending literals */
+		while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+			ip--;
+			ref--;
+		}
+
+		/* Encode the literal run; the token is fixed up below */
+		litlen = ip - anchor;
+		if (unlikely(op + 1 + (litlen + 255 - LZ4_RUN_MASK) / 255 +
+			     litlen + 2 > oend))
+			return -1;
+
+		token = op++;
+		if (litlen >= LZ4_RUN_MASK) {
+			*token = LZ4_RUN_MASK << LZ4_ML_BITS;
+			op = lz4_put_length(op, litlen - LZ4_RUN_MASK);
+		} else {
+			*token = (u8)(litlen << LZ4_ML_BITS);
+		}
+		memcpy(op, anchor, litlen);
+		op += litlen;
+
+		/* Encode the match offset and length */
+		put_unaligned_le16((u16)(ip - ref), op);
+		op += 2;
+
+		matchlen = lz4_count(ip + LZ4_MINMATCH, ref + LZ4_MINMATCH,
+				matchlimit);
+		ip += LZ4_MINMATCH + matchlen;
+
+		if (matchlen >= LZ4_ML_MASK) {
+			if (unlikely(op + 1 + (matchlen - LZ4_ML_MASK) / 255 >
+				     oend))
+				return -1;
+			*token += LZ4_ML_MASK;
+			op = lz4_put_length(op, matchlen - LZ4_ML_MASK);
+		} else {
+			*token += (u8)matchlen;
+		}
+
+		anchor = ip;
+		if (unlikely(ip > mflimit))
+			break;
+
+		/* Keep the table warm with the position just behind us */
+		hash_table[lz4_hash(ip - 2)] = (u32)(ip - 2 - src);
+	}
+
+last_literals:
+	litlen = iend - anchor;
+	if (unlikely(op + 1 + litlen + (litlen + 255 - LZ4_RUN_MASK) / 255 >
+		     oend))
+		return -1;
+
+	if (litlen >= LZ4_RUN_MASK) {
+		*op++ = LZ4_RUN_MASK << LZ4_ML_BITS;
+		op = lz4_put_length(op, litlen - LZ4_RUN_MASK);
+	} else {
+		*op++ = (u8)(litlen << LZ4_ML_BITS);
+	}
+	memcpy(op, anchor, litlen);
+	op += litlen;
+
+	*out_len = op - dst;
+	return 0;
+}
+
+int lz4_compress(const unsigned char *src, size_t src_len,
+		unsigned char *dst, size_t *dst_len, void *wrkmem)
+{
+	/* Offsets into the hash table are 32 bit */
+	if (unlikely(src_len > 0x7E000000))
+		return -1;
+
+	return lz4_compress_ctx(wrkmem, src, src_len, dst,
+			lz4_compressbound(src_len), dst_len);
+}
+EXPORT_SYMBOL(lz4_compress);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 compressor");
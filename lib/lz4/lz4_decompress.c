@@ -0,0 +1,126 @@
+/*
+ * LZ4 - Fast LZ compression algorithm
+ *
+ * Safe decompressor for the LZ4 block format: every length and offset
+ * read from the input is checked against both buffers, so corrupted
+ * data results in an error rather than an overrun.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef STATIC
+#include <linux/module.h>
+#include <linux/kernel.h>
+#endif
+#include <linux/types.h>
+#include <linux/string.h>
+#include <linux/lz4.h>
+#include "lz4defs.h"
+
+/*
+ * Reads the 255-continued extension of a literal or match length.
+ * Returns false if the input ends before the extension does.
+ */
+static inline bool lz4_get_length(const u8 **ipp, const u8 *iend,
+		size_t *len)
+{
+	const u8 *ip = *ipp;
+	unsigned int s;
+
+	do {
+		if (unlikely(ip >= iend))
+			return false;
+		s = *ip++;
+		*len += s;
+	} while (s == 255);
+
+	*ipp = ip;
+	return true;
+}
+
+/*
+ * Copies a match of 'len' bytes from 'offset' bytes behind 'op'. The
+ * source and destination may overlap, in which case the pattern repeats.
+ */
+static inline void lz4_copy_match(u8 *op, size_t offset, size_t len)
+{
+	const u8 *ref = op - offset;
+
+	if (offset >= len) {
+		memcpy(op, ref, len);
+		return;
+	}
+
+	if (offset >= sizeof(unsigned long)) {
+		/* Each word only reads bytes that have already been written */
+		while (len >= sizeof(unsigned long)) {
+			lz4_write_word(op, lz4_read_word(ref));
+			op += sizeof(unsigned long);
+			ref += sizeof(unsigned long);
+			len -= sizeof(unsigned long);
+		}
+	}
+
+	while (len--)
+		*op++ = *ref++;
+}
+
+int lz4_decompress_unknownoutputsize(const unsigned char *src, size_t src_len,
+		unsigned char *dest, size_t *dest_len)
+{
+	const u8 *ip = src;
+	const u8 * const iend = src + src_len;
+	u8 *op = dest;
+	u8 * const oend = dest + *dest_len;
+
+	while (ip < iend) {
+		unsigned int token = *ip++;
+		size_t length, offset;
+
+		/* Literals */
+		length = token >> LZ4_ML_BITS;
+		if (length == LZ4_RUN_MASK &&
+		    unlikely(!lz4_get_length(&ip, iend, &length)))
+			return -1;
+		if (unlikely(length > (size_t)(iend - ip) ||
+			     length > (size_t)(oend - op)))
+			return -1;
+		memcpy(op, ip, length);
+		op += length;
+		ip += length;
+
+		/* The last sequence carries literals only */
+		if (ip == iend)
+			break;
+
+		/* Match */
+		if (unlikely(iend - ip < 2))
+			return -1;
+		offset = get_unaligned_le16(ip);
+		ip += 2;
+		if (unlikely(offset == 0 || offset > (size_t)(op - dest)))
+			return -1;
+
+		length = token & LZ4_ML_MASK;
+		if (length == LZ4_ML_MASK &&
+		    unlikely(!lz4_get_length(&ip, iend, &length)))
+			return -1;
+		length += LZ4_MINMATCH;
+		if (unlikely(length > (size_t)(oend - op)))
+			return -1;
+
+		lz4_copy_match(op, offset, length);
+		op += length;
+	}
+
+	*dest_len = op - dest;
+	return 0;
+}
+#ifndef STATIC
+EXPORT_SYMBOL(lz4_decompress_unknownoutputsize);
+
+MODULE_LICENSE("GPL");
+MODULE_DESCRIPTION("LZ4 Decompressor");
+#endif
@@ -0,0 +1,62 @@
+/*
+ * lz4defs.h -- common definitions for the LZ4 compressor and decompressor
+ *
+ * LZ4 is an LZ77-type byte-oriented compression format. A compressed
+ * block is a series of sequences, each made of a token byte, an optional
+ * literal length extension, the literals themselves, a little endian
+ * 16 bit match offset and an optional match length extension. The last
+ * sequence of a block only carries literals.
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation.
+ */
+
+#ifndef __LZ4DEFS_H__
+#define __LZ4DEFS_H__
+
+#include <asm/unaligned.h>
+
+#define LZ4_MINMATCH		4
+#define LZ4_COPYLENGTH		8
+#define LZ4_LASTLITERALS	5
+#define LZ4_MFLIMIT		(LZ4_COPYLENGTH + LZ4_MINMATCH)
+#define LZ4_MINLENGTH		(LZ4_MFLIMIT + 1)
+
+#define LZ4_MAX_DISTANCE	65535
+
+#define LZ4_ML_BITS		4
+#define LZ4_ML_MASK		((1U << LZ4_ML_BITS) - 1)
+#define LZ4_RUN_BITS		(8 - LZ4_ML_BITS)
+#define LZ4_RUN_MASK		((1U << LZ4_RUN_BITS) - 1)
+
+/*
+ * The match finder uses a 4096 entry hash table of 32 bit input offsets,
+ * which fits in LZ4_MEM_COMPRESS on both 32 and 64 bit machines.
+ */
+#define LZ4_HASH_LOG		12
+#define LZ4_HASH_SIZE		(1U << LZ4_HASH_LOG)
+
+/*
+ * Controls how fast the compressor skips over incompressible data: after
+ * every (1 << LZ4_SKIP_STRENGTH) failed match attempts the search step
+ * grows by one byte.
+ */
+#define LZ4_SKIP_STRENGTH	6
+
+static inline u32 lz4_read32(const void *p)
+{
+	return get_unaligned((const u32 *)p);
+}
+
+static inline unsigned long lz4_read_word(const void *p)
+{
+	return get_unaligned((const unsigned long *)p);
+}
+
+static inline void lz4_write_word(void *p, unsigned long v)
+{
+	put_unaligned(v, (unsigned long *)p);
+}
+
+#endif /* __LZ4DEFS_H__ */
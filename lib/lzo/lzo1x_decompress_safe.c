@@ -14,6 +14,7 @@
 #ifndef STATIC
 #include <linux/module.h>
 #include <linux/kernel.h>
+#include <linux/string.h>
 #endif
 #include <asm/unaligned.h>
 #include <linux/lzo.h>
@@ -85,6 +86,11 @@ copy_literal_run:
 				if (likely(HAVE_IP(t + 15) && HAVE_OP(t + 15))) {
 					const unsigned char *ie = ip + t;
 					unsigned char *oe = op + t;
+#if defined(LZO_MEMCPY_MIN)
+					if (t >= LZO_MEMCPY_MIN)
+						memcpy(op, ip, t);
+					else
+#endif
 					do {
 						COPY8(op, ip);
 						op += 8;
@@ -188,6 +194,11 @@ copy_literal_run:
 		if (op - m_pos >= 8) {
 			unsigned char *oe = op + t;
 			if (likely(HAVE_OP(t + 15))) {
+#if defined(LZO_MEMCPY_MIN)
+				if (t >= LZO_MEMCPY_MIN && op - m_pos >= t)
+					memcpy(op, m_pos, t);
+				else
+#endif
 				do {
 					COPY8(op, m_pos);
 					op += 8;
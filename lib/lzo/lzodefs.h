@@ -28,6 +28,16 @@
 		COPY4(dst, src); COPY4((dst) + 4, (src) + 4)
 #endif
 
+/*
+ * Literal runs and non-overlapping matches of at least LZO_MEMCPY_MIN bytes
+ * are handed to memcpy(), which is the load/store-multiple routine with
+ * preloads on ARM, instead of the COPY8 loop. The boot decompressor only
+ * has a byte-wise memcpy(), so it keeps using the loop.
+ */
+#ifndef STATIC
+#define LZO_MEMCPY_MIN	64
+#endif
+
 #if defined(__BIG_ENDIAN) && defined(__LITTLE_ENDIAN)
 #error "conflicting endian definitions"
 #elif defined(__x86_64__)
@@ -18,6 +18,11 @@
 #include <linux/errno.h>
 #include <linux/io.h>
 #include <linux/string.h>
+#include <linux/ktime.h>
+#include <linux/math64.h>
+#include <linux/spinlock.h>
+#include <linux/debugfs.h>
+#include <linux/seq_file.h>
 #include <linux/qmi_encdec.h>
 
 #include "qmi_encdec_priv.h"
@@ -91,6 +96,80 @@ static int _qmi_kernel_decode(struct elem_info *ei_array,
 static struct elem_info *skip_to_next_elem(struct elem_info *ei_array,
 					   int level);
 
+/**
+ * qmi_encdec_stat - Time spent encoding or decoding messages
+ * @count: Number of messages processed.
+ * @total_ns: Accumulated processing time.
+ * @max_ns: Longest time spent on a single message.
+ */
+struct qmi_encdec_stat {
+	u64 count;
+	u64 total_ns;
+	u64 max_ns;
+};
+
+static struct qmi_encdec_stat qmi_encode_stat;
+static struct qmi_encdec_stat qmi_decode_stat;
+static DEFINE_SPINLOCK(qmi_encdec_stat_lock);
+
+static void qmi_encdec_account(struct qmi_encdec_stat *stat, ktime_t start)
+{
+	u64 ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	unsigned long flags;
+
+	spin_lock_irqsave(&qmi_encdec_stat_lock, flags);
+	stat->count++;
+	stat->total_ns += ns;
+	if (ns > stat->max_ns)
+		stat->max_ns = ns;
+	spin_unlock_irqrestore(&qmi_encdec_stat_lock, flags);
+}
+
+/**
+ * qmi_struct_wire_len() - Wire length of a struct that encodes as-is
+ * @ei_array: Struct info array describing the nested structure.
+ * @c_size: Size of one instance of the C structure.
+ *
+ * @return: c_size if the structure only holds basic elements and fixed
+ *          arrays of them, packed back to back in declaration order, so
+ *          that its QMI wire format is byte for byte its memory layout.
+ *          0 otherwise.
+ *
+ * Arrays of such structures are encoded and decoded with a single memcpy
+ * instead of walking the element info once per instance.
+ */
+static uint32_t qmi_struct_wire_len(struct elem_info *ei_array,
+				    uint32_t c_size)
+{
+	struct elem_info *temp_ei;
+	uint32_t offset = 0;
+
+	if (!ei_array)
+		return 0;
+
+	for (temp_ei = ei_array; temp_ei->data_type != QMI_EOTI; temp_ei++) {
+		switch (temp_ei->data_type) {
+		case QMI_UNSIGNED_1_BYTE:
+		case QMI_UNSIGNED_2_BYTE:
+		case QMI_UNSIGNED_4_BYTE:
+		case QMI_UNSIGNED_8_BYTE:
+		case QMI_SIGNED_2_BYTE_ENUM:
+		case QMI_SIGNED_4_BYTE_ENUM:
+			break;
+		default:
+			return 0;
+		}
+		if (temp_ei->is_array == VAR_LEN_ARRAY ||
+		    temp_ei->offset != offset)
+			return 0;
+		offset += temp_ei->elem_size *
+			  (temp_ei->is_array == STATIC_ARRAY ?
+			   temp_ei->elem_len : 1);
+	}
+
+	return offset == c_size ? offset : 0;
+}
+
 /**
  * qmi_calc_max_msg_len() - Calculate the maximum length of a QMI message
  * @ei_array: Struct info array describing the structure.
@@ -219,6 +298,7 @@ int qmi_kernel_encode(struct msg_desc *desc,
 {
 	int enc_level = 1;
 	int ret, calc_max_msg_len, calc_min_msg_len;
+	ktime_t start;
 
 	if (!desc)
 		return -EINVAL;
@@ -245,8 +325,10 @@ int qmi_kernel_encode(struct msg_desc *desc,
 	if (desc->max_msg_len < out_buf_len)
 		return -ETOOSMALL;
 
+	start = ktime_get();
 	ret = _qmi_kernel_encode(desc->ei_array, out_buf,
 				 in_c_struct, out_buf_len, enc_level);
+	qmi_encdec_account(&qmi_encode_stat, start);
 	if (ret == -ETOOSMALL) {
 		calc_max_msg_len = qmi_calc_max_msg_len(desc->ei_array, 1);
 		pr_err("%s: Calc. len %d != Out buf len %d\n",
@@ -274,12 +356,10 @@ EXPORT_SYMBOL(qmi_kernel_encode);
 static int qmi_encode_basic_elem(void *buf_dst, void *buf_src,
 				 uint32_t elem_len, uint32_t elem_size)
 {
-	uint32_t i, rc = 0;
+	uint32_t rc = elem_len * elem_size;
 
-	for (i = 0; i < elem_len; i++) {
-		QMI_ENCDEC_ENCODE_N_BYTES(buf_dst, buf_src, elem_size);
-		rc += elem_size;
-	}
+	/* Basic elements are laid out back to back in both formats */
+	QMI_ENCDEC_ENCODE_N_BYTES(buf_dst, buf_src, rc);
 
 	return rc;
 }
@@ -309,6 +389,17 @@ static int qmi_encode_struct_elem(struct elem_info *ei_array,
 {
 	int i, rc, encoded_bytes = 0;
 	struct elem_info *temp_ei = ei_array;
+	uint32_t wire_len;
+
+	wire_len = qmi_struct_wire_len(temp_ei->ei_array, temp_ei->elem_size);
+	if (wire_len) {
+		if (elem_len * wire_len > out_buf_len) {
+			pr_err("%s: Too Small Buffer @STRUCT\n", __func__);
+			return -ETOOSMALL;
+		}
+		memcpy(buf_dst, buf_src, elem_len * wire_len);
+		return elem_len * wire_len;
+	}
 
 	for (i = 0; i < elem_len; i++) {
 		rc = _qmi_kernel_encode(temp_ei->ei_array, buf_dst, buf_src,
@@ -499,6 +590,7 @@ int qmi_kernel_decode(struct msg_desc *desc, void *out_c_struct,
 {
 	int dec_level = 1;
 	int rc = 0;
+	ktime_t start;
 
 	if (!desc || !desc->ei_array)
 		return -EINVAL;
@@ -509,8 +601,10 @@ int qmi_kernel_decode(struct msg_desc *desc, void *out_c_struct,
 	if (desc->max_msg_len < in_buf_len)
 		return -EINVAL;
 
+	start = ktime_get();
 	rc = _qmi_kernel_decode(desc->ei_array, out_c_struct,
 				in_buf, in_buf_len, dec_level);
+	qmi_encdec_account(&qmi_decode_stat, start);
 	if (rc < 0)
 		return rc;
 	else
@@ -536,12 +630,9 @@ EXPORT_SYMBOL(qmi_kernel_decode);
 static int qmi_decode_basic_elem(void *buf_dst, void *buf_src,
 				 uint32_t elem_len, uint32_t elem_size)
 {
-	uint32_t i, rc = 0;
+	uint32_t rc = elem_len * elem_size;
 
-	for (i = 0; i < elem_len; i++) {
-		QMI_ENCDEC_DECODE_N_BYTES(buf_dst, buf_src, elem_size);
-		rc += elem_size;
-	}
+	QMI_ENCDEC_DECODE_N_BYTES(buf_dst, buf_src, rc);
 
 	return rc;
 }
@@ -571,12 +662,20 @@ static int qmi_decode_struct_elem(struct elem_info *ei_array, void *buf_dst,
 {
 	int i, rc, decoded_bytes = 0;
 	struct elem_info *temp_ei = ei_array;
+	uint32_t wire_len;
 
+	wire_len = qmi_struct_wire_len(temp_ei->ei_array, temp_ei->elem_size);
 	if (dec_level > 2 && !tlv_len) {
-		tlv_len = qmi_calc_max_msg_len(temp_ei->ei_array, dec_level);
+		tlv_len = wire_len ? wire_len :
+			qmi_calc_max_msg_len(temp_ei->ei_array, dec_level);
 		tlv_len = tlv_len * elem_len;
 	}
 
+	if (wire_len && elem_len && tlv_len == elem_len * wire_len) {
+		memcpy(buf_dst, buf_src, tlv_len);
+		return tlv_len;
+	}
+
 	for (i = 0; i < elem_len; i++) {
 		rc = _qmi_kernel_decode(temp_ei->ei_array, buf_dst, buf_src,
 					(tlv_len/elem_len), dec_level);
@@ -724,5 +823,50 @@ static int _qmi_kernel_decode(struct elem_info *ei_array,
 	}
 	return decoded_bytes;
 }
+#ifdef CONFIG_DEBUG_FS
+static void qmi_encdec_show_stat(struct seq_file *s, const char *name,
+				 struct qmi_encdec_stat *stat)
+{
+	struct qmi_encdec_stat snap;
+	unsigned long flags;
+
+	spin_lock_irqsave(&qmi_encdec_stat_lock, flags);
+	snap = *stat;
+	spin_unlock_irqrestore(&qmi_encdec_stat_lock, flags);
+
+	seq_printf(s, "%s: count %llu avg_ns %llu max_ns %llu\n", name,
+		   snap.count,
+		   snap.count ? div64_u64(snap.total_ns, snap.count) : 0,
+		   snap.max_ns);
+}
+
+static int qmi_encdec_stats_show(struct seq_file *s, void *unused)
+{
+	qmi_encdec_show_stat(s, "encode", &qmi_encode_stat);
+	qmi_encdec_show_stat(s, "decode", &qmi_decode_stat);
+	return 0;
+}
+
+static int qmi_encdec_stats_open(struct inode *inode, struct file *file)
+{
+	return single_open(file, qmi_encdec_stats_show, NULL);
+}
+
+static const struct file_operations qmi_encdec_stats_fops = {
+	.open = qmi_encdec_stats_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
+static int __init qmi_encdec_debugfs_init(void)
+{
+	debugfs_create_file("qmi_encdec_stats", S_IRUGO, NULL, NULL,
+			    &qmi_encdec_stats_fops);
+	return 0;
+}
+late_initcall(qmi_encdec_debugfs_init);
+#endif
+
 MODULE_DESCRIPTION("QMI kernel enc/dec");
 MODULE_LICENSE("GPL v2");
@@ -295,7 +295,7 @@ void bdi_wakeup_thread_delayed(struct backing_dev_info *bdi)
 {
 	unsigned long timeout;
 
-	timeout = msecs_to_jiffies(dirty_writeback_interval * 10);
+	timeout = msecs_to_jiffies(dirty_writeback_centisecs() * 10);
 	spin_lock_bh(&bdi->wb_lock);
 	if (test_bit(BDI_registered, &bdi->state))
 		queue_delayed_work(bdi_wq, &bdi->wb.dwork, timeout);
@@ -452,6 +452,7 @@ int bdi_init(struct backing_dev_info *bdi)
 	INIT_LIST_HEAD(&bdi->work_list);
 
 	bdi_wb_init(&bdi->wb, bdi);
+	bdi_ra_async_init(bdi);
 
 	for (i = 0; i < NR_BDI_STAT_ITEMS; i++) {
 		err = percpu_counter_init(&bdi->bdi_stat[i], 0);
@@ -508,6 +509,7 @@ void bdi_destroy(struct backing_dev_info *bdi)
 	 * bdi_wakeup_thread_delayed() calls from __mark_inode_dirty().
 	 */
 	cancel_delayed_work_sync(&bdi->wb.dwork);
+	bdi_ra_async_destroy(bdi);
 
 	for (i = 0; i < NR_BDI_STAT_ITEMS; i++)
 		percpu_counter_destroy(&bdi->bdi_stat[i]);
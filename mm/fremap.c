@@ -216,6 +216,7 @@ get_write_lock:
 			}
 			goto out_freed;
 		}
+		vma_start_write(vma);
 		mutex_lock(&mapping->i_mmap_mutex);
 		flush_dcache_mmap_lock(mapping);
 		vma->vm_flags |= VM_NONLINEAR;
@@ -250,10 +251,12 @@ out:
 	if (vma)
 		vm_flags = vma->vm_flags;
 out_freed:
-	if (likely(!has_write_lock))
+	if (likely(!has_write_lock)) {
 		up_read(&mm->mmap_sem);
-	else
+	} else {
+		vma_end_write_all(mm);
 		up_write(&mm->mmap_sem);
+	}
 	if (!err && ((vm_flags & VM_LOCKED) || !(flags & MAP_NONBLOCK)))
 		mm_populate(start, size);
 
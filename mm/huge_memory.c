@@ -2343,6 +2343,8 @@ static void collapse_huge_page(struct mm_struct *mm,
 	if (pmd_trans_huge(*pmd))
 		goto out;
 
+	/* the pmd is cleared below, keep vma locked faults out */
+	vma_start_write(vma);
 	anon_vma_lock_write(vma->anon_vma);
 
 	pte = pte_offset_map(pmd, address);
@@ -2413,6 +2415,7 @@ static void collapse_huge_page(struct mm_struct *mm,
 
 	khugepaged_pages_collapsed++;
 out_up_write:
+	vma_end_write_all(mm);
 	up_write(&mm->mmap_sem);
 	return;
 
@@ -16,6 +16,14 @@
 void free_pgtables(struct mmu_gather *tlb, struct vm_area_struct *start_vma,
 		unsigned long floor, unsigned long ceiling);
 
+void unmap_page_range(struct mmu_gather *tlb, struct vm_area_struct *vma,
+		unsigned long addr, unsigned long end,
+		struct zap_details *details);
+
+#ifdef CONFIG_PER_VMA_LOCK
+struct vm_area_struct *find_vma_rcu(struct mm_struct *mm, unsigned long addr);
+#endif
+
 static inline void set_page_count(struct page *page, int v)
 {
 	atomic_set(&page->_count, v);
@@ -85,6 +93,11 @@ static inline void get_page_foll(struct page *page)
 
 extern unsigned long highest_memmap_pfn;
 
+/*
+ * in mm/page_alloc.c:
+ */
+extern void pageset_autotune(void);
+
 /*
  * in mm/vmscan.c:
  */
@@ -133,6 +146,7 @@ struct compact_control {
 					 */
 	bool finished_update_migrate;
 
+	bool proactive;			/* Background compaction by kcompactd */
 	int order;			/* order a direct compactor needs */
 	int migratetype;		/* MOVABLE, RECLAIMABLE etc */
 	struct zone *zone;
@@ -37,6 +37,7 @@
 #include <linux/freezer.h>
 #include <linux/oom.h>
 #include <linux/numa.h>
+#include <linux/fb.h>
 
 #include <asm/tlbflush.h>
 #include "internal.h"
@@ -226,6 +227,32 @@ static unsigned int ksm_thread_sleep_millisecs = 20;
 /* Boolean to indicate whether to use deferred timer or not */
 static bool use_deferred_timer;
 
+/*
+ * Adaptive scanning: at the end of each full scan the merge yield moves
+ * ksm_adaptive_level, which scales the configured rate.  Negative levels
+ * scan 2^-level times as many pages per batch, positive levels sleep
+ * 2^level times as long between batches.
+ */
+static bool ksm_adaptive;
+static int ksm_adaptive_level;
+
+#define KSM_ADAPTIVE_LEVEL_MIN	(-2)
+#define KSM_ADAPTIVE_LEVEL_MAX	8
+
+/* Merged pages per mille of scanned pages that keep the rate going up */
+#define KSM_ADAPTIVE_YIELD_MIN	1
+
+/* Pages scanned and merged in the current full scan */
+static unsigned long ksm_pass_scanned;
+static unsigned long ksm_pass_merged;
+
+/* Merged pages per mille of scanned pages in the last full scan */
+static unsigned int ksm_scan_yield;
+
+/* Adaptive mode does not scan at all while either of these is set */
+static bool ksm_screen_off;
+static bool ksm_power_save;
+
 #ifdef CONFIG_NUMA
 /* Zeroed when merging across nodes is not allowed */
 static unsigned int ksm_merge_across_nodes = 1;
@@ -1405,6 +1432,7 @@ static void stable_tree_append(struct rmap_item *rmap_item,
 		ksm_pages_sharing++;
 	else
 		ksm_pages_shared++;
+	ksm_pass_merged++;
 }
 
 /*
@@ -1536,6 +1564,30 @@ static struct rmap_item *get_next_rmap_item(struct mm_slot *mm_slot,
 	return rmap_item;
 }
 
+/*
+ * Called by ksmd at the end of each full scan, under ksm_thread_mutex.
+ */
+static void ksm_end_pass(void)
+{
+	if (ksm_pass_scanned)
+		ksm_scan_yield = ksm_pass_merged * 1000 / ksm_pass_scanned;
+	else
+		ksm_scan_yield = 0;
+	ksm_pass_scanned = 0;
+	ksm_pass_merged = 0;
+
+	if (!ksm_adaptive)
+		return;
+
+	/* Speed up while merging pays off, back off exponentially if not */
+	if (ksm_scan_yield >= KSM_ADAPTIVE_YIELD_MIN)
+		ksm_adaptive_level = max(min(ksm_adaptive_level, 0) - 1,
+					 KSM_ADAPTIVE_LEVEL_MIN);
+	else
+		ksm_adaptive_level = min(max(ksm_adaptive_level, 0) + 1,
+					 KSM_ADAPTIVE_LEVEL_MAX);
+}
+
 static struct rmap_item *scan_get_next_rmap_item(struct page **page)
 {
 	struct mm_struct *mm;
@@ -1687,6 +1739,7 @@ next_mm:
 		goto next_mm;
 
 	ksm_scan.seqnr++;
+	ksm_end_pass();
 	return NULL;
 }
 
@@ -1706,6 +1759,7 @@ static void ksm_do_scan(unsigned int scan_npages)
 			return;
 		cmp_and_merge_page(page, rmap_item);
 		put_page(page);
+		ksm_pass_scanned++;
 	}
 }
 
@@ -1744,9 +1798,33 @@ out:
 	return timeout < 0 ? 0 : timeout;
 }
 
+static bool ksm_adaptive_paused(void)
+{
+	return ksm_adaptive && (ksm_screen_off || ksm_power_save);
+}
+
 static int ksmd_should_run(void)
 {
-	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list);
+	return (ksm_run & KSM_RUN_MERGE) && !list_empty(&ksm_mm_head.mm_list) &&
+		!ksm_adaptive_paused();
+}
+
+static unsigned int ksm_scan_npages(void)
+{
+	unsigned long npages = ksm_thread_pages_to_scan;
+
+	if (ksm_adaptive && ksm_adaptive_level < 0)
+		npages <<= -ksm_adaptive_level;
+	return min_t(unsigned long, npages, UINT_MAX);
+}
+
+static unsigned long ksm_sleep_jiffies(void)
+{
+	unsigned long msecs = ksm_thread_sleep_millisecs;
+
+	if (ksm_adaptive && ksm_adaptive_level > 0)
+		msecs <<= ksm_adaptive_level;
+	return msecs_to_jiffies(msecs);
 }
 
 static int ksm_scan_thread(void *nothing)
@@ -1758,18 +1836,17 @@ static int ksm_scan_thread(void *nothing)
 		mutex_lock(&ksm_thread_mutex);
 		wait_while_offlining();
 		if (ksmd_should_run())
-			ksm_do_scan(ksm_thread_pages_to_scan);
+			ksm_do_scan(ksm_scan_npages());
 		mutex_unlock(&ksm_thread_mutex);
 
 		try_to_freeze();
 
 		if (ksmd_should_run()) {
 			if (use_deferred_timer)
-				deferred_schedule_timeout(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+				deferred_schedule_timeout(ksm_sleep_jiffies());
 			else
 				schedule_timeout_interruptible(
-				msecs_to_jiffies(ksm_thread_sleep_millisecs));
+					ksm_sleep_jiffies());
 		} else {
 			wait_event_freezable(ksm_thread_wait,
 				ksmd_should_run() || kthread_should_stop());
@@ -2337,6 +2414,70 @@ static ssize_t deferred_timer_store(struct kobject *kobj,
 }
 KSM_ATTR(deferred_timer);
 
+static ssize_t adaptive_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_adaptive);
+}
+
+static ssize_t adaptive_store(struct kobject *kobj,
+			      struct kobj_attribute *attr,
+			      const char *buf, size_t count)
+{
+	unsigned long enable;
+	int err;
+
+	err = kstrtoul(buf, 10, &enable);
+	if (err)
+		return err;
+	if (enable > 1)
+		return -EINVAL;
+
+	mutex_lock(&ksm_thread_mutex);
+	ksm_adaptive = enable;
+	ksm_adaptive_level = 0;
+	mutex_unlock(&ksm_thread_mutex);
+
+	wake_up_interruptible(&ksm_thread_wait);
+
+	return count;
+}
+KSM_ATTR(adaptive);
+
+static ssize_t power_save_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_power_save);
+}
+
+static ssize_t power_save_store(struct kobject *kobj,
+				struct kobj_attribute *attr,
+				const char *buf, size_t count)
+{
+	unsigned long enable;
+	int err;
+
+	err = kstrtoul(buf, 10, &enable);
+	if (err)
+		return err;
+	if (enable > 1)
+		return -EINVAL;
+
+	ksm_power_save = enable;
+	if (!enable)
+		wake_up_interruptible(&ksm_thread_wait);
+
+	return count;
+}
+KSM_ATTR(power_save);
+
+static ssize_t scan_yield_show(struct kobject *kobj,
+			       struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", ksm_scan_yield);
+}
+KSM_ATTR_RO(scan_yield);
+
 #ifdef CONFIG_NUMA
 static ssize_t merge_across_nodes_show(struct kobject *kobj,
 				struct kobj_attribute *attr, char *buf)
@@ -2450,6 +2591,9 @@ static struct attribute *ksm_attrs[] = {
 	&pages_volatile_attr.attr,
 	&full_scans_attr.attr,
 	&deferred_timer_attr.attr,
+	&adaptive_attr.attr,
+	&power_save_attr.attr,
+	&scan_yield_attr.attr,
 #ifdef CONFIG_NUMA
 	&merge_across_nodes_attr.attr,
 #endif
@@ -2462,6 +2606,32 @@ static struct attribute_group ksm_attr_group = {
 };
 #endif /* CONFIG_SYSFS */
 
+#ifdef CONFIG_FB
+static int ksm_fb_notifier_callback(struct notifier_block *self,
+				    unsigned long event, void *data)
+{
+	struct fb_event *evdata = data;
+	int *blank;
+
+	if (event != FB_EVENT_BLANK || !evdata || !evdata->data)
+		return NOTIFY_DONE;
+
+	blank = evdata->data;
+	if (*blank == FB_BLANK_UNBLANK) {
+		ksm_screen_off = false;
+		wake_up_interruptible(&ksm_thread_wait);
+	} else if (*blank == FB_BLANK_POWERDOWN) {
+		ksm_screen_off = true;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block ksm_fb_notifier = {
+	.notifier_call = ksm_fb_notifier_callback,
+};
+#endif
+
 static int __init ksm_init(void)
 {
 	struct task_struct *ksm_thread;
@@ -2493,6 +2663,9 @@ static int __init ksm_init(void)
 #ifdef CONFIG_MEMORY_HOTREMOVE
 	/* There is no significance to this priority 100 */
 	hotplug_memory_notifier(ksm_memory_callback, 100);
+#endif
+#ifdef CONFIG_FB
+	fb_register_client(&ksm_fb_notifier);
 #endif
 	return 0;
 
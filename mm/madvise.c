@@ -30,6 +30,7 @@ static int madvise_need_mmap_write(int behavior)
 	switch (behavior) {
 	case MADV_REMOVE:
 	case MADV_WILLNEED:
+	case MADV_WILLNEED_ASYNC:
 	case MADV_DONTNEED:
 		return 0;
 	default:
@@ -127,6 +128,7 @@ success:
 	/*
 	 * vm_flags is protected by the mmap_sem held in write mode.
 	 */
+	vma_start_write(vma);
 	vma->vm_flags = new_flags;
 
 out:
@@ -196,7 +198,7 @@ static void force_shm_swapin_readahead(struct vm_area_struct *vma,
 	for (; start < end; start += PAGE_SIZE) {
 		index = ((start - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
 
-		page = find_get_page(mapping, index);
+		page = find_get_entry(mapping, index);
 		if (!radix_tree_exceptional_entry(page)) {
 			if (page)
 				page_cache_release(page);
@@ -218,7 +220,8 @@ static void force_shm_swapin_readahead(struct vm_area_struct *vma,
  */
 static long madvise_willneed(struct vm_area_struct * vma,
 			     struct vm_area_struct ** prev,
-			     unsigned long start, unsigned long end)
+			     unsigned long start, unsigned long end,
+			     bool async)
 {
 	struct file *file = vma->vm_file;
 
@@ -248,7 +251,9 @@ static long madvise_willneed(struct vm_area_struct * vma,
 		end = vma->vm_end;
 	end = ((end - vma->vm_start) >> PAGE_SHIFT) + vma->vm_pgoff;
 
-	force_page_cache_readahead(file->f_mapping, file, start, end - start);
+	if (!async || !readahead_async(file, start, end - start))
+		force_page_cache_readahead(file->f_mapping, file, start,
+					   end - start);
 	return 0;
 }
 
@@ -378,7 +383,9 @@ madvise_vma(struct vm_area_struct *vma, struct vm_area_struct **prev,
 	case MADV_REMOVE:
 		return madvise_remove(vma, prev, start, end);
 	case MADV_WILLNEED:
-		return madvise_willneed(vma, prev, start, end);
+		return madvise_willneed(vma, prev, start, end, false);
+	case MADV_WILLNEED_ASYNC:
+		return madvise_willneed(vma, prev, start, end, true);
 	case MADV_DONTNEED:
 		return madvise_dontneed(vma, prev, start, end);
 	default:
@@ -397,6 +404,7 @@ madvise_behavior_valid(int behavior)
 	case MADV_RANDOM:
 	case MADV_REMOVE:
 	case MADV_WILLNEED:
+	case MADV_WILLNEED_ASYNC:
 	case MADV_DONTNEED:
 #ifdef CONFIG_KSM
 	case MADV_MERGEABLE:
@@ -435,6 +443,8 @@ madvise_behavior_valid(int behavior)
  *		can be freed soon after they are accessed.
  *  MADV_WILLNEED - the application is notifying the system to read
  *		some pages ahead.
+ *  MADV_WILLNEED_ASYNC - like MADV_WILLNEED, but file pages are read
+ *		by a worker and madvise() returns once that is queued.
  *  MADV_DONTNEED - the application is finished with the given range,
  *		so the kernel can free resources associated with it.
  *  MADV_REMOVE - the application wants to free up the given range of
@@ -542,10 +552,12 @@ SYSCALL_DEFINE3(madvise, unsigned long, start, size_t, len_in, int, behavior)
 	}
 out:
 	blk_finish_plug(&plug);
-	if (write)
+	if (write) {
+		vma_end_write_all(current->mm);
 		up_write(&current->mm->mmap_sem);
-	else
+	} else {
 		up_read(&current->mm->mmap_sem);
+	}
 
 	return error;
 }
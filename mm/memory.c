@@ -1294,10 +1294,10 @@ static inline unsigned long zap_pud_range(struct mmu_gather *tlb,
 	return addr;
 }
 
-static void unmap_page_range(struct mmu_gather *tlb,
-			     struct vm_area_struct *vma,
-			     unsigned long addr, unsigned long end,
-			     struct zap_details *details)
+void unmap_page_range(struct mmu_gather *tlb,
+		      struct vm_area_struct *vma,
+		      unsigned long addr, unsigned long end,
+		      struct zap_details *details)
 {
 	pgd_t *pgd;
 	unsigned long next;
@@ -3062,7 +3062,7 @@ static int do_swap_page(struct mm_struct *mm, struct vm_area_struct *vma,
 	delayacct_set_flag(DELAYACCT_PF_SWAPIN);
 	page = lookup_swap_cache(entry);
 	if (!page) {
-		page = swapin_readahead(entry,
+		page = swapin_vma_readahead(entry,
 					GFP_HIGHUSER_MOVABLE, vma, address);
 		if (!page) {
 			/*
@@ -3908,6 +3908,93 @@ int handle_mm_fault(struct mm_struct *mm, struct vm_area_struct *vma,
 	return ret;
 }
 
+#ifdef CONFIG_PER_VMA_LOCK
+/*
+ * Faults are only handled under the vma lock where nothing outside the
+ * vma is looked at: anonymous memory that already has its anon_vma (see
+ * find_mergeable_anon_vma()) and page cache files. Stacks are expanded
+ * from the fault path and driver mappings may rely on mmap_sem, so those
+ * keep taking it.
+ */
+static bool vma_can_lock_fault(struct vm_area_struct *vma)
+{
+	if (vma->vm_flags & (VM_GROWSDOWN | VM_GROWSUP | VM_HUGETLB |
+			     VM_PFNMAP | VM_IO | VM_MIXEDMAP | VM_NONLINEAR))
+		return false;
+	if (vma->vm_ops && vma->vm_ops->fault != filemap_fault)
+		return false;
+	if (!vma->anon_vma && !(vma->vm_flags & VM_SHARED))
+		return false;
+	return true;
+}
+
+static bool vma_start_read(struct vm_area_struct *vma)
+{
+	int mm_lock_seq;
+
+	if (vma->vm_lock_seq == ACCESS_ONCE(vma->vm_mm->mm_lock_seq))
+		return false;
+	if (!down_read_trylock(&vma->vm_lock))
+		return false;
+
+	/* pairs with the smp_wmb() in vma_end_write_all() */
+	mm_lock_seq = ACCESS_ONCE(vma->vm_mm->mm_lock_seq);
+	smp_rmb();
+	if (vma->vm_lock_seq == mm_lock_seq) {
+		up_read(&vma->vm_lock);
+		return false;
+	}
+	return true;
+}
+
+/**
+ * lock_vma_under_rcu - find and read lock the vma for a fault at @address
+ * @mm: the faulting mm
+ * @address: the faulting address
+ *
+ * Returns the vma covering @address with its vma lock held for read, or
+ * NULL if the fault has to be handled under mmap_sem instead. The vma must
+ * be released with vma_end_read().
+ */
+struct vm_area_struct *lock_vma_under_rcu(struct mm_struct *mm,
+					  unsigned long address)
+{
+	struct vm_area_struct *vma;
+
+	rcu_read_lock();
+	vma = find_vma_rcu(mm, address);
+	if (!vma)
+		goto miss;
+	if (!vma_start_read(vma)) {
+		rcu_read_unlock();
+		count_vm_event(VMA_LOCK_ABORT);
+		return NULL;
+	}
+
+	/* Checked under the lock, the vma may have changed since the walk */
+	if (vma->vm_detached || address < vma->vm_start ||
+	    address >= vma->vm_end || !vma_can_lock_fault(vma)) {
+		up_read(&vma->vm_lock);
+		goto miss;
+	}
+	rcu_read_unlock();
+	return vma;
+
+miss:
+	rcu_read_unlock();
+	count_vm_event(VMA_LOCK_MISS);
+	return NULL;
+}
+
+void vma_end_read(struct vm_area_struct *vma)
+{
+	/* a writer woken by up_read() may free the vma under us */
+	rcu_read_lock();
+	up_read(&vma->vm_lock);
+	rcu_read_unlock();
+}
+#endif
+
 #ifndef __PAGETABLE_PUD_FOLDED
 /*
  * Allocate page upper directory.
@@ -447,8 +447,11 @@ void mpol_rebind_mm(struct mm_struct *mm, nodemask_t *new)
 	struct vm_area_struct *vma;
 
 	down_write(&mm->mmap_sem);
-	for (vma = mm->mmap; vma; vma = vma->vm_next)
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		vma_start_write(vma);
 		mpol_rebind_policy(vma->vm_policy, new, MPOL_REBIND_ONCE);
+	}
+	vma_end_write_all(mm);
 	up_write(&mm->mmap_sem);
 }
 
@@ -683,6 +686,7 @@ static int vma_replace_policy(struct vm_area_struct *vma,
 			goto err_out;
 	}
 
+	vma_start_write(vma);
 	old = vma->vm_policy;
 	vma->vm_policy = new; /* protected by mmap_sem */
 	mpol_put(old);
@@ -1267,6 +1271,7 @@ static long do_mbind(unsigned long start, unsigned long len,
 	} else
 		putback_lru_pages(&pagelist);
 
+	vma_end_write_all(mm);
 	up_write(&mm->mmap_sem);
  mpol_out:
 	mpol_put(new);
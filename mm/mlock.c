@@ -324,7 +324,7 @@ success:
 	 * It's okay if try_to_unmap_one unmaps a page just after we
 	 * set VM_LOCKED, __mlock_vma_pages_range will bring it back.
 	 */
-
+	vma_start_write(vma);
 	if (lock)
 		vma->vm_flags = newflags;
 	else
@@ -473,6 +473,7 @@ SYSCALL_DEFINE2(mlock, unsigned long, start, size_t, len)
 	/* check against resource limits */
 	if ((locked <= lock_limit) || capable(CAP_IPC_LOCK))
 		error = do_mlock(start, len, 1);
+	vma_end_write_all(current->mm);
 	up_write(&current->mm->mmap_sem);
 	if (!error)
 		error = __mm_populate(start, len, 0);
@@ -487,6 +488,7 @@ SYSCALL_DEFINE2(munlock, unsigned long, start, size_t, len)
 	len = PAGE_ALIGN(len + (start & ~PAGE_MASK));
 	start &= PAGE_MASK;
 	ret = do_mlock(start, len, 0);
+	vma_end_write_all(current->mm);
 	up_write(&current->mm->mmap_sem);
 	return ret;
 }
@@ -540,6 +542,7 @@ SYSCALL_DEFINE1(mlockall, int, flags)
 	if (!(flags & MCL_CURRENT) || (current->mm->total_vm <= lock_limit) ||
 	    capable(CAP_IPC_LOCK))
 		ret = do_mlockall(flags);
+	vma_end_write_all(current->mm);
 	up_write(&current->mm->mmap_sem);
 	if (!ret && (flags & MCL_CURRENT))
 		mm_populate(0, TASK_SIZE);
@@ -553,6 +556,7 @@ SYSCALL_DEFINE0(munlockall)
 
 	down_write(&current->mm->mmap_sem);
 	ret = do_mlockall(0);
+	vma_end_write_all(current->mm);
 	up_write(&current->mm->mmap_sem);
 	return ret;
 }
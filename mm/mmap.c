@@ -242,6 +242,25 @@ void unlink_file_vma(struct vm_area_struct *vma)
 	}
 }
 
+#ifdef CONFIG_PER_VMA_LOCK
+static void vm_area_free_rcu(struct rcu_head *head)
+{
+	kmem_cache_free(vm_area_cachep,
+			container_of(head, struct vm_area_struct, vm_rcu));
+}
+
+/* A vma that was linked into the mm may still be seen by find_vma_rcu() */
+static void vm_area_free(struct vm_area_struct *vma)
+{
+	call_rcu(&vma->vm_rcu, vm_area_free_rcu);
+}
+#else
+static void vm_area_free(struct vm_area_struct *vma)
+{
+	kmem_cache_free(vm_area_cachep, vma);
+}
+#endif
+
 /*
  * Close a vm structure and free it, returning the next.
  */
@@ -252,10 +271,12 @@ static struct vm_area_struct *remove_vma(struct vm_area_struct *vma)
 	might_sleep();
 	if (vma->vm_ops && vma->vm_ops->close)
 		vma->vm_ops->close(vma);
-	if (vma->vm_file)
+	if (vma->vm_file) {
+		readahead_async_cancel(vma);
 		fput(vma->vm_file);
+	}
 	mpol_put(vma_policy(vma));
-	kmem_cache_free(vm_area_cachep, vma);
+	vm_area_free(vma);
 	return next;
 }
 
@@ -321,6 +342,7 @@ SYSCALL_DEFINE1(brk, unsigned long, brk)
 set_brk:
 	mm->brk = brk;
 	populate = newbrk > oldbrk && (mm->def_flags & VM_LOCKED) != 0;
+	vma_end_write_all(mm);
 	up_write(&mm->mmap_sem);
 	if (populate)
 		mm_populate(oldbrk, newbrk - oldbrk);
@@ -328,6 +350,7 @@ set_brk:
 
 out:
 	retval = mm->brk;
+	vma_end_write_all(mm);
 	up_write(&mm->mmap_sem);
 	return retval;
 }
@@ -479,6 +502,7 @@ static void vma_rb_erase(struct vm_area_struct *vma, struct rb_root *root)
 	 * with the possible exception of the vma being erased.
 	 */
 	validate_mm_rb(root, vma);
+	vma_mark_detached(vma);
 
 	/*
 	 * Note rb_erase_augmented is a fairly large inline function,
@@ -600,6 +624,7 @@ void __vma_link_rb(struct mm_struct *mm, struct vm_area_struct *vma,
 	 * immediately update the gap to the correct value. Finally we
 	 * rebalance the rbtree after all augmented values have been set.
 	 */
+	vma_start_write(vma);
 	rb_link_node(&vma->vm_rb, rb_parent, rb_link);
 	vma->rb_subtree_gap = 0;
 	vma_gap_update(vma);
@@ -710,6 +735,7 @@ int vma_adjust(struct vm_area_struct *vma, unsigned long start,
 	long adjust_next = 0;
 	int remove_next = 0;
 
+	vma_start_write(vma);
 	if (next && !insert) {
 		struct vm_area_struct *exporter = NULL;
 
@@ -740,6 +766,8 @@ again:			remove_next = 1 + (end > next->vm_end);
 			exporter = vma;
 			importer = next;
 		}
+		if (exporter)
+			vma_start_write(next);
 
 		/*
 		 * Easily overlooked: when mprotect shifts the boundary,
@@ -869,7 +897,7 @@ again:			remove_next = 1 + (end > next->vm_end);
 			anon_vma_merge(vma, next);
 		mm->map_count--;
 		mpol_put(vma_policy(next));
-		kmem_cache_free(vm_area_cachep, next);
+		vm_area_free(next);
 		/*
 		 * In mprotect's case 6 (see comments on vma_merge),
 		 * we must remove another next too. It would clutter
@@ -1556,6 +1584,7 @@ munmap_back:
 	vma->vm_page_prot = vm_get_page_prot(vm_flags);
 	vma->vm_pgoff = pgoff;
 	INIT_LIST_HEAD(&vma->anon_vma_chain);
+	vma_lock_init(vma);
 
 	error = -EINVAL;	/* when rejecting VM_GROWSDOWN|VM_GROWSUP */
 
@@ -2017,6 +2046,34 @@ struct vm_area_struct *find_vma(struct mm_struct *mm, unsigned long addr)
 
 EXPORT_SYMBOL(find_vma);
 
+#ifdef CONFIG_PER_VMA_LOCK
+/*
+ * find_vma() without mmap_sem, called under rcu_read_lock(). The tree may
+ * be rebalanced under us, so the walk is bounded and its result is only a
+ * hint: the caller has to lock the vma and check that it covers @addr.
+ */
+struct vm_area_struct *find_vma_rcu(struct mm_struct *mm, unsigned long addr)
+{
+	struct rb_node *rb_node = ACCESS_ONCE(mm->mm_rb.rb_node);
+	struct vm_area_struct *vma = NULL;
+	int depth = 0;
+
+	while (rb_node && depth++ < 2 * BITS_PER_LONG) {
+		struct vm_area_struct *vma_tmp;
+
+		vma_tmp = rb_entry(rb_node, struct vm_area_struct, vm_rb);
+		if (ACCESS_ONCE(vma_tmp->vm_end) > addr) {
+			vma = vma_tmp;
+			if (ACCESS_ONCE(vma_tmp->vm_start) <= addr)
+				break;
+			rb_node = ACCESS_ONCE(rb_node->rb_left);
+		} else
+			rb_node = ACCESS_ONCE(rb_node->rb_right);
+	}
+	return vma;
+}
+#endif
+
 /*
  * Same as find_vma, but also return a pointer to the previous VMA in *pprev.
  */
@@ -2412,6 +2469,7 @@ static int __split_vma(struct mm_struct * mm, struct vm_area_struct * vma,
 	*new = *vma;
 
 	INIT_LIST_HEAD(&new->anon_vma_chain);
+	vma_lock_init(new);
 
 	if (new_below)
 		new->vm_end = addr;
@@ -2567,6 +2625,7 @@ int vm_munmap(unsigned long start, size_t len)
 
 	down_write(&mm->mmap_sem);
 	ret = do_munmap(mm, start, len);
+	vma_end_write_all(mm);
 	up_write(&mm->mmap_sem);
 	return ret;
 }
@@ -2667,6 +2726,7 @@ static unsigned long do_brk(unsigned long addr, unsigned long len)
 	}
 
 	INIT_LIST_HEAD(&vma->anon_vma_chain);
+	vma_lock_init(vma);
 	vma->vm_mm = mm;
 	vma->vm_start = addr;
 	vma->vm_end = addr + len;
@@ -2691,6 +2751,7 @@ unsigned long vm_brk(unsigned long addr, unsigned long len)
 	down_write(&mm->mmap_sem);
 	ret = do_brk(addr, len);
 	populate = ((mm->def_flags & VM_LOCKED) != 0);
+	vma_end_write_all(mm);
 	up_write(&mm->mmap_sem);
 	if (populate)
 		mm_populate(addr, len);
@@ -2847,6 +2908,7 @@ struct vm_area_struct *copy_vma(struct vm_area_struct **vmap,
 				goto out_free_vma;
 			vma_set_policy(new_vma, pol);
 			INIT_LIST_HEAD(&new_vma->anon_vma_chain);
+			vma_lock_init(new_vma);
 			if (anon_vma_clone(new_vma, vma))
 				goto out_free_mempol;
 			if (new_vma->vm_file)
@@ -2943,6 +3005,7 @@ int install_special_mapping(struct mm_struct *mm,
 		return -ENOMEM;
 
 	INIT_LIST_HEAD(&vma->anon_vma_chain);
+	vma_lock_init(vma);
 	vma->vm_mm = mm;
 	vma->vm_start = addr;
 	vma->vm_end = addr + len;
@@ -35,10 +35,15 @@
 #include <linux/freezer.h>
 #include <linux/ftrace.h>
 #include <linux/ratelimit.h>
+#include <linux/kthread.h>
+#include <linux/mmu_notifier.h>
+#include <asm/tlb.h>
 
 #define CREATE_TRACE_POINTS
 #include <trace/events/oom.h>
 
+#include "internal.h"
+
 int sysctl_panic_on_oom;
 int sysctl_oom_kill_allocating_task;
 int sysctl_oom_dump_tasks = 1;
@@ -160,7 +165,8 @@ unsigned long oom_badness(struct task_struct *p, struct mem_cgroup *memcg,
 		return 0;
 
 	adj = (long)p->signal->oom_score_adj;
-	if (adj == OOM_SCORE_ADJ_MIN) {
+	if (adj == OOM_SCORE_ADJ_MIN ||
+	    test_bit(MMF_OOM_REAPED, &p->mm->flags)) {
 		task_unlock(p);
 		return 0;
 	}
@@ -420,6 +426,203 @@ void note_oom_kill(void)
 }
 
 #define K(x) ((x) << (PAGE_SHIFT-10))
+
+#ifdef CONFIG_MMU
+/*
+ * A killed task only frees its memory once it gets to run exit_mm(), which
+ * can take a long time if it is blocked or starved of CPU by the very
+ * pressure that got it killed. The reaper tears down the private memory of
+ * the victim from its own context instead, so it is back on the free lists
+ * right away. Victims are queued on a small ring; if that overflows the
+ * task is left to free its memory on its own.
+ */
+#define OOM_REAPER_QUEUE	16
+#define OOM_REAPER_RETRIES	10
+
+static struct task_struct *oom_reaper_th;
+static DECLARE_WAIT_QUEUE_HEAD(oom_reaper_wait);
+static struct task_struct *oom_reaper_queue[OOM_REAPER_QUEUE];
+static unsigned int oom_reaper_head, oom_reaper_tail;
+static DEFINE_SPINLOCK(oom_reaper_lock);
+
+/*
+ * Returns true if a process outside @tsk's thread group that has not been
+ * killed still uses @mm, as with vfork(). Zapping would corrupt it.
+ */
+static bool oom_mm_shared_alive(struct task_struct *tsk, struct mm_struct *mm)
+{
+	struct task_struct *p, *t;
+	bool alive = false;
+
+	rcu_read_lock();
+	for_each_process(p) {
+		if (same_thread_group(p, tsk) || (p->flags & PF_KTHREAD))
+			continue;
+		for_each_thread(p, t) {
+			if (t->mm != mm)
+				continue;
+			if (!fatal_signal_pending(t))
+				alive = true;
+			break;
+		}
+		if (alive)
+			break;
+	}
+	rcu_read_unlock();
+
+	return alive;
+}
+
+/*
+ * Returns false if mmap_sem was contended and the reap should be retried,
+ * true once there is nothing more to do for @tsk.
+ */
+static bool __oom_reap_task(struct task_struct *tsk)
+{
+	struct mmu_gather tlb;
+	struct vm_area_struct *vma;
+	struct mm_struct *mm;
+	struct task_struct *p;
+
+	p = find_lock_task_mm(tsk);
+	if (!p)
+		return true;
+	mm = p->mm;
+	if (!atomic_inc_not_zero(&mm->mm_users)) {
+		task_unlock(p);
+		return true;
+	}
+	task_unlock(p);
+
+	if (!down_read_trylock(&mm->mmap_sem)) {
+		mmput(mm);
+		return false;
+	}
+
+	/* a core dump needs the memory intact */
+	if (mm->core_state || oom_mm_shared_alive(tsk, mm)) {
+		up_read(&mm->mmap_sem);
+		mmput(mm);
+		return true;
+	}
+
+	tlb_gather_mmu(&tlb, mm, 0, -1);
+	update_hiwater_rss(mm);
+	for (vma = mm->mmap; vma; vma = vma->vm_next) {
+		/*
+		 * Only anonymous pages are freed: shared mappings may have
+		 * dirty pagecache to write back, and locked or special
+		 * mappings are left to exit_mmap().
+		 */
+		if (!vma->anon_vma)
+			continue;
+		if (vma->vm_flags & (VM_SHARED | VM_LOCKED | VM_HUGETLB |
+				     VM_PFNMAP | VM_IO))
+			continue;
+
+		mmu_notifier_invalidate_range_start(mm, vma->vm_start,
+						    vma->vm_end);
+		unmap_page_range(&tlb, vma, vma->vm_start, vma->vm_end, NULL);
+		mmu_notifier_invalidate_range_end(mm, vma->vm_start,
+						  vma->vm_end);
+	}
+	tlb_finish_mmu(&tlb, 0, -1);
+	set_bit(MMF_OOM_REAPED, &mm->flags);
+
+	pr_info("oom_reaper: reaped process %d (%s), now anon-rss:%lukB, file-rss:%lukB\n",
+		task_pid_nr(tsk), tsk->comm,
+		K(get_mm_counter(mm, MM_ANONPAGES)),
+		K(get_mm_counter(mm, MM_FILEPAGES)));
+	up_read(&mm->mmap_sem);
+	mmput(mm);
+
+	/*
+	 * What is left is not worth waiting for, so let the OOM killer and
+	 * the LMK pick their next victim instead of stalling on this one.
+	 */
+	clear_tsk_thread_flag(tsk, TIF_MEMDIE);
+	return true;
+}
+
+static void oom_reap_task(struct task_struct *tsk)
+{
+	int attempts = 0;
+
+	while (attempts++ < OOM_REAPER_RETRIES && !__oom_reap_task(tsk))
+		schedule_timeout_interruptible(HZ / 10);
+
+	put_task_struct(tsk);
+}
+
+static struct task_struct *oom_reaper_next(void)
+{
+	struct task_struct *tsk = NULL;
+
+	spin_lock(&oom_reaper_lock);
+	if (oom_reaper_head != oom_reaper_tail) {
+		tsk = oom_reaper_queue[oom_reaper_tail % OOM_REAPER_QUEUE];
+		oom_reaper_tail++;
+	}
+	spin_unlock(&oom_reaper_lock);
+
+	return tsk;
+}
+
+static int oom_reaper(void *unused)
+{
+	struct task_struct *tsk;
+
+	set_freezable();
+	while (!kthread_should_stop()) {
+		wait_event_freezable(oom_reaper_wait,
+				     oom_reaper_head != oom_reaper_tail ||
+				     kthread_should_stop());
+		while ((tsk = oom_reaper_next()))
+			oom_reap_task(tsk);
+	}
+
+	return 0;
+}
+
+/*
+ * Queues @tsk, which must already have been sent SIGKILL, to have its
+ * private memory torn down by the reaper.
+ */
+void wake_oom_reaper(struct task_struct *tsk)
+{
+	unsigned int i;
+
+	if (!oom_reaper_th)
+		return;
+
+	spin_lock(&oom_reaper_lock);
+	for (i = oom_reaper_tail; i != oom_reaper_head; i++) {
+		if (oom_reaper_queue[i % OOM_REAPER_QUEUE] == tsk)
+			goto out;
+	}
+	if (oom_reaper_head - oom_reaper_tail >= OOM_REAPER_QUEUE)
+		goto out;
+	get_task_struct(tsk);
+	oom_reaper_queue[oom_reaper_head % OOM_REAPER_QUEUE] = tsk;
+	oom_reaper_head++;
+	wake_up(&oom_reaper_wait);
+out:
+	spin_unlock(&oom_reaper_lock);
+}
+
+static int __init oom_reaper_init(void)
+{
+	oom_reaper_th = kthread_run(oom_reaper, NULL, "oom_reaper");
+	if (IS_ERR(oom_reaper_th)) {
+		pr_err("Unable to start OOM reaper %ld. Continuing regardless\n",
+		       PTR_ERR(oom_reaper_th));
+		oom_reaper_th = NULL;
+	}
+	return 0;
+}
+subsys_initcall(oom_reaper_init);
+#endif /* CONFIG_MMU */
+
 /*
  * Must be called while holding a reference to p, which will be released upon
  * returning.
@@ -527,6 +730,7 @@ void oom_kill_process(struct task_struct *p, gfp_t gfp_mask, int order,
 
 	set_tsk_thread_flag(victim, TIF_MEMDIE);
 	do_send_sig_info(SIGKILL, SEND_SIG_FORCED, victim, true);
+	wake_oom_reaper(victim);
 	put_task_struct(victim);
 }
 #undef K
@@ -37,6 +37,7 @@
 #include <linux/timer.h>
 #include <linux/sched/rt.h>
 #include <linux/mm_inline.h>
+#include <linux/fb.h>
 #include <trace/events/writeback.h>
 
 #include "internal.h"
@@ -120,8 +121,17 @@ int laptop_mode;
 
 EXPORT_SYMBOL(laptop_mode);
 
+/*
+ * While the screen is off, kupdate writeback runs and dirty data expires
+ * only after this many centisecs, and writeback is batched as in laptop
+ * mode.  Zero disables the screen off mode.
+ */
+unsigned int dirty_screen_off_interval;
+
 /* End of sysctl-exported parameters */
 
+bool dirty_screen_off;
+
 unsigned long global_dirty_limit;
 
 /*
@@ -1420,7 +1430,7 @@ pause:
 	 * In normal mode, we start background writeout at the lower
 	 * background_thresh, to keep the amount of dirty memory low.
 	 */
-	if (laptop_mode)
+	if (writeback_batching())
 		return;
 
 	if (nr_reclaimable > background_thresh)
@@ -1577,7 +1587,7 @@ void laptop_mode_timer_fn(unsigned long data)
  */
 void laptop_io_completion(struct backing_dev_info *info)
 {
-	mod_timer(&info->laptop_mode_wb_timer, jiffies + laptop_mode);
+	mod_timer(&info->laptop_mode_wb_timer, jiffies + writeback_batching());
 }
 
 /*
@@ -1658,12 +1668,49 @@ static struct notifier_block __cpuinitdata ratelimit_nb = {
  * But we might still want to scale the dirty_ratio by how
  * much memory the box has..
  */
+#ifdef CONFIG_FB
+/*
+ * Dirty data batched up while the screen was off is written out as it
+ * comes back on: the device is awake anyway, and the normal expiry has
+ * long passed for most of it.
+ */
+static int dirty_fb_notifier_callback(struct notifier_block *self,
+				      unsigned long event, void *data)
+{
+	struct fb_event *evdata = data;
+	int *blank;
+
+	if (event != FB_EVENT_BLANK || !evdata || !evdata->data)
+		return NOTIFY_DONE;
+
+	blank = evdata->data;
+	if (*blank == FB_BLANK_UNBLANK) {
+		bool batching = dirty_screen_off_batching();
+
+		dirty_screen_off = false;
+		if (batching)
+			wakeup_flusher_threads(0, WB_REASON_LAPTOP_TIMER);
+	} else if (*blank == FB_BLANK_POWERDOWN) {
+		dirty_screen_off = true;
+	}
+
+	return NOTIFY_OK;
+}
+
+static struct notifier_block dirty_fb_notifier = {
+	.notifier_call = dirty_fb_notifier_callback,
+};
+#endif
+
 void __init page_writeback_init(void)
 {
 	writeback_set_ratelimit();
 	register_cpu_notifier(&ratelimit_nb);
 
 	fprop_global_init(&writeout_completions);
+#ifdef CONFIG_FB
+	fb_register_client(&dirty_fb_notifier);
+#endif
 }
 
 /**
@@ -119,6 +119,7 @@ unsigned long dirty_balance_reserve __read_mostly;
 unsigned long total_unmovable_pages __read_mostly;
 #endif
 int percpu_pagelist_fraction;
+int percpu_pagelist_autotune;
 gfp_t gfp_allowed_mask __read_mostly = GFP_BOOT_MASK;
 
 #ifdef CONFIG_PM_SLEEP
@@ -657,6 +658,15 @@ static inline int free_pages_check(struct page *page)
  * And clear the zone's pages_scanned counter, to hold off the "all pages are
  * pinned" detection logic.
  */
+/* zone->lock for the pcp bulk transfers, counting contention */
+static inline void zone_lock_bulk(struct zone *zone)
+{
+	if (!spin_trylock(&zone->lock)) {
+		__count_vm_event(ZONE_LOCK_CONTENDED);
+		spin_lock(&zone->lock);
+	}
+}
+
 static void free_pcppages_bulk(struct zone *zone, int count,
 					struct per_cpu_pages *pcp)
 {
@@ -664,7 +674,7 @@ static void free_pcppages_bulk(struct zone *zone, int count,
 	int batch_free = 0;
 	int to_free = count;
 
-	spin_lock(&zone->lock);
+	zone_lock_bulk(zone);
 	zone->pages_scanned = 0;
 
 	while (to_free) {
@@ -1191,7 +1201,7 @@ static int rmqueue_bulk(struct zone *zone, unsigned int order,
 {
 	int mt = migratetype, i;
 
-	spin_lock(&zone->lock);
+	zone_lock_bulk(zone);
 	for (i = 0; i < count; ++i) {
 		struct page *page;
 		if (cma)
@@ -1417,6 +1427,8 @@ void free_hot_cold_page(struct page *page, int cold)
 	if (pcp->count >= pcp->high) {
 		free_pcppages_bulk(zone, pcp->batch, pcp);
 		pcp->count -= pcp->batch;
+		pcp->spills++;
+		__count_vm_event(PCP_SPILL);
 	}
 
 out:
@@ -1559,6 +1571,8 @@ again:
 					pcp->batch, list,
 					migratetype, cold,
 					gfp_flags & __GFP_CMA);
+			pcp->refills++;
+			__count_vm_event(PCP_REFILL);
 			if (unlikely(list_empty(list)))
 				goto failed;
 		}
@@ -4121,6 +4135,7 @@ static void setup_pageset(struct per_cpu_pageset *p, unsigned long batch)
 	pcp->count = 0;
 	pcp->high = 6 * batch;
 	pcp->batch = max(1UL, 1 * batch);
+	pcp->base_batch = pcp->batch;
 	for (migratetype = 0; migratetype < MIGRATE_PCPTYPES; migratetype++)
 		INIT_LIST_HEAD(&pcp->lists[migratetype]);
 }
@@ -4683,6 +4698,9 @@ static void __paginginit free_area_init_core(struct pglist_data *pgdat,
 #endif
 	init_waitqueue_head(&pgdat->kswapd_wait);
 	init_waitqueue_head(&pgdat->pfmemalloc_wait);
+#ifdef CONFIG_COMPACTION
+	init_waitqueue_head(&pgdat->kcompactd_wait);
+#endif
 	pgdat_page_cgroup_init(pgdat);
 
 	for (j = 0; j < MAX_NR_ZONES; j++) {
@@ -5709,6 +5727,57 @@ int percpu_pagelist_fraction_sysctl_handler(ctl_table *table, int write,
 	return 0;
 }
 
+/*
+ * A CPU that refilled or spilled its pagelist this many times in one
+ * vmstat interval doubles its batch, up to PCP_AUTOTUNE_MAX times the
+ * zone default.  A CPU that did neither halves it again.
+ */
+#define PCP_AUTOTUNE_BUSY	8
+#define PCP_AUTOTUNE_MAX	8
+
+/*
+ * percpu_pagelist_autotune - adapt pcp->batch and pcp->high of the local
+ * cpu to its recent buddy traffic.  Called from the vmstat worker, which
+ * is deferrable, so an idle cpu is only looked at when it wakes up.
+ */
+void pageset_autotune(void)
+{
+	struct zone *zone;
+
+	if (!percpu_pagelist_autotune || percpu_pagelist_fraction)
+		return;
+
+	for_each_populated_zone(zone) {
+		struct per_cpu_pages *pcp;
+		unsigned long flags;
+		int transfers, batch, to_drain;
+
+		local_irq_save(flags);
+		pcp = &this_cpu_ptr(zone->pageset)->pcp;
+		transfers = pcp->refills + pcp->spills;
+		pcp->refills = 0;
+		pcp->spills = 0;
+
+		batch = pcp->batch;
+		if (transfers >= PCP_AUTOTUNE_BUSY)
+			batch = min(batch * 2,
+				    pcp->base_batch * PCP_AUTOTUNE_MAX);
+		else if (!transfers)
+			batch = max(batch / 2, pcp->base_batch);
+
+		if (batch != pcp->batch) {
+			pcp->batch = batch;
+			pcp->high = 6 * batch;
+		} else if (!transfers && pcp->count) {
+			/* Quiet at the default size: give a batch back */
+			to_drain = min(pcp->count, batch);
+			free_pcppages_bulk(zone, to_drain, pcp);
+			pcp->count -= to_drain;
+		}
+		local_irq_restore(flags);
+	}
+}
+
 int hashdist = HASHDIST_DEFAULT;
 
 #ifdef CONFIG_NUMA
@@ -6008,7 +6077,8 @@ static unsigned long pfn_max_align_up(unsigned long pfn)
 
 /* [start, end) must belong to a single zone. */
 static int __alloc_contig_migrate_range(struct compact_control *cc,
-					unsigned long start, unsigned long end)
+					unsigned long start, unsigned long end,
+					atomic_t *abort)
 {
 	/* This function is based on compact_zone() from compaction.c. */
 	unsigned long nr_reclaimed;
@@ -6016,10 +6086,8 @@ static int __alloc_contig_migrate_range(struct compact_control *cc,
 	unsigned int tries = 0;
 	int ret = 0;
 
-	migrate_prep();
-
 	while (pfn < end || !list_empty(&cc->migratepages)) {
-		if (fatal_signal_pending(current)) {
+		if (fatal_signal_pending(current) || atomic_read(abort)) {
 			ret = -EINTR;
 			break;
 		}
@@ -6052,6 +6120,113 @@ static int __alloc_contig_migrate_range(struct compact_control *cc,
 	return 0;
 }
 
+/*
+ * Large ranges are split into pageblock aligned chunks that are isolated and
+ * migrated in parallel, one chunk per worker plus one in the caller. The
+ * zone's lru_lock is dropped between isolation batches, so the workers do not
+ * serialise on it.
+ */
+#define CONTIG_MIGRATE_MAX_WORKERS	8
+
+struct contig_migrate_ctl {
+	struct zone *zone;
+	atomic_t pending;
+	atomic_t abort;
+	int ret;
+	struct completion done;
+};
+
+struct contig_migrate_work {
+	struct work_struct work;
+	struct contig_migrate_ctl *ctl;
+	unsigned long start, end;
+};
+
+static int contig_migrate_chunk(struct contig_migrate_ctl *ctl,
+				unsigned long start, unsigned long end)
+{
+	int ret;
+	struct compact_control cc = {
+		.nr_migratepages = 0,
+		.order = -1,
+		.zone = ctl->zone,
+		.sync = true,
+		.ignore_skip_hint = true,
+	};
+	INIT_LIST_HEAD(&cc.migratepages);
+
+	ret = __alloc_contig_migrate_range(&cc, start, end, &ctl->abort);
+	if (ret) {
+		/* The first failure is the one worth reporting */
+		cmpxchg(&ctl->ret, 0, ret);
+		atomic_set(&ctl->abort, 1);
+	}
+	return ret;
+}
+
+static void contig_migrate_workfn(struct work_struct *work)
+{
+	struct contig_migrate_work *w =
+		container_of(work, struct contig_migrate_work, work);
+	struct contig_migrate_ctl *ctl = w->ctl;
+
+	contig_migrate_chunk(ctl, w->start, w->end);
+	if (atomic_dec_and_test(&ctl->pending))
+		complete(&ctl->done);
+}
+
+static int alloc_contig_migrate_range(struct zone *zone,
+				      unsigned long start, unsigned long end)
+{
+	struct contig_migrate_work works[CONTIG_MIGRATE_MAX_WORKERS - 1];
+	struct contig_migrate_ctl ctl = {
+		.zone = zone,
+		.pending = ATOMIC_INIT(1),
+		.abort = ATOMIC_INIT(0),
+		.ret = 0,
+	};
+	unsigned long nr_chunks, chunk, pfn;
+	int i;
+
+	migrate_prep();
+
+	nr_chunks = min_t(unsigned long, num_online_cpus(),
+			  CONTIG_MIGRATE_MAX_WORKERS);
+	nr_chunks = min(nr_chunks, DIV_ROUND_UP(end - start, pageblock_nr_pages));
+	if (!system_unbound_wq)
+		nr_chunks = 1;
+	chunk = ALIGN(DIV_ROUND_UP(end - start, nr_chunks), pageblock_nr_pages);
+
+	init_completion(&ctl.done);
+
+	for (i = 0, pfn = start; pfn + chunk < end; i++, pfn += chunk) {
+		struct contig_migrate_work *w = &works[i];
+
+		w->ctl = &ctl;
+		w->start = pfn;
+		w->end = pfn + chunk;
+		INIT_WORK_ONSTACK(&w->work, contig_migrate_workfn);
+		atomic_inc(&ctl.pending);
+		queue_work(system_unbound_wq, &w->work);
+	}
+
+	/* The caller migrates the last chunk itself */
+	contig_migrate_chunk(&ctl, pfn, end);
+
+	if (!atomic_dec_and_test(&ctl.pending)) {
+		if (wait_for_completion_killable(&ctl.done)) {
+			atomic_set(&ctl.abort, 1);
+			cmpxchg(&ctl.ret, 0, -EINTR);
+			wait_for_completion(&ctl.done);
+		}
+	}
+
+	while (i--)
+		destroy_work_on_stack(&works[i].work);
+
+	return ctl.ret;
+}
+
 /**
  * alloc_contig_range() -- tries to allocate given range of pages
  * @start:	start PFN to allocate
@@ -6119,7 +6294,7 @@ int alloc_contig_range(unsigned long start, unsigned long end,
 
 	cc.zone->cma_alloc = 1;
 
-	ret = __alloc_contig_migrate_range(&cc, start, end);
+	ret = alloc_contig_migrate_range(cc.zone, start, end);
 	if (ret)
 		goto done;
 
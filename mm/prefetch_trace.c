@@ -0,0 +1,568 @@
+/*
+ * Page cache miss recording and replay
+ *
+ * While a recording window is open, the page cache misses taken by one
+ * thread group (or by every task, for boot) are logged as (file, page range)
+ * records in first-miss order, merging nearby misses in the same file. When
+ * the window is closed the log is turned into the binary trace described in
+ * <uapi/linux/prefetch_trace.h>. Userspace saves it and writes it back to
+ * the replay file before the next boot or launch of the same app; replay
+ * then issues the recorded ranges as large readahead requests, so that the
+ * hundreds of small random reads of a cold start become a few big ones.
+ *
+ *   /sys/kernel/mm/prefetch_trace/record	"start [tgid [msecs]]" / "stop"
+ *   /sys/kernel/mm/prefetch_trace/trace	last recorded trace
+ *   /sys/kernel/mm/prefetch_trace/replay	trace to replay
+ */
+
+#include <linux/mm.h>
+#include <linux/fs.h>
+#include <linux/file.h>
+#include <linux/sched.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/mutex.h>
+#include <linux/hashtable.h>
+#include <linux/workqueue.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
+#include <linux/string.h>
+#include <linux/init.h>
+#include <linux/prefetch_trace.h>
+
+#define PREFETCH_MAX_FILES	2048
+#define PREFETCH_MAX_RANGES	16384
+#define PREFETCH_MAX_TRACE	(2 << 20)
+
+/* Misses at most this many pages apart in a file are replayed as one read */
+#define PREFETCH_MERGE_GAP	32
+
+struct prefetch_file {
+	struct hlist_node node;
+	struct inode *inode;
+	char *name;
+	unsigned int last;		/* index of this file's latest range */
+};
+
+bool prefetch_trace_recording __read_mostly;
+
+/* Protects everything below */
+static DEFINE_MUTEX(prefetch_mutex);
+
+static DEFINE_HASHTABLE(prefetch_hash, 8);
+static pid_t prefetch_tgid;		/* 0 records every task */
+static struct prefetch_file *prefetch_files;
+static struct prefetch_trace_range *prefetch_ranges;
+static unsigned int prefetch_nr_files;
+static unsigned int prefetch_nr_ranges;
+static size_t prefetch_names_len;
+static unsigned long prefetch_dropped;
+
+/* Result of the last recording window */
+static void *prefetch_trace;
+static size_t prefetch_trace_len;
+
+/* Trace being written to the replay file, and the one being replayed */
+static void *prefetch_replay_buf;
+static size_t prefetch_replay_len;
+static size_t prefetch_replay_got;
+static void *prefetch_replay_trace;
+static unsigned long prefetch_replayed_pages;
+
+static void prefetch_stop_fn(struct work_struct *work);
+static DECLARE_DELAYED_WORK(prefetch_stop_work, prefetch_stop_fn);
+
+static void prefetch_replay_fn(struct work_struct *work);
+static DECLARE_WORK(prefetch_replay_work, prefetch_replay_fn);
+
+static struct prefetch_file *prefetch_lookup(struct inode *inode)
+{
+	struct prefetch_file *pf;
+
+	hash_for_each_possible(prefetch_hash, pf, node, (unsigned long)inode)
+		if (pf->inode == inode)
+			return pf;
+
+	return NULL;
+}
+
+static struct prefetch_file *prefetch_add_file(struct file *file)
+{
+	struct prefetch_file *pf;
+	char *buf, *path;
+
+	if (prefetch_nr_files >= PREFETCH_MAX_FILES)
+		return NULL;
+	pf = &prefetch_files[prefetch_nr_files];
+
+	/* Files that can't be reopened by name are useless for replay */
+	if (d_unlinked(file->f_path.dentry))
+		return NULL;
+
+	buf = (char *)__get_free_page(GFP_NOIO | __GFP_NOWARN);
+	if (!buf)
+		return NULL;
+
+	path = d_path(&file->f_path, buf, PAGE_SIZE);
+	if (IS_ERR(path))
+		goto out;
+
+	pf->name = kstrdup(path, GFP_NOIO | __GFP_NOWARN);
+	if (!pf->name)
+		goto out;
+
+	pf->inode = igrab(file_inode(file));
+	if (!pf->inode) {
+		kfree(pf->name);
+		goto out;
+	}
+
+	pf->last = UINT_MAX;
+	hash_add(prefetch_hash, &pf->node, (unsigned long)pf->inode);
+	prefetch_nr_files++;
+	prefetch_names_len += strlen(pf->name) + 1;
+	free_page((unsigned long)buf);
+
+	return pf;
+
+out:
+	free_page((unsigned long)buf);
+	return NULL;
+}
+
+void __prefetch_trace_miss(struct file *file, pgoff_t index, unsigned long nr)
+{
+	struct prefetch_file *pf;
+	struct prefetch_trace_range *r;
+	unsigned long end;
+
+	if (prefetch_tgid && current->tgid != prefetch_tgid)
+		return;
+
+	if (!nr || !S_ISREG(file_inode(file)->i_mode) || index >= U32_MAX)
+		return;
+	end = min_t(unsigned long, index + nr, U32_MAX);
+
+	mutex_lock(&prefetch_mutex);
+	if (!prefetch_trace_recording)
+		goto out;
+
+	pf = prefetch_lookup(file_inode(file));
+	if (!pf)
+		pf = prefetch_add_file(file);
+	if (!pf)
+		goto drop;
+
+	if (pf->last != UINT_MAX) {
+		r = &prefetch_ranges[pf->last];
+		if (index <= r->start + r->nr + PREFETCH_MERGE_GAP &&
+		    end + PREFETCH_MERGE_GAP >= r->start) {
+			end = max_t(unsigned long, end, r->start + r->nr);
+			r->start = min_t(unsigned long, index, r->start);
+			r->nr = end - r->start;
+			goto out;
+		}
+	}
+
+	if (prefetch_nr_ranges >= PREFETCH_MAX_RANGES)
+		goto drop;
+
+	r = &prefetch_ranges[prefetch_nr_ranges];
+	r->file = pf - prefetch_files;
+	r->start = index;
+	r->nr = end - index;
+	pf->last = prefetch_nr_ranges++;
+	goto out;
+
+drop:
+	prefetch_dropped++;
+out:
+	mutex_unlock(&prefetch_mutex);
+}
+
+static int prefetch_start(pid_t tgid, unsigned int msecs)
+{
+	int ret = 0;
+
+	cancel_delayed_work_sync(&prefetch_stop_work);
+
+	mutex_lock(&prefetch_mutex);
+	if (prefetch_trace_recording) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	prefetch_files = vzalloc(PREFETCH_MAX_FILES * sizeof(*prefetch_files));
+	prefetch_ranges = vmalloc(PREFETCH_MAX_RANGES *
+				  sizeof(*prefetch_ranges));
+	if (!prefetch_files || !prefetch_ranges) {
+		vfree(prefetch_files);
+		vfree(prefetch_ranges);
+		prefetch_files = NULL;
+		prefetch_ranges = NULL;
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	prefetch_tgid = tgid;
+	prefetch_nr_files = 0;
+	prefetch_nr_ranges = 0;
+	prefetch_names_len = 0;
+	prefetch_dropped = 0;
+	prefetch_trace_recording = true;
+
+	if (msecs)
+		schedule_delayed_work(&prefetch_stop_work,
+				      msecs_to_jiffies(msecs));
+out:
+	mutex_unlock(&prefetch_mutex);
+	return ret;
+}
+
+/* Turn the recorded misses into a trace. Called with prefetch_mutex held. */
+static void *prefetch_build_trace(size_t *lenp)
+{
+	struct prefetch_trace_header *hdr;
+	size_t ranges_len = prefetch_nr_ranges * sizeof(*prefetch_ranges);
+	char *names;
+	unsigned int i;
+	size_t len;
+
+	len = sizeof(*hdr) + ranges_len + prefetch_names_len;
+	hdr = vmalloc(len);
+	if (!hdr)
+		return NULL;
+
+	hdr->magic = PREFETCH_TRACE_MAGIC;
+	hdr->version = PREFETCH_TRACE_VERSION;
+	hdr->page_shift = PAGE_SHIFT;
+	hdr->nr_files = prefetch_nr_files;
+	hdr->nr_ranges = prefetch_nr_ranges;
+	hdr->names_len = prefetch_names_len;
+	memcpy(hdr + 1, prefetch_ranges, ranges_len);
+
+	names = (char *)(hdr + 1) + ranges_len;
+	for (i = 0; i < prefetch_nr_files; i++) {
+		size_t n = strlen(prefetch_files[i].name) + 1;
+
+		memcpy(names, prefetch_files[i].name, n);
+		names += n;
+	}
+
+	*lenp = len;
+	return hdr;
+}
+
+static int prefetch_stop(void)
+{
+	unsigned int i;
+	void *trace;
+	size_t len = 0;
+	int ret = 0;
+
+	mutex_lock(&prefetch_mutex);
+	if (!prefetch_trace_recording) {
+		ret = -EINVAL;
+		goto out;
+	}
+	prefetch_trace_recording = false;
+
+	trace = prefetch_build_trace(&len);
+	if (!trace)
+		ret = -ENOMEM;
+	vfree(prefetch_trace);
+	prefetch_trace = trace;
+	prefetch_trace_len = len;
+
+	for (i = 0; i < prefetch_nr_files; i++) {
+		iput(prefetch_files[i].inode);
+		kfree(prefetch_files[i].name);
+	}
+	hash_init(prefetch_hash);
+	vfree(prefetch_files);
+	vfree(prefetch_ranges);
+	prefetch_files = NULL;
+	prefetch_ranges = NULL;
+out:
+	mutex_unlock(&prefetch_mutex);
+
+	cancel_delayed_work(&prefetch_stop_work);
+	return ret;
+}
+
+static void prefetch_stop_fn(struct work_struct *work)
+{
+	prefetch_stop();
+}
+
+static void prefetch_replay_fn(struct work_struct *work)
+{
+	struct prefetch_trace_header *hdr = prefetch_replay_trace;
+	struct prefetch_trace_range *ranges = (void *)(hdr + 1);
+	char *names = (char *)(ranges + hdr->nr_ranges);
+	char *end = names + hdr->names_len;
+	struct file **files;
+	char **name;
+	unsigned long pages = 0;
+	unsigned int i;
+
+	name = kcalloc(hdr->nr_files, sizeof(*name), GFP_KERNEL);
+	files = kcalloc(hdr->nr_files, sizeof(*files), GFP_KERNEL);
+	if (!name || !files)
+		goto out;
+
+	for (i = 0; i < hdr->nr_files && names < end; i++) {
+		size_t n = strnlen(names, end - names);
+
+		if (n == end - names)
+			break;
+		name[i] = names;
+		names += n + 1;
+	}
+
+	for (i = 0; i < hdr->nr_ranges; i++) {
+		struct prefetch_trace_range *r = &ranges[i];
+		struct file *filp;
+
+		if (r->file >= hdr->nr_files || !name[r->file])
+			continue;
+
+		filp = files[r->file];
+		if (!filp) {
+			filp = filp_open(name[r->file], O_RDONLY | O_LARGEFILE,
+					 0);
+			if (IS_ERR(filp)) {
+				name[r->file] = NULL;
+				continue;
+			}
+			files[r->file] = filp;
+		}
+
+		force_page_cache_readahead(filp->f_mapping, filp,
+					   r->start, r->nr);
+		pages += r->nr;
+		cond_resched();
+	}
+
+	for (i = 0; i < hdr->nr_files; i++)
+		if (files[i])
+			fput(files[i]);
+out:
+	kfree(files);
+	kfree(name);
+
+	mutex_lock(&prefetch_mutex);
+	vfree(prefetch_replay_trace);
+	prefetch_replay_trace = NULL;
+	prefetch_replayed_pages += pages;
+	mutex_unlock(&prefetch_mutex);
+}
+
+#define PREFETCH_ATTR_RO(_name) \
+	static struct kobj_attribute _name##_attr = __ATTR_RO(_name)
+#define PREFETCH_ATTR(_name) \
+	static struct kobj_attribute _name##_attr = \
+		__ATTR(_name, 0644, _name##_show, _name##_store)
+
+static ssize_t record_show(struct kobject *kobj,
+			   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%s\n",
+		       prefetch_trace_recording ? "recording" : "idle");
+}
+
+static ssize_t record_store(struct kobject *kobj,
+			    struct kobj_attribute *attr,
+			    const char *buf, size_t count)
+{
+	int tgid = 0;
+	unsigned int msecs = 0;
+	int err;
+
+	if (sysfs_streq(buf, "stop")) {
+		err = prefetch_stop();
+	} else if (!strncmp(buf, "start", 5)) {
+		if (sscanf(buf + 5, "%d %u", &tgid, &msecs) < 0)
+			tgid = 0;
+		if (tgid < 0)
+			return -EINVAL;
+		err = prefetch_start(tgid, msecs);
+	} else {
+		return -EINVAL;
+	}
+
+	return err ? err : count;
+}
+PREFETCH_ATTR(record);
+
+static ssize_t nr_files_show(struct kobject *kobj,
+			     struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", prefetch_nr_files);
+}
+PREFETCH_ATTR_RO(nr_files);
+
+static ssize_t nr_ranges_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", prefetch_nr_ranges);
+}
+PREFETCH_ATTR_RO(nr_ranges);
+
+static ssize_t dropped_show(struct kobject *kobj,
+			    struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", prefetch_dropped);
+}
+PREFETCH_ATTR_RO(dropped);
+
+static ssize_t replayed_pages_show(struct kobject *kobj,
+				   struct kobj_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%lu\n", prefetch_replayed_pages);
+}
+PREFETCH_ATTR_RO(replayed_pages);
+
+static struct attribute *prefetch_attrs[] = {
+	&record_attr.attr,
+	&nr_files_attr.attr,
+	&nr_ranges_attr.attr,
+	&dropped_attr.attr,
+	&replayed_pages_attr.attr,
+	NULL,
+};
+
+static struct attribute_group prefetch_attr_group = {
+	.attrs = prefetch_attrs,
+};
+
+static ssize_t trace_read(struct file *filp, struct kobject *kobj,
+			  struct bin_attribute *attr, char *buf,
+			  loff_t off, size_t count)
+{
+	ssize_t ret;
+
+	mutex_lock(&prefetch_mutex);
+	if (prefetch_trace_recording) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (off >= prefetch_trace_len) {
+		ret = 0;
+		goto out;
+	}
+
+	ret = min_t(size_t, count, prefetch_trace_len - off);
+	memcpy(buf, prefetch_trace + off, ret);
+out:
+	mutex_unlock(&prefetch_mutex);
+	return ret;
+}
+
+/*
+ * The trace may arrive in several chunks; it is replayed once all the
+ * bytes announced by its header have been written.
+ */
+static ssize_t replay_write(struct file *filp, struct kobject *kobj,
+			    struct bin_attribute *attr, char *buf,
+			    loff_t off, size_t count)
+{
+	ssize_t ret = -EINVAL;
+
+	mutex_lock(&prefetch_mutex);
+	if (prefetch_replay_trace) {
+		ret = -EBUSY;
+		goto out;
+	}
+
+	if (off == 0) {
+		struct prefetch_trace_header *hdr = (void *)buf;
+		size_t len;
+
+		vfree(prefetch_replay_buf);
+		prefetch_replay_buf = NULL;
+
+		if (count < sizeof(*hdr) ||
+		    hdr->magic != PREFETCH_TRACE_MAGIC ||
+		    hdr->version != PREFETCH_TRACE_VERSION ||
+		    hdr->page_shift != PAGE_SHIFT ||
+		    hdr->nr_files > PREFETCH_MAX_FILES ||
+		    hdr->nr_ranges > PREFETCH_MAX_RANGES ||
+		    hdr->names_len > PREFETCH_MAX_TRACE)
+			goto out;
+
+		len = sizeof(*hdr) +
+		      hdr->nr_ranges * sizeof(struct prefetch_trace_range) +
+		      hdr->names_len;
+		if (len > PREFETCH_MAX_TRACE)
+			goto out;
+
+		prefetch_replay_buf = vmalloc(len);
+		if (!prefetch_replay_buf) {
+			ret = -ENOMEM;
+			goto out;
+		}
+		prefetch_replay_len = len;
+		prefetch_replay_got = 0;
+	} else if (!prefetch_replay_buf || off != prefetch_replay_got) {
+		goto out;
+	}
+
+	ret = min_t(size_t, count, prefetch_replay_len - prefetch_replay_got);
+	memcpy(prefetch_replay_buf + prefetch_replay_got, buf, ret);
+	prefetch_replay_got += ret;
+
+	if (prefetch_replay_got == prefetch_replay_len) {
+		prefetch_replay_trace = prefetch_replay_buf;
+		prefetch_replay_buf = NULL;
+		queue_work(system_unbound_wq, &prefetch_replay_work);
+	}
+out:
+	mutex_unlock(&prefetch_mutex);
+	return ret;
+}
+
+static struct bin_attribute trace_attr = {
+	.attr = { .name = "trace", .mode = 0400 },
+	.read = trace_read,
+};
+
+static struct bin_attribute replay_attr = {
+	.attr = { .name = "replay", .mode = 0200 },
+	.write = replay_write,
+};
+
+static int __init prefetch_trace_init(void)
+{
+	struct kobject *kobj;
+	int err;
+
+	kobj = kobject_create_and_add("prefetch_trace", mm_kobj);
+	if (!kobj)
+		return -ENOMEM;
+
+	err = sysfs_create_group(kobj, &prefetch_attr_group);
+	if (err)
+		goto put;
+
+	err = sysfs_create_bin_file(kobj, &trace_attr);
+	if (err)
+		goto remove_group;
+
+	err = sysfs_create_bin_file(kobj, &replay_attr);
+	if (err)
+		goto remove_trace;
+
+	return 0;
+
+remove_trace:
+	sysfs_remove_bin_file(kobj, &trace_attr);
+remove_group:
+	sysfs_remove_group(kobj, &prefetch_attr_group);
+put:
+	printk(KERN_ERR "prefetch_trace: register sysfs failed\n");
+	kobject_put(kobj);
+	return err;
+}
+module_init(prefetch_trace_init);
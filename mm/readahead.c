@@ -19,6 +19,8 @@
 #include <linux/pagemap.h>
 #include <linux/syscalls.h>
 #include <linux/file.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 /*
  * Initialise a struct file's readahead state.  Assumes that the caller has
@@ -179,7 +181,7 @@ __do_page_cache_readahead(struct address_space *mapping, struct file *filp,
 		rcu_read_lock();
 		page = radix_tree_lookup(&mapping->page_tree, page_offset);
 		rcu_read_unlock();
-		if (page)
+		if (page && !radix_tree_exceptional_entry(page))
 			continue;
 
 		page = page_cache_alloc_readahead(mapping);
@@ -240,6 +242,208 @@ int force_page_cache_readahead(struct address_space *mapping, struct file *filp,
 	return ret;
 }
 
+/*
+ * Readahead queued by MADV_WILLNEED_ASYNC.  Each bdi works through its
+ * requests from a work item, foreground requests before background ones,
+ * in the same 2 megabyte chunks as force_page_cache_readahead() so that a
+ * large background range cannot hold back a foreground one for long.
+ * Unmapping the range cancels what was not read yet.
+ */
+#define RA_ASYNC_FOREGROUND	0
+#define RA_ASYNC_BACKGROUND	1
+#define RA_ASYNC_MAX_REQS	128
+
+struct ra_async_req {
+	struct list_head list;
+	struct file *file;
+	struct mm_struct *mm;		/* only compared, not referenced */
+	pgoff_t start;
+	unsigned long nr_pages;
+	int prio;
+	bool cancelled;
+};
+
+/* Requests queued on any bdi, so that munmap can skip the lookup */
+static atomic_t ra_async_pending = ATOMIC_INIT(0);
+
+static void ra_async_free(struct ra_async_req *req)
+{
+	atomic_dec(&ra_async_pending);
+	fput(req->file);
+	kfree(req);
+}
+
+static struct ra_async_req *ra_async_next(struct backing_dev_info *bdi)
+{
+	int prio;
+
+	for (prio = RA_ASYNC_FOREGROUND; prio <= RA_ASYNC_BACKGROUND; prio++)
+		if (!list_empty(&bdi->ra_async_list[prio]))
+			return list_first_entry(&bdi->ra_async_list[prio],
+						struct ra_async_req, list);
+	return NULL;
+}
+
+static void ra_async_workfn(struct work_struct *work)
+{
+	struct backing_dev_info *bdi = container_of(work,
+				struct backing_dev_info, ra_async_work);
+	unsigned long chunk = (2 * 1024 * 1024) / PAGE_CACHE_SIZE;
+	struct ra_async_req *req;
+	unsigned long nr;
+	pgoff_t start;
+
+	for (;;) {
+		spin_lock(&bdi->ra_async_lock);
+		req = ra_async_next(bdi);
+		if (!req) {
+			spin_unlock(&bdi->ra_async_lock);
+			break;
+		}
+		list_del_init(&req->list);
+		start = req->start;
+		nr = min(req->nr_pages, chunk);
+		req->start += nr;
+		req->nr_pages -= nr;
+		bdi->ra_async_active = req;
+		spin_unlock(&bdi->ra_async_lock);
+
+		force_page_cache_readahead(req->file->f_mapping, req->file,
+					   start, nr);
+
+		spin_lock(&bdi->ra_async_lock);
+		bdi->ra_async_active = NULL;
+		if (req->nr_pages && !req->cancelled) {
+			list_add(&req->list, &bdi->ra_async_list[req->prio]);
+			req = NULL;
+		} else {
+			bdi->ra_async_nr--;
+		}
+		spin_unlock(&bdi->ra_async_lock);
+
+		if (req)
+			ra_async_free(req);
+		cond_resched();
+	}
+}
+
+/**
+ * readahead_async - queue readahead of a file range to its bdi
+ * @filp: file to read
+ * @offset: first page to read
+ * @nr_to_read: number of pages
+ *
+ * Returns false if the request could not be queued, in which case the
+ * caller should fall back to force_page_cache_readahead().  Callers with
+ * a positive nice value are served after everybody else.
+ */
+bool readahead_async(struct file *filp, pgoff_t offset,
+		     unsigned long nr_to_read)
+{
+	struct address_space *mapping = filp->f_mapping;
+	struct backing_dev_info *bdi = mapping->backing_dev_info;
+	struct ra_async_req *req;
+
+	if (unlikely(!mapping->a_ops->readpage && !mapping->a_ops->readpages))
+		return false;
+
+	nr_to_read = max_sane_readahead(nr_to_read);
+	if (!nr_to_read)
+		return true;
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return false;
+
+	req->file = get_file(filp);
+	req->mm = current->mm;
+	req->start = offset;
+	req->nr_pages = nr_to_read;
+	req->prio = task_nice(current) > 0 ? RA_ASYNC_BACKGROUND :
+					     RA_ASYNC_FOREGROUND;
+
+	spin_lock(&bdi->ra_async_lock);
+	if (bdi->ra_async_nr >= RA_ASYNC_MAX_REQS) {
+		spin_unlock(&bdi->ra_async_lock);
+		fput(req->file);
+		kfree(req);
+		return false;
+	}
+	bdi->ra_async_nr++;
+	atomic_inc(&ra_async_pending);
+	list_add_tail(&req->list, &bdi->ra_async_list[req->prio]);
+	spin_unlock(&bdi->ra_async_lock);
+
+	queue_work(system_unbound_wq, &bdi->ra_async_work);
+	return true;
+}
+
+/*
+ * Called as @vma goes away: drop the readahead its mm queued for the
+ * file range it mapped.
+ */
+void readahead_async_cancel(struct vm_area_struct *vma)
+{
+	struct backing_dev_info *bdi;
+	struct ra_async_req *req, *tmp;
+	pgoff_t start = vma->vm_pgoff;
+	pgoff_t end = start + vma_pages(vma);
+	LIST_HEAD(cancelled);
+	int prio;
+
+	if (!atomic_read(&ra_async_pending))
+		return;
+
+	bdi = vma->vm_file->f_mapping->backing_dev_info;
+	spin_lock(&bdi->ra_async_lock);
+	for (prio = RA_ASYNC_FOREGROUND; prio <= RA_ASYNC_BACKGROUND; prio++) {
+		list_for_each_entry_safe(req, tmp, &bdi->ra_async_list[prio],
+					 list) {
+			if (req->mm != vma->vm_mm ||
+			    req->file != vma->vm_file ||
+			    req->start >= end ||
+			    req->start + req->nr_pages <= start)
+				continue;
+			list_move(&req->list, &cancelled);
+			bdi->ra_async_nr--;
+		}
+	}
+	req = bdi->ra_async_active;
+	if (req && req->mm == vma->vm_mm && req->file == vma->vm_file)
+		req->cancelled = true;
+	spin_unlock(&bdi->ra_async_lock);
+
+	list_for_each_entry_safe(req, tmp, &cancelled, list)
+		ra_async_free(req);
+}
+
+void bdi_ra_async_init(struct backing_dev_info *bdi)
+{
+	spin_lock_init(&bdi->ra_async_lock);
+	INIT_LIST_HEAD(&bdi->ra_async_list[RA_ASYNC_FOREGROUND]);
+	INIT_LIST_HEAD(&bdi->ra_async_list[RA_ASYNC_BACKGROUND]);
+	bdi->ra_async_nr = 0;
+	bdi->ra_async_active = NULL;
+	INIT_WORK(&bdi->ra_async_work, ra_async_workfn);
+}
+
+void bdi_ra_async_destroy(struct backing_dev_info *bdi)
+{
+	struct ra_async_req *req;
+
+	cancel_work_sync(&bdi->ra_async_work);
+
+	spin_lock(&bdi->ra_async_lock);
+	while ((req = ra_async_next(bdi))) {
+		list_del(&req->list);
+		spin_unlock(&bdi->ra_async_lock);
+		ra_async_free(req);
+		spin_lock(&bdi->ra_async_lock);
+	}
+	bdi->ra_async_nr = 0;
+	spin_unlock(&bdi->ra_async_lock);
+}
+
 /*
  * Given a desired number of PAGE_CACHE_SIZE readahead pages, return a
  * sensible upper limit.
@@ -356,7 +560,7 @@ static pgoff_t count_history_pages(struct address_space *mapping,
 	pgoff_t head;
 
 	rcu_read_lock();
-	head = radix_tree_prev_hole(&mapping->page_tree, offset - 1, max);
+	head = page_cache_prev_hole(mapping, offset - 1, max);
 	rcu_read_unlock();
 
 	return offset - 1 - head;
@@ -435,7 +639,7 @@ ondemand_readahead(struct address_space *mapping,
 		pgoff_t start;
 
 		rcu_read_lock();
-		start = radix_tree_next_hole(&mapping->page_tree, offset+1,max);
+		start = page_cache_next_hole(mapping, offset + 1, max);
 		rcu_read_unlock();
 
 		if (!start || start - offset > max)
@@ -0,0 +1,124 @@
+/*
+ * linux/mm/swap_slots.c
+ *
+ * Per-cpu cache of swap slots.
+ *
+ * get_swap_pages() takes swap_lock and scans a swap_map, which becomes a
+ * hotspot when several reclaim contexts swap out to the same device. So
+ * each CPU keeps a small stash of slots that are allocated in batches,
+ * and get_swap_page() only goes to the swap devices once its stash is
+ * empty. The cached slots are accounted as in use (SWAP_HAS_CACHE, and not
+ * in nr_swap_pages). They are handed back when their CPU goes offline or
+ * the device is swapped off.
+ *
+ * The stash is protected by a mutex rather than by disabling preemption,
+ * since allocating slots may sleep. A task that migrates after picking its
+ * CPU's cache just ends up sharing it with that CPU for one allocation.
+ */
+
+#include <linux/swap.h>
+#include <linux/cpu.h>
+#include <linux/percpu.h>
+#include <linux/mutex.h>
+#include <linux/init.h>
+
+#define SWAP_SLOTS_CACHE_SIZE	64
+
+struct swap_slots_cache {
+	struct mutex	alloc_lock;
+	int		nr;
+	int		cur;
+	swp_entry_t	slots[SWAP_SLOTS_CACHE_SIZE];
+};
+
+static DEFINE_PER_CPU(struct swap_slots_cache, swp_slots);
+static bool swap_slot_cache_ready __read_mostly;
+
+/*
+ * Only stash slots while swap is far from full, so that the slots parked on
+ * other CPUs can't make an allocation fail.
+ */
+static bool swap_slot_cache_worthwhile(void)
+{
+	return get_nr_swap_pages() >
+		(long)SWAP_SLOTS_CACHE_SIZE * 2 * num_online_cpus();
+}
+
+/* Called with cache->alloc_lock held */
+static void drain_slots_cache(struct swap_slots_cache *cache)
+{
+	if (cache->nr)
+		swapcache_free_entries(cache->slots + cache->cur, cache->nr);
+	cache->nr = 0;
+	cache->cur = 0;
+}
+
+static void drain_slots_cache_cpu(unsigned int cpu)
+{
+	struct swap_slots_cache *cache = &per_cpu(swp_slots, cpu);
+
+	mutex_lock(&cache->alloc_lock);
+	drain_slots_cache(cache);
+	mutex_unlock(&cache->alloc_lock);
+}
+
+/*
+ * Return all cached slots to the swap devices. swapoff calls this after
+ * clearing SWP_WRITEOK, so the device can't be picked for a refill again.
+ */
+void drain_swap_slots_caches(void)
+{
+	unsigned int cpu;
+
+	if (!swap_slot_cache_ready)
+		return;
+
+	for_each_possible_cpu(cpu)
+		drain_slots_cache_cpu(cpu);
+}
+
+swp_entry_t get_swap_page(void)
+{
+	struct swap_slots_cache *cache;
+	swp_entry_t entry = { 0 };
+
+	if (!swap_slot_cache_ready || !swap_slot_cache_worthwhile()) {
+		get_swap_pages(1, &entry);
+		return entry;
+	}
+
+	cache = __this_cpu_ptr(&swp_slots);
+
+	mutex_lock(&cache->alloc_lock);
+	if (!cache->nr) {
+		cache->cur = 0;
+		cache->nr = get_swap_pages(SWAP_SLOTS_CACHE_SIZE, cache->slots);
+	}
+	if (cache->nr) {
+		entry = cache->slots[cache->cur++];
+		cache->nr--;
+	}
+	mutex_unlock(&cache->alloc_lock);
+
+	return entry;
+}
+
+static int swap_slots_cpu_callback(struct notifier_block *nfb,
+				   unsigned long action, void *hcpu)
+{
+	if (action == CPU_DEAD || action == CPU_DEAD_FROZEN)
+		drain_slots_cache_cpu((unsigned long)hcpu);
+	return NOTIFY_OK;
+}
+
+static int __init swap_slots_init(void)
+{
+	unsigned int cpu;
+
+	for_each_possible_cpu(cpu)
+		mutex_init(&per_cpu(swp_slots, cpu).alloc_lock);
+	hotcpu_notifier(swap_slots_cpu_callback, 0);
+	swap_slot_cache_ready = true;
+	return 0;
+}
+subsys_initcall(swap_slots_init);
@@ -18,9 +18,13 @@
 #include <linux/pagevec.h>
 #include <linux/migrate.h>
 #include <linux/page_cgroup.h>
+#include <linux/kobject.h>
+#include <linux/sysfs.h>
 
 #include <asm/pgtable.h>
 
+#include "internal.h"
+
 /*
  * swapper_space is a fiction, retained to simplify the path through
  * vmscan's shrink_page_list.
@@ -286,8 +290,13 @@ struct page * lookup_swap_cache(swp_entry_t entry)
 
 	page = find_get_page(swap_address_space(entry), entry.val);
 
-	if (page)
+	if (page) {
 		INC_CACHE_INFO(find_success);
+		if (TestClearPageReadahead(page)) {
+			atomic_inc(&swp_swap_info(entry)->ra_hits);
+			count_vm_event(SWAP_RA_HIT);
+		}
+	}
 
 	INC_CACHE_INFO(find_total);
 	return page;
@@ -406,20 +415,27 @@ struct page *read_swap_cache_async(swp_entry_t entry, gfp_t gfp_mask,
  * This has been extended to use the NUMA policies from the mm triggering
  * the readahead.
  *
+ * Swap areas whose policy is not SWAP_RA_CLUSTER only get the faulting
+ * entry read here.
+ *
  * Caller must hold down_read on the vma->vm_mm if vma is not NULL.
  */
 struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 			struct vm_area_struct *vma, unsigned long addr)
 {
 	struct page *page;
-	unsigned long offset = swp_offset(entry);
+	unsigned long entry_offset = swp_offset(entry);
+	unsigned long offset;
 	unsigned long start_offset, end_offset;
 	unsigned long mask = (1UL << page_cluster) - 1;
 	struct blk_plug plug;
 
+	if (ACCESS_ONCE(swp_swap_info(entry)->ra_mode) != SWAP_RA_CLUSTER)
+		goto skip;
+
 	/* Read a page_cluster sized and aligned cluster around offset. */
-	start_offset = offset & ~mask;
-	end_offset = offset | mask;
+	start_offset = entry_offset & ~mask;
+	end_offset = entry_offset | mask;
 	if (!start_offset)	/* First page is swap header. */
 		start_offset++;
 
@@ -430,10 +446,216 @@ struct page *swapin_readahead(swp_entry_t entry, gfp_t gfp_mask,
 						gfp_mask, vma, addr);
 		if (!page)
 			continue;
+		if (offset != entry_offset) {
+			SetPageReadahead(page);
+			count_vm_event(SWAP_RA);
+		}
+		page_cache_release(page);
+	}
+	blk_finish_plug(&plug);
+
+	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
+	return read_swap_cache_async(entry, gfp_mask, vma, addr);
+}
+
+/* Upper bound on the vma readahead window, in pages */
+#define SWAP_RA_VMA_MAX		16
+
+/*
+ * Size the next vma readahead window of @si from the readahead pages
+ * that were hit since the previous fault: no hits and a non sequential
+ * fault collapse the window to the faulting page, hits grow it to the
+ * next power of two, and it never shrinks by more than half at a time.
+ */
+static unsigned int swap_ra_window(struct swap_info_struct *si,
+				   unsigned long pfn)
+{
+	unsigned int pages, last, max_pages;
+	int cluster = ACCESS_ONCE(page_cluster);
+
+	if (cluster >= ilog2(SWAP_RA_VMA_MAX))
+		max_pages = SWAP_RA_VMA_MAX;
+	else
+		max_pages = 1 << cluster;
+	if (max_pages <= 1)
+		return 1;
+
+	pages = atomic_xchg(&si->ra_hits, 0) + 2;
+	if (pages == 2) {
+		if (pfn != si->ra_prev + 1 && pfn != si->ra_prev - 1)
+			pages = 1;
+	} else {
+		pages = roundup_pow_of_two(pages);
+	}
+	si->ra_prev = pfn;
+
+	if (pages > max_pages)
+		pages = max_pages;
+	last = atomic_read(&si->ra_win) / 2;
+	if (pages < last)
+		pages = last;
+	atomic_set(&si->ra_win, pages);
+
+	return pages;
+}
+
+/**
+ * swapin_vma_readahead - swap in pages mapped around a faulting address
+ * @entry: swap entry of this memory
+ * @gfp_mask: memory allocation flags
+ * @vma: user vma this address belongs to
+ * @addr: faulting address
+ *
+ * Returns the struct page for entry and addr, after queueing swapin.
+ *
+ * For swap areas using SWAP_RA_VMA, reads the swap entries found in the
+ * ptes around @addr instead of the neighbouring swap offsets; the window
+ * follows the hit rate of earlier readahead.  Other policies fall back
+ * to swapin_readahead().
+ *
+ * Caller must hold down_read on the vma->vm_mm.
+ */
+struct page *swapin_vma_readahead(swp_entry_t entry, gfp_t gfp_mask,
+			struct vm_area_struct *vma, unsigned long addr)
+{
+	struct swap_info_struct *si = swp_swap_info(entry);
+	swp_entry_t entries[SWAP_RA_VMA_MAX];
+	unsigned long addrs[SWAP_RA_VMA_MAX];
+	unsigned long start, end, win_size;
+	struct blk_plug plug;
+	struct page *page;
+	unsigned int win;
+	pmd_t *pmd;
+	pte_t *pte, *orig_pte;
+	int i, nr = 0;
+
+	if (ACCESS_ONCE(si->ra_mode) != SWAP_RA_VMA)
+		return swapin_readahead(entry, gfp_mask, vma, addr);
+
+	win = swap_ra_window(si, addr >> PAGE_SHIFT);
+	if (win <= 1)
+		goto skip;
+
+	/* Read an aligned window around addr, within the vma and pmd. */
+	win_size = (unsigned long)win << PAGE_SHIFT;
+	start = max3(addr & ~(win_size - 1), vma->vm_start, addr & PMD_MASK);
+	end = min3((addr & ~(win_size - 1)) + win_size, vma->vm_end,
+		   (addr & PMD_MASK) + PMD_SIZE);
+
+	pmd = mm_find_pmd(vma->vm_mm, addr);
+	if (!pmd || pmd_trans_huge(*pmd))
+		goto skip;
+
+	/*
+	 * The ptes are only sampled: read_swap_cache_async() revalidates
+	 * each entry, and the fault path rechecks the pte it maps.
+	 */
+	orig_pte = pte = pte_offset_map(pmd, start);
+	for (; start < end; start += PAGE_SIZE, pte++) {
+		pte_t pteval = *pte;
+		swp_entry_t ent;
+
+		if (!is_swap_pte(pteval))
+			continue;
+		ent = pte_to_swp_entry(pteval);
+		if (non_swap_entry(ent) || swp_type(ent) != swp_type(entry) ||
+		    ent.val == entry.val)
+			continue;
+		entries[nr] = ent;
+		addrs[nr++] = start;
+	}
+	pte_unmap(orig_pte);
+
+	blk_start_plug(&plug);
+	for (i = 0; i < nr; i++) {
+		page = read_swap_cache_async(entries[i], gfp_mask, vma,
+					     addrs[i]);
+		if (!page)
+			continue;
+		SetPageReadahead(page);
+		count_vm_event(SWAP_RA);
 		page_cache_release(page);
 	}
 	blk_finish_plug(&plug);
 
 	lru_add_drain();	/* Push any new pages onto the LRU now */
+skip:
 	return read_swap_cache_async(entry, gfp_mask, vma, addr);
 }
+
+#ifdef CONFIG_SYSFS
+static const char * const swap_ra_names[] = {
+	[SWAP_RA_CLUSTER]	= "cluster",
+	[SWAP_RA_VMA]		= "vma",
+	[SWAP_RA_NONE]		= "none",
+};
+
+static ssize_t readahead_show(struct kobject *kobj,
+			      struct kobj_attribute *attr, char *buf)
+{
+	return swap_ra_mode_show(buf, swap_ra_names);
+}
+
+/*
+ * Takes "<swap file or device> <cluster|vma|none>".
+ */
+static ssize_t readahead_store(struct kobject *kobj,
+			       struct kobj_attribute *attr,
+			       const char *buf, size_t count)
+{
+	char *tmp, *path, *mode;
+	unsigned int i;
+	int err = -EINVAL;
+
+	tmp = kstrndup(buf, count, GFP_KERNEL);
+	if (!tmp)
+		return -ENOMEM;
+
+	mode = strim(tmp);
+	path = strsep(&mode, " \t");
+	if (!mode)
+		goto out;
+	mode = skip_spaces(mode);
+
+	for (i = 0; i < ARRAY_SIZE(swap_ra_names); i++) {
+		if (!strcmp(mode, swap_ra_names[i])) {
+			err = swap_ra_mode_set(path, i);
+			break;
+		}
+	}
+out:
+	kfree(tmp);
+	return err ? err : count;
+}
+
+static struct kobj_attribute readahead_attr =
+	__ATTR(readahead, 0644, readahead_show, readahead_store);
+
+static struct attribute *swap_attrs[] = {
+	&readahead_attr.attr,
+	NULL,
+};
+
+static struct attribute_group swap_attr_group = {
+	.attrs = swap_attrs,
+};
+
+static int __init swap_init_sysfs(void)
+{
+	struct kobject *swap_kobj;
+	int err;
+
+	swap_kobj = kobject_create_and_add("swap", mm_kobj);
+	if (!swap_kobj)
+		return -ENOMEM;
+
+	err = sysfs_create_group(swap_kobj, &swap_attr_group);
+	if (err) {
+		kobject_put(swap_kobj);
+		return err;
+	}
+	return 0;
+}
+subsys_initcall(swap_init_sysfs);
+#endif /* CONFIG_SYSFS */
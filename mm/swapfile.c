@@ -413,18 +413,27 @@ no_page:
 	return 0;
 }
 
-swp_entry_t get_swap_page(void)
+/*
+ * Allocate up to @n swap entries for the swap cache into @swp_entries,
+ * all from the first device that has any. Returns how many were allocated.
+ * Most callers go through the per-cpu cache in get_swap_page().
+ */
+int get_swap_pages(int n, swp_entry_t swp_entries[])
 {
 	struct swap_info_struct *si;
 	pgoff_t offset;
 	int type, next;
 	int wrapped = 0;
 	int hp_index;
+	int n_ret = 0;
+	long avail;
 
 	spin_lock(&swap_lock);
-	if (atomic_long_read(&nr_swap_pages) <= 0)
+	avail = atomic_long_read(&nr_swap_pages);
+	if (avail <= 0)
 		goto noswap;
-	atomic_long_dec(&nr_swap_pages);
+	n = min_t(long, n, avail);
+	atomic_long_sub(n, &nr_swap_pages);
 
 	for (type = swap_list.next; type >= 0 && wrapped < 2; type = next) {
 		hp_index = atomic_xchg(&highest_priority_index, -1);
@@ -469,18 +478,28 @@ swp_entry_t get_swap_page(void)
 
 		spin_unlock(&swap_lock);
 		/* This is called for allocating swap entry for cache */
-		offset = scan_swap_map(si, SWAP_HAS_CACHE);
+		while (n_ret < n) {
+			offset = scan_swap_map(si, SWAP_HAS_CACHE);
+			if (!offset)
+				break;
+			swp_entries[n_ret++] = swp_entry(type, offset);
+		}
 		spin_unlock(&si->lock);
-		if (offset)
-			return swp_entry(type, offset);
+		if (n_ret)
+			goto out;
 		spin_lock(&swap_lock);
 		next = swap_list.next;
 	}
 
-	atomic_long_inc(&nr_swap_pages);
+	spin_unlock(&swap_lock);
+out:
+	if (n_ret < n)
+		atomic_long_add(n - n_ret, &nr_swap_pages);
+	return n_ret;
+
 noswap:
 	spin_unlock(&swap_lock);
-	return (swp_entry_t) {0};
+	return 0;
 }
 
 /* The only caller of this function is now susupend routine */
@@ -651,6 +670,18 @@ void swapcache_free(swp_entry_t entry, struct page *page)
 	}
 }
 
+/*
+ * Release swap cache entries that were allocated but never used, e.g. when
+ * a per-cpu slot cache is drained.
+ */
+void swapcache_free_entries(swp_entry_t *entries, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		swapcache_free(entries[i], NULL);
+}
+
 /*
  * How many references to page are currently swapped out?
  * This does not give an exact answer when swap count is continued,
@@ -1626,6 +1657,9 @@ SYSCALL_DEFINE1(swapoff, const char __user *, specialfile)
 	spin_unlock(&p->lock);
 	spin_unlock(&swap_lock);
 
+	/* Give back the slots the per-cpu caches hold on this device */
+	drain_swap_slots_caches();
+
 	set_current_oom_origin();
 	err = try_to_unuse(type, false, 0); /* force all pages to be unused */
 	clear_current_oom_origin();
@@ -2118,11 +2152,19 @@ SYSCALL_DEFINE2(swapon, const char __user *, specialfile, int, swap_flags)
 	if (frontswap_enabled)
 		frontswap_map = vzalloc(BITS_TO_LONGS(maxpages) * sizeof(long));
 
+	p->ra_mode = SWAP_RA_CLUSTER;
 	if (p->bdev) {
 		if (blk_queue_nonrot(bdev_get_queue(p->bdev))) {
 			p->flags |= SWP_SOLIDSTATE;
 			p->cluster_next = 1 + (prandom_u32() % p->highest_bit);
 		}
+		/*
+		 * RAM backed devices such as zram get nothing from reading
+		 * neighbouring offsets, which were swapped out by unrelated
+		 * tasks; follow the faulting address space instead.
+		 */
+		if (p->bdev->bd_disk->fops->swap_slot_free_notify)
+			p->ra_mode = SWAP_RA_VMA;
 		if ((swap_flags & SWAP_FLAG_DISCARD) && discard_swap(p) == 0)
 			p->flags |= SWP_DISCARDABLE;
 	}
@@ -2315,6 +2357,81 @@ struct swap_info_struct *page_swap_info(struct page *page)
 	return swap_info[swp_type(swap)];
 }
 
+struct swap_info_struct *swp_swap_info(swp_entry_t entry)
+{
+	return swap_info[swp_type(entry)];
+}
+
+/*
+ * List the active swap areas with their swapin readahead policy, for
+ * /sys/kernel/mm/swap/readahead.
+ */
+ssize_t swap_ra_mode_show(char *buf, const char * const names[])
+{
+	char *tmp = (char *)__get_free_page(GFP_KERNEL);
+	ssize_t count = 0;
+	int type;
+
+	if (!tmp)
+		return -ENOMEM;
+
+	mutex_lock(&swapon_mutex);
+	for (type = 0; type < nr_swapfiles; type++) {
+		struct swap_info_struct *si;
+		char *path;
+
+		smp_rmb();	/* read nr_swapfiles before swap_info[type] */
+		si = swap_info[type];
+
+		if (!(si->flags & SWP_WRITEOK))
+			continue;
+		path = d_path(&si->swap_file->f_path, tmp, PAGE_SIZE);
+		if (IS_ERR(path))
+			continue;
+		count += scnprintf(buf + count, PAGE_SIZE - count, "%s %s\n",
+				   path, names[si->ra_mode]);
+	}
+	mutex_unlock(&swapon_mutex);
+
+	free_page((unsigned long)tmp);
+	return count;
+}
+
+/*
+ * Change the swapin readahead policy of the active swap area at @path.
+ */
+int swap_ra_mode_set(const char *path, unsigned int mode)
+{
+	struct address_space *mapping;
+	struct file *file;
+	int type, err = -ENOENT;
+
+	file = filp_open(path, O_RDONLY | O_LARGEFILE, 0);
+	if (IS_ERR(file))
+		return PTR_ERR(file);
+	mapping = file->f_mapping;
+
+	mutex_lock(&swapon_mutex);
+	for (type = 0; type < nr_swapfiles; type++) {
+		struct swap_info_struct *si;
+
+		smp_rmb();	/* read nr_swapfiles before swap_info[type] */
+		si = swap_info[type];
+		if ((si->flags & SWP_WRITEOK) &&
+		    si->swap_file->f_mapping == mapping) {
+			atomic_set(&si->ra_hits, 0);
+			atomic_set(&si->ra_win, 0);
+			ACCESS_ONCE(si->ra_mode) = mode;
+			err = 0;
+			break;
+		}
+	}
+	mutex_unlock(&swapon_mutex);
+
+	filp_close(file, NULL);
+	return err;
+}
+
 /*
  * out-of-line __page_file_ methods to avoid include hell.
  */
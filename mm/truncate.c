@@ -182,6 +182,51 @@ int invalidate_inode_page(struct page *page)
 	return invalidate_complete_page(mapping, page);
 }
 
+/*
+ * Reclaim leaves shadow entries where it evicted pages, see
+ * workingset_eviction().  Remove those in [start, end] once the pages
+ * of the range are gone.
+ */
+static void truncate_shadow_entries(struct address_space *mapping,
+				    pgoff_t start, pgoff_t end)
+{
+	unsigned long indices[PAGEVEC_SIZE];
+	struct radix_tree_iter iter;
+	void **slot;
+	int i, nr;
+
+	do {
+		/* Paired with the smp_wmb() in page_cache_tree_delete() */
+		smp_rmb();
+		if (!mapping->nrshadows)
+			return;
+
+		nr = 0;
+		spin_lock_irq(&mapping->tree_lock);
+		radix_tree_for_each_slot(slot, &mapping->page_tree, &iter,
+					 start) {
+			void *entry;
+
+			if (iter.index > end || nr == PAGEVEC_SIZE)
+				break;
+			entry = radix_tree_deref_slot_protected(slot,
+						&mapping->tree_lock);
+			if (radix_tree_exceptional_entry(entry))
+				indices[nr++] = iter.index;
+		}
+		/* Deleting may free nodes, so not while iterating */
+		for (i = 0; i < nr; i++) {
+			radix_tree_delete(&mapping->page_tree, indices[i]);
+			mapping->nrshadows--;
+		}
+		spin_unlock_irq(&mapping->tree_lock);
+
+		if (nr)
+			start = indices[nr - 1] + 1;
+		cond_resched();
+	} while (nr == PAGEVEC_SIZE && start);
+}
+
 /**
  * truncate_inode_pages_range - truncate range of pages specified by start & end byte offsets
  * @mapping: mapping to truncate
@@ -213,7 +258,13 @@ void truncate_inode_pages_range(struct address_space *mapping,
 	int i;
 
 	cleancache_invalidate_inode(mapping);
-	if (mapping->nrpages == 0)
+	/*
+	 * When reclaim installs eviction entries, it increases
+	 * nrshadows first, then decreases nrpages.  Make sure we see
+	 * this in the right order or we might miss an entry.
+	 */
+	smp_rmb();
+	if (mapping->nrpages == 0 && mapping->nrshadows == 0)
 		return;
 
 	BUG_ON((lend & (PAGE_CACHE_SIZE - 1)) != (PAGE_CACHE_SIZE - 1));
@@ -291,6 +342,7 @@ void truncate_inode_pages_range(struct address_space *mapping,
 		mem_cgroup_uncharge_end();
 		index++;
 	}
+	truncate_shadow_entries(mapping, start, end);
 	cleancache_invalidate_inode(mapping);
 }
 EXPORT_SYMBOL(truncate_inode_pages_range);
@@ -398,7 +450,7 @@ invalidate_complete_page2(struct address_space *mapping, struct page *page)
 		goto failed;
 
 	BUG_ON(page_has_private(page));
-	__delete_from_page_cache(page);
+	__delete_from_page_cache(page, NULL);
 	spin_unlock_irq(&mapping->tree_lock);
 	mem_cgroup_uncharge_cache_page(page);
 
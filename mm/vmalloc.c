@@ -21,13 +21,15 @@
 #include <linux/debugobjects.h>
 #include <linux/kallsyms.h>
 #include <linux/list.h>
-#include <linux/rbtree.h>
+#include <linux/rbtree_augmented.h>
 #include <linux/radix-tree.h>
 #include <linux/rcupdate.h>
 #include <linux/pfn.h>
 #include <linux/kmemleak.h>
 #include <linux/atomic.h>
 #include <linux/llist.h>
+#include <linux/ktime.h>
+#include <linux/debugfs.h>
 #include <asm/uaccess.h>
 #include <asm/tlbflush.h>
 #include <asm/shmparam.h>
@@ -274,11 +276,12 @@ LIST_HEAD(vmap_area_list);
 static DEFINE_SPINLOCK(vmap_area_lock);
 static struct rb_root vmap_area_root = RB_ROOT;
 
-/* The vmap cache globals are protected by vmap_area_lock */
-static struct rb_node *free_vmap_cache;
-static unsigned long cached_hole_size;
-static unsigned long cached_vstart;
-static unsigned long cached_align;
+/* alloc_vmap_area() statistics, protected by vmap_area_lock */
+static u64 vmap_alloc_count;
+static u64 vmap_alloc_fail;
+static u64 vmap_alloc_ns_total;
+static u64 vmap_alloc_ns_max;
+static u64 vmap_lazy_purges;
 
 static unsigned long vmap_area_pcpu_hole;
 
@@ -354,6 +357,51 @@ static struct vmap_area *__find_vmap_area(unsigned long addr)
 	return NULL;
 }
 
+/*
+ * Each vmap_area tracks the free gap between the end of the area before it
+ * and its own start, and subtree_gap holds the largest such gap in its
+ * subtree, so that alloc_vmap_area() can skip subtrees without room.
+ */
+static unsigned long va_gap(struct vmap_area *va)
+{
+	struct vmap_area *prev;
+
+	if (va->list.prev == &vmap_area_list)
+		return va->va_start;
+
+	prev = list_entry(va->list.prev, struct vmap_area, list);
+	return va->va_start - prev->va_end;
+}
+
+static unsigned long va_compute_subtree_gap(struct vmap_area *va)
+{
+	unsigned long max, subtree_gap;
+
+	max = va_gap(va);
+	if (va->rb_node.rb_left) {
+		subtree_gap = rb_entry(va->rb_node.rb_left,
+				struct vmap_area, rb_node)->subtree_gap;
+		if (subtree_gap > max)
+			max = subtree_gap;
+	}
+	if (va->rb_node.rb_right) {
+		subtree_gap = rb_entry(va->rb_node.rb_right,
+				struct vmap_area, rb_node)->subtree_gap;
+		if (subtree_gap > max)
+			max = subtree_gap;
+	}
+	return max;
+}
+
+RB_DECLARE_CALLBACKS(static, va_gap_callbacks, struct vmap_area, rb_node,
+		     unsigned long, subtree_gap, va_compute_subtree_gap)
+
+/* The area before @va changed, update the gaps leading to it */
+static void va_gap_update(struct vmap_area *va)
+{
+	va_gap_callbacks_propagate(&va->rb_node, NULL);
+}
+
 static void __insert_vmap_area(struct vmap_area *va)
 {
 	struct rb_node **p = &vmap_area_root.rb_node;
@@ -374,7 +422,6 @@ static void __insert_vmap_area(struct vmap_area *va)
 	}
 
 	rb_link_node(&va->rb_node, parent, p);
-	rb_insert_color(&va->rb_node, &vmap_area_root);
 
 	/* address-sort this list */
 	tmp = rb_prev(&va->rb_node);
@@ -384,6 +431,90 @@ static void __insert_vmap_area(struct vmap_area *va)
 		list_add_rcu(&va->list, &prev->list);
 	} else
 		list_add_rcu(&va->list, &vmap_area_list);
+
+	va->subtree_gap = 0;
+	va_gap_update(va);
+	if (!list_is_last(&va->list, &vmap_area_list))
+		va_gap_update(list_entry(va->list.next, struct vmap_area,
+					 list));
+	rb_insert_augmented(&va->rb_node, &vmap_area_root, &va_gap_callbacks);
+}
+
+/*
+ * Returns the lowest address in [vstart, vend) where @size bytes aligned
+ * to @align fit, or 0 if there is none.  The areas are visited in address
+ * order, skipping subtrees whose largest gap is smaller than @size.
+ */
+static unsigned long __find_vmap_hole(unsigned long size, unsigned long align,
+				      unsigned long vstart, unsigned long vend)
+{
+	struct vmap_area *va, *last;
+	struct rb_node *node;
+	unsigned long gap_start, gap_end, addr;
+
+	if (RB_EMPTY_ROOT(&vmap_area_root)) {
+		gap_start = 0;
+		goto check_highest;
+	}
+
+	va = rb_entry(vmap_area_root.rb_node, struct vmap_area, rb_node);
+	if (va->subtree_gap < size)
+		goto check_last;
+
+	while (true) {
+		/* visit the left subtree if it may hold a gap above vstart */
+		gap_end = va->va_start;
+		if (gap_end > vstart && va->rb_node.rb_left) {
+			struct vmap_area *left = rb_entry(va->rb_node.rb_left,
+						struct vmap_area, rb_node);
+			if (left->subtree_gap >= size) {
+				va = left;
+				continue;
+			}
+		}
+
+		gap_start = gap_end - va_gap(va);
+check_current:
+		addr = ALIGN(max(gap_start, vstart), align);
+		if (addr < gap_start || addr + size < addr ||
+		    addr + size > vend)
+			return 0;
+		if (addr + size <= gap_end)
+			return addr;
+
+		/* visit the right subtree if it looks promising */
+		if (va->rb_node.rb_right) {
+			struct vmap_area *right = rb_entry(va->rb_node.rb_right,
+						struct vmap_area, rb_node);
+			if (right->subtree_gap >= size) {
+				va = right;
+				continue;
+			}
+		}
+
+		/* go back up to the next area in address order */
+		while (true) {
+			node = &va->rb_node;
+			if (!rb_parent(node))
+				goto check_last;
+			va = rb_entry(rb_parent(node), struct vmap_area,
+				      rb_node);
+			if (node == va->rb_node.rb_left) {
+				gap_end = va->va_start;
+				gap_start = gap_end - va_gap(va);
+				goto check_current;
+			}
+		}
+	}
+
+check_last:
+	last = list_entry(vmap_area_list.prev, struct vmap_area, list);
+	gap_start = last->va_end;
+check_highest:
+	addr = ALIGN(max(gap_start, vstart), align);
+	if (addr < gap_start || addr + size < addr || addr + size > vend)
+		return 0;
+	return addr;
 }
 
 static void purge_vmap_area_lazy(void);
@@ -398,10 +529,10 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 				int node, gfp_t gfp_mask)
 {
 	struct vmap_area *va;
-	struct rb_node *n;
 	unsigned long addr;
 	int purged = 0;
-	struct vmap_area *first;
+	ktime_t start = ktime_get();
+	u64 delta;
 
 	BUG_ON(!size);
 	BUG_ON(size & ~PAGE_MASK);
@@ -414,84 +545,20 @@ static struct vmap_area *alloc_vmap_area(unsigned long size,
 
 retry:
 	spin_lock(&vmap_area_lock);
-	/*
-	 * Invalidate cache if we have more permissive parameters.
-	 * cached_hole_size notes the largest hole noticed _below_
-	 * the vmap_area cached in free_vmap_cache: if size fits
-	 * into that hole, we want to scan from vstart to reuse
-	 * the hole instead of allocating above free_vmap_cache.
-	 * Note that __free_vmap_area may update free_vmap_cache
-	 * without updating cached_hole_size or cached_align.
-	 */
-	if (!free_vmap_cache ||
-			size < cached_hole_size ||
-			vstart < cached_vstart ||
-			align < cached_align) {
-nocache:
-		cached_hole_size = 0;
-		free_vmap_cache = NULL;
-	}
-	/* record if we encounter less permissive parameters */
-	cached_vstart = vstart;
-	cached_align = align;
-
-	/* find starting point for our search */
-	if (free_vmap_cache) {
-		first = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-		addr = ALIGN(first->va_end, align);
-		if (addr < vstart)
-			goto nocache;
-		if (addr + size < addr)
-			goto overflow;
-
-	} else {
-		addr = ALIGN(vstart, align);
-		if (addr + size < addr)
-			goto overflow;
-
-		n = vmap_area_root.rb_node;
-		first = NULL;
-
-		while (n) {
-			struct vmap_area *tmp;
-			tmp = rb_entry(n, struct vmap_area, rb_node);
-			if (tmp->va_end >= addr) {
-				first = tmp;
-				if (tmp->va_start <= addr)
-					break;
-				n = n->rb_left;
-			} else
-				n = n->rb_right;
-		}
-
-		if (!first)
-			goto found;
-	}
-
-	/* from the starting point, walk areas until a suitable hole is found */
-	while (addr + size > first->va_start && addr + size <= vend) {
-		if (addr + cached_hole_size < first->va_start)
-			cached_hole_size = first->va_start - addr;
-		addr = ALIGN(first->va_end, align);
-		if (addr + size < addr)
-			goto overflow;
-
-		if (list_is_last(&first->list, &vmap_area_list))
-			goto found;
-
-		first = list_entry(first->list.next,
-				struct vmap_area, list);
-	}
-
-found:
-	if (addr + size > vend)
+	addr = __find_vmap_hole(size, align, vstart, vend);
+	if (!addr)
 		goto overflow;
 
 	va->va_start = addr;
 	va->va_end = addr + size;
 	va->flags = 0;
 	__insert_vmap_area(va);
-	free_vmap_cache = &va->rb_node;
+
+	delta = ktime_to_ns(ktime_sub(ktime_get(), start));
+	vmap_alloc_count++;
+	vmap_alloc_ns_total += delta;
+	if (delta > vmap_alloc_ns_max)
+		vmap_alloc_ns_max = delta;
 	spin_unlock(&vmap_area_lock);
 
 	BUG_ON(va->va_start & (align-1));
@@ -507,6 +574,9 @@ overflow:
 		purged = 1;
 		goto retry;
 	}
+	spin_lock(&vmap_area_lock);
+	vmap_alloc_fail++;
+	spin_unlock(&vmap_area_lock);
 	if (printk_ratelimit())
 		printk(KERN_WARNING
 			"vmap allocation for size %lu failed: "
@@ -517,26 +587,18 @@ overflow:
 
 static void __free_vmap_area(struct vmap_area *va)
 {
+	struct vmap_area *next = NULL;
+
 	BUG_ON(RB_EMPTY_NODE(&va->rb_node));
 
-	if (free_vmap_cache) {
-		if (va->va_end < cached_vstart) {
-			free_vmap_cache = NULL;
-		} else {
-			struct vmap_area *cache;
-			cache = rb_entry(free_vmap_cache, struct vmap_area, rb_node);
-			if (va->va_start <= cache->va_start) {
-				free_vmap_cache = rb_prev(&va->rb_node);
-				/*
-				 * We don't try to update cached_hole_size or
-				 * cached_align, but it won't go very wrong.
-				 */
-			}
-		}
-	}
-	rb_erase(&va->rb_node, &vmap_area_root);
+	if (!list_is_last(&va->list, &vmap_area_list))
+		next = list_entry(va->list.next, struct vmap_area, list);
+
+	rb_erase_augmented(&va->rb_node, &vmap_area_root, &va_gap_callbacks);
 	RB_CLEAR_NODE(&va->rb_node);
 	list_del_rcu(&va->list);
+	if (next)
+		va_gap_update(next);
 
 	/*
 	 * Track the highest possible candidate for pcpu area
@@ -611,7 +673,14 @@ static unsigned long lazy_max_pages(void)
 
 	log = fls(num_online_cpus());
 
-	return log * (32UL * 1024 * 1024 / PAGE_SIZE);
+	/*
+	 * A small vmalloc space, as on 32-bit, would be left fragmented and
+	 * short of room by that much lazily freed address space: limit the
+	 * batch to an eighth of it, which still spreads a flush over many
+	 * frees.
+	 */
+	return min_t(unsigned long, log * (32UL * 1024 * 1024 / PAGE_SIZE),
+		     (VMALLOC_END - VMALLOC_START) / 8 >> PAGE_SHIFT);
 }
 
 static atomic_t vmap_lazy_nr = ATOMIC_INIT(0);
@@ -686,6 +755,7 @@ static void __purge_vmap_area_lazy(unsigned long *start, unsigned long *end,
 		spin_lock(&vmap_area_lock);
 		list_for_each_entry_safe(va, n_va, &valist, purge_list)
 			__free_vmap_area(va);
+		vmap_lazy_purges++;
 		spin_unlock(&vmap_area_lock);
 	}
 	spin_unlock(&purge_lock);
@@ -2797,6 +2867,27 @@ static int __init proc_vmalloc_init(void)
 }
 module_init(proc_vmalloc_init);
 
+#ifdef CONFIG_DEBUG_FS
+static int __init vmap_debugfs_init(void)
+{
+	struct dentry *root;
+
+	root = debugfs_create_dir("vmalloc", NULL);
+	if (!root)
+		return -ENOMEM;
+
+	debugfs_create_u64("alloc_count", S_IRUGO, root, &vmap_alloc_count);
+	debugfs_create_u64("alloc_fail", S_IRUGO, root, &vmap_alloc_fail);
+	debugfs_create_u64("alloc_ns_total", S_IRUGO, root,
+			   &vmap_alloc_ns_total);
+	debugfs_create_u64("alloc_ns_max", S_IRUGO, root,
+			   &vmap_alloc_ns_max);
+	debugfs_create_u64("lazy_purges", S_IRUGO, root, &vmap_lazy_purges);
+	return 0;
+}
+late_initcall(vmap_debugfs_init);
+#endif
+
 void get_vmalloc_info(struct vmalloc_info *vmi)
 {
 	struct vmap_area *va;
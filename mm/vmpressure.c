@@ -21,6 +21,7 @@
 #include <linux/eventfd.h>
 #include <linux/swap.h>
 #include <linux/printk.h>
+#include <linux/notifier.h>
 #include <linux/vmpressure.h>
 
 /*
@@ -48,6 +49,14 @@ static const unsigned long vmpressure_win = SWAP_CLUSTER_MAX * 16;
 static const unsigned int vmpressure_level_med = 60;
 static const unsigned int vmpressure_level_critical = 95;
 
+/*
+ * Once a level has been reported to a cgroup, pressure has to drop this many
+ * percent below the level's threshold before a lower level is reported, so
+ * that a ratio wobbling around a threshold doesn't flip the level on every
+ * window.
+ */
+static const unsigned int vmpressure_hysteresis = 10;
+
 /*
  * When there are too little pages left to scan, vmpressure() may miss the
  * critical pressure as number of pages will be less than "window size".
@@ -69,11 +78,29 @@ static const unsigned int vmpressure_level_critical = 95;
  */
 static const unsigned int vmpressure_level_critical_prio = ilog2(100 / 10);
 
+static void vmpressure_global_work_fn(struct work_struct *work);
+
+/*
+ * Pressure from global reclaim is accounted separately and reported to
+ * in-kernel listeners (e.g. the Android low memory killer) through a
+ * notifier chain, independently of memory cgroups.
+ */
+static struct vmpressure global_vmpressure = {
+	.sr_lock = __MUTEX_INITIALIZER(global_vmpressure.sr_lock),
+	.events = LIST_HEAD_INIT(global_vmpressure.events),
+	.events_lock = __MUTEX_INITIALIZER(global_vmpressure.events_lock),
+	.work = __WORK_INITIALIZER(global_vmpressure.work,
+				   vmpressure_global_work_fn),
+};
+
+static BLOCKING_NOTIFIER_HEAD(vmpressure_notifier);
+
 static struct vmpressure *work_to_vmpressure(struct work_struct *work)
 {
 	return container_of(work, struct vmpressure, work);
 }
 
+#ifdef CONFIG_MEMCG
 static struct vmpressure *cg_to_vmpressure(struct cgroup *cg)
 {
 	return css_to_vmpressure(cgroup_subsys_state(cg, mem_cgroup_subsys_id));
@@ -90,18 +117,12 @@ static struct vmpressure *vmpressure_parent(struct vmpressure *vmpr)
 	return memcg_to_vmpressure(memcg);
 }
 
-enum vmpressure_levels {
-	VMPRESSURE_LOW = 0,
-	VMPRESSURE_MEDIUM,
-	VMPRESSURE_CRITICAL,
-	VMPRESSURE_NUM_LEVELS,
-};
-
 static const char * const vmpressure_str_levels[] = {
 	[VMPRESSURE_LOW] = "low",
 	[VMPRESSURE_MEDIUM] = "medium",
 	[VMPRESSURE_CRITICAL] = "critical",
 };
+#endif
 
 static enum vmpressure_levels vmpressure_level(unsigned long pressure)
 {
@@ -112,8 +133,8 @@ static enum vmpressure_levels vmpressure_level(unsigned long pressure)
 	return VMPRESSURE_LOW;
 }
 
-static enum vmpressure_levels vmpressure_calc_level(unsigned long scanned,
-						    unsigned long reclaimed)
+static unsigned long vmpressure_calc_pressure(unsigned long scanned,
+					      unsigned long reclaimed)
 {
 	unsigned long scale = scanned + reclaimed;
 	unsigned long pressure;
@@ -131,8 +152,76 @@ static enum vmpressure_levels vmpressure_calc_level(unsigned long scanned,
 	pr_debug("%s: %3lu  (s: %lu  r: %lu)\n", __func__, pressure,
 		 scanned, reclaimed);
 
-	return vmpressure_level(pressure);
+	return pressure;
+}
+
+/*
+ * Takes the scanned/reclaimed counts accumulated in @vmpr, resetting them.
+ * @tree selects the subtree counts or the ones of the group's own LRUs.
+ * Returns false if there is nothing to report.
+ */
+static bool vmpressure_fetch(struct vmpressure *vmpr, bool tree,
+			     unsigned long *scanned, unsigned long *reclaimed)
+{
+	unsigned long *s = tree ? &vmpr->scanned : &vmpr->local_scanned;
+	unsigned long *r = tree ? &vmpr->reclaimed : &vmpr->local_reclaimed;
+
+	/*
+	 * Several contexts might be calling vmpressure(), so it is
+	 * possible that the work was rescheduled again before the old
+	 * work context cleared the counters. In that case we will run
+	 * just after the old work returns, but then scanned might be zero
+	 * here. No need for any locks here since we don't care if
+	 * vmpr->reclaimed is in sync.
+	 */
+	if (!*s)
+		return false;
+
+	mutex_lock(&vmpr->sr_lock);
+	*scanned = *s;
+	*reclaimed = *r;
+	*s = 0;
+	*r = 0;
+	mutex_unlock(&vmpr->sr_lock);
+
+	return true;
+}
+
+static void vmpressure_global_work_fn(struct work_struct *work)
+{
+	struct vmpressure *vmpr = work_to_vmpressure(work);
+	unsigned long scanned;
+	unsigned long reclaimed;
+	unsigned long pressure;
+
+	if (!vmpressure_fetch(vmpr, true, &scanned, &reclaimed))
+		return;
+
+	pressure = vmpressure_calc_pressure(scanned, reclaimed);
+	blocking_notifier_call_chain(&vmpressure_notifier,
+				     vmpressure_level(pressure), &pressure);
+}
+
+/**
+ * vmpressure_notifier_register() - Receive global reclaim pressure
+ * @nb:		notifier block to add to the chain
+ *
+ * The notifier is called from a workqueue once per accounting window of
+ * global reclaim, see the comment in include/linux/vmpressure.h.
+ */
+int vmpressure_notifier_register(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_register(&vmpressure_notifier, nb);
+}
+EXPORT_SYMBOL_GPL(vmpressure_notifier_register);
+
+int vmpressure_notifier_unregister(struct notifier_block *nb)
+{
+	return blocking_notifier_chain_unregister(&vmpressure_notifier, nb);
 }
+EXPORT_SYMBOL_GPL(vmpressure_notifier_unregister);
+
+#ifdef CONFIG_MEMCG
 
 struct vmpressure_event {
 	struct eventfd_ctx *efd;
@@ -140,17 +229,38 @@ struct vmpressure_event {
 	struct list_head node;
 };
 
+/*
+ * Levels go up as soon as the pressure crosses a threshold, but only come
+ * down once it is vmpressure_hysteresis below it. Called with events_lock.
+ */
+static enum vmpressure_levels vmpressure_level_hyst(struct vmpressure *vmpr,
+						    unsigned long pressure)
+{
+	enum vmpressure_levels level = vmpressure_level(pressure);
+	enum vmpressure_levels sticky;
+
+	sticky = vmpressure_level(pressure + vmpressure_hysteresis);
+	if (level < vmpr->level)
+		level = min_t(enum vmpressure_levels, vmpr->level, sticky);
+
+	vmpr->level = level;
+	return level;
+}
+
 static bool vmpressure_event(struct vmpressure *vmpr,
 			     unsigned long scanned, unsigned long reclaimed)
 {
 	struct vmpressure_event *ev;
 	enum vmpressure_levels level;
+	unsigned long pressure;
 	bool signalled = false;
 
-	level = vmpressure_calc_level(scanned, reclaimed);
+	pressure = vmpressure_calc_pressure(scanned, reclaimed);
 
 	mutex_lock(&vmpr->events_lock);
 
+	level = vmpressure_level_hyst(vmpr, pressure);
+
 	list_for_each_entry(ev, &vmpr->events, node) {
 		if (level >= ev->level) {
 			eventfd_signal(ev->efd, 1);
@@ -170,22 +280,14 @@ static void vmpressure_work_fn(struct work_struct *work)
 	unsigned long reclaimed;
 
 	/*
-	 * Several contexts might be calling vmpressure(), so it is
-	 * possible that the work was rescheduled again before the old
-	 * work context cleared the counters. In that case we will run
-	 * just after the old work returns, but then scanned might be zero
-	 * here. No need for any locks here since we don't care if
-	 * vmpr->reclaimed is in sync.
+	 * Pressure on the group's own pages is only of interest to the
+	 * group's listeners, it is not propagated to the parents.
 	 */
-	if (!vmpr->scanned)
-		return;
+	if (vmpressure_fetch(vmpr, false, &scanned, &reclaimed))
+		vmpressure_event(vmpr, scanned, reclaimed);
 
-	mutex_lock(&vmpr->sr_lock);
-	scanned = vmpr->scanned;
-	reclaimed = vmpr->reclaimed;
-	vmpr->scanned = 0;
-	vmpr->reclaimed = 0;
-	mutex_unlock(&vmpr->sr_lock);
+	if (!vmpressure_fetch(vmpr, true, &scanned, &reclaimed))
+		return;
 
 	do {
 		if (vmpressure_event(vmpr, scanned, reclaimed))
@@ -196,11 +298,33 @@ static void vmpressure_work_fn(struct work_struct *work)
 		 */
 	} while ((vmpr = vmpressure_parent(vmpr)));
 }
+#endif /* CONFIG_MEMCG */
+
+static void vmpressure_account(struct vmpressure *vmpr, bool tree,
+			       unsigned long scanned, unsigned long reclaimed)
+{
+	mutex_lock(&vmpr->sr_lock);
+	if (tree) {
+		vmpr->scanned += scanned;
+		vmpr->reclaimed += reclaimed;
+		scanned = vmpr->scanned;
+	} else {
+		vmpr->local_scanned += scanned;
+		vmpr->local_reclaimed += reclaimed;
+		scanned = vmpr->local_scanned;
+	}
+	mutex_unlock(&vmpr->sr_lock);
+
+	if (scanned < vmpressure_win || work_pending(&vmpr->work))
+		return;
+	schedule_work(&vmpr->work);
+}
 
 /**
  * vmpressure() - Account memory pressure through scanned/reclaimed ratio
  * @gfp:	reclaimer's gfp mask
  * @memcg:	cgroup memory controller handle
+ * @tree:	account the whole subtree of @memcg or only its own LRUs
  * @scanned:	number of pages scanned
  * @reclaimed:	number of pages reclaimed
  *
@@ -208,13 +332,18 @@ static void vmpressure_work_fn(struct work_struct *work)
  * "instantaneous" memory pressure (scanned/reclaimed ratio). The raw
  * pressure index is then further refined and averaged over time.
  *
+ * If @tree is set, @memcg is the target of the reclaim (NULL for global
+ * reclaim) and the pressure is reported to its listeners, walking up the
+ * hierarchy until someone handles it. Otherwise @memcg is a group whose own
+ * LRUs have just been scanned, e.g. a background app group during global
+ * reclaim, and only its listeners are told. This is what lets userspace
+ * see which groups are actually being squeezed.
+ *
  * This function does not return any value.
  */
-void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
+void vmpressure(gfp_t gfp, struct mem_cgroup *memcg, bool tree,
 		unsigned long scanned, unsigned long reclaimed)
 {
-	struct vmpressure *vmpr = memcg_to_vmpressure(memcg);
-
 	/*
 	 * Here we only want to account pressure that userland is able to
 	 * help us with. For example, suppose that DMA zone is under
@@ -240,15 +369,24 @@ void vmpressure(gfp_t gfp, struct mem_cgroup *memcg,
 	if (!scanned)
 		return;
 
-	mutex_lock(&vmpr->sr_lock);
-	vmpr->scanned += scanned;
-	vmpr->reclaimed += reclaimed;
-	scanned = vmpr->scanned;
-	mutex_unlock(&vmpr->sr_lock);
+	if (!tree) {
+#ifdef CONFIG_MEMCG
+		struct vmpressure *vmpr = memcg_to_vmpressure(memcg);
 
-	if (scanned < vmpressure_win || work_pending(&vmpr->work))
+		/* The root group already sees all of global reclaim */
+		if (memcg && vmpr != memcg_to_vmpressure(NULL))
+			vmpressure_account(vmpr, false, scanned, reclaimed);
+#endif
 		return;
-	schedule_work(&vmpr->work);
+	}
+
+	if (!memcg)
+		vmpressure_account(&global_vmpressure, true, scanned,
+				   reclaimed);
+#ifdef CONFIG_MEMCG
+	vmpressure_account(memcg_to_vmpressure(memcg), true, scanned,
+			   reclaimed);
+#endif
 }
 
 /**
@@ -278,9 +416,10 @@ void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio)
 	 * to the vmpressure() basically means that we signal 'critical'
 	 * level.
 	 */
-	vmpressure(gfp, memcg, vmpressure_win, 0);
+	vmpressure(gfp, memcg, true, vmpressure_win, 0);
 }
 
+#ifdef CONFIG_MEMCG
 /**
  * vmpressure_register_event() - Bind vmpressure notifications to an eventfd
  * @cg:		cgroup that is interested in vmpressure notifications
@@ -294,6 +433,10 @@ void vmpressure_prio(gfp_t gfp, struct mem_cgroup *memcg, int prio)
  * threshold (one of vmpressure_str_levels, i.e. "low", "medium", or
  * "critical").
  *
+ * The eventfd is signalled once per window in which @cg was at or above the
+ * level, either because its limit was hit or because global reclaim was
+ * scanning its pages.
+ *
  * This function should not be used directly, just pass it to (struct
  * cftype).register_event, and then cgroup core will handle everything by
  * itself.
@@ -370,5 +513,7 @@ void vmpressure_init(struct vmpressure *vmpr)
 	mutex_init(&vmpr->sr_lock);
 	mutex_init(&vmpr->events_lock);
 	INIT_LIST_HEAD(&vmpr->events);
+	vmpr->level = VMPRESSURE_LOW;
 	INIT_WORK(&vmpr->work, vmpressure_work_fn);
 }
+#endif /* CONFIG_MEMCG */
@@ -2378,6 +2378,34 @@ int hci_recv_frame(struct sk_buff *skb)
 }
 EXPORT_SYMBOL(hci_recv_frame);
 
+/* Receive a batch of complete frames, queued with one rx_work kick */
+int hci_recv_frames(struct hci_dev *hdev, struct sk_buff_head *list)
+{
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	if (!hdev || (!test_bit(HCI_UP, &hdev->flags)
+		      && !test_bit(HCI_INIT, &hdev->flags))) {
+		__skb_queue_purge(list);
+		return -ENXIO;
+	}
+
+	skb_queue_walk(list, skb) {
+		skb->dev = (void *) hdev;
+		bt_cb(skb)->incoming = 1;
+		__net_timestamp(skb);
+	}
+
+	spin_lock_irqsave(&hdev->rx_q.lock, flags);
+	skb_queue_splice_tail_init(list, &hdev->rx_q);
+	spin_unlock_irqrestore(&hdev->rx_q.lock, flags);
+
+	queue_work(hdev->workqueue, &hdev->rx_work);
+
+	return 0;
+}
+EXPORT_SYMBOL(hci_recv_frames);
+
 static int hci_reassembly(struct hci_dev *hdev, int type, void *data,
 			  int count, __u8 index)
 {
@@ -2813,7 +2841,11 @@ static void hci_queue_acl(struct hci_chan *chan, struct sk_buff_head *queue,
 	}
 }
 
-void hci_send_acl(struct hci_chan *chan, struct sk_buff *skb, __u16 flags)
+/* Queue ACL data without kicking the TX work. Callers sending a run of
+ * PDUs use this and then call hci_sched_tx() once, so the scheduler sees
+ * the whole batch rather than being woken per fragment.
+ */
+void __hci_send_acl(struct hci_chan *chan, struct sk_buff *skb, __u16 flags)
 {
 	struct hci_dev *hdev = chan->conn->hdev;
 
@@ -2822,8 +2854,13 @@ void hci_send_acl(struct hci_chan *chan, struct sk_buff *skb, __u16 flags)
 	skb->dev = (void *) hdev;
 
 	hci_queue_acl(chan, &chan->data_q, skb, flags);
+}
+EXPORT_SYMBOL(__hci_send_acl);
 
-	queue_work(hdev->workqueue, &hdev->tx_work);
+void hci_send_acl(struct hci_chan *chan, struct sk_buff *skb, __u16 flags)
+{
+	__hci_send_acl(chan, skb, flags);
+	hci_sched_tx(chan->conn->hdev);
 }
 
 /* Send SCO data */
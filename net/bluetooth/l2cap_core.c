@@ -765,7 +765,12 @@ static bool __chan_is_moving(struct l2cap_chan *chan)
 	       chan->move_state != L2CAP_MOVE_WAIT_PREPARE;
 }
 
-static void l2cap_do_send(struct l2cap_chan *chan, struct sk_buff *skb)
+/* Queue a PDU on the channel's ACL link without kicking the HCI TX
+ * work. Returns the controller the PDU was queued on, or NULL if it was
+ * dropped, so that callers sending a burst can schedule TX once.
+ */
+static struct hci_dev *__l2cap_do_send(struct l2cap_chan *chan,
+				       struct sk_buff *skb)
 {
 	struct hci_conn *hcon = chan->conn->hcon;
 	u16 flags;
@@ -774,12 +779,13 @@ static void l2cap_do_send(struct l2cap_chan *chan, struct sk_buff *skb)
 	       skb->priority);
 
 	if (chan->hs_hcon && !__chan_is_moving(chan)) {
-		if (chan->hs_hchan)
-			hci_send_acl(chan->hs_hchan, skb, ACL_COMPLETE);
-		else
-			kfree_skb(skb);
+		if (chan->hs_hchan) {
+			__hci_send_acl(chan->hs_hchan, skb, ACL_COMPLETE);
+			return chan->hs_hcon->hdev;
+		}
 
-		return;
+		kfree_skb(skb);
+		return NULL;
 	}
 
 	if (!test_bit(FLAG_FLUSHABLE, &chan->flags) &&
@@ -789,7 +795,16 @@ static void l2cap_do_send(struct l2cap_chan *chan, struct sk_buff *skb)
 		flags = ACL_START;
 
 	bt_cb(skb)->force_active = test_bit(FLAG_FORCE_ACTIVE, &chan->flags);
-	hci_send_acl(chan->conn->hchan, skb, flags);
+	__hci_send_acl(chan->conn->hchan, skb, flags);
+	return hcon->hdev;
+}
+
+static void l2cap_do_send(struct l2cap_chan *chan, struct sk_buff *skb)
+{
+	struct hci_dev *hdev = __l2cap_do_send(chan, skb);
+
+	if (hdev)
+		hci_sched_tx(hdev);
 }
 
 static void __unpack_enhanced_control(u16 enh, struct l2cap_ctrl *control)
@@ -1932,6 +1947,7 @@ static void l2cap_streaming_send(struct l2cap_chan *chan,
 {
 	struct sk_buff *skb;
 	struct l2cap_ctrl *control;
+	struct hci_dev *hdev = NULL;
 
 	BT_DBG("chan %p, skbs %p", chan, skbs);
 
@@ -1957,19 +1973,24 @@ static void l2cap_streaming_send(struct l2cap_chan *chan,
 			put_unaligned_le16(fcs, skb_put(skb, L2CAP_FCS_SIZE));
 		}
 
-		l2cap_do_send(chan, skb);
+		hdev = __l2cap_do_send(chan, skb) ? : hdev;
 
 		BT_DBG("Sent txseq %u", control->txseq);
 
 		chan->next_tx_seq = __next_seq(chan, chan->next_tx_seq);
 		chan->frames_sent++;
 	}
+
+	/* Let the HCI scheduler see the whole SDU at once */
+	if (hdev)
+		hci_sched_tx(hdev);
 }
 
 static int l2cap_ertm_send(struct l2cap_chan *chan)
 {
 	struct sk_buff *skb, *tx_skb;
 	struct l2cap_ctrl *control;
+	struct hci_dev *hdev = NULL;
 	int sent = 0;
 
 	BT_DBG("chan %p", chan);
@@ -2026,10 +2047,14 @@ static int l2cap_ertm_send(struct l2cap_chan *chan)
 		else
 			chan->tx_send_head = skb_queue_next(&chan->tx_q, skb);
 
-		l2cap_do_send(chan, tx_skb);
+		hdev = __l2cap_do_send(chan, tx_skb) ? : hdev;
 		BT_DBG("Sent txseq %u", control->txseq);
 	}
 
+	/* Flush everything the TX window allowed in one scheduler pass */
+	if (hdev)
+		hci_sched_tx(hdev);
+
 	BT_DBG("Sent %d, %u unacked, %u in ERTM queue", sent,
 	       chan->unacked_frames, skb_queue_len(&chan->tx_q));
 
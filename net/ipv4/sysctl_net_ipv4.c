@@ -829,6 +829,15 @@ static struct ctl_table ipv4_table[] = {
 		.extra1		= &tcp_use_userconfig_min,
 		.extra2		= &tcp_use_userconfig_max,
 	},
+	{
+		.procname	= "tcp_lowpower_timers",
+		.data		= &sysctl_tcp_lowpower_timers,
+		.maxlen		= sizeof(sysctl_tcp_lowpower_timers),
+		.mode		= 0644,
+		.proc_handler	= proc_dointvec_minmax,
+		.extra1		= &zero,
+		.extra2		= &one,
+	},
 
 	{ }
 };
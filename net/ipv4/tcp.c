@@ -306,6 +306,9 @@ EXPORT_SYMBOL(sysctl_tcp_delack_seg);
 int sysctl_tcp_use_userconfig __read_mostly;
 EXPORT_SYMBOL(sysctl_tcp_use_userconfig);
 
+int sysctl_tcp_lowpower_timers __read_mostly;
+EXPORT_SYMBOL(sysctl_tcp_lowpower_timers);
+
 
 /*
  * Current number of TCP sockets.
@@ -3046,8 +3046,12 @@ void tcp_send_delayed_ack(struct sock *sk)
 		/* If some rtt estimate is known, use it to bound delayed ack.
 		 * Do not use inet_csk(sk)->icsk_rto here, use results of rtt measurements
 		 * directly.
+		 *
+		 * In low power mode bulk receivers may wait up to the
+		 * RFC 1122 limit of half a second instead.
 		 */
-		if (tp->srtt) {
+		if (tp->srtt && (max_ato == TCP_DELACK_MAX ||
+				 !sysctl_tcp_lowpower_timers)) {
 			int rtt = max(tp->srtt >> 3, TCP_DELACK_MIN);
 
 			if (rtt < max_ato)
@@ -3060,6 +3064,13 @@ void tcp_send_delayed_ack(struct sock *sk)
 	/* Stay within the limit we were given */
 	timeout = jiffies + ato;
 
+	/* Expire on a grid shared by all sockets, but never past HZ/2 */
+	if (sysctl_tcp_lowpower_timers) {
+		timeout = roundup(timeout, TCP_DELACK_MIN);
+		if (time_after(timeout, jiffies + HZ / 2))
+			timeout = jiffies + HZ / 2;
+	}
+
 	/* Use new timeout only if there wasn't a older one earlier. */
 	if (icsk->icsk_ack.pending & ICSK_ACK_TIMER) {
 		/* If delack timer was blocked or is about to expire,
@@ -68,6 +68,17 @@ int tcp_use_userconfig_sysctl_handler(ctl_table *table, int write,
 	return ret;
 }
 
+/*
+ * In low power mode keepalive probes go out on whole second boundaries,
+ * together with the probes of other connections.
+ */
+static void tcp_reset_keepalive_timer(struct sock *sk, unsigned long len)
+{
+	if (sysctl_tcp_lowpower_timers)
+		len = round_jiffies_up_relative(len);
+	inet_csk_reset_keepalive_timer(sk, len);
+}
+
 static void tcp_write_err(struct sock *sk)
 {
 	sk->sk_err = sk->sk_err_soft ? : ETIMEDOUT;
@@ -585,7 +596,7 @@ void tcp_set_keepalive(struct sock *sk, int val)
 		return;
 
 	if (val && !sock_flag(sk, SOCK_KEEPOPEN))
-		inet_csk_reset_keepalive_timer(sk, keepalive_time_when(tcp_sk(sk)));
+		tcp_reset_keepalive_timer(sk, keepalive_time_when(tcp_sk(sk)));
 	else if (!val)
 		inet_csk_delete_keepalive_timer(sk);
 }
@@ -665,7 +676,7 @@ static void tcp_keepalive_timer (unsigned long data)
 	sk_mem_reclaim(sk);
 
 resched:
-	inet_csk_reset_keepalive_timer (sk, elapsed);
+	tcp_reset_keepalive_timer(sk, elapsed);
 	goto out;
 
 death:
@@ -680,5 +691,14 @@ void tcp_init_xmit_timers(struct sock *sk)
 {
 	inet_csk_init_xmit_timers(sk, &tcp_write_timer, &tcp_delack_timer,
 				  &tcp_keepalive_timer);
+
+	/*
+	 * The keepalive, FIN_WAIT2 and SYN-ACK timers can wait for the
+	 * next wakeup of an idle CPU. The retransmit and delayed ACK
+	 * timers stay exact.
+	 */
+	if (sysctl_tcp_lowpower_timers)
+		__setup_timer(&sk->sk_timer, tcp_keepalive_timer,
+			      (unsigned long)sk, TIMER_DEFERRABLE);
 }
 EXPORT_SYMBOL(tcp_init_xmit_timers);
@@ -11,8 +11,11 @@
 #define __XT_QTAGUID_INTERNAL_H__
 
 #include <linux/types.h>
+#include <linux/cpumask.h>
 #include <linux/rbtree.h>
 #include <linux/spinlock_types.h>
+#include <linux/string.h>
+#include <linux/u64_stats_sync.h>
 #include <linux/workqueue.h>
 
 /* Iface handling */
@@ -197,6 +200,15 @@ static inline uint64_t dc_sum_packets(struct data_counters *counters,
 		+ counters->bpc[set][direction][IFS_PROTO_OTHER].packets;
 }
 
+/*
+ * Per-cpu slice of a data_counters, updated with BHs disabled on the
+ * owning cpu and summed by the readers.
+ */
+struct data_counters_pcpu {
+	struct data_counters dc;
+	struct u64_stats_sync syncp;
+} ____cacheline_aligned_in_smp;
+
 
 /* Generic X based nodes used as a base for rb_tree ops */
 struct tag_node {
@@ -222,7 +234,8 @@ struct iface_stat {
 	struct net_device *net_dev;
 
 	struct byte_packet_counters totals_via_dev[IFS_MAX_DIRECTIONS];
-	struct data_counters totals_via_skb;
+	/* One slice per possible cpu, use iface_stat_skb_totals() to read */
+	struct data_counters_pcpu *totals_via_skb;
 	/*
 	 * We keep the last_known, because some devices reset their counters
 	 * just before NETDEV_UP, while some will reset just before
@@ -241,6 +254,31 @@ struct iface_stat {
 	spinlock_t tag_stat_list_lock;
 };
 
+static inline void iface_stat_skb_totals(struct iface_stat *is,
+					 struct data_counters *res)
+{
+	struct byte_packet_counters *dst = &res->bpc[0][0][0];
+	struct data_counters tmp;
+	unsigned int start;
+	int cpu, i;
+
+	memset(res, 0, sizeof(*res));
+	for_each_possible_cpu(cpu) {
+		struct data_counters_pcpu *pc = &is->totals_via_skb[cpu];
+		struct byte_packet_counters *src = &tmp.bpc[0][0][0];
+
+		do {
+			start = u64_stats_fetch_begin_bh(&pc->syncp);
+			tmp = pc->dc;
+		} while (u64_stats_fetch_retry_bh(&pc->syncp, start));
+
+		for (i = 0; i < sizeof(tmp.bpc) / sizeof(*src); i++) {
+			dst[i].bytes += src[i].bytes;
+			dst[i].packets += src[i].packets;
+		}
+	}
+}
+
 /* This is needed to create proc_dir_entries from atomic context. */
 struct iface_stat_work {
 	struct work_struct iface_work;
@@ -255,6 +293,9 @@ struct iface_stat_work {
  */
 struct sock_tag {
 	struct rb_node sock_node;
+	/* In sock_tag_hash, for lockless lookups from the packet path */
+	struct hlist_node sock_hnode;
+	struct rcu_head rcu;
 	struct sock *sk;  /* Only used as a number, never dereferenced */
 	/* The socket is needed for sockfd_put() */
 	struct socket *socket;
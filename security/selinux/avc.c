@@ -23,6 +23,7 @@
 #include <linux/skbuff.h>
 #include <linux/percpu.h>
 #include <linux/list.h>
+#include <linux/log2.h>
 #include <net/sock.h>
 #include <linux/un.h>
 #include <net/af_unix.h>
@@ -34,8 +35,9 @@
 #include "avc_ss.h"
 #include "classmap.h"
 
-#define AVC_CACHE_SLOTS			512
-#define AVC_DEF_CACHE_THRESHOLD		512
+#define AVC_DEF_CACHE_SLOTS		2048
+#define AVC_MAX_CACHE_SLOTS		16384
+#define AVC_DEF_CACHE_THRESHOLD		2048
 #define AVC_CACHE_RECLAIM		16
 
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
@@ -55,12 +57,13 @@ struct avc_entry {
 struct avc_node {
 	struct avc_entry	ae;
 	struct hlist_node	list; /* anchored in avc_cache->slots[i] */
+	int			referenced; /* hit since the last reclaim scan */
 	struct rcu_head		rhead;
 };
 
 struct avc_cache {
-	struct hlist_head	slots[AVC_CACHE_SLOTS]; /* head for avc_node->list */
-	spinlock_t		slots_lock[AVC_CACHE_SLOTS]; /* lock for writes */
+	struct hlist_head	*slots; /* head for avc_node->list */
+	spinlock_t		*slots_lock; /* lock for writes */
 	atomic_t		lru_hint;	/* LRU hint for reclaim scan */
 	atomic_t		active_nodes;
 	u32			latest_notif;	/* latest revocation notification */
@@ -85,6 +88,20 @@ struct avc_callback_node {
 /* Exported via selinufs */
 unsigned int avc_cache_threshold = AVC_DEF_CACHE_THRESHOLD;
 
+/* Number of hash slots, a power of two set with avc_cache_slots= */
+static unsigned int avc_cache_slots __read_mostly = AVC_DEF_CACHE_SLOTS;
+
+static int __init avc_cache_slots_setup(char *str)
+{
+	unsigned long slots;
+
+	if (!kstrtoul(str, 0, &slots) && slots)
+		avc_cache_slots = rounddown_pow_of_two(min_t(unsigned long,
+						slots, AVC_MAX_CACHE_SLOTS));
+	return 1;
+}
+__setup("avc_cache_slots=", avc_cache_slots_setup);
+
 #ifdef CONFIG_SECURITY_SELINUX_AVC_STATS
 DEFINE_PER_CPU(struct avc_cache_stats, avc_cache_stats) = { 0 };
 #endif
@@ -98,7 +115,7 @@ static struct kmem_cache *avc_operation_perm_cachep;
 
 static inline int avc_hash(u32 ssid, u32 tsid, u16 tclass)
 {
-	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (AVC_CACHE_SLOTS - 1);
+	return (ssid ^ (tsid<<2) ^ (tclass<<4)) & (avc_cache_slots - 1);
 }
 
 /**
@@ -177,7 +194,16 @@ void __init avc_init(void)
 {
 	int i;
 
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	avc_cache.slots = kcalloc(avc_cache_slots, sizeof(*avc_cache.slots),
+				  GFP_KERNEL);
+	avc_cache.slots_lock = kcalloc(avc_cache_slots,
+				       sizeof(*avc_cache.slots_lock),
+				       GFP_KERNEL);
+	if (!avc_cache.slots || !avc_cache.slots_lock)
+		panic("SELinux: cannot allocate %u AVC slots\n",
+		      avc_cache_slots);
+
+	for (i = 0; i < avc_cache_slots; i++) {
 		INIT_HLIST_HEAD(&avc_cache.slots[i]);
 		spin_lock_init(&avc_cache.slots_lock[i]);
 	}
@@ -210,7 +236,7 @@ int avc_get_hash_stats(char *page)
 
 	slots_used = 0;
 	max_chain_len = 0;
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	for (i = 0; i < avc_cache_slots; i++) {
 		head = &avc_cache.slots[i];
 		if (!hlist_empty(head)) {
 			slots_used++;
@@ -227,7 +253,7 @@ int avc_get_hash_stats(char *page)
 	return scnprintf(page, PAGE_SIZE, "entries: %d\nbuckets used: %d/%d\n"
 			 "longest chain: %d\n",
 			 atomic_read(&avc_cache.active_nodes),
-			 slots_used, AVC_CACHE_SLOTS, max_chain_len);
+			 slots_used, avc_cache_slots, max_chain_len);
 }
 
 /*
@@ -521,6 +547,11 @@ static void avc_node_replace(struct avc_node *new, struct avc_node *old)
 	atomic_dec(&avc_cache.active_nodes);
 }
 
+/*
+ * Entries hit since the scan last passed their slot get a second chance:
+ * the scan only clears their referenced flag, so the hot entries of a
+ * busy workload are not evicted along with the one-off ones.
+ */
 static inline int avc_reclaim_node(void)
 {
 	struct avc_node *node;
@@ -529,8 +560,9 @@ static inline int avc_reclaim_node(void)
 	struct hlist_head *head;
 	spinlock_t *lock;
 
-	for (try = 0, ecx = 0; try < AVC_CACHE_SLOTS; try++) {
-		hvalue = atomic_inc_return(&avc_cache.lru_hint) & (AVC_CACHE_SLOTS - 1);
+	for (try = 0, ecx = 0; try < avc_cache_slots; try++) {
+		hvalue = atomic_inc_return(&avc_cache.lru_hint) &
+			 (avc_cache_slots - 1);
 		head = &avc_cache.slots[hvalue];
 		lock = &avc_cache.slots_lock[hvalue];
 
@@ -539,6 +571,10 @@ static inline int avc_reclaim_node(void)
 
 		rcu_read_lock();
 		hlist_for_each_entry(node, head, list) {
+			if (node->referenced) {
+				node->referenced = 0;
+				continue;
+			}
 			avc_node_delete(node);
 			avc_cache_stats_incr(reclaims);
 			ecx++;
@@ -620,8 +656,12 @@ static struct avc_node *avc_lookup(u32 ssid, u32 tsid, u16 tclass)
 	avc_cache_stats_incr(lookups);
 	node = avc_search_node(ssid, tsid, tclass);
 
-	if (node)
+	if (node) {
+		/* avoid dirtying the cache line of an entry on every hit */
+		if (!ACCESS_ONCE(node->referenced))
+			ACCESS_ONCE(node->referenced) = 1;
 		return node;
+	}
 
 	avc_cache_stats_incr(misses);
 	return NULL;
@@ -930,7 +970,7 @@ static void avc_flush(void)
 	unsigned long flag;
 	int i;
 
-	for (i = 0; i < AVC_CACHE_SLOTS; i++) {
+	for (i = 0; i < avc_cache_slots; i++) {
 		head = &avc_cache.slots[i];
 		lock = &avc_cache.slots_lock[i];
 
@@ -121,13 +121,15 @@ static int dory_mi2s_startup(struct snd_pcm_substream *substream)
 	struct snd_soc_dai *cpu_dai = rtd->cpu_dai;
 	struct dory_data *machine = snd_soc_card_get_drvdata(rtd->card);
 
-	if (atomic_inc_return(&machine->mi2s_rsc_ref) == 1) {
-
+	/* Only the capture backend needs the mic powered */
+	if (substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
 		if (gpio_is_valid(mic_en_gpio.gpio))
 			gpio_set_value(mic_en_gpio.gpio, 1);
 
 		dory_regulator_enable(machine, true);
+	}
 
+	if (atomic_inc_return(&machine->mi2s_rsc_ref) == 1) {
 		ret = snd_soc_dai_set_fmt(cpu_dai, SND_SOC_DAIFMT_CBS_CFS);
 		if (ret < 0)
 			dev_err(cpu_dai->dev, "set format for CPU dai failed\n");
@@ -145,7 +147,8 @@ static int dory_mi2s_hw_params_fixup(struct snd_soc_pcm_runtime *rtd,
 	/*
 	 * This causes the mic to always run at 48KHz which results
 	 * in a smaller warm-up delay. Remove this function to allow
-	 * 8, 16 and 48KHz.
+	 * 8, 16 and 48KHz. Playback is pinned to 48KHz as well so the
+	 * low latency path never goes through the DSP resampler.
 	 */
 	rate->min = 48000;
 	rate->max = 48000;
@@ -194,7 +197,9 @@ static void dory_mi2s_shutdown(struct snd_pcm_substream *substream)
 	if (atomic_dec_return(&machine->mi2s_rsc_ref) == 0) {
 		if (afe_set_lpass_clock(MI2S_RX, &lpass_mi2s_disable) < 0)
 			pr_err("Unable to disable LPASS clock");
+	}
 
+	if (substream->stream == SNDRV_PCM_STREAM_CAPTURE) {
 		if (gpio_is_valid(mic_en_gpio.gpio))
 			gpio_set_value(mic_en_gpio.gpio, 0);
 
@@ -226,7 +231,41 @@ static struct snd_soc_dai_link dory_dai[] = {
 		.ignore_pmdown_time = 1,
 		.be_id = MSM_FRONTEND_DAI_MULTIMEDIA1
 	},
+	{
+		/*
+		 * Short tap-feedback and notification sounds. The platform
+		 * is the low latency ASM instance, which opens its session
+		 * in low latency mode and only allows small periods.
+		 */
+		.name = "Dory LowLatency",
+		.stream_name = "MultiMedia5",
+		.cpu_dai_name	= "MultiMedia5",
+		.platform_name  = "msm-pcm-dsp.1",
+		.dynamic = 1,
+		.trigger = {SND_SOC_DPCM_TRIGGER_POST,
+			SND_SOC_DPCM_TRIGGER_POST},
+		.codec_dai_name = "snd-soc-dummy-dai",
+		.codec_name = "snd-soc-dummy",
+		.ignore_suspend = 1,
+		/* This dainlink has playback support */
+		.ignore_pmdown_time = 1,
+		.be_id = MSM_FRONTEND_DAI_MULTIMEDIA5
+	},
 	/* Backend DAI Links */
+	{
+		.name = LPASS_BE_PRI_MI2S_RX,
+		.stream_name = "Primary MI2S Playback",
+		.cpu_dai_name = "msm-dai-q6-mi2s.0",
+		.platform_name = "msm-pcm-routing",
+		.codec_name     = "msm-stub-codec.1",
+		.codec_dai_name = "msm-stub-rx",
+		.no_pcm = 1,
+		.be_id = MSM_BACKEND_DAI_PRI_MI2S_RX,
+		.be_hw_params_fixup = dory_mi2s_hw_params_fixup,
+		.ops = &dory_mi2s_be_ops,
+		.ignore_pmdown_time = 1,
+		.ignore_suspend = 1,
+	},
 	{
 		.name = LPASS_BE_PRI_MI2S_TX,
 		.stream_name = "Primary MI2S Capture",
@@ -28,8 +28,35 @@
 #include <sound/control.h>
 #include <sound/q6lsm.h>
 #include <sound/lsm_params.h>
+#include <linux/msm_audio_ion.h>
 #include "msm-pcm-routing-v2.h"
 
+#define CAPTURE_MIN_NUM_PERIODS     2
+#define CAPTURE_MAX_NUM_PERIODS     8
+#define CAPTURE_MAX_PERIOD_SIZE     4096
+#define CAPTURE_MIN_PERIOD_SIZE     320
+
+/* Look ahead buffer stream, 16KHz mono as produced by the listen engine */
+static struct snd_pcm_hardware msm_pcm_hardware_capture = {
+	.info =                 (SNDRV_PCM_INFO_MMAP |
+				SNDRV_PCM_INFO_BLOCK_TRANSFER |
+				SNDRV_PCM_INFO_MMAP_VALID |
+				SNDRV_PCM_INFO_INTERLEAVED),
+	.formats =              SNDRV_PCM_FMTBIT_S16_LE,
+	.rates =                SNDRV_PCM_RATE_16000,
+	.rate_min =             16000,
+	.rate_max =             16000,
+	.channels_min =         1,
+	.channels_max =         1,
+	.buffer_bytes_max =     CAPTURE_MAX_NUM_PERIODS *
+				CAPTURE_MAX_PERIOD_SIZE,
+	.period_bytes_min =	CAPTURE_MIN_PERIOD_SIZE,
+	.period_bytes_max =     CAPTURE_MAX_PERIOD_SIZE,
+	.periods_min =          CAPTURE_MIN_NUM_PERIODS,
+	.periods_max =          CAPTURE_MAX_NUM_PERIODS,
+	.fifo_size =            0,
+};
+
 struct lsm_priv {
 	struct snd_pcm_substream *substream;
 	struct lsm_client *lsm_client;
@@ -39,8 +66,79 @@ struct lsm_priv {
 	wait_queue_head_t event_wait;
 	unsigned long event_avail;
 	atomic_t event_wait_stop;
+
+	unsigned int pcm_irq_pos;
+	unsigned int pcm_size;
 };
 
+/*
+ * The ring follows the stream's hw_params, so LAB can only be switched
+ * on once the stream is prepared and the DSP session is open.
+ */
+static int msm_lsm_lab_control(struct snd_pcm_substream *substream,
+			       bool enable)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct lsm_priv *prtd = runtime->private_data;
+	struct lsm_client *client = prtd->lsm_client;
+	struct snd_dma_buffer *dma_buf = &substream->dma_buffer;
+	int rc;
+
+	if (!enable) {
+		rc = q6lsm_lab_control(client, false);
+		snd_pcm_set_runtime_buffer(substream, NULL);
+		q6lsm_lab_buffer_free(client);
+		return rc;
+	}
+
+	if (runtime->status->state != SNDRV_PCM_STATE_PREPARED)
+		return -EBADFD;
+
+	if (!client->lab_buffer.data) {
+		rc = q6lsm_lab_buffer_alloc(client,
+				frames_to_bytes(runtime, runtime->period_size),
+				runtime->periods);
+		if (rc < 0) {
+			pr_err("%s: LAB buffer allocation failed rc = %d\n",
+			       __func__, rc);
+			return rc;
+		}
+	}
+
+	dma_buf->dev.type = SNDRV_DMA_TYPE_DEV;
+	dma_buf->dev.dev = substream->pcm->card->dev;
+	dma_buf->private_data = NULL;
+	dma_buf->area = client->lab_buffer.data;
+	dma_buf->addr = client->lab_buffer.phys;
+	dma_buf->bytes = frames_to_bytes(runtime, runtime->buffer_size);
+	snd_pcm_set_runtime_buffer(substream, dma_buf);
+	prtd->pcm_size = dma_buf->bytes;
+
+	rc = q6lsm_lab_control(client, true);
+	if (rc < 0) {
+		snd_pcm_set_runtime_buffer(substream, NULL);
+		q6lsm_lab_buffer_free(client);
+	}
+	return rc;
+}
+
+/* Queue every period of the look ahead buffer to the DSP */
+static void msm_lsm_start_lab(struct lsm_priv *prtd)
+{
+	struct lsm_client *client = prtd->lsm_client;
+	uint32_t i;
+
+	if (!client->lab_enable || client->lab_started ||
+	    !client->lab_buffer.data)
+		return;
+
+	prtd->pcm_irq_pos = 0;
+	client->lab_started = true;
+	for (i = 0; i < client->lab_buffer.periods; i++)
+		if (q6lsm_read(client, i) < 0)
+			break;
+}
+
 static void lsm_event_handler(uint32_t opcode, uint32_t token,
 			      void *payload, void *priv)
 {
@@ -78,7 +176,31 @@ static void lsm_event_handler(uint32_t opcode, uint32_t token,
 		}
 		if (substream->timer_running)
 			snd_timer_interrupt(substream->timer, 1);
+		/*
+		 * The DSP has been buffering the audio around the keyword
+		 * all along; hand it straight to the read stream.
+		 */
+		if (status == LSM_VOICE_WAKEUP_STATUS_DETECTED)
+			msm_lsm_start_lab(prtd);
 		break;
+	case LSM_DATA_EVENT_READ_DONE: {
+		struct lsm_cmd_read_done *read_done = payload;
+		struct lsm_client *client = prtd->lsm_client;
+
+		if (!client->lab_started)
+			break;
+		if (read_done->status) {
+			pr_err("%s: LAB read of period %d failed, status %d\n",
+			       __func__, token, read_done->status);
+			break;
+		}
+		prtd->pcm_irq_pos += client->lab_buffer.period_size;
+		snd_pcm_period_elapsed(substream);
+		/* Data lands in the mapped ring, so just reuse the period */
+		if (client->lab_started)
+			q6lsm_read(client, token);
+		break;
+	}
 	default:
 		pr_debug("%s: Unsupported Event opcode 0x%x\n", __func__,
 			 opcode);
@@ -275,8 +397,31 @@ static int msm_lsm_ioctl_shared(struct snd_pcm_substream *substream,
 		}
 		break;
 
+	case SNDRV_LSM_LAB_CONTROL: {
+		u32 *enable = arg;
+
+		pr_debug("%s: LAB control %d\n", __func__, *enable);
+		if (prtd->lsm_client->started) {
+			pr_err("%s: LAB can't change while session runs\n",
+			       __func__);
+			rc = -EBUSY;
+			break;
+		}
+		rc = msm_lsm_lab_control(substream, !!*enable);
+		break;
+	}
+
+	case SNDRV_LSM_STOP_LAB:
+		pr_debug("%s: Stopping LAB\n", __func__);
+		if (prtd->lsm_client->lab_started) {
+			prtd->lsm_client->lab_started = false;
+			rc = q6lsm_stop_lab(prtd->lsm_client);
+		}
+		break;
+
 	case SNDRV_LSM_STOP:
 		pr_debug("%s: Stopping LSM client session\n", __func__);
+		prtd->lsm_client->lab_started = false;
 		if (prtd->lsm_client->started) {
 			ret = q6lsm_stop(prtd->lsm_client, true);
 			if (!ret)
@@ -368,6 +513,16 @@ static int msm_lsm_ioctl(struct snd_pcm_substream *substream,
 			__func__, err);
 		return err;
 	}
+	case SNDRV_LSM_LAB_CONTROL: {
+		u32 enable;
+
+		if (copy_from_user(&enable, arg, sizeof(enable))) {
+			pr_err("%s: copy from user failed, size %zd\n",
+			       __func__, sizeof(enable));
+			return -EFAULT;
+		}
+		return msm_lsm_ioctl_shared(substream, cmd, &enable);
+	}
 	case SNDRV_LSM_EVENT_STATUS: {
 		struct snd_lsm_event_status *user = NULL, userarg;
 		pr_debug("%s: SNDRV_LSM_EVENT_STATUS\n", __func__);
@@ -435,10 +590,68 @@ static int msm_lsm_open(struct snd_pcm_substream *substream)
 		kfree(prtd);
 		return -ENOMEM;
 	}
+	runtime->hw = msm_pcm_hardware_capture;
+	if (snd_pcm_hw_constraint_integer(runtime,
+					  SNDRV_PCM_HW_PARAM_PERIODS) < 0)
+		pr_info("%s: snd_pcm_hw_constraint_integer failed\n",
+			__func__);
 	runtime->private_data = prtd;
 	return 0;
 }
 
+static int msm_lsm_hw_free(struct snd_pcm_substream *substream)
+{
+	struct lsm_priv *prtd = substream->runtime->private_data;
+
+	prtd->lsm_client->lab_started = false;
+	snd_pcm_set_runtime_buffer(substream, NULL);
+	return q6lsm_lab_buffer_free(prtd->lsm_client);
+}
+
+static int msm_lsm_trigger(struct snd_pcm_substream *substream, int cmd)
+{
+	struct lsm_priv *prtd = substream->runtime->private_data;
+
+	switch (cmd) {
+	case SNDRV_PCM_TRIGGER_START:
+		/* Data only starts flowing on a detection event */
+		break;
+	case SNDRV_PCM_TRIGGER_STOP:
+		prtd->lsm_client->lab_started = false;
+		break;
+	default:
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static snd_pcm_uframes_t msm_lsm_pointer(struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct lsm_priv *prtd = runtime->private_data;
+
+	if (prtd->pcm_irq_pos >= prtd->pcm_size)
+		prtd->pcm_irq_pos = 0;
+	return bytes_to_frames(runtime, prtd->pcm_irq_pos);
+}
+
+/* Zero copy: userspace maps the ION ring the DSP writes into */
+static int msm_lsm_mmap(struct snd_pcm_substream *substream,
+			struct vm_area_struct *vma)
+{
+	struct lsm_priv *prtd = substream->runtime->private_data;
+	struct lsm_lab_buffer *lab = &prtd->lsm_client->lab_buffer;
+	struct audio_buffer ab;
+
+	if (!lab->data)
+		return -EINVAL;
+
+	memset(&ab, 0, sizeof(ab));
+	ab.client = lab->client;
+	ab.handle = lab->handle;
+	return msm_audio_ion_mmap(&ab, vma);
+}
+
 static int msm_lsm_prepare(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
@@ -473,6 +686,11 @@ static int msm_lsm_close(struct snd_pcm_substream *substream)
 
 	pr_debug("%s\n", __func__);
 
+	if (prtd->lsm_client->lab_started) {
+		prtd->lsm_client->lab_started = false;
+		q6lsm_stop_lab(prtd->lsm_client);
+	}
+	q6lsm_lab_buffer_free(prtd->lsm_client);
 	q6lsm_close(prtd->lsm_client);
 	q6lsm_client_free(prtd->lsm_client);
 
@@ -490,6 +708,10 @@ static struct snd_pcm_ops msm_lsm_ops = {
 	.close          = msm_lsm_close,
 	.ioctl          = msm_lsm_ioctl,
 	.prepare	= msm_lsm_prepare,
+	.hw_free	= msm_lsm_hw_free,
+	.trigger	= msm_lsm_trigger,
+	.pointer	= msm_lsm_pointer,
+	.mmap		= msm_lsm_mmap,
 };
 
 static int msm_asoc_lsm_new(struct snd_soc_pcm_runtime *rtd)
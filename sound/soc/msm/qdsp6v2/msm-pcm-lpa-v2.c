@@ -59,6 +59,7 @@ static struct snd_pcm_hardware msm_pcm_hardware = {
 				SNDRV_PCM_INFO_BLOCK_TRANSFER |
 				SNDRV_PCM_INFO_MMAP_VALID |
 				SNDRV_PCM_INFO_INTERLEAVED |
+				SNDRV_PCM_INFO_NO_PERIOD_WAKEUP |
 				SNDRV_PCM_INFO_PAUSE | SNDRV_PCM_INFO_RESUME),
 	.formats =              SNDRV_PCM_FMTBIT_S16_LE |
 					SNDRV_PCM_FMTBIT_S24_LE,
@@ -68,9 +69,9 @@ static struct snd_pcm_hardware msm_pcm_hardware = {
 	.rate_max =             192000,
 	.channels_min =         1,
 	.channels_max =         2,
-	.buffer_bytes_max =     1024 * 1024,
+	.buffer_bytes_max =     2 * 1024 * 1024,
 	.period_bytes_min =	128 * 1024,
-	.period_bytes_max =     256 * 1024,
+	.period_bytes_max =     512 * 1024,
 	.periods_min =          4,
 	.periods_max =          8,
 	.fifo_size =            0,
@@ -88,6 +89,41 @@ static struct snd_pcm_hw_constraint_list constraints_sample_rates = {
 	.mask = 0,
 };
 
+/* out_head wraps with a mask, so the period count must be a power of 2 */
+static unsigned int supported_periods[] = {
+	4, 8
+};
+
+static struct snd_pcm_hw_constraint_list constraints_periods = {
+	.count = ARRAY_SIZE(supported_periods),
+	.list = supported_periods,
+	.mask = 0,
+};
+
+/*
+ * Account one consumed period. Streams opened with no period wakeup
+ * leave the ALSA pointer alone until userspace asks for it, so the
+ * driver keeps its own copy of the hardware position for the underrun
+ * check and lets the AP sleep through the whole DSP buffer.
+ */
+static snd_pcm_uframes_t msm_pcm_period_done(
+		struct snd_pcm_substream *substream)
+{
+	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct msm_audio *prtd = runtime->private_data;
+
+	if (!runtime->no_period_wakeup) {
+		if (atomic_read(&prtd->start))
+			snd_pcm_period_elapsed(substream);
+		return runtime->status->hw_ptr;
+	}
+
+	prtd->hw_pos += runtime->period_size;
+	if (prtd->hw_pos >= runtime->boundary)
+		prtd->hw_pos -= runtime->boundary;
+	return prtd->hw_pos;
+}
+
 static void event_handler(uint32_t opcode,
 		uint32_t token, uint32_t *payload, void *priv)
 {
@@ -97,6 +133,7 @@ static void event_handler(uint32_t opcode,
 	struct audio_aio_write_param param;
 	struct audio_buffer *buf = NULL;
 	struct output_meta_data_st output_meta_data;
+	snd_pcm_uframes_t hw_pos;
 	unsigned long flag = 0;
 	int i = 0;
 
@@ -109,11 +146,9 @@ static void event_handler(uint32_t opcode,
 		pr_debug("ASM_DATA_EVENT_WRITE_DONE_V2\n");
 		pr_debug("Buffer Consumed = 0x%08x\n", *ptrmem);
 		prtd->pcm_irq_pos += prtd->pcm_count;
-		if (atomic_read(&prtd->start))
-			snd_pcm_period_elapsed(substream);
-		else
-			if (substream->timer_running)
-				snd_timer_interrupt(substream->timer, 1);
+		hw_pos = msm_pcm_period_done(substream);
+		if (!atomic_read(&prtd->start) && substream->timer_running)
+			snd_timer_interrupt(substream->timer, 1);
 
 		atomic_inc(&prtd->out_count);
 		wake_up(&the_locks.write_wait);
@@ -124,7 +159,7 @@ static void event_handler(uint32_t opcode,
 			atomic_set(&prtd->pending_buffer, 0);
 
 		buf = prtd->audio_client->port[IN].buf;
-		if (runtime->status->hw_ptr >= runtime->control->appl_ptr) {
+		if (hw_pos >= runtime->control->appl_ptr) {
 			runtime->render_flag |= SNDRV_RENDER_STOPPED;
 			pr_info("%s:lpa driver underrun\n", __func__);
 			break;
@@ -343,6 +378,7 @@ static int msm_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 	switch (cmd) {
 	case SNDRV_PCM_TRIGGER_START:
 		prtd->pcm_irq_pos = 0;
+		prtd->hw_pos = runtime->status->hw_ptr;
 		atomic_set(&prtd->pending_buffer, 1);
 	case SNDRV_PCM_TRIGGER_RESUME:
 	case SNDRV_PCM_TRIGGER_PAUSE_RELEASE:
@@ -413,6 +449,11 @@ static int msm_pcm_open(struct snd_pcm_substream *substream)
 					    SNDRV_PCM_HW_PARAM_PERIODS);
 	if (ret < 0)
 		pr_debug("snd_pcm_hw_constraint_integer failed\n");
+	ret = snd_pcm_hw_constraint_list(runtime, 0,
+				SNDRV_PCM_HW_PARAM_PERIODS,
+				&constraints_periods);
+	if (ret < 0)
+		pr_debug("snd_pcm_hw_constraint_list periods failed\n");
 
 	prtd->dsp_cnt = 0;
 	atomic_set(&prtd->pending_buffer, 1);
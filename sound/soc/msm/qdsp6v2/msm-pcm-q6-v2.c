@@ -51,6 +51,11 @@ struct snd_msm {
 #define CAPTURE_MAX_NUM_PERIODS     8
 #define CAPTURE_MAX_PERIOD_SIZE     4096
 #define CAPTURE_MIN_PERIOD_SIZE     320
+/* 2ms of 48KHz mono up to 10ms of 48KHz stereo, 16 bit */
+#define LOW_LATENCY_MIN_NUM_PERIODS 2
+#define LOW_LATENCY_MAX_NUM_PERIODS 4
+#define LOW_LATENCY_MIN_PERIOD_SIZE 192
+#define LOW_LATENCY_MAX_PERIOD_SIZE 1920
 #define CMD_EOS_MIN_TIMEOUT_LENGTH  50
 #define CMD_EOS_TIMEOUT_MULTIPLIER  (HZ * 50)
 
@@ -81,6 +86,7 @@ static struct snd_pcm_hardware msm_pcm_hardware_playback = {
 				SNDRV_PCM_INFO_BLOCK_TRANSFER |
 				SNDRV_PCM_INFO_MMAP_VALID |
 				SNDRV_PCM_INFO_INTERLEAVED |
+				SNDRV_PCM_INFO_NO_PERIOD_WAKEUP |
 				SNDRV_PCM_INFO_PAUSE | SNDRV_PCM_INFO_RESUME),
 	.formats =              (SNDRV_PCM_FMTBIT_S16_LE |
 				SNDRV_PCM_FMTBIT_S24_LE),
@@ -98,6 +104,31 @@ static struct snd_pcm_hardware msm_pcm_hardware_playback = {
 	.fifo_size =            0,
 };
 
+/*
+ * The low latency ASM session only runs without resampling at 48KHz, so
+ * restrict it to that rate and to short buffers of at most a few periods.
+ */
+static struct snd_pcm_hardware msm_pcm_hardware_playback_low_latency = {
+	.info =                 (SNDRV_PCM_INFO_MMAP |
+				SNDRV_PCM_INFO_BLOCK_TRANSFER |
+				SNDRV_PCM_INFO_MMAP_VALID |
+				SNDRV_PCM_INFO_INTERLEAVED |
+				SNDRV_PCM_INFO_PAUSE | SNDRV_PCM_INFO_RESUME),
+	.formats =              SNDRV_PCM_FMTBIT_S16_LE,
+	.rates =                SNDRV_PCM_RATE_48000,
+	.rate_min =             48000,
+	.rate_max =             48000,
+	.channels_min =         1,
+	.channels_max =         2,
+	.buffer_bytes_max =     LOW_LATENCY_MAX_NUM_PERIODS *
+				LOW_LATENCY_MAX_PERIOD_SIZE,
+	.period_bytes_min =	LOW_LATENCY_MIN_PERIOD_SIZE,
+	.period_bytes_max =     LOW_LATENCY_MAX_PERIOD_SIZE,
+	.periods_min =          LOW_LATENCY_MIN_NUM_PERIODS,
+	.periods_max =          LOW_LATENCY_MAX_NUM_PERIODS,
+	.fifo_size =            0,
+};
+
 /* Conventional and unconventional sample rate supported */
 static unsigned int supported_sample_rates[] = {
 	8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000,
@@ -145,7 +176,12 @@ static void event_handler(uint32_t opcode,
 		pr_debug("ASM_DATA_EVENT_WRITE_DONE_V2\n");
 		pr_debug("Buffer Consumed = 0x%08x\n", *ptrmem);
 		prtd->pcm_irq_pos += prtd->pcm_count;
-		if (atomic_read(&prtd->start))
+		/*
+		 * Without period wakeups userspace polls the pointer,
+		 * which reads pcm_irq_pos, so only the position moves.
+		 */
+		if (atomic_read(&prtd->start) &&
+		    !substream->runtime->no_period_wakeup)
 			snd_pcm_period_elapsed(substream);
 		atomic_inc(&prtd->out_count);
 		wake_up(&the_locks.write_wait);
@@ -374,9 +410,15 @@ static int msm_pcm_trigger(struct snd_pcm_substream *substream, int cmd)
 static int msm_pcm_open(struct snd_pcm_substream *substream)
 {
 	struct snd_pcm_runtime *runtime = substream->runtime;
+	struct snd_soc_pcm_runtime *soc_prtd = substream->private_data;
+	struct msm_plat_data *pdata;
 	struct msm_audio *prtd;
+	bool low_latency;
 	int ret = 0;
 
+	pdata = dev_get_drvdata(soc_prtd->platform->dev);
+	low_latency = pdata && pdata->perf_mode != LEGACY_PCM_MODE;
+
 	prtd = kzalloc(sizeof(struct msm_audio), GFP_KERNEL);
 	if (prtd == NULL) {
 		pr_err("Failed to allocate memory for msm_audio\n");
@@ -391,7 +433,9 @@ static int msm_pcm_open(struct snd_pcm_substream *substream)
 		return -ENOMEM;
 	}
 
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK && low_latency)
+		runtime->hw = msm_pcm_hardware_playback_low_latency;
+	else if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK)
 		runtime->hw = msm_pcm_hardware_playback;
 
 	/* Capture path */
@@ -413,7 +457,18 @@ static int msm_pcm_open(struct snd_pcm_substream *substream)
 	if (ret < 0)
 		pr_info("snd_pcm_hw_constraint_integer failed\n");
 
-	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
+	if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK && low_latency) {
+		ret = snd_pcm_hw_constraint_minmax(runtime,
+			SNDRV_PCM_HW_PARAM_BUFFER_BYTES,
+			LOW_LATENCY_MIN_NUM_PERIODS *
+			LOW_LATENCY_MIN_PERIOD_SIZE,
+			LOW_LATENCY_MAX_NUM_PERIODS *
+			LOW_LATENCY_MAX_PERIOD_SIZE);
+		if (ret < 0) {
+			pr_err("constraint for buffer bytes min max ret = %d\n",
+									ret);
+		}
+	} else if (substream->stream == SNDRV_PCM_STREAM_PLAYBACK) {
 		ret = snd_pcm_hw_constraint_minmax(runtime,
 			SNDRV_PCM_HW_PARAM_BUFFER_BYTES,
 			PLAYBACK_MIN_NUM_PERIODS * PLAYBACK_MIN_PERIOD_SIZE,
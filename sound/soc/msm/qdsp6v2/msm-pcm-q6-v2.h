@@ -87,6 +87,7 @@ struct msm_audio {
 	atomic_t out_needed;
 	atomic_t eos;
 	int out_head;
+	snd_pcm_uframes_t hw_pos;	/* position when not woken per period */
 	int periods;
 	int mmap_flag;
 	atomic_t pending_buffer;
@@ -37,6 +37,8 @@
 #define LSM_ALIGN_BOUNDARY 512
 #define LSM_SAMPLE_RATE 16000
 #define QLSM_PARAM_ID_MINOR_VERSION 1
+/* Worst case time for the AP to wake up and start draining the LAB */
+#define LSM_LAB_WAKEUP_LATENCY_MS 500
 
 enum {
 	CMD_STATE_CLEARED = 0,
@@ -101,6 +103,7 @@ static int q6lsm_callback(struct apr_client_data *data, void *priv)
 		switch (payload[0]) {
 		case LSM_SESSION_CMD_START:
 		case LSM_SESSION_CMD_STOP:
+		case LSM_SESSION_CMD_EOB:
 		case LSM_SESSION_CMD_SET_PARAMS:
 		case LSM_SESSION_CMD_OPEN_TX:
 		case LSM_SESSION_CMD_CLOSE_TX:
@@ -956,6 +959,157 @@ exit:
 	return rc;
 }
 
+int q6lsm_lab_control(struct lsm_client *client, bool enable)
+{
+	struct lsm_cmd_set_params_lab_enable lab_enable;
+	struct lsm_cmd_set_params_lab_config lab_config;
+	int rc;
+
+	if (!client || CHECK_SESSION(client->session))
+		return -EINVAL;
+
+	memset(&lab_enable, 0, sizeof(lab_enable));
+	q6lsm_add_hdr(client, &lab_enable.hdr, sizeof(lab_enable), true);
+	lab_enable.hdr.opcode = LSM_SESSION_CMD_SET_PARAMS;
+	lab_enable.data_payload_size = sizeof(struct lsm_param_lab_enable);
+	lab_enable.lab_enable.common.module_id = LSM_MODULE_ID_LAB;
+	lab_enable.lab_enable.common.param_id = LSM_PARAM_ID_LAB_ENABLE;
+	lab_enable.lab_enable.common.param_size =
+		sizeof(struct lsm_param_lab_enable) -
+		sizeof(struct lsm_param_payload_common);
+	lab_enable.lab_enable.enable = enable;
+	rc = q6lsm_apr_send_pkt(client, client->apr, &lab_enable, true, NULL);
+	if (rc) {
+		pr_err("%s: Failed to %s LAB, rc %d\n", __func__,
+		       enable ? "enable" : "disable", rc);
+		return rc;
+	}
+
+	if (enable) {
+		memset(&lab_config, 0, sizeof(lab_config));
+		q6lsm_add_hdr(client, &lab_config.hdr, sizeof(lab_config),
+			      true);
+		lab_config.hdr.opcode = LSM_SESSION_CMD_SET_PARAMS;
+		lab_config.data_payload_size =
+			sizeof(struct lsm_param_lab_config);
+		lab_config.lab_config.common.module_id = LSM_MODULE_ID_LAB;
+		lab_config.lab_config.common.param_id =
+			LSM_PARAM_ID_LAB_CONFIG;
+		lab_config.lab_config.common.param_size =
+			sizeof(struct lsm_param_lab_config) -
+			sizeof(struct lsm_param_payload_common);
+		lab_config.lab_config.minor_version =
+			QLSM_PARAM_ID_MINOR_VERSION;
+		lab_config.lab_config.wake_up_latency_ms =
+			LSM_LAB_WAKEUP_LATENCY_MS;
+		rc = q6lsm_apr_send_pkt(client, client->apr, &lab_config,
+					true, NULL);
+		if (rc) {
+			pr_err("%s: Failed to configure LAB, rc %d\n",
+			       __func__, rc);
+			return rc;
+		}
+	}
+
+	client->lab_enable = enable;
+	return 0;
+}
+
+int q6lsm_lab_buffer_free(struct lsm_client *client)
+{
+	struct lsm_lab_buffer *lab;
+	int rc = 0;
+
+	if (!client || CHECK_SESSION(client->session))
+		return -EINVAL;
+
+	lab = &client->lab_buffer;
+	mutex_lock(&client->cmd_lock);
+	if (lab->data) {
+		rc = q6lsm_memory_unmap_regions(client, lab->mem_map_handle);
+		if (rc < 0)
+			pr_err("%s: CMD Memory_unmap_regions failed\n",
+			       __func__);
+		msm_audio_ion_free(lab->client, lab->handle);
+		memset(lab, 0, sizeof(*lab));
+	}
+	mutex_unlock(&client->cmd_lock);
+	return rc;
+}
+
+int q6lsm_lab_buffer_alloc(struct lsm_client *client, uint32_t period_size,
+			   uint32_t periods)
+{
+	struct lsm_lab_buffer *lab;
+	size_t len;
+	int rc;
+
+	if (!client || CHECK_SESSION(client->session) ||
+	    !period_size || !periods)
+		return -EINVAL;
+
+	lab = &client->lab_buffer;
+	mutex_lock(&client->cmd_lock);
+	if (lab->data) {
+		mutex_unlock(&client->cmd_lock);
+		return -EBUSY;
+	}
+	len = PAGE_ALIGN(period_size * periods);
+	rc = msm_audio_ion_alloc("lsm_lab", &lab->client, &lab->handle,
+				 len, &lab->phys, &len, &lab->data);
+	if (rc) {
+		pr_err("%s: Audio ION alloc is failed, rc = %d\n",
+		       __func__, rc);
+		mutex_unlock(&client->cmd_lock);
+		return rc;
+	}
+	lab->size = len;
+	lab->period_size = period_size;
+	lab->periods = periods;
+	mutex_unlock(&client->cmd_lock);
+
+	rc = q6lsm_memory_map_regions(client, lab->phys, len,
+				      &lab->mem_map_handle);
+	if (rc < 0) {
+		pr_err("%s: CMD Memory_map_regions failed\n", __func__);
+		q6lsm_lab_buffer_free(client);
+	}
+	return rc;
+}
+
+/*
+ * q6lsm_read : may be called from the APR callback, so it sends the read
+ *		without waiting. Completion comes as LSM_DATA_EVENT_READ_DONE
+ *		with the period index in the token.
+ */
+int q6lsm_read(struct lsm_client *client, uint32_t idx)
+{
+	struct lsm_lab_buffer *lab = &client->lab_buffer;
+	struct lsm_cmd_read read;
+	dma_addr_t addr;
+	int rc;
+
+	if (!lab->data || idx >= lab->periods)
+		return -EINVAL;
+
+	addr = lab->phys + idx * lab->period_size;
+	memset(&read, 0, sizeof(read));
+	q6lsm_add_hdr(client, &read.hdr, sizeof(read), false);
+	read.hdr.opcode = LSM_SESSION_CMD_READ;
+	read.hdr.token = idx;
+	read.buf_addr_lsw = lower_32_bits(addr);
+	read.buf_addr_msw = upper_32_bits(addr);
+	read.mem_map_handle = lab->mem_map_handle;
+	read.buf_size = lab->period_size;
+	rc = apr_send_pkt(client->apr, (uint32_t *)&read);
+	if (rc < 0) {
+		pr_err("%s: Failed read of period %d, rc %d\n", __func__,
+		       idx, rc);
+		return rc;
+	}
+	return 0;
+}
+
 static int q6lsm_cmd(struct lsm_client *client, int opcode, bool wait)
 {
 	struct apr_hdr hdr;
@@ -966,6 +1120,7 @@ static int q6lsm_cmd(struct lsm_client *client, int opcode, bool wait)
 	switch (opcode) {
 	case LSM_SESSION_CMD_START:
 	case LSM_SESSION_CMD_STOP:
+	case LSM_SESSION_CMD_EOB:
 	case LSM_SESSION_CMD_CLOSE_TX:
 		hdr.opcode = opcode;
 		break;
@@ -991,6 +1146,11 @@ int q6lsm_stop(struct lsm_client *client, bool wait)
 	return q6lsm_cmd(client, LSM_SESSION_CMD_STOP, wait);
 }
 
+int q6lsm_stop_lab(struct lsm_client *client)
+{
+	return q6lsm_cmd(client, LSM_SESSION_CMD_EOB, true);
+}
+
 int q6lsm_close(struct lsm_client *client)
 {
 	return q6lsm_cmd(client, LSM_SESSION_CMD_CLOSE_TX, true);